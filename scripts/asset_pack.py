@@ -0,0 +1,324 @@
+"""
+Build the read-only asset pack for the "assets" flash partition
+
+Reads the manifest (assets/assets.txt), converts each source to the layout
+the firmware reads in place (src/firmware/utils/asset_pack.cpp) and writes
+the pack plus the AssetId header the firmware is compiled with:
+- font:   BDF -> Adafruit_GFX GFXglyph table and packed glyph bits
+- bitmap: PBM (P1/P4) -> rows padded to bytes, MSB first
+- prompt: 16-bit mono WAV -> PCM, or IMA ADPCM blocks in the firmware
+          encoder's block format (dsp/audio_codec.cpp)
+
+scripts/build_assets.py runs this before every firmware build.
+
+Usage:
+    python scripts/asset_pack.py assets/assets.txt --out assets.bin
+    python scripts/asset_pack.py assets/assets.txt --out assets.bin --header src/firmware/config/asset_ids.h
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+import wave
+
+FORMAT = 1
+HEADER_BYTES = 64
+ENTRY = struct.Struct("<IIB3x")
+FONT_HEADER = struct.Struct("<HHBBH")
+GLYPH = struct.Struct("<HBBBbbx")
+BITMAP_HEADER = struct.Struct("<HH")
+PROMPT_HEADER = struct.Struct("<HBxIHH")
+
+TYPES = {"font": 1, "bitmap": 2, "prompt": 3}
+CODEC_PCM16, CODEC_IMA_ADPCM = 0, 1
+ADPCM_BLOCK_SAMPLES = 256
+
+# IMA ADPCM as in AudioEncoder
+STEP_SIZES = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+]
+INDEX_STEPS = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+class ManifestError(Exception):
+    pass
+
+
+def read_manifest(path):
+    """Return [(id, type, source path, {option: value})] in manifest order"""
+    assets = []
+    base = os.path.dirname(os.path.abspath(path))
+    with open(path, "r", encoding="utf-8") as f:
+        for number, line in enumerate(f, 1):
+            fields = line.split("#", 1)[0].split()
+            if not fields:
+                continue
+            if len(fields) < 3 or fields[1] not in TYPES:
+                raise ManifestError(f"{path}:{number}: expected '<ID> font|bitmap|prompt <source> [options]'")
+            options = {}
+            for option in fields[3:]:
+                key, _, value = option.partition("=")
+                options[key] = value
+            if any(fields[0] == asset[0] for asset in assets):
+                raise ManifestError(f"{path}:{number}: duplicate id {fields[0]}")
+            assets.append((fields[0], fields[1], os.path.join(base, fields[2]), options))
+    return assets
+
+
+def schema_of(assets):
+    """FNV-1a over ids and types: changes whenever the id numbering could"""
+    h = 0x811C9DC5
+    for name, kind, _, _ in assets:
+        for byte in f"{name} {kind}\n".encode():
+            h = ((h ^ byte) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+# ---------------------------------------------------------------- Fonts
+
+def load_bdf(path, options):
+    """Adafruit_GFX font: header, glyph table and packed bits"""
+    properties, glyphs = {}, {}
+    with open(path, "r", encoding="latin-1") as f:
+        lines = iter(f.read().splitlines())
+    for line in lines:
+        words = line.split()
+        if not words:
+            continue
+        if words[0] in ("FONT_ASCENT", "FONT_DESCENT"):
+            properties[words[0]] = int(words[1])
+        elif words[0] == "STARTCHAR":
+            glyph = {}
+            for line in lines:
+                words = line.split()
+                if words[0] == "ENCODING":
+                    glyph["code"] = int(words[1])
+                elif words[0] == "DWIDTH":
+                    glyph["advance"] = int(words[1])
+                elif words[0] == "BBX":
+                    glyph["bbx"] = [int(w) for w in words[1:5]]
+                elif words[0] == "BITMAP":
+                    rows = []
+                    for line in lines:
+                        if line.strip() == "ENDCHAR":
+                            break
+                        rows.append(int(line.strip(), 16) if line.strip() else 0)
+                    glyph["rows"] = rows
+                    break
+            glyphs[glyph["code"]] = glyph
+
+    first, _, last = options.get("chars", "32-126").partition("-")
+    first, last = int(first), int(last or first)
+    ascent = properties["FONT_ASCENT"]
+    line_height = int(options.get("line", ascent + properties["FONT_DESCENT"]))
+
+    table, bits = bytearray(), bytearray()
+    for code in range(first, last + 1):
+        glyph = glyphs.get(code)
+        if glyph is None:
+            table += GLYPH.pack(len(bits), 0, 0, 0, 0, 0)
+            continue
+        width, height, x_offset, y_offset = glyph["bbx"]
+        row_bits = ((width + 7) // 8) * 8
+        packed, count = 0, 0
+        start = len(bits)
+        for row in glyph["rows"][:height]:
+            for x in range(width):
+                packed = (packed << 1) | ((row >> (row_bits - 1 - x)) & 1)
+                count += 1
+                if count == 8:
+                    bits.append(packed)
+                    packed, count = 0, 0
+        if count:
+            bits.append(packed << (8 - count))
+        # BDF counts y up from the baseline to the bottom row; GFX down to the top row
+        table += GLYPH.pack(start, width, height, glyph["advance"], x_offset, -(y_offset + height))
+    if len(bits) > 0xFFFF:
+        raise ManifestError(f"{path}: glyph bits exceed 64 KB")
+    return FONT_HEADER.pack(first, last, line_height, ascent, len(bits)) + table + bits
+
+
+# ---------------------------------------------------------------- Bitmaps
+
+def load_pbm(path, options):
+    with open(path, "rb") as f:
+        data = f.read()
+    tokens, position = [], 0
+
+    def token():
+        nonlocal position
+        while True:
+            while position < len(data) and data[position:position + 1].isspace():
+                position += 1
+            if data[position:position + 1] == b"#":
+                while position < len(data) and data[position:position + 1] not in (b"\n", b"\r"):
+                    position += 1
+                continue
+            start = position
+            while position < len(data) and not data[position:position + 1].isspace():
+                position += 1
+            return data[start:position]
+
+    magic, width, height = token(), int(token()), int(token())
+    stride = (width + 7) // 8
+    if magic == b"P4":
+        rows = data[position + 1:position + 1 + stride * height]
+        if len(rows) != stride * height:
+            raise ManifestError(f"{path}: truncated P4 data")
+        pixels = bytes(rows)
+    elif magic == b"P1":
+        out = bytearray(stride * height)
+        digits = b"".join(data[position:].split())
+        digits = bytes(d for d in digits if d in b"01")
+        if len(digits) < width * height:
+            raise ManifestError(f"{path}: truncated P1 data")
+        for y in range(height):
+            for x in range(width):
+                if digits[y * width + x] == ord("1"):
+                    out[y * stride + x // 8] |= 0x80 >> (x & 7)
+        pixels = bytes(out)
+    else:
+        raise ManifestError(f"{path}: not a PBM (P1 or P4) file")
+    return BITMAP_HEADER.pack(width, height) + pixels
+
+
+# ---------------------------------------------------------------- Prompts
+
+def adpcm_blocks(samples, block_samples):
+    """IMA ADPCM blocks with AudioEncoder's 4-byte header; state carries over"""
+    predictor, index = 0, 0
+    blocks = []
+    for start in range(0, len(samples), block_samples):
+        chunk = samples[start:start + block_samples]
+        block = bytearray(struct.pack("<hBB", predictor, index, 1 if len(chunk) & 1 else 0))
+        nibbles = []
+        for sample in chunk:
+            difference = sample - predictor
+            nibble = 0
+            if difference < 0:
+                nibble, difference = 8, -difference
+            size = STEP_SIZES[index]
+            delta = size >> 3
+            if difference >= size:
+                nibble |= 4
+                difference -= size
+                delta += size
+            if difference >= size >> 1:
+                nibble |= 2
+                difference -= size >> 1
+                delta += size >> 1
+            if difference >= size >> 2:
+                nibble |= 1
+                delta += size >> 2
+            predictor = max(-32768, min(32767, predictor - delta if nibble & 8 else predictor + delta))
+            index = max(0, min(len(STEP_SIZES) - 1, index + INDEX_STEPS[nibble & 7]))
+            nibbles.append(nibble)
+        for i in range(0, len(nibbles), 2):
+            block.append(nibbles[i] | ((nibbles[i + 1] << 4) if i + 1 < len(nibbles) else 0))
+        blocks.append(bytes(block))
+    return blocks
+
+
+def load_wav(path, options):
+    with wave.open(path, "rb") as w:
+        if w.getnchannels() != 1 or w.getsampwidth() != 2:
+            raise ManifestError(f"{path}: prompts must be 16-bit mono")
+        rate = w.getframerate()
+        frames = w.readframes(w.getnframes())
+    samples = list(struct.unpack(f"<{len(frames) // 2}h", frames))
+    if "pcm" in options:
+        block_bytes = 2 * ADPCM_BLOCK_SAMPLES
+        header = PROMPT_HEADER.pack(rate, CODEC_PCM16, len(samples), block_bytes, ADPCM_BLOCK_SAMPLES)
+        return header + frames
+    blocks = adpcm_blocks(samples, ADPCM_BLOCK_SAMPLES)
+    block_bytes = 4 + ADPCM_BLOCK_SAMPLES // 2
+    header = PROMPT_HEADER.pack(rate, CODEC_IMA_ADPCM, len(samples), block_bytes, ADPCM_BLOCK_SAMPLES)
+    return header + b"".join(blocks)
+
+
+LOADERS = {"font": load_bdf, "bitmap": load_pbm, "prompt": load_wav}
+
+
+# ---------------------------------------------------------------- Pack
+
+def build(manifest):
+    """Return (pack bytes, assets, schema, [(id, type, bytes)])"""
+    assets = read_manifest(manifest)
+    schema = schema_of(assets)
+    data_start = HEADER_BYTES + ENTRY.size * len(assets)
+    data_start += -data_start % 4
+    table, data, sizes = bytearray(), bytearray(), []
+    for name, kind, source, options in assets:
+        blob = LOADERS[kind](source, options)
+        table += ENTRY.pack(data_start + len(data), len(blob), TYPES[kind])
+        data += blob
+        data += b"\0" * (-len(data) % 4)
+        sizes.append((name, kind, len(blob)))
+    body = bytes(table) + b"\0" * (data_start - HEADER_BYTES - len(table)) + bytes(data)
+    total = HEADER_BYTES + len(body)
+    header = struct.pack("<4sHHII16x32s", b"GAST", FORMAT, len(assets), schema, total, hashlib.sha256(body).digest())
+    return header + body, assets, schema, sizes
+
+
+def header_source(assets, schema, manifest):
+    lines = [
+        f"// Generated by scripts/asset_pack.py from {manifest}; do not edit",
+        "#ifndef ASSET_IDS_H",
+        "#define ASSET_IDS_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "// Hash of the manifest's ids and types; the pack must carry the same",
+        f"#define ASSET_SCHEMA 0x{schema:08X}u",
+        "",
+        "enum AssetId : uint16_t {",
+    ]
+    lines += [f"    {name} = {i}," for i, (name, _, _, _) in enumerate(assets)]
+    lines += [f"    ASSET_COUNT = {len(assets)}", "};", "", "#endif", ""]
+    return "\n".join(lines)
+
+
+def write_if_changed(path, text):
+    """Leave an unchanged header alone so it does not trigger a rebuild"""
+    if os.path.exists(path):
+        with open(path, "r", encoding="utf-8") as f:
+            if f.read() == text:
+                return False
+    with open(path, "w", encoding="utf-8", newline="\n") as f:
+        f.write(text)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the firmware asset pack")
+    parser.add_argument("manifest", help="Asset manifest, e.g. assets/assets.txt")
+    parser.add_argument("--out", required=True, help="Pack to write")
+    parser.add_argument("--header", help="AssetId header to (re)generate")
+    args = parser.parse_args()
+
+    try:
+        pack, assets, schema, sizes = build(args.manifest)
+    except (ManifestError, OSError, KeyError, ValueError) as e:
+        print(f"asset_pack: {e}", file=sys.stderr)
+        return 1
+    with open(args.out, "wb") as f:
+        f.write(pack)
+    if args.header:
+        manifest = os.path.relpath(args.manifest).replace(os.sep, "/")
+        write_if_changed(args.header, header_source(assets, schema, manifest))
+
+    for name, kind, size in sizes:
+        print(f"  {name:<22} {kind:<7} {size:>8}")
+    print(f"{args.out}: {len(assets)} assets, {len(pack)} bytes, schema 0x{schema:08X}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,87 @@
+"""
+Compare host benchmark results against the stored baseline
+
+Reads two Google Benchmark style JSON files (the native build writes one with
+--benchmark_out) and fails when any benchmark's CPU time grew by more than the
+threshold. Benchmarks missing from either side are listed but do not fail.
+
+Usage:
+    pio run -e native -t exec -a "--benchmark_out=bench.json"
+    python scripts/bench_compare.py src/host/bench/baseline.json bench.json
+    python scripts/bench_compare.py src/host/bench/baseline.json bench.json --threshold 0.10
+    python scripts/bench_compare.py src/host/bench/baseline.json bench.json --update
+"""
+
+import argparse
+import json
+import shutil
+import sys
+
+
+def load(path):
+    """Map of benchmark name -> CPU time in ns, skipping errored runs"""
+    with open(path, "r", encoding="utf-8") as f:
+        data = json.load(f)
+
+    scale = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+    times = {}
+    for bench in data.get("benchmarks", []):
+        if bench.get("error_occurred"):
+            continue
+        # Keep only aggregate medians when repetitions were reported separately
+        if bench.get("run_type") == "aggregate" and bench.get("aggregate_name") != "median":
+            continue
+        name = bench.get("run_name", bench["name"])
+        times[name] = bench["cpu_time"] * scale.get(bench.get("time_unit", "ns"), 1.0)
+    return times
+
+
+def compare(baseline, current, threshold):
+    """Print a table and return the names that regressed"""
+    regressions = []
+    print(f"{'benchmark':<40} {'baseline':>12} {'current':>12} {'change':>8}")
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline:
+            print(f"{name:<40} {'-':>12} {current[name]:>10.0f}ns {'new':>8}")
+            continue
+        if name not in current:
+            print(f"{name:<40} {baseline[name]:>10.0f}ns {'-':>12} {'missing':>8}")
+            continue
+
+        old, new = baseline[name], current[name]
+        change = (new - old) / old if old > 0 else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print(f"{name:<40} {old:>10.0f}ns {new:>10.0f}ns {change * 100:>+7.1f}%{flag}")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check host benchmarks against a baseline")
+    parser.add_argument("baseline", help="Stored baseline JSON")
+    parser.add_argument("current", help="Fresh --benchmark_out JSON")
+    # Shared CI runners jitter by 10-20% even on best-of-5 timings
+    parser.add_argument("--threshold", type=float, default=0.25,
+                        help="Allowed CPU time growth as a fraction (default 0.25)")
+    parser.add_argument("--update", action="store_true",
+                        help="Replace the baseline with the current results after comparing")
+    args = parser.parse_args()
+
+    regressions = compare(load(args.baseline), load(args.current), args.threshold)
+
+    if args.update:
+        shutil.copyfile(args.current, args.baseline)
+        print(f"Baseline updated from {args.current}")
+        return 0
+
+    if regressions:
+        print(f"{len(regressions)} benchmark(s) slower than baseline by more than {args.threshold * 100:.0f}%")
+        return 1
+    print("No regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,54 @@
+"""
+PlatformIO pre-build script: builds the asset pack
+
+Runs scripts/asset_pack.py on assets/assets.txt before every build, writing
+$BUILD_DIR/assets.bin and regenerating src/firmware/config/asset_ids.h when
+the manifest's ids change (an unchanged header is left alone, so it does not
+trigger a rebuild). On device environments it also adds a target that
+flashes the pack into the "assets" partition, separately from the app:
+
+    pio run -e glasses -t upload_assets
+"""
+
+import os
+import sys
+
+# Offset of the "assets" partition in partitions_ab.csv
+ASSETS_OFFSET = "0x610000"
+
+
+def main(env):
+    project = env.subst("$PROJECT_DIR")
+    sys.path.insert(0, os.path.join(project, "scripts"))
+    import asset_pack
+
+    manifest = os.path.join(project, "assets", "assets.txt")
+    out = os.path.join(env.subst("$BUILD_DIR"), "assets.bin")
+    header = os.path.join(project, "src", "firmware", "config", "asset_ids.h")
+
+    try:
+        pack, assets, schema, _ = asset_pack.build(manifest)
+    except (asset_pack.ManifestError, OSError, KeyError, ValueError) as e:
+        print(f"Asset pack: {e}")
+        env.Exit(1)
+    os.makedirs(os.path.dirname(out), exist_ok=True)
+    with open(out, "wb") as f:
+        f.write(pack)
+    asset_pack.write_if_changed(header, asset_pack.header_source(assets, schema, "assets/assets.txt"))
+    print(f"Asset pack: {len(assets)} assets, {len(pack)} bytes, schema 0x{schema:08X}")
+
+    if env.subst("$PIOPLATFORM") == "espressif32":
+        env.AddCustomTarget(
+            name="upload_assets",
+            dependencies=None,
+            actions=[
+                '"$PYTHONEXE" "$UPLOADER" --chip esp32s3 --port "$UPLOAD_PORT" --baud $UPLOAD_SPEED '
+                f'write_flash {ASSETS_OFFSET} "{out}"'
+            ],
+            title="Upload assets",
+            description="Flash the asset pack into the assets partition",
+        )
+
+
+Import("env")
+main(env)
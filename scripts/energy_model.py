@@ -0,0 +1,412 @@
+"""
+Energy model for the glasses
+
+Estimates average battery drain (mA·h per hour) for a scripted usage trace
+under different power management policies. Currents are typical ESP32-S3 /
+peripheral datasheet figures; adjust CURRENT_MA to match measurements from
+your own board.
+
+A usage trace is a JSON file:
+    {
+        "name": "office",
+        "duration_s": 3600,
+        "rtt_s": 0.08,
+        "commands": [{"t": 120.0, "speech_s": 2.0, "server_s": 1.5,
+                      "reply_parts": 4, "reply_s": 0.3}, ...]
+    }
+or generated on the fly with --commands-per-hour. rtt_s, reply_parts (a
+response streamed in parts) and reply_s (the gap between parts) are
+optional.
+
+A second table weighs Wi-Fi power save against latency: the radio's draw
+and how long replies wait at the access point for the modem to wake, per
+radio policy (see RadioScheduler in src/firmware/modules/radio_scheduler.cpp).
+
+Usage:
+    python scripts/energy_model.py --commands-per-hour 30
+    python scripts/energy_model.py --trace my_trace.json --policy dynamic_pm
+    python scripts/energy_model.py --radio scheduled --radio listen_3 --sweep
+"""
+
+import argparse
+import json
+import random
+import sys
+
+# Average current per component state (mA)
+CURRENT_MA = {
+    "cpu": {
+        # (state, MHz) -> mA
+        ("active", 240): 43.0,
+        ("active", 160): 34.0,
+        ("active", 80): 23.0,
+        ("active", 40): 16.0,
+        ("idle", 240): 27.0,
+        ("idle", 160): 22.0,
+        ("idle", 80): 15.0,
+        ("idle", 40): 10.0,
+        ("light_sleep", 0): 0.24,
+    },
+    "wifi": {
+        "tx": 190.0,
+        "rx": 85.0,
+        "connected_idle": 80.0,  # radio on, no power save
+        "off": 0.0,
+    },
+    "display_on": 12.0,
+    "display_off": 0.02,
+    "mic": 1.4,
+    "base": 1.5,  # regulator quiescent, pull-ups, LED off
+}
+
+# Fixed durations of the on-device command stages (seconds)
+RENDER_S = 0.03
+# CPU cycles spent per main loop pass (touch read, network/power checks)
+LOOP_PASS_CYCLES = 60_000
+UPLOAD_BITRATE_BPS = 2_000_000
+AUDIO_BYTES_PER_S = 16000 * 2
+
+# Wi-Fi modem sleep. Asleep, the radio wakes for one beacon every interval
+# and stays up a while for the broadcasts the AP sends after it; frames for
+# the station wait at the AP until then.
+PS_FLOOR_MA = 3.0
+BEACON_INTERVAL_S = 0.1024
+BEACON_AWAKE_S = 0.0218
+# The driver dozes this long after a transmit; later replies wait for a beacon
+MIN_ACTIVE_S = 0.050
+# Turning power save off: a null frame to the AP before the first transmit
+PS_EXIT_S = 0.005
+# Listener path: chunks go up while the next one is spoken
+CHUNK_S = 0.5
+RTT_S = 0.08
+# How long candidate speech keeps the radio awake (RadioScheduler::EXPECT_MS)
+EXPECT_S = 3.0
+
+
+class Policy:
+    """How the firmware spends its time between and during commands"""
+
+    def __init__(self, name, active_mhz, idle_mhz, vad_mhz, loop_hz, vad_duty_240=0.02):
+        self.name = name
+        self.active_mhz = active_mhz
+        self.idle_mhz = idle_mhz
+        # Clock the VAD runs at while listening
+        self.vad_mhz = vad_mhz
+        # Main loop passes per second while waiting for speech
+        self.loop_hz = loop_hz
+        # Fraction of each VAD frame the CPU is busy when running at 240 MHz
+        self.vad_duty_240 = vad_duty_240
+
+
+POLICIES = {
+    # Original firmware: fixed 240 MHz, the CPU never sleeps
+    "baseline": Policy("baseline", active_mhz=240, idle_mhz=240, vad_mhz=240, loop_hz=100),
+    # PM locks around work, DFS down to 40 MHz in between. Automatic light sleep is
+    # enabled too, but while I2S streams its driver holds the APB lock, so with the
+    # mic always on the CPU idles at the minimum clock instead of sleeping.
+    "dynamic_pm": Policy("dynamic_pm", active_mhz=240, idle_mhz=40, vad_mhz=240, loop_hz=100),
+    # Listener task runs the wake detector at the minimum clock on batched DMA
+    # reads; the loop task blocks until candidate speech (50 ms wait slices)
+    "low_power_listen": Policy("low_power_listen", active_mhz=240, idle_mhz=40, vad_mhz=40, loop_hz=20),
+}
+
+
+class RadioPolicy:
+    """How the Wi-Fi modem sleeps between and around requests"""
+
+    def __init__(self, name, interval, scheduled, tail_s=0.0, early_wake=False):
+        self.name = name
+        # Beacons between wakes while asleep; None for no power save
+        self.interval = interval
+        # Awake from each request to its whole reply, asleep otherwise
+        self.scheduled = scheduled
+        # Awake after a reply
+        self.tail_s = tail_s
+        # Awake from candidate speech for EXPECT_S
+        self.early_wake = early_wake
+
+    def period_s(self):
+        return self.interval * BEACON_INTERVAL_S if self.interval else 0.0
+
+
+RADIO_POLICIES = {
+    # No power save: replies never wait
+    "always_on": RadioPolicy("always_on", None, False),
+    # Arduino core default, WIFI_PS_MIN_MODEM: wakes every DTIM (1 on most
+    # APs) and after every transmit
+    "dtim_sleep": RadioPolicy("dtim_sleep", 1, False),
+    # WIFI_PS_MAX_MODEM with a listen interval, nothing held awake
+    "listen_3": RadioPolicy("listen_3", 3, False),
+    # RadioPolicy::choose for NORMAL, ECO and ULTRA_LOW
+    "scheduled": RadioPolicy("scheduled", 3, True, tail_s=0.5, early_wake=True),
+    "scheduled_eco": RadioPolicy("scheduled_eco", 5, True, tail_s=0.2),
+    "scheduled_ultra_low": RadioPolicy("scheduled_ultra_low", 10, True),
+}
+
+
+def modem_sleep_ma(interval):
+    """Average radio draw while associated and asleep, waking every interval beacons"""
+    wake = CURRENT_MA["wifi"]["connected_idle"] * BEACON_AWAKE_S / (interval * BEACON_INTERVAL_S)
+    return PS_FLOOR_MA + wake
+
+
+def cpu_current(state, mhz):
+    table = CURRENT_MA["cpu"]
+    if state == "light_sleep":
+        return table[("light_sleep", 0)]
+    if (state, mhz) in table:
+        return table[(state, mhz)]
+    # Interpolate over the known clocks
+    known = sorted(m for s, m in table if s == state)
+    lower = max([m for m in known if m <= mhz], default=known[0])
+    upper = min([m for m in known if m >= mhz], default=known[-1])
+    if lower == upper:
+        return table[(state, lower)]
+    frac = (mhz - lower) / (upper - lower)
+    return table[(state, lower)] + frac * (table[(state, upper)] - table[(state, lower)])
+
+
+class EnergyAccumulator:
+    """Integrates current over time per component (mA·s)"""
+
+    def __init__(self):
+        self.mas = {}
+        self.seconds = 0.0
+
+    def add(self, seconds, **currents):
+        self.seconds += seconds
+        for component, ma in currents.items():
+            self.mas[component] = self.mas.get(component, 0.0) + ma * seconds
+
+    def total_mah(self):
+        return sum(self.mas.values()) / 3600.0
+
+
+def listening_cpu_ma(policy):
+    """CPU current while the microphone streams and the VAD runs on every DMA frame"""
+    vad = min(1.0, policy.vad_duty_240 * 240 / policy.vad_mhz)
+    # Loop passes take no PM lock and run at the idle clock
+    loop = min(1.0 - vad, policy.loop_hz * LOOP_PASS_CYCLES / (policy.idle_mhz * 1e6))
+    idle = 1.0 - vad - loop
+    return (vad * cpu_current("active", policy.vad_mhz) +
+            loop * cpu_current("active", policy.idle_mhz) +
+            idle * cpu_current("idle", policy.idle_mhz))
+
+
+def simulate(trace, policy):
+    """Return an EnergyAccumulator for one trace under one policy"""
+    acc = EnergyAccumulator()
+    duration = trace["duration_s"]
+    commands = sorted(trace["commands"], key=lambda c: c["t"])
+
+    busy_s = 0.0
+    for cmd in commands:
+        speech = cmd.get("speech_s", 2.0)
+        server = cmd.get("server_s", 1.5)
+        upload = speech * AUDIO_BYTES_PER_S * 8 / UPLOAD_BITRATE_BPS
+        cpu_active = cpu_current("active", policy.active_mhz)
+        wifi_idle = CURRENT_MA["wifi"]["connected_idle"]
+
+        # Capture: mic streaming, CPU mostly waiting on DMA
+        acc.add(speech, cpu=listening_cpu_ma(policy), wifi=wifi_idle, mic=CURRENT_MA["mic"], display=CURRENT_MA["display_on"], base=CURRENT_MA["base"])
+        # Upload: radio transmitting, network PM lock held
+        acc.add(upload, cpu=cpu_active, wifi=CURRENT_MA["wifi"]["tx"], mic=CURRENT_MA["mic"], display=CURRENT_MA["display_on"], base=CURRENT_MA["base"])
+        # Server wait: radio receiving, CPU idle
+        acc.add(server, cpu=cpu_current("idle", policy.idle_mhz), wifi=CURRENT_MA["wifi"]["rx"], mic=CURRENT_MA["mic"], display=CURRENT_MA["display_on"], base=CURRENT_MA["base"])
+        # Render the answer
+        acc.add(RENDER_S, cpu=cpu_active, wifi=wifi_idle, mic=CURRENT_MA["mic"], display=CURRENT_MA["display_on"], base=CURRENT_MA["base"])
+        busy_s += speech + upload + server + RENDER_S
+
+    # Remaining time: waiting for speech
+    idle_s = max(0.0, duration - busy_s)
+    acc.add(idle_s, cpu=listening_cpu_ma(policy), wifi=CURRENT_MA["wifi"]["connected_idle"],
+            mic=CURRENT_MA["mic"], display=CURRENT_MA["display_on"], base=CURRENT_MA["base"])
+    return acc
+
+
+def generate_trace(commands_per_hour, seed, duration_s=3600):
+    """Poisson command arrivals with randomized speech and server times"""
+    rng = random.Random(seed)
+    commands = []
+    t = 0.0
+    rate = commands_per_hour / 3600.0
+    while rate > 0:
+        t += rng.expovariate(rate)
+        if t >= duration_s:
+            break
+        commands.append({
+            "t": t,
+            "speech_s": rng.uniform(1.0, 3.0),
+            "server_s": rng.uniform(0.8, 2.5),
+        })
+    return {"name": f"poisson_{commands_per_hour}_per_hour", "duration_s": duration_s, "commands": commands}
+
+
+def report(trace, policies):
+    hours = trace["duration_s"] / 3600.0
+    print(f"Trace: {trace['name']} ({len(trace['commands'])} commands, {trace['duration_s'] / 60:.0f} min)")
+    print(f"{'policy':<16} {'mAh/h':>8} {'cpu':>7} {'wifi':>7} {'display':>8} {'mic':>6} {'base':>6}")
+    results = {}
+    for name in policies:
+        acc = simulate(trace, POLICIES[name])
+        per_hour = acc.total_mah() / hours
+        results[name] = per_hour
+        parts = {k: v / 3600.0 / hours for k, v in acc.mas.items()}
+        print(f"{name:<16} {per_hour:>8.1f} {parts.get('cpu', 0):>7.1f} {parts.get('wifi', 0):>7.1f} "
+              f"{parts.get('display', 0):>8.1f} {parts.get('mic', 0):>6.1f} {parts.get('base', 0):>6.1f}")
+
+    if "baseline" in results:
+        for name, value in results.items():
+            if name != "baseline" and results["baseline"] > 0:
+                saving = 100.0 * (1 - value / results["baseline"])
+                print(f"{name}: {saving:.1f}% less than baseline")
+    return results
+
+
+def command_exchanges(cmd, rtt):
+    """Requests of one command on the listener path: (send, upload_s, reply_parts, reply_s, server_s)"""
+    speech = cmd.get("speech_s", 2.0)
+    chunks = max(1, int(-(-speech // CHUNK_S)))
+    exchanges = []
+    for k in range(chunks):
+        spoken = min((k + 1) * CHUNK_S, speech)
+        length = spoken - k * CHUNK_S
+        upload = length * AUDIO_BYTES_PER_S * 8 / UPLOAD_BITRATE_BPS
+        final = k == chunks - 1
+        exchanges.append({
+            "spoken": cmd["t"] + spoken,
+            "upload": upload,
+            "server": cmd.get("server_s", 1.5) if final else 0.0,
+            "parts": cmd.get("reply_parts", 1) if final else 1,
+            "gap": cmd.get("reply_s", 0.0) if final else 0.0,
+        })
+    return exchanges
+
+
+def merge(intervals):
+    """Union of (start, end) intervals"""
+    merged = []
+    for start, end in sorted(intervals):
+        if merged and start <= merged[-1][1]:
+            merged[-1][1] = max(merged[-1][1], end)
+        else:
+            merged.append([start, end])
+    return merged
+
+
+def simulate_radio(trace, radio, rng):
+    """Return (wifi mA·s, per-command added latency in s) for one radio policy"""
+    duration = trace["duration_s"]
+    rtt = trace.get("rtt_s", RTT_S)
+    period = radio.period_s()
+    wifi = CURRENT_MA["wifi"]
+    awake = []
+    tx_s = 0.0
+    added = []
+
+    for cmd in sorted(trace["commands"], key=lambda c: c["t"]):
+        held = []
+        if radio.scheduled and radio.early_wake:
+            held.append((cmd["t"], cmd["t"] + EXPECT_S))
+        ready = ready_ideal = cmd["t"]
+        for ex in command_exchanges(cmd, rtt):
+            send = max(ex["spoken"], ready)
+            send_ideal = max(ex["spoken"], ready_ideal)
+            if period and radio.scheduled and not any(a <= send < b for a, b in held):
+                send += PS_EXIT_S
+            sent = send + ex["upload"]
+            tx_s += ex["upload"]
+            arrival = sent + rtt + ex["server"]
+            ideal = send_ideal + ex["upload"] + rtt + ex["server"]
+            last_tx = sent
+            for part in range(ex["parts"]):
+                # Without a guard, a part that comes after the driver dozed
+                # off waits at the AP for the next wake
+                if period and not radio.scheduled and arrival - last_tx > MIN_ACTIVE_S:
+                    arrival += rng.uniform(0.0, period)
+                awake.append((arrival, arrival + MIN_ACTIVE_S))
+                last_tx = arrival      # TCP ACK
+                if part < ex["parts"] - 1:
+                    arrival += ex["gap"]
+                    ideal += ex["gap"]
+            awake.append((send, sent + MIN_ACTIVE_S))
+            if radio.scheduled:
+                held.append((send, arrival + radio.tail_s))
+            ready, ready_ideal = arrival, ideal
+        awake.extend(held)
+        added.append(ready - ready_ideal)
+
+    if radio.interval is None:
+        awake_s = duration
+        asleep_ma = 0.0
+    else:
+        awake_s = sum(min(end, duration) - start for start, end in merge(awake) if start < duration)
+        asleep_ma = modem_sleep_ma(radio.interval)
+    mas = (awake_s * wifi["connected_idle"] + (duration - awake_s) * asleep_ma +
+           tx_s * (wifi["tx"] - wifi["connected_idle"]))
+    return mas, added
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(p / 100.0 * len(ordered)))]
+
+
+def report_radio(trace, radios, seed, sweep):
+    hours = trace["duration_s"] / 3600.0
+    print()
+    print(f"{'radio':<20} {'mAh/h':>8} {'added p50':>10} {'p90':>7} {'idle wait':>10}")
+    results = {}
+    for name in radios:
+        radio = RADIO_POLICIES[name]
+        mas, added = simulate_radio(trace, radio, random.Random(seed))
+        per_hour = mas / 3600.0 / hours
+        results[name] = per_hour
+        # A frame the server sends unprompted waits half a period on average
+        idle_wait = radio.period_s() / 2
+        print(f"{name:<20} {per_hour:>8.1f} "
+              f"{percentile(added, 50) * 1000:>8.0f}ms {percentile(added, 90) * 1000:>5.0f}ms "
+              f"{idle_wait * 1000:>8.0f}ms")
+
+    if "always_on" in results:
+        for name, value in results.items():
+            if name != "always_on" and results["always_on"] > 0:
+                saving = 100.0 * (1 - value / results["always_on"])
+                print(f"{name}: {saving:.1f}% less Wi-Fi than always_on")
+
+    if sweep:
+        print()
+        print(f"{'listen interval':<16} {'idle mA':>8} {'idle wait':>10}")
+        for interval in (1, 2, 3, 5, 10, 20):
+            print(f"{interval:<16} {modem_sleep_ma(interval):>8.1f} "
+                  f"{interval * BEACON_INTERVAL_S / 2 * 1000:>8.0f}ms")
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Estimate battery drain for a usage trace")
+    parser.add_argument("--trace", help="Usage trace JSON file")
+    parser.add_argument("--commands-per-hour", type=float, default=20.0)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--policy", choices=sorted(POLICIES), action="append",
+                        help="Policy to evaluate (repeatable, default: all)")
+    parser.add_argument("--radio", choices=sorted(RADIO_POLICIES), action="append",
+                        help="Radio policy to evaluate (repeatable, default: all)")
+    parser.add_argument("--sweep", action="store_true", help="Also list idle draw and wait per listen interval")
+    args = parser.parse_args()
+
+    if args.trace:
+        with open(args.trace, "r", encoding="utf-8") as f:
+            trace = json.load(f)
+    else:
+        trace = generate_trace(args.commands_per_hour, args.seed)
+
+    report(trace, args.policy or list(POLICIES))
+    report_radio(trace, args.radio or list(RADIO_POLICIES), args.seed, args.sweep)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
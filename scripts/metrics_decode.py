@@ -0,0 +1,140 @@
+"""
+Decode binary metrics snapshots sent by the firmware
+
+Metrics::writeSnapshot() is triggered by sending 'm' over serial. Capture the
+raw serial bytes to a file and pass it here; metric names are read from the
+X-macro lists in src/firmware/utils/metrics.cpp so the two never drift apart.
+
+Usage:
+    python scripts/metrics_decode.py capture.bin
+"""
+
+import argparse
+import os
+import re
+import sys
+
+METRICS_SOURCE = os.path.join(os.path.dirname(__file__), "..", "src", "firmware", "utils", "metrics.cpp")
+
+SUB_BITS = 3
+SUB_BUCKETS = 1 << SUB_BITS
+
+
+def load_metric_names(path):
+    """Return (counters, gauges, histograms) name lists in registry order"""
+    with open(path, "r", encoding="utf-8") as f:
+        source = f.read()
+
+    names = {}
+    for kind in ("COUNTERS", "GAUGES", "HISTOGRAMS"):
+        block = re.search(r"#define METRICS_%s\(X\)(.*?)\n\n" % kind, source, re.S)
+        entries = re.findall(r'X\(\s*\w+\s*,\s*"((?:[^"\\]|\\.)*)"', block.group(1)) if block else []
+        names[kind] = [e.replace('\\"', '"') for e in entries]
+    return names["COUNTERS"], names["GAUGES"], names["HISTOGRAMS"]
+
+
+def bucket_lower(bucket):
+    if bucket < SUB_BUCKETS:
+        return bucket
+    exp = bucket // SUB_BUCKETS + SUB_BITS - 1
+    return (SUB_BUCKETS | (bucket % SUB_BUCKETS)) << (exp - SUB_BITS)
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return value
+            shift += 7
+
+
+def find_snapshots(data):
+    """Yield payloads of every valid snapshot frame in a serial capture"""
+    pos = 0
+    while True:
+        pos = data.find(b"GM\x01", pos)
+        if pos < 0 or pos + 5 > len(data):
+            return
+        length = data[pos + 3] | (data[pos + 4] << 8)
+        end = pos + 5 + length
+        if end + 2 <= len(data):
+            payload = data[pos + 5:end]
+            if crc16(payload) == (data[end] << 8 | data[end + 1]):
+                yield payload
+                pos = end + 2
+                continue
+        pos += 1
+
+
+def decode(payload, names):
+    counter_names, gauge_names, histogram_names = names
+    r = Reader(payload)
+    uptime = r.varint()
+    n_counters, n_gauges, n_histograms = r.varint(), r.varint(), r.varint()
+
+    print(f"uptime {uptime / 1000:.1f} s")
+    for i in range(n_counters):
+        name = counter_names[i] if i < len(counter_names) else f"counter_{i}"
+        print(f"  {name} {r.varint()}")
+    for i in range(n_gauges):
+        z = r.varint()
+        name = gauge_names[i] if i < len(gauge_names) else f"gauge_{i}"
+        print(f"  {name} {(z >> 1) ^ -(z & 1)}")
+    for i in range(n_histograms):
+        name = histogram_names[i] if i < len(histogram_names) else f"histogram_{i}"
+        total, total_sum = r.varint(), r.varint()
+        buckets = []
+        for _ in range(r.byte()):
+            index = r.byte()
+            buckets.append((bucket_lower(index), r.varint()))
+        mean = total_sum / total if total else 0
+        print(f"  {name} count={total} mean={mean:.1f}")
+        for lower, count in buckets:
+            print(f"    >= {lower:<10} {count}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode firmware binary metrics snapshots")
+    parser.add_argument("capture", help="Raw serial capture containing snapshots")
+    args = parser.parse_args()
+
+    names = load_metric_names(METRICS_SOURCE)
+    with open(args.capture, "rb") as f:
+        data = f.read()
+
+    found = 0
+    for payload in find_snapshots(data):
+        found += 1
+        decode(payload, names)
+
+    if not found:
+        print("No metrics snapshots found")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,110 @@
+"""
+Provision a pair of glasses with TLS credentials
+
+Makes a PSK identity and a random 32-byte key for one device and writes the
+NVS partition contents the firmware reads them from (namespace "tls", see
+TlsCredentials in src/firmware/modules/tls_transport.cpp) as the CSV that
+ESP-IDF's nvs_partition_gen.py turns into an image. The server's side of the
+key is appended to a secrets file, one "identity:hexkey" line per device, as
+openssl s_server -psk_identity/-psk and most TLS terminators take it.
+
+With --ca the server's CA certificate goes into the same namespace, for when
+the server cannot do ECDHE-PSK and the device falls back to checking its
+certificate.
+
+Usage:
+    python scripts/provision_psk.py --mac 24:0a:c4:00:00:01 --out nvs.csv --secrets psk_secrets.txt
+    python scripts/provision_psk.py --mac 24:0a:c4:00:00:01 --out nvs.csv --secrets psk_secrets.txt --ca cert.pem
+"""
+
+import argparse
+import os
+import re
+import secrets
+import sys
+
+NAMESPACE = "tls"
+IDENTITY_MAX = 32
+KEY_BYTES = 32
+CA_MAX = 4096
+
+# partitions_ab.csv
+NVS_OFFSET = "0x9000"
+NVS_SIZE = "0x5000"
+
+
+def identity_for(mac):
+    digits = re.sub(r"[^0-9a-fA-F]", "", mac).lower()
+    if len(digits) != 12:
+        raise ValueError("MAC address needs 12 hex digits: %s" % mac)
+    return "glasses-" + digits
+
+
+def read_secrets(path):
+    """Return {identity: hexkey} from an existing secrets file"""
+    entries = {}
+    if not os.path.exists(path):
+        return entries
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith("#") and ":" in line:
+                identity, key = line.split(":", 1)
+                entries[identity] = key
+    return entries
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Make TLS PSK credentials for one pair of glasses")
+    parser.add_argument("--mac", required=True, help="Wi-Fi MAC address of the device")
+    parser.add_argument("--out", required=True, help="NVS CSV to write, for nvs_partition_gen.py")
+    parser.add_argument("--secrets", required=True, help="Server's PSK file to append identity:hexkey to")
+    parser.add_argument("--ca", help="PEM file of the server's CA certificate, stored as well")
+    parser.add_argument("--force", action="store_true", help="Replace a key the secrets file already has")
+    args = parser.parse_args()
+
+    try:
+        identity = identity_for(args.mac)
+    except ValueError as e:
+        print(e)
+        return 2
+    assert len(identity) <= IDENTITY_MAX
+
+    existing = read_secrets(args.secrets)
+    if identity in existing and not args.force:
+        print("%s already has a key in %s (use --force to replace it)" % (identity, args.secrets))
+        return 1
+
+    rows = ["key,type,encoding,value", "%s,namespace,," % NAMESPACE]
+    key = secrets.token_bytes(KEY_BYTES)
+    rows.append("identity,data,string,%s" % identity)
+    rows.append("psk,data,hex2bin,%s" % key.hex())
+    if args.ca:
+        with open(args.ca, "r", encoding="utf-8") as f:
+            pem = f.read()
+        if "-----BEGIN CERTIFICATE-----" not in pem or len(pem) > CA_MAX:
+            print("%s is not a PEM certificate of at most %d bytes" % (args.ca, CA_MAX))
+            return 2
+        rows.append("ca,file,binary,%s" % os.path.abspath(args.ca))
+
+    with open(args.out, "w", encoding="utf-8") as f:
+        f.write("\n".join(rows) + "\n")
+
+    existing[identity] = key.hex()
+    with open(args.secrets, "w", encoding="utf-8") as f:
+        for name, value in existing.items():
+            f.write("%s:%s\n" % (name, value))
+    if os.name == "posix":
+        os.chmod(args.secrets, 0o600)
+
+    image = os.path.splitext(args.out)[0] + ".bin"
+    print("Identity %s, key written to %s" % (identity, args.secrets))
+    print("Flash it with:")
+    print("  python $IDF_PATH/components/nvs_flash/nvs_partition_generator/nvs_partition_gen.py "
+          "generate %s %s %s" % (args.out, image, NVS_SIZE))
+    print("  esptool.py --chip esp32s3 write_flash %s %s" % (NVS_OFFSET, image))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,498 @@
+"""
+Stand-in for the glasses server, for load tests without models or a GPU
+
+Serves the routes the firmware calls (POST / for commands, /audio,
+/vision/describe, /telemetry/metrics, GET /ota/update) plus the real server's /health,
+/chat/query and the /ws and /chat/ws WebSockets. Model calls are replaced by log-normal delays, and
+only --workers of them run at a time, so the server saturates the way a
+single inference box does. Standard library only.
+
+/ota/update serves the packages in --ota-dir (made with the native_ota
+program's pack command): 204 when the device runs the newest version, else
+a delta from the device's version when there is one and it accepts deltas,
+else the full image.
+
+For the glasses' response cache, the final audio chunk is answered with a
+transcript drawn from a few stock questions, command answers carry
+Cache-Control: max-age=--cache-ttl (no-store at 0), and every response a
+Date. POST /cache/invalidate with {"transcripts": [...]} or {"all": true}
+puts the keys (cache_key(), as firmware/utils/response_cache.cpp computes
+them) in an X-Cache-Invalidate header on every response for the next
+--invalidate-window seconds, which covers each device's minutely metrics
+push.
+
+/vision/describe takes the multipart body the glasses send (a JPEG in
+field image_file, X-Vision-Region for a crop) and answers 400 when the
+field is missing or is not a JPEG.
+
+GET /mux with Upgrade: glasses-mux/1 switches the connection to the
+glasses' stream multiplexer (firmware/utils/stream_mux.cpp): every stream
+is one request, routed as it would be over HTTP, and a RESET from the
+glasses cancels its model call.
+
+Usage:
+    python scripts/standin_server.py
+    python scripts/standin_server.py --port 8000 --workers 4 --command-ms 600 --audio-ms 900
+    python scripts/standin_server.py --ota-dir build/ota
+    curl -d '{"transcripts": ["Where are the M6 bolts?"]}' http://127.0.0.1:8000/cache/invalidate
+    .pio/build/native_load/program --server http://127.0.0.1:8000 --ramp 50,100,200
+"""
+
+import argparse
+import asyncio
+import base64
+import email.utils
+import hashlib
+import json
+import pathlib
+import random
+import signal
+import struct
+import sys
+import time
+
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+# Stream multiplexer frames, as in firmware/utils/stream_mux.cpp
+MUX_HEADERS, MUX_DATA, MUX_CREDIT, MUX_RESET, MUX_PING, MUX_PONG, MUX_GOAWAY = range(1, 8)
+MUX_END = 0x01
+MUX_MAX_PAYLOAD = 4096
+MUX_STREAM_WINDOW = 16384
+MUX_CONNECTION_WINDOW = 65536
+MUX_PROTOCOL_ERROR = 3
+
+STATUS_TEXT = {200: "OK", 204: "No Content", 400: "Bad Request", 404: "Not Found"}
+
+# Transcripts for final audio chunks, most asked first
+QUESTIONS = [
+    "Where are the M6 bolts?",
+    "What is the part number for the hinge bracket?",
+    "How do I get to loading bay two?",
+    "What time is it?",
+    "Is the blue forklift charged?",
+    "Who is on shift at the front desk?",
+]
+
+FILLERS = {"um", "uh", "please"}
+
+
+def cache_key(transcript):
+    """64-bit FNV-1a of the normalized transcript, as the glasses key their cache"""
+    words, word = [], bytearray()
+    for byte in transcript.encode("utf-8") + b" ":
+        if byte >= 0x80 or chr(byte).isalnum():
+            word.append(byte)
+        elif word:
+            words.append(bytes(word))
+            word = bytearray()
+    text = b" ".join(w.lower() for w in words if w.lower().decode("utf-8", "replace") not in FILLERS)
+    value = 0xcbf29ce484222325
+    for byte in text:
+        value = ((value ^ byte) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return f"{value:016x}"
+
+# UpdateHeader in firmware/utils/update_stream.cpp
+UPDATE_HEADER = struct.Struct("<4sBBBBIII32s32s16s")
+UPDATE_DELTA = 1
+
+
+def version_key(version):
+    """v1.10.0 sorts after v1.9.3"""
+    return tuple(int(part) if part.isdigit() else 0 for part in version.lstrip("v").split("."))
+
+
+def load_updates(directory):
+    """Index update packages by version: {"full": package, "deltas": {base version: package}}"""
+    packages = []
+    for path in sorted(pathlib.Path(directory).glob("*.bin")):
+        data = path.read_bytes()
+        if len(data) < UPDATE_HEADER.size:
+            continue
+        magic, _, flags, _, _, _, _, _, target_sha, base_sha, version = UPDATE_HEADER.unpack_from(data)
+        if magic != b"GOTA":
+            continue
+        packages.append((version.rstrip(b"\0").decode(), flags, target_sha, base_sha, data))
+
+    # A delta names its base by hash; the full package with that hash gives the version
+    versions = {target_sha: version for version, flags, target_sha, _, _ in packages if not flags & UPDATE_DELTA}
+    updates = {}
+    for version, flags, _, base_sha, data in packages:
+        entry = updates.setdefault(version, {"full": None, "deltas": {}})
+        if not flags & UPDATE_DELTA:
+            entry["full"] = data
+        elif base_sha in versions:
+            entry["deltas"][versions[base_sha]] = data
+    return {version: entry for version, entry in updates.items() if entry["full"]}
+
+
+def multipart_field(headers, body, name):
+    """Content of the multipart/form-data part called name, or None"""
+    content_type = headers.get("content-type", "")
+    if not content_type.startswith("multipart/form-data") or "boundary=" not in content_type:
+        return None
+    boundary = b"--" + content_type.split("boundary=", 1)[1].strip().strip('"').encode()
+    for part in (body or b"").split(boundary)[1:]:
+        head, separator, content = part.partition(b"\r\n\r\n")
+        if separator and f'name="{name}"'.encode() in head:
+            return content[:-2] if content.endswith(b"\r\n") else content
+    return None
+
+
+class StandIn:
+    def __init__(self, args):
+        self.args = args
+        self.workers = asyncio.Semaphore(args.workers)
+        self.rng = random.Random(args.seed)
+        self.counts = {}
+        self.started = time.monotonic()
+        self.updates = load_updates(args.ota_dir) if args.ota_dir else {}
+        self.questions = random.Random(args.seed + 1)
+        self.invalidations = []     # (expiry, keys)
+
+    async def model_call(self, median_ms):
+        """Hold one worker for a log-normal service time"""
+        async with self.workers:
+            await asyncio.sleep(self.rng.lognormvariate(0.0, self.args.sigma) * median_ms / 1000.0)
+
+    def count(self, route):
+        self.counts[route] = self.counts.get(route, 0) + 1
+
+    async def route(self, method, path, body, headers=None):
+        """Return (status, content type, body bytes) for one HTTP request"""
+        self.count(f"{method} {path}")
+        if method == "GET" and path == "/health":
+            return 200, "application/json", b'{"status":"healthy"}'
+        if method == "POST" and path == "/":
+            try:
+                command = json.loads(body or b"{}").get("command", "")
+            except ValueError:
+                return 400, "application/json", b'{"detail":"invalid json"}'
+            await self.model_call(self.args.command_ms)
+            reply = {"response": f"Stand-in answer to '{command}'"}
+            ttl = self.args.cache_ttl
+            cache_control = f"max-age={ttl:.0f}" if ttl > 0 else "no-store"
+            return 200, "application/json", json.dumps(reply).encode(), {"Cache-Control": cache_control}
+        if method == "POST" and path == "/chat/query":
+            await self.model_call(self.args.command_ms)
+            return 200, "application/json", b'{"response":"Stand-in answer"}'
+        if method == "POST" and path in ("/audio", "/audio/process"):
+            # Chunked uploads (X-Audio-Final: 0) are acknowledged at once;
+            # only the final chunk waits for transcription
+            if (headers or {}).get("x-audio-final") == "0":
+                return 200, "application/json", b'{"status":"partial"}'
+            await self.model_call(self.args.audio_ms)
+            question = QUESTIONS[min(int(self.questions.expovariate(0.7)), len(QUESTIONS) - 1)]
+            return 200, "application/json", json.dumps({"status": "ok", "transcript": question}).encode()
+        if method == "POST" and path in ("/vision/describe", "/vision/process"):
+            image = multipart_field(headers or {}, body, "image_file")
+            if image is None or not image.startswith(b"\xff\xd8") or not image.endswith(b"\xff\xd9"):
+                return 400, "application/json", b'{"detail":"image_file must be a JPEG"}'
+            await self.model_call(self.args.vision_ms)
+            region = (headers or {}).get("x-vision-region", "")
+            where = f" in region {region}" if region else ""
+            if path == "/vision/process":
+                return 200, "application/json", json.dumps({"detections": [], "bytes": len(image)}).encode()
+            reply = {"description": f"Stand-in description of {len(image)} bytes of JPEG{where}"}
+            return 200, "application/json", json.dumps(reply).encode()
+        if method == "POST" and path == "/cache/invalidate":
+            try:
+                request = json.loads(body or b"{}")
+            except ValueError:
+                return 400, "application/json", b'{"detail":"invalid json"}'
+            keys = ["*"] if request.get("all") else [cache_key(t) for t in request.get("transcripts", [])]
+            self.invalidations.append((time.monotonic() + self.args.invalidate_window, keys))
+            return 200, "application/json", json.dumps({"keys": keys}).encode()
+        if method == "POST" and path == "/telemetry/metrics":
+            return 200, "application/json", b'{"status":"ok"}'
+        if method == "GET" and path == "/ota/update":
+            return self.update(headers or {})
+        return 404, "application/json", b'{"detail":"Not Found"}'
+
+    def update(self, headers):
+        """Newest package for the device's version, 204 when it is current"""
+        if not self.updates:
+            return 204, "application/octet-stream", b""
+        latest = max(self.updates, key=version_key)
+        running = headers.get("x-firmware-version", "")
+        if running == latest:
+            return 204, "application/octet-stream", b""
+        entry = self.updates[latest]
+        if headers.get("x-accept-delta") == "1" and running in entry["deltas"]:
+            self.count("GET /ota/update delta")
+            return 200, "application/octet-stream", entry["deltas"][running]
+        self.count("GET /ota/update full")
+        return 200, "application/octet-stream", entry["full"]
+
+    async def handle(self, reader, writer):
+        try:
+            while True:
+                request_line = await reader.readline()
+                if not request_line:
+                    break
+                method, target, _ = request_line.decode("latin-1").split(" ", 2)
+                headers = {}
+                while True:
+                    line = await reader.readline()
+                    if line in (b"\r\n", b"\n", b""):
+                        break
+                    name, _, value = line.decode("latin-1").partition(":")
+                    headers[name.strip().lower()] = value.strip()
+                path = target.split("?", 1)[0]
+
+                if headers.get("upgrade", "").lower() == "websocket":
+                    if path in ("/ws", "/chat/ws"):
+                        await self.websocket(reader, writer, headers)
+                    break
+                if path == "/mux" and headers.get("upgrade", "").lower().startswith("glasses-mux"):
+                    await self.mux(reader, writer)
+                    break
+
+                length = int(headers.get("content-length", "0"))
+                body = await reader.readexactly(length) if length else b""
+                status, content_type, payload, *extra = await self.route(method, path, body, headers)
+                extra_headers = self.reply_headers(extra)
+                keep_alive = headers.get("connection", "").lower() != "close"
+                head = (
+                    f"HTTP/1.1 {status} {STATUS_TEXT.get(status, 'Error')}\r\n"
+                    f"Content-Type: {content_type}\r\n"
+                    f"Content-Length: {len(payload)}\r\n"
+                    + "".join(f"{name}: {value}\r\n" for name, value in extra_headers.items()) +
+                    f"Connection: {'keep-alive' if keep_alive else 'close'}\r\n\r\n")
+                writer.write(head.encode() + payload)
+                await writer.drain()
+                if not keep_alive:
+                    break
+        except (asyncio.IncompleteReadError, ConnectionError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+    def reply_headers(self, extra):
+        """Route's extra headers plus Date and any pending X-Cache-Invalidate"""
+        headers = dict(extra[0]) if extra else {}
+        headers["Date"] = email.utils.formatdate(usegmt=True)
+        invalidate = self.pending_invalidations()
+        if invalidate:
+            headers["X-Cache-Invalidate"] = invalidate
+        return headers
+
+    async def mux(self, reader, writer):
+        """Stream multiplexer peer: one request per stream, credited as it arrives"""
+        writer.write(b"HTTP/1.1 101 Switching Protocols\r\nUpgrade: glasses-mux/1\r\nConnection: Upgrade\r\n\r\n")
+        await writer.drain()
+        self.count("MUX connect")
+        streams = {}        # id -> request being received or served
+        credit = {}         # id -> what the glasses still take of its reply
+        connection = {"credit": MUX_CONNECTION_WINDOW, "window": MUX_CONNECTION_WINDOW, "owed": 0}
+        credited = asyncio.Event()
+        last = 0
+
+        def send(kind, stream, payload=b"", flags=0):
+            writer.write(struct.pack(">BBHH", kind, flags, stream, len(payload)) + payload)
+
+        async def serve_stream(stream, entry):
+            status, content_type, payload, *extra = await self.route(
+                entry["method"], entry["path"], bytes(entry["body"]), entry["headers"])
+            headers = {"Content-Type": content_type, **self.reply_headers(extra)}
+            head = f"{status}\r\n" + "".join(f"{name}: {value}\r\n" for name, value in headers.items())
+            send(MUX_HEADERS, stream, bytes([0]) + head.encode("latin-1"), 0 if payload else MUX_END)
+            credit[stream] = MUX_STREAM_WINDOW
+            offset = 0
+            while offset < len(payload):
+                while min(credit[stream], connection["credit"]) <= 0:
+                    credited.clear()
+                    await credited.wait()
+                size = min(len(payload) - offset, MUX_MAX_PAYLOAD, credit[stream], connection["credit"])
+                credit[stream] -= size
+                connection["credit"] -= size
+                offset += size
+                send(MUX_DATA, stream, payload[offset - size:offset], MUX_END if offset == len(payload) else 0)
+            await writer.drain()
+            streams.pop(stream, None)
+            credit.pop(stream, None)
+
+        def start(stream):
+            entry = streams[stream]
+            entry["task"] = asyncio.ensure_future(serve_stream(stream, entry))
+
+        try:
+            while True:
+                kind, flags, stream, length = struct.unpack(">BBHH", await reader.readexactly(6))
+                if length > MUX_MAX_PAYLOAD:
+                    break
+                payload = await reader.readexactly(length)
+                end = flags & MUX_END
+                if kind == MUX_HEADERS:
+                    if stream % 2 == 0 or stream <= last or not payload:
+                        break
+                    last = stream
+                    request_line, *lines = payload[1:].decode("latin-1").split("\r\n")
+                    method, _, target = request_line.partition(" ")
+                    headers = {}
+                    for line in lines:
+                        name, _, value = line.partition(":")
+                        if name:
+                            headers[name.strip().lower()] = value.strip()
+                    streams[stream] = {"method": method, "path": target.split("?", 1)[0], "headers": headers,
+                                       "body": bytearray(), "window": MUX_STREAM_WINDOW, "owed": 0, "task": None}
+                    self.count("MUX stream")
+                    if end:
+                        start(stream)
+                elif kind == MUX_DATA:
+                    if length > connection["window"]:
+                        break
+                    connection["window"] -= length
+                    connection["owed"] += length
+                    if connection["owed"] >= MUX_CONNECTION_WINDOW // 4:
+                        send(MUX_CREDIT, 0, struct.pack(">I", connection["owed"]))
+                        connection["window"] += connection["owed"]
+                        connection["owed"] = 0
+                    entry = streams.get(stream)
+                    if entry is None or entry["task"] is not None:
+                        continue    # Reset, or a stream already ended
+                    if length > entry["window"]:
+                        break
+                    entry["window"] -= length
+                    entry["body"] += payload
+                    if end:
+                        start(stream)
+                        continue
+                    entry["owed"] += length
+                    if entry["owed"] >= MUX_STREAM_WINDOW // 4:
+                        send(MUX_CREDIT, stream, struct.pack(">I", entry["owed"]))
+                        entry["window"] += entry["owed"]
+                        entry["owed"] = 0
+                elif kind == MUX_CREDIT and length == 4:
+                    increment = struct.unpack(">I", payload)[0]
+                    if stream == 0:
+                        connection["credit"] += increment
+                    elif stream in credit:
+                        credit[stream] += increment
+                    credited.set()
+                elif kind == MUX_RESET:
+                    entry = streams.pop(stream, None)
+                    credit.pop(stream, None)
+                    if entry is not None:
+                        self.count("MUX reset")
+                        if entry["task"] is not None:
+                            entry["task"].cancel()
+                elif kind == MUX_PING and length == 4:
+                    send(MUX_PONG, 0, payload)
+                elif kind == MUX_GOAWAY:
+                    return
+                await writer.drain()
+            # Broke the protocol
+            send(MUX_GOAWAY, 0, bytes([MUX_PROTOCOL_ERROR]))
+            await writer.drain()
+        finally:
+            for entry in streams.values():
+                if entry["task"] is not None:
+                    entry["task"].cancel()
+
+    async def websocket(self, reader, writer, headers):
+        """RFC 6455 echo of model answers: one text reply per text message"""
+        key = headers.get("sec-websocket-key", "")
+        accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+        writer.write(
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+            f"Sec-WebSocket-Accept: {accept}\r\n\r\n".encode())
+        await writer.drain()
+        self.count("WS connect")
+
+        while True:
+            head = await reader.readexactly(2)
+            opcode = head[0] & 0x0F
+            masked = head[1] & 0x80
+            length = head[1] & 0x7F
+            if length == 126:
+                length = struct.unpack(">H", await reader.readexactly(2))[0]
+            elif length == 127:
+                length = struct.unpack(">Q", await reader.readexactly(8))[0]
+            mask = await reader.readexactly(4) if masked else b"\0\0\0\0"
+            data = bytes(b ^ mask[i % 4] for i, b in enumerate(await reader.readexactly(length)))
+
+            if opcode == 0x8:
+                writer.write(b"\x88\x00")
+                await writer.drain()
+                return
+            if opcode == 0x9:
+                writer.write(self.frame(0xA, data))
+                await writer.drain()
+                continue
+            if opcode != 0x1:
+                continue
+
+            self.count("WS message")
+            await self.model_call(self.args.command_ms)
+            writer.write(self.frame(0x1, f"Stand-in answer to '{data.decode(errors='replace')}'".encode()))
+            await writer.drain()
+
+    def pending_invalidations(self):
+        """X-Cache-Invalidate value for a response now, empty when none are pending"""
+        now = time.monotonic()
+        self.invalidations = [(expiry, keys) for expiry, keys in self.invalidations if expiry > now]
+        keys = [key for _, batch in self.invalidations for key in batch]
+        return "*" if "*" in keys else ",".join(dict.fromkeys(keys))
+
+    @staticmethod
+    def frame(opcode, payload):
+        """Unmasked server frame"""
+        if len(payload) < 126:
+            header = struct.pack(">BB", 0x80 | opcode, len(payload))
+        elif len(payload) < 65536:
+            header = struct.pack(">BBH", 0x80 | opcode, 126, len(payload))
+        else:
+            header = struct.pack(">BBQ", 0x80 | opcode, 127, len(payload))
+        return header + payload
+
+    def summary(self):
+        elapsed = time.monotonic() - self.started
+        lines = [f"Served for {elapsed:.0f} s"]
+        for route, n in sorted(self.counts.items()):
+            lines.append(f"  {route:<28} {n:>8}  {n / max(elapsed, 1e-9):8.2f}/s")
+        return "\n".join(lines)
+
+
+async def serve(args):
+    standin = StandIn(args)
+    server = await asyncio.start_server(standin.handle, args.host, args.port, backlog=1024)
+    print(f"Stand-in listening on http://{args.host}:{args.port} "
+          f"({args.workers} workers, command {args.command_ms:.0f} ms, audio {args.audio_ms:.0f} ms)",
+          file=sys.stderr)
+    stop = asyncio.Event()
+    for sig in (signal.SIGINT, signal.SIGTERM):
+        try:
+            asyncio.get_running_loop().add_signal_handler(sig, stop.set)
+        except NotImplementedError:
+            pass  # Windows: Ctrl+C still ends the run, without the summary
+    async with server:
+        await stop.wait()
+    print(standin.summary(), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in glasses server for load tests")
+    parser.add_argument("--host", default="127.0.0.1", help="Address to listen on")
+    parser.add_argument("--port", type=int, default=8000, help="Port to listen on")
+    parser.add_argument("--workers", type=int, default=4, help="Model calls served at the same time")
+    parser.add_argument("--command-ms", type=float, default=600.0, help="Median command/chat service time")
+    parser.add_argument("--audio-ms", type=float, default=900.0, help="Median audio processing time")
+    parser.add_argument("--vision-ms", type=float, default=700.0, help="Median image description time")
+    parser.add_argument("--sigma", type=float, default=0.35, help="Log-normal spread of service times")
+    parser.add_argument("--seed", type=int, default=1, help="Random seed for service times")
+    parser.add_argument("--ota-dir", help="Directory of firmware update packages for /ota/update")
+    parser.add_argument("--cache-ttl", type=float, default=3600.0, help="max-age of command answers, 0 for no-store")
+    parser.add_argument("--invalidate-window", type=float, default=600.0,
+                        help="Seconds an invalidation is repeated on every response")
+    args = parser.parse_args()
+
+    try:
+        asyncio.run(serve(args))
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,96 @@
+"""
+Per-stage latency statistics for firmware traces
+
+Reads a serial capture (or a plain trace JSON file) produced by
+Tracer::exportChromeJson() and prints p50/p95/p99 for every pipeline stage.
+
+Usage:
+    python scripts/trace_stats.py serial_log.txt
+    python scripts/trace_stats.py serial_log.txt --out trace.json
+"""
+
+import argparse
+import json
+import math
+import sys
+
+
+def extract_traces(text):
+    """Return every trace JSON document found in the input text"""
+    if "TRACE_BEGIN" not in text:
+        return [json.loads(text)]
+
+    traces = []
+    block = None
+    for line in text.splitlines():
+        line = line.strip()
+        if line == "TRACE_BEGIN":
+            block = []
+        elif line == "TRACE_END" and block is not None:
+            traces.append(json.loads("\n".join(block)))
+            block = None
+        elif block is not None:
+            block.append(line)
+    return traces
+
+
+def percentile(sorted_values, p):
+    """Nearest-rank percentile of an already sorted list"""
+    if not sorted_values:
+        return 0.0
+    rank = max(1, math.ceil(p / 100.0 * len(sorted_values)))
+    return sorted_values[rank - 1]
+
+
+def stage_durations(traces):
+    """Group complete ("X") events by stage name, durations in microseconds"""
+    stages = {}
+    for trace in traces:
+        for event in trace.get("traceEvents", []):
+            if event.get("ph") != "X":
+                continue
+            stages.setdefault(event["name"], []).append(float(event["dur"]))
+    return stages
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-stage latency percentiles from firmware traces")
+    parser.add_argument("input", help="Serial log or trace JSON file")
+    parser.add_argument("--out", help="Write merged Chrome trace JSON to this file")
+    args = parser.parse_args()
+
+    with open(args.input, "r", encoding="utf-8", errors="replace") as f:
+        traces = extract_traces(f.read())
+
+    if not traces:
+        print("No traces found in input")
+        return 1
+
+    stages = stage_durations(traces)
+    dropped = sum(t.get("otherData", {}).get("dropped", 0) for t in traces)
+
+    print(f"{'stage':<12} {'count':>6} {'p50 ms':>9} {'p95 ms':>9} {'p99 ms':>9} {'max ms':>9}")
+    for name, durations in sorted(stages.items()):
+        durations.sort()
+        print(f"{name:<12} {len(durations):>6} "
+              f"{percentile(durations, 50) / 1000:>9.2f} "
+              f"{percentile(durations, 95) / 1000:>9.2f} "
+              f"{percentile(durations, 99) / 1000:>9.2f} "
+              f"{durations[-1] / 1000:>9.2f}")
+
+    if dropped:
+        print(f"Warning: {dropped} spans were dropped (no free trace ring)")
+
+    if args.out:
+        merged = {"displayTimeUnit": "ms", "traceEvents": []}
+        for trace in traces:
+            merged["traceEvents"].extend(trace.get("traceEvents", []))
+        with open(args.out, "w", encoding="utf-8") as f:
+            json.dump(merged, f)
+        print(f"Wrote {len(merged['traceEvents'])} events to {args.out}")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,35 @@
+// Generated by scripts/asset_pack.py from assets/assets.txt; do not edit
+#ifndef ASSET_IDS_H
+#define ASSET_IDS_H
+
+#include <stdint.h>
+
+// Hash of the manifest's ids and types; the pack must carry the same
+#define ASSET_SCHEMA 0xCA196358u
+
+enum AssetId : uint16_t {
+    FONT_UI = 0,
+    ICON_BATTERY_LOW = 1,
+    ICON_WARNING = 2,
+    ICON_WIFI_OFF = 3,
+    ICON_MIC = 4,
+    ICON_CHECK = 5,
+    PROMPT_LISTENING = 6,
+    PROMPT_THINKING = 7,
+    PROMPT_DONE = 8,
+    PROMPT_ERROR = 9,
+    PROMPT_LOW_BATTERY = 10,
+    COMMAND_MUTE_1 = 11,
+    COMMAND_MUTE_2 = 12,
+    COMMAND_UNMUTE_1 = 13,
+    COMMAND_UNMUTE_2 = 14,
+    COMMAND_DISPLAY_OFF_1 = 15,
+    COMMAND_DISPLAY_OFF_2 = 16,
+    COMMAND_DISPLAY_ON_1 = 17,
+    COMMAND_DISPLAY_ON_2 = 18,
+    COMMAND_BATTERY_1 = 19,
+    COMMAND_BATTERY_2 = 20,
+    ASSET_COUNT = 21
+};
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef BOARD_PROFILE_H
+#define BOARD_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compile-time board profiles.
+// A profile is a struct of constexpr pins and parameters, one nested struct
+// per peripheral. Drivers read them through `Board`, so every pin is a
+// constant at its call site. checkProfile<>() turns wiring mistakes (one GPIO
+// used twice, a flash or USB pin, battery sensing off ADC1) into
+// static_assert failures instead of a board that silently misbehaves.
+//
+// Pick a profile with -DBOARD_PROFILE_<NAME>; the glasses are the default.
+// `pio run -e native_profiles` checks every profile on the host.
+
+static constexpr uint8_t NO_PIN = 0xFF;
+
+// ESP32-S3 pin capabilities the checks rely on
+namespace Esp32S3 {
+    constexpr bool exists(uint8_t pin) {
+        return pin <= 21 || (pin >= 26 && pin <= 48);
+    }
+
+    // GPIO26-32 run the SPI flash / PSRAM, as do 33-37 on octal-PSRAM modules
+    constexpr bool isFlashPin(uint8_t pin, bool octalPsram) {
+        return (pin >= 26 && pin <= 32) || (octalPsram && pin >= 33 && pin <= 37);
+    }
+
+    constexpr bool isUsbPin(uint8_t pin) {
+        return pin == 19 || pin == 20;
+    }
+
+    constexpr bool isTouchPin(uint8_t pin) {
+        return pin >= 1 && pin <= 14;
+    }
+
+    // ADC2 cannot convert while Wi-Fi is on, so anything sampled at runtime needs ADC1
+    constexpr bool isAdc1Pin(uint8_t pin) {
+        return pin >= 1 && pin <= 10;
+    }
+
+    // Sampled at reset; usable afterwards, but external pulls can change the boot mode
+    constexpr bool isStrappingPin(uint8_t pin) {
+        return pin == 0 || pin == 3 || pin == 45 || pin == 46;
+    }
+}
+
+// The glasses frame: ESP32-S3-WROOM-1 N16 (quad flash, no PSRAM)
+struct GlassesV1Profile {
+    static constexpr const char* NAME = "glasses_v1";
+    static constexpr bool PSRAM = false;
+    static constexpr bool OCTAL_PSRAM = false;
+    static constexpr bool NATIVE_USB = true;    // ARDUINO_USB_MODE=1 keeps GPIO19/20 on USB
+
+    struct I2c {
+        static constexpr uint8_t SDA = 17;
+        static constexpr uint8_t SCL = 18;
+        static constexpr uint32_t FREQUENCY = 400000;
+    };
+
+    struct Display {
+        static constexpr uint8_t ADDRESS = 0x3C;
+        static constexpr uint8_t WIDTH = 128;
+        static constexpr uint8_t HEIGHT = 32;
+    };
+
+    // INMP441-style MEMS microphone, left channel, 24-bit data in 32-bit slots
+    struct Mic {
+        static constexpr uint8_t BCLK = 2;
+        static constexpr uint8_t WS = 15;
+        static constexpr uint8_t DIN = 13;
+        static constexpr uint32_t SAMPLE_RATE = 16000;  // After decimation
+        static constexpr uint8_t DECIMATION = 1;        // Capture at SAMPLE_RATE x DECIMATION (1-3)
+        static constexpr int16_t GAIN_Q8 = 256;         // Applied after DC removal, 256 = 1.0
+        static constexpr size_t DMA_BUF_LEN = 512;      // Frames per DMA buffer (4 bytes per channel)
+        static constexpr uint8_t DMA_BUF_COUNT = 8;
+        static constexpr uint8_t CHANNELS = 1;          // Mics sharing DIN; 2+ enables the beamformer
+        static constexpr uint16_t MOUTH_DELAY_US = 0;   // Mouth arrival delay between adjacent mics
+    };
+
+    // MAX98357A I2S amplifier driving the bone conduction transducer, 16-bit
+    // mono. A prompt waits behind at most DMA_BUF_COUNT + 1 buffers of queued
+    // output: (3 + 1) x 64 frames at 16 kHz is 16 ms.
+    struct Speaker {
+        static constexpr uint8_t BCLK = 6;
+        static constexpr uint8_t WS = 7;
+        static constexpr uint8_t DOUT = 16;
+        static constexpr uint32_t SAMPLE_RATE = 16000;
+        static constexpr size_t DMA_BUF_LEN = 64;       // Frames per DMA buffer
+        static constexpr uint8_t DMA_BUF_COUNT = 3;
+    };
+
+    struct Touch {
+        static constexpr uint8_t PIN = 8;
+        static constexpr uint16_t THRESHOLD = 40;
+    };
+
+    // One cell per temple, each behind a 1:2 divider
+    struct Battery {
+        static constexpr uint8_t PIN1 = 4;
+        static constexpr uint8_t PIN2 = 5;
+        static constexpr float DIVIDER = 2.0f;
+        static constexpr float LOW_PERCENT = 20.0f;
+        static constexpr float CRITICAL_PERCENT = 10.0f;
+    };
+
+    struct StatusLed {
+        static constexpr uint8_t PIN = 48;
+    };
+
+    // GPIO13 carries the microphone data, so there is no power button
+    struct Buttons {
+        static constexpr uint8_t POWER = NO_PIN;
+        static constexpr uint8_t MODE = 12;
+    };
+
+    // DVP camera module; its SCCB control port shares the I2C bus
+    struct Camera {
+        static constexpr bool PRESENT = false;
+        static constexpr uint8_t XCLK = NO_PIN;
+        static constexpr uint8_t PCLK = NO_PIN;
+        static constexpr uint8_t VSYNC = NO_PIN;
+        static constexpr uint8_t HREF = NO_PIN;
+        static constexpr uint8_t D0 = NO_PIN, D1 = NO_PIN, D2 = NO_PIN, D3 = NO_PIN;
+        static constexpr uint8_t D4 = NO_PIN, D5 = NO_PIN, D6 = NO_PIN, D7 = NO_PIN;
+        static constexpr uint32_t XCLK_HZ = 20000000;
+        static constexpr uint16_t WIDTH = 640;
+        static constexpr uint16_t HEIGHT = 480;
+        static constexpr uint8_t FB_COUNT = 2;          // YUV422 frame buffers in PSRAM
+        static constexpr uint8_t SCCB_ADDRESS = 0x30;   // OV2640
+    };
+};
+
+// ESP32-S3-DevKitC-1 (N8R8) on the bench: OLED module on the Arduino Wire
+// default pins and the BOOT button as the mode button
+struct DevKitC1Profile : GlassesV1Profile {
+    static constexpr const char* NAME = "devkitc1";
+    static constexpr bool PSRAM = true;
+    static constexpr bool OCTAL_PSRAM = true;
+
+    struct I2c {
+        static constexpr uint8_t SDA = 8;
+        static constexpr uint8_t SCL = 9;
+        static constexpr uint32_t FREQUENCY = 400000;
+    };
+
+    struct Display {
+        static constexpr uint8_t ADDRESS = 0x3C;
+        static constexpr uint8_t WIDTH = 128;
+        static constexpr uint8_t HEIGHT = 64;
+    };
+
+    struct Touch {
+        static constexpr uint8_t PIN = 14;
+        static constexpr uint16_t THRESHOLD = 40;
+    };
+
+    struct Buttons {
+        static constexpr uint8_t POWER = NO_PIN;
+        static constexpr uint8_t MODE = 0;
+    };
+};
+
+// Glasses frame with a second microphone 20 mm behind the first on the same
+// temple, for the delay-and-sum beamformer. The pair shares the I2S lines;
+// the rear mic has its L/R select pin tied high. The mouth sits about 40
+// degrees off the array axis: 20 mm x cos 40 / 343 m/s = 44 us.
+struct GlassesDualMicProfile : GlassesV1Profile {
+    static constexpr const char* NAME = "glasses_dualmic";
+
+    struct Mic : GlassesV1Profile::Mic {
+        static constexpr size_t DMA_BUF_LEN = 256;
+        static constexpr uint8_t DMA_BUF_COUNT = 16;
+        static constexpr uint8_t CHANNELS = 2;
+        static constexpr uint16_t MOUTH_DELAY_US = 44;
+    };
+};
+
+// Glasses frame with an OV2640 in the bridge, on an ESP32-S3-WROOM-1 N16R8
+// for the frame buffers. Octal PSRAM takes GPIO33-37, and the UART0 console
+// keeps GPIO43/44, which leaves exactly the twelve DVP lines free of the
+// strapping pins.
+struct GlassesCameraProfile : GlassesV1Profile {
+    static constexpr const char* NAME = "glasses_camera";
+    static constexpr bool PSRAM = true;
+    static constexpr bool OCTAL_PSRAM = true;
+
+    struct Camera : GlassesV1Profile::Camera {
+        static constexpr bool PRESENT = true;
+        static constexpr uint8_t XCLK = 10;
+        static constexpr uint8_t PCLK = 11;
+        static constexpr uint8_t VSYNC = 21;
+        static constexpr uint8_t HREF = 14;
+        static constexpr uint8_t D0 = 1, D1 = 9, D2 = 38, D3 = 39;
+        static constexpr uint8_t D4 = 40, D5 = 41, D6 = 42, D7 = 47;
+    };
+};
+
+template <typename... Profiles>
+struct ProfileList {};
+
+// Every profile the host check compiles
+using AllProfiles = ProfileList<GlassesV1Profile, DevKitC1Profile, GlassesDualMicProfile, GlassesCameraProfile>;
+
+#if defined(BOARD_PROFILE_DEVKITC1)
+using Board = DevKitC1Profile;
+#elif defined(BOARD_PROFILE_GLASSES_DUALMIC)
+using Board = GlassesDualMicProfile;
+#elif defined(BOARD_PROFILE_GLASSES_CAMERA)
+using Board = GlassesCameraProfile;
+#else
+using Board = GlassesV1Profile;
+#endif
+
+// ---------------------------------------------------------------- Checks
+
+template <typename P>
+struct ProfilePins {
+    static constexpr uint8_t ALL[] = {
+        P::I2c::SDA, P::I2c::SCL,
+        P::Mic::BCLK, P::Mic::WS, P::Mic::DIN,
+        P::Speaker::BCLK, P::Speaker::WS, P::Speaker::DOUT,
+        P::Touch::PIN,
+        P::Battery::PIN1, P::Battery::PIN2,
+        P::StatusLed::PIN,
+        P::Buttons::POWER, P::Buttons::MODE,
+        P::Camera::XCLK, P::Camera::PCLK, P::Camera::VSYNC, P::Camera::HREF,
+        P::Camera::D0, P::Camera::D1, P::Camera::D2, P::Camera::D3,
+        P::Camera::D4, P::Camera::D5, P::Camera::D6, P::Camera::D7
+    };
+    static constexpr size_t COUNT = sizeof(ALL) / sizeof(ALL[0]);
+
+    static constexpr bool usable(uint8_t pin) {
+        return pin == NO_PIN ||
+               (Esp32S3::exists(pin) &&
+                !Esp32S3::isFlashPin(pin, P::OCTAL_PSRAM) &&
+                !(P::NATIVE_USB && Esp32S3::isUsbPin(pin)));
+    }
+
+    static constexpr bool allUsable() {
+        for (size_t i = 0; i < COUNT; i++) {
+            if (!usable(ALL[i])) return false;
+        }
+        return true;
+    }
+
+    static constexpr bool allDistinct() {
+        for (size_t i = 0; i < COUNT; i++) {
+            for (size_t j = i + 1; j < COUNT; j++) {
+                if (ALL[i] != NO_PIN && ALL[i] == ALL[j]) return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <typename P>
+constexpr bool checkProfile() {
+    using Pins = ProfilePins<P>;
+    static_assert(Pins::allUsable(), "Board profile uses a GPIO that does not exist or belongs to flash, PSRAM or USB");
+    static_assert(Pins::allDistinct(), "Board profile assigns one GPIO to two functions");
+    static_assert(Esp32S3::isTouchPin(P::Touch::PIN), "Touch pad must be on a touch channel (GPIO1-14)");
+    static_assert(Esp32S3::isAdc1Pin(P::Battery::PIN1) && Esp32S3::isAdc1Pin(P::Battery::PIN2),
+                  "Battery sense pins must be on ADC1 (GPIO1-10); ADC2 is blocked while Wi-Fi is on");
+    static_assert(P::Mic::CHANNELS >= 1 && P::Mic::CHANNELS <= 4, "I2S capture takes 1-4 microphones (mono, stereo, TDM)");
+    static_assert(P::Mic::DMA_BUF_LEN >= 8 && P::Mic::DMA_BUF_LEN * 4 * P::Mic::CHANNELS <= 4092,
+                  "I2S DMA buffers hold at least 8 frames and at most 4092 bytes of 32-bit slots");
+    static_assert((uint64_t)P::Mic::MOUTH_DELAY_US * (P::Mic::CHANNELS - 1) * P::Mic::SAMPLE_RATE <= 3000000,
+                  "Beamformer steering delays span at most 3 samples");
+    static_assert(P::Mic::DMA_BUF_COUNT >= 2 && P::Mic::DMA_BUF_COUNT <= 128, "I2S needs 2-128 DMA buffers");
+    static_assert(P::Mic::DECIMATION >= 1 && P::Mic::DECIMATION <= 3, "The microphone front end decimates by 1-3");
+    static_assert(P::Mic::SAMPLE_RATE >= 8000 && P::Mic::SAMPLE_RATE * P::Mic::DECIMATION <= 48000,
+                  "Microphone sample rate must be 8-48 kHz, capture rate included");
+    static_assert(P::Speaker::DMA_BUF_COUNT >= 2 && P::Speaker::DMA_BUF_LEN >= 8 && P::Speaker::DMA_BUF_LEN * 2 <= 4092,
+                  "Speaker needs 2+ DMA buffers of 8 to 2046 16-bit frames");
+    static_assert((P::Speaker::DMA_BUF_COUNT + 1) * P::Speaker::DMA_BUF_LEN * 1000 <= 20 * P::Speaker::SAMPLE_RATE,
+                  "Queued speaker output must stay under the 20 ms prompt latency budget");
+    static_assert(P::I2c::FREQUENCY <= 1000000, "The S3 I2C controller tops out at 1 MHz");
+    static_assert(P::Display::ADDRESS == 0x3C || P::Display::ADDRESS == 0x3D, "SSD1306 answers on 0x3C or 0x3D");
+    static_assert(P::Display::WIDTH == 128 && (P::Display::HEIGHT == 32 || P::Display::HEIGHT == 64),
+                  "SSD1306 panels are 128x32 or 128x64");
+    static_assert(!P::Camera::PRESENT || P::Camera::SCCB_ADDRESS != P::Display::ADDRESS,
+                  "The camera's SCCB port and the display share the I2C bus");
+    static_assert(P::Battery::CRITICAL_PERCENT < P::Battery::LOW_PERCENT, "Critical battery level must be below low");
+    static_assert(!P::Camera::PRESENT || P::PSRAM, "Camera frame buffers need PSRAM");
+    static_assert(!P::Camera::PRESENT || (P::Camera::XCLK != NO_PIN && P::Camera::PCLK != NO_PIN &&
+                  P::Camera::VSYNC != NO_PIN && P::Camera::HREF != NO_PIN && P::Camera::D0 != NO_PIN &&
+                  P::Camera::D1 != NO_PIN && P::Camera::D2 != NO_PIN && P::Camera::D3 != NO_PIN &&
+                  P::Camera::D4 != NO_PIN && P::Camera::D5 != NO_PIN && P::Camera::D6 != NO_PIN &&
+                  P::Camera::D7 != NO_PIN), "A camera needs XCLK, PCLK, VSYNC, HREF and D0-D7");
+    static_assert(P::Camera::XCLK_HZ <= 20000000, "The S3's camera interface takes XCLK up to 20 MHz");
+    static_assert(P::Camera::WIDTH % 16 == 0 && P::Camera::HEIGHT % 16 == 0 && P::Camera::WIDTH <= 1600,
+                  "Camera frames are whole 16-pixel MCUs, at most UXGA");
+    static_assert(P::Camera::FB_COUNT >= 1 && P::Camera::FB_COUNT <= 3, "The camera takes 1-3 frame buffers");
+    return true;
+}
+
+template <typename... Profiles>
+constexpr bool checkProfiles(ProfileList<Profiles...>) {
+    return (checkProfile<Profiles>() && ...);
+}
+
+static_assert(checkProfile<Board>(), "Board profile check failed");
+
+#endif
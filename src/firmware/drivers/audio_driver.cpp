@@ -1,107 +1,485 @@
 #ifndef AUDIO_DRIVER_H
 #define AUDIO_DRIVER_H
 
-#include <driver/i2s.h>
-#include "kiss_fft.h"
+#include <freertos/stream_buffer.h>
+#include <freertos/semphr.h>
+#include "../config/board_profile.h"
+#include "../config/config.h"
+#include "../hal/i2s_hal.cpp"
 #include "../modules/network_module.cpp"
+#include "../utils/trace.cpp"
+#include "../utils/metrics.cpp"
+#include "../modules/power_manager.cpp"
+#include "../modules/radio_scheduler.cpp"
+#include "../dsp/wake_detector.cpp"
+#include "../dsp/mic_frontend.cpp"
+#include "../dsp/beamformer.cpp"
+#include "../dsp/speech_enhancer.cpp"
+#include "../dsp/audio_codec.cpp"
+#include "../dsp/intent_matcher.cpp"
+#include "prompt_player.cpp"
 
-#define I2S_WS 15
-#define I2S_SD 13
-#define I2S_SCK 2
-#define SAMPLE_RATE 16000
-#define BUFFER_SIZE 1024
+// Commands the glasses carry out themselves, recognized from the pack's
+// COMMAND_* recordings
+enum LocalIntent : uint8_t {
+    INTENT_NONE = 0,
+    INTENT_MUTE,
+    INTENT_UNMUTE,
+    INTENT_DISPLAY_OFF,
+    INTENT_DISPLAY_ON,
+    INTENT_BATTERY_LEVEL
+};
 
 class AudioDriver {
 public:
+    static constexpr uint32_t SAMPLE_RATE = Board::Mic::SAMPLE_RATE;
+    static constexpr uint32_t CAPTURE_RATE = SAMPLE_RATE * Board::Mic::DECIMATION;
+    static constexpr uint8_t MIC_CHANNELS = Board::Mic::CHANNELS;
+    static constexpr size_t BUFFER_SIZE = 1024;     // Samples per VAD read and per listener batch
+    
     bool begin() {
-        // Configure I2S for MEMS microphone
-        i2s_config_t i2s_config = {
-            .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-            .sample_rate = SAMPLE_RATE,
-            .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-            .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-            .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-            .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-            .dma_buf_count = 4,
-            .dma_buf_len = BUFFER_SIZE,
-            .use_apll = false
+        // MEMS microphones in 32-bit slots; the front end turns them into 16-bit
+        // PCM and, with more than one, the beamformer into one mouth-steered channel
+        I2sRxConfig config = {
+            .port = MIC_PORT,
+            .sampleRate = CAPTURE_RATE,
+            .bclk = Board::Mic::BCLK,
+            .ws = Board::Mic::WS,
+            .din = Board::Mic::DIN,
+            .dmaBufCount = Board::Mic::DMA_BUF_COUNT,
+            .dmaBufLen = Board::Mic::DMA_BUF_LEN,
+            .channels = MIC_CHANNELS
         };
         
-        i2s_pin_config_t pin_config = {
-            .bck_io_num = I2S_SCK,
-            .ws_io_num = I2S_WS,
-            .data_out_num = I2S_PIN_NO_CHANGE,
-            .data_in_num = I2S_SD
-        };
+        MicFrontEndConfig conditioning;
+        conditioning.channels = MIC_CHANNELS;
+        conditioning.decimation = Board::Mic::DECIMATION;
+        conditioning.gainQ8 = Board::Mic::GAIN_Q8;
+        frontEnd.configure(conditioning);
         
-        esp_err_t err = i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
-        if (err != ESP_OK) return false;
+        BeamformerConfig steering;
+        steering.channels = MIC_CHANNELS;
+        steering.sampleRate = SAMPLE_RATE;
+        steering.mouthDelayUs = Board::Mic::MOUTH_DELAY_US;
+        beamformer.configure(steering);
         
-        err = i2s_set_pin(I2S_NUM_0, &pin_config);
-        return err == ESP_OK;
+        SpeechEnhancerConfig enhancing;
+        enhancing.sampleRate = SAMPLE_RATE;
+        enhancer.configure(enhancing);
+        
+        return I2sHal::beginRx(config) == ESP_OK;
+    }
+    
+    // Low-power listening: a small task on core 0 reads whole DMA batches and runs
+    // the wake detector without holding a PM lock, so it executes at the minimum
+    // DFS clock. The loop task sleeps in voiceDetected() until candidate speech.
+    bool startLowPowerListening() {
+        if (listenTask != nullptr) {
+            return true;
+        }
+        
+        speechStream = xStreamBufferCreate(SPEECH_STREAM_BYTES, LISTEN_FRAME_SAMPLES * sizeof(int16_t));
+        speechCandidate = xSemaphoreCreateBinary();
+        if (speechStream == nullptr || speechCandidate == nullptr) {
+            return false;
+        }
+        
+        recorder = RECORDER_IDLE;
+        wakeDetector.reset();
+        preRoll.clear();
+        return xTaskCreatePinnedToCore(listenTaskEntry, "listen", 8192, this, 5, &listenTask, 0) == pdPASS;
+    }
+    
+    void setNetworkModule(NetworkModule* network) {
+        networkModule = network;
+    }
+    
+    bool isLowPowerListening() const {
+        return listenTask != nullptr;
     }
     
     bool voiceDetected() {
-        int16_t samples[BUFFER_SIZE];
-        size_t bytes_read;
+        if (listenTask != nullptr) {
+            // Block until the listener reports candidate speech
+            bool detected = xSemaphoreTake(speechCandidate, pdMS_TO_TICKS(LISTEN_WAIT_MS)) == pdTRUE;
+            if (detected) {
+                Metrics::inc(AUDIO_VAD_TRIGGERS);
+            }
+            return detected;
+        }
         
-        i2s_read(I2S_NUM_0, samples, sizeof(samples), &bytes_read, portMAX_DELAY);
+        TRACE_SPAN(TRACE_VAD);
+        int16_t samples[BUFFER_SIZE];
+        readSamples(samples, BUFFER_SIZE);
         
         // Simple energy-based voice activity detection
+        PmLockGuard pmLock(PM_WORK_DSP);
         float energy = 0;
-        for (int i = 0; i < BUFFER_SIZE; i++) {
+        for (size_t i = 0; i < BUFFER_SIZE; i++) {
             energy += abs(samples[i]);
         }
         energy /= BUFFER_SIZE;
         
-        return energy > VOICE_THRESHOLD;
+        if (resuming) {
+            // Nobody read the queue while the last command ran; that backlog
+            // was never going to be recorded, so it is no overrun
+            I2sHal::takeOverruns(MIC_PORT);
+            resuming = false;
+        } else {
+            countOverruns();
+        }
+        // With a mic array, also stay above the speech-free noise reference
+        bool detected = energy > VOICE_THRESHOLD && energy > NOISE_RATIO * beamformer.getNoiseLevel();
+        if (detected) {
+            Metrics::inc(AUDIO_VAD_TRIGGERS);
+        }
+        return detected;
     }
     
     String getVoiceCommand() {
-        // Record audio for command
-        size_t audioSize = SAMPLE_RATE * 2; // 2 seconds of audio
-        int16_t* audioBuffer = new int16_t[audioSize];
-        
-        size_t bytes_read;
-        size_t totalRead = 0;
+        // Record 2 seconds of audio, uploaded in chunks in the format the link plan picks
+        size_t audioSize = RECORDING_SAMPLES;
+        LinkPlan plan = networkModule != nullptr ? networkModule->getLinkPlan() : LinkPlan();
+        size_t chunkSize = min(audioSize, (size_t)(SAMPLE_RATE * plan.chunkMs / 1000));
+        // The listener's stream holds the rest of the recording, so only one
+        // chunk is kept here
+        int16_t* audioBuffer = new int16_t[listenTask != nullptr ? chunkSize : audioSize];
+        encoder.configure(SAMPLE_RATE, plan.format);
+        uint8_t* encoded = new uint8_t[encoder.maxBytes(chunkSize)];
         
-        while (totalRead < audioSize * sizeof(int16_t)) {
-            i2s_read(I2S_NUM_0, 
-                    ((uint8_t*)audioBuffer) + totalRead, 
-                    audioSize * sizeof(int16_t) - totalRead, 
-                    &bytes_read, 
-                    portMAX_DELAY);
-            totalRead += bytes_read;
+        if (listenTask == nullptr) {
+            // Nothing drains the DMA queue during an upload, so record it all first
+            TRACE_SPAN(TRACE_CAPTURE);
+            readSamples(audioBuffer, audioSize);
+            countOverruns();
+            
+            PmLockGuard pmLock(PM_WORK_DSP);
+            enhancer.reset();
+            enhancer.process(audioBuffer, audioSize, audioBuffer);
+            if (intentsReady) {
+                intents.reset();
+                for (size_t offset = 0; offset < audioSize; offset += LISTEN_FRAME_SAMPLES) {
+                    size_t n = min(LISTEN_FRAME_SAMPLES, audioSize - offset);
+                    if (!feedIntents(audioBuffer + offset, n, offset + n >= audioSize)) {
+                        break;
+                    }
+                }
+            }
         }
         
-        // Send audio to server for processing
-        bool success = networkModule->sendAudio((uint8_t*)audioBuffer, audioSize * sizeof(int16_t));
+        bool success = networkModule != nullptr;
+        uint16_t seq = 0;
+        for (size_t offset = 0; offset < audioSize && localIntent == INTENT_NONE; offset += chunkSize) {
+            size_t count = min(chunkSize, audioSize - offset);
+            bool final = offset + count >= audioSize;
+            int16_t* samples = audioBuffer + offset;
+            if (listenTask != nullptr) {
+                // Pre-roll plus live audio from the listener; each chunk goes
+                // up while the next one is spoken. A local command ends the
+                // upload with no final chunk, so the server never answers it.
+                TRACE_SPAN(TRACE_CAPTURE);
+                samples = audioBuffer;
+                if (!receiveSpeech(samples, count)) {
+                    break;
+                }
+                if (final) {
+                    // Everything is here; the final chunk and the server's
+                    // turn must not fill the stream
+                    recorder = RECORDER_FINISHING;
+                }
+            }
+            size_t bytes;
+            {
+                TRACE_SPAN(TRACE_ENCODE);
+                PmLockGuard pmLock(PM_WORK_DSP);
+                bytes = encoder.encode(samples, count, encoded);
+            }
+            // After a failed chunk the rest is still drained, but not sent
+            success = success && networkModule->sendAudioChunk(encoded, bytes, encoder.getFormat(), seq++, final);
+        }
+        if (listenTask != nullptr) {
+            recorder = RECORDER_IDLE;
+        } else {
+            resuming = true;
+        }
         delete[] audioBuffer;
+        delete[] encoded;
         
+        if (localIntent != INTENT_NONE) {
+            return "";
+        }
         if (!success) {
             return "Error processing audio";
         }
         
+        // The server's transcript when it sends one; it is also what the
+        // response cache is keyed by
+        const String& transcript = networkModule->getTranscript();
+        if (transcript.length() > 0) {
+            return transcript;
+        }
         // Wait for response
         delay(100);
         return "Command processed"; // Actual response should come from server
     }
     
-    void playResponse(const String &text) {
-        // Implementation for bone conduction audio output
-        // This would typically use I2S or DAC output
-        // Actual implementation depends on your bone conduction speaker setup
+    // Bone conduction speaker: earcons and status prompts from the asset pack
+    bool beginOutput() {
+        return prompts.begin();
+    }
+    
+    bool playPrompt(AssetId id) {
+        return prompts.play(id);
+    }
+    
+    void stopPrompt(AssetId id) {
+        prompts.stop(id);
+    }
+    
+    // The answer is in: the thinking loop gives way to the done or error
+    // prompt. The answer itself is text for the display; speaking it needs
+    // audio the server does not send.
+    void playResponse(const String &text, bool succeeded = true) {
+        prompts.stop(PROMPT_THINKING);
+        prompts.play(succeeded ? PROMPT_DONE : PROMPT_ERROR);
+    }
+    
+    // Local commands: templates come from the asset pack; false leaves every
+    // command to the server
+    bool beginIntents() {
+        if (!AssetStore::isMounted()) {
+            return false;
+        }
+        intents.clearTemplates();
+        for (const IntentTemplate& entry : INTENT_TEMPLATES) {
+            if (!intents.addTemplate(entry.intent, AssetStore::prompt(entry.id))) {
+                Logger::warning("AUDIO", String("Command template ") + String(entry.id) + " unusable");
+            }
+        }
+        intentsReady = intents.getTemplateCount() > 0;
+        return intentsReady;
+    }
+    
+    // The command getVoiceCommand() recognized on the glasses, if any; it
+    // is cleared by the call
+    LocalIntent takeLocalIntent() {
+        LocalIntent intent = localIntent;
+        localIntent = INTENT_NONE;
+        return intent;
+    }
+    
+    // Muted, the speaker plays no prompts; listening carries on
+    void setMuted(bool muted) {
+        isMuted = muted;
+        prompts.setMuted(muted);
+    }
+    
+    bool getMuted() const {
+        return isMuted;
     }
     
     void toggleMute() {
-        isMuted = !isMuted;
-        // Implement mute functionality
+        setMuted(!isMuted);
     }
     
 private:
-    static const float VOICE_THRESHOLD = 1000.0;
+    static constexpr float NOISE_RATIO = 3.0;
+    static const uint8_t MIC_PORT = 0;
+    static const size_t CHUNK_FRAMES = 256;                                // Output frames per raw read
+    static const size_t RAW_CHUNK_FRAMES = CHUNK_FRAMES * Board::Mic::DECIMATION;
+    static constexpr size_t LISTEN_FRAME_SAMPLES = 256;                   // 16 ms detector frames
+    static const size_t PRE_ROLL_SAMPLES = SAMPLE_RATE / 2;           // 500 ms of history
+    static const size_t RECORDING_SAMPLES = SAMPLE_RATE * 2;          // One command, pre-roll included
+    // A whole recording: however slowly chunks upload, the listener never
+    // has to drop speech the recorder has yet to read
+    static const size_t SPEECH_STREAM_BYTES = RECORDING_SAMPLES * sizeof(int16_t);
+    static const uint32_t LISTEN_WAIT_MS = 50;
+    
+    struct IntentTemplate {
+        AssetId id;
+        LocalIntent intent;
+    };
+    
+    static constexpr IntentTemplate INTENT_TEMPLATES[] = {
+        { COMMAND_MUTE_1, INTENT_MUTE },
+        { COMMAND_MUTE_2, INTENT_MUTE },
+        { COMMAND_UNMUTE_1, INTENT_UNMUTE },
+        { COMMAND_UNMUTE_2, INTENT_UNMUTE },
+        { COMMAND_DISPLAY_OFF_1, INTENT_DISPLAY_OFF },
+        { COMMAND_DISPLAY_OFF_2, INTENT_DISPLAY_OFF },
+        { COMMAND_DISPLAY_ON_1, INTENT_DISPLAY_ON },
+        { COMMAND_DISPLAY_ON_2, INTENT_DISPLAY_ON },
+        { COMMAND_BATTERY_1, INTENT_BATTERY_LEVEL },
+        { COMMAND_BATTERY_2, INTENT_BATTERY_LEVEL }
+    };
+    static_assert(sizeof(INTENT_TEMPLATES) / sizeof(INTENT_TEMPLATES[0]) <= IntentMatcher::MAX_TEMPLATES,
+                  "More command templates than the matcher holds");
+    
     bool isMuted = false;
-    NetworkModule* networkModule;
+    NetworkModule* networkModule = nullptr;
+    PromptPlayer prompts;
+    MicFrontEnd frontEnd;
+    Beamformer beamformer;
+    SpeechEnhancer enhancer;                            // Recorder-bound audio only, not the detectors
+    AudioEncoder encoder;                               // Upload format, set per recording
+    int32_t raw[RAW_CHUNK_FRAMES * MIC_CHANNELS];       // 32-bit slots straight from DMA
+    int16_t perChannel[MIC_CHANNELS > 1 ? CHUNK_FRAMES * MIC_CHANNELS : 1];  // Conditioned, before beamforming
+    
+    TaskHandle_t listenTask = nullptr;
+    StreamBufferHandle_t speechStream = nullptr;
+    SemaphoreHandle_t speechCandidate = nullptr;
+    // The listener's side of a recording: detecting wakes, handing audio to
+    // getVoiceCommand(), or dropping it while the last chunk and the server's
+    // turn finish
+    enum RecorderState : uint8_t {
+        RECORDER_IDLE,
+        RECORDER_CAPTURING,
+        RECORDER_FINISHING
+    };
+    volatile RecorderState recorder = RECORDER_IDLE;
+    bool resuming = false;                              // No listener: first check after a command
+    WakeDetector wakeDetector;
+    PreRollBuffer<PRE_ROLL_SAMPLES> preRoll;
+    IntentMatcher intents;                              // Sees the enhanced audio, as the server would
+    bool intentsReady = false;
+    bool matching = false;                              // Listener: until the matcher decides
+    volatile LocalIntent localIntent = INTENT_NONE;
+    
+    static void listenTaskEntry(void* arg) {
+        static_cast<AudioDriver*>(arg)->listenLoop();
+    }
+    
+    void listenLoop() {
+        int16_t batch[BUFFER_SIZE];
+        bool wasCapturing = false;
+        
+        while (true) {
+            size_t count = readSamples(batch, BUFFER_SIZE);
+            countOverruns();
+            wakeDetector.setNoiseReference(beamformer.getNoiseLevel());
+            
+            if (recorder != RECORDER_IDLE) {
+                wasCapturing = true;
+                if (recorder == RECORDER_CAPTURING) {
+                    streamToRecorder(batch, count);
+                }
+                continue;
+            }
+            if (wasCapturing) {
+                // Recorder is done; drop whatever it did not consume
+                xStreamBufferReset(speechStream);
+                wasCapturing = false;
+            }
+            
+            for (size_t offset = 0; offset < count; offset += LISTEN_FRAME_SAMPLES) {
+                size_t frame = min(LISTEN_FRAME_SAMPLES, count - offset);
+                bool wake = wakeDetector.process(batch + offset, frame);
+                preRoll.write(batch + offset, frame);
+                
+                if (wake && recorder == RECORDER_IDLE) {
+                    // Hand over the history first, then the rest of this batch
+                    enhancer.reset();
+                    intents.reset();
+                    localIntent = INTENT_NONE;
+                    matching = intentsReady;
+                    int16_t chunk[LISTEN_FRAME_SAMPLES];
+                    size_t n;
+                    while ((n = preRoll.read(chunk, LISTEN_FRAME_SAMPLES)) > 0) {
+                        streamToRecorder(chunk, n);
+                    }
+                    recorder = RECORDER_CAPTURING;
+                    // The upload follows unless a local intent takes it
+                    RadioScheduler::expect();
+                    xSemaphoreGive(speechCandidate);
+                } else if (recorder == RECORDER_CAPTURING) {
+                    streamToRecorder(batch + offset, frame);
+                }
+            }
+        }
+    }
+    
+    // Blocks until the listener has handed over count samples; false once
+    // the matcher has recognized a local command instead
+    bool receiveSpeech(int16_t* out, size_t count) {
+        size_t received = 0;
+        while (received < count * sizeof(int16_t)) {
+            if (localIntent != INTENT_NONE) {
+                return false;
+            }
+            received += xStreamBufferReceive(speechStream, ((uint8_t*)out) + received,
+                                             count * sizeof(int16_t) - received, pdMS_TO_TICKS(LISTEN_WAIT_MS));
+        }
+        return true;
+    }
+    
+    // Feeds enhanced audio to the matcher; true while it is still listening.
+    // The call that decides, DTW included, is timed into INTENT_MATCH_US and
+    // a match becomes the local intent
+    bool feedIntents(const int16_t* samples, size_t count, bool last) {
+        uint32_t start = micros();
+        IntentMatcher::State state = intents.process(samples, count);
+        if (last) {
+            state = intents.finish();
+        }
+        if (state == IntentMatcher::WAITING || state == IntentMatcher::SPEAKING) {
+            return true;
+        }
+        Metrics::observe(INTENT_MATCH_US, micros() - start);
+        if (state == IntentMatcher::MATCHED) {
+            localIntent = (LocalIntent)intents.getLabel();
+        }
+        return false;
+    }
+    
+    // Noise suppression and AGC run here, on audio bound for the server; the
+    // enhancer adds FRAME samples (16 ms) of latency
+    void streamToRecorder(const int16_t* samples, size_t count) {
+        int16_t enhanced[LISTEN_FRAME_SAMPLES];
+        for (size_t offset = 0; offset < count; offset += LISTEN_FRAME_SAMPLES) {
+            size_t n = min(LISTEN_FRAME_SAMPLES, count - offset);
+            {
+                PmLockGuard pmLock(PM_WORK_DSP);
+                enhancer.process(samples + offset, n, enhanced);
+                if (matching) {
+                    matching = feedIntents(enhanced, n, false);
+                }
+            }
+            size_t bytes = n * sizeof(int16_t);
+            if (xStreamBufferSend(speechStream, enhanced, bytes, 0) != bytes) {
+                Metrics::inc(AUDIO_OVERRUNS);
+            }
+        }
+    }
+    
+    // Blocks until count conditioned samples are read. Waiting on the DMA queue
+    // holds no PM lock, so the CPU can idle here. Only one task reads at a time:
+    // the listener when it runs, the loop task otherwise. The beamformer writes
+    // straight into out, so the VAD and recorder see no extra copy.
+    size_t readSamples(int16_t* out, size_t count) {
+        size_t produced = 0;
+        while (produced < count) {
+            size_t frames = min(RAW_CHUNK_FRAMES, (count - produced) * Board::Mic::DECIMATION);
+            size_t framesRead = 0;
+            I2sHal::readFrames(MIC_PORT, raw, frames, &framesRead, portMAX_DELAY);
+            if (framesRead == 0) {
+                break;
+            }
+            if constexpr (MIC_CHANNELS == 1) {
+                produced += frontEnd.process(raw, framesRead, out + produced);
+            } else {
+                size_t conditioned = frontEnd.process(raw, framesRead, perChannel);
+                produced += beamformer.process(perChannel, conditioned, out + produced);
+            }
+        }
+        return produced;
+    }
+    
+    void countOverruns() {
+        uint32_t overruns = I2sHal::takeOverruns(MIC_PORT);
+        if (overruns > 0) {
+            Metrics::inc(AUDIO_OVERRUNS, overruns);
+        }
+    }
 };
 
 #endif
@@ -1,42 +1,49 @@
 #ifndef DISPLAY_DRIVER_H
 #define DISPLAY_DRIVER_H
 
-#include <Wire.h>
-#include <Adafruit_SSD1306.h>
+#include "../config/board_profile.h"
+#include "ssd1306_panel.cpp"
+#include "../modules/asset_store.cpp"
 
+// Text is set in the asset pack's UI font and messages get their icon when
+// the pack is mounted; the glyphs and icon bits are drawn straight from
+// mapped flash. Without a pack, the built-in 6x8 font and plain text.
 class DisplayDriver {
 public:
-    DisplayDriver() : display(128, 32, &Wire, -1) {}
+    DisplayDriver() : display(Board::Display::WIDTH, Board::Display::HEIGHT, Board::Display::ADDRESS) {}
     
     bool begin() {
-        if(!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
+        if(!display.begin()) {
             return false;
         }
         display.clearDisplay();
         display.setTextSize(1);
         display.setTextColor(SSD1306_WHITE);
-        display.display();
+        selectFont();
+        flush();
         return true;
     }
     
     void showStatus(const String &status) {
         display.clearDisplay();
-        display.setCursor(0,0);
+        home();
         display.println(status);
-        display.display();
+        flush();
     }
     
     void showError(const String &error) {
         display.clearDisplay();
-        display.setCursor(0,0);
-        display.println("ERROR:");
-        display.println(error);
-        display.display();
+        if (!iconMessage(ICON_WARNING, error)) {
+            home();
+            display.println("ERROR:");
+            display.println(error);
+        }
+        flush();
     }
     
     void showText(const String &text) {
         display.clearDisplay();
-        display.setCursor(0,0);
+        home();
         
         // Word wrap implementation
         int16_t x1, y1;
@@ -66,28 +73,85 @@ public:
             words = words.substring(spaceIndex + 1);
         }
         
-        display.display();
+        flush();
     }
     
     void showBatteryWarning() {
         display.clearDisplay();
-        display.setCursor(0,0);
-        display.println("Low Battery!");
-        display.display();
+        if (!iconMessage(ICON_BATTERY_LOW, "Low Battery!")) {
+            home();
+            display.println("Low Battery!");
+        }
+        flush();
+    }
+    
+    // Draws a pack bitmap with its top-left corner at x, y
+    bool drawIcon(AssetId id, int16_t x, int16_t y) {
+        AssetBitmap icon = AssetStore::bitmap(id);
+        if (!icon) {
+            return false;
+        }
+        display.drawBitmap(x, y, icon.bits, icon.width, icon.height, SSD1306_WHITE);
+        return true;
     }
     
     void toggleDisplay() {
-        displayOn = !displayOn;
+        setDisplayOn(!displayOn);
+    }
+    
+    void setDisplayOn(bool on) {
+        displayOn = on;
         if (displayOn) {
             display.dim(false);
         } else {
             display.dim(true);
         }
-        display.display();
+        flush();
     }
     
 private:
-    Adafruit_SSD1306 display;
+    Ssd1306Panel display;
+    GFXfont uiFont = {};
+    uint8_t ascent = 0;             // Baseline offset of the pack font, 0 for the built-in one
+    uint8_t lineHeight = 8;
+    
+    void selectFont() {
+        AssetFont font = AssetStore::font(FONT_UI);
+        if (!font) {
+            return;
+        }
+        static_assert(sizeof(GFXglyph) == sizeof(AssetGlyph), "pack glyphs are used as GFXglyph");
+        uiFont.bitmap = (uint8_t*)font.bits;
+        uiFont.glyph = (GFXglyph*)font.glyphs;
+        uiFont.first = font.header->first;
+        uiFont.last = font.header->last;
+        uiFont.yAdvance = font.header->yAdvance;
+        ascent = font.header->ascent;
+        lineHeight = font.header->yAdvance;
+        display.setFont(&uiFont);
+    }
+    
+    // Start of the first line: custom fonts draw from the baseline
+    void home() {
+        display.setCursor(0, ascent);
+    }
+    
+    // Icon on the left, the message beside it, vertically centred
+    bool iconMessage(AssetId id, const String &message) {
+        AssetBitmap icon = AssetStore::bitmap(id);
+        if (!icon) {
+            return false;
+        }
+        display.drawBitmap(0, (display.height() - icon.height) / 2, icon.bits, icon.width, icon.height, SSD1306_WHITE);
+        display.setCursor(icon.width + 4, (display.height() - lineHeight) / 2 + ascent);
+        display.print(message);
+        return true;
+    }
+    
+    // Queue the framebuffer on the I2C bus; the panel records the flush time
+    void flush() {
+        display.display();
+    }
     bool displayOn = true;
 };
 
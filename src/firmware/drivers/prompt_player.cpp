@@ -0,0 +1,241 @@
+#ifndef PROMPT_PLAYER_H
+#define PROMPT_PLAYER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "../config/board_profile.h"
+#include "../hal/i2s_hal.cpp"
+#include "../modules/asset_store.cpp"
+#include "../dsp/prompt_mixer.cpp"
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+
+// Earcons and status prompts on the bone conduction speaker, played from the
+// asset pack without a server round trip. play() only posts to a queue, so
+// any task can call it; a task above the loop's priority mixes the clips
+// into the speaker's DMA buffers.
+//
+// From play() to the first sample at the amplifier:
+// - speaker idle: the task wakes, mixes the clips' decoded leads and starts
+//   the I2S clock with them already in the DMA buffers (IDF 5; the legacy
+//   driver puts one buffer of silence first)
+// - already playing: the clip joins the next buffer mixed, which waits
+//   behind the DMA_BUF_COUNT queued ones, 16 ms at most on the glasses
+// Each start is recorded in PROMPT_LATENCY_US. The I2S clock, and the APB
+// lock the driver holds with it, runs only while something plays.
+class PromptPlayer {
+public:
+    static constexpr uint32_t SAMPLE_RATE = Board::Speaker::SAMPLE_RATE;
+    static constexpr size_t BUFFER_SAMPLES = Board::Speaker::DMA_BUF_LEN;
+    static constexpr size_t RING_SAMPLES = BUFFER_SAMPLES * Board::Speaker::DMA_BUF_COUNT;
+
+    // Loads the prompts from the mounted asset pack and starts the task;
+    // false leaves prompts off
+    bool begin() {
+        if (task != nullptr) {
+            return true;
+        }
+        if (!AssetStore::isMounted()) {
+            Logger::warning("PROMPT", "No asset pack, prompts off");
+            return false;
+        }
+        for (uint8_t clip = 0; clip < CLIPS; clip++) {
+            AssetPrompt prompt = AssetStore::prompt(PROMPTS[clip].id);
+            if (!prompt || prompt.header->sampleRate != SAMPLE_RATE ||
+                !mixer.load(clip, prompt, PROMPTS[clip].priority, PROMPTS[clip].loop)) {
+                Logger::warning("PROMPT", String("Prompt ") + String(PROMPTS[clip].id) + " missing or not " +
+                                String(SAMPLE_RATE) + " Hz");
+            }
+        }
+
+        I2sTxConfig config = {
+            .port = SPEAKER_PORT,
+            .sampleRate = SAMPLE_RATE,
+            .bclk = Board::Speaker::BCLK,
+            .ws = Board::Speaker::WS,
+            .dout = Board::Speaker::DOUT,
+            .dmaBufCount = Board::Speaker::DMA_BUF_COUNT,
+            .dmaBufLen = Board::Speaker::DMA_BUF_LEN
+        };
+        esp_err_t err = I2sHal::beginTx(config);
+        if (err != ESP_OK) {
+            Logger::error("PROMPT", String("Speaker I2S setup failed: ") + esp_err_to_name(err));
+            return false;
+        }
+        commands = xQueueCreate(COMMAND_QUEUE_LEN, sizeof(Command));
+        if (commands == nullptr ||
+            xTaskCreatePinnedToCore(taskEntry, "prompts", 4096, this, TASK_PRIORITY, &task, 1) != pdPASS) {
+            Logger::warning("PROMPT", "Prompt task unavailable, prompts off");
+            return false;
+        }
+        return true;
+    }
+
+    bool isAvailable() const {
+        return task != nullptr;
+    }
+
+    // Starts a prompt; false if prompts are off, muted or the queue is full
+    bool play(AssetId id) {
+        return !muted && post(id, false);
+    }
+
+    // Fades a prompt out (the thinking loop once the answer is in)
+    void stop(AssetId id) {
+        post(id, true);
+    }
+    
+    // Muting refuses new prompts; one already playing finishes
+    void setMuted(bool mute) {
+        muted = mute;
+    }
+
+private:
+    static const uint8_t SPEAKER_PORT = 1;
+    static const uint8_t COMMAND_QUEUE_LEN = 8;
+    static const UBaseType_t TASK_PRIORITY = 6;     // Above the loop and the listener
+    static constexpr uint32_t BUFFER_US = BUFFER_SAMPLES * 1000000 / SAMPLE_RATE;
+#if ESP_IDF_VERSION_MAJOR >= 5
+    static constexpr uint32_t START_US = 0;         // Leads are preloaded
+#else
+    static constexpr uint32_t START_US = BUFFER_US; // One zeroed buffer goes out first
+#endif
+
+    struct PromptSpec {
+        AssetId id;
+        PromptPriority priority;
+        bool loop;
+    };
+
+    static constexpr PromptSpec PROMPTS[] = {
+        { PROMPT_LISTENING, PROMPT_PRIORITY_FEEDBACK, false },
+        { PROMPT_THINKING, PROMPT_PRIORITY_AMBIENT, true },
+        { PROMPT_DONE, PROMPT_PRIORITY_FEEDBACK, false },
+        { PROMPT_ERROR, PROMPT_PRIORITY_ALERT, false },
+        { PROMPT_LOW_BATTERY, PROMPT_PRIORITY_ALERT, false }
+    };
+    static constexpr uint8_t CLIPS = sizeof(PROMPTS) / sizeof(PROMPTS[0]);
+    static_assert(CLIPS <= PromptMixer::MAX_CLIPS, "More prompts than mixer clips");
+
+    struct Command {
+        uint8_t clip;
+        bool stop;
+        uint32_t triggerUs;
+    };
+
+    PromptMixer mixer = PromptMixer(mixerConfig());
+    TaskHandle_t task = nullptr;
+    QueueHandle_t commands = nullptr;
+    int16_t ring[RING_SAMPLES];             // Mixed ahead of a start
+    uint32_t started[COMMAND_QUEUE_LEN];    // Trigger times of clips started since the last mix
+    uint8_t startedCount = 0;
+    volatile bool muted = false;
+
+    static PromptMixerConfig mixerConfig() {
+        PromptMixerConfig config;
+        config.sampleRate = SAMPLE_RATE;
+        return config;
+    }
+
+    bool post(AssetId id, bool stop) {
+        if (task == nullptr) {
+            return false;
+        }
+        for (uint8_t clip = 0; clip < CLIPS; clip++) {
+            if (PROMPTS[clip].id == id) {
+                Command command = { clip, stop, (uint32_t)micros() };
+                return xQueueSend(commands, &command, 0) == pdTRUE;
+            }
+        }
+        return false;
+    }
+
+    static void taskEntry(void* arg) {
+        static_cast<PromptPlayer*>(arg)->run();
+    }
+
+    void run() {
+        bool running = false;
+        uint8_t silentBuffers = 0;
+        while (true) {
+            Command command;
+            if (!running) {
+                // Idle: no clock, nothing to do until a trigger
+                xQueueReceive(commands, &command, portMAX_DELAY);
+                apply(command);
+                takeCommands();
+                if (!mixer.isActive()) {
+                    continue;
+                }
+                mixer.mix(ring, RING_SAMPLES);
+                recordStarts(START_US);
+                size_t preloaded = 0;
+                esp_err_t err = I2sHal::startTx(SPEAKER_PORT, ring, RING_SAMPLES, &preloaded);
+                if (err != ESP_OK) {
+                    Logger::error("PROMPT", String("Speaker start failed: ") + esp_err_to_name(err));
+                    mixer.stopAll(true);
+                    continue;
+                }
+                if (preloaded < RING_SAMPLES) {
+                    size_t written;
+                    I2sHal::writeSamples(SPEAKER_PORT, ring + preloaded, RING_SAMPLES - preloaded, &written, portMAX_DELAY);
+                }
+                running = true;
+                silentBuffers = 0;
+                continue;
+            }
+
+            takeCommands();
+            bool playing = mixer.mix(ring, BUFFER_SAMPLES);
+            // The buffer plays once the ring queued ahead of it has
+            recordStarts(Board::Speaker::DMA_BUF_COUNT * BUFFER_US);
+            size_t written;
+            I2sHal::writeSamples(SPEAKER_PORT, ring, BUFFER_SAMPLES, &written, portMAX_DELAY);
+
+            // A ring of silence behind the last clip, then the clock stops
+            silentBuffers = playing ? 0 : silentBuffers + 1;
+            if (silentBuffers >= Board::Speaker::DMA_BUF_COUNT) {
+                I2sHal::stopTx(SPEAKER_PORT);
+                running = false;
+            }
+        }
+    }
+
+    void takeCommands() {
+        Command command;
+        while (xQueueReceive(commands, &command, 0) == pdTRUE) {
+            apply(command);
+        }
+    }
+
+    void apply(const Command& command) {
+        if (command.stop) {
+            mixer.stop(command.clip);
+            return;
+        }
+        bool wasPlaying = mixer.isPlaying(command.clip) && PROMPTS[command.clip].loop;
+        if (!mixer.play(command.clip)) {
+            Metrics::inc(PROMPTS_DROPPED);
+            return;
+        }
+        if (!wasPlaying) {
+            Metrics::inc(PROMPTS_PLAYED);
+            if (startedCount < COMMAND_QUEUE_LEN) {
+                started[startedCount++] = command.triggerUs;
+            }
+        }
+    }
+
+    // Clips started since the last mix reach the amplifier aheadUs from now
+    void recordStarts(uint32_t aheadUs) {
+        uint32_t now = (uint32_t)micros();
+        for (uint8_t i = 0; i < startedCount; i++) {
+            Metrics::observe(PROMPT_LATENCY_US, now - started[i] + aheadUs);
+        }
+        startedCount = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef SSD1306_PANEL_H
+#define SSD1306_PANEL_H
+
+#include <Adafruit_GFX.h>
+#include "../hal/i2c_bus.cpp"
+#include "../utils/metrics.cpp"
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+
+// SSD1306 over I2cBus: an Adafruit_GFX canvas in the panel's page layout, so
+// the drawing API is the same as Adafruit_SSD1306. display() copies the frame
+// into a transmit buffer and queues it; it only waits when the previous frame
+// is still on the wire. Commands and frame data carry the 0x00 / 0x40 control
+// byte as merge prefix, so a command queued right before the frame window goes
+// out in one transfer with it.
+class Ssd1306Panel : public Adafruit_GFX {
+public:
+    static const uint32_t MAX_FREQUENCY = 400000;   // Fast-mode, per the datasheet
+
+    Ssd1306Panel(uint8_t width, uint8_t height, uint8_t address)
+        : Adafruit_GFX(width, height), address(address), contrast(height == 32 ? 0x8F : 0xCF) {
+        const uint8_t pageWindow[WINDOW_LENGTH] = { 0x00, 0x22, 0x00, 0xFF, 0x21, 0x00, (uint8_t)(width - 1) };
+        memcpy(window, pageWindow, sizeof(window));
+    }
+
+    ~Ssd1306Panel() {
+        frameDone.wait();
+        commandDone.wait();
+        delete[] frame;
+        delete[] sent;
+    }
+
+    // Sends the init sequence and waits for it; false if the panel does not ACK
+    bool begin() {
+        if (!I2cBus::begin() || !I2cBus::addDevice(address, MAX_FREQUENCY, I2C_DISPLAY_US)) {
+            return false;
+        }
+        if (frame == nullptr) {
+            frame = new uint8_t[1 + bufferSize()];
+            sent = new uint8_t[1 + bufferSize()];
+            frame[0] = 0x40;
+        }
+        clearDisplay();
+
+        // Internal charge pump (SWITCHCAPVCC), horizontal addressing
+        const uint8_t init[] = {
+            0x00,
+            0xAE, 0xD5, 0x80, 0xA8, (uint8_t)(_height - 1), 0xD3, 0x00, 0x40, 0x8D, 0x14,
+            0x20, 0x00, 0xA1, 0xC8, 0xDA, (uint8_t)(_height == 32 ? 0x02 : 0x12), 0x81, contrast,
+            0xD9, 0xF1, 0xDB, 0x40, 0xA4, 0xA6, 0x2E, 0xAF
+        };
+        return I2cBus::transfer(address, init, sizeof(init)) == ESP_OK;
+    }
+
+    void clearDisplay() {
+        if (frame) memset(frame + 1, 0, bufferSize());
+    }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+        if (!frame || x < 0 || x >= _width || y < 0 || y >= _height) return;
+        uint8_t& cell = frame[1 + x + (y / 8) * _width];
+        uint8_t bit = 1 << (y & 7);
+        switch (color) {
+            case SSD1306_WHITE: cell |= bit; break;
+            case SSD1306_BLACK: cell &= ~bit; break;
+            case SSD1306_INVERSE: cell ^= bit; break;
+        }
+    }
+
+    void display() {
+        if (!frame) return;
+        frameDone.wait();
+        memcpy(sent, frame, 1 + bufferSize());
+
+        I2cTransaction pages;
+        pages.address = address;
+        pages.tx = window;
+        pages.txLength = sizeof(window);
+        pages.mergePrefix = 1;
+        I2cBus::submit(pages);
+
+        I2cTransaction data;
+        data.address = address;
+        data.tx = sent;
+        data.txLength = 1 + bufferSize();
+        data.mergePrefix = 1;
+        data.callback = onFrameDone;
+        data.future = &frameDone;
+        I2cBus::submit(data);
+    }
+
+    void dim(bool dim) {
+        sendCommand(0x81, dim ? 0x00 : contrast);
+    }
+
+    void invertDisplay(bool invert) {
+        sendCommand(invert ? 0xA7 : 0xA6);
+    }
+
+    // Waits for queued frames and commands to reach the panel
+    esp_err_t waitIdle(TickType_t ticks = portMAX_DELAY) {
+        esp_err_t err = frameDone.wait(ticks);
+        esp_err_t commandErr = commandDone.wait(ticks);
+        return err != ESP_OK ? err : commandErr;
+    }
+
+    uint8_t* getBuffer() {
+        return frame ? frame + 1 : nullptr;
+    }
+
+private:
+    static const size_t WINDOW_LENGTH = 7;
+
+    const uint8_t address;
+    const uint8_t contrast;
+    uint8_t window[WINDOW_LENGTH];
+    uint8_t* frame = nullptr;          // Control byte + framebuffer being drawn
+    uint8_t* sent = nullptr;           // Control byte + framebuffer on the wire
+    uint8_t command[3];
+    I2cFuture frameDone;
+    I2cFuture commandDone;
+
+    size_t bufferSize() const {
+        return _width * ((_height + 7) / 8);
+    }
+
+    void sendCommand(uint8_t first, int second = -1) {
+        commandDone.wait();
+        command[0] = 0x00;
+        command[1] = first;
+        command[2] = (uint8_t)second;
+
+        I2cTransaction transaction;
+        transaction.address = address;
+        transaction.tx = command;
+        transaction.txLength = second >= 0 ? 3 : 2;
+        transaction.mergePrefix = 1;
+        transaction.future = &commandDone;
+        I2cBus::submit(transaction);
+    }
+
+    static void onFrameDone(const I2cResult& result, void* context) {
+        if (result.status == ESP_OK) {
+            Metrics::observe(DISPLAY_FLUSH_US, result.latencyUs);
+        }
+    }
+};
+
+#endif
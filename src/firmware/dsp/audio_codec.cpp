@@ -0,0 +1,213 @@
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "mic_frontend.cpp"
+
+// Upload encoding for recorded commands: 16-bit PCM or IMA ADPCM (4 bits per
+// sample), at the capture rate or half of it. Integer-only and free of
+// Arduino/ESP-IDF dependencies so it builds on the host.
+//
+// Halving the rate reuses the mic front end's 2:1 anti-alias FIR (flat to
+// 3 kHz, below -38 dB from 4.5 kHz at 8 kHz out), so telephone-band speech
+// stays intact. The filter and ADPCM state carry across encode() calls, so
+// chunked and one-shot uploads decode to the same audio.
+//
+// Every encode() call produces one self-contained block, so a server can
+// decode chunks in any order and a lost chunk does not corrupt the next:
+//   PCM16:     little-endian samples
+//   IMA ADPCM: int16 predictor, uint8 step index, uint8 flags (bit 0: the
+//              last nibble is padding), then two samples per byte, low
+//              nibble first
+enum AudioCodecMode : uint8_t {
+    CODEC_PCM16 = 0,
+    CODEC_IMA_ADPCM = 1
+};
+
+struct AudioFormat {
+    uint32_t sampleRate = 16000;
+    AudioCodecMode codec = CODEC_PCM16;
+
+    uint32_t bitsPerSecond() const {
+        return sampleRate * (codec == CODEC_PCM16 ? 16 : 4);
+    }
+
+    const char* codecName() const {
+        return codec == CODEC_PCM16 ? "pcm16" : "ima-adpcm";
+    }
+};
+
+class AudioEncoder {
+public:
+    static const size_t ADPCM_HEADER_BYTES = 4;
+    static const uint8_t FLAG_ODD = 0x01;
+
+    explicit AudioEncoder(uint32_t inputRate = 16000, const AudioFormat& format = AudioFormat()) {
+        configure(inputRate, format);
+    }
+
+    // The output rate is the input rate or half of it
+    void configure(uint32_t newInputRate, const AudioFormat& newFormat) {
+        inputRate = newInputRate;
+        format = newFormat;
+        decimate = format.sampleRate * 2 == inputRate;
+        format.sampleRate = decimate ? inputRate / 2 : inputRate;
+        reset();
+    }
+
+    void reset() {
+        memset(history, 0, sizeof(history));
+        position = 0;
+        phase = 0;
+        predictor = 0;
+        stepIndex = 0;
+    }
+
+    const AudioFormat& getFormat() const { return format; }
+
+    // Largest block encode() can produce from count input samples
+    size_t maxBytes(size_t count) const {
+        size_t samples = decimate ? count / 2 + 1 : count;
+        return format.codec == CODEC_PCM16 ? samples * 2 : ADPCM_HEADER_BYTES + (samples + 1) / 2;
+    }
+
+    // Encodes count input samples as one block; returns its size in bytes
+    size_t encode(const int16_t* in, size_t count, uint8_t* out) {
+        size_t bytes = 0;
+        size_t samples = 0;
+        if (format.codec == CODEC_IMA_ADPCM) {
+            out[0] = (uint8_t)(predictor & 0xFF);
+            out[1] = (uint8_t)((uint16_t)predictor >> 8);
+            out[2] = stepIndex;
+            out[3] = 0;
+            bytes = ADPCM_HEADER_BYTES;
+        }
+
+        int16_t block[BLOCK];
+        for (size_t offset = 0; offset < count; offset += BLOCK) {
+            size_t n = count - offset < BLOCK ? count - offset : BLOCK;
+            const int16_t* source = in + offset;
+            if (decimate) {
+                n = halve(source, n, block);
+                source = block;
+            }
+            if (format.codec == CODEC_PCM16) {
+                for (size_t i = 0; i < n; i++) {
+                    out[bytes++] = (uint8_t)(source[i] & 0xFF);
+                    out[bytes++] = (uint8_t)((uint16_t)source[i] >> 8);
+                }
+            } else {
+                for (size_t i = 0; i < n; i++, samples++) {
+                    uint8_t nibble = encodeSample(source[i]);
+                    if (samples & 1) {
+                        out[bytes++] |= nibble << 4;
+                    } else {
+                        out[bytes] = nibble;
+                    }
+                }
+            }
+        }
+        if (format.codec == CODEC_IMA_ADPCM && (samples & 1)) {
+            out[3] = FLAG_ODD;
+            bytes++;
+        }
+        return bytes;
+    }
+
+    // Decodes one IMA ADPCM block; returns the number of samples
+    static size_t decodeAdpcm(const uint8_t* in, size_t bytes, int16_t* out) {
+        if (bytes < ADPCM_HEADER_BYTES) return 0;
+        int32_t value = (int16_t)(in[0] | (in[1] << 8));
+        int8_t index = in[2] < STEP_COUNT ? in[2] : STEP_COUNT - 1;
+        size_t samples = (bytes - ADPCM_HEADER_BYTES) * 2 - ((in[3] & FLAG_ODD) ? 1 : 0);
+        for (size_t i = 0; i < samples; i++) {
+            uint8_t byte = in[ADPCM_HEADER_BYTES + i / 2];
+            uint8_t nibble = (i & 1) ? byte >> 4 : byte & 0x0F;
+            value = step(value, index, nibble);
+            out[i] = (int16_t)value;
+        }
+        return samples;
+    }
+
+    static constexpr int16_t STEP_SIZES[] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+        50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+        253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+        1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+        3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+        12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+    };
+    static constexpr int8_t INDEX_STEPS[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+private:
+    static const int8_t STEP_COUNT = sizeof(STEP_SIZES) / sizeof(STEP_SIZES[0]);
+    static const uint8_t TAPS = MicFrontEnd::TAPS_PER_PHASE * 2;
+    static const size_t BLOCK = 64;         // Input samples per inner pass
+
+    uint32_t inputRate = 16000;
+    AudioFormat format;
+    bool decimate = false;
+    int16_t history[TAPS * 2];              // Doubled, so the last TAPS are contiguous
+    uint8_t position = 0;
+    uint8_t phase = 0;
+    int16_t predictor = 0;
+    int8_t stepIndex = 0;
+
+    size_t halve(const int16_t* in, size_t count, int16_t* out) {
+        const int16_t* taps = MicFrontEnd::FIR_2;
+        size_t produced = 0;
+        for (size_t i = 0; i < count; i++) {
+            history[position] = in[i];
+            history[position + TAPS] = in[i];
+            if (++position == TAPS) position = 0;
+            if (++phase < 2) continue;
+            phase = 0;
+
+            const int16_t* window = history + position;
+            int32_t acc = 0;
+            for (uint8_t k = 0; k < TAPS; k++) {
+                acc += window[k] * taps[k];
+            }
+            acc = (acc + (1 << 14)) >> 15;
+            out[produced++] = acc > 32767 ? 32767 : acc < -32768 ? -32768 : (int16_t)acc;
+        }
+        return produced;
+    }
+
+    // Shared by the encoder and decoder so both track the same predictor
+    static int32_t step(int32_t value, int8_t& index, uint8_t nibble) {
+        int32_t size = STEP_SIZES[index];
+        int32_t delta = size >> 3;
+        if (nibble & 4) delta += size;
+        if (nibble & 2) delta += size >> 1;
+        if (nibble & 1) delta += size >> 2;
+        value += (nibble & 8) ? -delta : delta;
+        if (value > 32767) value = 32767;
+        if (value < -32768) value = -32768;
+        index += INDEX_STEPS[nibble & 7];
+        if (index < 0) index = 0;
+        if (index >= STEP_COUNT) index = STEP_COUNT - 1;
+        return value;
+    }
+
+    uint8_t encodeSample(int16_t sample) {
+        int32_t difference = sample - predictor;
+        uint8_t nibble = 0;
+        if (difference < 0) {
+            nibble = 8;
+            difference = -difference;
+        }
+        int32_t size = STEP_SIZES[stepIndex];
+        if (difference >= size) { nibble |= 4; difference -= size; }
+        size >>= 1;
+        if (difference >= size) { nibble |= 2; difference -= size; }
+        size >>= 1;
+        if (difference >= size) { nibble |= 1; }
+        predictor = (int16_t)step(predictor, stepIndex, nibble);
+        return nibble;
+    }
+};
+
+#endif
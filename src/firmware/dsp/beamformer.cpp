@@ -0,0 +1,174 @@
+#ifndef BEAMFORMER_H
+#define BEAMFORMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+// Delay-and-sum beamformer for a small microphone array on the temple,
+// steered at the wearer's mouth. Free of Arduino/ESP-IDF dependencies so it
+// builds on the host; the taps are designed once in configure() and the
+// per-sample path is integer-only.
+//
+// Speech from the mouth reaches channel 0 first and each following channel
+// mouthDelayUs later. Every channel goes through its own fractional-delay FIR
+// (windowed sinc) that lines the mouth up across channels, and the aligned
+// channels are averaged: the voice adds coherently, uncorrelated noise does
+// not (+3 dB SNR for two mics, +6 dB for four). The FIRs add a fixed latency
+// of about TAPS / 2 samples.
+//
+// With two or more channels the difference of the first two aligned channels
+// places a null on the mouth; its level is a noise estimate that does not
+// rise while the wearer talks, which the wake detector can use as a floor.
+struct BeamformerConfig {
+    uint8_t channels = 2;           // Interleaved input channels, up to MAX_CHANNELS
+    uint32_t sampleRate = 16000;
+    uint16_t mouthDelayUs = 44;     // Arrival delay between adjacent mics for the mouth
+};
+
+class Beamformer {
+public:
+    static const uint8_t MAX_CHANNELS = 4;
+    static const uint8_t TAPS = 8;                  // Per channel
+    static constexpr float MAX_SPREAD = 3.0f;       // Largest steering delay, in samples
+    static const uint8_t NOISE_SHIFT = 2;           // Noise level follows each block by 1/4
+    static const uint8_t BLOCK = 32;                // Frames per inner pass, sized for the stack
+
+    explicit Beamformer(const BeamformerConfig& config = BeamformerConfig()) {
+        configure(config);
+    }
+
+    void configure(const BeamformerConfig& newConfig) {
+        config = newConfig;
+        if (config.channels < 1) config.channels = 1;
+        if (config.channels > MAX_CHANNELS) config.channels = MAX_CHANNELS;
+
+        float step = (float)config.mouthDelayUs * config.sampleRate / 1000000.0f;
+        if (step * (config.channels - 1) > MAX_SPREAD) {
+            step = config.channels > 1 ? MAX_SPREAD / (config.channels - 1) : 0.0f;
+        }
+        // Centre the delays in the FIR span, where the interpolation is flattest
+        float spread = step * (config.channels - 1);
+        float base = (TAPS - 1) / 2.0f - spread / 2.0f;
+        for (uint8_t c = 0; c < config.channels; c++) {
+            // The first mic hears the mouth first, so it waits longest
+            design(taps[c], base + step * (config.channels - 1 - c));
+        }
+        reset();
+    }
+
+    void reset() {
+        memset(history, 0, sizeof(history));
+        noiseLevel = 0;
+    }
+
+    // Beams frames interleaved frames into frames mono samples. out may be the
+    // input buffer: samples are written only after their frames are read.
+    size_t process(const int16_t* in, size_t frames, int16_t* out) {
+        switch (config.channels) {
+            case 1: return run<1>(in, frames, out);
+            case 2: return run<2>(in, frames, out);
+            case 3: return run<3>(in, frames, out);
+            default: return run<4>(in, frames, out);
+        }
+    }
+
+    // Mean absolute level of the mouth-nulled difference beam, smoothed over
+    // blocks; 0 with a single channel
+    uint16_t getNoiseLevel() const { return noiseLevel > 65535 ? 65535 : (uint16_t)noiseLevel; }
+
+    const BeamformerConfig& getConfig() const { return config; }
+
+    const int16_t* getTaps(uint8_t channel) const { return taps[channel]; }
+
+private:
+    BeamformerConfig config;
+    int16_t taps[MAX_CHANNELS][TAPS];
+    int32_t history[MAX_CHANNELS][TAPS - 1];
+    int32_t noiseLevel = 0;
+
+    // Works through BLOCK frames at a time, one channel after the other, so
+    // each FIR reads a plain line of samples. The channel count is a template
+    // argument so the loops over channels unroll.
+    template <uint8_t CHANNELS>
+    size_t run(const int16_t* in, size_t frames, int16_t* out) {
+        // Locals, since out could alias the members as far as the compiler knows
+        int32_t coefficients[CHANNELS][TAPS];
+        for (uint8_t c = 0; c < CHANNELS; c++) {
+            for (uint8_t k = 0; k < TAPS; k++) {
+                coefficients[c][k] = taps[c][k];
+            }
+        }
+        const uint8_t second = CHANNELS > 1 ? 1 : 0;
+        uint32_t noiseSum = 0;
+
+        for (size_t start = 0; start < frames; start += BLOCK) {
+            size_t count = frames - start < BLOCK ? frames - start : BLOCK;
+            int32_t aligned[CHANNELS][BLOCK];
+
+            for (uint8_t c = 0; c < CHANNELS; c++) {
+                // The last TAPS - 1 samples of the previous block, then this one
+                int32_t line[TAPS - 1 + BLOCK];
+                memcpy(line, history[c], sizeof(history[c]));
+                for (size_t j = 0; j < count; j++) {
+                    line[TAPS - 1 + j] = in[(start + j) * CHANNELS + c];
+                }
+                for (size_t j = 0; j < count; j++) {
+                    int32_t acc = 0;
+                    for (uint8_t k = 0; k < TAPS; k++) {
+                        acc += line[j + k] * coefficients[c][k];
+                    }
+                    aligned[c][j] = acc;
+                }
+                memcpy(history[c], line + count, sizeof(history[c]));
+            }
+
+            // The whole block is read before any of it is written, so out may be in
+            for (size_t j = 0; j < count; j++) {
+                int32_t sum = 0;
+                for (uint8_t c = 0; c < CHANNELS; c++) {
+                    sum += aligned[c][j];
+                }
+                // Taps already carry the 1 / channels weight
+                int32_t beam = (sum + (1 << 14)) >> 15;
+                out[start + j] = beam > 32767 ? 32767 : beam < -32768 ? -32768 : (int16_t)beam;
+
+                if (CHANNELS > 1) {
+                    int32_t difference = (aligned[0][j] - aligned[second][j]) >> 15;
+                    noiseSum += difference < 0 ? -difference : difference;
+                }
+            }
+        }
+
+        if (CHANNELS > 1 && frames > 0) {
+            int32_t block = noiseSum / frames;
+            noiseLevel += (block - noiseLevel) >> NOISE_SHIFT;
+        }
+        return frames;
+    }
+
+    // Hann-windowed sinc delaying by delay samples (0 .. TAPS - 1), in Q15
+    // weighted by 1 / channels. Taps are stored oldest-first.
+    void design(int16_t* out, float delay) {
+        float h[TAPS];
+        float sum = 0;
+        for (uint8_t k = 0; k < TAPS; k++) {
+            float x = (float)k - delay;
+            float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf((float)M_PI * x) / ((float)M_PI * x);
+            float window = 0.5f + 0.5f * cosf((float)M_PI * x / (TAPS / 2.0f));
+            h[k] = fabsf(x) >= TAPS / 2.0f ? 0.0f : sinc * window;
+            sum += h[k];
+        }
+        // Unity gain at DC, rounded so the taps sum exactly to 32768 / channels
+        int32_t target = 32768 / config.channels;
+        int32_t total = 0;
+        for (uint8_t k = 0; k < TAPS; k++) {
+            out[TAPS - 1 - k] = (int16_t)lroundf(h[k] / sum * target);
+            total += out[TAPS - 1 - k];
+        }
+        out[TAPS / 2] += target - total;
+    }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef FIXED_FFT_H
+#define FIXED_FFT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+// In-place radix-2 complex FFT on int32 data with Q15 twiddles.
+// Free of Arduino/ESP-IDF dependencies so it builds on the host; the twiddle
+// table is computed once per size, the transforms are integer-only.
+//
+// forward() halves the data (rounded) at every stage, so its output is the
+// DFT / N and stays within the input range. inverse() does not scale, so
+// inverse(forward(x)) == x up to rounding, and its intermediates grow up to N
+// times: keep inputs within +/-2^20 for a round trip. Scale quiet blocks up
+// towards that bound before the transform; the rounding error is a few LSBs
+// whatever the level. Products use 64-bit intermediates.
+template <size_t N>
+class FixedFft {
+public:
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two");
+
+    static void forward(int32_t* re, int32_t* im) {
+        transform(re, im, false);
+    }
+
+    static void inverse(int32_t* re, int32_t* im) {
+        transform(re, im, true);
+    }
+
+    // Q15 cos / sin of 2 pi k / N for k < N / 2
+    static const int16_t* cosTable() { return tables().cos; }
+    static const int16_t* sinTable() { return tables().sin; }
+
+private:
+    struct Tables {
+        int16_t cos[N / 2];
+        int16_t sin[N / 2];
+
+        Tables() {
+            for (size_t k = 0; k < N / 2; k++) {
+                double angle = 2.0 * M_PI * k / N;
+                cos[k] = (int16_t)lround(fmin(32767.0, 32768.0 * ::cos(angle)));
+                sin[k] = (int16_t)lround(fmin(32767.0, 32768.0 * ::sin(angle)));
+            }
+        }
+    };
+
+    static const Tables& tables() {
+        static const Tables instance;
+        return instance;
+    }
+
+    static void transform(int32_t* re, int32_t* im, bool inverse) {
+        // Bit-reversed order first, then decimation-in-time butterflies
+        for (size_t i = 1, j = 0; i < N; i++) {
+            size_t bit = N >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j |= bit;
+            if (i < j) {
+                int32_t t = re[i]; re[i] = re[j]; re[j] = t;
+                t = im[i]; im[i] = im[j]; im[j] = t;
+            }
+        }
+
+        const Tables& t = tables();
+        const int shift = inverse ? 0 : 1;
+        for (size_t half = 1; half < N; half <<= 1) {
+            size_t step = N / (half * 2);
+            for (size_t start = 0; start < N; start += half * 2) {
+                for (size_t k = 0; k < half; k++) {
+                    // e^(-j 2 pi k / 2half) forward, e^(+j ...) inverse
+                    int32_t wr = t.cos[k * step];
+                    int32_t wi = inverse ? t.sin[k * step] : -t.sin[k * step];
+                    size_t a = start + k;
+                    size_t b = a + half;
+                    int32_t br = (int32_t)(((int64_t)re[b] * wr - (int64_t)im[b] * wi + (1 << 14)) >> 15);
+                    int32_t bi = (int32_t)(((int64_t)re[b] * wi + (int64_t)im[b] * wr + (1 << 14)) >> 15);
+                    int32_t ar = re[a];
+                    int32_t ai = im[a];
+                    re[a] = (ar + br + shift) >> shift;
+                    im[a] = (ai + bi + shift) >> shift;
+                    re[b] = (ar - br + shift) >> shift;
+                    im[b] = (ai - bi + shift) >> shift;
+                }
+            }
+        }
+    }
+};
+
+#endif
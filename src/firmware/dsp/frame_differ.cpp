@@ -0,0 +1,185 @@
+#ifndef FRAME_DIFFER_H
+#define FRAME_DIFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "jpeg_encoder.cpp"
+
+// Decides whether a camera frame shows something new, and where. Free of
+// Arduino/ESP-IDF dependencies so it builds on the host.
+//
+// A frame is reduced to a COLS x ROWS thumbnail, each cell the mean luma
+// and chroma of a 4x4 grid of samples from its area: 12k reads of a VGA
+// frame in PSRAM rather than 300k, and in YUYV the chroma sits in the same
+// cache lines as the luma. Against the thumbnail of the last frame sent,
+// after taking out the change in overall brightness (exposure settling,
+// a cloud), a cell has changed when its luma and chroma moved by more
+// than cellThreshold together. Chroma catches a red cup on a grey table of
+// the same brightness; sensor noise averages out over the 16 samples.
+//
+// A head never holds still, and a pixel of movement moves an edge across
+// a row of samples. A cell on an edge in the reference (a large step to a
+// neighbour) must therefore change by edgePercent of that step on top of
+// cellThreshold: that passes a pixel or two of jitter on a busy scene and
+// still sees an object put down on a plain table.
+//
+// The changed cells give the scene change: their number, and the box
+// around them in frame pixels, widened by a cell on every side and aligned
+// to the encoder's 16-pixel MCUs, for a region-of-interest crop.
+struct FrameDifferConfig {
+    uint8_t cellThreshold = 14;     // Luma plus chroma change of a changed cell
+    uint8_t edgePercent = 50;       // Of the cell's largest step to a neighbour, added to it
+};
+
+struct SceneChange {
+    uint16_t changedCells = 0;      // All of them without a reference
+    uint8_t changedPercent = 100;   // Of the cells, rounded up; 100 without a reference
+    uint8_t meanDiff = 255;         // Mean cell change, brightness removed
+    JpegRect region;                // Around the changed cells; empty if none
+};
+
+class FrameDiffer {
+public:
+    static const uint8_t COLS = 32;
+    static const uint8_t ROWS = 24;
+    static const uint16_t CELLS = COLS * ROWS;
+    static const uint16_t THUMB_BYTES = CELLS * 3;  // Y, then U, then V planes
+    static const uint8_t SAMPLES = 4;               // Per cell side
+    static const uint8_t ALIGN = 16;
+
+    explicit FrameDiffer(const FrameDifferConfig& config = FrameDifferConfig()) : config(config) {}
+
+    // Thumbnail of a frame, THUMB_BYTES, each plane row by row; a grey
+    // frame has neutral chroma
+    static void thumbnail(const JpegImage& image, uint8_t* thumb) {
+        bool colour = image.format == JPEG_INPUT_YUYV;
+        uint8_t step = colour ? 2 : 1;
+        for (uint8_t row = 0; row < ROWS; row++) {
+            uint32_t y0 = (uint32_t)row * image.height / ROWS;
+            uint32_t cellHeight = (uint32_t)(row + 1) * image.height / ROWS - y0;
+            for (uint8_t col = 0; col < COLS; col++) {
+                uint32_t x0 = (uint32_t)col * image.width / COLS;
+                uint32_t cellWidth = (uint32_t)(col + 1) * image.width / COLS - x0;
+                uint32_t sum = 0, sumU = 0, sumV = 0;
+                for (uint8_t sy = 0; sy < SAMPLES; sy++) {
+                    const uint8_t* line = image.pixels + (y0 + (2 * sy + 1) * cellHeight / (2 * SAMPLES)) * image.stride;
+                    for (uint8_t sx = 0; sx < SAMPLES; sx++) {
+                        uint32_t x = x0 + (2 * sx + 1) * cellWidth / (2 * SAMPLES);
+                        sum += line[x * step];
+                        if (colour) {
+                            const uint8_t* pair = line + (x & ~1u) * 2;     // Y0 U Y1 V
+                            sumU += pair[1];
+                            sumV += pair[3];
+                        }
+                    }
+                }
+                uint16_t cell = row * COLS + col;
+                const uint16_t n = SAMPLES * SAMPLES;
+                thumb[cell] = (sum + n / 2) / n;
+                thumb[CELLS + cell] = colour ? (sumU + n / 2) / n : 128;
+                thumb[2 * CELLS + cell] = colour ? (sumV + n / 2) / n : 128;
+            }
+        }
+    }
+
+    void setReference(const uint8_t* thumb) {
+        memcpy(reference, thumb, THUMB_BYTES);
+        for (uint8_t row = 0; row < ROWS; row++) {
+            for (uint8_t col = 0; col < COLS; col++) {
+                uint16_t cell = row * COLS + col;
+                uint16_t step = 0;
+                if (col > 0) step = max16(step, distance(thumb, cell, thumb, cell - 1, 0));
+                if (col + 1 < COLS) step = max16(step, distance(thumb, cell, thumb, cell + 1, 0));
+                if (row > 0) step = max16(step, distance(thumb, cell, thumb, cell - COLS, 0));
+                if (row + 1 < ROWS) step = max16(step, distance(thumb, cell, thumb, cell + COLS, 0));
+                uint32_t extra = (uint32_t)step * config.edgePercent / 100;
+                edges[cell] = extra > 255 ? 255 : extra;
+            }
+        }
+        hasReference = true;
+    }
+
+    void clearReference() {
+        hasReference = false;
+    }
+
+    bool hasReferenceFrame() const {
+        return hasReference;
+    }
+
+    // The change from the reference to thumb, for a frame of width x height
+    SceneChange compare(const uint8_t* thumb, uint16_t width, uint16_t height) const {
+        SceneChange change;
+        if (!hasReference) {
+            change.changedCells = CELLS;
+            change.region.width = width;
+            change.region.height = height;
+            return change;
+        }
+        int32_t shift = 0;
+        for (uint16_t i = 0; i < CELLS; i++) {
+            shift += (int32_t)thumb[i] - reference[i];
+        }
+        shift /= (int32_t)CELLS;
+
+        uint16_t changed = 0;
+        uint32_t total = 0;
+        uint8_t minCol = COLS, maxCol = 0, minRow = ROWS, maxRow = 0;
+        for (uint8_t row = 0; row < ROWS; row++) {
+            for (uint8_t col = 0; col < COLS; col++) {
+                uint16_t cell = row * COLS + col;
+                uint16_t diff = distance(thumb, cell, reference, cell, shift);
+                total += diff;
+                if (diff > config.cellThreshold + edges[cell]) {
+                    changed++;
+                    if (col < minCol) minCol = col;
+                    if (col > maxCol) maxCol = col;
+                    if (row < minRow) minRow = row;
+                    if (row > maxRow) maxRow = row;
+                }
+            }
+        }
+        change.changedCells = changed;
+        change.changedPercent = (uint8_t)((changed * 100 + CELLS - 1) / CELLS);
+        uint32_t mean = total / CELLS;
+        change.meanDiff = mean > 255 ? 255 : mean;
+        if (changed == 0) return change;
+
+        minCol = minCol > 0 ? minCol - 1 : 0;
+        minRow = minRow > 0 ? minRow - 1 : 0;
+        maxCol = maxCol + 1 < COLS ? maxCol + 1 : COLS - 1;
+        maxRow = maxRow + 1 < ROWS ? maxRow + 1 : ROWS - 1;
+        uint32_t x0 = (uint32_t)minCol * width / COLS / ALIGN * ALIGN;
+        uint32_t y0 = (uint32_t)minRow * height / ROWS / ALIGN * ALIGN;
+        uint32_t x1 = ((uint32_t)(maxCol + 1) * width / COLS + ALIGN - 1) / ALIGN * ALIGN;
+        uint32_t y1 = ((uint32_t)(maxRow + 1) * height / ROWS + ALIGN - 1) / ALIGN * ALIGN;
+        if (x1 > width) x1 = width;
+        if (y1 > height) y1 = height;
+        change.region.x = x0;
+        change.region.y = y0;
+        change.region.width = x1 - x0;
+        change.region.height = y1 - y0;
+        return change;
+    }
+
+private:
+    FrameDifferConfig config;
+    uint8_t reference[THUMB_BYTES];
+    uint8_t edges[CELLS];           // Extra threshold per cell, from the reference
+    bool hasReference = false;
+
+    // Luma (less a brightness shift) plus chroma distance between two cells
+    static uint16_t distance(const uint8_t* a, uint16_t i, const uint8_t* b, uint16_t j, int32_t shift) {
+        int32_t y = (int32_t)a[i] - b[j] - shift;
+        int32_t u = (int32_t)a[CELLS + i] - b[CELLS + j];
+        int32_t v = (int32_t)a[2 * CELLS + i] - b[2 * CELLS + j];
+        return (y < 0 ? -y : y) + (u < 0 ? -u : u) + (v < 0 ? -v : v);
+    }
+
+    static uint16_t max16(uint16_t a, uint16_t b) {
+        return a > b ? a : b;
+    }
+};
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef INTENT_MATCHER_H
+#define INTENT_MATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "mfcc.cpp"
+#include "audio_codec.cpp"
+#include "../utils/asset_pack.cpp"
+
+// Recognizes a small fixed vocabulary of spoken commands by dynamic time
+// warping over MFCCs, so the glasses can act on them without the server.
+// Free of Arduino/ESP-IDF dependencies so it builds on the host.
+//
+// Each command has one or more templates: recordings run through the same
+// extractor and endpointing at load (addTemplate()), stored as int8 frames in
+// a fixed pool. An utterance streams in through process():
+// - endpointing: startFrames frames in a row speechQ8 above a floor that
+//   follows the energy while nothing is spoken start the utterance;
+//   hangoverMs of frames under holdQ8 above it, or dropQ8 under the loudest
+//   frame (the enhancer's AGC lifts the noise behind quiet speech), end it
+// - longer than maxSpeechMs, or shorter than minSpeechMs, it is rejected:
+//   not a command, the server gets it
+// - otherwise both sides are normalized per coefficient (cepstral mean
+//   subtraction, so microphone and room drop out, and scaled to a common
+//   mean deviation, so noise that flattens the cepstrum does not) and
+//   compared with DTW in a Sakoe-Chiba band, distances normalized by the
+//   path length
+// The best command wins if its distance is under acceptDistance and clearly
+// below the runner-up (marginQ8); anything else is rejected. Once matched or
+// rejected, further audio is ignored until reset().
+struct IntentMatcherConfig {
+    MfccConfig mfcc;
+    uint16_t speechQ8 = 3 * 256;        // Over the floor that starts speech: 9 dB
+    uint16_t holdQ8 = 3 * 128;          // and that keeps it going: 4.5 dB
+    uint16_t dropQ8 = 5 * 256;          // if within 15 dB of the loudest frame so far
+    uint8_t floorShift = 3;             // Floor moves 1/8 of the way per frame under holdQ8
+    uint8_t startFrames = 3;
+    uint16_t hangoverMs = 150;
+    uint16_t minSpeechMs = 200;
+    uint16_t maxSpeechMs = 1500;
+    uint16_t acceptDistance = 310;      // Mean L1 distance per frame pair
+    uint16_t marginQ8 = 230;            // Best must be under 0.9 x the runner-up
+};
+
+class IntentMatcher {
+public:
+    static const uint8_t COEFFS = MfccFrame::COEFFS;
+    static const uint8_t MAX_TEMPLATES = 16;
+    static const size_t POOL_FRAMES = 1024;         // 10 s of templates in all
+    static const size_t MAX_FRAMES = 192;           // Utterance, with padding and hangover
+    static const uint8_t PAD_FRAMES = 2;            // Kept either side of the endpoints
+    static const int8_t SPREAD = 32;                // Mean deviation of each normalized coefficient
+    static const size_t MAX_BLOCK_SAMPLES = 256;    // Pack recordings, per ADPCM block
+    static const uint8_t NO_LABEL = 0xFF;
+
+    enum State : uint8_t {
+        WAITING,        // No speech yet
+        SPEAKING,
+        MATCHED,        // getLabel() was said
+        REJECTED        // Too short, too long or not close to any command
+    };
+
+    explicit IntentMatcher(const IntentMatcherConfig& config = IntentMatcherConfig()) {
+        configure(config);
+    }
+
+    void configure(const IntentMatcherConfig& newConfig) {
+        config = newConfig;
+        mfcc.configure(config.mfcc);
+        size_t frameRate = config.mfcc.sampleRate / mfcc.getHop();
+        hangoverFrames = config.hangoverMs * frameRate / 1000;
+        minSpeechFrames = config.minSpeechMs * frameRate / 1000;
+        maxSpeechFrames = config.maxSpeechMs * frameRate / 1000;
+        if (maxSpeechFrames + hangoverFrames + 2 * PAD_FRAMES + config.startFrames > MAX_FRAMES) {
+            maxSpeechFrames = MAX_FRAMES - hangoverFrames - 2 * PAD_FRAMES - config.startFrames;
+        }
+        clearTemplates();
+    }
+
+    void clearTemplates() {
+        templateCount = 0;
+        poolUsed = 0;
+        reset();
+    }
+
+    // Extracts and stores a command template from a recording of it; false
+    // if it holds no usable speech or the pool is full
+    bool addTemplate(uint8_t label, const int16_t* samples, size_t count) {
+        if (!startTemplate(label)) {
+            return false;
+        }
+        process(samples, count);
+        return storeTemplate(label);
+    }
+
+    // The same from a recording in the asset pack, decoded a block at a time
+    bool addTemplate(uint8_t label, const AssetPrompt& prompt) {
+        if (!prompt || prompt.header->sampleRate != config.mfcc.sampleRate ||
+            (prompt.header->codec != CODEC_PCM16 && prompt.header->blockSamples > MAX_BLOCK_SAMPLES) ||
+            !startTemplate(label)) {
+            return false;
+        }
+        int16_t decoded[MAX_BLOCK_SAMPLES];
+        for (uint32_t index = 0; index < prompt.blocks(); index++) {
+            size_t length;
+            const uint8_t* block = prompt.block(index, length);
+            if (prompt.header->codec == CODEC_PCM16) {
+                process((const int16_t*)block, length / sizeof(int16_t));
+            } else {
+                process(decoded, AudioEncoder::decodeAdpcm(block, length, decoded));
+            }
+        }
+        return storeTemplate(label);
+    }
+
+    uint8_t getTemplateCount() const {
+        return templateCount;
+    }
+
+    size_t getTemplateFrames() const {
+        return poolUsed;
+    }
+
+    // Starts a new utterance
+    void reset() {
+        mfcc.reset();
+        state = WAITING;
+        label = NO_LABEL;
+        frameCount = 0;
+        floor = INT32_MAX;
+        peak = 0;
+        speechRun = 0;
+        silenceRun = 0;
+        speechStart = 0;
+        speechEnd = 0;
+        bestDistance = UINT32_MAX;
+        runnerUpDistance = UINT32_MAX;
+        closestLabel = NO_LABEL;
+    }
+
+    State process(const int16_t* samples, size_t count) {
+        while (count > 0 && (state == WAITING || state == SPEAKING)) {
+            // One hop at a time, so a decision stops the rest at once
+            size_t n = count < mfcc.getHop() ? count : mfcc.getHop();
+            MfccFrame frame;
+            if (mfcc.process(samples, n, &frame, 1) == 1) {
+                onFrame(frame);
+            }
+            samples += n;
+            count -= n;
+        }
+        return state;
+    }
+
+    // The recording ended: an utterance still being spoken is judged as it is
+    State finish() {
+        if (state == SPEAKING) {
+            endUtterance(frameCount);
+        }
+        return state;
+    }
+
+    State getState() const { return state; }
+    uint8_t getLabel() const { return label; }
+
+    // Diagnostics for the last decision
+    uint32_t getBestDistance() const { return bestDistance; }
+    uint32_t getRunnerUpDistance() const { return runnerUpDistance; }
+    uint8_t getClosestLabel() const { return closestLabel; }
+    size_t getSpeechFrames() const { return speechEnd > speechStart ? speechEnd - speechStart : 0; }
+    size_t getFrameCount() const { return frameCount; }
+
+private:
+    bool startTemplate(uint8_t label) {
+        if (templateCount >= MAX_TEMPLATES || label == NO_LABEL) {
+            return false;
+        }
+        reset();
+        enrolling = true;
+        return true;
+    }
+
+    bool storeTemplate(uint8_t label) {
+        finish();
+        enrolling = false;
+        size_t length = getSpeechFrames();
+        if (length < minSpeechFrames || poolUsed + length > POOL_FRAMES) {
+            reset();
+            return false;
+        }
+        normalize(speechStart, speechEnd);
+        Template& t = templates[templateCount++];
+        t.label = label;
+        t.offset = poolUsed;
+        t.frames = length;
+        for (size_t i = 0; i < length; i++) {
+            for (uint8_t k = 0; k < COEFFS; k++) {
+                pool[poolUsed + i][k] = (int8_t)frames[speechStart + i].c[k];
+            }
+        }
+        poolUsed += length;
+        reset();
+        return true;
+    }
+
+    struct Template {
+        uint8_t label;
+        uint16_t offset;
+        uint16_t frames;
+    };
+
+    IntentMatcherConfig config;
+    MfccExtractor mfcc;
+    size_t hangoverFrames = 10;
+    size_t minSpeechFrames = 20;
+    size_t maxSpeechFrames = 150;
+
+    Template templates[MAX_TEMPLATES];
+    uint8_t templateCount = 0;
+    int8_t pool[POOL_FRAMES][COEFFS];
+    size_t poolUsed = 0;
+
+    State state = WAITING;
+    uint8_t label = NO_LABEL;
+    bool enrolling = false;             // addTemplate() endpoints without matching
+    MfccFrame frames[MAX_FRAMES];       // From PAD_FRAMES before the speech on
+    size_t frameCount = 0;
+    int32_t floor = INT32_MAX;
+    int32_t peak = 0;                   // Loudest frame of the utterance
+    size_t speechRun = 0;
+    size_t silenceRun = 0;
+    size_t speechStart = 0;
+    size_t speechEnd = 0;
+    uint32_t bestDistance = UINT32_MAX;
+    uint32_t runnerUpDistance = UINT32_MAX;
+    uint8_t closestLabel = NO_LABEL;
+    uint32_t rows[2][MAX_FRAMES + 1];   // DTW, two rows of the cost matrix
+
+    void onFrame(const MfccFrame& frame) {
+        bool quiet = floor == INT32_MAX || frame.energy <= floor + config.holdQ8;
+        bool speech = !quiet && (state == SPEAKING ? frame.energy + config.dropQ8 > peak
+                                                   : frame.energy > floor + config.speechQ8);
+
+        if (state == WAITING) {
+            // Quiet frames move the floor towards their energy; a rising
+            // onset, under speechQ8 as it may still be, leaves it alone
+            if (quiet) {
+                floor = floor == INT32_MAX ? frame.energy : floor + ((frame.energy - floor) >> config.floorShift);
+            }
+            // Only the frames that may become the padded start are kept
+            size_t keep = config.startFrames + PAD_FRAMES;
+            if (frameCount >= keep) {
+                memmove(frames, frames + 1, (keep - 1) * sizeof(frames[0]));
+                frameCount = keep - 1;
+            }
+            frames[frameCount++] = frame;
+            speechRun = speech ? speechRun + 1 : 0;
+            if (speechRun >= config.startFrames) {
+                state = SPEAKING;
+                peak = frame.energy;
+                speechStart = frameCount - speechRun >= PAD_FRAMES ? frameCount - speechRun - PAD_FRAMES : 0;
+                silenceRun = 0;
+            }
+            return;
+        }
+
+        if (frameCount >= MAX_FRAMES) {
+            reject();
+            return;
+        }
+        frames[frameCount++] = frame;
+        if (frame.energy > peak) peak = frame.energy;
+        silenceRun = speech ? 0 : silenceRun + 1;
+        if (silenceRun >= hangoverFrames) {
+            endUtterance(frameCount - silenceRun + PAD_FRAMES);
+        } else if (frameCount - speechStart > maxSpeechFrames + 2 * PAD_FRAMES) {
+            reject();
+        }
+    }
+
+    void reject() {
+        state = REJECTED;
+        label = NO_LABEL;
+    }
+
+    void endUtterance(size_t end) {
+        speechEnd = end < frameCount ? end : frameCount;
+        size_t length = speechEnd - speechStart;
+        if (length < minSpeechFrames || length > maxSpeechFrames + 2 * PAD_FRAMES) {
+            reject();
+            return;
+        }
+        state = REJECTED;
+        if (!enrolling && templateCount > 0) {
+            match();
+        }
+    }
+
+    // Cepstral mean subtraction and scaling to SPREAD, then int8 in place
+    void normalize(size_t start, size_t end) {
+        size_t length = end - start;
+        for (uint8_t k = 0; k < COEFFS; k++) {
+            int32_t sum = 0;
+            for (size_t i = start; i < end; i++) sum += frames[i].c[k];
+            int32_t mean = sum / (int32_t)length;
+            int32_t deviation = 0;
+            for (size_t i = start; i < end; i++) deviation += abs(frames[i].c[k] - mean);
+            deviation = deviation / (int32_t)length + 1;
+            for (size_t i = start; i < end; i++) {
+                int32_t v = (frames[i].c[k] - mean) * SPREAD / deviation;
+                frames[i].c[k] = (int16_t)(v > 127 ? 127 : v < -127 ? -127 : v);
+            }
+        }
+    }
+
+    void match() {
+        normalize(speechStart, speechEnd);
+        uint32_t best[MAX_TEMPLATES] = {};
+        uint8_t labels[MAX_TEMPLATES] = {};
+        uint8_t distinct = 0;
+        for (uint8_t t = 0; t < templateCount; t++) {
+            uint32_t d = distance(templates[t]);
+            uint8_t i = 0;
+            while (i < distinct && labels[i] != templates[t].label) i++;
+            if (i == distinct) {
+                labels[distinct] = templates[t].label;
+                best[distinct++] = d;
+            } else if (d < best[i]) {
+                best[i] = d;
+            }
+        }
+        uint8_t winner = 0;
+        for (uint8_t i = 1; i < distinct; i++) {
+            if (best[i] < best[winner]) winner = i;
+        }
+        bestDistance = best[winner];
+        closestLabel = labels[winner];
+        for (uint8_t i = 0; i < distinct; i++) {
+            if (i != winner && best[i] < runnerUpDistance) runnerUpDistance = best[i];
+        }
+        bool clear = runnerUpDistance == UINT32_MAX ||
+                     (uint64_t)bestDistance * 256 <= (uint64_t)runnerUpDistance * config.marginQ8;
+        if (bestDistance <= config.acceptDistance && clear) {
+            state = MATCHED;
+            label = labels[winner];
+        }
+    }
+
+    // Symmetric DTW (diagonal steps count twice) over the band, divided by
+    // the path length n + m; UINT32_MAX when one is over 1.5x the other
+    uint32_t distance(const Template& t) {
+        const MfccFrame* u = frames + speechStart;
+        size_t n = speechEnd - speechStart;
+        size_t m = t.frames;
+        if (2 * n > 3 * m || 2 * m > 3 * n) {
+            return UINT32_MAX;
+        }
+        const int8_t (*v)[COEFFS] = pool + t.offset;
+        size_t band = (n > m ? n : m) / 8 + 2;
+        const uint32_t INF = UINT32_MAX / 2;
+
+        uint32_t* previous = rows[0];
+        uint32_t* current = rows[1];
+        for (size_t j = 0; j <= m; j++) previous[j] = INF;
+        previous[0] = 0;
+        for (size_t i = 1; i <= n; i++) {
+            // Band around the diagonal from (0, 0) to (n, m)
+            size_t centre = i * m / n;
+            size_t from = centre > band ? centre - band : 1;
+            size_t to = centre + band < m ? centre + band : m;
+            if (from < 1) from = 1;
+            for (size_t j = 0; j <= m; j++) current[j] = INF;
+            for (size_t j = from; j <= to; j++) {
+                uint32_t cost = 0;
+                for (uint8_t k = 0; k < COEFFS; k++) {
+                    int32_t diff = u[i - 1].c[k] - v[j - 1][k];
+                    cost += diff < 0 ? -diff : diff;
+                }
+                uint32_t diagonal = previous[j - 1] + 2 * cost;
+                uint32_t up = previous[j] + cost;
+                uint32_t left = current[j - 1] + cost;
+                uint32_t step = diagonal < up ? diagonal : up;
+                current[j] = step < left ? step : left;
+            }
+            uint32_t* swap = previous;
+            previous = current;
+            current = swap;
+        }
+        uint32_t total = previous[m];
+        return total >= INF ? UINT32_MAX : total / (uint32_t)(n + m);
+    }
+};
+
+#endif
@@ -0,0 +1,482 @@
+#ifndef JPEG_ENCODER_H
+#define JPEG_ENCODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Baseline JPEG encoder for camera frames. Free of Arduino/ESP-IDF
+// dependencies so it builds on the host; modules/vision_module.cpp runs it on
+// the camera's frame buffers.
+//
+// The S3 has no JPEG peripheral, and a sensor that encodes on chip (OV2640)
+// hands over only the compressed frame, which cannot be compared or cropped
+// cheaply. So the sensor delivers YUV 4:2:2, and only the region that goes
+// to the server is encoded: read in place from the frame buffer, written
+// into a caller's buffer, nothing else allocated.
+//
+// Colour frames come out as YCbCr 4:2:0 (16x16 MCUs), grey ones as a single
+// component. The DCT is the AAN float version (the S3 has a single-precision
+// FPU), with the quantizer scaling folded into one divisor table per
+// component. Huffman tables are the standard ones from Annex K.
+enum JpegInput : uint8_t {
+    JPEG_INPUT_YUYV,        // Y0 U Y1 V, 2 bytes per pixel, as the camera's YUV422 mode
+    JPEG_INPUT_GRAY         // 1 byte per pixel
+};
+
+struct JpegImage {
+    const uint8_t* pixels = nullptr;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint32_t stride = 0;            // Bytes per row
+    JpegInput format = JPEG_INPUT_YUYV;
+};
+
+struct JpegRect {
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+
+    uint32_t area() const { return (uint32_t)width * height; }
+};
+
+// Constant tables, shared by every encoder
+namespace JpegTables {
+struct HuffmanSpec {
+    const uint8_t* counts;      // Codes of each length 1-16
+    const uint8_t* symbols;
+    uint8_t symbolCount;
+};
+
+struct HuffmanCode {
+    uint16_t code = 0;
+    uint8_t length = 0;
+};
+
+// Canonical codes from a table spec, indexed by symbol
+struct HuffmanTable {
+    HuffmanCode codes[256];
+
+    constexpr HuffmanTable(const HuffmanSpec& spec) : codes() {
+        uint16_t code = 0;
+        int symbol = 0;
+        for (int length = 1; length <= 16; length++) {
+            for (int i = 0; i < spec.counts[length - 1]; i++) {
+                codes[spec.symbols[symbol++]] = HuffmanCode{ code++, (uint8_t)length };
+            }
+            code <<= 1;
+        }
+    }
+};
+
+inline constexpr uint8_t ZIGZAG[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Zigzag position of each natural-order coefficient
+inline constexpr uint8_t ZIGZAG_INVERSE[64] = {
+     0,  1,  5,  6, 14, 15, 27, 28,  2,  4,  7, 13, 16, 26, 29, 42,
+     3,  8, 12, 17, 25, 30, 41, 43,  9, 11, 18, 24, 31, 40, 44, 53,
+    10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63
+};
+
+// Annex K tables, zigzag order
+inline constexpr uint8_t LUMA_QUANT[64] = {
+    16, 11, 12, 14, 12, 10, 16, 14, 13, 14, 18, 17, 16, 19, 24, 40,
+    26, 24, 22, 22, 24, 49, 35, 37, 29, 40, 58, 51, 61, 60, 57, 51,
+    56, 55, 64, 72, 92, 78, 64, 68, 87, 69, 55, 56, 80, 109, 81, 87,
+    95, 98, 103, 104, 103, 62, 77, 113, 121, 112, 100, 120, 92, 101, 103, 99
+};
+inline constexpr uint8_t CHROMA_QUANT[64] = {
+    17, 18, 18, 24, 21, 24, 47, 26, 26, 47, 99, 66, 56, 66, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+inline constexpr float AAN_SCALE[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+inline constexpr uint8_t DC_LUMA_COUNTS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+inline constexpr uint8_t DC_CHROMA_COUNTS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+inline constexpr uint8_t DC_SYMBOLS[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+inline constexpr uint8_t AC_LUMA_COUNTS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+inline constexpr uint8_t AC_LUMA_SYMBOLS[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+inline constexpr uint8_t AC_CHROMA_COUNTS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+inline constexpr uint8_t AC_CHROMA_SYMBOLS[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+inline constexpr HuffmanSpec DC_LUMA_SPEC = { DC_LUMA_COUNTS, DC_SYMBOLS, 12 };
+inline constexpr HuffmanSpec DC_CHROMA_SPEC = { DC_CHROMA_COUNTS, DC_SYMBOLS, 12 };
+inline constexpr HuffmanSpec AC_LUMA_SPEC = { AC_LUMA_COUNTS, AC_LUMA_SYMBOLS, 162 };
+inline constexpr HuffmanSpec AC_CHROMA_SPEC = { AC_CHROMA_COUNTS, AC_CHROMA_SYMBOLS, 162 };
+
+inline constexpr HuffmanTable DC_LUMA_TABLE{ DC_LUMA_SPEC };
+inline constexpr HuffmanTable DC_CHROMA_TABLE{ DC_CHROMA_SPEC };
+inline constexpr HuffmanTable AC_LUMA_TABLE{ AC_LUMA_SPEC };
+inline constexpr HuffmanTable AC_CHROMA_TABLE{ AC_CHROMA_SPEC };
+inline constexpr const HuffmanCode* DC_LUMA = DC_LUMA_TABLE.codes;
+inline constexpr const HuffmanCode* DC_CHROMA = DC_CHROMA_TABLE.codes;
+inline constexpr const HuffmanCode* AC_LUMA = AC_LUMA_TABLE.codes;
+inline constexpr const HuffmanCode* AC_CHROMA = AC_CHROMA_TABLE.codes;
+}
+
+class JpegEncoder {
+public:
+    static const uint8_t MIN_QUALITY = 1;
+    static const uint8_t MAX_QUALITY = 100;
+
+    JpegEncoder() {
+        setQuality(75);
+    }
+
+    // IJG quality scale: 50 is the Annex K tables, 100 all ones
+    void setQuality(uint8_t newQuality) {
+        if (newQuality < MIN_QUALITY) newQuality = MIN_QUALITY;
+        if (newQuality > MAX_QUALITY) newQuality = MAX_QUALITY;
+        quality = newQuality;
+        int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+        for (int i = 0; i < 64; i++) {
+            quantLuma[i] = scaled(JpegTables::LUMA_QUANT[i], scale);
+            quantChroma[i] = scaled(JpegTables::CHROMA_QUANT[i], scale);
+        }
+        // Divisors in natural order, with the AAN output scaling folded in
+        for (int i = 0; i < 64; i++) {
+            int row = i >> 3, col = i & 7;
+            float aan = JpegTables::AAN_SCALE[row] * JpegTables::AAN_SCALE[col] * 8.0f;
+            divisorLuma[i] = 1.0f / (quantLuma[JpegTables::ZIGZAG_INVERSE[i]] * aan);
+            divisorChroma[i] = 1.0f / (quantChroma[JpegTables::ZIGZAG_INVERSE[i]] * aan);
+        }
+    }
+
+    uint8_t getQuality() const {
+        return quality;
+    }
+
+    // Encodes rect of image (clipped to it) into out. Returns the JPEG's
+    // length, or 0 if the image is unusable or out is too small.
+    size_t encode(const JpegImage& image, JpegRect rect, uint8_t* out, size_t capacity) {
+        if (image.pixels == nullptr || out == nullptr) return 0;
+        if (rect.width == 0 || rect.height == 0) {
+            rect.x = rect.y = 0;
+            rect.width = image.width;
+            rect.height = image.height;
+        }
+        if (rect.x >= image.width || rect.y >= image.height) return 0;
+        if (rect.x + rect.width > image.width) rect.width = image.width - rect.x;
+        if (rect.y + rect.height > image.height) rect.height = image.height - rect.y;
+
+        bool colour = image.format == JPEG_INPUT_YUYV;
+        if (colour) {
+            // Chroma pairs start on even columns
+            if (rect.x & 1) {
+                rect.x--;
+                rect.width++;
+            }
+        }
+        source = image;
+        area = rect;
+        writer = Writer{ out, capacity, 0, 0, 0, false };
+
+        writeHeaders(colour);
+        int lastDc[3] = { 0, 0, 0 };
+        int16_t block[64];
+        uint8_t mcu = colour ? 16 : 8;
+        for (uint16_t y = 0; y < rect.height; y += mcu) {
+            for (uint16_t x = 0; x < rect.width; x += mcu) {
+                if (colour) {
+                    for (uint8_t b = 0; b < 4; b++) {
+                        loadLuma(x + (b & 1) * 8, y + (b >> 1) * 8, block);
+                        encodeBlock(block, divisorLuma, lastDc[0], JpegTables::DC_LUMA, JpegTables::AC_LUMA);
+                    }
+                    loadChroma(x, y, 1, block);
+                    encodeBlock(block, divisorChroma, lastDc[1], JpegTables::DC_CHROMA, JpegTables::AC_CHROMA);
+                    loadChroma(x, y, 3, block);
+                    encodeBlock(block, divisorChroma, lastDc[2], JpegTables::DC_CHROMA, JpegTables::AC_CHROMA);
+                } else {
+                    loadLuma(x, y, block);
+                    encodeBlock(block, divisorLuma, lastDc[0], JpegTables::DC_LUMA, JpegTables::AC_LUMA);
+                }
+                if (writer.overflow) return 0;
+            }
+        }
+        flushBits();
+        putByte(0xFF);
+        putByte(0xD9);
+        return writer.overflow ? 0 : writer.length;
+    }
+
+private:
+    struct Writer {
+        uint8_t* out;
+        size_t capacity;
+        size_t length;
+        uint32_t bits;
+        uint8_t count;
+        bool overflow;
+    };
+
+    uint8_t quality = 0;
+    uint8_t quantLuma[64];          // Zigzag order, as in DQT
+    uint8_t quantChroma[64];
+    float divisorLuma[64];          // Natural order
+    float divisorChroma[64];
+    JpegImage source;
+    JpegRect area;
+    Writer writer;
+
+    static uint8_t scaled(uint8_t base, int scale) {
+        int value = (base * scale + 50) / 100;
+        return value < 1 ? 1 : value > 255 ? 255 : value;
+    }
+
+    // Edge blocks repeat the last row and column of the region
+    int lumaAt(int x, int y) const {
+        if (x >= area.width) x = area.width - 1;
+        if (y >= area.height) y = area.height - 1;
+        const uint8_t* row = source.pixels + (size_t)(area.y + y) * source.stride;
+        return source.format == JPEG_INPUT_YUYV ? row[(area.x + x) * 2] : row[area.x + x];
+    }
+
+    void loadLuma(int x0, int y0, int16_t* block) const {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                block[y * 8 + x] = lumaAt(x0 + x, y0 + y) - 128;
+            }
+        }
+    }
+
+    // One chroma sample per 2x2 pixels: the pair's U (offset 1) or V
+    // (offset 3), averaged over two rows
+    void loadChroma(int x0, int y0, int offset, int16_t* block) const {
+        int lastPair = (area.width - 1) / 2;
+        for (int y = 0; y < 8; y++) {
+            int row0 = y0 + y * 2;
+            int row1 = row0 + 1;
+            if (row0 >= area.height) row0 = area.height - 1;
+            if (row1 >= area.height) row1 = area.height - 1;
+            const uint8_t* top = source.pixels + (size_t)(area.y + row0) * source.stride + area.x * 2;
+            const uint8_t* bottom = source.pixels + (size_t)(area.y + row1) * source.stride + area.x * 2;
+            for (int x = 0; x < 8; x++) {
+                int pair = x0 / 2 + x;
+                if (pair > lastPair) pair = lastPair;
+                block[y * 8 + x] = ((top[pair * 4 + offset] + bottom[pair * 4 + offset] + 1) >> 1) - 128;
+            }
+        }
+    }
+
+    // AAN forward DCT, rows then columns; outputs are scaled by the divisors
+    static void forwardDct(const int16_t* input, float* data) {
+        for (int i = 0; i < 64; i++) data[i] = input[i];
+        for (int pass = 0; pass < 2; pass++) {
+            int step = pass == 0 ? 1 : 8;       // Along a row, then down a column
+            int next = pass == 0 ? 8 : 1;
+            for (int line = 0; line < 8; line++) {
+                float* p = data + line * next;
+                float tmp0 = p[0] + p[7 * step], tmp7 = p[0] - p[7 * step];
+                float tmp1 = p[step] + p[6 * step], tmp6 = p[step] - p[6 * step];
+                float tmp2 = p[2 * step] + p[5 * step], tmp5 = p[2 * step] - p[5 * step];
+                float tmp3 = p[3 * step] + p[4 * step], tmp4 = p[3 * step] - p[4 * step];
+
+                float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+                float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+                p[0] = tmp10 + tmp11;
+                p[4 * step] = tmp10 - tmp11;
+                float z1 = (tmp12 + tmp13) * 0.707106781f;
+                p[2 * step] = tmp13 + z1;
+                p[6 * step] = tmp13 - z1;
+
+                tmp10 = tmp4 + tmp5;
+                tmp11 = tmp5 + tmp6;
+                tmp12 = tmp6 + tmp7;
+                float z5 = (tmp10 - tmp12) * 0.382683433f;
+                float z2 = 0.541196100f * tmp10 + z5;
+                float z4 = 1.306562965f * tmp12 + z5;
+                float z3 = tmp11 * 0.707106781f;
+                float z11 = tmp7 + z3, z13 = tmp7 - z3;
+                p[5 * step] = z13 + z2;
+                p[3 * step] = z13 - z2;
+                p[step] = z11 + z4;
+                p[7 * step] = z11 - z4;
+            }
+        }
+    }
+
+    void encodeBlock(const int16_t* pixels, const float* divisors, int& lastDc,
+                     const JpegTables::HuffmanCode* dcCodes, const JpegTables::HuffmanCode* acCodes) {
+        float coefficients[64];
+        forwardDct(pixels, coefficients);
+        int quantized[64];
+        for (int i = 0; i < 64; i++) {
+            int natural = JpegTables::ZIGZAG[i];
+            float value = coefficients[natural] * divisors[natural];
+            quantized[i] = (int)(value < 0 ? value - 0.5f : value + 0.5f);
+        }
+
+        int diff = quantized[0] - lastDc;
+        lastDc = quantized[0];
+        putValue(diff, dcCodes);
+
+        int run = 0;
+        for (int i = 1; i < 64; i++) {
+            if (quantized[i] == 0) {
+                run++;
+                continue;
+            }
+            while (run > 15) {
+                putCode(acCodes[0xF0]);
+                run -= 16;
+            }
+            int size = magnitudeBits(quantized[i]);
+            putCode(acCodes[(run << 4) | size]);
+            putBits(amplitude(quantized[i], size), size);
+            run = 0;
+        }
+        if (run > 0) putCode(acCodes[0x00]);
+    }
+
+    void putValue(int value, const JpegTables::HuffmanCode* codes) {
+        int size = magnitudeBits(value);
+        putCode(codes[size]);
+        if (size > 0) putBits(amplitude(value, size), size);
+    }
+
+    static int magnitudeBits(int value) {
+        unsigned magnitude = value < 0 ? -value : value;
+        int bits = 0;
+        while (magnitude) {
+            bits++;
+            magnitude >>= 1;
+        }
+        return bits;
+    }
+
+    // Negative values go out as their ones' complement
+    static uint32_t amplitude(int value, int size) {
+        return (uint32_t)(value < 0 ? value - 1 : value) & ((1u << size) - 1);
+    }
+
+    void putCode(const JpegTables::HuffmanCode& code) {
+        putBits(code.code, code.length);
+    }
+
+    void putBits(uint32_t value, uint8_t count) {
+        writer.bits = (writer.bits << count) | value;
+        writer.count += count;
+        while (writer.count >= 8) {
+            uint8_t byte = (uint8_t)(writer.bits >> (writer.count - 8));
+            putByte(byte);
+            if (byte == 0xFF) putByte(0x00);    // Stuffed so it is not read as a marker
+            writer.count -= 8;
+        }
+        writer.bits &= (1u << writer.count) - 1;
+    }
+
+    // Pads the last byte with ones
+    void flushBits() {
+        if (writer.count > 0) putBits((1u << (8 - writer.count)) - 1, 8 - writer.count);
+    }
+
+    void putByte(uint8_t byte) {
+        if (writer.length >= writer.capacity) {
+            writer.overflow = true;
+            return;
+        }
+        writer.out[writer.length++] = byte;
+    }
+
+    void putWord(uint16_t word) {
+        putByte(word >> 8);
+        putByte(word & 0xFF);
+    }
+
+    void writeHeaders(bool colour) {
+        static const uint8_t JFIF[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+                                        0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00 };
+        for (uint8_t byte : JFIF) putByte(byte);
+
+        putWord(0xFFDB);
+        putWord(2 + (colour ? 2 : 1) * 65);
+        putByte(0);
+        for (int i = 0; i < 64; i++) putByte(quantLuma[i]);
+        if (colour) {
+            putByte(1);
+            for (int i = 0; i < 64; i++) putByte(quantChroma[i]);
+        }
+
+        uint8_t components = colour ? 3 : 1;
+        putWord(0xFFC0);
+        putWord(8 + 3 * components);
+        putByte(8);
+        putWord(area.height);
+        putWord(area.width);
+        putByte(components);
+        putByte(1);
+        putByte(colour ? 0x22 : 0x11);
+        putByte(0);
+        for (uint8_t c = 2; c <= components; c++) {
+            putByte(c);
+            putByte(0x11);
+            putByte(1);
+        }
+
+        writeHuffman(0x00, JpegTables::DC_LUMA_SPEC);
+        writeHuffman(0x10, JpegTables::AC_LUMA_SPEC);
+        if (colour) {
+            writeHuffman(0x01, JpegTables::DC_CHROMA_SPEC);
+            writeHuffman(0x11, JpegTables::AC_CHROMA_SPEC);
+        }
+
+        putWord(0xFFDA);
+        putWord(6 + 2 * components);
+        putByte(components);
+        putByte(1);
+        putByte(0x00);
+        for (uint8_t c = 2; c <= components; c++) {
+            putByte(c);
+            putByte(0x11);
+        }
+        putByte(0);
+        putByte(63);
+        putByte(0);
+    }
+
+    void writeHuffman(uint8_t tableClassAndId, const JpegTables::HuffmanSpec& spec) {
+        putWord(0xFFC4);
+        putWord(3 + 16 + spec.symbolCount);
+        putByte(tableClassAndId);
+        for (int i = 0; i < 16; i++) putByte(spec.counts[i]);
+        for (int i = 0; i < spec.symbolCount; i++) putByte(spec.symbols[i]);
+    }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef MFCC_H
+#define MFCC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "fixed_fft.cpp"
+
+// Mel-frequency cepstral coefficients for the on-device intent matcher.
+// Free of Arduino/ESP-IDF dependencies so it builds on the host; the window,
+// filterbank and DCT tables are set up in configure(), the streaming path is
+// integer-only.
+//
+// 25 ms Hamming frames every 10 ms at 16 kHz, zero-padded to a 512-point
+// FixedFft. Each frame is pre-emphasised as it is windowed and shifted up
+// towards PEAK_BITS before the transform so quiet frames keep their
+// precision; the shift is taken back out of the logs. The power spectrum is
+// pooled into BANDS triangular mel bands, each bin feeding at most two; the
+// log2 of every band (Q8) goes through a DCT-II, giving COEFFS cepstra
+// c1..c12 with c0 left out, so level does not enter the match. energy is the
+// log2 power (Q8) of the frame before pre-emphasis, for endpointing: after
+// it a fricative would outweigh the vowels.
+struct MfccConfig {
+    uint32_t sampleRate = 16000;
+    uint16_t lowHz = 125;           // Filterbank edges
+    uint16_t highHz = 7500;
+    uint16_t preEmphasisQ15 = 31785;    // 0.97
+};
+
+struct MfccFrame {
+    static const uint8_t COEFFS = 12;
+    int16_t c[COEFFS];              // c1..c12, log2 Q8 units / 4
+    int16_t energy;                 // log2 of the frame power before pre-emphasis, Q8
+};
+
+class MfccExtractor {
+public:
+    static const size_t FFT_SIZE = 512;
+    static const size_t BINS = FFT_SIZE / 2 + 1;
+    static const uint8_t BANDS = 24;
+    static const uint8_t COEFFS = MfccFrame::COEFFS;
+    static const uint8_t PEAK_BITS = 20;
+    static const uint8_t NO_BAND = 0xFF;
+
+    typedef FixedFft<FFT_SIZE> Fft;
+
+    explicit MfccExtractor(const MfccConfig& config = MfccConfig()) {
+        configure(config);
+    }
+
+    void configure(const MfccConfig& newConfig) {
+        config = newConfig;
+        window = config.sampleRate / 40;                // 25 ms
+        if (window > FFT_SIZE) window = FFT_SIZE;
+        hop = config.sampleRate / 100;                  // 10 ms
+        for (size_t n = 0; n < window; n++) {
+            hamming[n] = (int16_t)lround(32767.0 * (0.54 - 0.46 * cos(2.0 * M_PI * n / (window - 1))));
+        }
+
+        // Triangles between BANDS + 2 points evenly spaced in mel; a bin
+        // between points p and p + 1 rises into band p and falls out of
+        // band p - 1
+        double lowMel = mel(config.lowHz);
+        double highMel = mel(config.highHz);
+        for (size_t k = 0; k < BINS; k++) {
+            double m = mel((double)k * config.sampleRate / FFT_SIZE);
+            binPoint[k] = NO_BAND;
+            binRiseQ15[k] = 0;
+            if (m <= lowMel || m >= highMel) continue;
+            double position = (m - lowMel) / (highMel - lowMel) * (BANDS + 1);
+            uint8_t point = (uint8_t)position;
+            binPoint[k] = point;
+            binRiseQ15[k] = (uint16_t)lround(32767.0 * (position - point));
+        }
+        for (uint8_t n = 0; n < COEFFS; n++) {
+            for (uint8_t b = 0; b < BANDS; b++) {
+                dct[n][b] = (int16_t)lround(32767.0 * cos(M_PI * (n + 1) * (b + 0.5) / BANDS));
+            }
+        }
+        reset();
+    }
+
+    void reset() {
+        memset(history, 0, sizeof(history));
+        next = 0;
+        filled = 0;
+        sinceFrame = 0;
+    }
+
+    size_t getHop() const { return hop; }
+    size_t getWindow() const { return window; }
+
+    // Feeds count samples; writes one frame per completed hop into out (at
+    // most maxFrames) and returns how many
+    size_t process(const int16_t* in, size_t count, MfccFrame* out, size_t maxFrames) {
+        size_t produced = 0;
+        for (size_t i = 0; i < count; i++) {
+            history[next] = in[i];
+            next = next + 1 < window ? next + 1 : 0;
+            if (filled < window) {
+                filled++;
+            }
+            if (filled == window && ++sinceFrame >= hop) {
+                sinceFrame = 0;
+                if (produced < maxFrames) {
+                    computeFrame(out[produced++]);
+                }
+            }
+        }
+        return produced;
+    }
+
+    // Integer log2, Q8
+    static int32_t log2Q8(uint64_t x) {
+        if (x == 0) return 0;
+        int msb = 63 - __builtin_clzll(x);
+        uint32_t fraction = msb >= 8 ? (uint32_t)(x >> (msb - 8)) & 0xFF : (uint32_t)(x << (8 - msb)) & 0xFF;
+        return msb * 256 + logTable()[fraction];
+    }
+
+private:
+    MfccConfig config;
+    size_t window = 400;
+    size_t hop = 160;
+    int16_t hamming[FFT_SIZE];
+    uint8_t binPoint[BINS];
+    uint16_t binRiseQ15[BINS];
+    int16_t dct[COEFFS][BANDS];
+    int16_t history[FFT_SIZE];          // Input ring; next is the oldest once full
+    size_t next = 0;
+    size_t filled = 0;
+    size_t sinceFrame = 0;
+    int32_t re[FFT_SIZE];
+    int32_t im[FFT_SIZE];
+
+    static double mel(double hz) {
+        return 2595.0 * log10(1.0 + hz / 700.0);
+    }
+
+    // log2(1 + i / 256) in Q8
+    static const uint8_t* logTable() {
+        static const struct Table {
+            uint8_t values[256];
+            Table() {
+                for (int i = 0; i < 256; i++) {
+                    values[i] = (uint8_t)lround(256.0 * log2(1.0 + i / 256.0));
+                }
+            }
+        } table;
+        return table.values;
+    }
+
+    void computeFrame(MfccFrame& frame) {
+        int32_t peak = 0;
+        uint64_t raw = 0;
+        int32_t previous = history[next];
+        for (size_t n = 0, i = next; n < window; n++, i = i + 1 < window ? i + 1 : 0) {
+            int32_t x = history[i];
+            int32_t windowed = (x * hamming[n] + (1 << 14)) >> 15;
+            raw += (uint64_t)((int64_t)windowed * windowed);
+            int32_t emphasised = x - ((previous * config.preEmphasisQ15 + (1 << 14)) >> 15);
+            previous = x;
+            re[n] = (emphasised * hamming[n] + (1 << 14)) >> 15;
+            int32_t magnitude = re[n] < 0 ? -re[n] : re[n];
+            if (magnitude > peak) peak = magnitude;
+        }
+        int shift = 0;
+        while (peak > 0 && (peak << 1) < (1 << PEAK_BITS)) {
+            peak <<= 1;
+            shift++;
+        }
+        for (size_t n = 0; n < window; n++) re[n] <<= shift;
+        memset(re + window, 0, (FFT_SIZE - window) * sizeof(re[0]));
+        memset(im, 0, sizeof(im));
+        Fft::forward(re, im);
+
+        uint64_t bands[BANDS + 1] = {};
+        for (size_t k = 0; k < BINS; k++) {
+            uint64_t power = (uint64_t)((int64_t)re[k] * re[k] + (int64_t)im[k] * im[k]);
+            uint8_t point = binPoint[k];
+            if (point == NO_BAND) continue;
+            uint64_t rise = (power * binRiseQ15[k]) >> 15;
+            bands[point] += rise;                   // Rising side of band point
+            if (point > 0) bands[point - 1] += power - rise;
+        }
+
+        // The shift scaled the power by 4^shift
+        int32_t unshift = 2 * shift * 256;
+        int32_t logs[BANDS];
+        for (uint8_t b = 0; b < BANDS; b++) {
+            logs[b] = log2Q8(bands[b] + 1) - unshift;
+        }
+        for (uint8_t n = 0; n < COEFFS; n++) {
+            int64_t sum = 0;
+            for (uint8_t b = 0; b < BANDS; b++) {
+                sum += (int64_t)logs[b] * dct[n][b];
+            }
+            frame.c[n] = (int16_t)(sum >> 17);
+        }
+        frame.energy = (int16_t)log2Q8(raw + 1);
+    }
+};
+
+#endif
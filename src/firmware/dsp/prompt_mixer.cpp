@@ -0,0 +1,271 @@
+#ifndef PROMPT_MIXER_H
+#define PROMPT_MIXER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "audio_codec.cpp"
+#include "../utils/asset_pack.cpp"
+
+// Mixer for short pre-encoded prompts (earcons, status sounds) from the asset
+// pack. Free of Arduino/ESP-IDF dependencies so it builds on the host;
+// drivers/prompt_player.cpp runs it into the speaker's DMA buffers.
+//
+// Each clip is registered once with load(), which decodes its first
+// LEAD_SAMPLES into RAM. A clip that starts plays from there, so the buffer
+// after a trigger needs no ADPCM decode or flash cache miss; past the lead,
+// PCM is read from the mapped pack and ADPCM decoded a block at a time.
+//
+// play() applies the rules:
+// - the same clip again restarts it; a looping clip just keeps going
+// - up to VOICES clips sound at once; with all busy, a clip replaces the
+//   lowest-priority one if that is not above its own, or is dropped
+// - a clip under a higher-priority one is ducked to duckGainQ15, ramping
+//   down in duckAttackMs and back up in duckReleaseMs
+// - a stopped or replaced clip fades out over fadeMs rather than clicking
+enum PromptPriority : uint8_t {
+    PROMPT_PRIORITY_AMBIENT = 0,    // Background loops (thinking)
+    PROMPT_PRIORITY_FEEDBACK = 1,   // Acknowledgements (listening, done)
+    PROMPT_PRIORITY_ALERT = 2       // Errors and warnings
+};
+
+struct PromptMixerConfig {
+    uint32_t sampleRate = 16000;
+    int32_t duckGainQ15 = 8231;     // -12 dB
+    uint16_t duckAttackMs = 5;
+    uint16_t duckReleaseMs = 80;
+    uint16_t fadeMs = 3;
+};
+
+class PromptMixer {
+public:
+    static const uint8_t MAX_CLIPS = 8;
+    static const uint8_t VOICES = 2;                // Audible at once
+    static const size_t LEAD_SAMPLES = 256;         // Decoded at load: one ADPCM block, 16 ms
+    static const size_t MAX_BLOCK_SAMPLES = 256;
+    static const int32_t UNITY = 32768;             // Q15 gain 1.0
+
+    explicit PromptMixer(const PromptMixerConfig& config = PromptMixerConfig()) {
+        configure(config);
+    }
+
+    void configure(const PromptMixerConfig& newConfig) {
+        config = newConfig;
+        attackStep = rampStep(config.duckAttackMs);
+        releaseStep = rampStep(config.duckReleaseMs);
+        fadeStep = rampStep(config.fadeMs);
+        stopAll(true);
+    }
+
+    // Registers a prompt as clip (0 .. MAX_CLIPS - 1) and decodes its lead
+    bool load(uint8_t clip, const AssetPrompt& prompt, PromptPriority priority, bool loop = false) {
+        if (clip >= MAX_CLIPS || !prompt || prompt.header->samples == 0 ||
+            (prompt.header->codec != CODEC_PCM16 && prompt.header->blockSamples > MAX_BLOCK_SAMPLES)) {
+            return false;
+        }
+        for (Voice& voice : voices) {
+            if (voice.clip == clip) voice.clip = NO_CLIP;
+        }
+        Clip& c = clips[clip];
+        c.prompt = prompt;
+        c.priority = priority;
+        c.loop = loop;
+        uint32_t lead = prompt.header->samples < LEAD_SAMPLES ? prompt.header->samples : LEAD_SAMPLES;
+        Voice scratch;
+        c.leadSamples = 0;
+        for (uint32_t i = 0; i < lead; i++) {
+            c.lead[i] = fetch(c, scratch, i);
+        }
+        c.leadSamples = lead;
+        return true;
+    }
+
+    // Starts a clip; false if it was dropped for higher-priority ones
+    bool play(uint8_t clip) {
+        if (clip >= MAX_CLIPS || !clips[clip].prompt) {
+            return false;
+        }
+        const Clip& c = clips[clip];
+        for (Voice& voice : voices) {
+            if (voice.clip == clip && !voice.stopping) {
+                if (c.loop) return true;
+                voice.stopping = true;
+            }
+        }
+        if (audible() >= VOICES) {
+            Voice* victim = nullptr;
+            for (Voice& voice : voices) {
+                if (voice.clip != NO_CLIP && !voice.stopping &&
+                    (victim == nullptr || clips[voice.clip].priority < clips[victim->clip].priority)) {
+                    victim = &voice;
+                }
+            }
+            if (clips[victim->clip].priority > c.priority) {
+                return false;
+            }
+            victim->stopping = true;
+        }
+        Voice& voice = freeVoice();
+        voice.clip = clip;
+        voice.position = 0;
+        voice.block = NO_BLOCK;
+        voice.stopping = false;
+        voice.gain = ducked(c.priority) ? config.duckGainQ15 : UNITY;
+        return true;
+    }
+
+    // Fades a clip out
+    void stop(uint8_t clip) {
+        for (Voice& voice : voices) {
+            if (voice.clip == clip) voice.stopping = true;
+        }
+    }
+
+    void stopAll(bool immediately = false) {
+        for (Voice& voice : voices) {
+            voice.stopping = true;
+            if (immediately) voice.clip = NO_CLIP;
+        }
+    }
+
+    bool isActive() const {
+        for (const Voice& voice : voices) {
+            if (voice.clip != NO_CLIP) return true;
+        }
+        return false;
+    }
+
+    bool isPlaying(uint8_t clip) const {
+        for (const Voice& voice : voices) {
+            if (voice.clip == clip && !voice.stopping) return true;
+        }
+        return false;
+    }
+
+    // Mixes the next count samples into out; false if nothing played
+    bool mix(int16_t* out, size_t count) {
+        bool played = false;
+        for (size_t offset = 0; offset < count; offset += BLOCK) {
+            size_t n = count - offset < BLOCK ? count - offset : BLOCK;
+            int32_t sum[BLOCK] = {};
+            for (Voice& voice : voices) {
+                if (voice.clip != NO_CLIP) {
+                    played = true;
+                    render(voice, sum, n);
+                }
+            }
+            for (size_t i = 0; i < n; i++) {
+                int32_t s = sum[i];
+                out[offset + i] = s > 32767 ? 32767 : s < -32768 ? -32768 : (int16_t)s;
+            }
+        }
+        return played;
+    }
+
+private:
+    static const uint8_t NO_CLIP = 0xFF;
+    static const uint32_t NO_BLOCK = 0xFFFFFFFF;
+    static const uint8_t SLOTS = VOICES + 1;        // Room for one fading out
+    static const size_t BLOCK = 64;
+
+    struct Clip {
+        AssetPrompt prompt;
+        PromptPriority priority = PROMPT_PRIORITY_FEEDBACK;
+        bool loop = false;
+        uint32_t leadSamples = 0;
+        int16_t lead[LEAD_SAMPLES];
+    };
+
+    struct Voice {
+        uint8_t clip = NO_CLIP;
+        bool stopping = false;
+        uint32_t position = 0;
+        int32_t gain = UNITY;
+        uint32_t block = NO_BLOCK;                  // ADPCM block held in decoded
+        int16_t decoded[MAX_BLOCK_SAMPLES];
+    };
+
+    PromptMixerConfig config;
+    Clip clips[MAX_CLIPS];
+    Voice voices[SLOTS];
+    int32_t attackStep = 1;
+    int32_t releaseStep = 1;
+    int32_t fadeStep = 1;
+
+    int32_t rampStep(uint16_t ms) const {
+        int32_t samples = (int32_t)(config.sampleRate * ms / 1000);
+        return samples > 0 ? (UNITY + samples - 1) / samples : UNITY;
+    }
+
+    uint8_t audible() const {
+        uint8_t n = 0;
+        for (const Voice& voice : voices) {
+            if (voice.clip != NO_CLIP && !voice.stopping) n++;
+        }
+        return n;
+    }
+
+    // Whether a clip of this priority sits under a louder one
+    bool ducked(PromptPriority priority) const {
+        for (const Voice& voice : voices) {
+            if (voice.clip != NO_CLIP && !voice.stopping && clips[voice.clip].priority > priority) return true;
+        }
+        return false;
+    }
+
+    // A free slot; with none, the quietest fading voice is cut
+    Voice& freeVoice() {
+        Voice* quietest = nullptr;
+        for (Voice& voice : voices) {
+            if (voice.clip == NO_CLIP) return voice;
+            if (voice.stopping && (quietest == nullptr || voice.gain < quietest->gain)) quietest = &voice;
+        }
+        quietest->clip = NO_CLIP;
+        return *quietest;
+    }
+
+    static int16_t fetch(const Clip& c, Voice& voice, uint32_t position) {
+        if (position < c.leadSamples) {
+            return c.lead[position];
+        }
+        const AssetPromptHeader* header = c.prompt.header;
+        if (header->codec == CODEC_PCM16) {
+            return ((const int16_t*)c.prompt.data)[position];
+        }
+        uint32_t index = position / header->blockSamples;
+        if (index != voice.block) {
+            size_t length;
+            const uint8_t* block = c.prompt.block(index, length);
+            AudioEncoder::decodeAdpcm(block, length, voice.decoded);
+            voice.block = index;
+        }
+        return voice.decoded[position - index * header->blockSamples];
+    }
+
+    void render(Voice& voice, int32_t* sum, size_t count) {
+        const Clip& c = clips[voice.clip];
+        int32_t target = voice.stopping ? 0 : ducked(c.priority) ? config.duckGainQ15 : UNITY;
+        int32_t down = voice.stopping ? fadeStep : attackStep;
+        for (size_t i = 0; i < count; i++) {
+            if (voice.gain > target) {
+                voice.gain = voice.gain - down > target ? voice.gain - down : target;
+            } else if (voice.gain < target) {
+                voice.gain = voice.gain + releaseStep < target ? voice.gain + releaseStep : target;
+            }
+            sum[i] += (fetch(c, voice, voice.position) * voice.gain) >> 15;
+            if (++voice.position >= c.prompt.header->samples) {
+                voice.position = 0;
+                if (!c.loop) {
+                    voice.clip = NO_CLIP;
+                    return;
+                }
+            }
+            if (voice.stopping && voice.gain == 0) {
+                voice.clip = NO_CLIP;
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef SPEECH_ENHANCER_H
+#define SPEECH_ENHANCER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "fixed_fft.cpp"
+
+// Noise suppression and automatic gain control for audio on its way to the
+// server. Free of Arduino/ESP-IDF dependencies so it builds on the host; the
+// window and time constants are set up in configure(), the streaming path is
+// integer-only.
+//
+// Suppression is short-time spectral: 256-sample frames (16 ms at 16 kHz) with
+// a 128-sample hop, sqrt-Hann analysis and synthesis windows (overlap-add is
+// exact with no gain applied). Each bin's noise power is tracked like the wake
+// detector's floor, falling fast and rising slowly, and gets a Wiener-style
+// gain 1 - oversubtraction x noise / power, smoothed over frames and floored
+// so residual noise stays smooth instead of "musical". The estimate only rises
+// on hops not judged to be speech, unless "speech" lasts too long to be speech.
+//
+// The AGC follows with one gain per hop. Speech hops update a smoothed speech
+// level (levelMs) and move the gain towards targetLevel / level with separate
+// attack and release times; pauses leave both alone, so noise is not pumped up
+// between words. A hop whose peak would clip pulls the gain down at once. The
+// gain is ramped across each hop.
+//
+// Output is the input delayed by FRAME samples (16 ms); process() always
+// returns as many samples as it is given, and out may be in.
+struct SpeechEnhancerConfig {
+    uint32_t sampleRate = 16000;
+    bool suppress = true;
+    bool agc = true;
+    uint16_t oversubtractionQ8 = 384;   // 1.5 x the noise estimate
+    uint16_t gainFloorQ15 = 3277;       // At most -20 dB per bin
+    uint8_t noiseRiseShift = 5;         // Noise estimate rises by 1/32 per hop
+    uint8_t noiseFallShift = 4;         // and falls by 1/16
+    uint16_t speechRatioQ8 = 3 * 256;   // Hop power over noise power that counts as speech
+    uint16_t targetLevel = 2500;        // AGC target, mean absolute amplitude (about -20 dBFS)
+    uint16_t minGainQ8 = 64;            // 0.25
+    uint16_t maxGainQ8 = 16 * 256;      // +24 dB
+    uint16_t levelMs = 300;             // Speech level averaging
+    uint16_t attackMs = 50;             // Gain falling
+    uint16_t releaseMs = 1000;          // Gain rising
+};
+
+class SpeechEnhancer {
+public:
+    static const size_t FRAME = 256;
+    static const size_t HOP = FRAME / 2;
+    static const size_t BINS = FRAME / 2 + 1;
+    static const uint8_t PEAK_BITS = 20;     // Frames are scaled up to this before the FFT
+    static const uint8_t WARMUP_FRAMES = 8;  // 64 ms of audio seeds the noise estimate
+    static const uint16_t LONG_SPEECH_HOPS = 500;   // 4 s of "speech" is a louder background
+
+    typedef FixedFft<FRAME> Fft;
+
+    explicit SpeechEnhancer(const SpeechEnhancerConfig& config = SpeechEnhancerConfig()) {
+        // Periodic sqrt-Hann: w[n]^2 + w[n + HOP]^2 == 1
+        for (size_t n = 0; n < FRAME; n++) {
+            window[n] = (int16_t)lround(fmin(32767.0, 32768.0 * sin(M_PI * n / FRAME)));
+        }
+        configure(config);
+    }
+
+    void configure(const SpeechEnhancerConfig& newConfig) {
+        config = newConfig;
+        // One-pole coefficient per hop for a time constant of ms
+        double hopMs = 1000.0 * HOP / config.sampleRate;
+        attackQ15 = (uint16_t)lround(32768.0 * (1.0 - exp(-hopMs / (config.attackMs ? config.attackMs : 1))));
+        releaseQ15 = (uint16_t)lround(32768.0 * (1.0 - exp(-hopMs / (config.releaseMs ? config.releaseMs : 1))));
+        levelQ15 = (uint16_t)lround(32768.0 * (1.0 - exp(-hopMs / (config.levelMs ? config.levelMs : 1))));
+        reset();
+    }
+
+    void reset() {
+        memset(input, 0, sizeof(input));
+        memset(overlap, 0, sizeof(overlap));
+        memset(output, 0, sizeof(output));
+        memset(noise, 0, sizeof(noise));
+        for (size_t k = 0; k < BINS; k++) {
+            gains[k] = 32767;
+        }
+        filled = 0;
+        frames = 0;
+        agcGainQ8 = 256;
+        speechHops = 0;
+        speechRun = 0;
+        speechLevel = config.targetLevel;
+    }
+
+    size_t process(const int16_t* in, size_t count, int16_t* out) {
+        for (size_t i = 0; i < count; i++) {
+            int16_t sample = in[i];
+            out[i] = output[filled];
+            input[FRAME - HOP + filled] = sample;
+            if (++filled == HOP) {
+                runFrame();
+                filled = 0;
+            }
+        }
+        return count;
+    }
+
+    uint16_t getAgcGainQ8() const { return agcGainQ8; }
+    uint32_t getSpeechHops() const { return speechHops; }
+    uint32_t getFrames() const { return frames; }
+
+    // Noise power per bin, in (DFT / 64)^2 units
+    const uint32_t* getNoise() const { return noise; }
+
+private:
+    SpeechEnhancerConfig config;
+    int16_t window[FRAME];
+    int16_t input[FRAME];           // Last FRAME input samples, oldest first
+    int32_t overlap[HOP];           // Second half of the previous synthesis frame
+    int16_t output[HOP];            // Finished samples, handed out one hop behind
+    int32_t re[FRAME];
+    int32_t im[FRAME];
+    uint32_t noise[BINS];
+    uint16_t gains[BINS];           // Smoothed suppression gains, Q15
+    size_t filled = 0;
+    uint32_t frames = 0;
+    uint16_t agcGainQ8 = 256;
+    uint16_t attackQ15 = 0;
+    uint16_t releaseQ15 = 0;
+    uint32_t speechHops = 0;
+    uint16_t speechRun = 0;
+    uint32_t speechLevel = 0;       // Smoothed mean absolute level of speech hops
+    uint16_t levelQ15 = 0;
+
+    void runFrame() {
+        frames++;
+        int32_t hop[HOP];
+        bool speech = config.suppress ? suppress(hop) : passThrough(hop);
+        if (speech) speechHops++;
+        if (config.agc) {
+            applyAgc(hop, speech);
+        }
+        for (size_t i = 0; i < HOP; i++) {
+            int32_t s = hop[i];
+            output[i] = s > 32767 ? 32767 : s < -32768 ? -32768 : (int16_t)s;
+        }
+        memmove(input, input + HOP, (FRAME - HOP) * sizeof(int16_t));
+    }
+
+    // Without suppression the frame is still delayed by the same amount
+    bool passThrough(int32_t* hop) {
+        for (size_t i = 0; i < HOP; i++) {
+            hop[i] = input[i];
+        }
+        return true;
+    }
+
+    bool suppress(int32_t* hop) {
+        // Window and scale the frame so its peak sits just under 2^PEAK_BITS
+        int32_t peak = 1;
+        for (size_t n = 0; n < FRAME; n++) {
+            re[n] = (input[n] * window[n] + (1 << 14)) >> 15;
+            im[n] = 0;
+            int32_t magnitude = re[n] < 0 ? -re[n] : re[n];
+            if (magnitude > peak) peak = magnitude;
+        }
+        uint8_t scale = 0;
+        while ((peak << (scale + 1)) < (1 << PEAK_BITS)) {
+            scale++;
+        }
+        for (size_t n = 0; n < FRAME; n++) {
+            re[n] <<= scale;
+        }
+
+        Fft::forward(re, im);
+
+        // Bin powers in (DFT / 64)^2 units: re / im are DFT / FRAME << scale
+        uint64_t powerSum = 0;
+        uint64_t noiseSum = 0;
+        uint32_t power[BINS];
+        for (size_t k = 0; k < BINS; k++) {
+            uint64_t p = ((uint64_t)((int64_t)re[k] * re[k]) + (uint64_t)((int64_t)im[k] * im[k])) << 4;
+            p >>= 2 * scale;
+            power[k] = p > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)p;
+            powerSum += power[k];
+            noiseSum += noise[k];
+        }
+        // Speech is judged against the estimate so far, and the estimate only
+        // rises outside speech (or when "speech" goes on too long to be speech)
+        bool speech = frames > WARMUP_FRAMES && powerSum * 256 > noiseSum * config.speechRatioQ8;
+        speechRun = speech ? (speechRun < 0xFFFF ? speechRun + 1 : speechRun) : 0;
+        bool rise = !speech || speechRun > LONG_SPEECH_HOPS;
+        for (size_t k = 0; k < BINS; k++) {
+            trackNoise(k, power[k], rise);
+        }
+
+        for (size_t k = 0; k < BINS; k++) {
+            uint16_t gain = wienerGain(power[k], noise[k]);
+            gains[k] += ((int32_t)gain - gains[k]) >> 1;
+            applyGain(k, gains[k]);
+            if (k != 0 && k != FRAME / 2) {
+                applyGain(FRAME - k, gains[k]);
+            }
+        }
+
+        Fft::inverse(re, im);
+
+        // Unscale, synthesis window, overlap-add
+        int32_t round = scale ? 1 << (scale - 1) : 0;
+        for (size_t n = 0; n < FRAME; n++) {
+            int32_t y = (re[n] + round) >> scale;
+            re[n] = (int32_t)(((int64_t)y * window[n] + (1 << 14)) >> 15);
+        }
+        for (size_t i = 0; i < HOP; i++) {
+            hop[i] = overlap[i] + re[i];
+            overlap[i] = re[HOP + i];
+        }
+        return speech;
+    }
+
+    void trackNoise(size_t k, uint32_t power, bool rise) {
+        uint32_t n = noise[k];
+        // The first frames seed the estimate with their average
+        if (frames <= WARMUP_FRAMES || n == 0) {
+            noise[k] = frames <= 1 || n == 0 ? power : n + ((int64_t)power - n) / (int32_t)frames;
+            return;
+        }
+        if (power < n) {
+            noise[k] = n - ((n - power) >> config.noiseFallShift);
+        } else if (rise) {
+            // Speech peaks only nudge the estimate: the rise is capped at 4x
+            uint32_t capped = n > 0xFFFFFFFFu / 4 ? power : (power < n * 4 ? power : n * 4);
+            uint32_t step = (capped - n) >> config.noiseRiseShift;
+            noise[k] = n + (step ? step : (capped > n ? 1 : 0));
+        }
+    }
+
+    uint16_t wienerGain(uint32_t power, uint32_t noisePower) const {
+        uint64_t subtract = ((uint64_t)noisePower * config.oversubtractionQ8) >> 8;
+        if (power == 0 || subtract >= power) {
+            return config.gainFloorQ15;
+        }
+        // (power - subtract) / power in Q15, kept within 32 bits
+        uint32_t remaining = power - (uint32_t)subtract;
+        uint8_t shift = 0;
+        while ((power >> shift) >= (1u << 16)) {
+            shift++;
+        }
+        uint32_t gain = ((remaining >> shift) << 15) / ((power >> shift) ? (power >> shift) : 1);
+        if (gain > 32767) gain = 32767;
+        return gain < config.gainFloorQ15 ? config.gainFloorQ15 : (uint16_t)gain;
+    }
+
+    void applyGain(size_t bin, uint16_t gainQ15) {
+        re[bin] = (int32_t)(((int64_t)re[bin] * gainQ15 + (1 << 14)) >> 15);
+        im[bin] = (int32_t)(((int64_t)im[bin] * gainQ15 + (1 << 14)) >> 15);
+    }
+
+    void applyAgc(int32_t* hop, bool speech) {
+        uint32_t sum = 0;
+        int32_t peak = 0;
+        for (size_t i = 0; i < HOP; i++) {
+            int32_t magnitude = hop[i] < 0 ? -hop[i] : hop[i];
+            sum += magnitude;
+            if (magnitude > peak) peak = magnitude;
+        }
+        uint32_t level = sum / HOP;
+
+        int32_t from = agcGainQ8;
+        int32_t to = from;
+        if (speech) {
+            // Follow the speech level, not single syllables, so the gain does not pump
+            speechLevel += (int32_t)(((int64_t)((int32_t)level - (int32_t)speechLevel) * levelQ15) >> 15);
+            uint32_t desired = (uint32_t)config.targetLevel * 256 / (speechLevel ? speechLevel : 1);
+            if (desired < config.minGainQ8) desired = config.minGainQ8;
+            if (desired > config.maxGainQ8) desired = config.maxGainQ8;
+            uint16_t coefficient = (int32_t)desired < from ? attackQ15 : releaseQ15;
+            to = from + (int32_t)(((int64_t)((int32_t)desired - from) * coefficient) >> 15);
+        }
+        // Never let this hop clip
+        if (peak > 0 && (int64_t)peak * to > (int64_t)32767 * 256) {
+            to = (int32_t)((int64_t)32767 * 256 / peak);
+            if (from > to) from = to;
+        }
+
+        for (size_t i = 0; i < HOP; i++) {
+            int32_t gain = from + (to - from) * (int32_t)(i + 1) / (int32_t)HOP;
+            hop[i] = (int32_t)(((int64_t)hop[i] * gain + 128) >> 8);
+        }
+        agcGainQ8 = (uint16_t)to;
+    }
+};
+
+#endif
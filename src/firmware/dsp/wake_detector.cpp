@@ -0,0 +1,149 @@
+#ifndef WAKE_DETECTOR_H
+#define WAKE_DETECTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// First-stage speech detector for the always-listening path.
+// Integer-only and free of Arduino/ESP-IDF dependencies so it builds on the host.
+//
+// Each frame is reduced to its mean absolute amplitude and zero-crossing rate.
+// A noise floor tracks the quiet level (slow rise, fast fall); a frame is a
+// speech candidate when it is well above the floor and its zero-crossing rate
+// is in the voiced range, which rejects thumps (too low) and hiss (too high).
+// With a microphone array, setNoiseReference() supplies a speech-free noise
+// level (the beamformer's mouth-nulled beam); the floor never drops below it,
+// so a sudden loud background does not wait for the slow rise to catch up.
+struct WakeDetectorConfig {
+    uint16_t ratioQ8 = 3 * 256;      // Energy must exceed noise floor * ratio
+    uint16_t minEnergy = 200;        // Absolute floor, ignores near-silence
+    uint16_t minZcrPermille = 20;    // Voiced speech zero-crossing band at 16 kHz
+    uint16_t maxZcrPermille = 350;
+    uint8_t onsetFrames = 2;         // Consecutive candidate frames to trigger
+    uint8_t noiseRiseShift = 6;      // Floor adapts up by 1/64 per frame
+    uint8_t noiseFallShift = 2;      // and down by 1/4 per frame
+};
+
+class WakeDetector {
+public:
+    explicit WakeDetector(const WakeDetectorConfig& config = WakeDetectorConfig())
+        : config(config) {}
+
+    void reset() {
+        noiseFloor = 0;
+        noiseReference = 0;
+        candidateRun = 0;
+        lastEnergy = 0;
+        lastZcr = 0;
+    }
+
+    // Returns true on the frame where candidate speech starts
+    bool process(const int16_t* samples, size_t count) {
+        if (count == 0) {
+            return false;
+        }
+
+        uint32_t sum = 0;
+        uint32_t crossings = 0;
+        int16_t previous = samples[0];
+        for (size_t i = 0; i < count; i++) {
+            int32_t s = samples[i];
+            sum += s < 0 ? -s : s;
+            crossings += (s ^ previous) < 0;
+            previous = s;
+        }
+        lastEnergy = sum / count;
+        lastZcr = crossings * 1000 / count;
+
+        // First frame seeds the floor
+        if (noiseFloor == 0) {
+            noiseFloor = lastEnergy ? lastEnergy : 1;
+        }
+
+        uint16_t floor = noiseFloor > noiseReference ? noiseFloor : noiseReference;
+        bool loud = lastEnergy >= config.minEnergy &&
+                    (uint32_t)lastEnergy * 256 > (uint32_t)floor * config.ratioQ8;
+        bool voiced = lastZcr >= config.minZcrPermille && lastZcr <= config.maxZcrPermille;
+
+        if (loud && voiced) {
+            if (candidateRun < 255) {
+                candidateRun++;
+            } else {
+                // Several seconds of "speech" is really a new, louder background
+                trackNoise();
+            }
+        } else {
+            candidateRun = 0;
+            // Only learn the floor from frames that are not speech
+            trackNoise();
+        }
+
+        return candidateRun == config.onsetFrames;
+    }
+
+    // Mean absolute level of noise measured without the wearer's voice; 0 = none
+    void setNoiseReference(uint16_t level) { noiseReference = level; }
+
+    uint16_t getNoiseFloor() const { return noiseFloor; }
+    uint16_t getLastEnergy() const { return lastEnergy; }
+    uint16_t getLastZcr() const { return lastZcr; }
+
+private:
+    WakeDetectorConfig config;
+
+    void trackNoise() {
+        int32_t delta = (int32_t)lastEnergy - (int32_t)noiseFloor;
+        int32_t step = delta >> (delta > 0 ? config.noiseRiseShift : config.noiseFallShift);
+        if (step == 0 && delta > 0) step = 1;
+        noiseFloor += step;
+        if (noiseFloor == 0) noiseFloor = 1;
+    }
+
+    uint16_t noiseFloor = 0;
+    uint16_t noiseReference = 0;
+    uint16_t lastEnergy = 0;
+    uint16_t lastZcr = 0;
+    uint8_t candidateRun = 0;
+};
+
+// Keeps the most recent audio so the words spoken before and during wake-up
+// reach the recorder. Single writer, single reader, no allocation.
+template<size_t CAPACITY>
+class PreRollBuffer {
+public:
+    void write(const int16_t* samples, size_t count) {
+        // Only the newest CAPACITY samples matter
+        if (count > CAPACITY) {
+            samples += count - CAPACITY;
+            count = CAPACITY;
+        }
+        size_t first = CAPACITY - head < count ? CAPACITY - head : count;
+        memcpy(buffer + head, samples, first * sizeof(int16_t));
+        memcpy(buffer, samples + first, (count - first) * sizeof(int16_t));
+        head = (head + count) % CAPACITY;
+        filled = filled + count > CAPACITY ? CAPACITY : filled + count;
+    }
+
+    // Pops up to max of the oldest buffered samples, so the history can be
+    // handed over in small chunks
+    size_t read(int16_t* out, size_t max) {
+        size_t count = filled < max ? filled : max;
+        size_t start = (head + CAPACITY - filled) % CAPACITY;
+        size_t first = CAPACITY - start < count ? CAPACITY - start : count;
+        memcpy(out, buffer + start, first * sizeof(int16_t));
+        memcpy(out + first, buffer, (count - first) * sizeof(int16_t));
+        filled -= count;
+        return count;
+    }
+
+    size_t size() const { return filled; }
+    void clear() { filled = 0; }
+
+private:
+    int16_t buffer[CAPACITY];
+    size_t head = 0;
+    size_t filled = 0;
+};
+
+#endif
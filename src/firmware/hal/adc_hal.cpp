@@ -0,0 +1,162 @@
+#ifndef ADC_HAL_H
+#define ADC_HAL_H
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+// Oversampled, eFuse-calibrated battery voltage sampling.
+// Channels on ADC1 are read in bursts through the continuous (DMA) mode; pins
+// that are not ADC1 channels fall back to repeated analogReadMilliVolts().
+class AdcHal {
+public:
+    static constexpr uint8_t MAX_CHANNELS = 4;
+    static const uint32_t BURST_SAMPLE_RATE = 20000;   // Conversions per second, all channels
+    static const uint16_t BURST_SAMPLES = 256;         // Conversions averaged per channel
+
+    static bool begin(const uint8_t* pinList, uint8_t count) {
+        channelCount = min<uint8_t>(count, MAX_CHANNELS);
+        uint32_t adc1Mask = 0;
+
+        for (uint8_t i = 0; i < channelCount; i++) {
+            pins[i] = pinList[i];
+            int8_t channel = digitalPinToAnalogChannel(pinList[i]);
+            // Arduino numbers ADC2 channels after the ten ADC1 channels
+            channels[i] = (channel >= 0 && channel < 10) ? channel : -1;
+            if (channels[i] >= 0) {
+                adc1Mask |= 1u << channels[i];
+            }
+        }
+
+        // Two-point / curve fitting values burned into eFuse at the factory
+        calibrated = esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_TP_FIT) == ESP_OK ||
+                     esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_TP) == ESP_OK;
+        esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, DEFAULT_VREF_MV, &characteristics);
+
+        if (adc1Mask == 0) {
+            dmaReady = false;
+            return true;
+        }
+
+        adc_digi_init_config_t init = {};
+        init.max_store_buf_size = DMA_BUFFER_BYTES;
+        init.conv_num_each_intr = DMA_FRAME_BYTES;
+        init.adc1_chan_mask = adc1Mask;
+        init.adc2_chan_mask = 0;
+        dmaReady = adc_digi_initialize(&init) == ESP_OK;
+        if (!dmaReady) {
+            return false;
+        }
+
+        static adc_digi_pattern_config_t pattern[MAX_CHANNELS];
+        uint8_t patternCount = 0;
+        for (uint8_t i = 0; i < channelCount; i++) {
+            if (channels[i] < 0) continue;
+            pattern[patternCount].atten = ADC_ATTEN_DB_11;
+            pattern[patternCount].channel = channels[i];
+            pattern[patternCount].unit = 0;
+            pattern[patternCount].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+            patternCount++;
+        }
+
+        adc_digi_configuration_t config = {};
+        config.conv_limit_en = false;
+        config.conv_limit_num = 250;
+        config.pattern_num = patternCount;
+        config.adc_pattern = pattern;
+        config.sample_freq_hz = BURST_SAMPLE_RATE;
+        config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+        dmaReady = adc_digi_controller_configure(&config) == ESP_OK;
+        return dmaReady;
+    }
+
+    // Sample every channel once; results in millivolts at the pin.
+    // The converter only runs for the length of the burst (~BURST_SAMPLES * channels
+    // / BURST_SAMPLE_RATE), so it does not keep the APB clock up between readings.
+    static bool sample(uint32_t* millivolts) {
+        uint32_t sums[MAX_CHANNELS] = {};
+        uint16_t counts[MAX_CHANNELS] = {};
+
+        if (dmaReady) {
+            readBurst(sums, counts);
+        }
+
+        for (uint8_t i = 0; i < channelCount; i++) {
+            if (channels[i] >= 0 && counts[i] > 0) {
+                uint32_t raw = (sums[i] + counts[i] / 2) / counts[i];
+                millivolts[i] = esp_adc_cal_raw_to_voltage(raw, &characteristics);
+            } else {
+                millivolts[i] = readSlow(pins[i]);
+            }
+        }
+        return true;
+    }
+
+    static bool isCalibrated() {
+        return calibrated;
+    }
+
+private:
+    static const uint32_t DEFAULT_VREF_MV = 1100;
+    static const uint32_t DMA_FRAME_BYTES = 256;
+    static const uint32_t DMA_BUFFER_BYTES = 1024;
+    static const uint8_t SLOW_SAMPLES = 32;
+
+    static uint8_t pins[MAX_CHANNELS];
+    static int8_t channels[MAX_CHANNELS];
+    static uint8_t channelCount;
+    static bool dmaReady;
+    static bool calibrated;
+    static esp_adc_cal_characteristics_t characteristics;
+
+    static void readBurst(uint32_t* sums, uint16_t* counts) {
+        uint8_t frame[DMA_FRAME_BYTES];
+        uint16_t wanted = BURST_SAMPLES;
+
+        adc_digi_start();
+        // Elapsed time, so the timeout survives millis() wrapping
+        uint32_t start = millis();
+        while (millis() - start < 100) {
+            uint32_t length = 0;
+            if (adc_digi_read_bytes(frame, sizeof(frame), &length, 20) != ESP_OK) {
+                continue;
+            }
+
+            for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+                adc_digi_output_data_t* result = (adc_digi_output_data_t*)&frame[i];
+                for (uint8_t c = 0; c < channelCount; c++) {
+                    if (channels[c] == result->type2.channel && counts[c] < wanted) {
+                        sums[c] += result->type2.data;
+                        counts[c]++;
+                    }
+                }
+            }
+
+            bool done = true;
+            for (uint8_t c = 0; c < channelCount; c++) {
+                if (channels[c] >= 0 && counts[c] < wanted) done = false;
+            }
+            if (done) break;
+        }
+        adc_digi_stop();
+    }
+
+    static uint32_t readSlow(uint8_t pin) {
+        // analogReadMilliVolts() applies the same eFuse calibration per sample
+        uint32_t sum = 0;
+        for (uint8_t i = 0; i < SLOW_SAMPLES; i++) {
+            sum += analogReadMilliVolts(pin);
+        }
+        return sum / SLOW_SAMPLES;
+    }
+};
+
+uint8_t AdcHal::pins[AdcHal::MAX_CHANNELS] = {};
+int8_t AdcHal::channels[AdcHal::MAX_CHANNELS] = { -1, -1, -1, -1 };
+uint8_t AdcHal::channelCount = 0;
+bool AdcHal::dmaReady = false;
+bool AdcHal::calibrated = false;
+esp_adc_cal_characteristics_t AdcHal::characteristics;
+
+#endif
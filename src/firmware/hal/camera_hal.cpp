@@ -0,0 +1,123 @@
+#ifndef CAMERA_HAL_H
+#define CAMERA_HAL_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <driver/i2c.h>
+#include "../config/board_profile.h"
+#include "../dsp/jpeg_encoder.cpp"
+#include "i2c_bus.cpp"
+
+// DVP camera through the esp32-camera driver, on Board::Camera's pins.
+// Frames arrive as YUV 4:2:2 (YUYV) in PSRAM frame buffers filled by the
+// camera DMA; capture() lends one out as a JpegImage over the buffer itself,
+// and release() gives it back. With FB_COUNT buffers, the sensor fills the
+// next frame while the last one is compared and encoded.
+//
+// The sensor's SCCB control port goes through the I2C driver I2cBus already
+// installed (the display's bus), so init must come after the display. Its
+// register accesses bypass the bus queue, so its DeviceStats stay at zero,
+// but the sensor is registered with I2cBus so the bus clock never runs faster
+// than SCCB takes; like any addDevice(), that applies from the next queued
+// transfer.
+struct CameraFrame {
+    JpegImage image;
+    uint32_t timestampMs = 0;
+    camera_fb_t* buffer = nullptr;
+};
+
+class CameraHal {
+public:
+    static const uint32_t SCCB_MAX_FREQUENCY = 400000;     // SCCB is specified up to Fast-mode
+
+    static bool begin(i2c_port_t sccbPort = I2C_NUM_0) {
+        if (!Board::Camera::PRESENT) {
+            return false;
+        }
+        if (ready) {
+            return true;
+        }
+        I2cBus::addDevice(Board::Camera::SCCB_ADDRESS, SCCB_MAX_FREQUENCY);
+        camera_config_t config = {};       // LEDC timer and channel 0 for XCLK
+        config.pin_pwdn = -1;
+        config.pin_reset = -1;
+        config.pin_xclk = Board::Camera::XCLK;
+        config.pin_sccb_sda = -1;
+        config.pin_sccb_scl = -1;
+        config.sccb_i2c_port = sccbPort;
+        config.pin_d0 = Board::Camera::D0;
+        config.pin_d1 = Board::Camera::D1;
+        config.pin_d2 = Board::Camera::D2;
+        config.pin_d3 = Board::Camera::D3;
+        config.pin_d4 = Board::Camera::D4;
+        config.pin_d5 = Board::Camera::D5;
+        config.pin_d6 = Board::Camera::D6;
+        config.pin_d7 = Board::Camera::D7;
+        config.pin_vsync = Board::Camera::VSYNC;
+        config.pin_href = Board::Camera::HREF;
+        config.pin_pclk = Board::Camera::PCLK;
+        config.xclk_freq_hz = Board::Camera::XCLK_HZ;
+        config.pixel_format = PIXFORMAT_YUV422;
+        config.frame_size = frameSize();
+        config.fb_count = Board::Camera::FB_COUNT;
+        config.fb_location = CAMERA_FB_IN_PSRAM;
+        config.grab_mode = CAMERA_GRAB_LATEST;     // A frame shows the scene now, not when the last was returned
+        ready = esp_camera_init(&config) == ESP_OK;
+        return ready;
+    }
+
+    // Stops XCLK and frees the frame buffers
+    static void end() {
+        if (ready) {
+            esp_camera_deinit();
+            ready = false;
+        }
+    }
+
+    static bool isReady() {
+        return ready;
+    }
+
+    static bool capture(CameraFrame& frame) {
+        if (!ready) {
+            return false;
+        }
+        camera_fb_t* buffer = esp_camera_fb_get();
+        if (buffer == nullptr) {
+            return false;
+        }
+        frame.buffer = buffer;
+        frame.image.pixels = buffer->buf;
+        frame.image.width = buffer->width;
+        frame.image.height = buffer->height;
+        frame.image.stride = buffer->width * 2;
+        frame.image.format = JPEG_INPUT_YUYV;
+        frame.timestampMs = buffer->timestamp.tv_sec * 1000 + buffer->timestamp.tv_usec / 1000;
+        return true;
+    }
+
+    static void release(CameraFrame& frame) {
+        if (frame.buffer != nullptr) {
+            esp_camera_fb_return(frame.buffer);
+            frame.buffer = nullptr;
+            frame.image.pixels = nullptr;
+        }
+    }
+
+private:
+    static inline bool ready = false;
+
+    static framesize_t frameSize() {
+        switch (Board::Camera::WIDTH) {
+            case 320: return FRAMESIZE_QVGA;
+            case 480: return FRAMESIZE_HVGA;
+            case 800: return FRAMESIZE_SVGA;
+            case 1024: return FRAMESIZE_XGA;
+            case 1280: return Board::Camera::HEIGHT == 720 ? FRAMESIZE_HD : FRAMESIZE_SXGA;
+            case 1600: return FRAMESIZE_UXGA;
+            default: return FRAMESIZE_VGA;
+        }
+    }
+};
+
+#endif
@@ -2,28 +2,207 @@
 #define GPIO_HAL_H
 
 #include <Arduino.h>
+#include <driver/gpio.h>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <soc/soc.h>
+#include "../config/board_profile.h"
 
+// Runtime pin numbers, through the Arduino core (pin lookup on every call)
 class GpioHal {
 public:
     static void configurePin(uint8_t pin, uint8_t mode) {
         pinMode(pin, mode);
     }
-    
+
     static void digitalWrite(uint8_t pin, uint8_t value) {
         ::digitalWrite(pin, value);
     }
-    
+
     static int digitalRead(uint8_t pin) {
         return ::digitalRead(pin);
     }
-    
+
     static void attachInterrupt(uint8_t pin, void (*callback)(), int mode) {
         ::attachInterrupt(pin, callback, mode);
     }
-    
+
     static void detachInterrupt(uint8_t pin) {
         ::detachInterrupt(pin);
     }
 };
 
+// Compile-time pin: the number picks the register bank and bit, so set() and
+// clear() are a single store of a constant mask to GPIO_OUT_W1TS / W1TC.
+// Configure with output()/input() first; they go through the Arduino core to
+// set up the IO MUX.
+template <uint8_t N>
+class Pin {
+public:
+    static_assert(Esp32S3::exists(N), "No such GPIO on the ESP32-S3");
+
+    static constexpr uint8_t NUMBER = N;
+    static constexpr uint32_t MASK = 1u << (N & 31);
+
+    static void output() {
+        pinMode(N, OUTPUT);
+    }
+
+    static void input(uint8_t mode = INPUT) {
+        pinMode(N, mode);
+    }
+
+    static inline void set() {
+        REG_WRITE(N < 32 ? GPIO_OUT_W1TS_REG : GPIO_OUT1_W1TS_REG, MASK);
+    }
+
+    static inline void clear() {
+        REG_WRITE(N < 32 ? GPIO_OUT_W1TC_REG : GPIO_OUT1_W1TC_REG, MASK);
+    }
+
+    static inline void write(bool level) {
+        if (level) set(); else clear();
+    }
+
+    static inline bool read() {
+        return (REG_READ(N < 32 ? GPIO_IN_REG : GPIO_IN1_REG) & MASK) != 0;
+    }
+
+    // Reads the output latch, not the pad, so it works on output-only wiring
+    static inline void toggle() {
+        write((REG_READ(N < 32 ? GPIO_OUT_REG : GPIO_OUT1_REG) & MASK) == 0);
+    }
+};
+
+// Several compile-time pins written together: at most one W1TS and one W1TC
+// store per register bank, whatever the number of pins. The set and clear
+// stores land one bus cycle apart, so pins settle within a few nanoseconds.
+template <uint8_t... Ns>
+class PinGroup {
+public:
+    static_assert(sizeof...(Ns) > 0 && sizeof...(Ns) <= 32, "A pin group holds 1-32 pins");
+    static_assert((Esp32S3::exists(Ns) && ...), "No such GPIO on the ESP32-S3");
+
+    static constexpr size_t COUNT = sizeof...(Ns);
+    static constexpr uint32_t LOW_MASK = ((Ns < 32 ? 1u << (Ns & 31) : 0u) | ...);
+    static constexpr uint32_t HIGH_MASK = ((Ns >= 32 ? 1u << (Ns & 31) : 0u) | ...);
+
+    static void output() {
+        (pinMode(Ns, OUTPUT), ...);
+    }
+
+    static inline void set() {
+        if (LOW_MASK) REG_WRITE(GPIO_OUT_W1TS_REG, LOW_MASK);
+        if (HIGH_MASK) REG_WRITE(GPIO_OUT1_W1TS_REG, HIGH_MASK);
+    }
+
+    static inline void clear() {
+        if (LOW_MASK) REG_WRITE(GPIO_OUT_W1TC_REG, LOW_MASK);
+        if (HIGH_MASK) REG_WRITE(GPIO_OUT1_W1TC_REG, HIGH_MASK);
+    }
+
+    // Bit i of bits drives the i-th pin of the group
+    static inline void write(uint32_t bits) {
+        static constexpr uint8_t PINS[COUNT] = { Ns... };
+        uint32_t lowSet = 0;
+        uint32_t highSet = 0;
+        for (size_t i = 0; i < COUNT; i++) {
+            if (!((bits >> i) & 1)) continue;
+            if (PINS[i] < 32) lowSet |= 1u << (PINS[i] & 31);
+            else highSet |= 1u << (PINS[i] & 31);
+        }
+        if (LOW_MASK) {
+            REG_WRITE(GPIO_OUT_W1TS_REG, lowSet);
+            REG_WRITE(GPIO_OUT_W1TC_REG, LOW_MASK & ~lowSet);
+        }
+        if (HIGH_MASK) {
+            REG_WRITE(GPIO_OUT1_W1TS_REG, highSet);
+            REG_WRITE(GPIO_OUT1_W1TC_REG, HIGH_MASK & ~highSet);
+        }
+    }
+};
+
+// What the ISR saw: the level is read and the time taken on entry
+struct GpioEdge {
+    uint8_t pin;
+    uint8_t level;
+    int64_t timeUs;     // esp_timer_get_time(), unaffected by DFS clock changes
+};
+
+// Runs in interrupt context: must be IRAM_ATTR and must not touch flash
+typedef void (*GpioEdgeHandler)(const GpioEdge& edge, void* context);
+
+// Per-pin interrupt dispatch with a user context pointer. The slots live in
+// DRAM and dispatch() in IRAM, so edges are handled while the flash cache is
+// off (during OTA and NVS writes). Each slot also keeps the last edge time
+// and an edge count that can be read without a handler.
+class GpioIsr {
+public:
+    static bool attach(uint8_t pin, GpioEdgeHandler handler, void* context, gpio_int_type_t type) {
+        if (pin >= GPIO_NUM_MAX || handler == nullptr) {
+            return false;
+        }
+
+        // ESP_ERR_INVALID_STATE: already installed, e.g. by attachInterrupt()
+        esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            return false;
+        }
+
+        Slot& slot = slots[pin];
+        slot.handler = handler;
+        slot.context = context;
+        slot.pin = pin;
+        slot.lastUs = 0;
+        slot.count = 0;
+
+        return gpio_set_intr_type((gpio_num_t)pin, type) == ESP_OK &&
+               gpio_isr_handler_add((gpio_num_t)pin, dispatch, &slot) == ESP_OK &&
+               gpio_intr_enable((gpio_num_t)pin) == ESP_OK;
+    }
+
+    static void detach(uint8_t pin) {
+        if (pin >= GPIO_NUM_MAX) return;
+        gpio_intr_disable((gpio_num_t)pin);
+        gpio_isr_handler_remove((gpio_num_t)pin);
+        slots[pin].handler = nullptr;
+    }
+
+    static int64_t lastEdgeUs(uint8_t pin) {
+        return pin < GPIO_NUM_MAX ? slots[pin].lastUs : 0;
+    }
+
+    static uint32_t edgeCount(uint8_t pin) {
+        return pin < GPIO_NUM_MAX ? slots[pin].count : 0;
+    }
+
+private:
+    struct Slot {
+        GpioEdgeHandler handler;
+        void* context;
+        volatile int64_t lastUs;
+        volatile uint32_t count;
+        uint8_t pin;
+    };
+
+    static Slot slots[GPIO_NUM_MAX];
+
+    static void IRAM_ATTR dispatch(void* arg) {
+        int64_t now = esp_timer_get_time();
+        Slot* slot = static_cast<Slot*>(arg);
+        uint8_t pin = slot->pin;
+        uint32_t in = REG_READ(pin < 32 ? GPIO_IN_REG : GPIO_IN1_REG);
+
+        slot->lastUs = now;
+        slot->count = slot->count + 1;
+        GpioEdgeHandler handler = slot->handler;
+        if (handler != nullptr) {
+            GpioEdge edge = { pin, (uint8_t)((in >> (pin & 31)) & 1), now };
+            handler(edge, slot->context);
+        }
+    }
+};
+
+DRAM_ATTR GpioIsr::Slot GpioIsr::slots[GPIO_NUM_MAX] = {};
+
 #endif
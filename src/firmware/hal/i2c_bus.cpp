@@ -0,0 +1,378 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <driver/i2c.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "../config/board_profile.h"
+#include "../modules/power_manager.cpp"
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+
+struct I2cResult {
+    uint8_t address;
+    esp_err_t status;       // ESP_OK, ESP_FAIL (no ACK), ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE
+    uint32_t latencyUs;     // From submit() to the end of the transfer, queueing included
+    uint8_t mergedWrites;   // Transactions that went out in the same transfer, this one included
+};
+
+// Runs on the bus task: keep it short and never wait on the bus from it
+typedef void (*I2cCallback)(const I2cResult& result, void* context);
+
+// Completion a caller can block on, one transaction at a time
+class I2cFuture {
+public:
+    I2cFuture() : done(xSemaphoreCreateBinary()) {}
+    ~I2cFuture() { vSemaphoreDelete(done); }
+
+    I2cFuture(const I2cFuture&) = delete;
+    I2cFuture& operator=(const I2cFuture&) = delete;
+
+    // ESP_ERR_TIMEOUT if the transaction is still queued or running after ticks
+    esp_err_t wait(TickType_t ticks = portMAX_DELAY) {
+        if (pending) {
+            if (xSemaphoreTake(done, ticks) != pdTRUE) {
+                return ESP_ERR_TIMEOUT;
+            }
+            pending = false;
+        }
+        return result.status;
+    }
+
+    bool isPending() const {
+        return pending;
+    }
+
+    const I2cResult& getResult() const {
+        return result;
+    }
+
+private:
+    friend class I2cBus;
+
+    SemaphoreHandle_t done;
+    volatile bool pending = false;
+    I2cResult result = {};
+
+    void arm() {
+        xSemaphoreTake(done, 0);
+        pending = true;
+    }
+
+    void complete(const I2cResult& outcome) {
+        result = outcome;
+        xSemaphoreGive(done);
+    }
+};
+
+// One bus transaction: a write, a read, or a write then a repeated-start read.
+// The buffers stay owned by the caller and must outlive the transaction.
+struct I2cTransaction {
+    uint8_t address = 0;
+    const uint8_t* tx = nullptr;
+    size_t txLength = 0;
+    uint8_t* rx = nullptr;
+    size_t rxLength = 0;
+    // Leading bytes that start every write of this kind to the device, e.g. the
+    // SSD1306 0x00 (commands) / 0x40 (data) control byte. Queued writes with
+    // the same prefix go out as one transfer carrying the prefix once.
+    // 0 never merges, which is right for register writes.
+    uint8_t mergePrefix = 0;
+    I2cCallback callback = nullptr;
+    void* context = nullptr;
+    I2cFuture* future = nullptr;
+    uint32_t queuedUs = 0;      // Set by submit()
+};
+
+// Bus owner for the I2C controller. Every transaction goes through one queue
+// to a single task that drives the IDF master driver, so devices sharing the
+// bus never interleave. The driver is interrupt-driven (the S3's I2C has no
+// DMA: the ISR refills the 32-byte FIFO), and the task sleeps while a transfer
+// runs. The bus clock is the fastest every registered device supports, up to
+// the board's limit: 1 MHz Fast-mode Plus needs the pull-ups for it.
+//
+// Without a task (creation refused, as in the host's virtual time) submit()
+// runs the transaction in the caller instead.
+class I2cBus {
+public:
+    static const uint8_t MAX_DEVICES = 8;
+    static const UBaseType_t QUEUE_LENGTH = 16;
+    static const size_t MERGE_BYTES = 1025;        // A 128x64 SSD1306 frame plus its control byte
+    static const uint8_t MAX_MERGE = 8;
+    static const uint32_t TRANSFER_TIMEOUT_MS = 50;
+
+    struct DeviceStats {
+        uint8_t address;
+        uint32_t maxFrequency;
+        int16_t latencyMetric;      // HistogramId, or -1
+        std::atomic<uint32_t> transactions;
+        std::atomic<uint32_t> transfers;
+        std::atomic<uint32_t> errors;
+        std::atomic<uint32_t> bytes;
+    };
+
+    static bool begin(i2c_port_t busPort = I2C_NUM_0) {
+        if (queue != nullptr) {
+            return true;
+        }
+        port = busPort;
+        frequency = Board::I2c::FREQUENCY;
+        if (configure(frequency) != ESP_OK ||
+            i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0) != ESP_OK) {
+            Logger::error("I2C", "Driver install failed");
+            return false;
+        }
+        appliedFrequency = frequency;
+
+        queue = xQueueCreate(QUEUE_LENGTH, sizeof(I2cTransaction));
+        inlineLock = xSemaphoreCreateMutex();
+        if (queue == nullptr || inlineLock == nullptr) {
+            return false;
+        }
+        if (xTaskCreatePinnedToCore(taskEntry, "i2c", 4096, nullptr, 6, &task, 0) != pdPASS) {
+            task = nullptr;
+            Logger::debug("I2C", "No bus task, transactions run in the caller");
+        }
+        Logger::info("I2C", "Bus on SDA " + String(Board::I2c::SDA) + ", SCL " + String(Board::I2c::SCL) +
+                     " at " + String(frequency / 1000) + " kHz");
+        return true;
+    }
+
+    // Devices declare the fastest clock they accept; the bus slows down to the
+    // slowest one. The change applies from the next transfer.
+    static bool addDevice(uint8_t address, uint32_t maxFrequency, int16_t latencyMetric = -1) {
+        DeviceStats* device = find(address);
+        if (device == nullptr) {
+            if (deviceCount >= MAX_DEVICES) {
+                return false;
+            }
+            device = &devices[deviceCount];
+            device->address = address;
+            deviceCount++;
+        }
+        device->maxFrequency = maxFrequency;
+        device->latencyMetric = latencyMetric;
+
+        uint32_t bus = Board::I2c::FREQUENCY;
+        for (uint8_t i = 0; i < deviceCount; i++) {
+            bus = min(bus, devices[i].maxFrequency);
+        }
+        frequency = bus;
+        return true;
+    }
+
+    // Queues a transaction; false if the queue stays full for ticks. Completion
+    // is reported through the transaction's callback and/or future.
+    static bool submit(const I2cTransaction& transaction, TickType_t ticks = portMAX_DELAY) {
+        if (queue == nullptr) {
+            return false;
+        }
+        I2cTransaction item = transaction;
+        item.queuedUs = micros();
+        if (item.future != nullptr) {
+            item.future->arm();
+        }
+
+        if (task == nullptr) {
+            xSemaphoreTake(inlineLock, portMAX_DELAY);
+            execute(&item, 1);
+            xSemaphoreGive(inlineLock);
+            return true;
+        }
+        if (xQueueSend(queue, &item, ticks) != pdTRUE) {
+            if (item.future != nullptr) {
+                item.future->pending = false;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    // Blocking write/read through the queue, for callers that need the answer now
+    static esp_err_t transfer(uint8_t address, const uint8_t* tx, size_t txLength, uint8_t* rx = nullptr,
+                              size_t rxLength = 0, uint32_t timeoutMs = 100) {
+        I2cFuture future;
+        I2cTransaction transaction;
+        transaction.address = address;
+        transaction.tx = tx;
+        transaction.txLength = txLength;
+        transaction.rx = rx;
+        transaction.rxLength = rxLength;
+        transaction.future = &future;
+        if (!submit(transaction, pdMS_TO_TICKS(timeoutMs))) {
+            return ESP_ERR_TIMEOUT;
+        }
+        // The task still holds the future until it completes, so wait it out
+        return future.wait(portMAX_DELAY);
+    }
+
+    static bool isStarted() {
+        return queue != nullptr;
+    }
+
+    static uint32_t getFrequency() {
+        return frequency;
+    }
+
+    static const DeviceStats* getStats(uint8_t address) {
+        return find(address);
+    }
+
+    static void logStats() {
+        for (uint8_t i = 0; i < deviceCount; i++) {
+            const DeviceStats& device = devices[i];
+            String line = "0x" + String(device.address, HEX) + ": " + String(device.transactions.load()) +
+                          " transactions in " + String(device.transfers.load()) + " transfers, " +
+                          String(device.errors.load()) + " errors, " + String(device.bytes.load()) + " bytes";
+            if (device.latencyMetric >= 0) {
+                const Histogram& latency = Metrics::histogram((HistogramId)device.latencyMetric);
+                line += ", p50 " + String(latency.quantile(0.5f)) + " us, p99 " + String(latency.quantile(0.99f)) + " us";
+            }
+            Logger::info("I2C", line);
+        }
+    }
+
+private:
+    static i2c_port_t port;
+    static QueueHandle_t queue;
+    static SemaphoreHandle_t inlineLock;
+    static TaskHandle_t task;
+    static volatile uint32_t frequency;
+    static uint32_t appliedFrequency;
+    static DeviceStats devices[MAX_DEVICES];
+    static uint8_t deviceCount;
+    static uint8_t mergeBuffer[MERGE_BYTES];
+
+    static DeviceStats* find(uint8_t address) {
+        for (uint8_t i = 0; i < deviceCount; i++) {
+            if (devices[i].address == address) return &devices[i];
+        }
+        return nullptr;
+    }
+
+    static esp_err_t configure(uint32_t hz) {
+        i2c_config_t config = {};
+        config.mode = I2C_MODE_MASTER;
+        config.sda_io_num = Board::I2c::SDA;
+        config.scl_io_num = Board::I2c::SCL;
+        config.sda_pullup_en = true;
+        config.scl_pullup_en = true;
+        config.master.clk_speed = hz;
+        config.clk_flags = 0;
+        return i2c_param_config(port, &config);
+    }
+
+    static void taskEntry(void* arg) {
+        I2cTransaction batch[MAX_MERGE];
+        while (true) {
+            if (xQueueReceive(queue, &batch[0], portMAX_DELAY) != pdTRUE) {
+                continue;
+            }
+            execute(batch, collectMerges(batch));
+        }
+    }
+
+    static bool canMerge(const I2cTransaction& first, const I2cTransaction& next, size_t length) {
+        return next.address == first.address && next.rxLength == 0 && next.mergePrefix == first.mergePrefix &&
+               next.txLength >= next.mergePrefix && length + next.txLength - next.mergePrefix <= MERGE_BYTES &&
+               memcmp(next.tx, first.tx, first.mergePrefix) == 0;
+    }
+
+    // Pulls queued writes that continue batch[0] off the front of the queue.
+    // Only this task receives, so a peeked item is still there to take.
+    static size_t collectMerges(I2cTransaction* batch) {
+        const I2cTransaction& first = batch[0];
+        if (first.mergePrefix == 0 || first.rxLength != 0 || first.txLength < first.mergePrefix) {
+            return 1;
+        }
+        size_t count = 1;
+        size_t length = first.txLength;
+        I2cTransaction next;
+        while (count < MAX_MERGE && xQueuePeek(queue, &next, 0) == pdTRUE && canMerge(first, next, length)) {
+            xQueueReceive(queue, &batch[count], 0);
+            length += next.txLength - next.mergePrefix;
+            count++;
+        }
+        return count;
+    }
+
+    static void execute(I2cTransaction* batch, size_t count) {
+        const I2cTransaction& first = batch[0];
+        const uint8_t* data = first.tx;
+        size_t length = first.txLength;
+
+        if (count > 1) {
+            memcpy(mergeBuffer, first.tx, first.txLength);
+            length = first.txLength;
+            for (size_t i = 1; i < count; i++) {
+                size_t payload = batch[i].txLength - batch[i].mergePrefix;
+                memcpy(mergeBuffer + length, batch[i].tx + batch[i].mergePrefix, payload);
+                length += payload;
+            }
+            data = mergeBuffer;
+            Metrics::inc(I2C_MERGED_WRITES, count - 1);
+        }
+
+        esp_err_t status;
+        {
+            // The controller is clocked from APB, which DFS would otherwise slow down
+            PmLockGuard pmLock(PM_WORK_I2C);
+            uint32_t wanted = frequency;
+            if (wanted != appliedFrequency && configure(wanted) == ESP_OK) {
+                appliedFrequency = wanted;
+            }
+
+            TickType_t ticks = pdMS_TO_TICKS(TRANSFER_TIMEOUT_MS);
+            if (first.rxLength == 0) {
+                status = i2c_master_write_to_device(port, first.address, data, length, ticks);
+            } else if (first.txLength == 0) {
+                status = i2c_master_read_from_device(port, first.address, first.rx, first.rxLength, ticks);
+            } else {
+                status = i2c_master_write_read_device(port, first.address, first.tx, first.txLength,
+                                                      first.rx, first.rxLength, ticks);
+            }
+        }
+
+        uint32_t end = micros();
+        DeviceStats* device = find(first.address);
+        if (device != nullptr) {
+            device->transfers++;
+            device->bytes += length + first.rxLength;
+        }
+        if (status != ESP_OK) {
+            Metrics::inc(I2C_ERRORS);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            I2cTransaction& transaction = batch[i];
+            I2cResult result = { transaction.address, status, end - transaction.queuedUs, (uint8_t)count };
+            if (device != nullptr) {
+                device->transactions++;
+                if (status != ESP_OK) device->errors++;
+                if (device->latencyMetric >= 0) {
+                    Metrics::observe((HistogramId)device->latencyMetric, result.latencyUs);
+                }
+            }
+            if (transaction.callback != nullptr) {
+                transaction.callback(result, transaction.context);
+            }
+            if (transaction.future != nullptr) {
+                transaction.future->complete(result);
+            }
+        }
+    }
+};
+
+i2c_port_t I2cBus::port = I2C_NUM_0;
+QueueHandle_t I2cBus::queue = nullptr;
+SemaphoreHandle_t I2cBus::inlineLock = nullptr;
+TaskHandle_t I2cBus::task = nullptr;
+volatile uint32_t I2cBus::frequency = 0;
+uint32_t I2cBus::appliedFrequency = 0;
+I2cBus::DeviceStats I2cBus::devices[I2cBus::MAX_DEVICES] = {};
+uint8_t I2cBus::deviceCount = 0;
+uint8_t I2cBus::mergeBuffer[I2cBus::MERGE_BYTES];
+
+#endif
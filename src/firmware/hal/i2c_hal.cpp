@@ -2,14 +2,14 @@
 #define I2C_HAL_H
 
 #include <Wire.h>
-#include "../config/pinmap.h"
+#include "../config/board_profile.h"
 #include "../utils/logger.cpp"
 
 class I2cHal {
 public:
     static bool init() {
-        Logger::debug("I2C", "Initializing I2C on pins SDA: " + String(I2C_SDA) + ", SCL: " + String(I2C_SCL));
-        return begin(I2C_SDA, I2C_SCL);
+        Logger::debug("I2C", "Initializing I2C on pins SDA: " + String(Board::I2c::SDA) + ", SCL: " + String(Board::I2c::SCL));
+        return begin(Board::I2c::SDA, Board::I2c::SCL, Board::I2c::FREQUENCY);
     }
 
     static bool begin(uint8_t sda, uint8_t scl, uint32_t frequency = 400000) {
@@ -1,37 +1,331 @@
 #ifndef I2S_HAL_H
 #define I2S_HAL_H
 
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <driver/i2s_std.h>
+#include <driver/i2s_tdm.h>
+#else
 #include <driver/i2s.h>
+#endif
+
+// Receive side of I2S microphones in 32-bit slots: 24-bit MEMS mics send
+// their sample left-justified in a 32-bit slot, which a 16-bit setup
+// truncates or misreads. IDF 5 goes through the standard / TDM channel API;
+// IDF 4.4 (arduino-esp32 2.x) through the legacy driver with 32-bit samples.
+// The two drivers cannot be linked together, so only one is compiled in.
+//
+// Microphones share BCLK, WS and DIN: one is mono (left slot), two are a
+// stereo pair (L/R select pin low on channel 0, high on channel 1), three or
+// four are TDM slots. Frames arrive interleaved, channel 0 first.
+//
+// The transmit side drives the speaker amplifier: 16-bit mono, left slot. It
+// only runs while there is something to play, and starts with its first
+// samples already in the DMA buffers.
+struct I2sRxConfig {
+    uint8_t port;
+    uint32_t sampleRate;
+    uint8_t bclk;
+    uint8_t ws;
+    uint8_t din;
+    uint8_t dmaBufCount;
+    uint16_t dmaBufLen;         // Frames per DMA buffer, at most 4092 bytes of 32-bit slots
+    uint8_t channels = 1;
+};
+
+struct I2sTxConfig {
+    uint8_t port;
+    uint32_t sampleRate;
+    uint8_t bclk;
+    uint8_t ws;
+    uint8_t dout;
+    uint8_t dmaBufCount;
+    uint16_t dmaBufLen;         // Frames per DMA buffer (16-bit mono)
+};
 
 class I2sHal {
 public:
+    static const uint8_t PORTS = 2;
+    static const uint8_t MAX_CHANNELS = 4;
+    static const size_t MAX_DMA_BUFFER_BYTES = 4092;
+
+    static esp_err_t beginRx(const I2sRxConfig& config) {
+        if (config.port >= PORTS || config.channels < 1 || config.channels > MAX_CHANNELS ||
+            (size_t)config.dmaBufLen * config.channels * sizeof(int32_t) > MAX_DMA_BUFFER_BYTES) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        channels[config.port] = config.channels;
+#if ESP_IDF_VERSION_MAJOR >= 5
+        i2s_chan_config_t channel = I2S_CHANNEL_DEFAULT_CONFIG((i2s_port_t)config.port, I2S_ROLE_MASTER);
+        channel.dma_desc_num = config.dmaBufCount;
+        channel.dma_frame_num = config.dmaBufLen;
+        esp_err_t err = i2s_new_channel(&channel, nullptr, &rx[config.port]);
+        if (err != ESP_OK) return err;
+
+        if (config.channels <= 2) {
+            i2s_std_config_t standard = {
+                .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(config.sampleRate),
+                .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT,
+                    config.channels == 2 ? I2S_SLOT_MODE_STEREO : I2S_SLOT_MODE_MONO),
+                .gpio_cfg = {
+                    .mclk = I2S_GPIO_UNUSED,
+                    .bclk = (gpio_num_t)config.bclk,
+                    .ws = (gpio_num_t)config.ws,
+                    .dout = I2S_GPIO_UNUSED,
+                    .din = (gpio_num_t)config.din,
+                    .invert_flags = { .mclk_inv = false, .bclk_inv = false, .ws_inv = false }
+                }
+            };
+            standard.slot_cfg.slot_mask = config.channels == 2 ? I2S_STD_SLOT_BOTH : I2S_STD_SLOT_LEFT;
+            err = i2s_channel_init_std_mode(rx[config.port], &standard);
+        } else {
+            i2s_tdm_slot_mask_t slots = (i2s_tdm_slot_mask_t)((1 << config.channels) - 1);
+            i2s_tdm_config_t tdm = {
+                .clk_cfg = I2S_TDM_CLK_DEFAULT_CONFIG(config.sampleRate),
+                .slot_cfg = I2S_TDM_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO, slots),
+                .gpio_cfg = {
+                    .mclk = I2S_GPIO_UNUSED,
+                    .bclk = (gpio_num_t)config.bclk,
+                    .ws = (gpio_num_t)config.ws,
+                    .dout = I2S_GPIO_UNUSED,
+                    .din = (gpio_num_t)config.din,
+                    .invert_flags = { .mclk_inv = false, .bclk_inv = false, .ws_inv = false }
+                }
+            };
+            err = i2s_channel_init_tdm_mode(rx[config.port], &tdm);
+        }
+        if (err != ESP_OK) return err;
+
+        i2s_event_callbacks_t callbacks = {};
+        callbacks.on_recv_q_ovf = onOverrun;
+        i2s_channel_register_event_callback(rx[config.port], &callbacks, (void*)&overruns[config.port]);
+        return i2s_channel_enable(rx[config.port]);
+#else
+        i2s_config_t legacy = {
+            .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
+            .sample_rate = config.sampleRate,
+            .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,
+            .channel_format = config.channels == 1 ? I2S_CHANNEL_FMT_ONLY_LEFT :
+                              config.channels == 2 ? I2S_CHANNEL_FMT_RIGHT_LEFT : I2S_CHANNEL_FMT_MULTIPLE,
+            .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+            .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+            .dma_buf_count = config.dmaBufCount,
+            .dma_buf_len = config.dmaBufLen,
+            .use_apll = false
+        };
+        if (config.channels > 2) {
+            // TDM slots 0 .. channels - 1
+            legacy.chan_mask = (i2s_channel_t)(((1 << config.channels) - 1) * I2S_TDM_ACTIVE_CH0);
+            legacy.total_chan = config.channels;
+        }
+        i2s_pin_config_t pins = {
+            .mck_io_num = I2S_PIN_NO_CHANGE,
+            .bck_io_num = config.bclk,
+            .ws_io_num = config.ws,
+            .data_out_num = I2S_PIN_NO_CHANGE,
+            .data_in_num = config.din
+        };
+        // The event queue reports receive overruns
+        esp_err_t err = i2s_driver_install((i2s_port_t)config.port, &legacy, EVENT_QUEUE_LEN, &events[config.port]);
+        if (err != ESP_OK) return err;
+        return i2s_set_pin((i2s_port_t)config.port, &pins);
+#endif
+    }
+
+    // Reads up to count frames of channels 32-bit slots each, interleaved;
+    // blocking on the DMA queue holds no PM lock
+    static esp_err_t readFrames(uint8_t port, int32_t* frames, size_t count, size_t* framesRead, TickType_t ticks) {
+        size_t frameBytes = channels[port] * sizeof(int32_t);
+        size_t bytesRead = 0;
+#if ESP_IDF_VERSION_MAJOR >= 5
+        uint32_t timeoutMs = ticks == portMAX_DELAY ? portMAX_DELAY : ticks * portTICK_PERIOD_MS;
+        esp_err_t err = i2s_channel_read(rx[port], frames, count * frameBytes, &bytesRead, timeoutMs);
+#else
+        esp_err_t err = i2s_read((i2s_port_t)port, frames, count * frameBytes, &bytesRead, ticks);
+#endif
+        *framesRead = bytesRead / frameBytes;
+        return err;
+    }
+
+    // Receive DMA overruns since the last call
+    static uint32_t takeOverruns(uint8_t port) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        uint32_t seen = overruns[port];
+        uint32_t count = seen - overrunsTaken[port];
+        overrunsTaken[port] = seen;
+        return count;
+#else
+        uint32_t count = 0;
+        i2s_event_t event;
+        while (events[port] && xQueueReceive(events[port], &event, 0) == pdTRUE) {
+            if (event.type == I2S_EVENT_RX_Q_OVF) {
+                count++;
+            }
+        }
+        return count;
+#endif
+    }
+
+    // Sets up the port for output without starting its clock
+    static esp_err_t beginTx(const I2sTxConfig& config) {
+        if (config.port >= PORTS || config.dmaBufCount < 2 ||
+            (size_t)config.dmaBufLen * sizeof(int16_t) > MAX_DMA_BUFFER_BYTES) {
+            return ESP_ERR_INVALID_ARG;
+        }
+#if ESP_IDF_VERSION_MAJOR >= 5
+        i2s_chan_config_t channel = I2S_CHANNEL_DEFAULT_CONFIG((i2s_port_t)config.port, I2S_ROLE_MASTER);
+        channel.dma_desc_num = config.dmaBufCount;
+        channel.dma_frame_num = config.dmaBufLen;
+        channel.auto_clear = true;      // Silence on an underrun, not the last buffer again
+        esp_err_t err = i2s_new_channel(&channel, &tx[config.port], nullptr);
+        if (err != ESP_OK) return err;
+
+        i2s_std_config_t standard = {
+            .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(config.sampleRate),
+            .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+            .gpio_cfg = {
+                .mclk = I2S_GPIO_UNUSED,
+                .bclk = (gpio_num_t)config.bclk,
+                .ws = (gpio_num_t)config.ws,
+                .dout = (gpio_num_t)config.dout,
+                .din = I2S_GPIO_UNUSED,
+                .invert_flags = { .mclk_inv = false, .bclk_inv = false, .ws_inv = false }
+            }
+        };
+        standard.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+        return i2s_channel_init_std_mode(tx[config.port], &standard);
+#else
+        i2s_config_t legacy = {
+            .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
+            .sample_rate = config.sampleRate,
+            .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+            .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+            .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+            .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+            .dma_buf_count = config.dmaBufCount,
+            .dma_buf_len = config.dmaBufLen,
+            .use_apll = false,
+            .tx_desc_auto_clear = true
+        };
+        i2s_pin_config_t pins = {
+            .mck_io_num = I2S_PIN_NO_CHANGE,
+            .bck_io_num = config.bclk,
+            .ws_io_num = config.ws,
+            .data_out_num = config.dout,
+            .data_in_num = I2S_PIN_NO_CHANGE
+        };
+        esp_err_t err = i2s_driver_install((i2s_port_t)config.port, &legacy, 0, nullptr);
+        if (err != ESP_OK) return err;
+        err = i2s_set_pin((i2s_port_t)config.port, &pins);
+        if (err != ESP_OK) return err;
+        // The legacy driver clocks out from install; stay idle until startTx()
+        return i2s_stop((i2s_port_t)config.port);
+#endif
+    }
+
+    // Starts the clock with count samples. IDF 5 preloads them into the DMA
+    // buffers, so the first plays as the clock starts; the legacy driver
+    // starts on a zeroed buffer, which puts one buffer of silence first.
+    static esp_err_t startTx(uint8_t port, const int16_t* samples, size_t count, size_t* started) {
+        size_t bytes = 0;
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_err_t err = i2s_channel_preload_data(tx[port], samples, count * sizeof(int16_t), &bytes);
+        if (err == ESP_OK) {
+            err = i2s_channel_enable(tx[port]);
+        }
+#else
+        esp_err_t err = i2s_start((i2s_port_t)port);
+        if (err == ESP_OK) {
+            err = i2s_write((i2s_port_t)port, samples, count * sizeof(int16_t), &bytes, 0);
+        }
+#endif
+        *started = bytes / sizeof(int16_t);
+        return err;
+    }
+
+    // Queues samples behind those already in the DMA buffers; blocks until
+    // they fit, which is the pace of the output
+    static esp_err_t writeSamples(uint8_t port, const int16_t* samples, size_t count, size_t* written, TickType_t ticks) {
+        size_t bytes = 0;
+#if ESP_IDF_VERSION_MAJOR >= 5
+        uint32_t timeoutMs = ticks == portMAX_DELAY ? portMAX_DELAY : ticks * portTICK_PERIOD_MS;
+        esp_err_t err = i2s_channel_write(tx[port], samples, count * sizeof(int16_t), &bytes, timeoutMs);
+#else
+        esp_err_t err = i2s_write((i2s_port_t)port, samples, count * sizeof(int16_t), &bytes, ticks);
+#endif
+        *written = bytes / sizeof(int16_t);
+        return err;
+    }
+
+    // Stops the clock once the queued samples no longer matter
+    static esp_err_t stopTx(uint8_t port) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        return i2s_channel_disable(tx[port]);
+#else
+        return i2s_stop((i2s_port_t)port);
+#endif
+    }
+
+#if ESP_IDF_VERSION_MAJOR < 5
     static esp_err_t init(i2s_port_t port, const i2s_config_t *config) {
         return i2s_driver_install(port, config, 0, NULL);
     }
-    
+
     static esp_err_t setPins(i2s_port_t port, const i2s_pin_config_t *pins) {
         return i2s_set_pin(port, pins);
     }
-    
+
     static esp_err_t read(i2s_port_t port, void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait) {
         return i2s_read(port, dest, size, bytes_read, ticks_to_wait);
     }
-    
+
     static esp_err_t write(i2s_port_t port, const void *src, size_t size, size_t *bytes_written, TickType_t ticks_to_wait) {
         return i2s_write(port, src, size, bytes_written, ticks_to_wait);
     }
-    
+
     static esp_err_t setClk(i2s_port_t port, uint32_t rate, i2s_bits_per_sample_t bits, i2s_channel_t ch) {
         return i2s_set_clk(port, rate, bits, ch);
     }
-    
+
     static esp_err_t stop(i2s_port_t port) {
         return i2s_stop(port);
     }
-    
+
     static esp_err_t start(i2s_port_t port) {
         return i2s_start(port);
     }
+#endif
+
+private:
+    static uint8_t channels[PORTS];
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+    static i2s_chan_handle_t rx[PORTS];
+    static i2s_chan_handle_t tx[PORTS];
+    static volatile uint32_t overruns[PORTS];
+    static uint32_t overrunsTaken[PORTS];
+
+    static bool IRAM_ATTR onOverrun(i2s_chan_handle_t handle, i2s_event_data_t* event, void* context) {
+        volatile uint32_t* count = (volatile uint32_t*)context;
+        *count = *count + 1;
+        return false;
+    }
+#else
+    static const int EVENT_QUEUE_LEN = 8;
+    static QueueHandle_t events[PORTS];
+#endif
 };
 
+uint8_t I2sHal::channels[I2sHal::PORTS] = { 1, 1 };
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+i2s_chan_handle_t I2sHal::rx[I2sHal::PORTS] = {};
+i2s_chan_handle_t I2sHal::tx[I2sHal::PORTS] = {};
+volatile uint32_t I2sHal::overruns[I2sHal::PORTS] = {};
+uint32_t I2sHal::overrunsTaken[I2sHal::PORTS] = {};
+#else
+QueueHandle_t I2sHal::events[I2sHal::PORTS] = {};
+#endif
+
 #endif
@@ -4,13 +4,26 @@
 #include "../drivers/audio_driver.cpp"
 #include "../modules/touch_module.cpp"
 #include "../modules/power_module.cpp"
+#include "../modules/ota_updater.cpp"
+#include "../modules/vision_module.cpp"
 #include "../utils/logger.cpp"
+#include "../utils/trace.cpp"
+#include "../utils/metrics.cpp"
+#include "../utils/boot_orchestrator.cpp"
 
 NetworkModule networkModule;
 DisplayDriver displayDriver;
 AudioDriver audioDriver;
 TouchModule touchModule;
 PowerModule powerModule;
+OtaUpdater otaUpdater;
+VisionModule visionModule;
+BootOrchestrator boot;
+
+// An update is judged on the steps the image itself answers for; Wi-Fi and
+// the peripherals also depend on where the glasses are
+uint32_t firmwareSteps = 0;
+uint32_t networkStep = 0;
 
 // Configuration
 const char* WIFI_SSID = "Your_WiFi_SSID";
@@ -18,39 +31,112 @@ const char* WIFI_PASS = "Your_WiFi_Password";
 const char* SERVER_ADDRESS = "192.168.1.100";
 const int SERVER_PORT = 8000;
 
+void handleTouchEvent(TouchGesture gesture);
+void handleVoiceCommand();
+void handleLocalIntent(LocalIntent intent);
+void handleVisionRequest(VisionRequest request);
+void serviceUpdates();
+
+// The core would confirm an updated image before setup(); OtaUpdater does it
+// once the boot has completed, so an image that cannot boot is rolled back
+extern "C" bool verifyRollbackLater() {
+    return true;
+}
+
 void setup() {
-    // Initialize logger first for debugging
-    Logger::init(LOG_DEBUG);
-    Logger::info("MAIN", "System initialization starting...");
+    // Logger first; Wi-Fi associates in the background while the rest comes up
+    uint8_t logger = boot.add("logger", [] {
+        Logger::init(LOG_DEBUG);
+        Logger::info("MAIN", "System initialization starting...");
+        return true;
+    });
     
-    // Initialize components
-    if (!displayDriver.begin()) {
-        Logger::error("MAIN", "Display initialization failed!");
-    } else {
-        Logger::info("MAIN", "Display initialized successfully");
-    }
+    uint8_t wifi = boot.add("wifi", [] {
+        Logger::info("MAIN", "Connecting to WiFi...");
+        networkModule.begin(WIFI_SSID, WIFI_PASS);
+        return true;
+    }, [] {
+        if (networkModule.isConnecting()) {
+            return BOOT_RUNNING;
+        }
+        if (WiFi.status() == WL_CONNECTED) {
+            Logger::info("MAIN", "Connected to WiFi");
+            return BOOT_DONE;
+        }
+        displayDriver.showError("Network Error");
+        return BOOT_FAILED;
+    }, BootOrchestrator::after(logger), BOOT_BACKGROUND);
     
-    if (!audioDriver.begin()) {
-        Logger::error("MAIN", "Audio initialization failed!");
-    } else {
-        Logger::info("MAIN", "Audio initialized successfully");
-    }
+    // Fonts and icons come from the mapped asset pack; a missing pack only
+    // means the built-in font, so it never fails the boot
+    uint8_t assets = boot.add("assets", [] {
+        AssetStore::mount();
+        return true;
+    }, nullptr, BootOrchestrator::after(logger));
     
-    if (!touchModule.begin()) {
-        Logger::error("MAIN", "Touch sensor initialization failed!");
-    } else {
-        Logger::info("MAIN", "Touch sensor initialized successfully");
-    }
+    uint8_t display = boot.add("display", [] { return displayDriver.begin(); }, nullptr,
+             BootOrchestrator::after(logger) | BootOrchestrator::after(assets));
     
-    // Connect to WiFi
-    Logger::info("MAIN", "Connecting to WiFi...");
-    if (!networkModule.connect(WIFI_SSID, WIFI_PASS)) {
-        Logger::error("MAIN", "Network connection failed!");
-        displayDriver.showError("Network Error");
-    } else {
-        Logger::info("MAIN", "Connected to WiFi");
+    uint8_t audio = boot.add("audio", [] {
+        audioDriver.setNetworkModule(&networkModule);
+        return audioDriver.begin();
+    }, nullptr, BootOrchestrator::after(logger));
+    
+    // Earcons need the pack's prompts; without them the glasses stay silent
+    boot.add("speaker", [] {
+        if (!audioDriver.beginOutput()) {
+            Logger::warning("MAIN", "Speaker prompts unavailable");
+        }
+        return true;
+    }, nullptr, BootOrchestrator::after(assets));
+    
+    // Command templates come from the pack too; the listener must not be
+    // matching while they load
+    uint8_t intents = boot.add("intents", [] {
+        if (!audioDriver.beginIntents()) {
+            Logger::warning("MAIN", "No command templates, every command goes to the server");
+        }
+        return true;
+    }, nullptr, BootOrchestrator::after(assets) | BootOrchestrator::after(audio));
+    
+    firmwareSteps = BootOrchestrator::after(logger) | BootOrchestrator::after(assets) |
+                    BootOrchestrator::after(audio) | BootOrchestrator::after(intents);
+    networkStep = BootOrchestrator::after(wifi);
+    
+    boot.add("listening", [] {
+        if (!audioDriver.startLowPowerListening()) {
+            Logger::warning("MAIN", "Low-power listening unavailable, polling VAD");
+        }
+        return true;
+    }, nullptr, BootOrchestrator::after(audio) | BootOrchestrator::after(intents));
+    
+    boot.add("touch", [] { return touchModule.begin(); }, nullptr, BootOrchestrator::after(logger));
+    
+    // Answers kept from before the restart; RAM-only without the partition
+    boot.add("cache", [] {
+        if (!networkModule.beginCache()) {
+            Logger::warning("MAIN", "No response cache partition, caching in RAM only");
+        }
+        return true;
+    }, nullptr, BootOrchestrator::after(logger));
+    
+    // The camera's SCCB port is the display's I2C bus; a camera that does not
+    // come up only loses scene descriptions
+    if (Board::Camera::PRESENT) {
+        boot.add("camera", [] {
+            visionModule.setNetworkModule(&networkModule);
+            if (!visionModule.begin()) {
+                Logger::warning("MAIN", "Camera unavailable");
+            }
+            return true;
+        }, nullptr, BootOrchestrator::after(display), BOOT_DEFERRED);
     }
     
+    // Battery sampling and DFS can wait for the first loop
+    boot.add("power", [] { return powerModule.begin(); }, nullptr, BootOrchestrator::after(logger), BOOT_DEFERRED);
+    
+    boot.run();
+    
     // Show ready status
     displayDriver.showStatus("System Ready");
     Logger::info("MAIN", "System initialization complete");
@@ -58,9 +144,13 @@ void setup() {
 
 void loop() {
     static unsigned long lastLogTime = 0;
+    static unsigned long lastMetricsPush = 0;
+    static bool batteryWarned = false;
     
     // Main system loop
+    boot.service();
     networkModule.maintain();
+    serviceUpdates();
     powerModule.checkStatus();
     
     // Handle touch events
@@ -72,13 +162,44 @@ void loop() {
     // Handle audio input
     if (audioDriver.voiceDetected()) {
         Logger::info("MAIN", "Voice activity detected");
+        audioDriver.playPrompt(PROMPT_LISTENING);
         handleVoiceCommand();
     }
     
-    // Check battery status
-    if (powerModule.needsAttention()) {
+    // While watching, each new scene is shown as it is described
+    String scene;
+    if (visionModule.service(scene)) {
+        displayDriver.showText(scene);
+    }
+    
+    // Check battery status; the prompt sounds once per low-battery episode
+    bool batteryLow = powerModule.needsAttention();
+    if (batteryLow) {
         Logger::warning("MAIN", "Battery level low");
         displayDriver.showBatteryWarning();
+        if (!batteryWarned) {
+            audioDriver.playPrompt(PROMPT_LOW_BATTERY);
+        }
+    }
+    batteryWarned = batteryLow;
+    
+    // Serial diagnostics: 't' dumps latency traces, 'm' a binary metrics snapshot
+    if (Serial.available()) {
+        switch (Serial.read()) {
+            case 't':
+                Tracer::exportChromeJson(Serial);
+                Tracer::clear();
+                break;
+            case 'm':
+                Metrics::writeSnapshot(Serial);
+                break;
+        }
+    }
+    
+    // Push metrics to the server
+    if (millis() - lastMetricsPush > 60000) {  // Every minute
+        lastMetricsPush = millis();
+        networkModule.postMetrics();
     }
     
     // Periodic status log
@@ -87,7 +208,36 @@ void loop() {
         Logger::info("MAIN", "System running, battery: " + String(powerModule.getBatteryLevel()) + "%");
     }
     
-    delay(10); // Small delay to prevent watchdog issues
+    delay(10); // Yields to the idle task, which may light sleep when no PM lock is held
+}
+
+// Confirms an updated image once its own steps are up, then checks for
+// updates every OTA_CHECK_INTERVAL_MS. The decision waits while Wi-Fi is
+// still associating, but a network that cannot be joined never rolls back.
+void serviceUpdates() {
+    static bool confirmed = false;
+    static unsigned long lastCheck = 0;
+    
+    if (!confirmed) {
+        if (!boot.hasFinished(firmwareSteps | networkStep)) {
+            return;
+        }
+        confirmed = true;
+        otaUpdater.confirmBoot(!boot.hasFailures(firmwareSteps));
+        lastCheck = millis() - OTA_CHECK_INTERVAL_MS;
+    }
+    if (!boot.isComplete()) {
+        return;
+    }
+    if (millis() - lastCheck < OTA_CHECK_INTERVAL_MS || powerModule.needsAttention()) {
+        return;
+    }
+    lastCheck = millis();
+    if (otaUpdater.checkForUpdate() == OtaUpdater::OTA_INSTALLED) {
+        displayDriver.showStatus("Updated, restarting");
+        delay(1000);
+        ESP.restart();
+    }
 }
 
 void handleTouchEvent(TouchGesture gesture) {
@@ -113,13 +263,92 @@ void handleTouchEvent(TouchGesture gesture) {
 void handleVoiceCommand() {
     Logger::info("AUDIO", "Processing voice command");
     String command = audioDriver.getVoiceCommand();
+    LocalIntent intent = audioDriver.takeLocalIntent();
+    if (intent != INTENT_NONE) {
+        handleLocalIntent(intent);
+        return;
+    }
     Logger::debug("AUDIO", "Command text: " + command);
+    VisionRequest vision = visionModule.isReady() ? VisionModule::parseRequest(command) : VISION_NONE;
+    if (vision != VISION_NONE) {
+        handleVisionRequest(vision);
+        return;
+    }
     
+    // Recording is up; the thinking loop covers the server's turn
+    audioDriver.playPrompt(PROMPT_THINKING);
     Logger::info("NETWORK", "Sending command to server");
     String response = networkModule.sendCommand(command);
     Logger::debug("NETWORK", "Server response: " + response);
     
-    audioDriver.playResponse(response);
-    displayDriver.showText(response);
+    {
+        TRACE_SPAN(TRACE_PLAYBACK);
+        audioDriver.playResponse(response, networkModule.lastCommandSucceeded());
+    }
+    {
+        TRACE_SPAN(TRACE_RENDER);
+        displayDriver.showText(response);
+    }
     Logger::info("AUDIO", "Voice command processed");
-} 
\ No newline at end of file
+} 
+
+// Commands recognized on the glasses: no upload, no server turn
+void handleLocalIntent(LocalIntent intent) {
+    Logger::info("AUDIO", "Local command " + String(intent));
+    Metrics::inc(INTENTS_LOCAL);
+    switch (intent) {
+        case INTENT_MUTE:
+            audioDriver.setMuted(true);
+            displayDriver.showStatus("Muted");
+            break;
+        case INTENT_UNMUTE:
+            audioDriver.setMuted(false);
+            displayDriver.showStatus("Unmuted");
+            break;
+        case INTENT_DISPLAY_OFF:
+            displayDriver.setDisplayOn(false);
+            break;
+        case INTENT_DISPLAY_ON:
+            displayDriver.setDisplayOn(true);
+            break;
+        case INTENT_BATTERY_LEVEL:
+            displayDriver.showStatus("Battery " + String((int)powerModule.getBatteryLevel()) + "%");
+            break;
+        default:
+            break;
+    }
+    // Silent while muted
+    audioDriver.playPrompt(PROMPT_DONE);
+}
+
+// Questions about what is in front of the glasses go with a camera frame
+void handleVisionRequest(VisionRequest request) {
+    switch (request) {
+        case VISION_WATCH_START:
+            visionModule.setWatching(true);
+            displayDriver.showStatus("Watching");
+            audioDriver.playPrompt(PROMPT_DONE);
+            return;
+        case VISION_WATCH_STOP:
+            visionModule.setWatching(false);
+            displayDriver.showStatus("Stopped watching");
+            audioDriver.playPrompt(PROMPT_DONE);
+            return;
+        default:
+            break;
+    }
+    audioDriver.playPrompt(PROMPT_THINKING);
+    String description = visionModule.describe();
+    bool described = description.length() > 0;
+    if (!described) {
+        description = "I can't see anything right now";
+    }
+    {
+        TRACE_SPAN(TRACE_PLAYBACK);
+        audioDriver.playResponse(description, described);
+    }
+    {
+        TRACE_SPAN(TRACE_RENDER);
+        displayDriver.showText(description);
+    }
+}
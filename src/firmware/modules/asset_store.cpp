@@ -0,0 +1,107 @@
+#ifndef ASSET_STORE_H
+#define ASSET_STORE_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "../config/asset_ids.h"
+#include "../utils/asset_pack.cpp"
+#include "../utils/logger.cpp"
+
+// The asset pack in the "assets" data partition (partitions_ab.csv), mapped
+// into the data address space through the flash cache. Fonts, bitmaps and
+// prompts are read where they lie: the cache fetches the lines a draw or a
+// playback touches, and nothing is copied to RAM or linked into the app
+// image, so assets cost neither DRAM nor OTA download size.
+//
+// Only the pack's own size is mapped, in 64 KB MMU pages. The pack is flashed
+// separately from the app (pio run -t upload_assets, see
+// scripts/build_assets.py); without one, or with one built from another
+// manifest, mount() fails and callers fall back to the built-in font and
+// text-only screens.
+class AssetStore {
+public:
+    static const uint8_t PARTITION_SUBTYPE = 0x40;
+
+    // Maps and checks the pack; verify also hashes it (a few ms per 100 KB)
+    static bool mount(bool verify = true) {
+        if (mounted) {
+            return true;
+        }
+        const esp_partition_t* partition = esp_partition_find_first(
+            ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)PARTITION_SUBTYPE, "assets");
+        if (partition == nullptr) {
+            Logger::warning("ASSETS", "No assets partition");
+            return false;
+        }
+        uint8_t header[AssetPack::HEADER_BYTES];
+        if (esp_partition_read(partition, 0, header, sizeof(header)) != ESP_OK) {
+            return false;
+        }
+        uint32_t size = header[12] | (uint32_t)header[13] << 8 | (uint32_t)header[14] << 16 | (uint32_t)header[15] << 24;
+        if (memcmp(header, "GAST", 4) != 0 || size < sizeof(header) || size > partition->size) {
+            Logger::warning("ASSETS", "No asset pack in the assets partition");
+            return false;
+        }
+
+        const void* mapped = nullptr;
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_err_t err = esp_partition_mmap(partition, 0, size, ESP_PARTITION_MMAP_DATA, &mapped, &handle);
+#else
+        esp_err_t err = esp_partition_mmap(partition, 0, size, SPI_FLASH_MMAP_DATA, &mapped, &handle);
+#endif
+        if (err != ESP_OK) {
+            Logger::error("ASSETS", String("Mapping the asset pack failed: ") + esp_err_to_name(err));
+            return false;
+        }
+        AssetPackError error = pack.open((const uint8_t*)mapped, size, ASSET_SCHEMA, verify);
+        if (error != ASSET_PACK_OK) {
+            Logger::error("ASSETS", String("Asset pack rejected: ") + assetPackErrorName(error));
+            unmap();
+            return false;
+        }
+        mounted = true;
+        Logger::info("ASSETS", String("Mapped ") + String(pack.size()) + " assets, " + String(size) + " bytes");
+        return true;
+    }
+
+    static void unmount() {
+        if (mounted) {
+            pack.close();
+            unmap();
+            mounted = false;
+        }
+    }
+
+    static bool isMounted() { return mounted; }
+
+    static AssetFont font(AssetId id) { return mounted ? pack.font(id) : AssetFont(); }
+    static AssetBitmap bitmap(AssetId id) { return mounted ? pack.bitmap(id) : AssetBitmap(); }
+    static AssetPrompt prompt(AssetId id) { return mounted ? pack.prompt(id) : AssetPrompt(); }
+
+private:
+    static AssetPack pack;
+    static bool mounted;
+#if ESP_IDF_VERSION_MAJOR >= 5
+    static esp_partition_mmap_handle_t handle;
+#else
+    static spi_flash_mmap_handle_t handle;
+#endif
+
+    static void unmap() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_partition_munmap(handle);
+#else
+        spi_flash_munmap(handle);
+#endif
+    }
+};
+
+AssetPack AssetStore::pack;
+bool AssetStore::mounted = false;
+#if ESP_IDF_VERSION_MAJOR >= 5
+esp_partition_mmap_handle_t AssetStore::handle = 0;
+#else
+spi_flash_mmap_handle_t AssetStore::handle = 0;
+#endif
+
+#endif
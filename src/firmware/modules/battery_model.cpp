@@ -0,0 +1,151 @@
+#ifndef BATTERY_MODEL_H
+#define BATTERY_MODEL_H
+
+#include <stdint.h>
+#include <math.h>
+
+// State-of-charge estimator for one LiPo cell.
+// Plain C++ (no Arduino calls) so discharge traces can be replayed on a PC.
+//
+// Each update:
+//   1. Load-compensates the terminal voltage: OCV = V + I * R_internal
+//   2. Looks the OCV up in the discharge curve to get a voltage-based SoC
+//   3. Predicts SoC by coulomb counting the estimated current
+//   4. Blends the two, trusting the voltage less under heavy load and in the
+//      flat middle of the curve where millivolts say little about charge
+// The load estimate only knows what the device draws, so charging is told
+// from the OCV: smoothed, it has to climb chargeRiseMv from its lowest point
+// to count as charging and fall as far from its peak to count as discharging
+// again. On the charger the coulomb count stops and the voltage leads.
+// The reported percentage only moves with the current direction, so it never
+// ticks back up while discharging or down while charging.
+struct BatteryModelConfig {
+    uint16_t capacityMah = 500;
+    uint16_t internalResistanceMilliOhm = 150;
+    float voltageGain = 0.05f;       // Per-update weight of the voltage estimate
+    float heavyLoadMa = 150.0f;      // Above this the OCV estimate is trusted less
+    float chargeRiseMv = 25.0f;      // OCV swing that flips between charging and discharging
+    float ocvSmoothing = 0.1f;       // Per-update weight of a new OCV in the trend
+};
+
+class BatteryModel {
+public:
+    // Typical single-cell LiPo open-circuit voltage at 0%, 5%, ... 100%
+    static const uint8_t CURVE_POINTS = 21;
+
+    explicit BatteryModel(const BatteryModelConfig& config = BatteryModelConfig())
+        : config(config) {}
+
+    static float socFromOcv(float millivolts) {
+        if (millivolts <= OCV_CURVE[0]) return 0.0f;
+        if (millivolts >= OCV_CURVE[CURVE_POINTS - 1]) return 100.0f;
+
+        for (uint8_t i = 1; i < CURVE_POINTS; i++) {
+            if (millivolts < OCV_CURVE[i]) {
+                float span = OCV_CURVE[i] - OCV_CURVE[i - 1];
+                float frac = (millivolts - OCV_CURVE[i - 1]) / span;
+                return (i - 1 + frac) * 5.0f;
+            }
+        }
+        return 100.0f;
+    }
+
+    static float ocvFromSoc(float percent) {
+        if (percent <= 0.0f) return OCV_CURVE[0];
+        if (percent >= 100.0f) return OCV_CURVE[CURVE_POINTS - 1];
+        uint8_t i = (uint8_t)(percent / 5.0f);
+        float frac = (percent - i * 5.0f) / 5.0f;
+        return OCV_CURVE[i] + frac * (OCV_CURVE[i + 1] - OCV_CURVE[i]);
+    }
+
+    // terminalMv: measured cell voltage, loadMa: estimated discharge current
+    // (negative while charging), elapsedMs: time since the previous update
+    void update(float terminalMv, float loadMa, uint32_t elapsedMs) {
+        float ocv = terminalMv + loadMa * config.internalResistanceMilliOhm / 1000.0f;
+        float voltageSoc = socFromOcv(ocv);
+
+        if (!initialized) {
+            soc = voltageSoc;
+            reported = (int)(soc + 0.5f);
+            trendOcv = ocv;
+            turnOcv = ocv;
+            initialized = true;
+            return;
+        }
+
+        trackDirection(ocv);
+        bool charging = onCharger || loadMa < 0.0f;
+
+        // Coulomb counting prediction; the charger's current is unknown
+        float predicted = soc;
+        if (!onCharger) {
+            float usedMah = loadMa * elapsedMs / 3600000.0f;
+            predicted -= usedMah * 100.0f / config.capacityMah;
+        }
+
+        // Voltage correction, weighted by how informative the voltage is
+        float gain = config.voltageGain * curveSteepness(voltageSoc);
+        if (!onCharger && loadMa > config.heavyLoadMa) {
+            gain *= config.heavyLoadMa / loadMa;
+        }
+        soc = predicted + gain * (voltageSoc - predicted);
+        if (soc < 0.0f) soc = 0.0f;
+        if (soc > 100.0f) soc = 100.0f;
+
+        // Whole-percent output with direction-aware hysteresis
+        int rounded = (int)(soc + 0.5f);
+        if ((charging && rounded > reported) || (!charging && rounded < reported)) {
+            reported = rounded;
+        }
+    }
+
+    int getPercent() const { return reported; }
+    float getSoc() const { return soc; }
+    bool isInitialized() const { return initialized; }
+    bool isCharging() const { return onCharger; }
+
+private:
+    static const float OCV_CURVE[CURVE_POINTS];
+
+    BatteryModelConfig config;
+    float soc = 0.0f;
+    int reported = 0;
+    bool initialized = false;
+    bool onCharger = false;
+    float trendOcv = 0.0f;          // Smoothed OCV
+    float turnOcv = 0.0f;           // Its lowest point while discharging, highest while charging
+
+    // Follows the smoothed OCV's last turning point; a swing of chargeRiseMv
+    // back from it flips the direction
+    void trackDirection(float ocv) {
+        trendOcv += config.ocvSmoothing * (ocv - trendOcv);
+        if (onCharger ? trendOcv > turnOcv : trendOcv < turnOcv) {
+            turnOcv = trendOcv;
+        } else if (fabsf(trendOcv - turnOcv) >= config.chargeRiseMv) {
+            onCharger = !onCharger;
+            turnOcv = trendOcv;
+        }
+    }
+
+    // Relative slope of the curve around a SoC: 1.0 at the steepest segment,
+    // smaller on the plateau
+    static float curveSteepness(float percent) {
+        uint8_t i = percent >= 100.0f ? CURVE_POINTS - 2 : (uint8_t)(percent / 5.0f);
+        float slope = OCV_CURVE[i + 1] - OCV_CURVE[i];
+        float steepest = 0.0f;
+        for (uint8_t j = 1; j < CURVE_POINTS; j++) {
+            float s = OCV_CURVE[j] - OCV_CURVE[j - 1];
+            if (s > steepest) steepest = s;
+        }
+        float ratio = slope / steepest;
+        return ratio < 0.1f ? 0.1f : ratio;
+    }
+};
+
+// Empty at 3.3 V to match battery_test.cpp; full at 4.2 V
+const float BatteryModel::OCV_CURVE[BatteryModel::CURVE_POINTS] = {
+    3300, 3610, 3690, 3710, 3730, 3750, 3770, 3790, 3800, 3820,
+    3840, 3850, 3870, 3910, 3950, 3980, 4020, 4080, 4110, 4150, 4200
+};
+
+#endif
@@ -1,19 +1,11 @@
 #include <Arduino.h>
-#include <Wire.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
-#include "../config/pinmap.h"
+#include "../config/board_profile.h"
+#include "../drivers/ssd1306_panel.cpp"
 #include "../utils/logger.cpp"
 
-// OLED display settings
-#define SCREEN_WIDTH 128
-#define SCREEN_HEIGHT 64
-#define OLED_RESET -1       // No reset pin
-#define OLED_ADDR 0x3C      // Common I2C address for SSD1306
-
 class DisplayModule {
 private:
-    Adafruit_SSD1306* display;
+    Ssd1306Panel* display;
     bool initialized;
     
 public:
@@ -38,17 +30,11 @@ public:
         }
         
         // Create display instance
-        display = new Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-        
-        // Initialize the I2C bus first
-        Wire.begin(OLED_SDA, OLED_SCL);
-        
-        Logger::debug("Display", "Starting display on I2C with SDA: " + 
-                     String(OLED_SDA) + ", SCL: " + String(OLED_SCL));
+        display = new Ssd1306Panel(Board::Display::WIDTH, Board::Display::HEIGHT, Board::Display::ADDRESS);
         
-        // Initialize the display
-        if (!display->begin(SSD1306_SWITCHCAPVCC, OLED_ADDR)) {
-            Logger::error("Display", "SSD1306 allocation failed");
+        // Starts the shared I2C bus on first use
+        if (!display->begin()) {
+            Logger::error("Display", "SSD1306 not responding");
             return false;
         }
         
@@ -0,0 +1,166 @@
+#ifndef LINK_ESTIMATOR_H
+#define LINK_ESTIMATOR_H
+
+#include <stdint.h>
+#include "../dsp/audio_codec.cpp"
+
+// Link-quality estimate for the audio upload and the plan derived from it.
+// Plain C++ (no Arduino calls) so link traces can be replayed on a PC.
+//
+// Inputs:
+//   - RSSI, sampled by NetworkModule::maintain()
+//   - upload transfers whose reply is only an acknowledgement: payload bytes
+//     and the time from sending the request to the reply
+// The round-trip time is smoothed as in TCP (RFC 6298); each transfer is
+// split into that round trip plus payload time, which gives a goodput
+// sample. Before any transfer, and whenever the RSSI is weak, an RSSI-based
+// rate caps the goodput.
+//
+// The plan is the best format (16 kHz PCM, 16 kHz ADPCM, 8 kHz ADPCM) whose
+// upload keeps up with capture with headroom: per chunk, payload time plus
+// one round trip must fit in the chunk's duration. Shorter chunks shorten
+// the tail after the user stops talking but pay the round trip more often,
+// so the shortest chunk that keeps up wins. When nothing keeps up, the
+// leanest format with the longest chunk is used. Switching to a richer format
+// takes extra headroom, so the plan does not flap around a boundary.
+struct LinkEstimatorConfig {
+    float rttGain = 0.125f;             // RFC 6298 alpha
+    float rttVarGain = 0.25f;           // RFC 6298 beta
+    float goodputGain = 0.25f;
+    uint32_t initialRttMs = 100;
+    float headroom = 0.7f;              // Share of a chunk's duration the upload may take
+    float upgradeHeadroom = 0.5f;       // Tighter share before moving to a richer format
+    int8_t weakRssi = -72;              // Below: cap goodput by the RSSI rate
+};
+
+struct LinkPlan {
+    AudioFormat format;
+    uint16_t chunkMs = 1000;
+
+    uint32_t chunkBytes() const {
+        return (uint32_t)((uint64_t)format.bitsPerSecond() * chunkMs / 8000);
+    }
+};
+
+class LinkEstimator {
+public:
+    static const uint8_t FORMAT_COUNT = 3;
+    static const uint8_t CHUNK_COUNT = 3;
+    // At the default headroom the longest chunk uploads within 700 ms. A
+    // slower upload only delays the reply: the listener's speech stream holds
+    // a whole recording
+    static constexpr uint16_t CHUNK_MS[CHUNK_COUNT] = { 250, 500, 1000 };
+
+    explicit LinkEstimator(const LinkEstimatorConfig& config = LinkEstimatorConfig())
+        : config(config) {
+        reset();
+    }
+
+    void reset() {
+        srttMs = config.initialRttMs;
+        rttVarMs = config.initialRttMs / 2.0f;
+        goodputBps = 0;
+        rssi = 0;
+        samples = 0;
+        level = 0;
+    }
+
+    void onRssi(int8_t dbm) {
+        rssi = dbm;
+    }
+
+    // One acknowledged upload of bytes that took elapsedMs from send to reply
+    void onTransfer(uint32_t bytes, uint32_t elapsedMs) {
+        if (elapsedMs == 0) elapsedMs = 1;
+        float payloadMs = goodputBps > 0 ? bytes * 8000.0f / goodputBps : elapsedMs / 2.0f;
+        // Round trip: what the payload does not explain, never below a quarter
+        float rttSample = elapsedMs - payloadMs;
+        if (rttSample < elapsedMs / 4.0f) rttSample = elapsedMs / 4.0f;
+        if (samples == 0) {
+            srttMs = rttSample;
+            rttVarMs = rttSample / 2.0f;
+        } else {
+            float error = rttSample - srttMs;
+            rttVarMs += config.rttVarGain * ((error < 0 ? -error : error) - rttVarMs);
+            srttMs += config.rttGain * error;
+        }
+
+        float transferMs = elapsedMs - srttMs;
+        if (transferMs < elapsedMs / 4.0f) transferMs = elapsedMs / 4.0f;
+        float sample = bytes * 8000.0f / transferMs;
+        goodputBps = samples == 0 ? sample : goodputBps + config.goodputGain * (sample - goodputBps);
+        samples++;
+    }
+
+    // Measured goodput, capped by what the RSSI suggests on a weak or unmeasured link
+    uint32_t getGoodputBps() const {
+        uint32_t cap = rssiRateBps(rssi);
+        if (samples == 0) return cap;
+        if (rssi != 0 && rssi < config.weakRssi && cap < goodputBps) return cap;
+        return (uint32_t)goodputBps;
+    }
+
+    uint32_t getRttMs() const { return (uint32_t)(srttMs + 0.5f); }
+    uint32_t getRttVarMs() const { return (uint32_t)(rttVarMs + 0.5f); }
+    uint32_t getSamples() const { return samples; }
+
+    LinkPlan plan() {
+        float goodput = (float)getGoodputBps();
+        // Round trips vary; plan for one deviation above the mean
+        float rttMs = srttMs + rttVarMs;
+        uint8_t chosen = FORMAT_COUNT - 1;
+        uint16_t chunkMs = CHUNK_MS[CHUNK_COUNT - 1];
+        for (uint8_t f = 0; f < FORMAT_COUNT; f++) {
+            float share = f < level ? config.upgradeHeadroom : config.headroom;
+            uint16_t fits = shortestChunk(FORMATS[f], goodput, rttMs, share);
+            if (fits) {
+                chosen = f;
+                chunkMs = fits;
+                break;
+            }
+        }
+        level = chosen;
+
+        LinkPlan result;
+        result.format = FORMATS[chosen];
+        result.chunkMs = chunkMs;
+        return result;
+    }
+
+    // Typical uplink goodput of an ESP32 station at this signal strength
+    static uint32_t rssiRateBps(int8_t dbm) {
+        if (dbm == 0 || dbm >= -60) return 4000000;
+        if (dbm >= -67) return 2000000;
+        if (dbm >= -72) return 1000000;
+        if (dbm >= -77) return 400000;
+        if (dbm >= -82) return 150000;
+        return 60000;
+    }
+
+private:
+    static constexpr AudioFormat FORMATS[FORMAT_COUNT] = {
+        { 16000, CODEC_PCM16 },
+        { 16000, CODEC_IMA_ADPCM },
+        { 8000, CODEC_IMA_ADPCM }
+    };
+
+    LinkEstimatorConfig config;
+    float srttMs = 0;
+    float rttVarMs = 0;
+    float goodputBps = 0;
+    int8_t rssi = 0;
+    uint32_t samples = 0;
+    uint8_t level = 0;              // Index of the last planned format
+
+    static uint16_t shortestChunk(const AudioFormat& format, float goodput, float rttMs, float share) {
+        for (uint8_t c = 0; c < CHUNK_COUNT; c++) {
+            float payloadMs = format.bitsPerSecond() * (float)CHUNK_MS[c] / goodput;
+            if (payloadMs + rttMs <= share * CHUNK_MS[c]) {
+                return CHUNK_MS[c];
+            }
+        }
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,478 @@
+#ifndef MUX_CLIENT_H
+#define MUX_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "../utils/stream_mux.cpp"
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+#include "tls_transport.cpp"
+
+// The glasses' one connection to the server: GET /mux, upgraded to
+// StreamMux framing (utils/stream_mux.cpp), carries every request as a
+// stream. A request no longer pays a TCP connect, and while requests
+// overlap a command or a cancel goes ahead of a camera frame or an audio
+// chunk that is already on its way.
+//
+// There is no task of its own. Whoever waits for a reply pumps the
+// connection under the lock, one frame into the socket per turn, so
+// requests from several tasks move together and none holds the lock for
+// longer than a frame takes; service() pumps between requests. What lwIP
+// has already taken (TCP_SND_BUF, 5.7 KB) cannot be overtaken any more:
+// about 46 ms at 1 Mbit/s, on top of the frame in progress.
+//
+// An https:// server gets the connection over TLS (tls_transport.cpp), so the
+// handshake is paid once per connection rather than once per request, and a
+// reconnect resumes the session.
+//
+// A server without /mux answers the upgrade with 404; the caller retries
+// later and sends over HTTP meanwhile (MuxHttp).
+struct MuxReply {
+    int code = 0;               // HTTP status, or an HTTPC_ERROR_* code
+    String head;                // Status line and headers as the server sent them
+    String body;
+
+    String header(const char* name) const {
+        String lower = String("\r\n") + name + ":";
+        lower.toLowerCase();
+        String text = head;
+        text.toLowerCase();
+        int at = text.indexOf(lower);
+        if (at < 0) {
+            return String();
+        }
+        int start = at + lower.length();
+        int end = head.indexOf("\r\n", start);
+        String value = head.substring(start, end < 0 ? head.length() : end);
+        value.trim();
+        return value;
+    }
+};
+
+class MuxClient {
+public:
+    MuxClient() : lock(xSemaphoreCreateMutex()) {
+        mux.setCallback(onEvent, this);
+    }
+
+    // Opens the connection and upgrades it; false when the server does not
+    // speak the protocol or cannot be reached within timeoutMs
+    bool connect(const String& serverUrl, uint32_t timeoutMs = CONNECT_TIMEOUT_MS) {
+        String host;
+        uint16_t port;
+        bool secure;
+        if (!parseUrl(serverUrl, host, port, secure)) {
+            return false;
+        }
+        xSemaphoreTake(lock, portMAX_DELAY);
+        closeLocked();
+        client.setSecure(secure);
+        bool upgraded = client.connect(host.c_str(), port, timeoutMs) && upgrade(host, port, timeoutMs);
+        if (upgraded) {
+            mux.reset();
+            outboxFill = 0;
+            outboxSent = 0;
+            connected = true;
+            pingOutstanding = false;
+            lastReceiveMs = millis();
+            Logger::info("MUX", "Connected to " + host + ":" + String(port));
+        } else {
+            client.stop();
+        }
+        xSemaphoreGive(lock);
+        return upgraded;
+    }
+
+    bool isConnected() const {
+        return connected && !mux.isGoingAway();
+    }
+
+    void close() {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        closeLocked();
+        xSemaphoreGive(lock);
+    }
+
+    // Between requests: answers pings and credits, checks an idle
+    // connection is still there, and lets it go after the server's GOAWAY
+    void service() {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (connected) {
+            pump();
+        }
+        if (connected && mux.isGoingAway() && mux.activeStreams() == 0) {
+            closeLocked();
+        }
+        if (connected && pingOutstanding && millis() - pingSentMs >= PING_TIMEOUT_MS) {
+            Logger::warning("MUX", "No answer to ping, closing");
+            closeLocked();
+        }
+        if (connected && !pingOutstanding && millis() - lastReceiveMs >= PING_IDLE_MS) {
+            mux.ping(++pingToken);
+            pingOutstanding = true;
+            pingSentMs = millis();
+        }
+        xSemaphoreGive(lock);
+    }
+
+    // One request on its own stream: head is the request line and headers
+    // ("POST /audio\r\nName: value\r\n"), the body comes from data or, when
+    // given, stream. Waits for the whole reply. A request the connection
+    // makes no progress on for timeoutMs is reset, so the server drops it
+    // too. HTTPC_ERROR_NOT_CONNECTED means nothing was sent.
+    int request(MuxPriority priority, const String& head, const uint8_t* data, size_t length,
+                Stream* stream, MuxReply& reply, uint32_t timeoutMs) {
+        Exchange exchange;
+        exchange.reply = &reply;
+        reply = MuxReply();
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        unsigned long waitStartMs = millis();
+        int32_t id = -1;
+        while (isConnected() && (id = mux.open(priority, head.c_str(), head.length())) < 0) {
+            if (mux.activeStreams() < StreamMux::MAX_STREAMS) {
+                // Stream ids used up: a new connection starts them again
+                mux.goAway();
+                break;
+            }
+            if (millis() - waitStartMs >= timeoutMs) {
+                break;
+            }
+            // Every slot busy: wait for one while moving the others along
+            pump();
+            xSemaphoreGive(lock);
+            delay(1);
+            xSemaphoreTake(lock, portMAX_DELAY);
+        }
+        if (id < 0) {
+            xSemaphoreGive(lock);
+            return HTTPC_ERROR_NOT_CONNECTED;
+        }
+        exchange.stream = id;
+        track(&exchange);
+        Metrics::inc(MUX_STREAMS);
+
+        size_t sent = 0;
+        bool ended = false;
+        unsigned long progressMs = millis();
+        while (true) {
+            // Body into the stream as its buffer makes room
+            while (!ended && !exchange.done) {
+                size_t room = mux.writable(id);
+                size_t n = length - sent < room ? length - sent : room;
+                if (n > sizeof(chunk)) n = sizeof(chunk);
+                if (n == 0 && sent < length) break;
+                const uint8_t* piece = chunk;
+                if (stream != nullptr) {
+                    if (stream->readBytes((char*)chunk, n) != n) {
+                        mux.reset(id);
+                        exchange.code = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+                        exchange.done = true;
+                        break;
+                    }
+                } else if (n > 0) {
+                    piece = data + sent;
+                }
+                sent += n;
+                ended = sent == length;
+                mux.write(id, piece, n, ended);
+            }
+            if (connected && !exchange.done && pump()) {
+                progressMs = millis();
+            }
+            if (!connected && !exchange.done) {
+                exchange.code = HTTPC_ERROR_CONNECTION_LOST;
+                exchange.done = true;
+            }
+            if (!exchange.done && millis() - progressMs >= timeoutMs) {
+                mux.reset(id, MUX_CANCEL);
+                Metrics::inc(MUX_CANCELS);
+                exchange.code = HTTPC_ERROR_READ_TIMEOUT;
+                exchange.done = true;
+            }
+            if (exchange.done) {
+                break;
+            }
+            xSemaphoreGive(lock);
+            delay(1);
+            xSemaphoreTake(lock, portMAX_DELAY);
+        }
+        if (mux.isOpen(id)) {
+            mux.reset(id, MUX_CANCEL);      // Answered before the body was all sent
+        }
+        untrack(&exchange);
+        xSemaphoreGive(lock);
+        reply.code = exchange.code;
+        return exchange.code;
+    }
+
+private:
+    static const uint32_t CONNECT_TIMEOUT_MS = 3000;
+    static const uint32_t PING_IDLE_MS = 60000;     // The minutely metrics push usually comes first
+    static const uint32_t PING_TIMEOUT_MS = 10000;
+    static const size_t TURN_BYTES = MUX_HEADER_BYTES + 1024 + 64;   // A full DATA frame and some control frames
+
+    // A request waiting for its reply
+    struct Exchange {
+        int32_t stream = -1;
+        MuxReply* reply = nullptr;
+        int code = HTTPC_ERROR_CONNECTION_LOST;
+        bool done = false;
+    };
+
+    SemaphoreHandle_t lock;
+    StreamMux mux;
+    TlsTransport client;
+    bool connected = false;
+    Exchange* exchanges[StreamMux::MAX_STREAMS] = {};
+    uint8_t outbox[MUX_HEADER_BYTES + MUX_MAX_PAYLOAD];
+    size_t outboxFill = 0;
+    size_t outboxSent = 0;
+    uint8_t inbox[1460];
+    uint8_t chunk[1024];
+    unsigned long lastReceiveMs = 0;
+    bool pingOutstanding = false;
+    unsigned long pingSentMs = 0;
+    uint32_t pingToken = 0;
+
+    static bool parseUrl(const String& url, String& host, uint16_t& port, bool& secure) {
+        secure = url.startsWith("https://");
+        int start = url.indexOf("://");
+        start = start < 0 ? 0 : start + 3;
+        int end = url.indexOf('/', start);
+        String authority = url.substring(start, end < 0 ? url.length() : end);
+        int colon = authority.lastIndexOf(':');
+        host = colon < 0 ? authority : authority.substring(0, colon);
+        port = colon < 0 ? (secure ? 443 : 80) : authority.substring(colon + 1).toInt();
+        return host.length() > 0 && port > 0;
+    }
+
+    bool upgrade(const String& host, uint16_t port, uint32_t timeoutMs) {
+        client.setNoDelay(true);
+        String request = "GET /mux HTTP/1.1\r\nHost: " + host + ":" + String(port) +
+                         "\r\nConnection: Upgrade\r\nUpgrade: glasses-mux/1\r\nX-Device-Id: " +
+                         WiFi.macAddress() + "\r\n\r\n";
+        unsigned long startMs = millis();
+        size_t written = 0;
+        while (written < request.length() && millis() - startMs < timeoutMs) {
+            size_t n = client.write((const uint8_t*)request.c_str() + written, request.length() - written);
+            written += n;
+            if (n == 0) delay(1);
+        }
+        // Byte by byte up to the blank line: what follows is already frames
+        String head;
+        while (!head.endsWith("\r\n\r\n")) {
+            if (millis() - startMs >= timeoutMs || !client.connected() || head.length() > 1024) {
+                return false;
+            }
+            if (client.available() > 0) {
+                head += (char)client.read();
+            } else {
+                delay(1);
+            }
+        }
+        if (!head.startsWith("HTTP/1.1 101")) {
+            Logger::info("MUX", "Server has no /mux, staying on HTTP");
+            return false;
+        }
+        return true;
+    }
+
+    void closeLocked() {
+        if (connected) {
+            client.stop();
+            connected = false;
+        }
+        for (Exchange* exchange : exchanges) {
+            if (exchange != nullptr && !exchange->done) {
+                exchange->code = HTTPC_ERROR_CONNECTION_LOST;
+                exchange->done = true;
+            }
+        }
+    }
+
+    // One turn: a frame's worth of output as far as the socket takes it,
+    // then whatever has arrived. True if any bytes moved.
+    bool pump() {
+        bool moved = false;
+        if (outboxSent == outboxFill) {
+            outboxFill = mux.poll(outbox, TURN_BYTES);
+            outboxSent = 0;
+        }
+        if (outboxSent < outboxFill) {
+            size_t n = client.write(outbox + outboxSent, outboxFill - outboxSent);
+            outboxSent += n;
+            moved = n > 0;
+        }
+        int available;
+        while (connected && (available = client.available()) > 0) {
+            int n = client.read(inbox, available < (int)sizeof(inbox) ? available : sizeof(inbox));
+            if (n <= 0) break;
+            moved = true;
+            lastReceiveMs = millis();
+            if (!mux.receive(inbox, n)) {
+                Logger::error("MUX", "Protocol error from the server");
+                size_t goaway = mux.poll(outbox, sizeof(outbox));
+                client.write(outbox, goaway);
+                closeLocked();
+            }
+        }
+        if (connected && !client.connected()) {
+            Logger::warning("MUX", "Connection closed by the server");
+            closeLocked();
+        }
+        return moved;
+    }
+
+    void track(Exchange* exchange) {
+        for (Exchange*& slot : exchanges) {
+            if (slot == nullptr) {
+                slot = exchange;
+                return;
+            }
+        }
+    }
+
+    void untrack(Exchange* exchange) {
+        for (Exchange*& slot : exchanges) {
+            if (slot == exchange) slot = nullptr;
+        }
+    }
+
+    Exchange* exchangeFor(uint16_t stream) {
+        for (Exchange* exchange : exchanges) {
+            if (exchange != nullptr && exchange->stream == stream) return exchange;
+        }
+        return nullptr;
+    }
+
+    static void onEvent(const MuxEvent& event, void* context) {
+        MuxClient* self = (MuxClient*)context;
+        if (event.type == MUX_PONG) {
+            self->pingOutstanding = false;
+            return;
+        }
+        Exchange* exchange = self->exchangeFor(event.stream);
+        if (exchange == nullptr || exchange->done) {
+            return;
+        }
+        MuxReply& reply = *exchange->reply;
+        switch (event.type) {
+            case MUX_HEADERS:
+                reply.head = String((const char*)event.data, event.length);
+                exchange->code = reply.head.toInt();
+                break;
+            case MUX_DATA:
+                reply.body.concat((const char*)event.data, event.length);
+                break;
+            case MUX_RESET:
+                // Refused streams were never processed; anything else ended midway
+                exchange->code = event.value == MUX_REFUSED ? HTTPC_ERROR_CONNECTION_REFUSED : HTTPC_ERROR_CONNECTION_LOST;
+                exchange->done = true;
+                return;
+            default:
+                return;
+        }
+        if (event.end) {
+            exchange->done = true;
+        }
+    }
+};
+
+// HTTPClient's calls as NetworkModule makes them. While the connection is
+// up a request goes on it as a stream of the given priority; otherwise, or
+// when the connection turns out to be gone before anything was sent, it
+// goes through HTTPClient as before, over its own TLS connection for an
+// https:// URL (a full handshake each time). HTTPClient gets every call
+// either way: it does nothing on the network until a request is made.
+class MuxHttp {
+public:
+    MuxHttp(MuxClient& mux, MuxPriority priority) : mux(mux), priority(priority) {}
+
+    bool begin(const String& url) {
+        int start = url.indexOf("://");
+        int path = url.indexOf('/', start < 0 ? 0 : start + 3);
+        target = path < 0 ? String("/") : url.substring(path);
+        headers = "";
+        viaMux = false;
+        if (url.startsWith("https://")) {
+            TlsCredentials::get().apply(secure);
+            return http.begin(secure, url);
+        }
+        return http.begin(url);
+    }
+
+    void addHeader(const String& name, const String& value) {
+        headers += name + ": " + value + "\r\n";
+        http.addHeader(name, value);
+    }
+
+    void collectHeaders(const char* keys[], size_t count) {
+        http.collectHeaders(keys, count);
+    }
+
+    void setTimeout(uint16_t ms) {
+        timeoutMs = ms;
+        http.setTimeout(ms);
+    }
+
+    int GET() {
+        int code = send("GET", nullptr, 0, nullptr);
+        return viaMux ? code : http.GET();
+    }
+
+    int POST(const String& payload) {
+        int code = send("POST", (const uint8_t*)payload.c_str(), payload.length(), nullptr);
+        return viaMux ? code : http.POST(payload);
+    }
+
+    int POST(uint8_t* payload, size_t size) {
+        int code = send("POST", payload, size, nullptr);
+        return viaMux ? code : http.POST(payload, size);
+    }
+
+    int sendRequest(const char* method, Stream* stream, size_t size) {
+        int code = send(method, nullptr, size, stream);
+        return viaMux ? code : http.sendRequest(method, stream, size);
+    }
+
+    String getString() {
+        return viaMux ? reply.body : http.getString();
+    }
+
+    String header(const char* name) {
+        return viaMux ? reply.header(name) : http.header(name);
+    }
+
+    void end() {
+        http.end();
+    }
+
+private:
+    MuxClient& mux;
+    MuxPriority priority;
+    WiFiClientSecure secure;
+    HTTPClient http;
+    bool viaMux = false;
+    String target;
+    String headers;
+    MuxReply reply;
+    uint32_t timeoutMs = 5000;      // HTTPClient's default
+
+    int send(const char* method, const uint8_t* data, size_t length, Stream* stream) {
+        if (!mux.isConnected()) {
+            viaMux = false;
+            return HTTPC_ERROR_NOT_CONNECTED;
+        }
+        String head = String(method) + " " + target + "\r\n" + headers;
+        int code = mux.request(priority, head, data, length, stream, reply, timeoutMs);
+        viaMux = code != HTTPC_ERROR_NOT_CONNECTED;
+        return code;
+    }
+};
+
+#endif
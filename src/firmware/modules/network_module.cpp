@@ -4,61 +4,145 @@
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include <esp_partition.h>
+#include "../config/config.h"
+#include "../utils/trace.cpp"
+#include "../utils/metrics.cpp"
+#include "../utils/response_cache.cpp"
+#include "../utils/multipart_stream.cpp"
+#include "power_manager.cpp"
+#include "radio_scheduler.cpp"
+#include "link_estimator.cpp"
+#include "mux_client.cpp"
 
 class NetworkModule {
 public:
     bool connect(const char* ssid, const char* password) {
-        WiFi.begin(ssid, password);
-        
-        int attempts = 0;
-        while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-            delay(500);
-            attempts++;
+        begin(ssid, password);
+        while (isConnecting()) {
+            delay(CONNECT_POLL_MS);
         }
-        
         return WiFi.status() == WL_CONNECTED;
     }
     
+    // Starts associating and returns; isConnecting() stays true until the
+    // link is up or WIFI_CONNECT_TIMEOUT has passed
+    void begin(const char* ssid, const char* password) {
+        WiFi.begin(ssid, password);
+        RadioScheduler::begin();
+        connecting = true;
+        connectStartMs = millis();
+    }
+    
+    bool isConnecting() {
+        if (connecting && (WiFi.status() == WL_CONNECTED || millis() - connectStartMs >= WIFI_CONNECT_TIMEOUT)) {
+            connecting = false;
+        }
+        return connecting;
+    }
+    
     void maintain() {
+        if (isConnecting()) {
+            return;
+        }
         if (WiFi.status() != WL_CONNECTED) {
-            reconnectAttempts++;
-            if (reconnectAttempts >= MAX_RECONNECT_ATTEMPTS) {
-                ESP.restart();
+            unsigned long now = millis();
+            if (!wasDisconnected) {
+                mux.close();
+                wasDisconnected = true;
+                reconnectAttemptMs = now;
+            }
+            // The core rejoins by itself; every interval still without the
+            // link counts as a failed attempt and asks again
+            if (now - reconnectAttemptMs >= WIFI_RECONNECT_INTERVAL) {
+                reconnectAttemptMs = now;
+                reconnectAttempts++;
+                if (reconnectAttempts >= MAX_RECONNECT_ATTEMPTS) {
+                    ESP.restart();
+                    return;
+                }
+                WiFi.reconnect();
             }
         } else {
+            if (wasDisconnected) {
+                Metrics::inc(NET_RECONNECTS);
+                wasDisconnected = false;
+            }
             reconnectAttempts = 0;
+            int8_t rssi = WiFi.RSSI();
+            Metrics::set(WIFI_RSSI, rssi);
+            link.onRssi(rssi);
+            serviceMux();
         }
     }
     
+    // Repeated questions are answered from the response cache. Only text
+    // the server transcribed is looked up or kept (never the placeholder
+    // texts), and only once the server's Date has set the clock.
     String sendCommand(const String &command) {
+        commandSucceeded = false;
+        bool cacheable = clockKnown && command.length() > 0 && command == transcript;
+        transcript = "";
+        uint64_t key = cacheable ? cacheKey(command.c_str(), command.length()) : 0;
+        if (cacheable) {
+            char cached[ResponseCache<>::MAX_TEXT + 1];
+            CacheTier tier = cache.lookup(key, now(), cached, sizeof(cached));
+            if (tier != CACHE_MISS) {
+                Metrics::inc(tier == CACHE_RAM ? CACHE_HITS_RAM : CACHE_HITS_FLASH);
+                commandSucceeded = true;
+                return String(cached);
+            }
+            Metrics::inc(CACHE_MISSES);
+        }
         if (WiFi.status() != WL_CONNECTED) {
             return "Network Error";
         }
         
-        HTTPClient http;
+        PmLockGuard pmLock(PM_WORK_NETWORK);
+        RadioAwakeGuard radioAwake;
+        MuxHttp http(mux, MUX_INTERACTIVE);
         
         // Create JSON payload
-        StaticJsonDocument<200> doc;
-        doc["command"] = command;
         String jsonString;
-        serializeJson(doc, jsonString);
+        {
+            TRACE_SPAN(TRACE_ENCODE);
+            StaticJsonDocument<200> doc;
+            doc["command"] = command;
+            serializeJson(doc, jsonString);
+        }
         
         // Send POST request
         http.begin(serverUrl);
         http.addHeader("Content-Type", "application/json");
+        http.collectHeaders(CACHE_HEADERS, CACHE_HEADER_COUNT);
         
-        int httpResponseCode = http.POST(jsonString);
+        int httpResponseCode;
         String response = "Error";
+        unsigned long startTime = millis();
+        {
+            TRACE_SPAN(TRACE_SERVER_WAIT);
+            httpResponseCode = http.POST(jsonString);
+            if (httpResponseCode > 0) {
+                response = http.getString();
+            }
+        }
+        recordRequest(startTime, jsonString.length(), httpResponseCode == 200);
         
         if (httpResponseCode > 0) {
-            response = http.getString();
-            
+            takeCacheHeaders(http);
             // Parse JSON response
             StaticJsonDocument<200> responseDoc;
             DeserializationError error = deserializeJson(responseDoc, response);
             
             if (!error) {
                 response = responseDoc["response"].as<String>();
+                commandSucceeded = httpResponseCode == 200;
+            }
+        }
+        if (cacheable && commandSucceeded) {
+            CacheHint hint = parseCacheControl(http.header("Cache-Control").c_str(), CACHE_DEFAULT_TTL_S, CACHE_MAX_TTL_S);
+            if (hint.store) {
+                cache.store(key, response.c_str(), response.length(), now() + hint.ttlS, now());
             }
         }
         
@@ -66,16 +150,164 @@ public:
         return response;
     }
     
+    // Whether the last sendCommand() got an answer rather than an error text
+    bool lastCommandSucceeded() const {
+        return commandSucceeded;
+    }
+    
+    // One-shot upload of 16 kHz PCM
     bool sendAudio(const uint8_t* audioData, size_t length) {
+        return sendAudioChunk(audioData, length, AudioFormat(), 0, true);
+    }
+    
+    // One chunk of a recording; seq 0 starts a new one. The server only
+    // acknowledges chunks before the final one, so their timing feeds the
+    // link estimate; its answer to the final one may carry the transcript.
+    bool sendAudioChunk(const uint8_t* audioData, size_t length, const AudioFormat& format, uint16_t seq, bool final) {
         if (WiFi.status() != WL_CONNECTED) {
             return false;
         }
+        if (seq == 0) {
+            audioSession++;
+        }
         
-        HTTPClient http;
+        PmLockGuard pmLock(PM_WORK_NETWORK);
+        RadioAwakeGuard radioAwake;
+        MuxHttp http(mux, MUX_BULK);
         http.begin(serverUrl + "/audio");
         http.addHeader("Content-Type", "application/octet-stream");
+        http.addHeader("X-Audio-Session", String(audioSession));
+        http.addHeader("X-Audio-Seq", String(seq));
+        http.addHeader("X-Audio-Final", final ? "1" : "0");
+        http.addHeader("X-Audio-Rate", String(format.sampleRate));
+        http.addHeader("X-Audio-Codec", format.codecName());
+        http.collectHeaders(CACHE_HEADERS, CACHE_HEADER_COUNT);
+        
+        int httpResponseCode;
+        unsigned long startTime = millis();
+        {
+            TRACE_SPAN(TRACE_UPLOAD);
+            httpResponseCode = http.POST(const_cast<uint8_t*>(audioData), length);
+        }
+        recordRequest(startTime, length, httpResponseCode == 200);
+        if (seq == 0) {
+            transcript = "";
+        }
+        if (httpResponseCode > 0) {
+            takeCacheHeaders(http);
+        }
+        if (httpResponseCode == 200 && final) {
+            StaticJsonDocument<256> doc;
+            if (!deserializeJson(doc, http.getString())) {
+                transcript = doc["transcript"] | "";
+            }
+        }
+        http.end();
+        
+        if (httpResponseCode == 200 && !final) {
+            link.onTransfer(length, millis() - startTime);
+            Metrics::set(NET_GOODPUT_KBPS, link.getGoodputBps() / 1000);
+            Metrics::set(NET_RTT_MS, link.getRttMs());
+        }
+        return httpResponseCode == 200;
+    }
+    
+    // Posts a JPEG to a vision endpoint (/vision/describe, /vision/process)
+    // as the image_file form field, read from where it lies. region says
+    // which part of the frame a crop shows, "x,y,w,h/WxH"; empty for a whole
+    // frame. Returns the reply body, empty on failure.
+    String sendImage(const char* path, const uint8_t* jpeg, size_t length, const String& region) {
+        if (WiFi.status() != WL_CONNECTED) {
+            return String();
+        }
+        
+        PmLockGuard pmLock(PM_WORK_NETWORK);
+        RadioAwakeGuard radioAwake;
+        MuxHttp http(mux, MUX_BULK);
+        MultipartStream body("image_file", "frame.jpg", "image/jpeg", jpeg, length);
+        http.begin(serverUrl + path);
+        http.addHeader("Content-Type", body.contentType());
+        if (region.length() > 0) {
+            http.addHeader("X-Vision-Region", region);
+        }
+        http.collectHeaders(CACHE_HEADERS, CACHE_HEADER_COUNT);
+        
+        int httpResponseCode;
+        unsigned long startTime = millis();
+        {
+            TRACE_SPAN(TRACE_CAM_UPLOAD);
+            httpResponseCode = http.sendRequest("POST", &body, body.size());
+        }
+        recordRequest(startTime, body.size(), httpResponseCode == 200);
+        String reply;
+        if (httpResponseCode > 0) {
+            takeCacheHeaders(http);
+        }
+        if (httpResponseCode == 200) {
+            reply = http.getString();
+        }
+        http.end();
+        return reply;
+    }
+    
+    // Upload format and chunk length for the next recording
+    LinkPlan getLinkPlan() {
+        LinkPlan plan = link.plan();
+        Metrics::set(AUDIO_UPLOAD_KBPS, plan.format.bitsPerSecond() / 1000);
+        return plan;
+    }
+    
+    const LinkEstimator& getLinkEstimator() const {
+        return link;
+    }
+    
+    // What the server heard in the last recording; empty if it did not say
+    const String& getTranscript() const {
+        return transcript;
+    }
+    
+    // Adds the "rcache" partition as the response cache's flash tier, so
+    // answers outlive RAM evictions and restarts; without it the cache is
+    // RAM-only
+    bool beginCache() {
+        const esp_partition_t* partition = esp_partition_find_first(
+            ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)CACHE_PARTITION_SUBTYPE, "rcache");
+        if (partition == nullptr) {
+            return false;
+        }
+        CacheFlash flash;
+        flash.read = [](void* context, uint32_t offset, void* data, size_t length) {
+            return esp_partition_read((const esp_partition_t*)context, offset, data, length) == ESP_OK;
+        };
+        flash.write = [](void* context, uint32_t offset, const void* data, size_t length) {
+            return esp_partition_write((const esp_partition_t*)context, offset, data, length) == ESP_OK;
+        };
+        flash.erase = [](void* context, uint32_t offset, size_t length) {
+            return esp_partition_erase_range((const esp_partition_t*)context, offset, length) == ESP_OK;
+        };
+        flash.context = (void*)partition;
+        flash.size = partition->size;
+        return cache.attach(flash);
+    }
+    
+    // Push the Prometheus text form of the metrics registry to the server
+    bool postMetrics() {
+        if (WiFi.status() != WL_CONNECTED) {
+            return false;
+        }
         
-        int httpResponseCode = http.POST(audioData, length);
+        PmLockGuard pmLock(PM_WORK_NETWORK);
+        RadioAwakeGuard radioAwake;
+        MuxHttp http(mux, MUX_BACKGROUND);
+        http.begin(serverUrl + "/telemetry/metrics");
+        http.addHeader("Content-Type", "text/plain; version=0.0.4");
+        http.addHeader("X-Device-Id", WiFi.macAddress());
+        http.collectHeaders(CACHE_HEADERS, CACHE_HEADER_COUNT);
+        
+        int httpResponseCode = http.POST(Metrics::toPrometheus());
+        if (httpResponseCode > 0) {
+            takeCacheHeaders(http);
+        }
         http.end();
         
         return httpResponseCode == 200;
@@ -83,12 +315,93 @@ public:
     
     void setServer(const String &url) {
         serverUrl = url;
+        mux.close();
+        muxRetryMs = 0;
+    }
+    
+    // Whether requests currently share the multiplexed connection
+    bool isMultiplexed() const {
+        return mux.isConnected();
     }
     
 private:
-    String serverUrl = "http://192.168.1.100:8000";
+    String serverUrl = DEFAULT_SERVER_URL;
+    static const uint32_t CONNECT_POLL_MS = 50;
     const int MAX_RECONNECT_ATTEMPTS = 5;
     int reconnectAttempts = 0;
+    unsigned long reconnectAttemptMs = 0;
+    bool wasDisconnected = false;
+    bool connecting = false;
+    unsigned long connectStartMs = 0;
+    LinkEstimator link;
+    uint32_t audioSession = 0;
+    bool commandSucceeded = false;
+    
+    // One connection for every request (mux_client.cpp) while the server
+    // has /mux; retried with backoff, with HTTP in the meantime
+    static const uint32_t MUX_RETRY_MIN_MS = 5000;
+    static const uint32_t MUX_RETRY_MAX_MS = 10UL * 60 * 1000;
+    MuxClient mux;
+    unsigned long muxAttemptMs = 0;
+    uint32_t muxRetryMs = 0;
+    
+    static const uint8_t CACHE_PARTITION_SUBTYPE = 0x41;
+    static const uint32_t CACHE_DEFAULT_TTL_S = 600;            // Without a max-age from the server
+    static const uint32_t CACHE_MAX_TTL_S = 7 * 24 * 3600;
+    static inline const char* CACHE_HEADERS[] = { "Date", "Cache-Control", "X-Cache-Invalidate" };
+    static const size_t CACHE_HEADER_COUNT = 3;
+    ResponseCache<> cache;
+    String transcript;
+    bool clockKnown = false;
+    uint32_t clockOffsetS = 0;                                  // Server time minus uptime
+    
+    uint32_t now() const {
+        return (uint32_t)(millis() / 1000) + clockOffsetS;
+    }
+    
+    // Any answer may set the clock or drop cached answers (X-Cache-Invalidate:
+    // "*" or hex keys, see response_cache.cpp); the minutely metrics push
+    // makes sure drops arrive when no command is asked
+    void takeCacheHeaders(MuxHttp& http) {
+        uint32_t date = parseHttpDate(http.header("Date").c_str());
+        if (date != 0) {
+            clockOffsetS = date - (uint32_t)(millis() / 1000);
+            clockKnown = true;
+        }
+        String invalidation = http.header("X-Cache-Invalidate");
+        if (invalidation.length() > 0) {
+            size_t dropped = cache.invalidate(invalidation.c_str());
+            if (dropped > 0) {
+                Metrics::inc(CACHE_INVALIDATIONS, dropped);
+            }
+        }
+    }
+    
+    void serviceMux() {
+        if (mux.isConnected()) {
+            mux.service();
+            return;
+        }
+        if (millis() - muxAttemptMs < muxRetryMs) {
+            return;
+        }
+        muxAttemptMs = millis();
+        if (mux.connect(serverUrl)) {
+            muxRetryMs = MUX_RETRY_MIN_MS;
+        } else {
+            muxRetryMs = muxRetryMs == 0 ? MUX_RETRY_MIN_MS : muxRetryMs * 2;
+            if (muxRetryMs > MUX_RETRY_MAX_MS) muxRetryMs = MUX_RETRY_MAX_MS;
+        }
+    }
+    
+    void recordRequest(unsigned long startTime, size_t bytesSent, bool ok) {
+        Metrics::inc(NET_REQUESTS);
+        Metrics::inc(NET_BYTES_SENT, bytesSent);
+        Metrics::observe(NET_LATENCY_MS, millis() - startTime);
+        if (!ok) {
+            Metrics::inc(NET_ERRORS);
+        }
+    }
 };
 
 #endif
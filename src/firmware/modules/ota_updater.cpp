@@ -0,0 +1,279 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include "../config/config.h"
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+#include "../utils/update_stream.cpp"
+#include "power_manager.cpp"
+#include "radio_scheduler.cpp"
+#include "tls_transport.cpp"
+
+// Over-the-air firmware updates into the inactive slot of the A/B layout
+// (partitions_ab.csv).
+//
+// checkForUpdate() asks the server's /ota/update for a newer image, sending
+// the running version. The server answers 204 when there is nothing newer,
+// otherwise with an update package (update_stream.cpp): a delta against the
+// running image when it has one for this version, else the full image.
+// The package goes from the socket through the decoder and delta applier
+// straight into the inactive slot, which is erased sector by sector as the
+// writes reach it; the running slot is only read, as the delta's base. RAM
+// use is the decoder window plus one flash page, whatever the image size.
+//
+// A delta is only applied after the running image hashes to the package's
+// base; otherwise (a locally flashed build with the same version string)
+// the full image is requested instead. The new slot is set to boot only
+// when size, SHA-256 and the IDF image check all pass, so an interrupted or
+// corrupt download leaves the running firmware as it was.
+//
+// Rollback: the bootloader starts a new image pending verification.
+// confirmBoot() keeps it once the boot went well, or marks it invalid and
+// restarts into the previous slot. A crash or reset before confirmBoot() has
+// the same effect, as the bootloader aborts an image still pending.
+//
+// An https:// server is reached with the device's TLS credentials, as for
+// every other request: the package's hashes only catch damage on the way,
+// while TLS keeps a forged image out.
+class OtaUpdater {
+public:
+    enum Result : uint8_t {
+        OTA_UP_TO_DATE,
+        OTA_INSTALLED,          // Boots on the next restart
+        OTA_FAILED
+    };
+
+    static const uint32_t READ_TIMEOUT_MS = 10000;
+    static const size_t CHUNK_BYTES = 1024;         // Socket reads
+    static const size_t PAGE_BYTES = 4096;          // Flash writes, one sector
+
+    // First boot of an update: keep it when healthy, else roll back and restart
+    void confirmBoot(bool healthy) {
+        if (!isPendingVerify()) {
+            return;
+        }
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        if (healthy) {
+            esp_ota_mark_app_valid_cancel_rollback();
+            Logger::info("OTA", String("Update confirmed, running from ") + running->label);
+            return;
+        }
+        Logger::error("OTA", String("Update in ") + running->label + " failed its first boot, rolling back");
+        Metrics::inc(OTA_ROLLBACKS);
+        esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+        Logger::error("OTA", String("Rollback not possible: ") + esp_err_to_name(err));
+    }
+
+    bool isPendingVerify() {
+        esp_ota_img_states_t state;
+        return esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+               state == ESP_OTA_IMG_PENDING_VERIFY;
+    }
+
+    Result checkForUpdate() {
+        if (WiFi.status() != WL_CONNECTED || isPendingVerify()) {
+            return OTA_FAILED;
+        }
+        bool baseMismatch = false;
+        Result result = download(true, baseMismatch);
+        if (baseMismatch) {
+            Logger::warning("OTA", "Running image is not the delta's base, fetching the full image");
+            result = download(false, baseMismatch);
+        }
+        return result;
+    }
+
+    void setServer(const String& url) {
+        serverUrl = url;
+    }
+
+    UpdateError getLastError() const { return stream.getError(); }
+
+private:
+    String serverUrl = DEFAULT_SERVER_URL;
+    UpdateStream stream;
+    const esp_partition_t* running = nullptr;
+    esp_ota_handle_t handle = 0;
+    uint8_t chunk[CHUNK_BYTES];
+    uint8_t page[PAGE_BYTES];
+    size_t pageFill = 0;
+    bool flashFailed = false;
+
+    Result download(bool acceptDelta, bool& baseMismatch) {
+        baseMismatch = false;
+        PmLockGuard pmLock(PM_WORK_NETWORK);
+        RadioAwakeGuard radioAwake;
+        WiFiClientSecure secure;
+        HTTPClient http;
+        String url = serverUrl + "/ota/update";
+        if (url.startsWith("https://")) {
+            TlsCredentials::get().apply(secure);
+            http.begin(secure, url);
+        } else {
+            http.begin(url);
+        }
+        http.setTimeout(READ_TIMEOUT_MS);
+        http.addHeader("X-Firmware-Version", FIRMWARE_VERSION);
+        http.addHeader("X-Accept-Delta", acceptDelta ? "1" : "0");
+        int code = http.GET();
+        if (code == 204) {
+            http.end();
+            return OTA_UP_TO_DATE;
+        }
+        if (code != 200) {
+            Logger::error("OTA", "Update check failed: HTTP " + String(code));
+            http.end();
+            return OTA_FAILED;
+        }
+
+        WiFiClient* socket = http.getStreamPtr();
+        uint8_t raw[UpdateHeader::BYTES];
+        UpdateHeader header;
+        if (!readFully(http, socket, raw, sizeof(raw)) || !header.parse(raw)) {
+            return fail(http, "bad package header");
+        }
+        running = esp_ota_get_running_partition();
+        const esp_partition_t* target = esp_ota_get_next_update_partition(nullptr);
+        if (target == nullptr || header.targetSize > target->size) {
+            return fail(http, "image does not fit the update slot");
+        }
+        if (header.isDelta() && !baseMatches(header)) {
+            http.end();
+            baseMismatch = true;
+            return OTA_FAILED;
+        }
+
+        Logger::info("OTA", String("Installing ") + header.version + " into " + target->label +
+                     (header.isDelta() ? " (delta, " : " (full, ") + String(header.payloadSize) + " bytes)");
+        unsigned long startMs = millis();
+        esp_err_t err = esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+        if (err != ESP_OK) {
+            return fail(http, esp_err_to_name(err));
+        }
+        pageFill = 0;
+        flashFailed = false;
+        stream.begin(header, readBase, writeTarget, this);
+
+        uint32_t left = header.payloadSize;
+        while (left > 0) {
+            size_t n = readSome(http, socket, chunk, left < CHUNK_BYTES ? left : CHUNK_BYTES);
+            if (n == 0 || !stream.write(chunk, n)) {
+                break;
+            }
+            left -= n;
+        }
+        if (!stream.finish() || !flushPage()) {
+            esp_ota_abort(handle);
+            return fail(http, flashFailed ? "flash write failed" : updateErrorName(stream.getError()));
+        }
+        http.end();
+
+        err = esp_ota_end(handle);
+        if (err == ESP_OK) {
+            err = esp_ota_set_boot_partition(target);
+        }
+        if (err != ESP_OK) {
+            Logger::error("OTA", String("Update rejected: ") + esp_err_to_name(err));
+            Metrics::inc(OTA_FAILURES);
+            return OTA_FAILED;
+        }
+        Metrics::inc(OTA_INSTALLS);
+        Logger::info("OTA", String("Installed ") + header.version + " in " + String(millis() - startMs) +
+                     " ms, boots on the next restart");
+        return OTA_INSTALLED;
+    }
+
+    Result fail(HTTPClient& http, const char* reason) {
+        http.end();
+        Logger::error("OTA", String("Update failed: ") + reason);
+        Metrics::inc(OTA_FAILURES);
+        return OTA_FAILED;
+    }
+
+    // Hashes the first baseSize bytes of the running slot
+    bool baseMatches(const UpdateHeader& header) {
+        if (header.baseSize > running->size) {
+            return false;
+        }
+        Sha256 hash;
+        for (uint32_t offset = 0; offset < header.baseSize; offset += CHUNK_BYTES) {
+            uint32_t n = header.baseSize - offset < CHUNK_BYTES ? header.baseSize - offset : CHUNK_BYTES;
+            if (esp_partition_read(running, offset, chunk, n) != ESP_OK) {
+                return false;
+            }
+            hash.update(chunk, n);
+        }
+        uint8_t digest[Sha256::DIGEST_BYTES];
+        hash.finish(digest);
+        return memcmp(digest, header.baseSha256, sizeof(digest)) == 0;
+    }
+
+    static bool readBase(void* self, uint32_t offset, uint8_t* out, size_t length) {
+        OtaUpdater* updater = (OtaUpdater*)self;
+        return esp_partition_read(updater->running, offset, out, length) == ESP_OK;
+    }
+
+    // Collects the image into whole sectors for esp_ota_write
+    static bool writeTarget(void* self, const uint8_t* data, size_t length) {
+        OtaUpdater* updater = (OtaUpdater*)self;
+        while (length > 0) {
+            size_t n = PAGE_BYTES - updater->pageFill < length ? PAGE_BYTES - updater->pageFill : length;
+            memcpy(updater->page + updater->pageFill, data, n);
+            updater->pageFill += n;
+            data += n;
+            length -= n;
+            if (updater->pageFill == PAGE_BYTES && !updater->flushPage()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool flushPage() {
+        if (pageFill > 0 && !flashFailed) {
+            esp_err_t err = esp_ota_write(handle, page, pageFill);
+            if (err != ESP_OK) {
+                Logger::error("OTA", String("Flash write failed: ") + esp_err_to_name(err));
+                flashFailed = true;
+            }
+        }
+        pageFill = 0;
+        return !flashFailed;
+    }
+
+    // Whatever the socket has, up to length bytes; 0 once it closed or stalled
+    static size_t readSome(HTTPClient& http, WiFiClient* socket, uint8_t* out, size_t length) {
+        unsigned long startMs = millis();
+        while (millis() - startMs < READ_TIMEOUT_MS) {
+            int available = socket->available();
+            if (available > 0) {
+                int n = socket->read(out, length < (size_t)available ? length : (size_t)available);
+                return n > 0 ? n : 0;
+            }
+            if (!http.connected()) {
+                return 0;
+            }
+            delay(1);
+        }
+        return 0;
+    }
+
+    static bool readFully(HTTPClient& http, WiFiClient* socket, uint8_t* out, size_t length) {
+        while (length > 0) {
+            size_t n = readSome(http, socket, out, length);
+            if (n == 0) {
+                return false;
+            }
+            out += n;
+            length -= n;
+        }
+        return true;
+    }
+};
+
+#endif
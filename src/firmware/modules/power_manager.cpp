@@ -0,0 +1,206 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <esp_idf_version.h>
+#include "../config/board_profile.h"
+#include "../utils/logger.cpp"
+
+enum PowerMode {
+    NORMAL,
+    ECO,
+    ULTRA_LOW
+};
+
+// Kinds of active work that must not be slowed down or put to sleep
+enum PmWork : uint8_t {
+    PM_WORK_NETWORK,
+    PM_WORK_I2C,
+    PM_WORK_DSP,
+    PM_WORK_COUNT
+};
+
+// Dynamic frequency scaling bounds handed to esp_pm_configure()
+struct DfsBounds {
+    uint16_t maxMhz;
+    uint16_t minMhz;
+    bool lightSleep;
+
+    bool operator==(const DfsBounds& other) const {
+        return maxMhz == other.maxMhz && minMhz == other.minMhz && lightSleep == other.lightSleep;
+    }
+    bool operator!=(const DfsBounds& other) const { return !(*this == other); }
+};
+
+// Chooses DFS bounds from the user power mode, recent workload and battery level,
+// with the board's low and critical battery levels. Pure logic so it can be
+// exercised off-target.
+class PowerPolicy {
+public:
+    // busyRatio: fraction of the last window with any PM lock held (0.0 - 1.0)
+    static DfsBounds choose(PowerMode mode, float busyRatio, float batteryPercent) {
+        DfsBounds bounds;
+
+        switch (mode) {
+            case NORMAL:    bounds.maxMhz = 240; break;
+            case ECO:       bounds.maxMhz = 160; break;
+            case ULTRA_LOW: bounds.maxMhz = 80;  break;
+        }
+
+        // Battery overrides the user choice
+        if (batteryPercent < Board::Battery::CRITICAL_PERCENT) {
+            bounds.maxMhz = 80;
+        } else if (batteryPercent < Board::Battery::LOW_PERCENT && bounds.maxMhz > 160) {
+            bounds.maxMhz = 160;
+        }
+
+        // Under sustained load, ramping up from XTAL costs more than it saves
+        bounds.minMhz = busyRatio > 0.5f ? 80 : 40;
+
+        // Light sleep only pays off when there are idle gaps to sleep in
+        bounds.lightSleep = busyRatio < 0.8f;
+
+        return bounds;
+    }
+};
+
+// Owns the ESP-IDF power management locks and the current DFS configuration.
+// Work that needs full speed takes a lock through PmLockGuard; between locks the
+// idle task may drop to minMhz and enter automatic light sleep.
+class PowerManager {
+public:
+    static void begin() {
+        static const char* const names[PM_WORK_COUNT] = { "network", "i2c", "dsp" };
+        // The I2C controller runs off the APB clock; everything else needs CPU speed
+        static const esp_pm_lock_type_t types[PM_WORK_COUNT] = {
+            ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_CPU_FREQ_MAX
+        };
+
+        for (int i = 0; i < PM_WORK_COUNT; i++) {
+            if (esp_pm_lock_create(types[i], 0, names[i], &locks[i]) != ESP_OK) {
+                locks[i] = nullptr;
+            }
+        }
+        windowStart = micros();
+    }
+
+    static void acquire(PmWork work) {
+        if (locks[work]) {
+            esp_pm_lock_acquire(locks[work]);
+        }
+        portENTER_CRITICAL(&busyMux);
+        if (activeCount++ == 0) {
+            busySince = micros();
+        }
+        portEXIT_CRITICAL(&busyMux);
+    }
+
+    static void release(PmWork work) {
+        portENTER_CRITICAL(&busyMux);
+        if (--activeCount == 0) {
+            busyUs += micros() - busySince;
+        }
+        portEXIT_CRITICAL(&busyMux);
+        if (locks[work]) {
+            esp_pm_lock_release(locks[work]);
+        }
+    }
+
+    // Re-evaluate the policy; only touches the hardware when the bounds change
+    static void update(PowerMode mode, float batteryPercent) {
+        DfsBounds bounds = PowerPolicy::choose(mode, takeBusyRatio(), batteryPercent);
+        if (configured && bounds == current) {
+            return;
+        }
+        apply(bounds);
+    }
+
+    static DfsBounds getBounds() {
+        return current;
+    }
+
+    static bool autoSleepEnabled() {
+        return pmSupported && current.lightSleep;
+    }
+
+private:
+    static esp_pm_lock_handle_t locks[PM_WORK_COUNT];
+    static DfsBounds current;
+    static bool configured;
+    static bool pmSupported;
+    static portMUX_TYPE busyMux;
+    static uint8_t activeCount;
+    static unsigned long busySince;
+    static unsigned long busyUs;
+    static unsigned long windowStart;
+
+    static float takeBusyRatio() {
+        portENTER_CRITICAL(&busyMux);
+        unsigned long now = micros();
+        unsigned long busy = busyUs;
+        if (activeCount > 0) {
+            busy += now - busySince;
+            busySince = now;
+        }
+        unsigned long window = now - windowStart;
+        busyUs = 0;
+        windowStart = now;
+        portEXIT_CRITICAL(&busyMux);
+        return window ? (float)busy / window : 0.0f;
+    }
+
+    static void apply(const DfsBounds& bounds) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_pm_config_t config = {
+#else
+        esp_pm_config_esp32s3_t config = {
+#endif
+            .max_freq_mhz = bounds.maxMhz,
+            .min_freq_mhz = bounds.minMhz,
+            .light_sleep_enable = bounds.lightSleep
+        };
+
+        esp_err_t err = esp_pm_configure(&config);
+        pmSupported = err == ESP_OK;
+        if (!pmSupported) {
+            // Framework built without CONFIG_PM_ENABLE: fixed clock only
+            setCpuFrequencyMhz(bounds.maxMhz);
+        }
+
+        current = bounds;
+        configured = true;
+        Logger::debug("POWER", "DFS " + String(bounds.minMhz) + "-" + String(bounds.maxMhz) +
+                      " MHz, light sleep " + (autoSleepEnabled() ? "on" : "off"));
+    }
+};
+
+esp_pm_lock_handle_t PowerManager::locks[PM_WORK_COUNT] = {};
+DfsBounds PowerManager::current = { 240, 240, false };
+bool PowerManager::configured = false;
+bool PowerManager::pmSupported = false;
+portMUX_TYPE PowerManager::busyMux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t PowerManager::activeCount = 0;
+unsigned long PowerManager::busySince = 0;
+unsigned long PowerManager::busyUs = 0;
+unsigned long PowerManager::windowStart = 0;
+
+// Holds a PM lock for the enclosing scope
+class PmLockGuard {
+public:
+    explicit PmLockGuard(PmWork work) : work(work) {
+        PowerManager::acquire(work);
+    }
+
+    ~PmLockGuard() {
+        PowerManager::release(work);
+    }
+
+    PmLockGuard(const PmLockGuard&) = delete;
+    PmLockGuard& operator=(const PmLockGuard&) = delete;
+
+private:
+    PmWork work;
+};
+
+#endif
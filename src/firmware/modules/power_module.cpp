@@ -1,11 +1,12 @@
 #ifndef POWER_MODULE_H
 #define POWER_MODULE_H
 
-enum PowerMode {
-    NORMAL,
-    ECO,
-    ULTRA_LOW
-};
+#include "../config/board_profile.h"
+#include "../utils/metrics.cpp"
+#include "../hal/adc_hal.cpp"
+#include "power_manager.cpp"
+#include "radio_scheduler.cpp"
+#include "battery_model.cpp"
 
 class PowerModule {
 public:
@@ -15,26 +16,51 @@ public:
         analogSetAttenuation(ADC_11db);
         
         // Configure power pins
-        pinMode(BAT1_VOLTAGE_PIN, INPUT);
-        pinMode(BAT2_VOLTAGE_PIN, INPUT);
+        pinMode(Board::Battery::PIN1, INPUT);
+        pinMode(Board::Battery::PIN2, INPUT);
+        
+        static const uint8_t batteryPins[2] = { Board::Battery::PIN1, Board::Battery::PIN2 };
+        if (!AdcHal::begin(batteryPins, 2)) {
+            Logger::warning("POWER", "ADC DMA unavailable, using single reads");
+        }
+        if (!AdcHal::isCalibrated()) {
+            Logger::warning("POWER", "No ADC eFuse calibration, using default Vref");
+        }
+        
+        // Enable DFS and automatic light sleep for the current mode
+        PowerManager::begin();
+        applyPowerMode();
         
         return true;
     }
     
     void checkStatus() {
+        // Ends the radio's tail and early-wake windows on time
+        RadioScheduler::service();
+        
         unsigned long currentTime = millis();
         if (currentTime - lastCheck < CHECK_INTERVAL) {
             return;
         }
+        uint32_t elapsed = lastSample ? currentTime - lastSample : 0;
         lastCheck = currentTime;
+        lastSample = currentTime;
+        accountModeTime();
         
-        // Read battery voltages
-        float bat1Voltage = readBatteryVoltage(BAT1_VOLTAGE_PIN);
-        float bat2Voltage = readBatteryVoltage(BAT2_VOLTAGE_PIN);
+        // Read battery voltages at the pins, then undo the divider
+        uint32_t pinMv[2];
+        AdcHal::sample(pinMv);
+        
+        // Each cell powers one side, so assume it carries half the load
+        float loadMa = estimateLoadMa() / 2;
+        bat1Model.update(pinMv[0] * Board::Battery::DIVIDER, loadMa, elapsed);
+        bat2Model.update(pinMv[1] * Board::Battery::DIVIDER, loadMa, elapsed);
         
         // Update battery levels
-        bat1Level = voltageToPercent(bat1Voltage);
-        bat2Level = voltageToPercent(bat2Voltage);
+        bat1Level = bat1Model.getPercent();
+        bat2Level = bat2Model.getPercent();
+        
+        Metrics::set(BATTERY_PERCENT, (int32_t)getBatteryLevel());
         
         // Check if we need to switch power modes
         updatePowerMode();
@@ -46,6 +72,7 @@ public:
     }
     
     void togglePowerMode() {
+        accountModeTime();
         switch (currentMode) {
             case NORMAL:
                 currentMode = ECO;
@@ -65,28 +92,51 @@ public:
     }
     
 private:
-    static const uint8_t BAT1_VOLTAGE_PIN = 34;
-    static const uint8_t BAT2_VOLTAGE_PIN = 35;
-    static const unsigned long CHECK_INTERVAL = 30000; // 30 seconds
-    static const float LOW_BATTERY_THRESHOLD = 20.0;
-    static const float CRITICAL_BATTERY_THRESHOLD = 10.0;
+    static const unsigned long CHECK_INTERVAL = 5000; // 5 seconds, keeps the coulomb estimate fine-grained
+    static constexpr float LOW_BATTERY_THRESHOLD = Board::Battery::LOW_PERCENT;
+    static constexpr float CRITICAL_BATTERY_THRESHOLD = Board::Battery::CRITICAL_PERCENT;
     
     PowerMode currentMode = NORMAL;
     float bat1Level = 100.0;
     float bat2Level = 100.0;
     unsigned long lastCheck = 0;
+    unsigned long lastSample = 0;
+    unsigned long modeSince = 0;
+    BatteryModel bat1Model;
+    BatteryModel bat2Model;
     
-    float readBatteryVoltage(uint8_t pin) {
-        // Read ADC and convert to voltage
-        float adcValue = analogRead(pin);
-        return (adcValue / 4095.0) * 3.3 * 2; // Voltage divider ratio
+    // Rough total draw from the current clock ceiling and how long the radio
+    // was kept awake; Wi-Fi stays associated in every mode. Figures match
+    // scripts/energy_model.py.
+    float estimateLoadMa() {
+        float cpuMa;
+        switch (PowerManager::getBounds().maxMhz) {
+            case 240: cpuMa = 43.0f; break;
+            case 160: cpuMa = 34.0f; break;
+            default:  cpuMa = 23.0f; break;
+        }
+        float wifiMa = RadioScheduler::takeCurrentMa();
+        const float peripheralsMa = 15.0f;   // Display, mic, regulator
+        return cpuMa + wifiMa + peripheralsMa;
     }
     
-    float voltageToPercent(float voltage) {
-        // LiPo battery voltage to percentage conversion
-        // Assuming 3.0V = 0%, 4.2V = 100%
-        float percentage = (voltage - 3.0) * 83.33;
-        return constrain(percentage, 0, 100);
+    // Credit the time since the last call to the mode we were in
+    void accountModeTime() {
+        unsigned long now = millis();
+        uint32_t elapsed = now - modeSince;
+        modeSince = now;
+        
+        switch (currentMode) {
+            case NORMAL:
+                Metrics::inc(POWER_NORMAL_MS, elapsed);
+                break;
+            case ECO:
+                Metrics::inc(POWER_ECO_MS, elapsed);
+                break;
+            case ULTRA_LOW:
+                Metrics::inc(POWER_ULTRA_LOW_MS, elapsed);
+                break;
+        }
     }
     
     void updatePowerMode() {
@@ -101,23 +151,11 @@ private:
         applyPowerMode();
     }
     
+    // Hand the mode to the power manager and the radio scheduler; each
+    // reconfigures only when its setting differs from what is applied
     void applyPowerMode() {
-        switch (currentMode) {
-            case NORMAL:
-                // Full functionality
-                setCpuFrequencyMhz(240);
-                break;
-                
-            case ECO:
-                // Reduced functionality
-                setCpuFrequencyMhz(160);
-                break;
-                
-            case ULTRA_LOW:
-                // Minimal functionality
-                setCpuFrequencyMhz(80);
-                break;
-        }
+        PowerManager::update(currentMode, getBatteryLevel());
+        RadioScheduler::update(currentMode, getBatteryLevel());
     }
 };
 
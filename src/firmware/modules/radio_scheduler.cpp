@@ -0,0 +1,254 @@
+#ifndef RADIO_SCHEDULER_H
+#define RADIO_SCHEDULER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+#include "power_manager.cpp"
+
+// How the Wi-Fi modem spends the time between requests in one power mode
+struct RadioSetting {
+    uint8_t listenInterval;     // Beacons between wakes while idle
+    uint16_t tailMs;            // Awake after a reply, for the request that follows it
+    bool earlyWake;             // Awake from candidate speech, ahead of the upload
+
+    bool operator==(const RadioSetting& other) const {
+        return listenInterval == other.listenInterval && tailMs == other.tailMs && earlyWake == other.earlyWake;
+    }
+    bool operator!=(const RadioSetting& other) const { return !(*this == other); }
+};
+
+// Chooses the idle listen interval and how long the radio stays awake around
+// requests from the user power mode and battery level. Pure logic so it can
+// be exercised off-target.
+//
+// Awake, the radio draws about 80 mA; in modem sleep it wakes only for a
+// beacon every listen interval. A reply that arrives in between waits at the
+// AP for that wake, up to 102 ms per beacon of interval, so the radio sleeps
+// only while no reply is due. The intervals come from scripts/energy_model.py:
+// past 3 beacons the idle draw falls little, while broadcasts (ARP) are
+// missed more and more.
+class RadioPolicy {
+public:
+    static RadioSetting choose(PowerMode mode, float batteryPercent) {
+        // Battery overrides the user choice, as for DFS
+        if (batteryPercent < Board::Battery::CRITICAL_PERCENT) {
+            mode = ULTRA_LOW;
+        } else if (batteryPercent < Board::Battery::LOW_PERCENT && mode == NORMAL) {
+            mode = ECO;
+        }
+
+        switch (mode) {
+            case NORMAL:    return { 3, 500, true };
+            case ECO:       return { 5, 200, false };
+            default:        return { 10, 0, false };
+        }
+    }
+
+    // Average draw of the radio while associated and idle, mA. Each wake
+    // costs the beacon plus the driver's wait for broadcast data. Figures
+    // match scripts/energy_model.py.
+    static float idleCurrentMa(bool awake, uint8_t listenInterval) {
+        const float awakeMa = 80.0f;
+        const float asleepMa = 3.0f;
+        const float wakeMs = 21.8f;
+        const float beaconMs = 102.4f;
+        if (awake) {
+            return awakeMa;
+        }
+        return asleepMa + awakeMa * wakeMs / (listenInterval * beaconMs);
+    }
+};
+
+// Keeps the modem in power save (WIFI_PS_MAX_MODEM) except while a reply is
+// due: from the request to its whole reply (RadioAwakeGuard), for tailMs
+// after it, and with earlyWake from candidate speech to the upload it leads
+// to. Awake means WIFI_PS_NONE, so nothing the server sends waits for a
+// beacon. PowerModule passes its mode in and calls service() every loop,
+// which ends the tail and early-wake windows.
+//
+// The listen interval goes out with the association request: a new one is
+// written to the station config and used from the next association on.
+class RadioScheduler {
+public:
+    // After WiFi.begin(), which writes a fresh station config
+    static void begin() {
+        if (lock == nullptr) {
+            lock = xSemaphoreCreateMutex();
+        }
+        take();
+        appliedInterval = 0;
+        give();
+        service();
+    }
+
+    static void update(PowerMode mode, float batteryPercent) {
+        RadioSetting next = RadioPolicy::choose(mode, batteryPercent);
+        take();
+        bool changed = next != setting;
+        setting = next;
+        give();
+        if (changed) {
+            Logger::debug("RADIO", "Listen interval " + String(next.listenInterval) + ", tail " +
+                          String(next.tailMs) + " ms, early wake " + (next.earlyWake ? "on" : "off"));
+        }
+        service();
+    }
+
+    // Candidate speech: an upload is likely to start within EXPECT_MS
+    static void expect() {
+        take();
+        bool wake = setting.earlyWake;
+        if (wake) {
+            if (!expecting || expectUsed) {
+                Metrics::inc(WIFI_EARLY_WAKES);
+            }
+            expecting = true;
+            expectUsed = false;
+            expectSince = millis();
+        }
+        give();
+        if (wake) {
+            service();
+        }
+    }
+
+    static void acquire() {
+        take();
+        active++;
+        expectUsed = true;
+        give();
+        service();
+    }
+
+    static void release() {
+        take();
+        if (active > 0 && --active == 0) {
+            tailing = setting.tailMs > 0;
+            tailSince = millis();
+        }
+        give();
+        service();
+    }
+
+    // Applies the power save the current state calls for; only touches the
+    // driver when that changes
+    static void service() {
+        take();
+        unsigned long now = millis();
+        if (expecting && now - expectSince >= EXPECT_MS) {
+            expecting = false;
+            if (!expectUsed) {
+                Metrics::inc(WIFI_EARLY_WAKES_UNUSED);
+            }
+        }
+        if (tailing && now - tailSince >= setting.tailMs) {
+            tailing = false;
+        }
+        bool awake = active > 0 || expecting || tailing;
+        if (!configured || awake != applied) {
+            WiFi.setSleep(awake ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+            if (configured && applied) {
+                awakeMs += now - awakeSince;
+                Metrics::inc(WIFI_AWAKE_MS, now - awakeSince);
+            }
+            awakeSince = now;
+            applied = awake;
+            configured = true;
+        }
+        applyListenInterval();
+        give();
+    }
+
+    static bool isAwake() {
+        return configured && applied;
+    }
+
+    // Average radio draw since the last call, mA, for the battery model
+    static float takeCurrentMa() {
+        take();
+        unsigned long now = millis();
+        unsigned long awake = awakeMs;
+        if (configured && applied) {
+            awake += now - awakeSince;
+            Metrics::inc(WIFI_AWAKE_MS, now - awakeSince);
+            awakeSince = now;
+        }
+        unsigned long window = now - windowStart;
+        awakeMs = 0;
+        windowStart = now;
+        uint8_t interval = setting.listenInterval;
+        give();
+        float ratio = window ? (float)awake / window : 0.0f;
+        return ratio * RadioPolicy::idleCurrentMa(true, interval) +
+               (1.0f - ratio) * RadioPolicy::idleCurrentMa(false, interval);
+    }
+
+private:
+    static const unsigned long EXPECT_MS = 3000;    // A 2 s recording and its first chunk's reply
+
+    static inline SemaphoreHandle_t lock = nullptr;
+    static inline RadioSetting setting = RadioPolicy::choose(NORMAL, 100.0f);
+    static inline uint8_t appliedInterval = 0;
+    static inline bool configured = false;
+    static inline bool applied = false;
+    static inline uint8_t active = 0;
+    static inline bool expecting = false;
+    static inline bool expectUsed = false;
+    static inline bool tailing = false;
+    static inline unsigned long expectSince = 0;
+    static inline unsigned long tailSince = 0;
+    static inline unsigned long awakeSince = 0;
+    static inline unsigned long awakeMs = 0;
+    static inline unsigned long windowStart = 0;
+
+    // Requests can come from the loop and the listener task at once
+    static void take() {
+        if (lock != nullptr) {
+            xSemaphoreTake(lock, portMAX_DELAY);
+        }
+    }
+
+    static void give() {
+        if (lock != nullptr) {
+            xSemaphoreGive(lock);
+        }
+    }
+
+    // The driver refuses a new config while the station connects; tried
+    // again on the next call
+    static void applyListenInterval() {
+        if (appliedInterval == setting.listenInterval || WiFi.status() != WL_CONNECTED) {
+            return;
+        }
+        wifi_config_t config;
+        if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK) {
+            return;
+        }
+        config.sta.listen_interval = setting.listenInterval;
+        if (esp_wifi_set_config(WIFI_IF_STA, &config) == ESP_OK) {
+            appliedInterval = setting.listenInterval;
+        }
+    }
+};
+
+// Keeps the radio awake for the enclosing request and its reply
+class RadioAwakeGuard {
+public:
+    RadioAwakeGuard() {
+        RadioScheduler::acquire();
+    }
+
+    ~RadioAwakeGuard() {
+        RadioScheduler::release();
+    }
+
+    RadioAwakeGuard(const RadioAwakeGuard&) = delete;
+    RadioAwakeGuard& operator=(const RadioAwakeGuard&) = delete;
+};
+
+#endif
@@ -0,0 +1,473 @@
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <sdkconfig.h>
+#include <esp_idf_version.h>
+#include <nvs.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/error.h>
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+
+// The AES, SHA and RSA (MPI) accelerators only serve TLS through mbedtls'
+// hardware backends; the Arduino core's sdkconfig has them on
+#if !defined(CONFIG_MBEDTLS_HARDWARE_AES) || !defined(CONFIG_MBEDTLS_HARDWARE_SHA) || \
+    !defined(CONFIG_MBEDTLS_HARDWARE_MPI)
+#warning "mbedtls is built without the AES/SHA/MPI accelerators: TLS runs in software"
+#endif
+
+// The device's TLS credentials, in NVS namespace "tls". scripts/provision_psk.py
+// writes them as an NVS partition image; provision() does the same from the
+// firmware.
+// - "identity": PSK identity, a string of up to 32 characters
+// - "psk": the pre-shared key, 16 to 32 bytes
+// - "ca": the server's CA certificate in PEM, for a server without PSK
+struct TlsCredentials {
+    static const size_t MAX_IDENTITY = 32;
+    static const size_t MIN_KEY_BYTES = 16;
+    static const size_t MAX_KEY_BYTES = 32;
+    static const size_t MAX_CA_BYTES = 4096;
+
+    char identity[MAX_IDENTITY + 1] = "";
+    uint8_t key[MAX_KEY_BYTES] = {};
+    size_t keyLength = 0;
+    char keyHex[MAX_KEY_BYTES * 2 + 1] = "";    // As WiFiClientSecure takes it
+    String caPem;
+
+    bool hasPsk() const {
+        return keyLength > 0;
+    }
+
+    bool hasCa() const {
+        return caPem.length() > 0;
+    }
+
+    // The same credentials for HTTPClient's own TLS (no resumption there)
+    void apply(WiFiClientSecure& secure) const {
+        if (hasPsk()) {
+            secure.setPreSharedKey(identity, keyHex);
+        } else if (hasCa()) {
+            secure.setCACert(caPem.c_str());
+        }
+    }
+
+    // Read once, then kept; provision() and erase() refresh it
+    static const TlsCredentials& get() {
+        static TlsCredentials current;
+        if (!loaded) {
+            load(current);
+            loaded = true;
+        }
+        return current;
+    }
+
+    // False when NVS holds neither a usable PSK nor a CA
+    static bool load(TlsCredentials& out) {
+        out = TlsCredentials();
+        nvs_handle_t handle;
+        if (nvs_open(NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+            return false;
+        }
+        size_t identityLength = sizeof(out.identity);
+        size_t keyLength = sizeof(out.key);
+        if (nvs_get_str(handle, "identity", out.identity, &identityLength) == ESP_OK &&
+            nvs_get_blob(handle, "psk", out.key, &keyLength) == ESP_OK &&
+            keyLength >= MIN_KEY_BYTES && identityLength > 1) {
+            out.keyLength = keyLength;
+            toHex(out.key, keyLength, out.keyHex);
+        } else {
+            out.identity[0] = '\0';
+        }
+        size_t caLength = 0;
+        if (nvs_get_blob(handle, "ca", nullptr, &caLength) == ESP_OK && caLength > 0 && caLength <= MAX_CA_BYTES) {
+            char* pem = (char*)malloc(caLength + 1);
+            if (pem != nullptr && nvs_get_blob(handle, "ca", pem, &caLength) == ESP_OK) {
+                pem[caLength] = '\0';
+                out.caPem = pem;
+            }
+            free(pem);
+        }
+        nvs_close(handle);
+        return out.hasPsk() || out.hasCa();
+    }
+
+    static bool provision(const char* identity, const uint8_t* key, size_t length) {
+        size_t identityLength = strlen(identity);
+        if (identityLength == 0 || identityLength > MAX_IDENTITY || length < MIN_KEY_BYTES || length > MAX_KEY_BYTES) {
+            return false;
+        }
+        return write([&](nvs_handle_t handle) {
+            return nvs_set_str(handle, "identity", identity) == ESP_OK &&
+                   nvs_set_blob(handle, "psk", key, length) == ESP_OK;
+        });
+    }
+
+    static bool provisionCa(const String& pem) {
+        if (pem.indexOf("-----BEGIN CERTIFICATE-----") < 0 || pem.length() > MAX_CA_BYTES) {
+            return false;
+        }
+        return write([&](nvs_handle_t handle) {
+            return nvs_set_blob(handle, "ca", pem.c_str(), pem.length()) == ESP_OK;
+        });
+    }
+
+    static bool erase() {
+        return write([](nvs_handle_t handle) {
+            return nvs_erase_all(handle) == ESP_OK;
+        });
+    }
+
+private:
+    static constexpr const char* NAMESPACE = "tls";
+    static inline bool loaded = false;
+
+    template <typename Change>
+    static bool write(Change change) {
+        nvs_handle_t handle;
+        if (nvs_open(NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+            return false;
+        }
+        bool ok = change(handle) && nvs_commit(handle) == ESP_OK;
+        nvs_close(handle);
+        loaded = false;
+        return ok;
+    }
+
+    static void toHex(const uint8_t* data, size_t length, char* out) {
+        static const char DIGITS[] = "0123456789abcdef";
+        for (size_t i = 0; i < length; i++) {
+            out[i * 2] = DIGITS[data[i] >> 4];
+            out[i * 2 + 1] = DIGITS[data[i] & 0x0F];
+        }
+        out[length * 2] = '\0';
+    }
+};
+
+// The connection to the server, with or without TLS, with WiFiClient's calls
+// as MuxClient makes them. What makes a TLS connection slow on the S3 is the
+// handshake, not the records (AES and SHA-256 run on the accelerators): a
+// full one takes two round trips and a P-256 key exchange in software. So:
+// - with a PSK in NVS the server is authenticated by the key (ECDHE-PSK):
+//   no certificate chain to receive, parse and verify, no CA to keep current;
+//   without one, the server's certificate is checked against the CA in NVS
+// - every reconnect to the same server offers the session ticket of the last
+//   handshake (RFC 5077): one round trip and no public-key operations. A
+//   server that no longer knows the ticket does a full handshake instead.
+// - one curve, P-256, and AES suites only, which the accelerators serve
+// The handshake is stepped here rather than in one call so that it can time
+// out, and so that a resumed handshake (which skips the key exchange) can be
+// told from a full one for the metrics.
+class TlsTransport {
+public:
+    TlsTransport() {
+        mbedtls_ssl_init(&ssl);
+        mbedtls_ssl_config_init(&config);
+        mbedtls_ssl_session_init(&saved);
+        mbedtls_x509_crt_init(&ca);
+        mbedtls_entropy_init(&entropy);
+        mbedtls_ctr_drbg_init(&drbg);
+    }
+
+    ~TlsTransport() {
+        stop();
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&config);
+        mbedtls_ssl_session_free(&saved);
+        mbedtls_x509_crt_free(&ca);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+    }
+
+    TlsTransport(const TlsTransport&) = delete;
+    TlsTransport& operator=(const TlsTransport&) = delete;
+
+    // For the next connect(): https:// or not
+    void setSecure(bool enabled) {
+        secure = enabled;
+    }
+
+    bool isSecure() const {
+        return secure;
+    }
+
+    // TCP connect and, when secure, the handshake, both within timeoutMs
+    int connect(const char* host, uint16_t port, int32_t timeoutMs) {
+        stop();
+        unsigned long startMs = millis();
+        if (!client.connect(host, port, timeoutMs)) {
+            return 0;
+        }
+        if (!secure) {
+            return 1;
+        }
+        // mbedtls sends a flight as several records; Nagle would hold them
+        client.setNoDelay(true);
+        int32_t left = timeoutMs - (int32_t)(millis() - startMs);
+        if (left <= 0 || !handshake(host, port, left)) {
+            client.stop();
+            return 0;
+        }
+        return 1;
+    }
+
+    int setNoDelay(bool enabled) {
+        return client.setNoDelay(enabled);
+    }
+
+    int available() {
+        if (!secure) {
+            return client.available();
+        }
+        if (!established) {
+            return 0;
+        }
+        if (mbedtls_ssl_get_bytes_avail(&ssl) == 0 && client.available() > 0) {
+            mbedtls_ssl_read(&ssl, nullptr, 0);     // Decrypts a record that has arrived
+        }
+        return mbedtls_ssl_get_bytes_avail(&ssl);
+    }
+
+    int read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    int read(uint8_t* buffer, size_t size) {
+        if (!secure) {
+            return client.read(buffer, size);
+        }
+        if (!established) {
+            return -1;
+        }
+        int n = mbedtls_ssl_read(&ssl, buffer, size);
+        if (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return 0;
+        }
+        if (n < 0) {
+            established = false;    // Closed by the server, or broken
+            return -1;
+        }
+        return n;
+    }
+
+    // Takes what the socket takes now. After a short write mbedtls keeps the
+    // record and must be called again with the same data, which MuxClient does.
+    size_t write(const uint8_t* buffer, size_t size) {
+        if (!secure) {
+            return client.write(buffer, size);
+        }
+        if (!established) {
+            return 0;
+        }
+        int n = mbedtls_ssl_write(&ssl, buffer, size);
+        if (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return 0;
+        }
+        if (n < 0) {
+            established = false;
+            return 0;
+        }
+        return n;
+    }
+
+    uint8_t connected() {
+        if (!secure) {
+            return client.connected();
+        }
+        return established && (client.connected() || mbedtls_ssl_get_bytes_avail(&ssl) > 0);
+    }
+
+    void stop() {
+        if (established) {
+            mbedtls_ssl_close_notify(&ssl);
+            established = false;
+        }
+        client.stop();
+    }
+
+    // Whether the last handshake resumed a session
+    bool wasResumed() const {
+        return resumed;
+    }
+
+private:
+    static const size_t PERSONALIZATION_BYTES = 7;
+
+    // AES-128: the accelerator does it, and there is nothing to gain from 256
+    static inline const int PSK_SUITES[] = {
+        MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256,
+        0
+    };
+    static inline const int CERTIFICATE_SUITES[] = {
+        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+        0
+    };
+    static inline const mbedtls_ecp_group_id CURVES[] = {
+        MBEDTLS_ECP_DP_SECP256R1,
+        MBEDTLS_ECP_DP_NONE
+    };
+
+    WiFiClient client;
+    bool secure = false;
+    bool configured = false;
+    bool established = false;
+    bool resumed = false;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config config;
+    mbedtls_ssl_session saved;
+    bool haveSession = false;
+    String sessionHost;
+    uint16_t sessionPort = 0;
+    mbedtls_x509_crt ca;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+
+    static int handshakeState(const mbedtls_ssl_context& context) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        return context.MBEDTLS_PRIVATE(state);
+#else
+        return context.state;
+#endif
+    }
+
+    // Once, with whichever credentials NVS has; PSK first
+    bool configure() {
+        if (configured) {
+            return true;
+        }
+        const TlsCredentials& credentials = TlsCredentials::get();
+        if (!credentials.hasPsk() && !credentials.hasCa()) {
+            Logger::error("TLS", "No PSK or CA certificate provisioned");
+            return false;
+        }
+        int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                        (const unsigned char*)"glasses", PERSONALIZATION_BYTES);
+        if (ret == 0) {
+            ret = mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              MBEDTLS_SSL_PRESET_DEFAULT);
+        }
+        if (ret == 0 && credentials.hasPsk()) {
+            ret = mbedtls_ssl_conf_psk(&config, credentials.key, credentials.keyLength,
+                                       (const unsigned char*)credentials.identity, strlen(credentials.identity));
+            mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_NONE);
+            mbedtls_ssl_conf_ciphersuites(&config, PSK_SUITES);
+        } else if (ret == 0) {
+            ret = mbedtls_x509_crt_parse(&ca, (const unsigned char*)credentials.caPem.c_str(),
+                                         credentials.caPem.length() + 1);
+            mbedtls_ssl_conf_ca_chain(&config, &ca, nullptr);
+            mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_REQUIRED);
+            mbedtls_ssl_conf_ciphersuites(&config, CERTIFICATE_SUITES);
+        }
+        if (ret == 0) {
+            mbedtls_ssl_conf_rng(&config, mbedtls_ctr_drbg_random, &drbg);
+            mbedtls_ssl_conf_curves(&config, CURVES);
+            mbedtls_ssl_conf_session_tickets(&config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+            ret = mbedtls_ssl_setup(&ssl, &config);
+        }
+        if (ret != 0) {
+            logError("Setup failed", ret);
+            return false;
+        }
+        configured = true;
+        Logger::info("TLS", credentials.hasPsk() ? "Using PSK " + String(credentials.identity)
+                                                 : String("Using the CA certificate"));
+        return true;
+    }
+
+    bool handshake(const char* host, uint16_t port, uint32_t timeoutMs) {
+        if (!configure()) {
+            Metrics::inc(TLS_FAILURES);
+            return false;
+        }
+        mbedtls_ssl_session_reset(&ssl);
+        mbedtls_ssl_set_hostname(&ssl, host);
+        mbedtls_ssl_set_bio(&ssl, this, onSend, onReceive, nullptr);
+        bool offered = haveSession && sessionHost == host && sessionPort == port &&
+                       mbedtls_ssl_set_session(&ssl, &saved) == 0;
+
+        unsigned long startMs = millis();
+        bool keyExchange = false;
+        int ret = 0;
+        while (handshakeState(ssl) != MBEDTLS_SSL_HANDSHAKE_OVER) {
+            ret = mbedtls_ssl_handshake_step(&ssl);
+            if (handshakeState(ssl) == MBEDTLS_SSL_CLIENT_KEY_EXCHANGE) {
+                keyExchange = true;
+            }
+            if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                if (millis() - startMs >= timeoutMs) {
+                    break;
+                }
+                delay(1);
+            } else if (ret != 0) {
+                break;
+            }
+        }
+        uint32_t elapsedMs = millis() - startMs;
+        if (handshakeState(ssl) != MBEDTLS_SSL_HANDSHAKE_OVER) {
+            Metrics::inc(TLS_FAILURES);
+            if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                Logger::warning("TLS", "Handshake timed out after " + String(elapsedMs) + " ms");
+            } else {
+                logError("Handshake failed", ret);
+            }
+            if (offered) {
+                forgetSession();    // In case the ticket is what the server refused
+            }
+            return false;
+        }
+
+        established = true;
+        resumed = offered && !keyExchange;
+        Metrics::inc(resumed ? TLS_RESUMED : TLS_FULL);
+        Metrics::observe(resumed ? TLS_RESUMED_MS : TLS_FULL_MS, elapsedMs);
+        Logger::debug("TLS", String(resumed ? "Resumed " : "Full handshake ") + mbedtls_ssl_get_ciphersuite(&ssl) +
+                                 " in " + String(elapsedMs) + " ms");
+
+        // The ticket from this handshake, for the next
+        forgetSession();
+        if (mbedtls_ssl_get_session(&ssl, &saved) == 0) {
+            haveSession = true;
+            sessionHost = host;
+            sessionPort = port;
+        }
+        return true;
+    }
+
+    void forgetSession() {
+        mbedtls_ssl_session_free(&saved);
+        mbedtls_ssl_session_init(&saved);
+        haveSession = false;
+    }
+
+    void logError(const char* what, int ret) {
+        char text[80];
+        mbedtls_strerror(ret, text, sizeof(text));
+        Logger::error("TLS", String(what) + ": " + text);
+    }
+
+    static int onSend(void* context, const unsigned char* data, size_t length) {
+        TlsTransport* self = (TlsTransport*)context;
+        if (!self->client.connected()) {
+            return MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        size_t n = self->client.write(data, length);
+        return n > 0 ? (int)n : MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    static int onReceive(void* context, unsigned char* data, size_t length) {
+        TlsTransport* self = (TlsTransport*)context;
+        int available = self->client.available();
+        if (available <= 0) {
+            return self->client.connected() ? MBEDTLS_ERR_SSL_WANT_READ : 0;
+        }
+        return self->client.read(data, (size_t)available < length ? available : length);
+    }
+};
+
+#endif
@@ -1,7 +1,7 @@
 #ifndef TOUCH_MODULE_H
 #define TOUCH_MODULE_H
 
-#include "../config/pinmap.h"
+#include "../config/board_profile.h"
 
 enum TouchGesture {
     NONE,
@@ -15,13 +15,13 @@ enum TouchGesture {
 class TouchModule {
 public:
     bool begin() {
-        pinMode(TOUCH_PIN, INPUT);
-        touchAttachInterrupt(TOUCH_PIN, nullptr, TOUCH_THRESHOLD);
+        pinMode(Board::Touch::PIN, INPUT);
+        touchAttachInterrupt(Board::Touch::PIN, nullptr, TOUCH_THRESHOLD);
         return true;
     }
     
     bool checkTouch() {
-        uint16_t touchValue = touchRead(TOUCH_PIN);
+        uint16_t touchValue = touchRead(Board::Touch::PIN);
         unsigned long currentTime = millis();
         
         if (touchValue < TOUCH_THRESHOLD) {
@@ -50,7 +50,7 @@ public:
                         lastTapTime = currentTime;
                         // Wait a bit to see if it's a double tap
                         delay(50);
-                        if (touchRead(TOUCH_PIN) >= TOUCH_THRESHOLD) {
+                        if (touchRead(Board::Touch::PIN) >= TOUCH_THRESHOLD) {
                             currentGesture = SINGLE_TAP;
                             return true;
                         }
@@ -71,7 +71,7 @@ public:
     
 private:
     // Touch configuration
-    static const uint16_t TOUCH_THRESHOLD = 40;
+    static constexpr uint16_t TOUCH_THRESHOLD = Board::Touch::THRESHOLD;
     static const unsigned long TAP_DURATION = 150;
     static const unsigned long DOUBLE_TAP_INTERVAL = 300;
     static const unsigned long LONG_PRESS_DURATION = 500;
@@ -0,0 +1,287 @@
+#ifndef VISION_MODULE_H
+#define VISION_MODULE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+#include "../hal/camera_hal.cpp"
+#include "../dsp/frame_differ.cpp"
+#include "../dsp/jpeg_encoder.cpp"
+#include "../utils/logger.cpp"
+#include "../utils/metrics.cpp"
+#include "../utils/trace.cpp"
+#include "network_module.cpp"
+
+// Scene descriptions from the camera through the server's /vision/describe.
+//
+// Every look (a question, or a tick while watching) takes a frame and
+// compares its thumbnail with the one last sent (FrameDiffer):
+// - too little changed: the last description still holds, nothing is sent
+// - the change is local: only the region around it is encoded and sent, and
+//   the reply describes what is new there
+// - otherwise the whole frame goes
+// The region is encoded straight from the camera's frame buffer into one
+// PSRAM output buffer, which is uploaded in place (NetworkModule::sendImage).
+//
+// Quality follows the link: the JPEG should upload within uploadBudgetMs at
+// the measured goodput. One that comes out well over is encoded again lower
+// (the frame is still held); one well under lets the next start higher.
+struct VisionConfig {
+    uint16_t sceneChangeCells = 6;      // Of FrameDiffer's 768, for a new scene
+    uint8_t cropMaxPercent = 40;        // Larger changes send the whole frame
+    uint16_t cropMinSide = 160;         // Pixels; the detector needs some context
+    uint8_t minQuality = 25;
+    uint8_t maxQuality = 85;
+    uint8_t startQuality = 70;
+    uint8_t qualityStep = 10;
+    uint16_t uploadBudgetMs = 500;
+    uint32_t minTargetBytes = 12000;    // Even a link without an estimate takes this
+    uint32_t reuseMs = 300000;          // An unchanged scene is described again after this
+    uint32_t watchIntervalMs = 2000;
+};
+
+enum VisionRequest : uint8_t {
+    VISION_NONE,
+    VISION_DESCRIBE,
+    VISION_WATCH_START,
+    VISION_WATCH_STOP
+};
+
+// What the last look did, for logs and the host benchmark
+struct VisionReport {
+    bool captured = false;
+    bool uploaded = false;
+    bool cropped = false;
+    uint16_t changedCells = 0;
+    JpegRect region;
+    uint8_t quality = 0;
+    uint8_t encodes = 0;
+    uint32_t bytes = 0;                 // JPEG bytes sent
+    uint32_t captureMs = 0;             // Frame timestamp to description
+    uint32_t totalMs = 0;               // From the start of the look
+};
+
+class VisionModule {
+public:
+    explicit VisionModule(const VisionConfig& config = VisionConfig())
+        : config(config), differ() {
+        quality = config.startQuality;
+    }
+
+    void setNetworkModule(NetworkModule* module) {
+        network = module;
+    }
+
+    // Camera on, output buffer in PSRAM: half a byte per pixel holds a VGA
+    // frame at the top quality
+    bool begin() {
+        if (!CameraHal::begin()) {
+            Logger::warning("VISION", "No camera");
+            return false;
+        }
+        outputCapacity = (size_t)Board::Camera::WIDTH * Board::Camera::HEIGHT / 2;
+        if (output == nullptr) {
+            output = (uint8_t*)heap_caps_malloc(outputCapacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+        if (output == nullptr) {
+            Logger::error("VISION", "No PSRAM for the JPEG buffer");
+            CameraHal::end();
+            return false;
+        }
+        return true;
+    }
+
+    bool isReady() const {
+        return output != nullptr && CameraHal::isReady();
+    }
+
+    // What a transcribed command asks of the camera
+    static VisionRequest parseRequest(const String& command) {
+        String text = command;
+        text.toLowerCase();
+        if (text.indexOf("stop watching") >= 0) return VISION_WATCH_STOP;
+        if (text.indexOf("keep watching") >= 0 || text.indexOf("start watching") >= 0) return VISION_WATCH_START;
+        if (text.indexOf("what am i looking at") >= 0 || text.indexOf("what do you see") >= 0 ||
+            text.indexOf("describe") >= 0 || text.indexOf("what's in front of me") >= 0) {
+            return VISION_DESCRIBE;
+        }
+        return VISION_NONE;
+    }
+
+    // A description of what is in front of the camera now; the last one if
+    // the scene has not changed. Empty if there is none to give.
+    String describe() {
+        look();
+        return lastDescription;
+    }
+
+    void setWatching(bool enabled) {
+        watching = enabled;
+        lastWatchMs = millis() - config.watchIntervalMs;
+    }
+
+    bool isWatching() const {
+        return watching;
+    }
+
+    // While watching, looks every watchIntervalMs; true with a description
+    // when the scene changed
+    bool service(String& description) {
+        if (!watching || millis() - lastWatchMs < config.watchIntervalMs) {
+            return false;
+        }
+        lastWatchMs = millis();
+        if (!look()) {
+            return false;
+        }
+        description = lastDescription;
+        return true;
+    }
+
+    const VisionReport& getLastReport() const {
+        return report;
+    }
+
+    uint8_t getQuality() const {
+        return quality;
+    }
+
+    // The next look sends a whole frame
+    void forget() {
+        differ.clearReference();
+        lastDescription = "";
+    }
+
+private:
+    VisionConfig config;
+    FrameDiffer differ;
+    JpegEncoder encoder;
+    NetworkModule* network = nullptr;
+    uint8_t* output = nullptr;
+    size_t outputCapacity = 0;
+    uint8_t quality;
+    uint8_t thumb[FrameDiffer::THUMB_BYTES];
+    String lastDescription;
+    unsigned long describedAtMs = 0;
+    bool watching = false;
+    unsigned long lastWatchMs = 0;
+    VisionReport report;
+
+    // One frame: skip, crop or whole. True if a new description came back.
+    bool look() {
+        unsigned long startMs = millis();
+        report = VisionReport();
+        if (!isReady() || network == nullptr) {
+            return false;
+        }
+        CameraFrame frame;
+        {
+            TRACE_SPAN(TRACE_CAM_CAPTURE);
+            if (!CameraHal::capture(frame)) {
+                Logger::warning("VISION", "No frame from the camera");
+                return false;
+            }
+        }
+        report.captured = true;
+        FrameDiffer::thumbnail(frame.image, thumb);
+        SceneChange change = differ.compare(thumb, frame.image.width, frame.image.height);
+        report.changedCells = change.changedCells;
+
+        bool fresh = lastDescription.length() > 0 && millis() - describedAtMs < config.reuseMs;
+        if (fresh && change.changedCells < config.sceneChangeCells) {
+            CameraHal::release(frame);
+            Metrics::inc(VISION_SKIPPED);
+            report.totalMs = millis() - startMs;
+            return false;
+        }
+
+        JpegRect region;        // Empty: the whole frame
+        uint32_t frameArea = (uint32_t)frame.image.width * frame.image.height;
+        if (lastDescription.length() > 0 && differ.hasReferenceFrame() && change.region.area() > 0 &&
+            change.region.area() * 100 <= frameArea * config.cropMaxPercent) {
+            region = widen(change.region, frame.image.width, frame.image.height);
+            report.cropped = true;
+        }
+        report.region = region;
+
+        size_t length = encode(frame, region);
+        CameraHal::release(frame);
+        if (length == 0) {
+            Logger::error("VISION", "Frame does not fit the JPEG buffer");
+            return false;
+        }
+
+        String regionHeader;
+        if (report.cropped) {
+            regionHeader = String(region.x) + "," + String(region.y) + "," + String(region.width) + "," +
+                           String(region.height) + "/" + String(frame.image.width) + "x" + String(frame.image.height);
+        }
+        String reply = network->sendImage("/vision/describe", output, length, regionHeader);
+        report.uploaded = true;
+        report.bytes = length;
+        Metrics::inc(VISION_UPLOADS);
+        Metrics::inc(VISION_BYTES, length);
+        if (reply.length() == 0) {
+            return false;
+        }
+        StaticJsonDocument<512> doc;
+        if (deserializeJson(doc, reply)) {
+            return false;
+        }
+        String description = doc["description"] | "";
+        if (description.length() == 0) {
+            return false;
+        }
+        differ.setReference(thumb);
+        lastDescription = description;
+        describedAtMs = millis();
+        report.totalMs = millis() - startMs;
+        report.captureMs = millis() - frame.timestampMs;
+        Metrics::observe(VISION_LATENCY_MS, report.totalMs);
+        return true;
+    }
+
+    // At least cropMinSide on each side, around the same centre, on MCUs
+    JpegRect widen(JpegRect region, uint16_t width, uint16_t height) const {
+        auto grow = [](uint16_t& start, uint16_t& size, uint16_t minimum, uint16_t limit) {
+            if (size >= minimum) return;
+            if (minimum > limit) minimum = limit;
+            int32_t centre = start + size / 2;
+            int32_t newStart = centre - minimum / 2;
+            newStart = newStart / FrameDiffer::ALIGN * FrameDiffer::ALIGN;
+            if (newStart < 0) newStart = 0;
+            if (newStart + minimum > limit) newStart = limit - minimum;
+            start = newStart;
+            size = minimum;
+        };
+        grow(region.x, region.width, config.cropMinSide, width);
+        grow(region.y, region.height, config.cropMinSide, height);
+        return region;
+    }
+
+    // Encodes at the current quality, again lower while well over the
+    // budget, and adjusts the quality for next time
+    size_t encode(const CameraFrame& frame, const JpegRect& region) {
+        TRACE_SPAN(TRACE_CAM_ENCODE);
+        uint32_t target = network->getLinkEstimator().getGoodputBps() / 8 * config.uploadBudgetMs / 1000;
+        if (target < config.minTargetBytes) target = config.minTargetBytes;
+        size_t length = 0;
+        uint8_t q = quality;
+        for (uint8_t attempt = 0; attempt < 3; attempt++) {
+            encoder.setQuality(q);
+            length = encoder.encode(frame.image, region, output, outputCapacity);
+            report.encodes++;
+            bool over = length == 0 || length > target + target / 4;
+            if (!over || q <= config.minQuality) break;
+            q = q > config.minQuality + config.qualityStep ? q - config.qualityStep : config.minQuality;
+        }
+        report.quality = q;
+        if (length > 0 && length < target / 2 && q < config.maxQuality) {
+            q = q + config.qualityStep / 2 < config.maxQuality ? q + config.qualityStep / 2 : config.maxQuality;
+        }
+        quality = q;
+        return length;
+    }
+};
+
+#endif
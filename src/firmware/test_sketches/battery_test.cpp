@@ -1,11 +1,11 @@
 #include <Arduino.h>
-#include "../config/pinmap.h"
+#include "../config/board_profile.h"
 
 // Configuration
-#define STATUS_LED 48
+#define STATUS_LED Board::StatusLed::PIN
 #define DISPLAY_INTERVAL 1000  // Update every second
 #define BATTERY_SAMPLES 10     // Average multiple readings
-#define VOLTAGE_MULTIPLIER 2.0 // Voltage divider ratio (adjust based on your hardware)
+#define VOLTAGE_MULTIPLIER Board::Battery::DIVIDER
 #define FULL_BATTERY_VOLTAGE 4.2
 #define EMPTY_BATTERY_VOLTAGE 3.3
 
@@ -33,8 +33,8 @@ void setup() {
   Serial.println("\n\n");
   Serial.println("ESP32-S3 Battery Monitor Test");
   Serial.println("============================");
-  Serial.printf("Battery 1 monitoring on GPIO%d\n", BAT1_VOLTAGE_PIN);
-  Serial.printf("Battery 2 monitoring on GPIO%d\n", BAT2_VOLTAGE_PIN);
+  Serial.printf("Battery 1 monitoring on GPIO%d\n", Board::Battery::PIN1);
+  Serial.printf("Battery 2 monitoring on GPIO%d\n", Board::Battery::PIN2);
   
   // Note: ESP32-S3 uses 0-3.3V analog range with 12-bit resolution (0-4095)
   // Configure ADC
@@ -86,8 +86,8 @@ void displayBar(int percentage, char symbol) {
 
 void loop() {
   // Read battery voltages
-  battery1Voltage = readBatteryVoltage(BAT1_VOLTAGE_PIN);
-  battery2Voltage = readBatteryVoltage(BAT2_VOLTAGE_PIN);
+  battery1Voltage = readBatteryVoltage(Board::Battery::PIN1);
+  battery2Voltage = readBatteryVoltage(Board::Battery::PIN2);
   
   // Calculate battery percentages
   int battery1Percentage = calculateBatteryPercentage(battery1Voltage);
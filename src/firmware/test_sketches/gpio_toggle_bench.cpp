@@ -0,0 +1,185 @@
+#include <Arduino.h>
+#include <driver/gpio.h>
+#include "../hal/gpio_hal.cpp"
+
+// GPIO fast path test for ESP32-S3
+// Jumper GPIO10 to GPIO11. The sketch first checks Pin<N>, PinGroup and the
+// ISR dispatch table through the loopback, then compares toggle rates of the
+// Arduino call, the IDF call and the W1TS/W1TC fast path, and measures the
+// time from a set() to the edge timestamp taken in the ISR.
+// A scope on GPIO10 shows the toggle frequencies directly.
+
+#define LOOPBACK_OUT 10
+#define LOOPBACK_IN 11
+#define TOGGLES 100000
+#define LATENCY_RUNS 1000
+
+using Out = Pin<LOOPBACK_OUT>;
+using In = Pin<LOOPBACK_IN>;
+using Group = PinGroup<LOOPBACK_OUT, 12, 38>;   // Loopback pin plus two free pins
+
+struct EdgeLog {
+    volatile uint32_t count;
+    volatile uint32_t cycles;     // CPU cycle counter when the handler ran
+    volatile int64_t timeUs;
+    volatile uint8_t level;
+};
+
+EdgeLog edgeLog;
+int failures = 0;
+
+static void IRAM_ATTR onEdge(const GpioEdge& edge, void* context) {
+    EdgeLog* log = static_cast<EdgeLog*>(context);
+    log->cycles = ESP.getCycleCount();
+    log->timeUs = edge.timeUs;
+    log->level = edge.level;
+    log->count = log->count + 1;
+}
+
+void check(const char* name, bool ok) {
+    Serial.printf("  %-40s %s\n", name, ok ? "PASS" : "FAIL");
+    if (!ok) failures++;
+}
+
+void selfTest() {
+    Serial.println("Self test (GPIO10 -> GPIO11 loopback)");
+    Out::output();
+    In::input();
+
+    Out::set();
+    delayMicroseconds(1);
+    check("Pin<10>::set() reads back high", In::read());
+    Out::clear();
+    delayMicroseconds(1);
+    check("Pin<10>::clear() reads back low", !In::read());
+    Out::toggle();
+    delayMicroseconds(1);
+    check("Pin<10>::toggle() flips the latch", In::read());
+    Out::clear();
+
+    Group::output();
+    Group::write(0b001);
+    delayMicroseconds(1);
+    check("PinGroup::write() drives bit 0", In::read());
+    Group::write(0b110);
+    delayMicroseconds(1);
+    check("PinGroup::write() clears bit 0", !In::read());
+    Group::clear();
+
+    memset((void*)&edgeLog, 0, sizeof(edgeLog));
+    check("GpioIsr::attach() on GPIO11", GpioIsr::attach(LOOPBACK_IN, onEdge, &edgeLog, GPIO_INTR_POSEDGE));
+    int64_t before = esp_timer_get_time();
+    Out::set();
+    delayMicroseconds(20);
+    Out::clear();
+    delayMicroseconds(20);
+    check("ISR ran once per rising edge", edgeLog.count == 1 && GpioIsr::edgeCount(LOOPBACK_IN) == 1);
+    check("ISR saw the pin high", edgeLog.level == 1);
+    check("Edge timestamp follows the set()", edgeLog.timeUs >= before && edgeLog.timeUs - before < 20);
+    check("lastEdgeUs() matches the handler", GpioIsr::lastEdgeUs(LOOPBACK_IN) == edgeLog.timeUs);
+    GpioIsr::detach(LOOPBACK_IN);
+
+    Serial.printf("Self test: %s\n\n", failures == 0 ? "all passed" : "FAILED");
+}
+
+void report(const char* name, uint32_t cycles) {
+    float perPair = (float)cycles / TOGGLES;
+    float mhz = getCpuFrequencyMhz() / perPair;
+    Serial.printf("  %-28s %6.1f cycles per high+low  %6.2f MHz square wave\n", name, perPair, mhz);
+}
+
+void toggleBench() {
+    Serial.printf("Toggle rate at %lu MHz, %d pulses each\n", (unsigned long)getCpuFrequencyMhz(), TOGGLES);
+    Out::output();
+    uint32_t start;
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < TOGGLES; i++) {
+        digitalWrite(LOOPBACK_OUT, HIGH);
+        digitalWrite(LOOPBACK_OUT, LOW);
+    }
+    report("digitalWrite()", ESP.getCycleCount() - start);
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < TOGGLES; i++) {
+        gpio_set_level((gpio_num_t)LOOPBACK_OUT, 1);
+        gpio_set_level((gpio_num_t)LOOPBACK_OUT, 0);
+    }
+    report("gpio_set_level()", ESP.getCycleCount() - start);
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < TOGGLES; i++) {
+        Out::set();
+        Out::clear();
+    }
+    report("Pin<10>::set()/clear()", ESP.getCycleCount() - start);
+
+    Group::output();
+    start = ESP.getCycleCount();
+    for (int i = 0; i < TOGGLES; i++) {
+        Group::set();
+        Group::clear();
+    }
+    report("PinGroup<3 pins>::set/clear", ESP.getCycleCount() - start);
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < TOGGLES; i++) {
+        Group::write(0b101);
+        Group::write(0b010);
+    }
+    report("PinGroup<3 pins>::write()", ESP.getCycleCount() - start);
+    Group::clear();
+}
+
+void latencyBench() {
+    memset((void*)&edgeLog, 0, sizeof(edgeLog));
+    GpioIsr::attach(LOOPBACK_IN, onEdge, &edgeLog, GPIO_INTR_POSEDGE);
+
+    uint32_t minCycles = UINT32_MAX, maxCycles = 0;
+    uint64_t total = 0;
+    uint32_t missed = 0;
+    for (int i = 0; i < LATENCY_RUNS; i++) {
+        uint32_t count = edgeLog.count;
+        uint32_t start = ESP.getCycleCount();
+        Out::set();
+        while (edgeLog.count == count && ESP.getCycleCount() - start < 240000) {}
+        Out::clear();
+        if (edgeLog.count == count) {
+            missed++;
+            continue;
+        }
+        uint32_t cycles = edgeLog.cycles - start;
+        minCycles = min(minCycles, cycles);
+        maxCycles = max(maxCycles, cycles);
+        total += cycles;
+        delayMicroseconds(50);
+    }
+    GpioIsr::detach(LOOPBACK_IN);
+
+    uint32_t seen = LATENCY_RUNS - missed;
+    if (seen == 0) {
+        Serial.println("Edge to handler: no edges seen, check the GPIO10-GPIO11 jumper\n");
+        return;
+    }
+    float mhz = getCpuFrequencyMhz();
+    Serial.printf("Edge to handler over %lu edges: min %.2f us, avg %.2f us, max %.2f us, %lu missed\n\n",
+                  (unsigned long)seen, minCycles / mhz, (float)total / seen / mhz,
+                  maxCycles / mhz, (unsigned long)missed);
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(2000);
+
+    Serial.println();
+    Serial.println("================================");
+    Serial.println("ESP32-S3 GPIO Fast Path Test");
+    Serial.println("================================");
+    selfTest();
+}
+
+void loop() {
+    toggleBench();
+    latencyBench();
+    delay(5000);
+}
@@ -1,10 +1,10 @@
 #include <Arduino.h>
 #include <driver/i2s.h>
-#include "../config/pinmap.h"
+#include "../config/board_profile.h"
 
 // I2S Configuration
 #define I2S_PORT I2S_NUM_0
-#define SAMPLE_RATE 16000
+#define SAMPLE_RATE Board::Mic::SAMPLE_RATE
 #define SAMPLE_BITS 16
 #define BUFFER_SIZE 512
 
@@ -15,7 +15,7 @@ unsigned long lastDisplayTime = 0;
 const int displayInterval = 100; // Update interval in ms
 
 // Status LED (onboard)
-#define STATUS_LED 48
+#define STATUS_LED Board::StatusLed::PIN
 
 void setup() {
   // Initialize serial
@@ -38,9 +38,9 @@ void setup() {
   Serial.println("========================");
   
   Serial.printf("Configuring I2S...\n");
-  Serial.printf("- BCLK: GPIO%d\n", I2S_BCLK);
-  Serial.printf("- LRCK: GPIO%d\n", I2S_LRCK);
-  Serial.printf("- DIN: GPIO%d\n", I2S_DIN);
+  Serial.printf("- BCLK: GPIO%d\n", Board::Mic::BCLK);
+  Serial.printf("- LRCK: GPIO%d\n", Board::Mic::WS);
+  Serial.printf("- DIN: GPIO%d\n", Board::Mic::DIN);
   
   // Configure I2S for microphone input
   esp_err_t err;
@@ -62,10 +62,10 @@ void setup() {
   
   // I2S pin configuration
   i2s_pin_config_t pin_config = {
-    .bck_io_num = I2S_BCLK,
-    .ws_io_num = I2S_LRCK,
+    .bck_io_num = Board::Mic::BCLK,
+    .ws_io_num = Board::Mic::WS,
     .data_out_num = -1,  // Not using output
-    .data_in_num = I2S_DIN
+    .data_in_num = Board::Mic::DIN
   };
   
   // Initialize I2S with configs
@@ -0,0 +1,303 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "sha256.cpp"
+
+// Read-only asset pack: fonts, UI bitmaps and audio prompts in one blob that
+// is read where it lies, never copied to RAM. Plain C++ (no Arduino calls) so
+// the reader builds on the host; on the device the blob is the memory-mapped
+// "assets" partition (modules/asset_store.cpp). scripts/asset_pack.py builds
+// it from assets/assets.txt.
+//
+// Layout, little-endian, every section 4-byte aligned:
+//    0  "GAST"
+//    4  format (1), entry count (u16)
+//    8  schema: hash of the manifest's ids and types
+//   12  total size
+//   32  SHA-256 of everything after the 64-byte header
+//   64  entry table, one AssetEntry per id
+//       asset data: a per-type header, then the payload
+//
+// Ids are dense and fixed when the pack is built, so a lookup is table[id].
+// The packer also writes config/asset_ids.h with the ids and the schema;
+// open() refuses a pack built from another manifest, so an id never lands
+// on the wrong asset. open() also bounds-checks every entry once, which is
+// what lets the accessors below hand out pointers without further checks.
+//
+// Payloads:
+//   font:   AssetFontHeader, glyphs in Adafruit_GFX's GFXglyph layout, then
+//           the glyph bits (rows back to back, MSB first), so a GFXfont can
+//           point straight into the pack
+//   bitmap: AssetBitmapHeader, then rows padded to whole bytes, MSB first,
+//           as Adafruit_GFX::drawBitmap() takes them
+//   prompt: AssetPromptHeader, then 16-bit PCM, or IMA ADPCM blocks in
+//           AudioEncoder's block format
+enum AssetType : uint8_t {
+    ASSET_NONE = 0,
+    ASSET_FONT = 1,
+    ASSET_BITMAP = 2,
+    ASSET_PROMPT = 3
+};
+
+struct AssetEntry {
+    uint32_t offset;            // From the start of the pack
+    uint32_t size;              // Type header included
+    uint8_t type;
+    uint8_t reserved[3];
+};
+
+struct AssetFontHeader {
+    uint16_t first;             // First and last character code
+    uint16_t last;
+    uint8_t yAdvance;           // Line height
+    uint8_t ascent;             // Baseline below the top of a line
+    uint16_t glyphBytes;        // Size of the glyph bits
+};
+
+// Same layout as GFXglyph
+struct AssetGlyph {
+    uint16_t bitmapOffset;
+    uint8_t width;
+    uint8_t height;
+    uint8_t xAdvance;
+    int8_t xOffset;             // From the cursor to the glyph's left edge
+    int8_t yOffset;             // From the baseline to the glyph's top row
+    uint8_t reserved;
+};
+
+struct AssetBitmapHeader {
+    uint16_t width;
+    uint16_t height;
+};
+
+struct AssetPromptHeader {
+    uint16_t sampleRate;
+    uint8_t codec;              // AudioCodecMode: 0 PCM16, 1 IMA ADPCM
+    uint8_t reserved;
+    uint32_t samples;
+    uint16_t blockBytes;        // ADPCM: every block but the last
+    uint16_t blockSamples;
+};
+
+static_assert(sizeof(AssetEntry) == 12 && sizeof(AssetFontHeader) == 8 && sizeof(AssetGlyph) == 8 &&
+              sizeof(AssetBitmapHeader) == 4 && sizeof(AssetPromptHeader) == 12,
+              "asset pack structures are read in place and must match scripts/asset_pack.py");
+
+struct AssetFont {
+    const AssetFontHeader* header = nullptr;
+    const AssetGlyph* glyphs = nullptr;
+    const uint8_t* bits = nullptr;
+
+    explicit operator bool() const { return header != nullptr; }
+
+    const AssetGlyph* glyph(uint16_t code) const {
+        if (!header || code < header->first || code > header->last) return nullptr;
+        return &glyphs[code - header->first];
+    }
+};
+
+struct AssetBitmap {
+    uint16_t width = 0;
+    uint16_t height = 0;
+    const uint8_t* bits = nullptr;
+
+    explicit operator bool() const { return bits != nullptr; }
+
+    bool pixel(uint16_t x, uint16_t y) const {
+        return bits[y * ((width + 7) / 8) + x / 8] & (0x80 >> (x & 7));
+    }
+};
+
+struct AssetPrompt {
+    const AssetPromptHeader* header = nullptr;
+    const uint8_t* data = nullptr;
+    uint32_t bytes = 0;
+
+    explicit operator bool() const { return header != nullptr; }
+
+    uint32_t blocks() const {
+        return header ? (bytes + header->blockBytes - 1) / header->blockBytes : 0;
+    }
+
+    // One block as stored: PCM samples, or an ADPCM block for
+    // AudioEncoder::decodeAdpcm()
+    const uint8_t* block(uint32_t index, size_t& length) const {
+        uint32_t offset = index * header->blockBytes;
+        length = bytes - offset < header->blockBytes ? bytes - offset : header->blockBytes;
+        return data + offset;
+    }
+};
+
+enum AssetPackError : uint8_t {
+    ASSET_PACK_OK,
+    ASSET_PACK_BAD_HEADER,      // Not a pack, or cut short
+    ASSET_PACK_SCHEMA_MISMATCH, // Built from another manifest than this firmware
+    ASSET_PACK_BAD_ENTRY,       // An entry points outside the pack or is inconsistent
+    ASSET_PACK_HASH_MISMATCH
+};
+
+inline const char* assetPackErrorName(AssetPackError error) {
+    switch (error) {
+        case ASSET_PACK_OK: return "ok";
+        case ASSET_PACK_BAD_HEADER: return "bad header";
+        case ASSET_PACK_SCHEMA_MISMATCH: return "schema mismatch";
+        case ASSET_PACK_BAD_ENTRY: return "bad entry";
+        case ASSET_PACK_HASH_MISMATCH: return "hash mismatch";
+    }
+    return "unknown";
+}
+
+class AssetPack {
+public:
+    static const size_t HEADER_BYTES = 64;
+    static const uint16_t FORMAT = 1;
+
+    // Checks the pack at base; verify also hashes all of it
+    AssetPackError open(const uint8_t* base, size_t size, uint32_t schema, bool verify = true) {
+        close();
+        if (size < HEADER_BYTES || memcmp(base, "GAST", 4) != 0 || get16(base + 4) != FORMAT) {
+            return ASSET_PACK_BAD_HEADER;
+        }
+        uint16_t entries = get16(base + 6);
+        uint32_t total = get32(base + 12);
+        if (total > size || HEADER_BYTES + entries * sizeof(AssetEntry) > total) {
+            return ASSET_PACK_BAD_HEADER;
+        }
+        if (get32(base + 8) != schema) {
+            return ASSET_PACK_SCHEMA_MISMATCH;
+        }
+        const AssetEntry* entryTable = (const AssetEntry*)(base + HEADER_BYTES);
+        for (uint16_t id = 0; id < entries; id++) {
+            if (!entryValid(base, total, HEADER_BYTES + entries * sizeof(AssetEntry), entryTable[id])) {
+                return ASSET_PACK_BAD_ENTRY;
+            }
+        }
+        if (verify) {
+            uint8_t digest[Sha256::DIGEST_BYTES];
+            Sha256 hash;
+            hash.update(base + HEADER_BYTES, total - HEADER_BYTES);
+            hash.finish(digest);
+            if (memcmp(digest, base + 32, sizeof(digest)) != 0) {
+                return ASSET_PACK_HASH_MISMATCH;
+            }
+        }
+        this->base = base;
+        this->total = total;
+        table = entryTable;
+        count = entries;
+        return ASSET_PACK_OK;
+    }
+
+    void close() {
+        base = nullptr;
+        table = nullptr;
+        count = 0;
+        total = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    uint16_t size() const { return count; }
+    uint32_t bytes() const { return total; }
+
+    const AssetEntry* entry(uint16_t id) const {
+        return id < count && table[id].type != ASSET_NONE ? &table[id] : nullptr;
+    }
+
+    AssetFont font(uint16_t id) const {
+        AssetFont font;
+        const AssetEntry* e = typed(id, ASSET_FONT);
+        if (e) {
+            font.header = (const AssetFontHeader*)(base + e->offset);
+            font.glyphs = (const AssetGlyph*)(font.header + 1);
+            font.bits = (const uint8_t*)(font.glyphs + (font.header->last - font.header->first + 1));
+        }
+        return font;
+    }
+
+    AssetBitmap bitmap(uint16_t id) const {
+        AssetBitmap bitmap;
+        const AssetEntry* e = typed(id, ASSET_BITMAP);
+        if (e) {
+            const AssetBitmapHeader* header = (const AssetBitmapHeader*)(base + e->offset);
+            bitmap.width = header->width;
+            bitmap.height = header->height;
+            bitmap.bits = (const uint8_t*)(header + 1);
+        }
+        return bitmap;
+    }
+
+    AssetPrompt prompt(uint16_t id) const {
+        AssetPrompt prompt;
+        const AssetEntry* e = typed(id, ASSET_PROMPT);
+        if (e) {
+            prompt.header = (const AssetPromptHeader*)(base + e->offset);
+            prompt.data = (const uint8_t*)(prompt.header + 1);
+            prompt.bytes = e->size - sizeof(AssetPromptHeader);
+        }
+        return prompt;
+    }
+
+private:
+    const uint8_t* base = nullptr;
+    const AssetEntry* table = nullptr;
+    uint16_t count = 0;
+    uint32_t total = 0;
+
+    const AssetEntry* typed(uint16_t id, AssetType type) const {
+        const AssetEntry* e = entry(id);
+        return e && e->type == type ? e : nullptr;
+    }
+
+    static bool entryValid(const uint8_t* base, uint32_t total, uint32_t dataStart, const AssetEntry& e) {
+        if (e.type == ASSET_NONE) {
+            return true;
+        }
+        if (e.offset < dataStart || e.offset % 4 != 0 || e.offset > total || e.size > total - e.offset) {
+            return false;
+        }
+        const uint8_t* data = base + e.offset;
+        switch (e.type) {
+            case ASSET_FONT: {
+                if (e.size < sizeof(AssetFontHeader)) return false;
+                const AssetFontHeader* header = (const AssetFontHeader*)data;
+                if (header->last < header->first) return false;
+                size_t glyphTable = (size_t)(header->last - header->first + 1) * sizeof(AssetGlyph);
+                if (sizeof(AssetFontHeader) + glyphTable + header->glyphBytes > e.size) return false;
+                const AssetGlyph* glyphs = (const AssetGlyph*)(header + 1);
+                for (uint16_t i = 0; i <= header->last - header->first; i++) {
+                    if (glyphs[i].bitmapOffset + (glyphs[i].width * glyphs[i].height + 7) / 8 > header->glyphBytes) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case ASSET_BITMAP: {
+                if (e.size < sizeof(AssetBitmapHeader)) return false;
+                const AssetBitmapHeader* header = (const AssetBitmapHeader*)data;
+                return sizeof(AssetBitmapHeader) + (size_t)(header->width + 7) / 8 * header->height <= e.size;
+            }
+            case ASSET_PROMPT: {
+                if (e.size < sizeof(AssetPromptHeader)) return false;
+                const AssetPromptHeader* header = (const AssetPromptHeader*)data;
+                size_t payload = e.size - sizeof(AssetPromptHeader);
+                if (header->sampleRate == 0 || header->blockBytes == 0) return false;
+                if (header->codec == 0) return (size_t)header->samples * 2 == payload && header->blockBytes % 2 == 0;
+                return header->codec == 1 && header->blockBytes > 4;
+            }
+        }
+        return false;
+    }
+
+    static uint16_t get16(const uint8_t* in) {
+        return in[0] | (uint16_t)(in[1] << 8);
+    }
+
+    static uint32_t get32(const uint8_t* in) {
+        return in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+    }
+};
+
+#endif
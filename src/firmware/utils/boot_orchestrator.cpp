@@ -0,0 +1,233 @@
+#ifndef BOOT_ORCHESTRATOR_H
+#define BOOT_ORCHESTRATOR_H
+
+#include <Arduino.h>
+#include "logger.cpp"
+#include "metrics.cpp"
+
+// Dependency-ordered subsystem bring-up.
+//
+// Each step declares the steps it needs. run() starts every step whose
+// dependencies are done, in the order they were added, and returns once the
+// system is ready: all steps except background and deferred ones have
+// finished. A step with a poll function is asynchronous: start() only kicks
+// it off (Wi-Fi association, a queued I2C init) and poll() reports when it
+// has finished, so it overlaps with the steps started after it. Between polls
+// run() sleeps for POLL_MS, which lets the idle task and the Wi-Fi stack run.
+//
+// Background steps start as soon as their dependencies allow but the system
+// does not wait for them; deferred steps only start after ready, from
+// service() in the main loop. A failed step fails every step that depends
+// on it. Start and finish times are kept per step and logged as the boot
+// profile, once at ready and once when everything has finished.
+enum BootStatus : uint8_t {
+    BOOT_WAITING,
+    BOOT_RUNNING,
+    BOOT_DONE,
+    BOOT_FAILED
+};
+
+enum BootFlags : uint8_t {
+    BOOT_CRITICAL = 0,          // Ready waits for it
+    BOOT_BACKGROUND = 1,        // Starts right away, ready does not wait
+    BOOT_DEFERRED = 2           // Starts after ready
+};
+
+class BootOrchestrator {
+public:
+    typedef bool (*StartFn)();            // false: the step failed
+    typedef BootStatus (*PollFn)();       // RUNNING until DONE or FAILED
+
+    static const uint8_t MAX_STEPS = 16;
+    static const uint8_t INVALID_STEP = 31;     // From add() when the table is full
+    static const uint32_t POLL_MS = 1;
+    static_assert(MAX_STEPS <= INVALID_STEP, "Step ids are bits of a 32-bit needs mask");
+
+    struct Step {
+        const char* name;
+        StartFn start;
+        PollFn poll;
+        uint32_t needs;             // Bit i: step i must be done first
+        uint8_t flags;
+        BootStatus status;
+        uint32_t startMs;
+        uint32_t endMs;
+    };
+
+    // Returns the step id for other steps' needs, via after(). A step that
+    // does not fit is logged and dropped, and the boot counts as failed; its
+    // id is INVALID_STEP, which after() never confuses with a real step.
+    uint8_t add(const char* name, StartFn start, PollFn poll = nullptr, uint32_t needs = 0,
+                uint8_t flags = BOOT_CRITICAL) {
+        if (count >= MAX_STEPS) {
+            Logger::error("BOOT", String("Too many boot steps, ") + name + " dropped");
+            dropped = true;
+            return INVALID_STEP;
+        }
+        steps[count] = { name, start, poll, needs, flags, BOOT_WAITING, 0, 0 };
+        return count++;
+    }
+
+    static uint32_t after(uint8_t id) {
+        return 1u << (id < MAX_STEPS ? id : INVALID_STEP);
+    }
+
+    // Brings up everything the system needs; returns the time to ready in ms
+    uint32_t run() {
+        bootStartMs = millis();
+        while (!finished(false)) {
+            if (!advance(false)) {
+                delay(POLL_MS);
+            }
+        }
+        readyMs = millis() - bootStartMs;
+        ready = true;
+        Metrics::set(BOOT_READY_MS, readyMs);
+        logProfile("ready");
+        return readyMs;
+    }
+
+    // Called from loop(): polls background steps and starts deferred ones,
+    // one step start per call so the loop stays responsive
+    void service() {
+        if (!ready || complete) {
+            return;
+        }
+        advance(true);
+        if (finished(true)) {
+            complete = true;
+            completeMs = millis() - bootStartMs;
+            logProfile("complete");
+        }
+    }
+
+    bool isReady() const { return ready; }
+    bool isComplete() const { return complete; }
+    uint32_t getReadyMs() const { return readyMs; }
+    uint32_t getCompleteMs() const { return completeMs; }
+    uint8_t getStepCount() const { return count; }
+    const Step& getStep(uint8_t id) const { return steps[id]; }
+
+    BootStatus status(uint8_t id) const {
+        return id < count ? steps[id].status : BOOT_FAILED;
+    }
+
+    // Whether any of the given steps (after() bits, all by default) failed;
+    // a step dropped from a full table counts as failed
+    bool hasFailures(uint32_t mask = ~0u) const {
+        if (dropped && (mask & after(INVALID_STEP))) {
+            return true;
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            if ((mask & after(i)) && steps[i].status == BOOT_FAILED) return true;
+        }
+        return false;
+    }
+
+    // Whether all of the given steps have finished, done or failed
+    bool hasFinished(uint32_t mask) const {
+        for (uint8_t i = 0; i < count; i++) {
+            if ((mask & after(i)) && (steps[i].status == BOOT_WAITING || steps[i].status == BOOT_RUNNING)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    Step steps[MAX_STEPS];
+    uint8_t count = 0;
+    bool dropped = false;
+    uint32_t bootStartMs = 0;
+    uint32_t readyMs = 0;
+    uint32_t completeMs = 0;
+    bool ready = false;
+    bool complete = false;
+
+    // Starts and polls what it can; true when any step changed state
+    bool advance(bool afterReady) {
+        bool progressed = false;
+        for (uint8_t i = 0; i < count; i++) {
+            Step& step = steps[i];
+            if (step.status == BOOT_RUNNING) {
+                BootStatus polled = step.poll();
+                if (polled == BOOT_DONE || polled == BOOT_FAILED) {
+                    finish(step, polled);
+                    progressed = true;
+                }
+                continue;
+            }
+            if (step.status != BOOT_WAITING || ((step.flags & BOOT_DEFERRED) && !afterReady)) {
+                continue;
+            }
+            uint32_t failed = 0, done = 0;
+            for (uint8_t d = 0; d < count; d++) {
+                if (steps[d].status == BOOT_FAILED) failed |= after(d);
+                if (steps[d].status == BOOT_DONE) done |= after(d);
+            }
+            if (step.needs & failed) {
+                step.startMs = step.endMs = millis() - bootStartMs;
+                step.status = BOOT_FAILED;
+                Logger::error("BOOT", String(step.name) + " skipped, a dependency failed");
+                progressed = true;
+                continue;
+            }
+            if ((step.needs & done) != step.needs) {
+                continue;
+            }
+
+            step.startMs = millis() - bootStartMs;
+            step.status = BOOT_RUNNING;
+            bool started = step.start();
+            if (!started) {
+                finish(step, BOOT_FAILED);
+            } else if (step.poll == nullptr) {
+                finish(step, BOOT_DONE);
+            }
+            progressed = true;
+            if (afterReady && (step.flags & BOOT_DEFERRED)) {
+                break;
+            }
+        }
+        return progressed;
+    }
+
+    void finish(Step& step, BootStatus result) {
+        step.status = result;
+        step.endMs = millis() - bootStartMs;
+        if (result == BOOT_FAILED) {
+            Logger::error("BOOT", String(step.name) + " failed");
+        }
+    }
+
+    // Ready: every critical step has finished; all: every step has
+    bool finished(bool all) const {
+        for (uint8_t i = 0; i < count; i++) {
+            bool counts = all || steps[i].flags == BOOT_CRITICAL;
+            if (counts && (steps[i].status == BOOT_WAITING || steps[i].status == BOOT_RUNNING)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void logProfile(const char* milestone) {
+        uint32_t at = millis() - bootStartMs;
+        Logger::info("BOOT", String("Boot ") + milestone + " in " + String(at) + " ms");
+        for (uint8_t i = 0; i < count; i++) {
+            const Step& step = steps[i];
+            if (step.status == BOOT_WAITING) {
+                continue;
+            }
+            const char* state = step.status == BOOT_DONE ? "ok" : step.status == BOOT_FAILED ? "failed" : "running";
+            const char* kind = (step.flags & BOOT_DEFERRED) ? " deferred" : (step.flags & BOOT_BACKGROUND) ? " background" : "";
+            String line = String("  ") + step.name + ": " + String(step.startMs) + " ms";
+            if (step.status != BOOT_RUNNING) {
+                line += " +" + String(step.endMs - step.startMs) + " ms";
+            }
+            Logger::info("BOOT", line + " " + state + kind);
+        }
+    }
+};
+
+#endif
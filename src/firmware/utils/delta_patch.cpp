@@ -0,0 +1,172 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Streaming applier for binary deltas between firmware images.
+// Plain C++ (no Arduino calls) so the update engine builds on the host.
+//
+// A delta rebuilds the target image front to back from the base image (the
+// running firmware) and bytes carried in the delta. It is a list of
+// operations, each a LEB128 varint (length << 2 | op) and, for ADD and
+// INSERT, length data bytes:
+//   COPY    length bytes from the base at the cursor; the cursor moves on
+//   ADD     length bytes of base plus data, bytewise mod 256 (bsdiff's diff
+//           bytes: code that only moved keeps small, repetitive differences)
+//   INSERT  length bytes of data that have no counterpart in the base
+//   SEEK    moves the base cursor; the length is zigzag-encoded and signed
+// Operations and their data may be split across feed() calls anywhere, so
+// the applier holds no more than one block of base bytes at a time.
+enum DeltaOp : uint8_t {
+    DELTA_COPY = 0,
+    DELTA_ADD = 1,
+    DELTA_INSERT = 2,
+    DELTA_SEEK = 3
+};
+
+class DeltaPatcher {
+public:
+    // Reads length base bytes at offset; false on a flash error
+    typedef bool (*ReadFn)(void* context, uint32_t offset, uint8_t* out, size_t length);
+    // Takes the next target bytes; false aborts
+    typedef bool (*WriteFn)(void* context, const uint8_t* data, size_t length);
+
+    static const size_t BLOCK = 256;
+
+    void begin(ReadFn newRead, WriteFn newWrite, void* newContext, uint32_t newBaseSize) {
+        read = newRead;
+        write = newWrite;
+        context = newContext;
+        baseSize = newBaseSize;
+        cursor = 0;
+        written = 0;
+        remaining = 0;
+        op = DELTA_COPY;
+        varint = 0;
+        varintShift = 0;
+        failed = false;
+    }
+
+    // Applies the next length bytes of the delta; false once the delta was
+    // malformed, reached outside the base or the writer refused
+    bool feed(const uint8_t* data, size_t length) {
+        size_t i = 0;
+        while (i < length && !failed) {
+            if (remaining == 0) {
+                uint8_t byte = data[i++];
+                if (varintShift > 28) {
+                    return fail();
+                }
+                varint |= (uint32_t)(byte & 0x7F) << varintShift;
+                varintShift += 7;
+                if (byte & 0x80) {
+                    continue;
+                }
+                startOp(varint);
+                varint = 0;
+                varintShift = 0;
+                continue;
+            }
+
+            size_t run = length - i < remaining ? length - i : remaining;
+            if (op == DELTA_INSERT) {
+                if (!emit(data + i, run)) return fail();
+            } else {
+                if (!addBase(data + i, run)) return fail();
+            }
+            i += run;
+            remaining -= run;
+        }
+        return !failed;
+    }
+
+    // True between operations, where a complete delta ends
+    bool isIdle() const { return remaining == 0 && varintShift == 0 && !failed; }
+    uint32_t getWritten() const { return written; }
+
+private:
+    ReadFn read = nullptr;
+    WriteFn write = nullptr;
+    void* context = nullptr;
+    uint32_t baseSize = 0;
+    uint32_t cursor = 0;            // Base offset the next COPY or ADD reads
+    uint32_t written = 0;
+    uint32_t remaining = 0;         // Data bytes left in the current ADD / INSERT
+    DeltaOp op = DELTA_COPY;
+    uint32_t varint = 0;
+    uint8_t varintShift = 0;
+    bool failed = false;
+    uint8_t block[BLOCK];
+
+    void startOp(uint32_t header) {
+        op = (DeltaOp)(header & 3);
+        uint32_t length = header >> 2;
+        switch (op) {
+            case DELTA_COPY:
+                copyBase(length);
+                break;
+            case DELTA_SEEK: {
+                int32_t offset = (int32_t)(length >> 1) ^ -(int32_t)(length & 1);
+                int64_t target = (int64_t)cursor + offset;
+                if (target < 0 || target > baseSize) {
+                    fail();
+                } else {
+                    cursor = (uint32_t)target;
+                }
+                break;
+            }
+            case DELTA_ADD:
+                if ((uint64_t)cursor + length > baseSize) fail();
+                remaining = length;
+                break;
+            case DELTA_INSERT:
+                remaining = length;
+                break;
+        }
+    }
+
+    void copyBase(uint32_t length) {
+        if ((uint64_t)cursor + length > baseSize) {
+            fail();
+            return;
+        }
+        while (length > 0) {
+            size_t n = length < BLOCK ? length : BLOCK;
+            if (!read(context, cursor, block, n) || !emit(block, n)) {
+                fail();
+                return;
+            }
+            cursor += n;
+            length -= n;
+        }
+    }
+
+    bool addBase(const uint8_t* diff, size_t length) {
+        while (length > 0) {
+            size_t n = length < BLOCK ? length : BLOCK;
+            if (!read(context, cursor, block, n)) return false;
+            for (size_t k = 0; k < n; k++) {
+                block[k] += diff[k];
+            }
+            if (!emit(block, n)) return false;
+            cursor += n;
+            diff += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    bool emit(const uint8_t* data, size_t length) {
+        written += length;
+        return write(context, data, length);
+    }
+
+    bool fail() {
+        failed = true;
+        remaining = 0;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef HEATSHRINK_H
+#define HEATSHRINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Streaming decoder for the heatshrink LZSS bitstream, for firmware updates.
+// Plain C++ (no Arduino calls) so the update engine builds on the host.
+//
+// The stream is a sequence of items, most significant bit first:
+//   1, 8 bits                    literal byte
+//   0, windowBits, lookaheadBits back reference: distance - 1, length - 1
+// Back references reach into the last 2^windowBits bytes of output, which
+// starts as zeros; trailing bits that do not form a whole item are padding.
+// Input can arrive in pieces of any size: a partial item waits in the bit
+// buffer for the next decode() call, so the whole state is the window plus a
+// few words (4 KB at the largest window).
+class HeatshrinkDecoder {
+public:
+    // Receives decoded bytes in runs of up to OUTPUT_BYTES; false aborts
+    typedef bool (*SinkFn)(void* context, const uint8_t* data, size_t length);
+
+    static const uint8_t MIN_WINDOW_BITS = 4;
+    static const uint8_t MAX_WINDOW_BITS = 12;
+    static const size_t OUTPUT_BYTES = 256;
+
+    // The lookahead must be shorter than the window, as in heatshrink itself
+    bool configure(uint8_t newWindowBits, uint8_t newLookaheadBits) {
+        if (newWindowBits < MIN_WINDOW_BITS || newWindowBits > MAX_WINDOW_BITS ||
+            newLookaheadBits < 3 || newLookaheadBits >= newWindowBits) {
+            return false;
+        }
+        windowBits = newWindowBits;
+        lookaheadBits = newLookaheadBits;
+        reset();
+        return true;
+    }
+
+    void reset() {
+        memset(window, 0, sizeof(window));
+        head = 0;
+        bits = 0;
+        bitCount = 0;
+        literal = false;
+        tagRead = false;
+        produced = 0;
+    }
+
+    // Decodes length bytes of input; false when the sink refused output
+    bool decode(const uint8_t* in, size_t length, SinkFn sink, void* context) {
+        const uint32_t mask = (1u << windowBits) - 1;
+        const uint8_t refBits = windowBits + lookaheadBits;
+        size_t outCount = 0;
+
+        for (size_t i = 0; i < length; i++) {
+            bits = (bits << 8) | in[i];
+            bitCount += 8;
+
+            while (true) {
+                if (!tagRead) {
+                    if (bitCount < 1) break;
+                    literal = take(1) != 0;
+                    tagRead = true;
+                }
+                if (literal) {
+                    if (bitCount < 8) break;
+                    uint8_t value = (uint8_t)take(8);
+                    window[head++ & mask] = value;
+                    output[outCount++] = value;
+                    if (outCount == OUTPUT_BYTES && !flush(sink, context, outCount)) return false;
+                } else {
+                    if (bitCount < refBits) break;
+                    uint32_t distance = take(windowBits) + 1;
+                    uint32_t count = take(lookaheadBits) + 1;
+                    while (count--) {
+                        uint8_t value = window[(head - distance) & mask];
+                        window[head++ & mask] = value;
+                        output[outCount++] = value;
+                        if (outCount == OUTPUT_BYTES && !flush(sink, context, outCount)) return false;
+                    }
+                }
+                tagRead = false;
+            }
+        }
+        return outCount == 0 || flush(sink, context, outCount);
+    }
+
+    // Total bytes decoded since reset()
+    uint32_t getProduced() const { return produced; }
+
+private:
+    uint8_t window[1u << MAX_WINDOW_BITS];
+    uint8_t output[OUTPUT_BYTES];
+    uint8_t windowBits = 8;
+    uint8_t lookaheadBits = 4;
+    uint32_t head = 0;
+    uint32_t bits = 0;              // Unread input bits, the newest in the low end
+    uint8_t bitCount = 0;
+    bool literal = false;
+    bool tagRead = false;
+    uint32_t produced = 0;
+
+    uint32_t take(uint8_t count) {
+        bitCount -= count;
+        return (bits >> bitCount) & ((1u << count) - 1);
+    }
+
+    bool flush(SinkFn sink, void* context, size_t& count) {
+        produced += count;
+        bool accepted = sink(context, output, count);
+        count = 0;
+        return accepted;
+    }
+};
+
+#endif
@@ -3,6 +3,16 @@
 
 #include <Arduino.h>
 
+// Development builds wait briefly for a USB serial monitor so the boot log is
+// not lost; release builds (-DRELEASE_BUILD) never wait
+#ifndef LOGGER_SERIAL_WAIT_MS
+#ifdef RELEASE_BUILD
+#define LOGGER_SERIAL_WAIT_MS 0
+#else
+#define LOGGER_SERIAL_WAIT_MS 3000
+#endif
+#endif
+
 enum LogLevel {
     LOG_NONE = 0,
     LOG_ERROR,
@@ -17,7 +27,7 @@ public:
     static void init(LogLevel level = LOG_INFO, unsigned long baud = 115200) {
         currentLevel = level;
         Serial.begin(baud);
-        while (!Serial && millis() < 3000); // Wait for Serial up to 3 seconds
+        while (LOGGER_SERIAL_WAIT_MS > 0 && !Serial && millis() < LOGGER_SERIAL_WAIT_MS);
         Serial.println("[Logger] Initialized");
     }
     
@@ -0,0 +1,342 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Every metric is declared here once; ids, names and storage are generated
+// from this list at compile time. Histogram values are unitless integers,
+// the unit is part of the metric name.
+#define METRICS_COUNTERS(X) \
+    X(NET_REQUESTS,        "glasses_net_requests_total",               "HTTP requests sent to the server") \
+    X(NET_ERRORS,          "glasses_net_errors_total",                 "HTTP requests that failed") \
+    X(NET_BYTES_SENT,      "glasses_net_bytes_sent_total",             "Request payload bytes sent") \
+    X(NET_RECONNECTS,      "glasses_net_reconnects_total",             "WiFi reconnections after a drop") \
+    X(AUDIO_VAD_TRIGGERS,  "glasses_audio_vad_triggers_total",         "Voice activity detections") \
+    X(AUDIO_OVERRUNS,      "glasses_audio_overruns_total",             "I2S receive queue overflows") \
+    X(I2C_ERRORS,          "glasses_i2c_errors_total",                 "I2C transfers without an ACK or timed out") \
+    X(I2C_MERGED_WRITES,   "glasses_i2c_merged_writes_total",          "Queued I2C writes sent with the previous one") \
+    X(POWER_NORMAL_MS,     "glasses_power_mode_ms_total{mode=\"normal\"}",    "Time spent in each power mode") \
+    X(POWER_ECO_MS,        "glasses_power_mode_ms_total{mode=\"eco\"}",       "Time spent in each power mode") \
+    X(POWER_ULTRA_LOW_MS,  "glasses_power_mode_ms_total{mode=\"ultra_low\"}", "Time spent in each power mode") \
+    X(OTA_INSTALLS,        "glasses_ota_installs_total",               "Firmware updates written and set to boot") \
+    X(OTA_FAILURES,        "glasses_ota_failures_total",               "Firmware update downloads that were rejected") \
+    X(OTA_ROLLBACKS,       "glasses_ota_rollbacks_total",              "Updated images rolled back after a failed boot") \
+    X(PROMPTS_PLAYED,      "glasses_prompts_played_total",             "Earcons and status prompts started") \
+    X(PROMPTS_DROPPED,     "glasses_prompts_dropped_total",            "Prompts dropped for higher-priority ones") \
+    X(INTENTS_LOCAL,       "glasses_intents_local_total",              "Voice commands handled on the glasses") \
+    X(CACHE_HITS_RAM,      "glasses_response_cache_hits_total{tier=\"ram\"}", "Commands answered from the response cache") \
+    X(CACHE_HITS_FLASH,    "glasses_response_cache_hits_total{tier=\"flash\"}", "Commands answered from the response cache") \
+    X(CACHE_MISSES,        "glasses_response_cache_misses_total",      "Cacheable commands sent to the server") \
+    X(CACHE_INVALIDATIONS, "glasses_response_cache_invalidations_total", "Cached answers dropped at the server's request") \
+    X(VISION_UPLOADS,      "glasses_vision_uploads_total",             "Camera frames or regions sent to be described") \
+    X(VISION_SKIPPED,      "glasses_vision_skipped_total",             "Camera looks answered without an upload: scene unchanged") \
+    X(VISION_BYTES,        "glasses_vision_bytes_total",               "JPEG bytes uploaded") \
+    X(MUX_STREAMS,         "glasses_mux_streams_total",                "Requests sent as streams on the multiplexed connection") \
+    X(MUX_CANCELS,         "glasses_mux_cancels_total",                "Streams reset by the glasses after their timeout") \
+    X(TLS_FULL,            "glasses_tls_handshakes_total{kind=\"full\"}",    "TLS handshakes to the server") \
+    X(TLS_RESUMED,         "glasses_tls_handshakes_total{kind=\"resumed\"}", "TLS handshakes to the server") \
+    X(TLS_FAILURES,        "glasses_tls_handshake_failures_total",     "TLS handshakes that failed or timed out") \
+    X(WIFI_AWAKE_MS,       "glasses_wifi_awake_ms_total",              "Time the Wi-Fi modem was kept out of power save") \
+    X(WIFI_EARLY_WAKES,    "glasses_wifi_early_wakes_total",           "Modem wakes ahead of an upload, from candidate speech") \
+    X(WIFI_EARLY_WAKES_UNUSED, "glasses_wifi_early_wakes_unused_total", "Early wakes that no upload followed")
+
+#define METRICS_GAUGES(X) \
+    X(BATTERY_PERCENT,     "glasses_battery_percent",                  "Lowest battery level") \
+    X(WIFI_RSSI,           "glasses_wifi_rssi_dbm",                    "WiFi signal strength") \
+    X(NET_GOODPUT_KBPS,    "glasses_net_goodput_kbps",                 "Estimated audio upload goodput") \
+    X(NET_RTT_MS,          "glasses_net_rtt_ms",                       "Smoothed upload round trip") \
+    X(AUDIO_UPLOAD_KBPS,   "glasses_audio_upload_kbps",                "Bit rate of the planned audio upload format") \
+    X(BOOT_READY_MS,       "glasses_boot_ready_ms",                    "Time from setup() to ready on the last boot")
+
+#define METRICS_HISTOGRAMS(X) \
+    X(NET_LATENCY_MS,      "glasses_net_request_latency_ms",           "Server request round trip") \
+    X(DISPLAY_FLUSH_US,    "glasses_display_flush_us",                 "SSD1306 framebuffer flush time") \
+    X(I2C_DISPLAY_US,      "glasses_i2c_latency_us{peripheral=\"display\"}", "I2C transaction time from submit to completion") \
+    X(PROMPT_LATENCY_US,   "glasses_prompt_latency_us",                "Prompt trigger to its first sample at the amplifier") \
+    X(INTENT_MATCH_US,     "glasses_intent_match_us",                  "Intent matcher time for the block that decides") \
+    X(VISION_LATENCY_MS,   "glasses_vision_latency_ms",                "Camera look to scene description") \
+    X(TLS_FULL_MS,         "glasses_tls_handshake_ms{kind=\"full\"}",        "TLS handshake time, after the TCP connect") \
+    X(TLS_RESUMED_MS,      "glasses_tls_handshake_ms{kind=\"resumed\"}",     "TLS handshake time, after the TCP connect")
+
+#define METRIC_ENUM_ENTRY(id, name, help) id,
+
+enum CounterId : uint8_t { METRICS_COUNTERS(METRIC_ENUM_ENTRY) COUNTER_COUNT };
+enum GaugeId : uint8_t { METRICS_GAUGES(METRIC_ENUM_ENTRY) GAUGE_COUNT };
+enum HistogramId : uint8_t { METRICS_HISTOGRAMS(METRIC_ENUM_ENTRY) HISTOGRAM_COUNT };
+
+// Log-linear histogram: values below 2^SUB_BITS get exact buckets, above that
+// each power of two is split into 2^SUB_BITS linear buckets (<= 12.5% width).
+// The last bucket is open-ended: it starts at the top slice of 2^(MAX_EXP-1)
+// (15 * 2^20) and also takes everything of 2^MAX_EXP and above.
+struct Histogram {
+    static const uint8_t SUB_BITS = 3;
+    static const uint8_t SUB_BUCKETS = 1 << SUB_BITS;
+    static const uint8_t MAX_EXP = 24;
+    static const uint8_t BUCKETS = SUB_BUCKETS * (MAX_EXP - SUB_BITS + 1);
+
+    std::atomic<uint32_t> counts[BUCKETS];
+    std::atomic<uint32_t> total;
+    std::atomic<uint32_t> sum;
+
+    static uint8_t bucketFor(uint32_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        uint8_t exp = 31 - __builtin_clz(value);
+        if (exp >= MAX_EXP) {
+            return BUCKETS - 1;
+        }
+        uint8_t sub = (value >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1);
+        return (exp - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    // Smallest value that falls into the bucket
+    static uint32_t bucketLower(uint8_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        uint8_t exp = bucket / SUB_BUCKETS + SUB_BITS - 1;
+        uint32_t sub = bucket % SUB_BUCKETS;
+        return (uint32_t(SUB_BUCKETS) | sub) << (exp - SUB_BITS);
+    }
+
+    // Largest value that falls into the bucket (Prometheus "le" bound)
+    static uint32_t bucketUpper(uint8_t bucket) {
+        if (bucket == BUCKETS - 1) {
+            return UINT32_MAX;
+        }
+        return bucketLower(bucket + 1) - 1;
+    }
+
+    void observe(uint32_t value) {
+        counts[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Approximate quantile (0.0 - 1.0), returns the midpoint of the bucket
+    uint32_t quantile(float q) const {
+        uint32_t n = total.load(std::memory_order_relaxed);
+        if (n == 0) {
+            return 0;
+        }
+        uint32_t rank = (uint32_t)(q * (n - 1)) + 1;
+        uint32_t seen = 0;
+        for (uint8_t b = 0; b < BUCKETS; b++) {
+            seen += counts[b].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                uint32_t lower = bucketLower(b);
+                return lower + (bucketUpper(b) - lower) / 2;
+            }
+        }
+        return bucketLower(BUCKETS - 1);
+    }
+};
+
+class Metrics {
+public:
+    static void inc(CounterId id, uint32_t delta = 1) {
+        counters[id].fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    static uint32_t get(CounterId id) {
+        return counters[id].load(std::memory_order_relaxed);
+    }
+
+    static void set(GaugeId id, int32_t value) {
+        gauges[id].store(value, std::memory_order_relaxed);
+    }
+
+    static int32_t get(GaugeId id) {
+        return gauges[id].load(std::memory_order_relaxed);
+    }
+
+    static void observe(HistogramId id, uint32_t value) {
+        histograms[id].observe(value);
+    }
+
+    static const Histogram& histogram(HistogramId id) {
+        return histograms[id];
+    }
+
+    // Compact binary snapshot, decoded by scripts/metrics_decode.py.
+    // Layout: "GM" magic, version, payload length (u16 LE), payload, CRC-16/CCITT (BE).
+    // Payload: varint uptime ms, counter/gauge/histogram counts, counter values and
+    // zigzag gauges, then per histogram varint total and sum, a u8 non-empty bucket
+    // count and (u8 bucket index, varint count) pairs.
+    static size_t writeSnapshot(uint8_t* out, size_t capacity) {
+        if (capacity < SNAPSHOT_MAX_SIZE) {
+            return 0;
+        }
+
+        uint8_t* payload = out + 5;
+        size_t len = 0;
+
+        len += putVarint(payload + len, millis());
+        len += putVarint(payload + len, COUNTER_COUNT);
+        len += putVarint(payload + len, GAUGE_COUNT);
+        len += putVarint(payload + len, HISTOGRAM_COUNT);
+
+        for (uint8_t i = 0; i < COUNTER_COUNT; i++) {
+            len += putVarint(payload + len, counters[i].load(std::memory_order_relaxed));
+        }
+        for (uint8_t i = 0; i < GAUGE_COUNT; i++) {
+            int32_t v = gauges[i].load(std::memory_order_relaxed);
+            len += putVarint(payload + len, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+        }
+        for (uint8_t i = 0; i < HISTOGRAM_COUNT; i++) {
+            const Histogram& h = histograms[i];
+            len += putVarint(payload + len, h.total.load(std::memory_order_relaxed));
+            len += putVarint(payload + len, h.sum.load(std::memory_order_relaxed));
+
+            // Reserve the non-empty count byte, fill it after the pairs
+            uint8_t* nonEmpty = payload + len++;
+            *nonEmpty = 0;
+            for (uint8_t b = 0; b < Histogram::BUCKETS; b++) {
+                uint32_t c = h.counts[b].load(std::memory_order_relaxed);
+                if (c == 0) continue;
+                payload[len++] = b;
+                len += putVarint(payload + len, c);
+                (*nonEmpty)++;
+            }
+        }
+
+        out[0] = 'G';
+        out[1] = 'M';
+        out[2] = SNAPSHOT_VERSION;
+        out[3] = len & 0xFF;
+        out[4] = len >> 8;
+        uint16_t crc = crc16(payload, len);
+        out[5 + len] = crc >> 8;
+        out[6 + len] = crc & 0xFF;
+        return len + 7;
+    }
+
+    static void writeSnapshot(Print& out) {
+        static uint8_t buffer[SNAPSHOT_MAX_SIZE];
+        size_t len = writeSnapshot(buffer, sizeof(buffer));
+        out.write(buffer, len);
+    }
+
+    // Prometheus text exposition format
+    static String toPrometheus() {
+        String text;
+        text.reserve(1024);
+        char line[256];       // A histogram's +Inf, _sum and _count lines at once
+
+        for (uint8_t i = 0; i < COUNTER_COUNT; i++) {
+            appendHeader(text, counterNames[i], counterHelp[i], "counter");
+            snprintf(line, sizeof(line), "%s %lu\n", counterNames[i],
+                     (unsigned long)counters[i].load(std::memory_order_relaxed));
+            text += line;
+        }
+        for (uint8_t i = 0; i < GAUGE_COUNT; i++) {
+            appendHeader(text, gaugeNames[i], gaugeHelp[i], "gauge");
+            snprintf(line, sizeof(line), "%s %ld\n", gaugeNames[i],
+                     (long)gauges[i].load(std::memory_order_relaxed));
+            text += line;
+        }
+        for (uint8_t i = 0; i < HISTOGRAM_COUNT; i++) {
+            const Histogram& h = histograms[i];
+            const char* name = histogramNames[i];
+            appendHeader(text, name, histogramHelp[i], "histogram");
+
+            // The suffixes go on the family name and its labels join le:
+            // name_bucket{peripheral="display",le="10"}, name_sum{peripheral="display"}
+            const char* labels = strchr(name, '{');
+            int family = labels ? (int)(labels - name) : (int)strlen(name);
+            const char* inside = labels ? labels + 1 : "";
+            int inner = labels ? (int)strlen(inside) - 1 : 0;
+            const char* separator = inner > 0 ? "," : "";
+            if (labels == nullptr) {
+                labels = "";
+            }
+
+            uint32_t cumulative = 0;
+            for (uint8_t b = 0; b < Histogram::BUCKETS - 1; b++) {
+                uint32_t c = h.counts[b].load(std::memory_order_relaxed);
+                if (c == 0) continue;
+                cumulative += c;
+                snprintf(line, sizeof(line), "%.*s_bucket{%.*s%sle=\"%lu\"} %lu\n", family, name,
+                         inner, inside, separator,
+                         (unsigned long)Histogram::bucketUpper(b), (unsigned long)cumulative);
+                text += line;
+            }
+            uint32_t total = h.total.load(std::memory_order_relaxed);
+            snprintf(line, sizeof(line), "%.*s_bucket{%.*s%sle=\"+Inf\"} %lu\n%.*s_sum%s %lu\n%.*s_count%s %lu\n",
+                     family, name, inner, inside, separator, (unsigned long)total,
+                     family, name, labels, (unsigned long)h.sum.load(std::memory_order_relaxed),
+                     family, name, labels, (unsigned long)total);
+            text += line;
+        }
+        return text;
+    }
+
+private:
+    static const uint8_t SNAPSHOT_VERSION = 1;
+    static const size_t SNAPSHOT_MAX_SIZE =
+        7 + 20 + COUNTER_COUNT * 5 + GAUGE_COUNT * 5 + HISTOGRAM_COUNT * (11 + Histogram::BUCKETS * 6);
+
+    static std::atomic<uint32_t> counters[COUNTER_COUNT];
+    static std::atomic<int32_t> gauges[GAUGE_COUNT];
+    static Histogram histograms[HISTOGRAM_COUNT];
+
+    static const char* const counterNames[COUNTER_COUNT];
+    static const char* const counterHelp[COUNTER_COUNT];
+    static const char* const gaugeNames[GAUGE_COUNT];
+    static const char* const gaugeHelp[GAUGE_COUNT];
+    static const char* const histogramNames[HISTOGRAM_COUNT];
+    static const char* const histogramHelp[HISTOGRAM_COUNT];
+
+    static size_t putVarint(uint8_t* out, uint32_t value) {
+        size_t n = 0;
+        while (value >= 0x80) {
+            out[n++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        out[n++] = value;
+        return n;
+    }
+
+    static uint16_t crc16(const uint8_t* data, size_t len) {
+        uint16_t crc = 0xFFFF;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= (uint16_t)data[i] << 8;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    static void appendHeader(String& text, const char* name, const char* help, const char* type) {
+        // Labels are part of the name; HELP/TYPE use the bare family name
+        String family(name);
+        int brace = family.indexOf('{');
+        if (brace >= 0) {
+            family = family.substring(0, brace);
+        }
+        if (text.indexOf("# TYPE " + family + " ") >= 0) {
+            return;
+        }
+        text += "# HELP " + family + " " + help + "\n";
+        text += "# TYPE " + family + " " + type + "\n";
+    }
+};
+
+#define METRIC_NAME_ENTRY(id, name, help) name,
+#define METRIC_HELP_ENTRY(id, name, help) help,
+
+std::atomic<uint32_t> Metrics::counters[COUNTER_COUNT] = {};
+std::atomic<int32_t> Metrics::gauges[GAUGE_COUNT] = {};
+Histogram Metrics::histograms[HISTOGRAM_COUNT] = {};
+
+const char* const Metrics::counterNames[COUNTER_COUNT] = { METRICS_COUNTERS(METRIC_NAME_ENTRY) };
+const char* const Metrics::counterHelp[COUNTER_COUNT] = { METRICS_COUNTERS(METRIC_HELP_ENTRY) };
+const char* const Metrics::gaugeNames[GAUGE_COUNT] = { METRICS_GAUGES(METRIC_NAME_ENTRY) };
+const char* const Metrics::gaugeHelp[GAUGE_COUNT] = { METRICS_GAUGES(METRIC_HELP_ENTRY) };
+const char* const Metrics::histogramNames[HISTOGRAM_COUNT] = { METRICS_HISTOGRAMS(METRIC_NAME_ENTRY) };
+const char* const Metrics::histogramHelp[HISTOGRAM_COUNT] = { METRICS_HISTOGRAMS(METRIC_HELP_ENTRY) };
+
+#endif
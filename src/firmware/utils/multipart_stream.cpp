@@ -0,0 +1,93 @@
+#ifndef MULTIPART_STREAM_H
+#define MULTIPART_STREAM_H
+
+#include <Arduino.h>
+#include <string.h>
+
+// multipart/form-data body with one file part, read by HTTPClient's
+// sendRequest() a TCP segment at a time. The part's head and tail are a few
+// dozen bytes of text; the file itself is read where it lies (a JPEG in
+// PSRAM), so the body is never assembled in a second buffer. A boundary of
+// 23 characters turning up in a JPEG is not worth checking for.
+class MultipartStream : public Stream {
+public:
+    // field and filename end up in the part's Content-Disposition
+    MultipartStream(const char* field, const char* filename, const char* contentType,
+                    const uint8_t* data, size_t length)
+        : data(data), dataLength(length) {
+        static uint16_t count = 0;
+        snprintf(boundary, sizeof(boundary), "----glasses%08lx%04x", (unsigned long)micros(), count++);
+        headLength = snprintf(head, sizeof(head),
+                              "--%s\r\nContent-Disposition: form-data; name=\"%s\"; filename=\"%s\"\r\n"
+                              "Content-Type: %s\r\n\r\n", boundary, field, filename, contentType);
+        tailLength = snprintf(tail, sizeof(tail), "\r\n--%s--\r\n", boundary);
+    }
+
+    // For the request's Content-Type header
+    String contentType() const {
+        return String("multipart/form-data; boundary=") + boundary;
+    }
+
+    size_t size() const {
+        return headLength + dataLength + tailLength;
+    }
+
+    int available() override {
+        return size() - position;
+    }
+
+    int read() override {
+        char c;
+        return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+    }
+
+    int peek() override {
+        if (position >= size()) return -1;
+        return (uint8_t)byteAt(position);
+    }
+
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t copied = 0;
+        while (copied < length && position < size()) {
+            const uint8_t* source;
+            size_t left;
+            if (position < headLength) {
+                source = (const uint8_t*)head + position;
+                left = headLength - position;
+            } else if (position < headLength + dataLength) {
+                source = data + (position - headLength);
+                left = headLength + dataLength - position;
+            } else {
+                source = (const uint8_t*)tail + (position - headLength - dataLength);
+                left = size() - position;
+            }
+            size_t n = left < length - copied ? left : length - copied;
+            memcpy(buffer + copied, source, n);
+            copied += n;
+            position += n;
+        }
+        return copied;
+    }
+
+    size_t write(uint8_t c) override {
+        return 0;
+    }
+
+private:
+    const uint8_t* data;
+    size_t dataLength;
+    size_t position = 0;
+    char boundary[24];
+    char head[192];
+    size_t headLength;
+    char tail[36];
+    size_t tailLength;
+
+    char byteAt(size_t offset) const {
+        if (offset < headLength) return head[offset];
+        if (offset < headLength + dataLength) return (char)data[offset - headLength];
+        return tail[offset - headLength - dataLength];
+    }
+};
+
+#endif
@@ -0,0 +1,545 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Answers to questions the wearer asks again and again, kept on the glasses
+// so a repeat costs no sendCommand() round trip or server inference. Plain
+// C++ (no Arduino calls) so it builds on the host; the network module feeds
+// it the server's transcripts, answers and hints.
+//
+// Keys are the 64-bit FNV-1a hash of the normalized transcript: ASCII
+// lowercased, anything other than letters, digits and UTF-8 bytes taken as
+// a word break, the filler words in FILLERS dropped and the rest joined by
+// single spaces. scripts/standin_server.py computes the same keys.
+//
+// Two tiers:
+// - RAM: ENTRIES slots of up to MAX_TEXT bytes; a full cache evicts the
+//   least recently used entry
+// - flash, once attach()ed: a ring of RECORD_BYTES records in a raw
+//   partition. Entries evicted from RAM while still fresh are appended, and
+//   a hit there is copied back into RAM. The record index is rebuilt from
+//   the headers at attach, so the tier survives a restart.
+// Expiry times are seconds on the caller's clock; on the glasses that is the
+// server's wall clock, so flash entries keep their meaning across a restart.
+//
+// Flash record, little-endian:
+//    0  state: 0xFFFFFFFF erased, RECORD_LIVE, 0 dropped
+//    4  sequence number
+//    8  key
+//   16  expiry
+//   20  text length
+//   22  check: FNV-1a of bytes 4-21 and the text, folded to 16 bits
+//   24  text
+// The state is written last, so a record cut short by a reset is never
+// read; dropping one clears its state in place (flash bits go from 1 to 0
+// without an erase). A sector is erased when the ring comes back to it.
+enum CacheTier : uint8_t {
+    CACHE_MISS = 0,
+    CACHE_RAM,
+    CACHE_FLASH
+};
+
+// What the server said about keeping an answer
+struct CacheHint {
+    bool store;
+    uint32_t ttlS;
+};
+
+// Flash access for the spill tier, offsets from the start of its region
+struct CacheFlash {
+    typedef bool (*ReadFn)(void* context, uint32_t offset, void* data, size_t length);
+    typedef bool (*WriteFn)(void* context, uint32_t offset, const void* data, size_t length);
+    typedef bool (*EraseFn)(void* context, uint32_t offset, size_t length);
+
+    ReadFn read = nullptr;
+    WriteFn write = nullptr;
+    EraseFn erase = nullptr;
+    void* context = nullptr;
+    uint32_t size = 0;
+};
+
+static const uint64_t CACHE_FNV_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t CACHE_FNV_PRIME = 0x100000001b3ULL;
+
+inline uint64_t cacheFnv(uint64_t hash, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * CACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+// Key of a transcript; normalizes and hashes in one pass, nothing copied
+inline uint64_t cacheKey(const char* text, size_t length) {
+    static const char* const FILLERS[] = { "um", "uh", "please" };
+    uint64_t hash = CACHE_FNV_OFFSET;
+    bool first = true;
+    size_t i = 0;
+    while (i < length) {
+        // One word: letters, digits and UTF-8 bytes
+        size_t start = i;
+        while (i < length) {
+            uint8_t c = (uint8_t)text[i];
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80)) break;
+            i++;
+        }
+        size_t word = i - start;
+        if (word > 0) {
+            bool filler = false;
+            for (const char* f : FILLERS) {
+                size_t n = strlen(f);
+                if (n != word) continue;
+                size_t k = 0;
+                while (k < n && (text[start + k] | 0x20) == f[k]) k++;
+                filler = filler || k == n;
+            }
+            if (!filler) {
+                if (!first) {
+                    hash = (hash ^ ' ') * CACHE_FNV_PRIME;
+                }
+                for (size_t k = start; k < i; k++) {
+                    uint8_t c = (uint8_t)text[k];
+                    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+                    hash = (hash ^ c) * CACHE_FNV_PRIME;
+                }
+                first = false;
+            }
+        }
+        while (i < length) {
+            uint8_t c = (uint8_t)text[i];
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80) break;
+            i++;
+        }
+    }
+    return hash;
+}
+
+inline uint64_t cacheKey(const char* text) {
+    return cacheKey(text, strlen(text));
+}
+
+// Cache-Control: no-store or no-cache keep nothing, max-age sets the TTL,
+// anything else leaves defaultTtlS; the TTL never exceeds maxTtlS
+inline CacheHint parseCacheControl(const char* value, uint32_t defaultTtlS, uint32_t maxTtlS) {
+    CacheHint hint = { true, defaultTtlS };
+    const char* p = value;
+    while (p != nullptr && *p != '\0') {
+        while (*p == ' ' || *p == ',') p++;
+        const char* end = p;
+        while (*end != '\0' && *end != ',') end++;
+        size_t n = end - p;
+        while (n > 0 && p[n - 1] == ' ') n--;
+        if ((n == 8 && strncmp(p, "no-store", 8) == 0) || (n == 8 && strncmp(p, "no-cache", 8) == 0)) {
+            hint.store = false;
+        } else if (n > 8 && strncmp(p, "max-age=", 8) == 0) {
+            uint32_t ttl = 0;
+            for (size_t k = 8; k < n && p[k] >= '0' && p[k] <= '9'; k++) {
+                ttl = ttl > UINT32_MAX / 10 - 10 ? UINT32_MAX : ttl * 10 + (p[k] - '0');
+            }
+            hint.ttlS = ttl;
+        }
+        p = end;
+    }
+    if (hint.ttlS > maxTtlS) hint.ttlS = maxTtlS;
+    if (hint.ttlS == 0) hint.store = false;
+    return hint;
+}
+
+// Seconds since 1970 from an HTTP Date ("Sun, 06 Nov 1994 08:49:37 GMT");
+// 0 if it does not parse
+inline uint32_t parseHttpDate(const char* value) {
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    const char* p = strchr(value, ',');
+    if (p == nullptr) return 0;
+    p++;
+    int day = 0, year = 0, hour = 0, minute = 0, second = 0, month = -1;
+    auto number = [&p](int& out) {
+        while (*p == ' ') p++;
+        if (*p < '0' || *p > '9') return false;
+        out = 0;
+        while (*p >= '0' && *p <= '9') out = out * 10 + (*p++ - '0');
+        return true;
+    };
+    if (!number(day)) return 0;
+    while (*p == ' ') p++;
+    for (int m = 0; m < 12; m++) {
+        if (strncmp(p, MONTHS + 3 * m, 3) == 0) month = m;
+    }
+    if (month < 0) return 0;
+    p += 3;
+    if (!number(year) || !number(hour) || *p++ != ':' || !number(minute) || *p++ != ':' || !number(second)) return 0;
+    if (year < 1970 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) return 0;
+
+    // Days from the civil date, March-based years
+    int y = year - (month < 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int mp = (month + 10) % 12;
+    int doy = (153 * mp + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    return (uint32_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+}
+
+template <uint8_t ENTRIES = 32>
+class ResponseCache {
+public:
+    static const size_t MAX_TEXT = 192;             // Longer answers are not kept
+    static const size_t SECTOR_BYTES = 4096;
+    static const size_t RECORD_BYTES = 256;
+    static const size_t RECORD_HEADER = 24;
+    static const size_t MAX_RECORDS = 256;          // 64 KB of flash
+    static const uint32_t RECORD_LIVE = 0x31435247; // "GRC1"
+    static const uint16_t NO_SLOT = 0xFFFF;
+    static_assert(RECORD_HEADER + MAX_TEXT <= RECORD_BYTES, "Answer does not fit a flash record");
+
+    struct Stats {
+        uint32_t ramHits = 0;
+        uint32_t flashHits = 0;
+        uint32_t misses = 0;
+        uint32_t stores = 0;
+        uint32_t evictions = 0;         // Left RAM for good: stale, or nowhere to spill
+        uint32_t spills = 0;
+        uint32_t drops = 0;             // Invalidated
+        uint32_t flashBytesWritten = 0;
+        uint32_t sectorErases = 0;
+    };
+
+    ResponseCache() {
+        clearRam();
+    }
+
+    // Adds the flash tier and indexes what it already holds; false leaves
+    // the cache RAM-only
+    bool attach(const CacheFlash& newFlash) {
+        flash = CacheFlash();
+        records = 0;
+        size_t fit = newFlash.size / SECTOR_BYTES * (SECTOR_BYTES / RECORD_BYTES);
+        if (newFlash.read == nullptr || newFlash.write == nullptr || newFlash.erase == nullptr || fit == 0) {
+            return false;
+        }
+        flash = newFlash;
+        records = fit < MAX_RECORDS ? fit : MAX_RECORDS;
+        records -= records % (SECTOR_BYTES / RECORD_BYTES);
+
+        // Newest written record, live or dropped, sets the write position
+        uint32_t newest = 0;
+        bool any = false;
+        for (size_t slot = 0; slot < records; slot++) {
+            slotExpiry[slot] = 0;
+            uint8_t header[RECORD_HEADER];
+            uint8_t text[MAX_TEXT];
+            if (!flash.read(flash.context, slot * RECORD_BYTES, header, sizeof(header))) continue;
+            uint32_t state = get32(header);
+            uint16_t length = get16(header + 20);
+            if (state == 0xFFFFFFFF || length > MAX_TEXT ||
+                !flash.read(flash.context, slot * RECORD_BYTES + RECORD_HEADER, text, length) ||
+                check(header, text, length) != get16(header + 22)) {
+                continue;
+            }
+            uint32_t seq = get32(header + 4);
+            if (!any || (int32_t)(seq - newest) > 0) {
+                newest = seq;
+                writeSlot = (slot + 1) % records;
+                any = true;
+            }
+            if (state == RECORD_LIVE) {
+                slotKey[slot] = (uint32_t)get64(header + 8);
+                slotExpiry[slot] = get32(header + 16);
+            }
+        }
+        sequence = any ? newest + 1 : 0;
+        if (!any) {
+            writeSlot = 0;
+        }
+        // A record cut short by a reset leaves the next slot dirty; start
+        // on a fresh sector rather than write over it
+        if (writeSlot % PER_SECTOR != 0 && !slotErased(writeSlot)) {
+            writeSlot = (writeSlot / PER_SECTOR + 1) * PER_SECTOR % records;
+        }
+        return true;
+    }
+
+    bool hasFlash() const {
+        return records > 0;
+    }
+
+    // The answer for key, fresh at now, into out (NUL-terminated)
+    CacheTier lookup(uint64_t key, uint32_t now, char* out, size_t outSize) {
+        for (uint8_t i = 0; i < ENTRIES; i++) {
+            Entry& entry = entries[i];
+            if (entry.expiry == 0 || entry.key != key) continue;
+            if (entry.expiry <= now) {
+                entry.expiry = 0;
+                break;
+            }
+            entry.used = ++tick;
+            copyOut(entry.text, entry.length, out, outSize);
+            stats.ramHits++;
+            return CACHE_RAM;
+        }
+
+        uint16_t slot = findSlot(key, now);
+        if (slot != NO_SLOT) {
+            uint8_t header[RECORD_HEADER];
+            char text[MAX_TEXT];
+            uint16_t length = 0;
+            bool ok = flash.read(flash.context, slot * RECORD_BYTES, header, sizeof(header));
+            if (ok) {
+                length = get16(header + 20);
+                ok = get32(header) == RECORD_LIVE && get64(header + 8) == key && length <= MAX_TEXT &&
+                     flash.read(flash.context, slot * RECORD_BYTES + RECORD_HEADER, text, length) &&
+                     check(header, (const uint8_t*)text, length) == get16(header + 22);
+            }
+            if (ok) {
+                // Back into RAM; the record stays, so a later eviction need not rewrite it
+                Entry& entry = claim(now);
+                fill(entry, key, text, length, slotExpiry[slot], slot);
+                copyOut(text, length, out, outSize);
+                stats.flashHits++;
+                return CACHE_FLASH;
+            }
+            slotExpiry[slot] = 0;
+        }
+        stats.misses++;
+        return CACHE_MISS;
+    }
+
+    // Keeps an answer until expiry; false if it is too long or already stale
+    bool store(uint64_t key, const char* text, size_t length, uint32_t expiry, uint32_t now) {
+        if (length > MAX_TEXT || expiry <= now) {
+            return false;
+        }
+        // A new answer supersedes any kept one, in either tier
+        drop(key, false);
+        Entry& entry = claim(now);
+        fill(entry, key, text, length, expiry, NO_SLOT);
+        stats.stores++;
+        return true;
+    }
+
+    // Forgets key in both tiers; true if it was kept
+    bool drop(uint64_t key) {
+        return drop(key, true);
+    }
+
+    // Forgets everything, flash records included
+    void clear() {
+        clearRam();
+        for (size_t slot = 0; slot < records; slot++) {
+            if (slotExpiry[slot] != 0) {
+                killSlot(slot);
+            }
+        }
+    }
+
+    // The server's X-Cache-Invalidate value: "*", or keys as 16 hex digits
+    // separated by commas. Returns the entries dropped.
+    size_t invalidate(const char* value) {
+        size_t dropped = 0;
+        const char* p = value;
+        while (*p != '\0') {
+            while (*p == ' ' || *p == ',') p++;
+            if (*p == '*') {
+                size_t before = countKept();
+                clear();
+                stats.drops += before;
+                return dropped + before;
+            }
+            uint64_t key = 0;
+            size_t digits = 0;
+            for (; *p != '\0' && *p != ',' && *p != ' '; p++, digits++) {
+                char c = *p | 0x20;
+                int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+                if (v < 0) digits = 17;
+                key = key << 4 | (uint64_t)(v & 0xF);
+            }
+            if (digits == 16 && drop(key, true)) {
+                dropped++;
+            }
+        }
+        return dropped;
+    }
+
+    // Entries in RAM and records indexed in flash, fresh or not
+    size_t countKept() const {
+        size_t n = 0;
+        for (uint8_t i = 0; i < ENTRIES; i++) n += entries[i].expiry != 0;
+        for (size_t slot = 0; slot < records; slot++) n += slotExpiry[slot] != 0;
+        return n;
+    }
+
+    size_t getRecordCount() const { return records; }
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+private:
+    static const size_t PER_SECTOR = SECTOR_BYTES / RECORD_BYTES;
+
+    struct Entry {
+        uint64_t key;
+        uint32_t expiry;            // 0: free
+        uint32_t used;              // LRU tick
+        uint16_t length;
+        uint16_t slot;              // Flash copy, or NO_SLOT
+        char text[MAX_TEXT];
+    };
+
+    Entry entries[ENTRIES];
+    uint32_t tick = 0;
+    Stats stats;
+
+    CacheFlash flash;
+    size_t records = 0;
+    size_t writeSlot = 0;
+    uint32_t sequence = 0;
+    uint32_t slotKey[MAX_RECORDS];          // Low half of the key, checked in full on a read
+    uint32_t slotExpiry[MAX_RECORDS] = {};  // 0: nothing live in the slot
+
+    static uint16_t get16(const uint8_t* p) { return p[0] | p[1] << 8; }
+    static uint32_t get32(const uint8_t* p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+    static uint64_t get64(const uint8_t* p) { return get32(p) | (uint64_t)get32(p + 4) << 32; }
+    static void put16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    static void put32(uint8_t* p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+    static void put64(uint8_t* p, uint64_t v) { put32(p, v); put32(p + 4, v >> 32); }
+
+    static uint16_t check(const uint8_t* header, const uint8_t* text, size_t length) {
+        uint64_t hash = cacheFnv(cacheFnv(CACHE_FNV_OFFSET, header + 4, 18), text, length);
+        return (uint16_t)(hash ^ hash >> 16 ^ hash >> 32 ^ hash >> 48);
+    }
+
+    static void copyOut(const char* text, size_t length, char* out, size_t outSize) {
+        size_t n = length < outSize - 1 ? length : outSize - 1;
+        memcpy(out, text, n);
+        out[n] = '\0';
+    }
+
+    void clearRam() {
+        for (uint8_t i = 0; i < ENTRIES; i++) {
+            entries[i].expiry = 0;
+            entries[i].slot = NO_SLOT;
+        }
+    }
+
+    void fill(Entry& entry, uint64_t key, const char* text, size_t length, uint32_t expiry, uint16_t slot) {
+        entry.key = key;
+        entry.expiry = expiry;
+        entry.used = ++tick;
+        entry.length = length;
+        entry.slot = slot;
+        memcpy(entry.text, text, length);
+    }
+
+    // A free slot, or the least recently used one once its entry has
+    // spilled to flash (when fresh and not already there)
+    Entry& claim(uint32_t now) {
+        Entry* victim = &entries[0];
+        for (uint8_t i = 0; i < ENTRIES; i++) {
+            if (entries[i].expiry == 0) {
+                return entries[i];
+            }
+            if (entries[i].used < victim->used) victim = &entries[i];
+        }
+        if (victim->expiry > now && victim->slot == NO_SLOT && records > 0 && append(*victim)) {
+            stats.spills++;
+        } else if (victim->slot == NO_SLOT) {
+            stats.evictions++;
+        }
+        victim->expiry = 0;
+        return *victim;
+    }
+
+    bool drop(uint64_t key, bool count) {
+        bool kept = false;
+        for (uint8_t i = 0; i < ENTRIES; i++) {
+            if (entries[i].expiry != 0 && entries[i].key == key) {
+                entries[i].expiry = 0;
+                kept = true;
+            }
+        }
+        for (size_t slot = 0; slot < records; slot++) {
+            if (slotExpiry[slot] != 0 && slotKey[slot] == (uint32_t)key) {
+                uint8_t header[RECORD_HEADER];
+                if (flash.read(flash.context, slot * RECORD_BYTES, header, sizeof(header)) && get64(header + 8) == key) {
+                    killSlot(slot);
+                    kept = true;
+                }
+            }
+        }
+        if (kept && count) {
+            stats.drops++;
+        }
+        return kept;
+    }
+
+    uint16_t findSlot(uint64_t key, uint32_t now) const {
+        for (size_t slot = 0; slot < records; slot++) {
+            if (slotExpiry[slot] > now && slotKey[slot] == (uint32_t)key) {
+                return (uint16_t)slot;
+            }
+        }
+        return NO_SLOT;
+    }
+
+    bool slotErased(size_t slot) const {
+        uint8_t bytes[RECORD_BYTES];
+        if (!flash.read(flash.context, slot * RECORD_BYTES, bytes, sizeof(bytes))) return false;
+        for (uint8_t b : bytes) {
+            if (b != 0xFF) return false;
+        }
+        return true;
+    }
+
+    void killSlot(size_t slot) {
+        uint8_t zero[4] = {};
+        flash.write(flash.context, slot * RECORD_BYTES, zero, sizeof(zero));
+        stats.flashBytesWritten += sizeof(zero);
+        slotExpiry[slot] = 0;
+    }
+
+    bool append(Entry& entry) {
+        size_t slot = writeSlot;
+        if (slot % PER_SECTOR == 0) {
+            // The ring is back at this sector: its records go
+            if (!flash.erase(flash.context, slot * RECORD_BYTES, SECTOR_BYTES)) {
+                return false;
+            }
+            stats.sectorErases++;
+            for (size_t s = slot; s < slot + PER_SECTOR; s++) {
+                slotExpiry[s] = 0;
+            }
+            for (uint8_t i = 0; i < ENTRIES; i++) {
+                if (entries[i].slot != NO_SLOT && entries[i].slot / PER_SECTOR == slot / PER_SECTOR) {
+                    entries[i].slot = NO_SLOT;
+                }
+            }
+        }
+        writeSlot = (slot + 1) % records;
+
+        uint8_t record[RECORD_HEADER + MAX_TEXT];
+        put32(record, 0xFFFFFFFF);
+        put32(record + 4, sequence++);
+        put64(record + 8, entry.key);
+        put32(record + 16, entry.expiry);
+        put16(record + 20, entry.length);
+        memcpy(record + RECORD_HEADER, entry.text, entry.length);
+        put16(record + 22, check(record, record + RECORD_HEADER, entry.length));
+        uint32_t offset = slot * RECORD_BYTES;
+        size_t bodyBytes = RECORD_HEADER - 4 + entry.length;
+        uint8_t live[4];
+        put32(live, RECORD_LIVE);
+        if (!flash.write(flash.context, offset + 4, record + 4, bodyBytes) ||
+            !flash.write(flash.context, offset, live, sizeof(live))) {
+            return false;
+        }
+        stats.flashBytesWritten += bodyBytes + sizeof(live);
+        slotKey[slot] = (uint32_t)entry.key;
+        slotExpiry[slot] = entry.expiry;
+        entry.slot = (uint16_t)slot;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_idf_version.h>
+#include <mbedtls/sha256.h>
+
+// Incremental SHA-256 through mbedtls, which uses the SHA accelerator on the
+// ESP32-S3. IDF 5 ships mbedtls 3, where the *_ret functions lost the suffix.
+class Sha256 {
+public:
+    static const size_t DIGEST_BYTES = 32;
+
+    Sha256() {
+        mbedtls_sha256_init(&context);
+        begin();
+    }
+
+    ~Sha256() {
+        mbedtls_sha256_free(&context);
+    }
+
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    void begin() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        mbedtls_sha256_starts(&context, 0);
+#else
+        mbedtls_sha256_starts_ret(&context, 0);
+#endif
+    }
+
+    void update(const uint8_t* data, size_t length) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        mbedtls_sha256_update(&context, data, length);
+#else
+        mbedtls_sha256_update_ret(&context, data, length);
+#endif
+    }
+
+    void finish(uint8_t digest[DIGEST_BYTES]) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        mbedtls_sha256_finish(&context, digest);
+#else
+        mbedtls_sha256_finish_ret(&context, digest);
+#endif
+    }
+
+    // Lowercase hex into out, which holds DIGEST_BYTES * 2 + 1 characters
+    static void toHex(const uint8_t digest[DIGEST_BYTES], char* out) {
+        static const char DIGITS[] = "0123456789abcdef";
+        for (size_t i = 0; i < DIGEST_BYTES; i++) {
+            out[i * 2] = DIGITS[digest[i] >> 4];
+            out[i * 2 + 1] = DIGITS[digest[i] & 0x0F];
+        }
+        out[DIGEST_BYTES * 2] = '\0';
+    }
+
+private:
+    mbedtls_sha256_context context;
+};
+
+#endif
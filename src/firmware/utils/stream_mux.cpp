@@ -0,0 +1,726 @@
+#ifndef STREAM_MUX_H
+#define STREAM_MUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Logical streams over one connection to the server, so a command or a
+// cancel is not stuck behind an audio chunk or a camera frame. Plain C++
+// (no Arduino calls) so it builds on the host; it neither reads nor writes
+// a socket itself: receive() takes what arrived, poll() fills what may be
+// sent next. See modules/mux_client.cpp for the firmware's connection and
+// scripts/standin_server.py (GET /mux) for the server end.
+//
+// Each request is a stream: a HEADERS frame with its priority, method and
+// path (the HTTP request line and headers, as text), then DATA frames, the
+// last one flagged END. The reply comes back on the same stream the same
+// way, its HEADERS text starting with the status code.
+//
+// Frame, big-endian:
+//    0  type (MuxFrameType)
+//    1  flags: MUX_END on the last frame a side sends on a stream
+//    2  stream id: odd from the client, even from the server, 0 the connection
+//    4  payload length, at most MUX_MAX_PAYLOAD
+//    6  payload
+// HEADERS: priority, then text. DATA: bytes. CREDIT: 32-bit window
+// increment. RESET: reason (MuxReason). PING and PONG: 32-bit token.
+// GOAWAY: reason, after which the connection closes.
+//
+// Flow control: a side may send only as many DATA bytes on a stream as the
+// other has credited, MUX_STREAM_WINDOW to start with and CREDIT frames
+// after, and no more than MUX_CONNECTION_WINDOW across all streams. Data is
+// credited back once it is delivered (or consume()d, without autoCredit),
+// so a receiver that stops reading one stream stalls only that stream.
+//
+// Scheduling, each time poll() has room:
+// - RESET, PONG, PING and CREDIT frames first; a cancel overtakes all data
+// - the HEADERS of new streams, in the order opened, since the receiver
+//   takes a lower id than one it has seen for a stream already closed
+// - then the highest priority class with a stream that can send; within a
+//   class, the stream that has sent the fewest bytes (start-time fair
+//   queueing, so byte shares are even whatever the frame sizes)
+// - DATA frames carry at most maxFrameBytes: that is what a frame of higher
+//   priority can find in front of it, plus what the socket already holds
+// Lower classes send only while higher ones have nothing to send; the
+// glasses' interactive and bulk traffic comes in bursts, so background
+// streams are delayed, not starved.
+static const size_t MUX_HEADER_BYTES = 6;
+static const uint16_t MUX_MAX_PAYLOAD = 4096;
+static const uint32_t MUX_STREAM_WINDOW = 16384;
+static const uint32_t MUX_CONNECTION_WINDOW = 65536;
+static const uint8_t MUX_END = 0x01;
+
+enum MuxFrameType : uint8_t {
+    MUX_HEADERS = 1,
+    MUX_DATA,
+    MUX_CREDIT,
+    MUX_RESET,
+    MUX_PING,
+    MUX_PONG,
+    MUX_GOAWAY
+};
+
+enum MuxPriority : uint8_t {
+    MUX_INTERACTIVE = 0,    // Commands and their answers
+    MUX_BULK,               // Audio chunks, camera frames
+    MUX_BACKGROUND,         // Telemetry
+    MUX_PRIORITY_COUNT
+};
+
+enum MuxReason : uint8_t {
+    MUX_NO_ERROR = 0,
+    MUX_CANCEL,             // The sender no longer wants the stream
+    MUX_REFUSED,            // No stream slot free; the request was not processed
+    MUX_PROTOCOL_ERROR
+};
+
+// What receive() found: HEADERS and DATA carry the bytes (valid only during
+// the callback), RESET and GOAWAY the reason, PONG the token
+struct MuxEvent {
+    MuxFrameType type;
+    uint16_t stream;
+    uint8_t priority;
+    bool end;
+    const uint8_t* data;
+    size_t length;
+    uint32_t value;
+};
+
+// Runs inside receive(); may call write(), respond() and reset(), not receive()
+typedef void (*MuxCallback)(const MuxEvent& event, void* context);
+
+struct StreamMuxConfig {
+    bool client = true;                 // Opens odd streams; the server opens even ones
+    uint16_t maxFrameBytes = 1024;      // DATA payload; at most MUX_MAX_PAYLOAD
+    uint16_t sendBufferBytes = 8192;    // Queued per stream; write() takes less when full
+    bool autoCredit = true;             // Credit data on delivery; else on consume()
+};
+
+struct StreamMuxStats {
+    uint32_t streamsOpened = 0;         // By either side
+    uint32_t framesSent = 0;
+    uint32_t bytesSent = 0;             // Frames, headers included
+    uint32_t resetsSent = 0;
+    uint32_t resetsReceived = 0;
+    uint32_t creditStalls = 0;          // Polls where queued data waited for credit
+};
+
+class StreamMux {
+public:
+    static const uint8_t MAX_STREAMS = 8;
+
+    explicit StreamMux(const StreamMuxConfig& config = StreamMuxConfig()) : config(config) {
+        if (this->config.maxFrameBytes > MUX_MAX_PAYLOAD) this->config.maxFrameBytes = MUX_MAX_PAYLOAD;
+        reset();
+    }
+
+    ~StreamMux() {
+        for (Slot& slot : slots) release(slot);
+    }
+
+    StreamMux(const StreamMux&) = delete;
+    StreamMux& operator=(const StreamMux&) = delete;
+
+    void setCallback(MuxCallback callback, void* context) {
+        this->callback = callback;
+        callbackContext = context;
+    }
+
+    // Back to a fresh connection: every stream dropped
+    void reset() {
+        for (Slot& slot : slots) release(slot);
+        nextStream = config.client ? 1 : 2;
+        lastPeerStream = 0;
+        sendConnectionCredit = MUX_CONNECTION_WINDOW;
+        receiveConnectionWindow = MUX_CONNECTION_WINDOW;
+        connectionOwed = 0;
+        for (uint32_t& clock : classClock) clock = 0;
+        refusedCount = 0;
+        pongPending = false;
+        pingPending = false;
+        goawayPending = false;
+        goawayReason = MUX_NO_ERROR;
+        goneAway = false;
+        failed = false;
+        inboundFill = 0;
+        stats = StreamMuxStats();
+    }
+
+    // A new stream with the request head ("POST /audio\r\nName: value\r\n");
+    // its id, or -1 when no slot or id is left or the head is too long
+    int32_t open(MuxPriority priority, const char* head, size_t length) {
+        if (goneAway || failed || priority >= MUX_PRIORITY_COUNT || length + 1 > config.maxFrameBytes ||
+            nextStream > 0xFFFF - 2) {
+            return -1;
+        }
+        Slot* slot = allocate((uint16_t)nextStream, priority);
+        if (slot == nullptr) {
+            return -1;
+        }
+        nextStream += 2;
+        setHead(*slot, head, length);
+        return slot->id;
+    }
+
+    // The reply head ("200\r\nName: value\r\n") on a stream the peer opened
+    bool respond(uint16_t stream, const char* head, size_t length) {
+        Slot* slot = find(stream);
+        if (slot == nullptr || slot->headSent || slot->head != nullptr || length + 1 > config.maxFrameBytes) {
+            return false;
+        }
+        setHead(*slot, head, length);
+        return true;
+    }
+
+    // Queues up to length bytes; end closes this side once they are all
+    // taken. Returns the bytes taken, fewer when the send buffer is full.
+    size_t write(uint16_t stream, const uint8_t* data, size_t length, bool end) {
+        Slot* slot = find(stream);
+        if (slot == nullptr || slot->endQueued || slot->resetPending) {
+            return 0;
+        }
+        if (slot->queued == 0 && slot->head == nullptr) {
+            rejoin(*slot);
+        }
+        size_t taken = length < (size_t)(slot->capacity - slot->queued) ? length : slot->capacity - slot->queued;
+        for (size_t i = 0; i < taken;) {
+            size_t tail = (slot->start + slot->queued) % slot->capacity;
+            size_t run = slot->capacity - tail < taken - i ? slot->capacity - tail : taken - i;
+            memcpy(slot->buffer + tail, data + i, run);
+            slot->queued += run;
+            i += run;
+        }
+        if (taken == length && end) {
+            slot->endQueued = true;
+        }
+        return taken;
+    }
+
+    // Room left in the stream's send buffer
+    size_t writable(uint16_t stream) const {
+        const Slot* slot = find(stream);
+        if (slot == nullptr || slot->endQueued || slot->resetPending) return 0;
+        return slot->capacity - slot->queued;
+    }
+
+    // Bytes written and not yet sent
+    size_t queued(uint16_t stream) const {
+        const Slot* slot = find(stream);
+        return slot != nullptr ? slot->queued : 0;
+    }
+
+    bool isOpen(uint16_t stream) const {
+        const Slot* slot = find(stream);
+        return slot != nullptr && !slot->resetPending;
+    }
+
+    // Drops the stream and whatever of it is still queued; the RESET goes
+    // out ahead of all data
+    void reset(uint16_t stream, MuxReason reason = MUX_CANCEL) {
+        Slot* slot = find(stream);
+        if (slot == nullptr || slot->resetPending) {
+            return;
+        }
+        if (!slot->headSent && !peerStream(stream)) {
+            release(*slot);     // The peer never heard of it
+            return;
+        }
+        slot->resetPending = true;
+        slot->resetReason = reason;
+        slot->queued = 0;
+        delete[] slot->head;
+        slot->head = nullptr;
+    }
+
+    // Without autoCredit: the application has taken bytes of a stream's data
+    void consume(uint16_t stream, size_t bytes) {
+        Slot* slot = find(stream);
+        if (slot == nullptr) {
+            return;     // Its credit went back with the slot
+        }
+        if (bytes > slot->unconsumed) bytes = slot->unconsumed;
+        slot->unconsumed -= bytes;
+        if (!slot->receivedEnd) {
+            slot->owed += bytes;
+        }
+        connectionOwed += bytes;
+    }
+
+    void ping(uint32_t token) {
+        pingPending = true;
+        pingToken = token;
+    }
+
+    // Tells the peer the connection is ending; no new streams after this
+    void goAway(MuxReason reason = MUX_NO_ERROR) {
+        goawayPending = true;
+        goawayReason = reason;
+        goneAway = true;
+    }
+
+    // Next frames into out, whole frames only; returns the bytes filled
+    size_t poll(uint8_t* out, size_t capacity) {
+        size_t used = 0;
+        if (goawayPending && used + MUX_HEADER_BYTES + 1 <= capacity) {
+            uint8_t reason = goawayReason;
+            used += frame(out + used, MUX_GOAWAY, 0, 0, &reason, 1);
+            goawayPending = false;
+        }
+        if (failed) {
+            return used;
+        }
+        while (refusedCount > 0 && used + MUX_HEADER_BYTES + 1 <= capacity) {
+            uint8_t reason = MUX_REFUSED;
+            used += frame(out + used, MUX_RESET, 0, refused[--refusedCount], &reason, 1);
+            stats.resetsSent++;
+        }
+        for (Slot& slot : slots) {
+            if (slot.id != 0 && slot.resetPending && used + MUX_HEADER_BYTES + 1 <= capacity) {
+                uint8_t reason = slot.resetReason;
+                used += frame(out + used, MUX_RESET, 0, slot.id, &reason, 1);
+                stats.resetsSent++;
+                release(slot);
+            }
+        }
+        if (pongPending && used + MUX_HEADER_BYTES + 4 <= capacity) {
+            used += word(out + used, MUX_PONG, 0, pongToken);
+            pongPending = false;
+        }
+        if (pingPending && used + MUX_HEADER_BYTES + 4 <= capacity) {
+            used += word(out + used, MUX_PING, 0, pingToken);
+            pingPending = false;
+        }
+        if (connectionOwed >= MUX_CONNECTION_WINDOW / 4 && used + MUX_HEADER_BYTES + 4 <= capacity) {
+            used += word(out + used, MUX_CREDIT, 0, connectionOwed);
+            receiveConnectionWindow += connectionOwed;
+            connectionOwed = 0;
+        }
+        for (Slot& slot : slots) {
+            if (slot.id != 0 && slot.owed >= MUX_STREAM_WINDOW / 4 && used + MUX_HEADER_BYTES + 4 <= capacity) {
+                used += word(out + used, MUX_CREDIT, slot.id, slot.owed);
+                slot.receiveWindow += slot.owed;
+                slot.owed = 0;
+            }
+        }
+
+        // Our new streams' heads in the order they were opened: the peer
+        // takes an id below the last it saw for a stream already gone
+        Slot* head;
+        while ((head = nextHead()) != nullptr && used + MUX_HEADER_BYTES + head->headLength + 1 <= capacity) {
+            used += send(*head, out + used, capacity - used - MUX_HEADER_BYTES);
+        }
+
+        bool stalled = false;
+        while (used + MUX_HEADER_BYTES <= capacity) {
+            Slot* slot = next(stalled);
+            if (slot == nullptr) break;
+            size_t room = capacity - used - MUX_HEADER_BYTES;
+            size_t written = send(*slot, out + used, room);
+            if (written == 0) break;
+            used += written;
+        }
+        if (stalled) {
+            stats.creditStalls++;
+        }
+        stats.bytesSent += used;
+        return used;
+    }
+
+    // Bytes from the connection, any split. False once the peer broke the
+    // protocol: a GOAWAY is queued and the connection should be closed.
+    bool receive(const uint8_t* data, size_t length) {
+        while (length > 0 && !failed) {
+            size_t want = inboundFill < MUX_HEADER_BYTES ? MUX_HEADER_BYTES - inboundFill
+                                                          : MUX_HEADER_BYTES + inboundLength() - inboundFill;
+            size_t n = length < want ? length : want;
+            memcpy(inbound + inboundFill, data, n);
+            inboundFill += n;
+            data += n;
+            length -= n;
+            if (inboundFill == MUX_HEADER_BYTES && inboundLength() > MUX_MAX_PAYLOAD) {
+                fail();
+                break;
+            }
+            if (inboundFill >= MUX_HEADER_BYTES && inboundFill == MUX_HEADER_BYTES + inboundLength()) {
+                inboundFill = 0;
+                handle();
+            }
+        }
+        return !failed;
+    }
+
+    bool isFailed() const {
+        return failed;
+    }
+
+    // The peer sent GOAWAY, or goAway() was called
+    bool isGoingAway() const {
+        return goneAway;
+    }
+
+    uint8_t activeStreams() const {
+        uint8_t count = 0;
+        for (const Slot& slot : slots) count += slot.id != 0;
+        return count;
+    }
+
+    const StreamMuxStats& getStats() const {
+        return stats;
+    }
+
+private:
+    struct Slot {
+        uint16_t id = 0;                // 0: free
+        uint8_t priority = 0;
+        bool headSent = false;
+        bool endQueued = false;
+        bool endSent = false;
+        bool receivedEnd = false;
+        bool resetPending = false;
+        uint8_t resetReason = 0;
+        char* head = nullptr;           // HEADERS text waiting to go
+        uint16_t headLength = 0;
+        uint8_t* buffer = nullptr;      // Ring of queued DATA bytes
+        uint16_t capacity = 0;
+        uint16_t start = 0;
+        uint16_t queued = 0;
+        int64_t sendCredit = 0;
+        uint32_t receiveWindow = 0;
+        uint32_t owed = 0;              // Delivered, not yet credited back
+        uint32_t unconsumed = 0;        // Delivered, not yet consume()d
+        uint32_t served = 0;            // Fair-queueing tag: bytes sent, as of joining the class
+    };
+
+    StreamMuxConfig config;
+    MuxCallback callback = nullptr;
+    void* callbackContext = nullptr;
+    Slot slots[MAX_STREAMS];
+    uint32_t nextStream;
+    uint16_t lastPeerStream;
+    int64_t sendConnectionCredit;
+    uint32_t receiveConnectionWindow;
+    uint32_t connectionOwed;
+    uint32_t classClock[MUX_PRIORITY_COUNT];
+    uint16_t refused[4];
+    uint8_t refusedCount;
+    bool pongPending;
+    uint32_t pongToken = 0;
+    bool pingPending;
+    uint32_t pingToken = 0;
+    bool goawayPending;
+    uint8_t goawayReason;
+    bool goneAway;
+    bool failed;
+    uint8_t inbound[MUX_HEADER_BYTES + MUX_MAX_PAYLOAD];
+    size_t inboundFill;
+    StreamMuxStats stats;
+
+    Slot* find(uint16_t stream) {
+        if (stream == 0) return nullptr;
+        for (Slot& slot : slots) {
+            if (slot.id == stream) return &slot;
+        }
+        return nullptr;
+    }
+
+    const Slot* find(uint16_t stream) const {
+        return const_cast<StreamMux*>(this)->find(stream);
+    }
+
+    Slot* allocate(uint16_t stream, uint8_t priority) {
+        for (Slot& slot : slots) {
+            if (slot.id != 0) continue;
+            slot = Slot();
+            slot.buffer = new uint8_t[config.sendBufferBytes];
+            slot.capacity = config.sendBufferBytes;
+            slot.id = stream;
+            slot.priority = priority;
+            slot.sendCredit = MUX_STREAM_WINDOW;
+            slot.receiveWindow = MUX_STREAM_WINDOW;
+            rejoin(slot);
+            stats.streamsOpened++;
+            return &slot;
+        }
+        return nullptr;
+    }
+
+    // Whatever the application never consumed goes back to the connection
+    void release(Slot& slot) {
+        connectionOwed += slot.unconsumed;
+        delete[] slot.buffer;
+        delete[] slot.head;
+        slot = Slot();
+    }
+
+    // Both sides have ended the stream: nothing more can use the slot
+    void closeIfDone(Slot& slot) {
+        if (slot.endSent && slot.receivedEnd && slot.owed == 0) {
+            release(slot);
+        }
+    }
+
+    void setHead(Slot& slot, const char* head, size_t length) {
+        slot.head = new char[length > 0 ? length : 1];
+        memcpy(slot.head, head, length);
+        slot.headLength = (uint16_t)length;
+        rejoin(slot);
+    }
+
+    // A stream that had nothing to send starts level with its class, so
+    // idle time does not bank a burst
+    void rejoin(Slot& slot) {
+        uint32_t clock = classClock[slot.priority];
+        if ((int32_t)(slot.served - clock) < 0) {
+            slot.served = clock;
+        }
+    }
+
+    bool ready(const Slot& slot, bool& stalled) const {
+        if (slot.id == 0 || slot.resetPending || slot.endSent) return false;
+        if (slot.head != nullptr) return peerStream(slot.id);   // Ours go by nextHead()
+        if (!slot.headSent) return false;       // Peer's stream, reply head not given yet
+        if (slot.queued == 0) return slot.endQueued;
+        if (slot.sendCredit <= 0 || sendConnectionCredit <= 0) {
+            stalled = true;
+            return false;
+        }
+        return true;
+    }
+
+    // The stream to serve next: highest class, then fewest bytes served
+    Slot* next(bool& stalled) {
+        for (uint8_t priority = 0; priority < MUX_PRIORITY_COUNT; priority++) {
+            Slot* best = nullptr;
+            for (Slot& slot : slots) {
+                if (slot.priority != priority || !ready(slot, stalled)) continue;
+                if (best == nullptr || (int32_t)(slot.served - best->served) < 0) {
+                    best = &slot;
+                }
+            }
+            if (best != nullptr) {
+                classClock[priority] = best->served;
+                return best;
+            }
+        }
+        return nullptr;
+    }
+
+    Slot* nextHead() {
+        Slot* first = nullptr;
+        for (Slot& slot : slots) {
+            if (slot.id != 0 && slot.head != nullptr && !peerStream(slot.id) && (first == nullptr || slot.id < first->id)) {
+                first = &slot;
+            }
+        }
+        return first;
+    }
+
+    // One HEADERS or DATA frame of the stream into out, within room payload bytes
+    size_t send(Slot& slot, uint8_t* out, size_t room) {
+        if (slot.head != nullptr) {
+            if (room < (size_t)slot.headLength + 1) return 0;
+            bool end = slot.endQueued && slot.queued == 0;
+            uint8_t* payload = out + MUX_HEADER_BYTES;
+            payload[0] = slot.priority;
+            memcpy(payload + 1, slot.head, slot.headLength);
+            size_t written = frame(out, MUX_HEADERS, end ? MUX_END : 0, slot.id, nullptr, slot.headLength + 1);
+            slot.served += slot.headLength + 1;
+            delete[] slot.head;
+            slot.head = nullptr;
+            slot.headSent = true;
+            finishSend(slot, end);
+            return written;
+        }
+        size_t length = slot.queued;
+        if (length > config.maxFrameBytes) length = config.maxFrameBytes;
+        if ((int64_t)length > slot.sendCredit) length = slot.sendCredit;
+        if ((int64_t)length > sendConnectionCredit) length = sendConnectionCredit;
+        if (length > room) {
+            // Not worth a sliver; the frame waits for the next poll
+            if (room < 64) return 0;
+            length = room;
+        }
+        bool end = slot.endQueued && length == slot.queued;
+        uint8_t* payload = out + MUX_HEADER_BYTES;
+        size_t first = (size_t)(slot.capacity - slot.start) < length ? slot.capacity - slot.start : length;
+        memcpy(payload, slot.buffer + slot.start, first);
+        memcpy(payload + first, slot.buffer, length - first);
+        slot.start = (slot.start + length) % slot.capacity;
+        slot.queued -= length;
+        slot.sendCredit -= length;
+        sendConnectionCredit -= length;
+        slot.served += length;
+        size_t written = frame(out, MUX_DATA, end ? MUX_END : 0, slot.id, nullptr, length);
+        finishSend(slot, end);
+        return written;
+    }
+
+    void finishSend(Slot& slot, bool end) {
+        stats.framesSent++;
+        if (end) {
+            slot.endSent = true;
+            closeIfDone(slot);
+        }
+    }
+
+    // Writes a frame header (and payload, unless it is already in place)
+    static size_t frame(uint8_t* out, MuxFrameType type, uint8_t flags, uint16_t stream,
+                        const uint8_t* payload, size_t length) {
+        out[0] = type;
+        out[1] = flags;
+        out[2] = stream >> 8;
+        out[3] = stream & 0xFF;
+        out[4] = length >> 8;
+        out[5] = length & 0xFF;
+        if (payload != nullptr) {
+            memcpy(out + MUX_HEADER_BYTES, payload, length);
+        }
+        return MUX_HEADER_BYTES + length;
+    }
+
+    static size_t word(uint8_t* out, MuxFrameType type, uint16_t stream, uint32_t value) {
+        uint8_t payload[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+        return frame(out, type, 0, stream, payload, 4);
+    }
+
+    static uint32_t readWord(const uint8_t* p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    size_t inboundLength() const {
+        return (size_t)inbound[4] << 8 | inbound[5];
+    }
+
+    void fail() {
+        failed = true;
+        goAway(MUX_PROTOCOL_ERROR);
+    }
+
+    void emit(MuxFrameType type, uint16_t stream, uint8_t priority, bool end,
+              const uint8_t* data, size_t length, uint32_t value) {
+        if (callback == nullptr) return;
+        MuxEvent event = { type, stream, priority, end, data, length, value };
+        callback(event, callbackContext);
+    }
+
+    bool peerStream(uint16_t stream) const {
+        return (stream & 1) == (config.client ? 0 : 1);
+    }
+
+    void handle() {
+        MuxFrameType type = (MuxFrameType)inbound[0];
+        bool end = (inbound[1] & MUX_END) != 0;
+        uint16_t stream = (uint16_t)inbound[2] << 8 | inbound[3];
+        const uint8_t* payload = inbound + MUX_HEADER_BYTES;
+        size_t length = inboundLength();
+
+        switch (type) {
+            case MUX_HEADERS: {
+                if (stream == 0 || length < 1 || payload[0] >= MUX_PRIORITY_COUNT) {
+                    fail();
+                    return;
+                }
+                Slot* slot = find(stream);
+                if (slot == nullptr) {
+                    if (!peerStream(stream) || stream <= lastPeerStream) {
+                        return;     // A stream already closed or reset
+                    }
+                    lastPeerStream = stream;
+                    if (goneAway || (slot = allocate(stream, payload[0])) == nullptr) {
+                        if (refusedCount < sizeof(refused) / sizeof(refused[0])) {
+                            refused[refusedCount++] = stream;
+                        } else {
+                            fail();
+                        }
+                        return;
+                    }
+                } else if (slot->receivedEnd) {
+                    fail();
+                    return;
+                }
+                slot->receivedEnd = end;
+                emit(MUX_HEADERS, stream, payload[0], end, payload + 1, length - 1, 0);
+                if ((slot = find(stream)) != nullptr) closeIfDone(*slot);
+                return;
+            }
+            case MUX_DATA: {
+                if (stream == 0 || length > receiveConnectionWindow) {
+                    fail();
+                    return;
+                }
+                receiveConnectionWindow -= length;
+                Slot* slot = find(stream);
+                if (slot == nullptr || slot->resetPending) {
+                    connectionOwed += length;   // Reset under way: dropped, the window comes back
+                    return;
+                }
+                if (slot->receivedEnd || length > slot->receiveWindow) {
+                    fail();
+                    return;
+                }
+                slot->receiveWindow -= length;
+                slot->receivedEnd = end;
+                if (config.autoCredit) {
+                    if (!end) slot->owed += length;
+                    connectionOwed += length;
+                } else {
+                    slot->unconsumed += length;
+                }
+                emit(MUX_DATA, stream, slot->priority, end, payload, length, 0);
+                if ((slot = find(stream)) != nullptr) {
+                    if (slot->receivedEnd) slot->owed = 0;
+                    closeIfDone(*slot);
+                }
+                return;
+            }
+            case MUX_CREDIT: {
+                if (length != 4) {
+                    fail();
+                    return;
+                }
+                uint32_t increment = readWord(payload);
+                if (stream == 0) {
+                    sendConnectionCredit += increment;
+                    if (sendConnectionCredit > 0x7FFFFFFF) fail();
+                    return;
+                }
+                Slot* slot = find(stream);
+                if (slot != nullptr) {
+                    slot->sendCredit += increment;
+                    if (slot->sendCredit > 0x7FFFFFFF) fail();
+                }
+                return;
+            }
+            case MUX_RESET: {
+                Slot* slot = find(stream);
+                if (length != 1 || slot == nullptr) {
+                    return;
+                }
+                stats.resetsReceived++;
+                release(*slot);
+                emit(MUX_RESET, stream, 0, true, nullptr, 0, payload[0]);
+                return;
+            }
+            case MUX_PING:
+                if (length == 4) {
+                    pongPending = true;
+                    pongToken = readWord(payload);
+                }
+                return;
+            case MUX_PONG:
+                if (length == 4) {
+                    emit(MUX_PONG, 0, 0, false, nullptr, 0, readWord(payload));
+                }
+                return;
+            case MUX_GOAWAY:
+                goneAway = true;
+                emit(MUX_GOAWAY, 0, 0, true, nullptr, 0, length > 0 ? payload[0] : MUX_NO_ERROR);
+                return;
+            default:
+                return;     // Unknown frame types are ignored, for later additions
+        }
+    }
+};
+
+#endif
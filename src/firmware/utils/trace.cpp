@@ -0,0 +1,188 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Events kept per task before the oldest ones are overwritten
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 256
+#endif
+
+// Number of tasks that can record spans at the same time
+#ifndef TRACE_MAX_TASKS
+#define TRACE_MAX_TASKS 4
+#endif
+
+// Stages of the voice command pipeline, then of a vision request, kept apart
+// so neither skews the other's percentiles
+enum TraceStage : uint8_t {
+    TRACE_VAD,
+    TRACE_CAPTURE,
+    TRACE_ENCODE,
+    TRACE_UPLOAD,
+    TRACE_SERVER_WAIT,
+    TRACE_RENDER,
+    TRACE_PLAYBACK,
+    TRACE_CAM_CAPTURE,
+    TRACE_CAM_ENCODE,
+    TRACE_CAM_UPLOAD,
+    TRACE_STAGE_COUNT
+};
+
+struct TraceEvent {
+    uint32_t startUs;         // esp_timer_get_time() when the span opened, low 32 bits
+    uint32_t durationUs;      // Wall time inside the span
+    uint8_t stage;
+};
+
+// Single-producer ring owned by one task; only the owner writes events
+struct TraceRing {
+    std::atomic<TaskHandle_t> owner;
+    std::atomic<uint32_t> head;
+    TraceEvent events[TRACE_RING_SIZE];
+};
+
+class Tracer {
+public:
+    static const char* stageName(uint8_t stage) {
+        static const char* const names[TRACE_STAGE_COUNT] = {
+            "vad", "capture", "encode", "upload", "server_wait", "render", "playback",
+            "cam_capture", "cam_encode", "cam_upload"
+        };
+        return stage < TRACE_STAGE_COUNT ? names[stage] : "unknown";
+    }
+
+    static void record(uint8_t stage, uint32_t startUs, uint32_t durationUs) {
+        TraceRing* ring = ringForCurrentTask();
+        if (ring == nullptr) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        uint32_t index = ring->head.load(std::memory_order_relaxed);
+        TraceEvent& event = ring->events[index % TRACE_RING_SIZE];
+        event.startUs = startUs;
+        event.durationUs = durationUs;
+        event.stage = stage;
+        ring->head.store(index + 1, std::memory_order_release);
+    }
+
+    static void clear() {
+        for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+            rings[i].head.store(0, std::memory_order_release);
+        }
+        dropped.store(0, std::memory_order_relaxed);
+    }
+
+    // Write all buffered spans as Chrome trace-event JSON (chrome://tracing, Perfetto).
+    // The output is framed by TRACE_BEGIN / TRACE_END lines so scripts/trace_stats.py
+    // can pick it out of a serial log.
+    static void exportChromeJson(Print& out) {
+        out.println("TRACE_BEGIN");
+        out.print("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":");
+        out.print(dropped.load(std::memory_order_relaxed));
+        out.print("},\"traceEvents\":[");
+
+        bool first = true;
+        for (int tid = 0; tid < TRACE_MAX_TASKS; tid++) {
+            TraceRing& ring = rings[tid];
+            TaskHandle_t owner = ring.owner.load(std::memory_order_acquire);
+            if (owner == nullptr) {
+                continue;
+            }
+
+            if (!first) out.print(",");
+            first = false;
+            out.printf("\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                       tid, pcTaskGetName(owner));
+
+            uint32_t head = ring.head.load(std::memory_order_acquire);
+            uint32_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+            for (uint32_t i = head - count; i != head; i++) {
+                const TraceEvent& event = ring.events[i % TRACE_RING_SIZE];
+                out.printf(",\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lu,\"dur\":%lu}",
+                           stageName(event.stage), tid,
+                           (unsigned long)event.startUs,
+                           (unsigned long)event.durationUs);
+            }
+        }
+
+        out.println("\n]}");
+        out.println("TRACE_END");
+    }
+
+    // Copy out the buffered spans, oldest first within each task; returns the count.
+    // Lets the host simulator build its latency report without parsing JSON.
+    static size_t readEvents(TraceEvent* out, size_t capacity) {
+        size_t copied = 0;
+        for (int tid = 0; tid < TRACE_MAX_TASKS; tid++) {
+            TraceRing& ring = rings[tid];
+            if (ring.owner.load(std::memory_order_acquire) == nullptr) {
+                continue;
+            }
+            uint32_t head = ring.head.load(std::memory_order_acquire);
+            uint32_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+            for (uint32_t i = head - count; i != head && copied < capacity; i++) {
+                out[copied++] = ring.events[i % TRACE_RING_SIZE];
+            }
+        }
+        return copied;
+    }
+
+private:
+    static TraceRing rings[TRACE_MAX_TASKS];
+    static std::atomic<uint32_t> dropped;
+
+    static TraceRing* ringForCurrentTask() {
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+        for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+            if (rings[i].owner.load(std::memory_order_acquire) == self) {
+                return &rings[i];
+            }
+        }
+
+        // First span from this task: claim a free ring
+        for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+            TaskHandle_t expected = nullptr;
+            if (rings[i].owner.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+                return &rings[i];
+            }
+        }
+        return nullptr;
+    }
+};
+
+TraceRing Tracer::rings[TRACE_MAX_TASKS] = {};
+std::atomic<uint32_t> Tracer::dropped(0);
+
+// RAII span: measures the enclosing scope with esp_timer. Spans such as VAD
+// and capture block without a PM lock, so DFS changes the clock and light
+// sleep stops the cycle counter while they are open; the timer runs through
+// both.
+class TraceSpan {
+public:
+    explicit TraceSpan(uint8_t stage)
+        : stage(stage), startUs(esp_timer_get_time()) {}
+
+    ~TraceSpan() {
+        Tracer::record(stage, (uint32_t)startUs, (uint32_t)(esp_timer_get_time() - startUs));
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    uint8_t stage;
+    int64_t startUs;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(stage) TraceSpan TRACE_CONCAT(_traceSpan, __LINE__)(stage)
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef UPDATE_STREAM_H
+#define UPDATE_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "heatshrink.cpp"
+#include "delta_patch.cpp"
+#include "sha256.cpp"
+
+// Firmware update package and the pipeline that turns it into an image.
+// Plain C++ (no Arduino calls) so the update engine builds on the host.
+//
+// A package is a fixed header followed by the payload: the new image, or a
+// delta against the running one (delta_patch.cpp), optionally heatshrink-
+// compressed (heatshrink.cpp). Header, little-endian:
+//    0  "GOTA"
+//    4  format (1)
+//    5  flags: UPDATE_DELTA, UPDATE_COMPRESSED
+//    6  heatshrink window bits, lookahead bits
+//    8  target image size
+//   12  base image size (delta only)
+//   16  payload size
+//   20  target image SHA-256
+//   52  base image SHA-256 (delta only)
+//   84  version string, NUL-padded to 16 bytes
+//
+// UpdateStream takes the payload in pieces as it downloads and passes the
+// rebuilt image to the writer in order, hashing it on the way; finish()
+// accepts it only if size and SHA-256 match the header. Nothing is buffered
+// beyond the decoder's window and one block of base bytes.
+enum UpdateFlags : uint8_t {
+    UPDATE_DELTA = 0x01,
+    UPDATE_COMPRESSED = 0x02
+};
+
+struct UpdateHeader {
+    static const size_t BYTES = 100;
+    static const uint8_t FORMAT = 1;
+    static const size_t VERSION_BYTES = 16;
+
+    uint8_t flags = 0;
+    uint8_t windowBits = 0;
+    uint8_t lookaheadBits = 0;
+    uint32_t targetSize = 0;
+    uint32_t baseSize = 0;
+    uint32_t payloadSize = 0;
+    uint8_t targetSha256[Sha256::DIGEST_BYTES] = {};
+    uint8_t baseSha256[Sha256::DIGEST_BYTES] = {};
+    char version[VERSION_BYTES + 1] = {};
+
+    bool isDelta() const { return flags & UPDATE_DELTA; }
+    bool isCompressed() const { return flags & UPDATE_COMPRESSED; }
+
+    bool parse(const uint8_t* in) {
+        if (memcmp(in, "GOTA", 4) != 0 || in[4] != FORMAT) {
+            return false;
+        }
+        flags = in[5];
+        windowBits = in[6];
+        lookaheadBits = in[7];
+        targetSize = get32(in + 8);
+        baseSize = get32(in + 12);
+        payloadSize = get32(in + 16);
+        memcpy(targetSha256, in + 20, Sha256::DIGEST_BYTES);
+        memcpy(baseSha256, in + 52, Sha256::DIGEST_BYTES);
+        memcpy(version, in + 84, VERSION_BYTES);
+        version[VERSION_BYTES] = '\0';
+        return (flags & ~(UPDATE_DELTA | UPDATE_COMPRESSED)) == 0;
+    }
+
+    void serialize(uint8_t* out) const {
+        memset(out, 0, BYTES);
+        memcpy(out, "GOTA", 4);
+        out[4] = FORMAT;
+        out[5] = flags;
+        out[6] = windowBits;
+        out[7] = lookaheadBits;
+        put32(out + 8, targetSize);
+        put32(out + 12, baseSize);
+        put32(out + 16, payloadSize);
+        memcpy(out + 20, targetSha256, Sha256::DIGEST_BYTES);
+        memcpy(out + 52, baseSha256, Sha256::DIGEST_BYTES);
+        size_t length = strlen(version);
+        memcpy(out + 84, version, length < VERSION_BYTES ? length : VERSION_BYTES);
+    }
+
+private:
+    static uint32_t get32(const uint8_t* in) {
+        return in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+    }
+
+    static void put32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) out[i] = (uint8_t)(value >> (8 * i));
+    }
+};
+
+enum UpdateError : uint8_t {
+    UPDATE_OK,
+    UPDATE_BAD_HEADER,          // Unknown format or decoder parameters
+    UPDATE_CORRUPT,             // Payload longer than declared or a malformed delta
+    UPDATE_WRITE_FAILED,        // The writer or a base read failed
+    UPDATE_TRUNCATED,           // finish() before the whole payload arrived
+    UPDATE_SIZE_MISMATCH,       // The image came out longer or shorter than declared
+    UPDATE_HASH_MISMATCH
+};
+
+inline const char* updateErrorName(UpdateError error) {
+    switch (error) {
+        case UPDATE_OK: return "ok";
+        case UPDATE_BAD_HEADER: return "bad header";
+        case UPDATE_CORRUPT: return "corrupt payload";
+        case UPDATE_WRITE_FAILED: return "write failed";
+        case UPDATE_TRUNCATED: return "truncated";
+        case UPDATE_SIZE_MISMATCH: return "size mismatch";
+        case UPDATE_HASH_MISMATCH: return "hash mismatch";
+    }
+    return "unknown";
+}
+
+class UpdateStream {
+public:
+    typedef DeltaPatcher::ReadFn ReadFn;
+    typedef DeltaPatcher::WriteFn WriteFn;
+
+    // readBase is only used by deltas and may be null for full images
+    bool begin(const UpdateHeader& newHeader, ReadFn newReadBase, WriteFn newWriteTarget, void* newContext) {
+        header = newHeader;
+        readBase = newReadBase;
+        writeTarget = newWriteTarget;
+        context = newContext;
+        consumed = 0;
+        written = 0;
+        error = UPDATE_OK;
+        hash.begin();
+
+        if (header.isCompressed() && !decoder.configure(header.windowBits, header.lookaheadBits)) {
+            error = UPDATE_BAD_HEADER;
+        }
+        if (header.isDelta()) {
+            if (readBase == nullptr) {
+                error = UPDATE_BAD_HEADER;
+            }
+            patcher.begin(readFromBase, emit, this, header.baseSize);
+        }
+        return error == UPDATE_OK;
+    }
+
+    // The next length payload bytes as they arrive
+    bool write(const uint8_t* data, size_t length) {
+        if (error != UPDATE_OK) {
+            return false;
+        }
+        if ((uint64_t)consumed + length > header.payloadSize) {
+            return setError(UPDATE_CORRUPT);
+        }
+        consumed += length;
+        bool ok = header.isCompressed() ? decoder.decode(data, length, decoded, this)
+                                        : decoded(this, data, length);
+        // Writer and base read failures set their own error; anything else is a bad delta
+        if (!ok && error == UPDATE_OK) {
+            setError(UPDATE_CORRUPT);
+        }
+        return error == UPDATE_OK;
+    }
+
+    // Once the payload is in: true only for the complete image with the right hash
+    bool finish() {
+        if (error != UPDATE_OK) {
+            return false;
+        }
+        if (consumed < header.payloadSize) {
+            return setError(UPDATE_TRUNCATED);
+        }
+        if ((header.isDelta() && !patcher.isIdle()) || written != header.targetSize) {
+            return setError(UPDATE_SIZE_MISMATCH);
+        }
+        uint8_t digest[Sha256::DIGEST_BYTES];
+        hash.finish(digest);
+        if (memcmp(digest, header.targetSha256, sizeof(digest)) != 0) {
+            return setError(UPDATE_HASH_MISMATCH);
+        }
+        return true;
+    }
+
+    UpdateError getError() const { return error; }
+    uint32_t getConsumed() const { return consumed; }
+    uint32_t getWritten() const { return written; }
+    const UpdateHeader& getHeader() const { return header; }
+
+private:
+    UpdateHeader header;
+    HeatshrinkDecoder decoder;
+    DeltaPatcher patcher;
+    Sha256 hash;
+    ReadFn readBase = nullptr;
+    WriteFn writeTarget = nullptr;
+    void* context = nullptr;
+    uint32_t consumed = 0;
+    uint32_t written = 0;
+    UpdateError error = UPDATE_OK;
+
+    bool setError(UpdateError newError) {
+        error = newError;
+        return false;
+    }
+
+    // Decompressed payload: a delta to apply or the image itself
+    static bool decoded(void* self, const uint8_t* data, size_t length) {
+        UpdateStream* stream = (UpdateStream*)self;
+        if (!stream->header.isDelta()) {
+            return emit(self, data, length);
+        }
+        return stream->patcher.feed(data, length);
+    }
+
+    static bool readFromBase(void* self, uint32_t offset, uint8_t* out, size_t length) {
+        UpdateStream* stream = (UpdateStream*)self;
+        if (!stream->readBase(stream->context, offset, out, length)) {
+            stream->setError(UPDATE_WRITE_FAILED);
+            return false;
+        }
+        return true;
+    }
+
+    static bool emit(void* self, const uint8_t* data, size_t length) {
+        UpdateStream* stream = (UpdateStream*)self;
+        if ((uint64_t)stream->written + length > stream->header.targetSize) {
+            stream->setError(UPDATE_SIZE_MISMATCH);
+            return false;
+        }
+        stream->written += length;
+        stream->hash.update(data, length);
+        if (!stream->writeTarget(stream->context, data, length)) {
+            stream->setError(UPDATE_WRITE_FAILED);
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
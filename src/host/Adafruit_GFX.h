@@ -0,0 +1,207 @@
+#ifndef HOST_ADAFRUIT_GFX_H
+#define HOST_ADAFRUIT_GFX_H
+
+#include "Arduino.h"
+#include "gfxfont.h"
+
+// Subset of Adafruit_GFX with the classic 6x8 text cell and custom GFXfonts.
+// There is no classic font table on the host: its glyphs are placeholder bit
+// patterns, but cursor movement, wrapping and getTextBounds() follow the real
+// library. Custom fonts and drawBitmap() draw exactly as on the device.
+class Adafruit_GFX : public Print {
+public:
+    Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h) {}
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+    int16_t width() const { return _width; }
+    int16_t height() const { return _height; }
+
+    void setCursor(int16_t x, int16_t y) { cursorX = x; cursorY = y; }
+    int16_t getCursorX() const { return cursorX; }
+    int16_t getCursorY() const { return cursorY; }
+    void setTextSize(uint8_t size) { textSize = size ? size : 1; }
+    void setTextColor(uint16_t color) { textColor = color; }
+    void setTextColor(uint16_t color, uint16_t background) { textColor = color; }
+    void setTextWrap(bool wrap) { this->wrap = wrap; }
+
+    // As in the library, the cursor moves by 6 rows when switching between
+    // the classic font (top-left origin) and a custom one (baseline origin)
+    void setFont(const GFXfont* f = nullptr) {
+        if (f && !gfxFont) {
+            cursorY += 6;
+        } else if (!f && gfxFont) {
+            cursorY -= 6;
+        }
+        gfxFont = (GFXfont*)f;
+    }
+
+    // Rows padded to whole bytes, MSB first; only set bits are drawn
+    void drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color) {
+        int16_t stride = (w + 7) / 8;
+        for (int16_t j = 0; j < h; j++) {
+            for (int16_t i = 0; i < w; i++) {
+                if (bitmap[j * stride + i / 8] & (0x80 >> (i & 7))) {
+                    drawPixel(x + i, y + j, color);
+                }
+            }
+        }
+    }
+
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+        for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, color);
+    }
+
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+        for (int16_t i = 0; i < h; i++) drawPixel(x, y + i, color);
+    }
+
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+        drawFastHLine(x, y, w, color);
+        drawFastHLine(x, y + h - 1, w, color);
+        drawFastVLine(x, y, h, color);
+        drawFastVLine(x + w - 1, y, h, color);
+    }
+
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+        for (int16_t i = 0; i < h; i++) drawFastHLine(x, y + i, w, color);
+    }
+
+    void getTextBounds(const char* text, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+        int16_t minX = _width, minY = _height, maxX = -1, maxY = -1;
+        while (*text) {
+            charBounds(*text++, &x, &y, &minX, &minY, &maxX, &maxY);
+        }
+        *x1 = maxX >= minX ? minX : x;
+        *y1 = maxY >= minY ? minY : y;
+        *w = maxX >= minX ? maxX - minX + 1 : 0;
+        *h = maxY >= minY ? maxY - minY + 1 : 0;
+    }
+
+    size_t write(uint8_t c) override {
+        if (gfxFont) {
+            writeCustom(c);
+            return 1;
+        }
+        if (c == '\n') {
+            cursorX = 0;
+            cursorY += textSize * 8;
+        } else if (c != '\r') {
+            if (wrap && cursorX + textSize * 6 > _width) {
+                cursorX = 0;
+                cursorY += textSize * 8;
+            }
+            drawChar(cursorX, cursorY, c);
+            cursorX += textSize * 6;
+        }
+        return 1;
+    }
+    using Print::write;
+
+protected:
+    int16_t _width;
+    int16_t _height;
+    int16_t cursorX = 0;
+    int16_t cursorY = 0;
+    uint8_t textSize = 1;
+    uint16_t textColor = 1;
+    bool wrap = true;
+    GFXfont* gfxFont = nullptr;
+
+    void writeCustom(uint8_t c) {
+        if (c == '\n') {
+            cursorX = 0;
+            cursorY += textSize * gfxFont->yAdvance;
+        } else if (c != '\r' && c >= gfxFont->first && c <= gfxFont->last) {
+            const GFXglyph* glyph = &gfxFont->glyph[c - gfxFont->first];
+            if (glyph->width > 0 && glyph->height > 0) {
+                if (wrap && cursorX + textSize * (glyph->xOffset + glyph->width) > _width) {
+                    cursorX = 0;
+                    cursorY += textSize * gfxFont->yAdvance;
+                }
+                drawCustomChar(cursorX, cursorY, glyph);
+            }
+            cursorX += glyph->xAdvance * textSize;
+        }
+    }
+
+    void drawCustomChar(int16_t x, int16_t y, const GFXglyph* glyph) {
+        const uint8_t* bits = gfxFont->bitmap + glyph->bitmapOffset;
+        uint8_t value = 0, bit = 0;
+        for (uint8_t yy = 0; yy < glyph->height; yy++) {
+            for (uint8_t xx = 0; xx < glyph->width; xx++) {
+                if (!(bit++ & 7)) {
+                    value = *bits++;
+                }
+                if (value & 0x80) {
+                    if (textSize == 1) {
+                        drawPixel(x + glyph->xOffset + xx, y + glyph->yOffset + yy, textColor);
+                    } else {
+                        fillRect(x + (glyph->xOffset + xx) * textSize, y + (glyph->yOffset + yy) * textSize,
+                                 textSize, textSize, textColor);
+                    }
+                }
+                value <<= 1;
+            }
+        }
+    }
+
+    void drawChar(int16_t x, int16_t y, uint8_t c) {
+        for (int8_t col = 0; col < 5; col++) {
+            uint8_t bits = (uint8_t)(c * (col + 3)) | 0x81;
+            for (int8_t row = 0; row < 8; row++) {
+                if (bits & (1 << row)) {
+                    if (textSize == 1) {
+                        drawPixel(x + col, y + row, textColor);
+                    } else {
+                        fillRect(x + col * textSize, y + row * textSize, textSize, textSize, textColor);
+                    }
+                }
+            }
+        }
+    }
+
+    void charBounds(char c, int16_t* x, int16_t* y, int16_t* minX, int16_t* minY, int16_t* maxX, int16_t* maxY) {
+        if (gfxFont) {
+            uint8_t code = (uint8_t)c;
+            if (code == '\n') {
+                *x = 0;
+                *y += textSize * gfxFont->yAdvance;
+            } else if (code != '\r' && code >= gfxFont->first && code <= gfxFont->last) {
+                const GFXglyph* glyph = &gfxFont->glyph[code - gfxFont->first];
+                if (wrap && *x + (glyph->xOffset + glyph->width) * textSize > _width) {
+                    *x = 0;
+                    *y += textSize * gfxFont->yAdvance;
+                }
+                int16_t x1 = *x + glyph->xOffset * textSize;
+                int16_t y1 = *y + glyph->yOffset * textSize;
+                int16_t x2 = x1 + glyph->width * textSize - 1;
+                int16_t y2 = y1 + glyph->height * textSize - 1;
+                if (x1 < *minX) *minX = x1;
+                if (y1 < *minY) *minY = y1;
+                if (x2 > *maxX) *maxX = x2;
+                if (y2 > *maxY) *maxY = y2;
+                *x += glyph->xAdvance * textSize;
+            }
+            return;
+        }
+        if (c == '\n') {
+            *x = 0;
+            *y += textSize * 8;
+        } else if (c != '\r') {
+            if (wrap && *x + textSize * 6 > _width) {
+                *x = 0;
+                *y += textSize * 8;
+            }
+            int16_t x2 = *x + textSize * 6 - 1;
+            int16_t y2 = *y + textSize * 8 - 1;
+            if (x2 > *maxX) *maxX = x2;
+            if (y2 > *maxY) *maxY = y2;
+            if (*x < *minX) *minX = *x;
+            if (*y < *minY) *minY = *y;
+            *x += textSize * 6;
+        }
+    }
+};
+
+#endif
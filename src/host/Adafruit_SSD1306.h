@@ -0,0 +1,120 @@
+#ifndef HOST_ADAFRUIT_SSD1306_H
+#define HOST_ADAFRUIT_SSD1306_H
+
+#include "Adafruit_GFX.h"
+#include "Wire.h"
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+#define SSD1306_EXTERNALVCC 0x01
+#define SSD1306_SWITCHCAPVCC 0x02
+
+// Framebuffer and I2C traffic match the real driver: commands go out with a
+// 0x00 prefix, display() sends the page window then the buffer in chunks that
+// fit the Wire buffer, each prefixed with 0x40. Like the library, transfers
+// run at 400 kHz and the bus is put back to 100 kHz afterwards.
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+    Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rstPin = -1)
+        : Adafruit_GFX(w, h), wire(twi) {}
+
+    ~Adafruit_SSD1306() {
+        delete[] buffer;
+    }
+
+    bool begin(uint8_t vccState = SSD1306_SWITCHCAPVCC, uint8_t address = 0, bool reset = true, bool periphBegin = true) {
+        if (buffer == nullptr) {
+            buffer = new uint8_t[bufferSize()];
+        }
+        clearDisplay();
+        i2cAddress = address ? address : (_height == 32 ? 0x3C : 0x3D);
+        if (periphBegin) {
+            wire->begin();
+        }
+
+        static const uint8_t init[] = {
+            0xAE, 0xD5, 0x80, 0xA8, 0x1F, 0xD3, 0x00, 0x40, 0x8D, 0x14,
+            0x20, 0x00, 0xA1, 0xC8, 0xDA, 0x02, 0x81, 0x8F, 0xD9, 0xF1,
+            0xDB, 0x40, 0xA4, 0xA6, 0x2E, 0xAF
+        };
+        commandList(init, sizeof(init));
+        return true;
+    }
+
+    void clearDisplay() {
+        if (buffer) memset(buffer, 0, bufferSize());
+    }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+        if (!buffer || x < 0 || x >= _width || y < 0 || y >= _height) return;
+        uint8_t& cell = buffer[x + (y / 8) * _width];
+        uint8_t bit = 1 << (y & 7);
+        switch (color) {
+            case SSD1306_WHITE: cell |= bit; break;
+            case SSD1306_BLACK: cell &= ~bit; break;
+            case SSD1306_INVERSE: cell ^= bit; break;
+        }
+    }
+
+    void display() {
+        wire->setClock(400000);
+        const uint8_t window[] = { 0x22, 0x00, 0xFF, 0x21, 0x00, (uint8_t)(_width - 1) };
+        sendCommands(window, sizeof(window));
+
+        size_t remaining = bufferSize();
+        const uint8_t* p = buffer;
+        while (remaining > 0) {
+            wire->beginTransmission(i2cAddress);
+            wire->write((uint8_t)0x40);
+            size_t chunk = min<size_t>(remaining, I2C_BUFFER_LENGTH - 1);
+            wire->write(p, chunk);
+            wire->endTransmission();
+            p += chunk;
+            remaining -= chunk;
+        }
+        wire->setClock(100000);
+    }
+
+    void dim(bool dim) {
+        const uint8_t contrast[] = { 0x81, (uint8_t)(dim ? 0x00 : 0x8F) };
+        commandList(contrast, sizeof(contrast));
+    }
+
+    void invertDisplay(bool invert) {
+        const uint8_t command[] = { (uint8_t)(invert ? 0xA7 : 0xA6) };
+        commandList(command, sizeof(command));
+    }
+
+    void ssd1306_command(uint8_t command) {
+        commandList(&command, 1);
+    }
+
+    uint8_t* getBuffer() {
+        return buffer;
+    }
+
+private:
+    TwoWire* wire;
+    uint8_t* buffer = nullptr;
+    uint8_t i2cAddress = 0x3C;
+
+    size_t bufferSize() const {
+        return _width * ((_height + 7) / 8);
+    }
+
+    void commandList(const uint8_t* commands, size_t count) {
+        wire->setClock(400000);
+        sendCommands(commands, count);
+        wire->setClock(100000);
+    }
+
+    void sendCommands(const uint8_t* commands, size_t count) {
+        wire->beginTransmission(i2cAddress);
+        wire->write((uint8_t)0x00);
+        wire->write(commands, count);
+        wire->endTransmission();
+    }
+};
+
+#endif
@@ -0,0 +1,482 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal arduino-esp32 core for the native build. Covers what the firmware
+// uses; pins, ADC and touch are backed by HostGpio, time by HostClock.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "host_hal.h"
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+#define OPEN_DRAIN 0x10
+#define OUTPUT_OPEN_DRAIN 0x12
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define ONLOW 0x04
+#define ONHIGH 0x05
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define PROGMEM
+#define F(text) (text)
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+typedef enum {
+    ADC_0db,
+    ADC_2_5db,
+    ADC_6db,
+    ADC_11db
+} adc_attenuation_t;
+
+// ---------------------------------------------------------------- String
+
+class String {
+public:
+    String() {}
+    String(const char* text) : value(text ? text : "") {}
+    String(const char* text, size_t length) : value(text ? text : "", text ? length : 0) {}
+    String(const std::string& text) : value(text) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(unsigned char number, unsigned char base = 10) : value(format((unsigned long)number, base)) {}
+    explicit String(int number, unsigned char base = 10) : value(formatSigned(number, base)) {}
+    explicit String(unsigned int number, unsigned char base = 10) : value(format(number, base)) {}
+    explicit String(long number, unsigned char base = 10) : value(formatSigned(number, base)) {}
+    explicit String(unsigned long number, unsigned char base = 10) : value(format(number, base)) {}
+    explicit String(long long number, unsigned char base = 10) : value(formatSigned(number, base)) {}
+    explicit String(unsigned long long number, unsigned char base = 10) : value(format(number, base)) {}
+    explicit String(float number, unsigned int decimals = 2) : value(formatFloat(number, decimals)) {}
+    explicit String(double number, unsigned int decimals = 2) : value(formatFloat(number, decimals)) {}
+
+    unsigned int length() const { return value.length(); }
+    bool isEmpty() const { return value.empty(); }
+    const char* c_str() const { return value.c_str(); }
+    bool reserve(unsigned int size) { value.reserve(size); return true; }
+
+    char charAt(unsigned int index) const { return index < value.length() ? value[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return value[index]; }
+
+    bool concat(const String& other) { value += other.value; return true; }
+    bool concat(const char* text) { if (text) value += text; return text != nullptr; }
+    bool concat(const char* text, unsigned int length) { value.append(text, length); return true; }
+    bool concat(char c) { value += c; return true; }
+    template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    bool concat(T number) { return concat(String(number)); }
+
+    String& operator+=(const String& other) { concat(other); return *this; }
+    String& operator+=(const char* text) { concat(text); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+    template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    String& operator+=(T number) { concat(String(number)); return *this; }
+
+    bool equals(const String& other) const { return value == other.value; }
+    bool equals(const char* text) const { return value == (text ? text : ""); }
+    bool operator==(const String& other) const { return equals(other); }
+    bool operator==(const char* text) const { return equals(text); }
+    bool operator!=(const String& other) const { return !equals(other); }
+    bool operator!=(const char* text) const { return !equals(text); }
+    bool operator<(const String& other) const { return value < other.value; }
+    bool equalsIgnoreCase(const String& other) const {
+        return strcasecmp(value.c_str(), other.value.c_str()) == 0;
+    }
+
+    bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.length(), prefix.value) == 0; }
+    bool endsWith(const String& suffix) const {
+        return value.length() >= suffix.value.length() &&
+               value.compare(value.length() - suffix.value.length(), suffix.value.length(), suffix.value) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return toIndex(value.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return toIndex(value.find(text.value, from)); }
+    int lastIndexOf(char c) const { return toIndex(value.rfind(c)); }
+    int lastIndexOf(const String& text) const { return toIndex(value.rfind(text.value)); }
+
+    String substring(unsigned int begin) const {
+        return begin < value.length() ? String(value.substr(begin)) : String();
+    }
+    String substring(unsigned int begin, unsigned int end) const {
+        if (begin > end) std::swap(begin, end);
+        if (begin >= value.length()) return String();
+        return String(value.substr(begin, end - begin));
+    }
+
+    void replace(const String& find, const String& replacement) {
+        if (find.value.empty()) return;
+        size_t at = 0;
+        while ((at = value.find(find.value, at)) != std::string::npos) {
+            value.replace(at, find.value.length(), replacement.value);
+            at += replacement.value.length();
+        }
+    }
+    void remove(unsigned int index) { if (index < value.length()) value.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < value.length()) value.erase(index, count); }
+    void trim() {
+        size_t first = value.find_first_not_of(" \t\r\n");
+        size_t last = value.find_last_not_of(" \t\r\n");
+        value = first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+    }
+    void toLowerCase() { for (char& c : value) c = tolower(c); }
+    void toUpperCase() { for (char& c : value) c = toupper(c); }
+
+    long toInt() const { return atol(value.c_str()); }
+    float toFloat() const { return atof(value.c_str()); }
+    double toDouble() const { return atof(value.c_str()); }
+
+    friend String operator+(const String& left, const String& right) { String s(left); s += right; return s; }
+    friend String operator+(const String& left, const char* right) { String s(left); s += right; return s; }
+    friend String operator+(const char* left, const String& right) { String s(left); s += right; return s; }
+    friend String operator+(const String& left, char right) { String s(left); s += right; return s; }
+    template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    friend String operator+(const String& left, T right) { String s(left); s += right; return s; }
+
+private:
+    std::string value;
+
+    static int toIndex(size_t position) {
+        return position == std::string::npos ? -1 : (int)position;
+    }
+
+    static std::string format(unsigned long long number, unsigned char base) {
+        if (base < 2 || base > 36) base = 10;
+        char buffer[65];
+        char* p = buffer + sizeof(buffer) - 1;
+        *p = 0;
+        do {
+            int digit = number % base;
+            *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+            number /= base;
+        } while (number);
+        return p;
+    }
+
+    static std::string formatSigned(long long number, unsigned char base) {
+        if (number < 0 && base == 10) {
+            return "-" + format(0ULL - (unsigned long long)number, base);
+        }
+        return format((unsigned long long)number, base);
+    }
+
+    static std::string formatFloat(double number, unsigned int decimals) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+        return buffer;
+    }
+};
+
+// Named by ArduinoJson's String adapters; concatenations here return plain String
+class StringSumHelper : public String {
+public:
+    using String::String;
+};
+
+// ---------------------------------------------------------------- Print / Stream
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+    size_t write(const char* text) { return text ? write((const uint8_t*)text, strlen(text)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+    size_t print(const String& text) { return write(text.c_str(), text.length()); }
+    size_t print(const char* text) { return write(text); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char number, int base = DEC) { return print(String(number, base)); }
+    size_t print(int number, int base = DEC) { return print(String(number, base)); }
+    size_t print(unsigned int number, int base = DEC) { return print(String(number, base)); }
+    size_t print(long number, int base = DEC) { return print(String(number, base)); }
+    size_t print(unsigned long number, int base = DEC) { return print(String(number, base)); }
+    size_t print(long long number, int base = DEC) { return print(String(number, base)); }
+    size_t print(unsigned long long number, int base = DEC) { return print(String(number, base)); }
+    size_t print(double number, int digits = 2) { return print(String(number, digits)); }
+
+    size_t println() { return write("\r\n"); }
+    template<typename T>
+    size_t println(const T& value) { size_t n = print(value); return n + println(); }
+    template<typename T>
+    size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char small[128];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(small, sizeof(small), format, args);
+        va_end(args);
+        if (length < 0) return 0;
+        if ((size_t)length < sizeof(small)) return write((const uint8_t*)small, length);
+
+        std::string large(length + 1, '\0');
+        va_start(args, format);
+        vsnprintf(&large[0], large.size(), format, args);
+        va_end(args);
+        return write((const uint8_t*)large.data(), length);
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+
+    // Up to length bytes, fewer if the stream runs dry
+    virtual size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int c = read();
+            if (c < 0) break;
+            buffer[count++] = (char)c;
+        }
+        return count;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+};
+
+// Serial goes to stdout (or another stream, or nowhere with nullptr);
+// input can be queued with feed() to script commands
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) {}
+    void end() {}
+    operator bool() const { return true; }
+
+    void setHostOutput(FILE* stream) {
+        output = stream;
+    }
+
+    size_t write(uint8_t c) override {
+        return output ? fwrite(&c, 1, 1, output) : 1;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return output ? fwrite(buffer, 1, size, output) : size;
+    }
+    using Print::write;
+
+    int available() override {
+        std::lock_guard<std::mutex> guard(inputLock);
+        return input.size();
+    }
+    int read() override {
+        std::lock_guard<std::mutex> guard(inputLock);
+        if (input.empty()) return -1;
+        int c = input.front();
+        input.pop_front();
+        return c;
+    }
+    int peek() override {
+        std::lock_guard<std::mutex> guard(inputLock);
+        return input.empty() ? -1 : input.front();
+    }
+    void flush() override {
+        if (output) fflush(output);
+    }
+
+    void feed(const char* text) {
+        std::lock_guard<std::mutex> guard(inputLock);
+        while (*text) input.push_back((uint8_t)*text++);
+    }
+
+private:
+    FILE* output = stdout;
+    std::mutex inputLock;
+    std::deque<uint8_t> input;
+};
+
+inline HardwareSerial Serial;
+
+// ---------------------------------------------------------------- Time
+
+inline unsigned long micros() {
+    return (unsigned long)(uint32_t)HostClock::nowUs();
+}
+
+inline unsigned long millis() {
+    return (unsigned long)(uint32_t)(HostClock::nowUs() / 1000);
+}
+
+inline void delay(uint32_t ms) {
+    HostClock::advanceMs(ms);
+}
+
+inline void delayMicroseconds(uint32_t us) {
+    HostClock::advanceUs(us);
+}
+
+inline void yield() {
+    std::this_thread::yield();
+}
+
+// ---------------------------------------------------------------- CPU
+
+inline uint32_t& hostCpuMhz() {
+    static uint32_t mhz = 240;
+    return mhz;
+}
+
+inline bool setCpuFrequencyMhz(uint32_t mhz) {
+    hostCpuMhz() = mhz;
+    return true;
+}
+
+inline uint32_t getCpuFrequencyMhz() {
+    return hostCpuMhz();
+}
+
+class EspClass {
+public:
+    // Derived from the clock at the current CPU frequency
+    uint32_t getCycleCount() {
+        return (uint32_t)(HostClock::nowUs() * getCpuFrequencyMhz());
+    }
+
+    // The host keeps running; callers see the request in getRestartCount()
+    void restart() {
+        if (restarts++ == 0) {
+            fprintf(stderr, "[host] ESP.restart() requested, further requests are only counted\n");
+        }
+    }
+
+    uint32_t getRestartCount() const { return restarts; }
+    uint32_t getFreeHeap() { return 320 * 1024; }
+    uint32_t getHeapSize() { return 512 * 1024; }
+    const char* getChipModel() { return "host"; }
+
+private:
+    uint32_t restarts = 0;
+};
+
+inline EspClass ESP;
+
+// ---------------------------------------------------------------- GPIO / ADC / touch
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    HostGpio::setMode(pin, mode);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+    HostGpio::write(pin, value);
+}
+
+inline int digitalRead(uint8_t pin) {
+    return HostGpio::read(pin);
+}
+
+inline int digitalPinToInterrupt(uint8_t pin) {
+    return pin;
+}
+
+inline void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    HostGpio::attachInterrupt(pin, handler, mode);
+}
+
+inline void detachInterrupt(uint8_t pin) {
+    HostGpio::detachInterrupt(pin);
+}
+
+// ESP32-S3 numbering: GPIO1-10 are ADC1 channels 0-9, GPIO11-20 ADC2 (reported as 10-19)
+inline int8_t digitalPinToAnalogChannel(uint8_t pin) {
+    if (pin >= 1 && pin <= 20) return pin - 1;
+    return -1;
+}
+
+inline uint8_t& hostAdcBits() {
+    static uint8_t bits = 12;
+    return bits;
+}
+
+inline void analogReadResolution(uint8_t bits) {
+    hostAdcBits() = bits;
+}
+
+inline void analogSetAttenuation(adc_attenuation_t attenuation) {}
+inline void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation) {}
+
+inline uint32_t analogReadMilliVolts(uint8_t pin) {
+    return HostGpio::milliVolts(pin);
+}
+
+// Ideal converter with 11 dB attenuation (about 3.1 V full scale)
+inline uint16_t analogRead(uint8_t pin) {
+    uint32_t full = (1u << hostAdcBits()) - 1;
+    uint32_t raw = HostGpio::milliVolts(pin) * full / 3100;
+    return raw > full ? full : raw;
+}
+
+typedef uint32_t touch_value_t;
+
+inline touch_value_t touchRead(uint8_t pin) {
+    return HostGpio::touch(pin);
+}
+
+inline void touchAttachInterrupt(uint8_t pin, void (*handler)(), touch_value_t threshold) {}
+
+// ---------------------------------------------------------------- Math
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    if (inMax == inMin) return outMin;
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+inline long random(long howBig) {
+    return howBig > 0 ? rand() % howBig : 0;
+}
+
+inline long random(long howSmall, long howBig) {
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+inline void randomSeed(unsigned long seed) {
+    srand(seed);
+}
+
+#endif
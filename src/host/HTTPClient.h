@@ -0,0 +1,127 @@
+#ifndef HOST_HTTPCLIENT_H
+#define HOST_HTTPCLIENT_H
+
+#include "Arduino.h"
+#include "host_net.h"
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+
+#define HTTP_CODE_OK 200
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Requests go to the HostHttp handler (a simulated server or a real transport)
+class HTTPClient {
+public:
+    bool begin(const String& url) {
+        request = HostHttpRequest();
+        request.url = url;
+        response = HostHttpResponse();
+        return true;
+    }
+
+    bool begin(WiFiClient& client, const String& url) {
+        return begin(url);
+    }
+
+    bool begin(WiFiClientSecure& client, const String& url) {
+        begin(url);
+        request.secure = &client;
+        return true;
+    }
+
+    void end() {
+        request = HostHttpRequest();
+    }
+
+    void addHeader(const String& name, const String& value) {
+        request.headers.push_back(std::make_pair(name, value));
+    }
+
+    void setTimeout(uint16_t timeoutMs) {
+        timeout = timeoutMs;
+    }
+    void setConnectTimeout(int32_t timeoutMs) {}
+    void setReuse(bool reuse) {}
+
+    void collectHeaders(const char* keys[], size_t count) {}
+
+    String header(const char* name) {
+        for (const auto& h : response.headers) {
+            if (h.first.equalsIgnoreCase(name)) return h.second;
+        }
+        return String();
+    }
+
+    int GET() {
+        return send("GET", nullptr, 0);
+    }
+
+    int POST(const String& payload) {
+        return send("POST", (const uint8_t*)payload.c_str(), payload.length());
+    }
+
+    int POST(uint8_t* payload, size_t size) {
+        return send("POST", payload, size);
+    }
+
+    // The body comes from a stream of known size, read in TCP-segment pieces
+    // as the core does; there they go to the socket, here to the handler
+    int sendRequest(const char* method, Stream* stream, size_t size) {
+        std::vector<uint8_t> body(size);
+        size_t filled = 0;
+        while (filled < size && stream->available() > 0) {
+            size_t piece = std::min<size_t>(std::min<size_t>(stream->available(), size - filled), TCP_SEGMENT_BYTES);
+            size_t read = stream->readBytes((char*)body.data() + filled, piece);
+            if (read == 0) break;
+            filled += read;
+        }
+        if (filled < size) {
+            return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        }
+        return send(method, body.data(), size);
+    }
+
+    int PUT(const String& payload) {
+        return send("PUT", (const uint8_t*)payload.c_str(), payload.length());
+    }
+
+    int getSize() {
+        return response.body.length();
+    }
+
+    String getString() {
+        return response.body;
+    }
+
+    // The body as a socket, for responses too large to hold in a String
+    WiFiClient* getStreamPtr() {
+        stream.open(response.body);
+        return &stream;
+    }
+
+    bool connected() {
+        return stream.connected();
+    }
+
+private:
+    static const size_t TCP_SEGMENT_BYTES = 1460;
+
+    HostHttpRequest request;
+    HostHttpResponse response;
+    uint32_t timeout = 5000;
+    WiFiClient stream;
+
+    int send(const char* method, const uint8_t* payload, size_t size) {
+        request.method = method;
+        request.timeoutMs = timeout;
+        request.body.assign(payload, payload + size);
+        response = HostHttp::perform(request);
+        return response.code;
+    }
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+#include "host_net.h"
+#include "esp_wifi.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3
+} wifi_mode_t;
+
+class WiFiClass {
+public:
+    // Writes a new station config, as the core does
+    wl_status_t begin(const char* ssid, const char* password = nullptr) {
+        HostWifi::listenInterval = 0;
+        HostWifi::startConnect();
+        return status();
+    }
+
+    bool reconnect() {
+        HostWifi::startConnect();
+        return true;
+    }
+
+    bool disconnect(bool wifiOff = false) {
+        HostWifi::disconnect();
+        return true;
+    }
+
+    wl_status_t status() {
+        if (HostWifi::isConnected()) return WL_CONNECTED;
+        if (HostWifi::wasLost()) return WL_CONNECTION_LOST;
+        return HostWifi::apAvailable ? WL_DISCONNECTED : WL_NO_SSID_AVAIL;
+    }
+
+    bool isConnected() {
+        return status() == WL_CONNECTED;
+    }
+
+    int8_t RSSI() {
+        return HostWifi::isConnected() ? HostWifi::rssi.load() : 0;
+    }
+
+    String macAddress() {
+        return "24:0A:C4:00:00:01";
+    }
+
+    bool mode(wifi_mode_t mode) { return true; }
+
+    bool setSleep(bool enabled) {
+        return setSleep(enabled ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+    }
+
+    bool setSleep(wifi_ps_type_t type) {
+        return esp_wifi_set_ps(type) == ESP_OK;
+    }
+
+    wifi_ps_type_t getSleep() {
+        return (wifi_ps_type_t)HostWifi::powerSave.load();
+    }
+
+    bool setAutoReconnect(bool enabled) { return true; }
+};
+
+inline WiFiClass WiFi;
+
+// Socket of a response whose body is read as a stream (HTTPClient::getStreamPtr);
+// reading charges the downlink time to the clock. connect() instead opens a
+// HostSockets connection, which is read and written as it is.
+class WiFiClient : public Stream {
+public:
+    void open(const String& response) {
+        socket = nullptr;
+        body = response;
+        position = 0;
+    }
+
+    int connect(const char* host, uint16_t port, int32_t timeoutMs = 3000) {
+        socket = HostSockets::connect(host, port);
+        body = String();
+        position = 0;
+        return socket != nullptr;
+    }
+
+    int setNoDelay(bool enabled) { return 0; }
+
+    int available() override {
+        if (socket) return socket->available();
+        return body.length() - position;
+    }
+
+    int read() override {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    int read(uint8_t* buffer, size_t size) {
+        if (socket) return socket->read(buffer, size);
+        size_t n = std::min<size_t>(size, body.length() - position);
+        memcpy(buffer, body.c_str() + position, n);
+        position += n;
+        if (HostHttp::chargeClock && n > 0) {
+            HostWifi::setTransfer(HostWifi::RADIO_RX);
+            HostClock::advanceUs((uint64_t)n * 8 * 1000000 / HostHttp::downlinkBitsPerSecond);
+            HostWifi::setTransfer(HostWifi::RADIO_OFF);
+        }
+        return n;
+    }
+
+    int peek() override {
+        return position < body.length() ? (uint8_t)body[position] : -1;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return socket ? socket->write(buffer, size) : 0;
+    }
+
+    uint8_t connected() {
+        if (socket) return socket->connected();
+        return position < body.length();
+    }
+
+    void stop() {
+        if (socket) socket->close();
+        socket = nullptr;
+        body = String();
+        position = 0;
+    }
+
+private:
+    std::shared_ptr<HostSocket> socket;
+    String body;
+    size_t position = 0;
+};
+
+#endif
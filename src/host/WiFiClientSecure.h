@@ -0,0 +1,29 @@
+#ifndef HOST_WIFICLIENTSECURE_H
+#define HOST_WIFICLIENTSECURE_H
+
+#include "WiFi.h"
+
+// The credentials are kept for inspection only: HTTPClient requests go to
+// the HostHttp handler whatever client they are given
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setCACert(const char* rootCA) {
+        caCert = rootCA;
+    }
+
+    void setPreSharedKey(const char* identity, const char* hexKey) {
+        pskIdentity = identity;
+        pskHex = hexKey;
+    }
+
+    void setInsecure() {
+        insecure = true;
+    }
+
+    const char* caCert = nullptr;
+    const char* pskIdentity = nullptr;
+    const char* pskHex = nullptr;
+    bool insecure = false;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+// Same 128-byte transmit buffer as the ESP32 core
+#ifndef I2C_BUFFER_LENGTH
+#define I2C_BUFFER_LENGTH 128
+#endif
+
+class TwoWire : public Stream {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+        HostI2c::setFrequency(frequency ? frequency : 100000);
+        started = true;
+        return true;
+    }
+
+    bool end() {
+        started = false;
+        return true;
+    }
+
+    bool setClock(uint32_t frequency) {
+        HostI2c::setFrequency(frequency);
+        return true;
+    }
+
+    uint32_t getClock() {
+        return HostI2c::getFrequency();
+    }
+
+    void beginTransmission(uint16_t address) {
+        txAddress = address;
+        txLength = 0;
+    }
+
+    uint8_t endTransmission(bool sendStop = true) {
+        if (!started) return 4;
+        uint8_t status = HostI2c::write(txAddress, txBuffer, txLength);
+        txLength = 0;
+        return status;
+    }
+
+    uint8_t requestFrom(uint16_t address, uint8_t quantity, bool sendStop = true) {
+        rxLength = started ? HostI2c::read(address, rxBuffer, min<size_t>(quantity, I2C_BUFFER_LENGTH)) : 0;
+        rxIndex = 0;
+        return rxLength;
+    }
+
+    size_t write(uint8_t data) override {
+        if (txLength >= I2C_BUFFER_LENGTH) return 0;
+        txBuffer[txLength++] = data;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t quantity) override {
+        size_t n = 0;
+        while (n < quantity && write(data[n])) n++;
+        return n;
+    }
+    using Print::write;
+
+    int available() override { return rxLength - rxIndex; }
+    int read() override { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+    int peek() override { return rxIndex < rxLength ? rxBuffer[rxIndex] : -1; }
+
+private:
+    bool started = false;
+    uint16_t txAddress = 0;
+    uint8_t txBuffer[I2C_BUFFER_LENGTH];
+    size_t txLength = 0;
+    uint8_t rxBuffer[I2C_BUFFER_LENGTH];
+    size_t rxLength = 0;
+    size_t rxIndex = 0;
+};
+
+inline TwoWire Wire;
+
+#endif
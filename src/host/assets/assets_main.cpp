@@ -0,0 +1,525 @@
+// Asset pack harness (pio run -e native_assets).
+// Reads the pack scripts/asset_pack.py built (the env's pre-script writes it
+// to .pio/build/native_assets/assets.bin) and checks it against the manifest
+// and its sources:
+//   - the pack opens with the firmware's schema and hash, and holds every
+//     AssetId with the manifest's type
+//   - font glyphs and bitmaps match their BDF and PBM sources bit for bit;
+//     prompts decode back to their WAV sources (PCM exactly, ADPCM within
+//     MIN_ADPCM_SNR_DB)
+//   - damaged packs are refused: another schema, a flipped byte, a short
+//     read, entries pointing outside the pack
+//   - AssetStore maps the pack from the simulated partition without a copy,
+//     and DisplayDriver puts the icon on the panel as it is in the pack
+// and reports sizes and timings on this host:
+//   - bytes per type, against the same assets as arrays in the app image
+//     or in DRAM
+//   - lookup time for packs of 10 to 60000 entries
+//   - mount time with and without the hash, text drawing in the pack font
+//
+// Usage: program [--pack assets.bin] [--manifest assets/assets.txt]
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../host_wav.h"
+#include "../../firmware/drivers/display_driver.cpp"
+#include "../../firmware/dsp/audio_codec.cpp"
+
+typedef std::vector<uint8_t> Bytes;
+
+static const double MIN_ADPCM_SNR_DB = 20.0;
+
+static bool readFile(const std::string& path, Bytes& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    uint8_t buffer[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.insert(out.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best of a few runs, in seconds per call
+static double timePerCall(size_t calls, const std::function<void()>& run) {
+    double best = 1e9;
+    for (int i = 0; i < 5; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, secondsSince(start));
+    }
+    return best / calls;
+}
+
+// ---------------------------------------------------------------- Sources
+
+struct ManifestEntry {
+    std::string id;
+    std::string type;
+    std::string source;
+    std::string options;
+};
+
+static bool readManifest(const std::string& path, std::vector<ManifestEntry>& entries) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return false;
+    std::string dir = path.find('/') == std::string::npos ? "." : path.substr(0, path.rfind('/'));
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        std::string text = line;
+        text = text.substr(0, text.find('#'));
+        std::istringstream fields(text);
+        ManifestEntry entry;
+        if (!(fields >> entry.id >> entry.type >> entry.source)) continue;
+        entry.source = dir + "/" + entry.source;
+        std::string option;
+        while (fields >> option) entry.options += option + " ";
+        entries.push_back(entry);
+    }
+    fclose(file);
+    return true;
+}
+
+struct SourceGlyph {
+    int width = 0, height = 0, xOffset = 0, yOffset = 0, advance = 0;
+    std::vector<uint32_t> rows;
+};
+
+// Just the parts of BDF the packer reads
+static bool readBdf(const std::string& path, std::map<int, SourceGlyph>& glyphs) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return false;
+    char line[256];
+    SourceGlyph glyph;
+    int code = -1;
+    bool bitmap = false;
+    while (fgets(line, sizeof(line), file)) {
+        std::istringstream words(line);
+        std::string key;
+        words >> key;
+        if (key == "ENCODING") {
+            words >> code;
+            glyph = SourceGlyph();
+        } else if (key == "DWIDTH") {
+            words >> glyph.advance;
+        } else if (key == "BBX") {
+            words >> glyph.width >> glyph.height >> glyph.xOffset >> glyph.yOffset;
+        } else if (key == "BITMAP") {
+            bitmap = true;
+        } else if (key == "ENDCHAR") {
+            glyphs[code] = glyph;
+            bitmap = false;
+        } else if (bitmap) {
+            glyph.rows.push_back((uint32_t)strtoul(key.c_str(), nullptr, 16));
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Plain (P1) PBM as the repo's icons are stored; 1 is a lit pixel
+static bool readPbm(const std::string& path, int& width, int& height, std::vector<bool>& pixels) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return false;
+    std::string text;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        std::string row = line;
+        text += row.substr(0, row.find('#')) + " ";
+    }
+    fclose(file);
+    std::istringstream tokens(text);
+    std::string magic;
+    if (!(tokens >> magic >> width >> height) || magic != "P1") return false;
+    pixels.clear();
+    char c;
+    while ((int)pixels.size() < width * height && tokens >> c) {
+        if (c == '0' || c == '1') pixels.push_back(c == '1');
+    }
+    return (int)pixels.size() == width * height;
+}
+
+// ---------------------------------------------------------------- Pack checks
+
+static void checkFont(Checks& checks, const AssetPack& pack, uint16_t id, const ManifestEntry& source) {
+    AssetFont font = pack.font(id);
+    std::map<int, SourceGlyph> glyphs;
+    if (!font || !readBdf(source.source, glyphs)) {
+        checks.expect(false, source.id + " font", "missing font or source");
+        return;
+    }
+    int mismatched = 0, covered = 0;
+    for (int code = 32; code <= 126; code++) {
+        const AssetGlyph* glyph = font.glyph(code);
+        auto it = glyphs.find(code);
+        if (!glyph || it == glyphs.end()) {
+            mismatched++;
+            continue;
+        }
+        covered++;
+        const SourceGlyph& bdf = it->second;
+        bool same = glyph->width == bdf.width && glyph->height == bdf.height && glyph->xAdvance == bdf.advance &&
+                    glyph->xOffset == bdf.xOffset && glyph->yOffset == -(bdf.yOffset + bdf.height);
+        int rowBits = (bdf.width + 7) / 8 * 8;
+        for (int y = 0; same && y < bdf.height; y++) {
+            for (int x = 0; x < bdf.width; x++) {
+                int bit = y * bdf.width + x;
+                bool packed = font.bits[glyph->bitmapOffset + bit / 8] & (0x80 >> (bit & 7));
+                bool expected = (bdf.rows[y] >> (rowBits - 1 - x)) & 1;
+                if (packed != expected) same = false;
+            }
+        }
+        // Within the line: ascent above the baseline, the rest of yAdvance below
+        if (glyph->height > 0 && (glyph->yOffset < -font.header->ascent ||
+                                  glyph->yOffset + glyph->height > font.header->yAdvance - font.header->ascent)) {
+            same = false;
+        }
+        if (!same) mismatched++;
+    }
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%d of 95 printable glyphs match, line %u px, ascent %u px", covered - mismatched,
+             font.header->yAdvance, font.header->ascent);
+    checks.expect(mismatched == 0 && covered == 95, source.id + " glyphs match the BDF source", detail);
+}
+
+static void checkBitmap(Checks& checks, const AssetPack& pack, uint16_t id, const ManifestEntry& source) {
+    AssetBitmap bitmap = pack.bitmap(id);
+    int width = 0, height = 0;
+    std::vector<bool> pixels;
+    bool same = bitmap && readPbm(source.source, width, height, pixels) && bitmap.width == width &&
+                bitmap.height == height;
+    for (int y = 0; same && y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (bitmap.pixel(x, y) != pixels[y * width + x]) same = false;
+        }
+    }
+    checks.expect(same, source.id + " matches the PBM source", String(width).c_str() + std::string("x") +
+                  String(height).c_str());
+}
+
+// Decodes every block of a prompt
+static std::vector<int16_t> decodePrompt(const AssetPrompt& prompt) {
+    std::vector<int16_t> out;
+    int16_t block[4096];
+    for (uint32_t i = 0; i < prompt.blocks(); i++) {
+        size_t length;
+        const uint8_t* data = prompt.block(i, length);
+        if (prompt.header->codec == CODEC_PCM16) {
+            const int16_t* samples = (const int16_t*)data;
+            out.insert(out.end(), samples, samples + length / 2);
+        } else {
+            size_t n = AudioEncoder::decodeAdpcm(data, length, block);
+            out.insert(out.end(), block, block + n);
+        }
+    }
+    return out;
+}
+
+static void checkPrompt(Checks& checks, const AssetPack& pack, uint16_t id, const ManifestEntry& source) {
+    AssetPrompt prompt = pack.prompt(id);
+    std::vector<int16_t> wav;
+    std::string error;
+    if (!prompt || !loadWav(source.source, prompt.header->sampleRate, wav, error)) {
+        checks.expect(false, source.id + " prompt", error.empty() ? "missing prompt" : error);
+        return;
+    }
+    std::vector<int16_t> decoded = decodePrompt(prompt);
+    double signal = 0, noise = 0;
+    for (size_t i = 0; i < wav.size() && i < decoded.size(); i++) {
+        signal += (double)wav[i] * wav[i];
+        noise += (double)(wav[i] - decoded[i]) * (wav[i] - decoded[i]);
+    }
+    bool pcm = prompt.header->codec == CODEC_PCM16;
+    double snr = noise > 0 ? 10 * log10(signal / noise) : 99.0;
+    bool sizes = decoded.size() == wav.size() && prompt.header->samples == wav.size();
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%s, %zu samples, %u bytes, SNR %.1f dB", pcm ? "PCM" : "ADPCM", decoded.size(),
+             prompt.bytes, snr);
+    checks.expect(sizes && (pcm ? noise == 0 : snr >= MIN_ADPCM_SNR_DB), source.id + " decodes to the WAV source",
+                  detail);
+}
+
+// Header, entry table and data for a pack of count tiny bitmaps
+static Bytes syntheticPack(uint16_t count, uint32_t schema) {
+    const size_t entryBytes = 8;           // 4x4 bitmap: header plus 4 rows
+    size_t dataStart = AssetPack::HEADER_BYTES + count * sizeof(AssetEntry);
+    Bytes pack(dataStart + count * entryBytes, 0);
+    memcpy(pack.data(), "GAST", 4);
+    pack[4] = AssetPack::FORMAT;
+    pack[6] = count & 0xFF;
+    pack[7] = count >> 8;
+    memcpy(&pack[8], &schema, 4);
+    uint32_t total = pack.size();
+    memcpy(&pack[12], &total, 4);
+    for (uint16_t id = 0; id < count; id++) {
+        AssetEntry entry = { (uint32_t)(dataStart + id * entryBytes), (uint32_t)entryBytes, ASSET_BITMAP, {} };
+        memcpy(&pack[AssetPack::HEADER_BYTES + id * sizeof(AssetEntry)], &entry, sizeof(entry));
+        AssetBitmapHeader header = { 4, 4 };
+        memcpy(&pack[entry.offset], &header, sizeof(header));
+        pack[entry.offset + 4] = (uint8_t)id;
+    }
+    Sha256 hash;
+    hash.update(&pack[AssetPack::HEADER_BYTES], pack.size() - AssetPack::HEADER_BYTES);
+    hash.finish(&pack[32]);
+    return pack;
+}
+
+// Damaged copies of the pack must not open
+static void checkDamage(Checks& checks, const Bytes& pack, const std::vector<ManifestEntry>& manifest) {
+    AssetPack reader;
+    checks.expect(reader.open(pack.data(), pack.size(), ASSET_SCHEMA ^ 1) == ASSET_PACK_SCHEMA_MISMATCH,
+                  "pack from another manifest is refused", "schema mismatch");
+
+    Bytes flipped = pack;
+    flipped[flipped.size() - 7] ^= 0x10;
+    checks.expect(reader.open(flipped.data(), flipped.size(), ASSET_SCHEMA) == ASSET_PACK_HASH_MISMATCH,
+                  "flipped data bit is refused", "hash mismatch");
+    checks.expect(reader.open(flipped.data(), flipped.size(), ASSET_SCHEMA, false) == ASSET_PACK_OK,
+                  "without the hash, a data bit goes unnoticed", "mount(verify) is the default");
+
+    checks.expect(reader.open(pack.data(), pack.size() - 1, ASSET_SCHEMA) == ASSET_PACK_BAD_HEADER,
+                  "short read is refused", "bad header");
+
+    Bytes outside = pack;
+    AssetEntry* table = (AssetEntry*)&outside[AssetPack::HEADER_BYTES];
+    table[manifest.size() - 1].size += 4096;
+    checks.expect(reader.open(outside.data(), outside.size(), ASSET_SCHEMA, false) == ASSET_PACK_BAD_ENTRY,
+                  "entry reaching past the pack is refused", "bad entry");
+
+    Bytes glyph = pack;
+    AssetPack good;
+    good.open(pack.data(), pack.size(), ASSET_SCHEMA);
+    AssetFont font = good.font(FONT_UI);
+    if (font) {
+        size_t at = (const uint8_t*)font.glyph('A') - pack.data();
+        glyph[at] = 0xFF;
+        glyph[at + 1] = 0xFF;
+        checks.expect(reader.open(glyph.data(), glyph.size(), ASSET_SCHEMA, false) == ASSET_PACK_BAD_ENTRY,
+                      "glyph pointing past the font's bits is refused", "bad entry");
+    }
+}
+
+// ---------------------------------------------------------------- Device path
+
+// SSD1306 frame as it arrives on the bus, in the panel's page layout
+class PanelCapture : public HostI2cDevice {
+public:
+    std::vector<uint8_t> frame = std::vector<uint8_t>(Board::Display::WIDTH * Board::Display::HEIGHT / 8, 0);
+
+    void onWrite(const uint8_t* data, size_t length) override {
+        if (length == 0) return;
+        if (data[0] == 0x00) {
+            for (size_t i = 1; i < length; i++) {
+                if (data[i] == 0x22) position = 0;      // Page window: a frame follows
+            }
+        } else if (data[0] == 0x40) {
+            for (size_t i = 1; i < length && position < frame.size(); i++) {
+                frame[position++] = data[i];
+            }
+        }
+    }
+
+    bool pixel(int x, int y) const {
+        return frame[x + (y / 8) * Board::Display::WIDTH] & (1 << (y & 7));
+    }
+
+private:
+    size_t position = 0;
+};
+
+static void devicePath(Checks& checks, const Bytes& pack) {
+    HostFlash::load(&HostFlash::assets, pack);
+    checks.expect(AssetStore::mount(), "AssetStore mounts the assets partition");
+    AssetBitmap icon = AssetStore::bitmap(ICON_BATTERY_LOW);
+    const uint8_t* flash = HostFlash::data(&HostFlash::assets).data();
+    bool inPlace = icon && icon.bits >= flash && icon.bits < flash + pack.size();
+    checks.expect(inPlace, "icons are read from the mapped partition", "no copy");
+
+    PanelCapture panel;
+    HostI2c::attach(Board::Display::ADDRESS, &panel);
+    DisplayDriver display;
+    display.begin();
+    display.showBatteryWarning();
+    uint8_t nop[] = { 0x00, 0xE3 };         // Queued behind the frame: returns once it is out
+    I2cBus::transfer(Board::Display::ADDRESS, nop, sizeof(nop));
+
+    int top = (Board::Display::HEIGHT - icon.height) / 2;
+    bool same = (bool)icon;
+    int lit = 0;
+    for (int y = 0; same && y < icon.height; y++) {
+        for (int x = 0; x < icon.width; x++) {
+            if (panel.pixel(x, top + y) != icon.pixel(x, y)) same = false;
+        }
+    }
+    for (int x = icon.width; x < Board::Display::WIDTH; x++) {
+        for (int y = 0; y < Board::Display::HEIGHT; y++) lit += panel.pixel(x, y);
+    }
+    checks.expect(same && lit > 0, "battery warning shows the pack icon and text on the panel",
+                  String(lit).c_str() + std::string(" text pixels"));
+    AssetStore::unmount();
+    checks.expect(HostFlash::mappings == 0, "unmount releases the mapping");
+}
+
+// ---------------------------------------------------------------- Numbers
+
+// Adafruit_GFX canvas that only counts, for drawing times
+class CountingCanvas : public Adafruit_GFX {
+public:
+    CountingCanvas() : Adafruit_GFX(Board::Display::WIDTH, Board::Display::HEIGHT) {}
+    uint32_t pixels = 0;
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override { pixels++; }
+};
+
+static void report(const Bytes& pack, const AssetPack& reader, const std::vector<ManifestEntry>& manifest) {
+    std::map<std::string, size_t> byType;
+    std::map<std::string, int> countByType;
+    for (uint16_t id = 0; id < reader.size(); id++) {
+        const AssetEntry* entry = reader.entry(id);
+        byType[manifest[id].type] += entry->size;
+        countByType[manifest[id].type]++;
+    }
+    size_t payload = 0;
+    printf("%-10s %6s %9s\n", "type", "assets", "bytes");
+    for (const auto& type : byType) {
+        printf("%-10s %6d %9zu\n", type.first.c_str(), countByType[type.first], type.second);
+        payload += type.second;
+    }
+    printf("%-10s %6u %9zu  (header, table and padding %zu)\n\n", "pack", reader.size(), pack.size(),
+           pack.size() - payload);
+    printf("Where the assets cost      app image   DRAM   OTA download\n");
+    printf("  const arrays in the app   %9zu %6d %14zu\n", payload, 0, payload);
+    printf("  copies in RAM             %9zu %6zu %14zu\n", payload, payload, payload);
+    printf("  mapped pack               %9d %6zu %14d   (%zu of 64 KB MMU pages)\n\n", 0,
+           sizeof(AssetPack) + sizeof(GFXfont), 0, (pack.size() + 65535) / 65536);
+
+    // Lookups stay flat as the table grows
+    printf("Lookup (this host)        entries   ns/lookup\n");
+    HostRandom rng(1);
+    for (uint16_t count : { 10, 1000, 60000 }) {
+        Bytes synthetic = syntheticPack(count, 0x12345678);
+        AssetPack big;
+        big.open(synthetic.data(), synthetic.size(), 0x12345678);
+        std::vector<uint16_t> ids(1 << 16);
+        for (uint16_t& id : ids) id = (uint16_t)(rng.uniform() * count);
+        volatile uint32_t sink = 0;
+        double perCall = timePerCall(ids.size() * 16, [&] {
+            uint32_t sum = 0;
+            for (int round = 0; round < 16; round++) {
+                for (uint16_t id : ids) sum += big.bitmap(id).bits[0];
+            }
+            sink = sum;
+        });
+        printf("  %-22s %8u %11.1f\n", count == 10 ? "bitmap(id)" : "", count, perCall * 1e9);
+    }
+
+    AssetPack mount;
+    double verify = timePerCall(1, [&] { mount.open(pack.data(), pack.size(), ASSET_SCHEMA, true); });
+    double noVerify = timePerCall(1, [&] { mount.open(pack.data(), pack.size(), ASSET_SCHEMA, false); });
+    printf("\nMount (this host): %.1f us with the SHA-256, %.2f us without\n", verify * 1e6, noVerify * 1e6);
+
+    AssetFont font = mount.font(FONT_UI);
+    if (font) {
+        GFXfont gfx = { (uint8_t*)font.bits, (GFXglyph*)font.glyphs, font.header->first, font.header->last,
+                        font.header->yAdvance };
+        const char* text = "Light rain expected after six, take an umbrella";
+        CountingCanvas canvas;
+        int16_t x1, y1;
+        uint16_t builtinWidth, packWidth, h;
+        canvas.setTextWrap(false);
+        canvas.getTextBounds(text, 0, 0, &x1, &y1, &builtinWidth, &h);
+        canvas.setFont(&gfx);
+        canvas.getTextBounds(text, 0, 0, &x1, &y1, &packWidth, &h);
+        double draw = timePerCall(1000, [&] {
+            for (int i = 0; i < 1000; i++) {
+                canvas.setCursor(0, font.header->ascent);
+                canvas.print(text);
+            }
+        });
+        printf("Text: \"%s\"\n  built-in 6x8 %u px wide, pack font %u px wide; %.1f us to draw from the pack\n",
+               text, builtinWidth, packWidth, draw * 1e6);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string packPath = ".pio/build/native_assets/assets.bin";
+    std::string manifestPath = "assets/assets.txt";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pack" && i + 1 < argc) packPath = argv[++i];
+        else if (arg == "--manifest" && i + 1 < argc) manifestPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--pack assets.bin] [--manifest assets/assets.txt]\n", argv[0]);
+            return 2;
+        }
+    }
+    Logger::setLogLevel(LOG_NONE);
+
+    Bytes pack;
+    std::vector<ManifestEntry> manifest;
+    if (!readFile(packPath, pack)) {
+        fprintf(stderr, "Cannot read %s; build it with: python scripts/asset_pack.py %s --out %s\n",
+                packPath.c_str(), manifestPath.c_str(), packPath.c_str());
+        return 2;
+    }
+    if (!readManifest(manifestPath, manifest)) {
+        fprintf(stderr, "Cannot read %s\n", manifestPath.c_str());
+        return 2;
+    }
+
+    AssetPack reader;
+    AssetPackError error = reader.open(pack.data(), pack.size(), ASSET_SCHEMA);
+    printf("%s: %zu bytes, %u assets, %s\n\n", packPath.c_str(), pack.size(), reader.size(),
+           assetPackErrorName(error));
+    if (error != ASSET_PACK_OK) {
+        fprintf(stderr, "Rebuild the pack and the firmware from the same manifest\n");
+        return 1;
+    }
+    report(pack, reader, manifest);
+
+    printf("\nChecks:\n");
+    Checks checks;
+    const std::map<std::string, AssetType> types = {
+        { "font", ASSET_FONT }, { "bitmap", ASSET_BITMAP }, { "prompt", ASSET_PROMPT }
+    };
+    bool typed = reader.size() == ASSET_COUNT && manifest.size() == ASSET_COUNT;
+    for (uint16_t id = 0; typed && id < reader.size(); id++) {
+        auto type = types.find(manifest[id].type);
+        typed = type != types.end() && reader.entry(id) && reader.entry(id)->type == type->second;
+    }
+    checks.expect(typed, "every AssetId is in the pack with its manifest type",
+                  String(ASSET_COUNT).c_str() + std::string(" ids"));
+    for (uint16_t id = 0; typed && id < reader.size(); id++) {
+        if (manifest[id].type == "font") checkFont(checks, reader, id, manifest[id]);
+        else if (manifest[id].type == "bitmap") checkBitmap(checks, reader, id, manifest[id]);
+        else checkPrompt(checks, reader, id, manifest[id]);
+    }
+    checkDamage(checks, pack, manifest);
+    devicePath(checks, pack);
+
+    printf("\n%s\n", checks.failed ? "Some checks FAILED" : "All checks passed");
+    return checks.failed ? 1 : 0;
+}
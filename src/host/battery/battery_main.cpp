@@ -0,0 +1,235 @@
+// Battery model harness (pio run -e native_battery).
+// Replays synthetic traces through BatteryModel the way PowerModule feeds
+// it, every 5 s from a 12-bit reading and a load estimate, against a cell
+// the model does not know exactly: 6% less capacity, 20% more resistance,
+// a polarization that relaxes for a minute after each load change and ADC
+// noise. Checks the reported percentage against the cell's true charge:
+//   - discharge: full to empty under idle listening with upload bursts
+//   - charge then discharge: a low cell plugged in until the charger stops,
+//     left on it, then unplugged and used again
+//
+// Usage: program [--seed N] [--noise mV]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "../host_random.h"
+#include "../../firmware/modules/battery_model.cpp"
+
+static const uint32_t SAMPLE_MS = 5000;          // PowerModule's CHECK_INTERVAL
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+// One LiPo cell on the curve the model uses, with its own capacity and
+// resistance plus an RC polarization
+struct Cell {
+    double capacityMah = 470;
+    double resistanceOhm = 0.18;
+    double polarizationOhm = 0.05;
+    double polarizationS = 60;
+    double soc;
+    double polarizationMv = 0;
+
+    explicit Cell(double soc) : soc(soc) {}
+
+    // currentMa > 0 discharges
+    void step(double currentMa, double seconds) {
+        soc -= currentMa * seconds / 3600.0 / capacityMah * 100.0;
+        soc = std::max(0.0, std::min(100.0, soc));
+        polarizationMv += (currentMa * polarizationOhm - polarizationMv) * (1 - exp(-seconds / polarizationS));
+    }
+
+    double terminalMv(double currentMa) const {
+        return BatteryModel::ocvFromSoc((float)soc) - currentMa * resistanceOhm - polarizationMv;
+    }
+};
+
+// The cell, its model and the running scores of one trace
+struct Trace {
+    Cell cell;
+    BatteryModel model;
+    HostRandom rng;
+    double noiseMv;
+    uint32_t seconds = 0;
+    double windowMah = 0;
+    uint32_t windowS = 0;
+
+    // Scores since the last reset
+    int rises = 0;
+    int falls = 0;
+    int jumps = 0;                  // Moves of more than 1% in one update
+    int changes = 0;
+    int chargingUpdates = 0;
+    double maxError = 0;
+    double errorSum = 0;
+    int updates = 0;
+    uint32_t since = 0;
+
+    Trace(double soc, uint64_t seed, double noiseMv) : cell(soc), rng(seed), noiseMv(noiseMv) {}
+
+    void reset() {
+        rises = falls = jumps = changes = chargingUpdates = updates = 0;
+        maxError = errorSum = 0;
+        since = seconds;
+    }
+
+    // The device's draw per cell: listening at the minimum clock with the
+    // radio dozing, and a 4 s command upload every 40 s
+    double loadMa() const {
+        return seconds % 40 < 4 ? 115.0 : 32.0;
+    }
+
+    // Runs for the given time; with the charger in, it feeds the device and
+    // charges the cell at 250 mA, then holds 4.2 V until the current falls
+    // to 25 mA and stops. Returns the time the model took to agree on the
+    // direction, or -1 if it never did.
+    double run(double hours, bool charger) {
+        double agreedAfter = -1;
+        uint32_t end = seconds + (uint32_t)(hours * 3600);
+        bool terminated = false;
+        while (seconds < end) {
+            double load = loadMa();
+            double current = load;
+            if (charger) {
+                double cvMa = (4200.0 - BatteryModel::ocvFromSoc((float)cell.soc) - cell.polarizationMv) /
+                              (cell.resistanceOhm + cell.polarizationOhm);
+                double chargeMa = terminated ? 0 : std::min(250.0, cvMa);
+                terminated = terminated || chargeMa < 25.0;
+                current = terminated ? 0 : -chargeMa;
+            }
+            cell.step(current, 1);
+            // PowerModule's estimate is the device's own draw, charger or not
+            windowMah += load;
+            windowS++;
+            seconds++;
+
+            if (windowS * 1000 >= SAMPLE_MS) {
+                double measured = cell.terminalMv(current) + noiseMv * rng.normal();
+                float terminalMv = (float)(lround(measured / 2 / 3300 * 4095) * 3300.0 / 4095 * 2);
+                float estimateMa = (float)(windowMah / windowS * 0.9);   // Estimates run 10% low
+                bool first = !model.isInitialized();
+                int before = model.getPercent();
+                model.update(terminalMv, estimateMa, windowS * 1000);
+                windowMah = 0;
+                windowS = 0;
+                if (!first) {
+                    score(before);
+                }
+                if (agreedAfter < 0 && model.isCharging() == (charger && !terminated)) {
+                    agreedAfter = seconds;
+                }
+                if (model.isCharging() != (charger && !terminated) && !(charger && terminated)) {
+                    agreedAfter = -1;
+                }
+            }
+        }
+        return agreedAfter;
+    }
+
+    void score(int before) {
+        int now = model.getPercent();
+        rises += now > before;
+        falls += now < before;
+        jumps += abs(now - before) > 1;
+        changes += now != before;
+        chargingUpdates += model.isCharging();
+        double error = fabs(now - cell.soc);
+        maxError = std::max(maxError, error);
+        errorSum += error;
+        updates++;
+    }
+
+    double hours() const {
+        return (seconds - since) / 3600.0;
+    }
+
+    std::string summary() const {
+        return format("max error %.1f%%, mean %.1f%%, ", maxError, updates ? errorSum / updates : 0) +
+               format("%.1f changes per hour", hours() > 0 ? changes / hours() : 0);
+    }
+};
+
+static void discharge(Checks& checks, uint64_t seed, double noiseMv) {
+    printf("Discharge (full to empty):\n");
+    Trace trace(100.0, seed, noiseMv);
+    double hours = 0;
+    while (trace.cell.soc > 3.0 && hours < 24) {
+        trace.run(0.1, false);
+        hours += 0.1;
+    }
+    printf("  %.1f h to 3%%, model at %d%%\n", hours, trace.model.getPercent());
+    checks.expect(trace.rises == 0 && trace.jumps == 0, "the percentage only steps down, 1% at a time",
+                  format("%.0f rises, %.0f jumps", trace.rises, trace.jumps));
+    checks.expect(trace.chargingUpdates == 0, "never taken for charging",
+                  format("%.0f updates", trace.chargingUpdates));
+    checks.expect(trace.maxError <= 8, "within 8% of the true charge throughout", trace.summary());
+}
+
+static void chargeThenDischarge(Checks& checks, uint64_t seed, double noiseMv) {
+    printf("\nCharge then discharge:\n");
+    Trace trace(20.0, seed, noiseMv);
+    trace.run(0.5, false);
+
+    trace.reset();
+    uint32_t plugged = trace.seconds;
+    double agreed = trace.run(3.0, true);
+    checks.expect(agreed >= 0 && agreed - plugged <= 60, "charging recognized within a minute of plugging in",
+                  agreed >= 0 ? format("after %.0f s", agreed - plugged) : "never");
+    checks.expect(trace.falls == 0 && trace.jumps == 0, "on the charger the percentage only steps up, 1% at a time",
+                  format("%.0f falls, %.0f jumps", trace.falls, trace.jumps));
+    checks.expect(trace.model.getPercent() >= 97, "full once the charger stops",
+                  format("%.0f%% for a true %.1f%%", trace.model.getPercent(), trace.cell.soc));
+    checks.expect(trace.maxError <= 10, "within 10% of the true charge while charging", trace.summary());
+
+    trace.reset();
+    uint32_t unplugged = trace.seconds;
+    agreed = trace.run(4.0, false);
+    checks.expect(agreed >= 0 && agreed - unplugged <= 30 * 60, "discharge recognized within 30 min of unplugging",
+                  agreed >= 0 ? format("after %.0f min", (agreed - unplugged) / 60.0) : "never");
+    checks.expect(trace.rises == 0 && trace.jumps == 0, "then the percentage only steps down, 1% at a time",
+                  format("%.0f rises, %.0f jumps", trace.rises, trace.jumps));
+    checks.expect(trace.maxError <= 8, "within 8% of the true charge after unplugging",
+                  trace.summary() + format(", ends at %.0f%% for a true %.1f%%", trace.model.getPercent(), trace.cell.soc));
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = 1;
+    double noiseMv = 6;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+            noiseMv = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--seed N] [--noise mV]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Checks checks;
+    discharge(checks, seed, noiseMv);
+    chargeThenDischarge(checks, seed, noiseMv);
+
+    if (checks.failed) {
+        printf("\n%d check(s) failed\n", checks.failed);
+        return 1;
+    }
+    printf("\nAll checks passed\n");
+    return 0;
+}
@@ -0,0 +1,559 @@
+// Host benchmarks for the firmware modules (pio run -e native -t exec).
+// The modules are compiled unchanged against the Arduino shim in src/host.
+// Compare against the stored baseline with scripts/bench_compare.py.
+
+#include <Arduino.h>
+#include <math.h>
+#include "benchmark.h"
+#include "../../firmware/modules/network_module.cpp"
+#include "../../firmware/drivers/display_driver.cpp"
+#include "../../firmware/drivers/audio_driver.cpp"
+#include "../../firmware/modules/touch_module.cpp"
+#include "../../firmware/modules/power_module.cpp"
+#include "../../firmware/dsp/wake_detector.cpp"
+#include "../../firmware/dsp/mic_frontend.cpp"
+#include "../../firmware/dsp/beamformer.cpp"
+#include "../../firmware/dsp/speech_enhancer.cpp"
+#include "../../firmware/dsp/audio_codec.cpp"
+#include "../../firmware/hal/gpio_hal.cpp"
+#include "../../firmware/utils/logger.cpp"
+
+// ---------------------------------------------------------------- Fixtures
+
+// Speech-like test signal: 200 Hz voiced tone under low noise
+static size_t speechSource(int16_t* out, size_t count) {
+    static uint32_t phase = 0;
+    static uint32_t noise = 1;
+    for (size_t i = 0; i < count; i++) {
+        noise = noise * 1103515245u + 12345u;
+        float tone = 3000.0f * sinf(2.0f * (float)M_PI * 200.0f * phase++ / AudioDriver::SAMPLE_RATE);
+        out[i] = (int16_t)(tone + (int16_t)(noise >> 16) / 64);
+    }
+    return count;
+}
+
+static HostHttpResponse echoServer(const HostHttpRequest& request) {
+    HostHttpResponse response;
+    response.code = 200;
+    response.body = "{\"response\":\"The weather today is sunny with a light breeze\"}";
+    response.latencyMs = 300;
+    return response;
+}
+
+// Discards output, counting bytes
+class NullPrint : public Print {
+public:
+    size_t write(uint8_t c) override { bytes++; return 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { bytes += size; return size; }
+    uint64_t bytes = 0;
+};
+
+// Records bytes like an SSD1306 on the bus
+class DisplaySink : public HostI2cDevice {
+public:
+    void onWrite(const uint8_t* data, size_t length) override { bytes += length; }
+    uint64_t bytes = 0;
+};
+
+struct BenchBoard {
+    NetworkModule network;
+    AudioDriver audio;
+    DisplayDriver display;
+    TouchModule touch;
+    PowerModule power;
+    DisplaySink oled;
+
+    BenchBoard() {
+        Logger::setLogLevel(LOG_NONE);
+        HostI2c::attach(Board::Display::ADDRESS, &oled);
+        HostI2s::setSource(I2S_NUM_0, speechSource);
+        HostHttp::setHandler(echoServer);
+        HostGpio::setMilliVolts(Board::Battery::PIN1, 1950);
+        HostGpio::setMilliVolts(Board::Battery::PIN2, 1940);
+
+        network.connect("bench", "bench");
+        audio.setNetworkModule(&network);
+        audio.begin();
+        display.begin();
+        touch.begin();
+        power.begin();
+    }
+};
+
+// Drivers own global peripherals (I2S port, PM locks), so they are set up once
+static BenchBoard& board() {
+    static BenchBoard instance;
+    return instance;
+}
+
+// ---------------------------------------------------------------- Audio
+
+static void BM_WakeDetector_Frame(benchmark::State& state) {
+    int16_t frame[256];
+    speechSource(frame, 256);
+    WakeDetector detector;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(detector.process(frame, 256));
+    }
+    state.SetItemsProcessed(state.iterations() * 256);
+}
+BENCHMARK(BM_WakeDetector_Frame);
+
+static void BM_AudioDriver_VoiceDetected(benchmark::State& state) {
+    AudioDriver& audio = board().audio;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(audio.voiceDetected());
+    }
+    state.SetItemsProcessed(state.iterations() * AudioDriver::BUFFER_SIZE);
+}
+BENCHMARK(BM_AudioDriver_VoiceDetected);
+
+static void BM_AudioDriver_GetVoiceCommand(benchmark::State& state) {
+    AudioDriver& audio = board().audio;
+    for (auto _ : state) {
+        String result = audio.getVoiceCommand();
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(state.iterations() * AudioDriver::SAMPLE_RATE * 2 * sizeof(int16_t));
+}
+BENCHMARK(BM_AudioDriver_GetVoiceCommand);
+
+// ---------------------------------------------------------------- Mic front end
+
+static const size_t MIC_BLOCK = 1536;      // 32 ms at 48 kHz
+
+// speechSource as the microphone sends it: 24-bit in a 32-bit slot, with DC offset
+static void micSlots(int32_t* raw, size_t count) {
+    static int16_t pcm[MIC_BLOCK];
+    speechSource(pcm, count);
+    for (size_t i = 0; i < count; i++) {
+        raw[i] = (pcm[i] * 256 + 40000) * 256;
+    }
+}
+
+// Reference: one pass per stage over a fresh block, the way the capture path
+// used to be written. The fused kernel must match it bit for bit.
+static size_t micStaged(const int32_t* raw, size_t frames, uint8_t decimation, int16_t* out) {
+    static int32_t wide[MIC_BLOCK];
+    static int32_t low[MIC_BLOCK];
+    for (size_t i = 0; i < frames; i++) {
+        wide[i] = raw[i] >> 8;
+    }
+
+    size_t count = frames;
+    if (decimation > 1) {
+        const int16_t* taps = decimation == 2 ? MicFrontEnd::FIR_2 : MicFrontEnd::FIR_3;
+        size_t length = MicFrontEnd::TAPS_PER_PHASE * decimation;
+        for (size_t i = 0; i < frames; i++) {
+            int64_t acc = 0;
+            for (size_t k = 0; k < length; k++) {
+                int32_t x = i + 1 + k >= length ? wide[i + 1 + k - length] : 0;
+                acc += (int64_t)x * taps[k];
+            }
+            low[i] = (int32_t)((acc + (1 << 14)) >> 15);
+        }
+        count = 0;
+        for (size_t i = decimation - 1; i < frames; i += decimation) {
+            wide[count++] = low[i];
+        }
+    }
+
+    int32_t previous = 0;
+    int32_t blocker = 0;
+    for (size_t i = 0; i < count; i++) {
+        blocker += (wide[i] - previous) * (1 << MicFrontEnd::DC_FRAC_BITS) - (blocker >> 8);
+        previous = wide[i];
+        wide[i] = blocker >> MicFrontEnd::DC_FRAC_BITS;
+    }
+    for (size_t i = 0; i < count; i++) {
+        int64_t scaled = ((int64_t)wide[i] * 256 + (1 << 15)) >> 16;
+        out[i] = scaled > 32767 ? 32767 : scaled < -32768 ? -32768 : (int16_t)scaled;
+    }
+    return count;
+}
+
+static void benchMicFrontEnd(benchmark::State& state, uint8_t decimation, bool fused) {
+    static int32_t raw[MIC_BLOCK];
+    static int16_t out[MIC_BLOCK + 1];
+    static int16_t reference[MIC_BLOCK + 1];
+    micSlots(raw, MIC_BLOCK);
+
+    MicFrontEndConfig config;
+    config.decimation = decimation;
+    MicFrontEnd frontEnd(config);
+    size_t count = frontEnd.process(raw, MIC_BLOCK, out);
+    if (micStaged(raw, MIC_BLOCK, decimation, reference) != count ||
+        memcmp(out, reference, count * sizeof(int16_t)) != 0) {
+        state.SkipWithError("fused kernel differs from the staged reference");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (fused) {
+            frontEnd.reset();
+            benchmark::DoNotOptimize(frontEnd.process(raw, MIC_BLOCK, out));
+        } else {
+            benchmark::DoNotOptimize(micStaged(raw, MIC_BLOCK, decimation, out));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * MIC_BLOCK);
+}
+
+static void BM_MicFrontEnd_Fused(benchmark::State& state) {
+    benchMicFrontEnd(state, 1, true);
+}
+BENCHMARK(BM_MicFrontEnd_Fused);
+
+static void BM_MicFrontEnd_Staged(benchmark::State& state) {
+    benchMicFrontEnd(state, 1, false);
+}
+BENCHMARK(BM_MicFrontEnd_Staged);
+
+// 48 -> 16 kHz: the fused kernel only computes the FIR outputs it keeps
+static void BM_MicFrontEnd_FusedDecimate3(benchmark::State& state) {
+    benchMicFrontEnd(state, 3, true);
+}
+BENCHMARK(BM_MicFrontEnd_FusedDecimate3);
+
+static void BM_MicFrontEnd_StagedDecimate3(benchmark::State& state) {
+    benchMicFrontEnd(state, 3, false);
+}
+BENCHMARK(BM_MicFrontEnd_StagedDecimate3);
+
+// ---------------------------------------------------------------- Beamformer
+
+static const size_t BEAM_FRAMES = 4096;
+static const uint16_t BEAM_MOUTH_DELAY_US = 44;
+
+// Two-mic capture of the mouth plus independent noise at each mic. The voice
+// is a sum of harmonics, so it can be evaluated at the exact fractional delay
+// the rear mic hears it.
+static void twoMicScene(int16_t* voice, int16_t* noise, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < frames; i++) {
+        for (uint8_t c = 0; c < 2; c++) {
+            double t = (double)i / AudioDriver::SAMPLE_RATE - c * BEAM_MOUTH_DELAY_US / 1e6;
+            double v = 0;
+            for (int harmonic = 1; harmonic <= 12; harmonic++) {
+                v += 1500.0 / harmonic * sin(2 * M_PI * 180.0 * harmonic * t + harmonic);
+            }
+            seed = seed * 1103515245u + 12345u;
+            voice[i * 2 + c] = (int16_t)lround(v);
+            noise[i * 2 + c] = (int16_t)((int16_t)(seed >> 16) / 16);
+        }
+    }
+}
+
+static double power(const int16_t* samples, size_t count, size_t stride) {
+    double sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += (double)samples[i * stride] * samples[i * stride];
+    }
+    return sum / count;
+}
+
+static void BM_Beamformer_TwoMic(benchmark::State& state) {
+    static int16_t voice[BEAM_FRAMES * 2];
+    static int16_t noise[BEAM_FRAMES * 2];
+    static int16_t mixed[BEAM_FRAMES * 2];
+    static int16_t out[BEAM_FRAMES];
+    twoMicScene(voice, noise, BEAM_FRAMES);
+    for (size_t i = 0; i < BEAM_FRAMES * 2; i++) {
+        mixed[i] = voice[i] + noise[i];
+    }
+
+    // SNR gain: the beamformer is linear, so voice and noise go through it apart
+    BeamformerConfig config;
+    config.mouthDelayUs = BEAM_MOUTH_DELAY_US;
+    Beamformer beamformer(config);
+    size_t settled = Beamformer::TAPS;
+    double snrIn = power(voice, BEAM_FRAMES, 2) / power(noise, BEAM_FRAMES, 2);
+    beamformer.process(voice, BEAM_FRAMES, out);
+    double voiceOut = power(out + settled, BEAM_FRAMES - settled, 1);
+    beamformer.reset();
+    beamformer.process(noise, BEAM_FRAMES, out);
+    double gainDb = 10 * log10(voiceOut / power(out + settled, BEAM_FRAMES - settled, 1) / snrIn);
+    if (gainDb < 2.5) {
+        state.SkipWithError("two-mic SNR gain below 2.5 dB");
+        return;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "snr_gain=%.1fdB", gainDb);
+    state.SetLabel(label);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(beamformer.process(mixed, BEAM_FRAMES, out));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * BEAM_FRAMES);
+}
+BENCHMARK(BM_Beamformer_TwoMic);
+
+// ---------------------------------------------------------------- Speech enhancer
+
+static const size_t ENHANCE_SAMPLES = SpeechEnhancer::HOP * 64;
+
+// Suppression and AGC on a tone in white noise; the harness in src/host/enhance
+// reports the SNR side, this tracks the cost per hop
+static void BM_SpeechEnhancer_Hop(benchmark::State& state) {
+    static int16_t in[ENHANCE_SAMPLES];
+    static int16_t out[ENHANCE_SAMPLES];
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < ENHANCE_SAMPLES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        double tone = 2000.0 * sin(2 * M_PI * 200.0 * i / AudioDriver::SAMPLE_RATE);
+        in[i] = (int16_t)(lround(tone) + (int16_t)(seed >> 16) / 32);
+    }
+    SpeechEnhancer enhancer;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(enhancer.process(in, ENHANCE_SAMPLES, out));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * ENHANCE_SAMPLES / SpeechEnhancer::HOP);
+}
+BENCHMARK(BM_SpeechEnhancer_Hop);
+
+// ---------------------------------------------------------------- Upload encoding
+
+static const size_t CODEC_SAMPLES = 8000;      // 500 ms chunk at 16 kHz
+
+static void encodeChunk(benchmark::State& state, const AudioFormat& format) {
+    static int16_t in[CODEC_SAMPLES];
+    for (size_t i = 0; i < CODEC_SAMPLES; i++) {
+        in[i] = (int16_t)lround(3000.0 * sin(2 * M_PI * 200.0 * i / AudioDriver::SAMPLE_RATE));
+    }
+    AudioEncoder encoder(AudioDriver::SAMPLE_RATE, format);
+    static uint8_t out[CODEC_SAMPLES * sizeof(int16_t)];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(encoder.encode(in, CODEC_SAMPLES, out));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * CODEC_SAMPLES);
+}
+
+static void BM_AudioEncoder_Adpcm16k(benchmark::State& state) {
+    encodeChunk(state, { 16000, CODEC_IMA_ADPCM });
+}
+BENCHMARK(BM_AudioEncoder_Adpcm16k);
+
+static void BM_AudioEncoder_Adpcm8k(benchmark::State& state) {
+    encodeChunk(state, { 8000, CODEC_IMA_ADPCM });
+}
+BENCHMARK(BM_AudioEncoder_Adpcm8k);
+
+// ---------------------------------------------------------------- Network
+
+static void BM_NetworkModule_SendCommand(benchmark::State& state) {
+    NetworkModule& network = board().network;
+    String command = "what is the weather like today";
+    for (auto _ : state) {
+        String response = network.sendCommand(command);
+        benchmark::DoNotOptimize(response);
+    }
+}
+BENCHMARK(BM_NetworkModule_SendCommand);
+
+static void BM_NetworkModule_PostMetrics(benchmark::State& state) {
+    NetworkModule& network = board().network;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(network.postMetrics());
+    }
+}
+BENCHMARK(BM_NetworkModule_PostMetrics);
+
+// ---------------------------------------------------------------- Display
+
+static void BM_DisplayDriver_ShowStatus(benchmark::State& state) {
+    DisplayDriver& display = board().display;
+    for (auto _ : state) {
+        display.showStatus("System Ready");
+    }
+}
+BENCHMARK(BM_DisplayDriver_ShowStatus);
+
+static void BM_DisplayDriver_ShowText(benchmark::State& state) {
+    DisplayDriver& display = board().display;
+    String text = "The weather today is sunny with a light breeze from the west";
+    for (auto _ : state) {
+        display.showText(text);
+    }
+}
+BENCHMARK(BM_DisplayDriver_ShowText);
+
+// ---------------------------------------------------------------- I2C bus
+
+// A register-mapped sensor sharing the bus with the display
+class SensorSink : public HostI2cDevice {
+public:
+    static const uint8_t ADDRESS = 0x48;
+};
+
+static void BM_I2cBus_Transfer(benchmark::State& state) {
+    board();
+    static SensorSink sensor;
+    HostI2c::attach(SensorSink::ADDRESS, &sensor);
+    I2cBus::addDevice(SensorSink::ADDRESS, 1000000);
+    const uint8_t reg = 0x00;
+    uint8_t value[2];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(I2cBus::transfer(SensorSink::ADDRESS, &reg, 1, value, sizeof(value)));
+    }
+}
+BENCHMARK(BM_I2cBus_Transfer);
+
+// Eight display commands queued back to back, merged by the bus task
+static void BM_I2cBus_QueuedCommands(benchmark::State& state) {
+    board();
+    static const uint8_t contrast[] = { 0x00, 0x81, 0x8F };
+    I2cFuture done;
+    for (auto _ : state) {
+        for (int i = 0; i < 8; i++) {
+            I2cTransaction transaction;
+            transaction.address = Board::Display::ADDRESS;
+            transaction.tx = contrast;
+            transaction.txLength = sizeof(contrast);
+            transaction.mergePrefix = 1;
+            transaction.future = i == 7 ? &done : nullptr;
+            I2cBus::submit(transaction);
+        }
+        done.wait();
+    }
+    state.SetItemsProcessed(state.iterations() * 8);
+}
+BENCHMARK(BM_I2cBus_QueuedCommands);
+
+// ---------------------------------------------------------------- Touch
+
+static void BM_TouchModule_Idle(benchmark::State& state) {
+    TouchModule& touch = board().touch;
+    HostGpio::setTouch(Board::Touch::PIN, HostGpio::TOUCH_IDLE);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(touch.checkTouch());
+    }
+}
+BENCHMARK(BM_TouchModule_Idle);
+
+static void BM_TouchModule_SingleTap(benchmark::State& state) {
+    TouchModule& touch = board().touch;
+    for (auto _ : state) {
+        HostGpio::setTouch(Board::Touch::PIN, 10);
+        touch.checkTouch();
+        delay(60);
+        HostGpio::setTouch(Board::Touch::PIN, HostGpio::TOUCH_IDLE);
+        touch.checkTouch();
+        benchmark::DoNotOptimize(touch.getGesture());
+        delay(400);   // Past the double-tap window
+    }
+}
+BENCHMARK(BM_TouchModule_SingleTap);
+
+// ---------------------------------------------------------------- GPIO
+// On the host these time the register mock; the on-target numbers come from
+// the gpio_toggle_bench sketch
+
+static void BM_GpioHal_DigitalWrite(benchmark::State& state) {
+    GpioHal::configurePin(Board::StatusLed::PIN, OUTPUT);
+    for (auto _ : state) {
+        GpioHal::digitalWrite(Board::StatusLed::PIN, HIGH);
+        GpioHal::digitalWrite(Board::StatusLed::PIN, LOW);
+    }
+}
+BENCHMARK(BM_GpioHal_DigitalWrite);
+
+static void BM_Pin_SetClear(benchmark::State& state) {
+    using Led = Pin<Board::StatusLed::PIN>;
+    Led::output();
+    for (auto _ : state) {
+        Led::set();
+        Led::clear();
+    }
+}
+BENCHMARK(BM_Pin_SetClear);
+
+static void BM_PinGroup_Write(benchmark::State& state) {
+    using Group = PinGroup<38, 39, 40, 41>;
+    Group::output();
+    uint32_t bits = 0;
+    for (auto _ : state) {
+        Group::write(bits++);
+    }
+}
+BENCHMARK(BM_PinGroup_Write);
+
+static void IRAM_ATTR countEdge(const GpioEdge& edge, void* context) {
+    ++*static_cast<uint32_t*>(context);
+}
+
+static void BM_GpioIsr_Dispatch(benchmark::State& state) {
+    static uint32_t edges = 0;
+    GpioIsr::attach(Board::Buttons::MODE, countEdge, &edges, GPIO_INTR_ANYEDGE);
+    uint8_t level = 0;
+    for (auto _ : state) {
+        HostGpio::inject(Board::Buttons::MODE, level ^= 1);
+    }
+    GpioIsr::detach(Board::Buttons::MODE);
+    benchmark::DoNotOptimize(edges);
+}
+BENCHMARK(BM_GpioIsr_Dispatch);
+
+// ---------------------------------------------------------------- Power
+
+static void BM_PowerModule_CheckStatus(benchmark::State& state) {
+    PowerModule& power = board().power;
+    for (auto _ : state) {
+        delay(5000);   // One sampling interval of simulated time
+        power.checkStatus();
+    }
+}
+BENCHMARK(BM_PowerModule_CheckStatus);
+
+static void BM_BatteryModel_Update(benchmark::State& state) {
+    BatteryModel model;
+    uint32_t step = 0;
+    for (auto _ : state) {
+        // Sweep the curve so every run sees the same mix of segments
+        model.update(4200.0f - (step++ % 900), 70.0f, 5000);
+        benchmark::DoNotOptimize(model.getPercent());
+    }
+}
+BENCHMARK(BM_BatteryModel_Update);
+
+static void BM_PmLockGuard(benchmark::State& state) {
+    board();
+    for (auto _ : state) {
+        PmLockGuard lock(PM_WORK_DSP);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_PmLockGuard);
+
+// ---------------------------------------------------------------- Telemetry
+
+static void BM_Metrics_Observe(benchmark::State& state) {
+    uint32_t value = 1;
+    for (auto _ : state) {
+        Metrics::observe(NET_LATENCY_MS, value);
+        value = value * 7 % 5000 + 1;
+    }
+}
+BENCHMARK(BM_Metrics_Observe);
+
+static void BM_Metrics_Snapshot(benchmark::State& state) {
+    NullPrint out;
+    for (auto _ : state) {
+        Metrics::writeSnapshot(out);
+    }
+    benchmark::DoNotOptimize(out.bytes);
+}
+BENCHMARK(BM_Metrics_Snapshot);
+
+static void BM_Trace_Span(benchmark::State& state) {
+    for (auto _ : state) {
+        TRACE_SPAN(TRACE_ENCODE);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_Trace_Span);
+
+BENCHMARK_MAIN();
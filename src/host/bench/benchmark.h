@@ -0,0 +1,292 @@
+#ifndef HOST_BENCHMARK_H
+#define HOST_BENCHMARK_H
+
+// Small subset of the Google Benchmark API, enough to write benchmarks the
+// same way without the dependency:
+//
+//   static void BM_Name(benchmark::State& state) {
+//       setup();
+//       for (auto _ : state) { work(); }
+//   }
+//   BENCHMARK(BM_Name);
+//   BENCHMARK_MAIN();
+//
+// Each benchmark is run with a growing iteration count until one run takes at
+// least --benchmark_min_time seconds, then repeated (--benchmark_repetitions)
+// and the fastest repetition is reported: on a shared machine interference
+// only ever adds time, so the minimum is the most repeatable figure for a
+// regression check. Times are per-thread CPU time, so helper threads and
+// HostClock skips do not count.
+//
+// Flags: --benchmark_filter=<substring>, --benchmark_min_time=<s>,
+//        --benchmark_repetitions=<n>, --benchmark_format=console|json,
+//        --benchmark_out=<file> (always JSON, Google Benchmark layout)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+inline uint64_t threadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+inline uint64_t wallNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+template<typename T>
+inline void DoNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ClobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+class State {
+public:
+    explicit State(uint64_t iterations) : maxIterations(iterations) {}
+
+    // Non-trivial so "for (auto _ : state)" does not warn about an unused variable
+    struct Value {
+        ~Value() {}
+    };
+
+    class Iterator {
+    public:
+        Iterator(State* state, uint64_t remaining) : state(state), remaining(remaining) {}
+        Value operator*() const { return Value(); }
+        Iterator& operator++() { --remaining; return *this; }
+        bool operator!=(const Iterator&) const {
+            if (remaining != 0) return true;
+            state->finish();
+            return false;
+        }
+    private:
+        State* state;
+        uint64_t remaining;
+    };
+
+    Iterator begin() {
+        resumeTiming();
+        return Iterator(this, maxIterations);
+    }
+
+    Iterator end() {
+        return Iterator(this, 0);
+    }
+
+    // Exclude per-iteration setup from the measurement
+    void PauseTiming() {
+        cpuNs += threadCpuNs() - cpuStart;
+        realNs += wallNs() - realStart;
+    }
+
+    void ResumeTiming() {
+        resumeTiming();
+    }
+
+    void SetItemsProcessed(int64_t items) { itemsProcessed = items; }
+    void SetBytesProcessed(int64_t bytes) { bytesProcessed = bytes; }
+    void SetLabel(const std::string& text) { label = text; }
+    void SkipWithError(const char* message) { error = message; }
+
+    uint64_t iterations() const { return maxIterations; }
+
+    uint64_t maxIterations;
+    uint64_t cpuNs = 0;
+    uint64_t realNs = 0;
+    int64_t itemsProcessed = 0;
+    int64_t bytesProcessed = 0;
+    std::string label;
+    std::string error;
+
+private:
+    uint64_t cpuStart = 0;
+    uint64_t realStart = 0;
+
+    void resumeTiming() {
+        cpuStart = threadCpuNs();
+        realStart = wallNs();
+    }
+
+    void finish() {
+        PauseTiming();
+    }
+};
+
+typedef void (*Function)(State&);
+
+struct Registration {
+    const char* name;
+    Function function;
+};
+
+inline std::vector<Registration>& registry() {
+    static std::vector<Registration> benchmarks;
+    return benchmarks;
+}
+
+inline int registerBenchmark(const char* name, Function function) {
+    registry().push_back({ name, function });
+    return 0;
+}
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double realNs;       // Per iteration
+    double cpuNs;
+    double itemsPerSecond;
+    double bytesPerSecond;
+    std::string label;
+    std::string error;
+};
+
+inline Result runOne(const Registration& bench, double minTimeSeconds, int repetitions) {
+    // Find an iteration count that fills the minimum time
+    uint64_t iterations = 1;
+    State probe(iterations);
+    while (true) {
+        probe = State(iterations);
+        bench.function(probe);
+        if (!probe.error.empty() || probe.cpuNs >= minTimeSeconds * 1e9 || iterations >= 1000000000ull) break;
+        double scale = probe.cpuNs > 0 ? minTimeSeconds * 1e9 * 1.4 / probe.cpuNs : 10.0;
+        scale = std::min(std::max(scale, 2.0), 10.0);
+        iterations = (uint64_t)(iterations * scale);
+    }
+
+    Result result = { bench.name, iterations, 0, 0, 0, 0, probe.label, probe.error };
+    if (!probe.error.empty()) {
+        return result;
+    }
+
+    std::vector<State> runs;
+    runs.push_back(probe);
+    for (int i = 1; i < repetitions; i++) {
+        State state(iterations);
+        bench.function(state);
+        runs.push_back(state);
+    }
+    const State& best = *std::min_element(runs.begin(), runs.end(),
+                                          [](const State& a, const State& b) { return a.cpuNs < b.cpuNs; });
+
+    result.cpuNs = (double)best.cpuNs / iterations;
+    result.realNs = (double)best.realNs / iterations;
+    double seconds = best.cpuNs / 1e9;
+    if (seconds > 0) {
+        result.itemsPerSecond = best.itemsProcessed / seconds;
+        result.bytesPerSecond = best.bytesProcessed / seconds;
+    }
+    return result;
+}
+
+inline void writeJson(FILE* out, const std::vector<Result>& results, double minTime, int repetitions) {
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(out, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"min_time\": %.3f,\n    \"repetitions\": %d\n  },\n",
+            date, minTime, repetitions);
+    fprintf(out, "  \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(out, "%s\n    {\n      \"name\": \"%s\",\n      \"iterations\": %llu,\n"
+                     "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\"",
+                i ? "," : "", r.name.c_str(), (unsigned long long)r.iterations, r.realNs, r.cpuNs);
+        if (r.itemsPerSecond > 0) fprintf(out, ",\n      \"items_per_second\": %.1f", r.itemsPerSecond);
+        if (r.bytesPerSecond > 0) fprintf(out, ",\n      \"bytes_per_second\": %.1f", r.bytesPerSecond);
+        if (!r.label.empty()) fprintf(out, ",\n      \"label\": \"%s\"", r.label.c_str());
+        if (!r.error.empty()) fprintf(out, ",\n      \"error_occurred\": true,\n      \"error_message\": \"%s\"", r.error.c_str());
+        fprintf(out, "\n    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+inline void writeConsole(FILE* out, const std::vector<Result>& results) {
+    fprintf(out, "%-40s %14s %14s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+    fprintf(out, "%s\n", std::string(83, '-').c_str());
+    for (const Result& r : results) {
+        if (!r.error.empty()) {
+            fprintf(out, "%-40s ERROR: %s\n", r.name.c_str(), r.error.c_str());
+            continue;
+        }
+        fprintf(out, "%-40s %11.0f ns %11.0f ns %12llu", r.name.c_str(), r.realNs, r.cpuNs,
+                (unsigned long long)r.iterations);
+        if (r.itemsPerSecond > 0) fprintf(out, " items/s=%.3g", r.itemsPerSecond);
+        if (r.bytesPerSecond > 0) fprintf(out, " bytes/s=%.3g", r.bytesPerSecond);
+        if (!r.label.empty()) fprintf(out, " %s", r.label.c_str());
+        fprintf(out, "\n");
+    }
+}
+
+inline int runSpecifiedBenchmarks(int argc, char** argv) {
+    std::string filter;
+    std::string format = "console";
+    std::string outPath;
+    double minTime = 0.2;
+    int repetitions = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (!strncmp(arg, "--benchmark_filter=", 19)) filter = arg + 19;
+        else if (!strncmp(arg, "--benchmark_min_time=", 21)) minTime = atof(arg + 21);
+        else if (!strncmp(arg, "--benchmark_repetitions=", 24)) repetitions = std::max(1, atoi(arg + 24));
+        else if (!strncmp(arg, "--benchmark_format=", 19)) format = arg + 19;
+        else if (!strncmp(arg, "--benchmark_out=", 16)) outPath = arg + 16;
+        else {
+            fprintf(stderr, "Unknown flag: %s\n", arg);
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    for (const Registration& bench : registry()) {
+        if (!filter.empty() && strstr(bench.name, filter.c_str()) == nullptr) continue;
+        results.push_back(runOne(bench, minTime, repetitions));
+    }
+
+    if (format == "json") {
+        writeJson(stdout, results, minTime, repetitions);
+    } else {
+        writeConsole(stdout, results);
+    }
+    if (!outPath.empty()) {
+        FILE* out = fopen(outPath.c_str(), "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+            return 1;
+        }
+        writeJson(out, results, minTime, repetitions);
+        fclose(out);
+    }
+
+    for (const Result& r : results) {
+        if (!r.error.empty()) return 1;
+    }
+    return 0;
+}
+
+}  // namespace benchmark
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+#define BENCHMARK(function) \
+    static int BENCHMARK_CONCAT(benchmarkRegistration_, __LINE__) = \
+        ::benchmark::registerBenchmark(#function, function)
+
+#define BENCHMARK_MAIN() \
+    int main(int argc, char** argv) { return ::benchmark::runSpecifiedBenchmarks(argc, argv); }
+
+#endif
@@ -0,0 +1,608 @@
+// Response cache harness (pio run -e native_cache).
+// Checks ResponseCache's rules (normalization, hints, expiry, LRU, the flash
+// ring across restarts, invalidation, damaged records), then replays a
+// synthetic week of questions and reports the hit ratio of RAM-only and
+// RAM + flash caches against an unbounded one, and the lookup cost. Last,
+// the real NetworkModule answers repeats from the cache against a stand-in
+// server that sends transcripts, Date, Cache-Control and X-Cache-Invalidate.
+//
+// Usage: program [--days N] [--seed N]
+//
+// The week: questions come every 90 s on average over 8-hour shifts, the
+// glasses restart every night. Two thirds are drawn from a catalog with
+// Zipf popularity (where parts are, part numbers, stock levels, the time),
+// the rest are one-off questions about orders. Each is worded a little
+// differently every time: case, fillers, punctuation. Mid-week, the answers
+// to the five most asked questions change and the server invalidates them.
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../host_random.h"
+#include "../../firmware/modules/network_module.cpp"
+
+static const uint32_t EPOCH = 1790000000;              // Server clock at the start
+static const uint32_t DEFAULT_TTL_S = 600;
+static const uint32_t MAX_TTL_S = 7 * 24 * 3600;
+static const uint32_t SHIFT_S = 8 * 3600;
+static const double MEAN_GAP_S = 90.0;
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+static std::string httpDate(uint32_t epoch) {
+    time_t t = epoch;
+    struct tm parts;
+    gmtime_r(&t, &parts);
+    char text[40];
+    strftime(text, sizeof(text), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    return text;
+}
+
+// The cache's flash tier on the simulated "rcache" partition
+static CacheFlash partitionFlash() {
+    CacheFlash flash;
+    flash.read = [](void* context, uint32_t offset, void* data, size_t length) {
+        return esp_partition_read((const esp_partition_t*)context, offset, data, length) == ESP_OK;
+    };
+    flash.write = [](void* context, uint32_t offset, const void* data, size_t length) {
+        return esp_partition_write((const esp_partition_t*)context, offset, data, length) == ESP_OK;
+    };
+    flash.erase = [](void* context, uint32_t offset, size_t length) {
+        return esp_partition_erase_range((const esp_partition_t*)context, offset, length) == ESP_OK;
+    };
+    flash.context = &HostFlash::responseCache;
+    flash.size = HostFlash::responseCache.size;
+    return flash;
+}
+
+static void eraseFlash() {
+    esp_partition_erase_range(&HostFlash::responseCache, 0, HostFlash::responseCache.size);
+}
+
+// ---------------------------------------------------------------- Rules
+
+template <uint8_t N>
+static bool hits(ResponseCache<N>& cache, const char* question, uint32_t now, const char* answer = nullptr) {
+    char out[ResponseCache<N>::MAX_TEXT + 1];
+    CacheTier tier = cache.lookup(cacheKey(question), now, out, sizeof(out));
+    return tier != CACHE_MISS && (answer == nullptr || strcmp(out, answer) == 0);
+}
+
+template <uint8_t N>
+static void put(ResponseCache<N>& cache, const char* question, const char* answer, uint32_t now, uint32_t ttl = 3600) {
+    cache.store(cacheKey(question), answer, strlen(answer), now + ttl, now);
+}
+
+static void rules(Checks& checks) {
+    uint64_t key = cacheKey("Where are the M6 bolts?");
+    bool folded = cacheKey("um, where are the m6 bolts please") == key &&
+                  cacheKey("  WHERE are the M6 bolts") == key && cacheKey("where-are-the-m6-bolts!") == key;
+    checks.expect(folded, "case, punctuation, spacing and fillers fold to one key");
+    checks.expect(cacheKey("Where are the M8 bolts?") != key && cacheKey("Where are the M6 bolts umbrella?") != key,
+                  "a different word is a different key");
+    checks.expect(cacheKey("Wo sind die Schrauben für M6?") == cacheKey("wo sind die schrauben für m6"),
+                  "UTF-8 letters stay part of a word");
+
+    CacheHint hint = parseCacheControl("public, max-age=120", DEFAULT_TTL_S, MAX_TTL_S);
+    CacheHint none = parseCacheControl("", DEFAULT_TTL_S, MAX_TTL_S);
+    CacheHint noStore = parseCacheControl("no-store", DEFAULT_TTL_S, MAX_TTL_S);
+    CacheHint capped = parseCacheControl("max-age=99999999999", DEFAULT_TTL_S, MAX_TTL_S);
+    CacheHint zero = parseCacheControl("max-age=0", DEFAULT_TTL_S, MAX_TTL_S);
+    checks.expect(hint.store && hint.ttlS == 120 && none.store && none.ttlS == DEFAULT_TTL_S && !noStore.store &&
+                  capped.ttlS == MAX_TTL_S && !zero.store, "Cache-Control: max-age, default, no-store, cap, zero");
+    checks.expect(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT") == 784111777 &&
+                  parseHttpDate(httpDate(EPOCH).c_str()) == EPOCH && parseHttpDate("yesterday") == 0,
+                  "HTTP Date parses to seconds since 1970");
+
+    uint32_t now = EPOCH;
+    ResponseCache<4> ram;
+    put(ram, "where are the m6 bolts", "Aisle 4, bin 12", now, 60);
+    checks.expect(hits(ram, "Where are the M6 bolts?", now + 59, "Aisle 4, bin 12"), "stored answer is found under another wording");
+    checks.expect(!hits(ram, "Where are the M6 bolts?", now + 60), "expired answer misses");
+    std::string tooLong(ResponseCache<4>::MAX_TEXT + 1, 'x');
+    checks.expect(!ram.store(cacheKey("long"), tooLong.c_str(), tooLong.size(), now + 60, now) && !hits(ram, "long", now),
+                  "answer over MAX_TEXT is not kept");
+
+    // Five questions in four slots: the least recently used goes
+    const char* questions[] = { "q one", "q two", "q three", "q four", "q five" };
+    for (int i = 0; i < 4; i++) put(ram, questions[i], "answer", now);
+    hits(ram, questions[0], now + 1);
+    put(ram, questions[4], "answer", now + 2);
+    checks.expect(hits(ram, questions[0], now + 3) && !hits(ram, questions[1], now + 3) &&
+                  hits(ram, questions[4], now + 3), "full RAM tier evicts the least recently used");
+
+    // Flash tier: evicted entries spill, survive a restart, come back to RAM
+    eraseFlash();
+    {
+        ResponseCache<4> cache;
+        cache.attach(partitionFlash());
+        for (int i = 0; i < 5; i++) put(cache, questions[i], questions[i], now + i);
+        char out[ResponseCache<4>::MAX_TEXT + 1];
+        uint32_t spills = cache.getStats().spills;
+        CacheTier tier = cache.lookup(cacheKey(questions[0]), now + 10, out, sizeof(out));
+        checks.expect(tier == CACHE_FLASH && strcmp(out, questions[0]) == 0 && spills == 1,
+                      "evicted answer spills to flash and is found there");
+        tier = cache.lookup(cacheKey(questions[0]), now + 11, out, sizeof(out));
+        checks.expect(tier == CACHE_RAM, "a flash hit is copied back into RAM");
+    }
+    {
+        ResponseCache<4> restarted;
+        restarted.attach(partitionFlash());
+        checks.expect(hits(restarted, questions[0], now + 20, questions[0]) &&
+                      hits(restarted, questions[1], now + 20, questions[1]) && !hits(restarted, questions[4], now + 20),
+                      "spilled answers survive a restart, RAM-only ones do not");
+        checks.expect(restarted.invalidate("0000000000000000") == 0 && restarted.invalidate("x, 00000000") == 0,
+                      "unknown or malformed keys drop nothing");
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)cacheKey(questions[1]));
+        checks.expect(restarted.invalidate(hex) == 1 && !hits(restarted, questions[1], now + 21),
+                      "X-Cache-Invalidate key drops the answer");
+    }
+    {
+        ResponseCache<4> restarted;
+        restarted.attach(partitionFlash());
+        checks.expect(!hits(restarted, questions[1], now + 22) && hits(restarted, questions[0], now + 22),
+                      "a dropped answer stays dropped after a restart");
+        checks.expect(restarted.invalidate("*") >= 1 && !hits(restarted, questions[0], now + 23),
+                      "X-Cache-Invalidate * drops everything");
+    }
+    {
+        ResponseCache<4> restarted;
+        restarted.attach(partitionFlash());
+        checks.expect(restarted.countKept() == 0, "and that too survives a restart");
+    }
+
+    // Damaged and torn records
+    eraseFlash();
+    {
+        ResponseCache<1> cache;
+        cache.attach(partitionFlash());
+        put(cache, "first", "answer one", now);
+        put(cache, "second", "answer two", now);        // Spills "first" to record 0
+        put(cache, "third", "answer three", now);       // Spills "second" to record 1
+    }
+    std::vector<uint8_t>& bytes = HostFlash::data(&HostFlash::responseCache);
+    bytes[ResponseCache<1>::RECORD_HEADER + 2] &= 0xFE;            // A bit of "answer one"
+    bytes[ResponseCache<1>::RECORD_BYTES * 2 + 8] = 0x00;          // Record 2: body, no state
+    {
+        ResponseCache<1> restarted;
+        restarted.attach(partitionFlash());
+        checks.expect(!hits(restarted, "first", now + 1) && hits(restarted, "second", now + 1, "answer two"),
+                      "record with a flipped bit is ignored, its neighbour is not");
+        put(restarted, "fourth", "answer four", now + 2);
+        put(restarted, "fifth", "answer five", now + 2);        // Spills past the torn record
+        ResponseCache<1> again;
+        again.attach(partitionFlash());
+        checks.expect(hits(again, "fourth", now + 3, "answer four"),
+                      "a torn record is never read and the ring moves past it");
+    }
+
+    // The ring: three times as many spills as records
+    eraseFlash();
+    {
+        ResponseCache<1> cache;
+        cache.attach(partitionFlash());
+        size_t records = cache.getRecordCount();
+        char question[32];
+        for (size_t i = 0; i < 3 * records + 1; i++) {
+            snprintf(question, sizeof(question), "question %zu", i);
+            put(cache, question, question, now);
+        }
+        size_t found = 0;
+        for (size_t i = 0; i < 3 * records; i++) {
+            snprintf(question, sizeof(question), "question %zu", i);
+            found += hits(cache, question, now + 1, question);
+        }
+        ResponseCache<1> restarted;
+        restarted.attach(partitionFlash());
+        snprintf(question, sizeof(question), "question %zu", 3 * records - 1);
+        bool newest = hits(restarted, question, now + 2, question);
+        snprintf(question, sizeof(question), "question %d", 0);
+        bool oldest = hits(restarted, question, now + 2);
+        checks.expect(found >= records - ResponseCache<1>::SECTOR_BYTES / ResponseCache<1>::RECORD_BYTES &&
+                      found <= records && newest && !oldest,
+                      format("wrapping ring keeps the newest records: %.0f of %.0f found", found, records));
+    }
+}
+
+// ---------------------------------------------------------------- Workload
+
+struct Question {
+    std::string text;
+    bool store;
+    uint32_t ttlS;
+    uint32_t version = 1;
+};
+
+struct Ask {
+    uint32_t at;                    // Seconds from the start
+    int question;                   // Index into the catalog, or -1 for a one-off
+    std::string words;
+    bool restartBefore;
+};
+
+struct Workload {
+    std::vector<Question> catalog;
+    std::vector<Ask> asks;
+    std::vector<int> popular;       // Most asked first
+    uint32_t changeAt;              // When the popular answers change
+    size_t oneOffs = 0;
+};
+
+static std::string reword(const std::string& text, HostRandom& rng) {
+    std::string words = text;
+    double r = rng.uniform();
+    if (r < 0.3) {
+        for (char& c : words) c = tolower(c);
+    } else if (r < 0.4) {
+        for (char& c : words) c = toupper(c);
+    }
+    if (rng.uniform() < 0.3 && !words.empty() && words.back() == '?') words.pop_back();
+    if (rng.uniform() < 0.2) words = "um, " + words;
+    if (rng.uniform() < 0.15) words += " please";
+    if (rng.uniform() < 0.1) {
+        size_t space = words.find(' ');
+        if (space != std::string::npos) words.insert(space, " ");
+    }
+    return words;
+}
+
+static Workload makeWorkload(int days, HostRandom& rng) {
+    static const char* const PARTS[] = {
+        "M3 screws", "M4 screws", "M5 screws", "M6 bolts", "M8 bolts", "M10 bolts", "M12 bolts", "wing nuts",
+        "hinge brackets", "corner brackets", "drawer slides", "cable ties", "zip ties", "rivets", "washers",
+        "spring pins", "dowels", "shelf pins", "door handles", "cam locks", "gas struts", "castor wheels",
+        "rubber feet", "edge banding", "wood glue", "epoxy", "sandpaper", "drill bits", "saw blades", "router bits",
+        "hex keys", "torx bits", "safety glasses", "ear defenders", "gloves", "dust masks", "pallets", "shrink wrap",
+        "tape guns", "label rolls"
+    };
+    Workload w;
+    for (const char* part : PARTS) {
+        w.catalog.push_back({ std::string("Where are the ") + part + "?", true, 24 * 3600 });
+        w.catalog.push_back({ std::string("What is the part number for the ") + part + "?", true, 7 * 24 * 3600 });
+        w.catalog.push_back({ std::string("How many ") + part + " are in stock?", true, 300 });
+    }
+    w.catalog.push_back({ "What time is it?", false, 0 });
+    w.catalog.push_back({ "Who is on shift at the front desk?", true, 3600 });
+    w.catalog.push_back({ "Is the blue forklift charged?", true, 900 });
+
+    // Zipf popularity over a shuffled catalog
+    std::vector<int> order(w.catalog.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+    for (size_t i = order.size() - 1; i > 0; i--) std::swap(order[i], order[rng.next() % (i + 1)]);
+    std::vector<double> cdf;
+    double total = 0;
+    for (size_t rank = 0; rank < order.size(); rank++) {
+        total += 1.0 / pow(rank + 1, 1.0);
+        cdf.push_back(total);
+    }
+    w.popular.assign(order.begin(), order.begin() + 5);
+
+    for (int day = 0; day < days; day++) {
+        double t = day * 86400.0;
+        bool restart = day > 0;
+        while (true) {
+            t += rng.exponential(MEAN_GAP_S);
+            if (t >= day * 86400.0 + SHIFT_S) break;
+            Ask ask = { (uint32_t)t, -1, "", restart };
+            restart = false;
+            if (rng.uniform() < 2.0 / 3.0) {
+                double pick = rng.uniform() * total;
+                size_t rank = std::lower_bound(cdf.begin(), cdf.end(), pick) - cdf.begin();
+                ask.question = order[std::min(rank, order.size() - 1)];
+                ask.words = reword(w.catalog[ask.question].text, rng);
+            } else {
+                char text[64];
+                snprintf(text, sizeof(text), "What is the status of order %06u?", (unsigned)(rng.next() % 1000000));
+                ask.words = text;
+                w.oneOffs++;
+            }
+            w.asks.push_back(ask);
+        }
+    }
+    w.changeAt = (uint32_t)((days / 2) * 86400 + SHIFT_S / 2);
+    return w;
+}
+
+static std::string answerFor(const Workload& w, int question, uint32_t version) {
+    // 40 to 180 characters, fixed per question and version
+    HostRandom rng((uint64_t)question * 1000 + version);
+    std::string answer = "Answer " + std::to_string(question) + " v" + std::to_string(version) + ":";
+    size_t length = 40 + rng.next() % 141;
+    while (answer.size() < length) answer += " lorem";
+    answer.resize(length);
+    return answer;
+}
+
+struct Replay {
+    size_t asked = 0;
+    size_t hits = 0;
+    size_t flashHits = 0;
+    size_t stale = 0;               // Hits with an answer the server had replaced
+    double flashKbWritten = 0;
+    size_t sectorErases = 0;
+};
+
+// Answers the week's questions through a cache of N entries, with or
+// without the flash tier; the server's answers and hints as in the catalog
+template <uint8_t N>
+static Replay replay(const Workload& source, bool withFlash) {
+    Workload w = source;
+    Replay result;
+    eraseFlash();
+    ResponseCache<N>* cache = new ResponseCache<N>();
+    if (withFlash) cache->attach(partitionFlash());
+    bool changed = false;
+    char out[ResponseCache<N>::MAX_TEXT + 1];
+    for (const Ask& ask : w.asks) {
+        uint32_t now = EPOCH + ask.at;
+        if (ask.restartBefore) {
+            // Overnight restart: RAM is gone, flash is indexed again
+            ResponseCache<N>* fresh = new ResponseCache<N>();
+            if (withFlash) fresh->attach(partitionFlash());
+            result.flashKbWritten += cache->getStats().flashBytesWritten / 1024.0;
+            result.sectorErases += cache->getStats().sectorErases;
+            delete cache;
+            cache = fresh;
+        }
+        if (!changed && ask.at >= w.changeAt) {
+            changed = true;
+            std::string header;
+            for (int q : w.popular) {
+                w.catalog[q].version++;
+                char hex[18];
+                snprintf(hex, sizeof(hex), "%s%016llx", header.empty() ? "" : ",",
+                         (unsigned long long)cacheKey(w.catalog[q].text.c_str()));
+                header += hex;
+            }
+            cache->invalidate(header.c_str());
+        }
+
+        result.asked++;
+        uint64_t key = cacheKey(ask.words.c_str());
+        CacheTier tier = cache->lookup(key, now, out, sizeof(out));
+        std::string answer = ask.question >= 0 ? answerFor(w, ask.question, w.catalog[ask.question].version)
+                                               : "Order " + ask.words.substr(28, 6) + " ships tomorrow";
+        if (tier != CACHE_MISS) {
+            result.hits++;
+            result.flashHits += tier == CACHE_FLASH;
+            result.stale += answer != out;
+            continue;
+        }
+        CacheHint hint = { true, DEFAULT_TTL_S };
+        if (ask.question >= 0) {
+            const Question& q = w.catalog[ask.question];
+            hint = { q.store, q.ttlS };
+        }
+        if (hint.store) cache->store(key, answer.c_str(), answer.size(), now + hint.ttlS, now);
+    }
+    result.flashKbWritten += cache->getStats().flashBytesWritten / 1024.0;
+    result.sectorErases += cache->getStats().sectorErases;
+    delete cache;
+    return result;
+}
+
+// Unbounded, never restarted, same TTLs and invalidation: the ceiling
+static Replay replayIdeal(const Workload& source) {
+    Workload w = source;
+    Replay result;
+    std::unordered_map<uint64_t, uint32_t> expiry;
+    bool changed = false;
+    for (const Ask& ask : w.asks) {
+        uint32_t now = EPOCH + ask.at;
+        if (!changed && ask.at >= w.changeAt) {
+            changed = true;
+            for (int q : w.popular) expiry.erase(cacheKey(w.catalog[q].text.c_str()));
+        }
+        result.asked++;
+        uint64_t key = cacheKey(ask.words.c_str());
+        auto it = expiry.find(key);
+        if (it != expiry.end() && it->second > now) {
+            result.hits++;
+            continue;
+        }
+        bool store = true;
+        uint32_t ttl = DEFAULT_TTL_S;
+        if (ask.question >= 0) {
+            store = w.catalog[ask.question].store;
+            ttl = w.catalog[ask.question].ttlS;
+        }
+        if (store) expiry[key] = now + ttl;
+    }
+    return result;
+}
+
+static void lookupCost(Checks& checks, const Workload& w) {
+    eraseFlash();
+    ResponseCache<32>* cache = new ResponseCache<32>();
+    cache->attach(partitionFlash());
+    uint32_t now = EPOCH;
+    // 32 in RAM, the previous 200 spilled to flash
+    std::vector<std::string> questions;
+    for (int i = 0; i < 232; i++) {
+        questions.push_back(w.catalog[i % w.catalog.size()].text + " " + std::to_string(i));
+        std::string answer = answerFor(w, i, 1);
+        cache->store(cacheKey(questions.back().c_str()), answer.c_str(), answer.size(), now + 3600, now);
+    }
+    const int ROUNDS = 200000;
+    char out[ResponseCache<32>::MAX_TEXT + 1];
+    volatile uint64_t sink = 0;
+
+    auto time = [&](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) body(i);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / ROUNDS * 1e9;
+    };
+    double keyNs = time([&](int i) { sink = sink + cacheKey(w.asks[i % w.asks.size()].words.c_str()); });
+    std::vector<uint64_t> ramKeys, flashKeys;
+    for (int i = 200; i < 232; i++) ramKeys.push_back(cacheKey(questions[i].c_str()));
+    double ramNs = time([&](int i) { sink = sink + cache->lookup(ramKeys[i % ramKeys.size()], now + 1, out, sizeof(out)); });
+    double missNs = time([&](int i) { sink = sink + cache->lookup(0x1234567800000000ULL + i, now + 1, out, sizeof(out)); });
+
+    // Flash hits promote, so each one evicts another entry; time them on a fresh cache
+    for (int i = 0; i < 100; i++) flashKeys.push_back(cacheKey(questions[60 + i].c_str()));
+    uint64_t readBefore = HostFlash::bytesRead;
+    auto start = std::chrono::steady_clock::now();
+    size_t flashHits = 0;
+    for (uint64_t key : flashKeys) flashHits += cache->lookup(key, now + 1, out, sizeof(out)) == CACHE_FLASH;
+    double flashUs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / flashKeys.size() * 1e6;
+    double flashBytes = (double)(HostFlash::bytesRead - readBefore) / flashKeys.size();
+    delete cache;
+
+    auto attachStart = std::chrono::steady_clock::now();
+    ResponseCache<32>* restarted = new ResponseCache<32>();
+    restarted->attach(partitionFlash());
+    double attachUs = std::chrono::duration<double>(std::chrono::steady_clock::now() - attachStart).count() * 1e6;
+    delete restarted;
+
+    printf("  key of a transcript          %8.0f ns\n", keyNs);
+    printf("  RAM hit (32 entries)         %8.0f ns\n", ramNs);
+    printf("  miss (32 + %u records)      %8.0f ns\n", (unsigned)ResponseCache<32>::MAX_RECORDS, missNs);
+    printf("  flash hit, promoted          %8.2f us, %.0f bytes read from flash\n", flashUs, flashBytes);
+    printf("  attach (index %u records)   %8.0f us\n", (unsigned)ResponseCache<32>::MAX_RECORDS, attachUs);
+    printf("  RAM: %zu bytes for 32 entries and the flash index\n", sizeof(ResponseCache<32>));
+    checks.expect(flashHits == flashKeys.size(), "flash hits for spilled answers", format("%.0f of %.0f", flashHits, flashKeys.size()));
+    checks.expect(keyNs + missNs < 5000, "key and a full miss under 5 us on this host", format("%.0f ns", keyNs + missNs));
+}
+
+// ---------------------------------------------------------------- Firmware
+
+// NetworkModule against a stand-in server that transcribes, answers with
+// hints and pushes invalidations with the metrics reply
+static void firmware(Checks& checks) {
+    eraseFlash();
+    HostClock::setVirtual(true);
+    static int commandPosts = 0;
+    static std::string heard;
+    static std::string invalidation;
+    HostHttp::setHandler([](const HostHttpRequest& request) {
+        HostHttpResponse response;
+        response.latencyMs = 20;
+        response.headers.push_back({ "Date", String(httpDate(EPOCH + HostClock::nowUs() / 1000000).c_str()) });
+        if (request.url.endsWith("/audio")) {
+            response.body = request.header("X-Audio-Final") == "1" && !heard.empty()
+                ? String(("{\"status\":\"ok\",\"transcript\":\"" + heard + "\"}").c_str()) : String("{\"status\":\"ok\"}");
+        } else if (request.url.endsWith("/telemetry/metrics")) {
+            if (!invalidation.empty()) {
+                response.headers.push_back({ "X-Cache-Invalidate", String(invalidation.c_str()) });
+            }
+        } else {
+            commandPosts++;
+            response.latencyMs = 600;
+            response.body = String(("{\"response\":\"Answer " + std::to_string(commandPosts) + "\"}").c_str());
+            response.headers.push_back({ "Cache-Control", "max-age=3600" });
+        }
+        return response;
+    });
+
+    static NetworkModule network;
+    network.connect("stand-in", "");
+    network.beginCache();
+    uint8_t audio[320] = {};
+    auto ask = [&](const char* words) {
+        heard = words;
+        network.sendAudio(audio, sizeof(audio));
+        String command = network.getTranscript().length() > 0 ? network.getTranscript() : String("Command processed");
+        uint64_t start = HostClock::nowUs();
+        String answer = network.sendCommand(command);
+        HostClock::advanceMs(1000);
+        return std::make_pair(std::string(answer.c_str()), (HostClock::nowUs() - start - 1000000) / 1000.0);
+    };
+
+    auto first = ask("Where are the M6 bolts?");
+    auto second = ask("um where are the m6 bolts");
+    checks.expect(commandPosts == 1 && first.first == second.first,
+                  "NetworkModule answers the repeat from the cache",
+                  format("%.0f ms, then %.0f ms", first.second, second.second));
+    heard = "";
+    ask("");
+    ask("");
+    checks.expect(commandPosts == 3, "without a transcript nothing is cached");
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)cacheKey("where are the m6 bolts"));
+    invalidation = hex;
+    network.postMetrics();
+    invalidation = "";
+    auto third = ask("Where are the M6 bolts?");
+    checks.expect(commandPosts == 4 && third.first != first.first,
+                  "X-Cache-Invalidate on the metrics reply sends the question to the server again");
+}
+
+int main(int argc, char** argv) {
+    int days = 7;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--days" && i + 1 < argc) days = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "usage: %s [--days N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (days < 2) days = 2;
+    Logger::setLogLevel(LOG_NONE);
+
+    Checks checks;
+    printf("Rules:\n");
+    rules(checks);
+
+    HostRandom rng(seed);
+    Workload w = makeWorkload(days, rng);
+    printf("\nWorkload: %d days, %zu questions (%zu one-off), catalog of %zu, restart every night\n",
+           days, w.asks.size(), w.oneOffs, w.catalog.size());
+    Replay ideal = replayIdeal(w);
+    Replay ram8 = replay<8>(w, false);
+    Replay ram32 = replay<32>(w, false);
+    Replay flash8 = replay<8>(w, true);
+    Replay flash32 = replay<32>(w, true);
+
+    printf("\n  %-24s %8s %8s %8s %8s %10s\n", "cache", "hit%", "flash%", "stale", "erases", "flash KB");
+    auto row = [](const char* name, const Replay& r) {
+        printf("  %-24s %7.1f%% %7.1f%% %8zu %8zu %10.1f\n", name, 100.0 * r.hits / r.asked,
+               100.0 * r.flashHits / r.asked, r.stale, r.sectorErases, r.flashKbWritten);
+    };
+    row("unbounded, no restarts", ideal);
+    row("RAM 8", ram8);
+    row("RAM 32", ram32);
+    row("RAM 8 + flash 64 KB", flash8);
+    row("RAM 32 + flash 64 KB", flash32);
+    double saved = flash32.hits * 0.6 / days;
+    printf("  RAM 32 + flash saves %.0f server round trips a day (%.0f s of waiting at 600 ms each)\n",
+           (double)flash32.hits / days, saved);
+
+    printf("\nLookup cost (this host):\n");
+    lookupCost(checks, w);
+
+    printf("\nChecks:\n");
+    checks.expect(flash32.stale == 0 && ram32.stale == 0, "no replaced answer is served after its invalidation");
+    checks.expect(flash32.hits > ram32.hits, "the flash tier adds hits across restarts",
+                  format("%.1f%% vs %.1f%%", 100.0 * flash32.hits / flash32.asked, 100.0 * ram32.hits / ram32.asked));
+    checks.expect(flash32.hits >= 0.85 * ideal.hits, "RAM 32 + flash within 15% of the unbounded cache",
+                  format("%.1f%% of the ceiling", 100.0 * flash32.hits / ideal.hits));
+    firmware(checks);
+
+    printf("\n%s\n", checks.failed ? "Some checks FAILED" : "All checks passed");
+    return checks.failed ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#ifndef HOST_DRIVER_GPIO_H
+#define HOST_DRIVER_GPIO_H
+
+// IDF GPIO driver: per-pin ISR service on top of HostGpio. Handlers run
+// synchronously from whatever drives the pin (HostGpio::inject, a register write).
+
+#include "../esp_err.h"
+#include "../esp_intr_alloc.h"
+#include "../host_hal.h"
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_MAX = 49
+} gpio_num_t;
+
+typedef enum {
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE = 1,
+    GPIO_INTR_NEGEDGE = 2,
+    GPIO_INTR_ANYEDGE = 3,
+    GPIO_INTR_LOW_LEVEL = 4,
+    GPIO_INTR_HIGH_LEVEL = 5
+} gpio_int_type_t;
+
+typedef void (*gpio_isr_t)(void* arg);
+
+inline bool& hostGpioIsrServiceInstalled() {
+    static bool installed = false;
+    return installed;
+}
+
+inline esp_err_t gpio_install_isr_service(int flags) {
+    if (hostGpioIsrServiceInstalled()) return ESP_ERR_INVALID_STATE;
+    hostGpioIsrServiceInstalled() = true;
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type) {
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    HostGpio::setIsrType(pin, type);
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void* arg) {
+    if (!hostGpioIsrServiceInstalled()) return ESP_ERR_INVALID_STATE;
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    HostGpio::setIsr(pin, handler, arg);
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_isr_handler_remove(gpio_num_t pin) {
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    HostGpio::setIsr(pin, nullptr, nullptr);
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    HostGpio::write(pin, level ? 1 : 0);
+    return ESP_OK;
+}
+
+inline int gpio_get_level(gpio_num_t pin) {
+    return HostGpio::read(pin);
+}
+
+inline esp_err_t gpio_intr_enable(gpio_num_t pin) { return ESP_OK; }
+inline esp_err_t gpio_intr_disable(gpio_num_t pin) { return ESP_OK; }
+
+#endif
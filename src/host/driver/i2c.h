@@ -0,0 +1,114 @@
+#ifndef HOST_DRIVER_I2C_H
+#define HOST_DRIVER_I2C_H
+
+// Legacy IDF 4.4 I2C master driver API on HostI2c. Transfers charge the bus
+// time to HostClock at the configured clock; a missing device is ESP_FAIL,
+// like a NACK on the wire, and one stretching the clock past ticks is
+// ESP_ERR_TIMEOUT.
+
+#include "../esp_err.h"
+#include "../esp_intr_alloc.h"
+#include "../freertos/FreeRTOS.h"
+#include "../host_hal.h"
+
+#define I2C_SCLK_SRC_FLAG_FOR_NOMAL 0
+
+typedef enum {
+    I2C_NUM_0 = 0,
+    I2C_NUM_1 = 1,
+    I2C_NUM_MAX
+} i2c_port_t;
+
+typedef enum {
+    I2C_MODE_SLAVE = 0,
+    I2C_MODE_MASTER = 1
+} i2c_mode_t;
+
+typedef struct {
+    i2c_mode_t mode;
+    int sda_io_num;
+    int scl_io_num;
+    bool sda_pullup_en;
+    bool scl_pullup_en;
+    struct {
+        uint32_t clk_speed;
+    } master;
+    uint32_t clk_flags;
+} i2c_config_t;
+
+struct HostI2cPort {
+    bool installed = false;
+    uint32_t frequency = 100000;
+};
+
+inline HostI2cPort& hostI2cPort(i2c_port_t port) {
+    static HostI2cPort ports[I2C_NUM_MAX];
+    return ports[port];
+}
+
+inline esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t* config) {
+    if (port < 0 || port >= I2C_NUM_MAX || config == nullptr || config->mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->master.clk_speed == 0 || config->master.clk_speed > 1000000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hostI2cPort(port).frequency = config->master.clk_speed;
+    return ESP_OK;
+}
+
+inline esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rxBufLen, size_t txBufLen, int flags) {
+    if (port < 0 || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (hostI2cPort(port).installed) return ESP_FAIL;
+    hostI2cPort(port).installed = true;
+    return ESP_OK;
+}
+
+inline esp_err_t i2c_driver_delete(i2c_port_t port) {
+    if (port < 0 || port >= I2C_NUM_MAX || !hostI2cPort(port).installed) return ESP_ERR_INVALID_STATE;
+    hostI2cPort(port).installed = false;
+    return ESP_OK;
+}
+
+inline esp_err_t hostI2cBegin(i2c_port_t port) {
+    if (port < 0 || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (!hostI2cPort(port).installed) return ESP_ERR_INVALID_STATE;
+    HostI2c::setFrequency(hostI2cPort(port).frequency);
+    return ESP_OK;
+}
+
+// Waits out the device's clock stretching, up to the caller's timeout
+inline esp_err_t hostI2cStretch(uint8_t address, TickType_t ticks) {
+    uint64_t stretchUs = HostI2c::stretchUs(address);
+    uint64_t timeoutUs = (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+    HostClock::advanceUs(stretchUs < timeoutUs ? stretchUs : timeoutUs);
+    return stretchUs < timeoutUs ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+inline esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t address, const uint8_t* data, size_t length,
+                                            TickType_t ticks) {
+    esp_err_t err = hostI2cBegin(port);
+    if (err == ESP_OK) err = hostI2cStretch(address, ticks);
+    if (err != ESP_OK) return err;
+    return HostI2c::write(address, data, length) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+inline esp_err_t i2c_master_read_from_device(i2c_port_t port, uint8_t address, uint8_t* out, size_t length,
+                                             TickType_t ticks) {
+    esp_err_t err = hostI2cBegin(port);
+    if (err == ESP_OK) err = hostI2cStretch(address, ticks);
+    if (err != ESP_OK) return err;
+    return HostI2c::read(address, out, length) == length ? ESP_OK : ESP_FAIL;
+}
+
+// Write, repeated start, read
+inline esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t address, const uint8_t* data, size_t length,
+                                              uint8_t* out, size_t outLength, TickType_t ticks) {
+    esp_err_t err = hostI2cBegin(port);
+    if (err == ESP_OK) err = hostI2cStretch(address, ticks);
+    if (err != ESP_OK) return err;
+    if (HostI2c::write(address, data, length) != 0) return ESP_FAIL;
+    return HostI2c::read(address, out, outLength) == outLength ? ESP_OK : ESP_FAIL;
+}
+
+#endif
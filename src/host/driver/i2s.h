@@ -0,0 +1,229 @@
+#ifndef HOST_DRIVER_I2S_H
+#define HOST_DRIVER_I2S_H
+
+// Legacy IDF 4.4 I2S driver API, reading from HostI2s sources. Receive
+// overruns seen by HostI2s are posted to the event queue as RX_Q_OVF.
+// With 32-bit samples each source sample is delivered left-justified in its slot.
+// Stereo and TDM formats read that many interleaved samples per frame from the
+// source, and the port clock runs at sample rate x channels.
+// A transmit port starts clocking out at install, as the real driver does;
+// i2s_stop() / i2s_start() stop and restart it with empty DMA buffers.
+
+#include "../esp_err.h"
+#include "../esp_intr_alloc.h"
+#include "../freertos/FreeRTOS.h"
+#include "../freertos/queue.h"
+#include "../host_hal.h"
+
+#define I2S_PIN_NO_CHANGE (-1)
+
+typedef enum {
+    I2S_NUM_0 = 0,
+    I2S_NUM_1 = 1,
+    I2S_NUM_MAX
+} i2s_port_t;
+
+typedef enum {
+    I2S_MODE_MASTER = 1 << 0,
+    I2S_MODE_SLAVE = 1 << 1,
+    I2S_MODE_TX = 1 << 2,
+    I2S_MODE_RX = 1 << 3
+} i2s_mode_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_8BIT = 8,
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+    I2S_BITS_PER_SAMPLE_24BIT = 24,
+    I2S_BITS_PER_SAMPLE_32BIT = 32
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_BITS_PER_CHAN_DEFAULT = 0,
+    I2S_BITS_PER_CHAN_8BIT = 8,
+    I2S_BITS_PER_CHAN_16BIT = 16,
+    I2S_BITS_PER_CHAN_24BIT = 24,
+    I2S_BITS_PER_CHAN_32BIT = 32
+} i2s_bits_per_chan_t;
+
+typedef enum {
+    I2S_CHANNEL_MONO = 1,
+    I2S_CHANNEL_STEREO = 2,
+    I2S_TDM_ACTIVE_CH0 = 1 << 16,
+    I2S_TDM_ACTIVE_CH1 = 1 << 17,
+    I2S_TDM_ACTIVE_CH2 = 1 << 18,
+    I2S_TDM_ACTIVE_CH3 = 1 << 19
+} i2s_channel_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+    I2S_CHANNEL_FMT_MULTIPLE
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_STAND_I2S = 0x01,
+    I2S_COMM_FORMAT_STAND_MSB = 0x02,
+    I2S_COMM_FORMAT_STAND_PCM_SHORT = 0x04,
+    I2S_COMM_FORMAT_STAND_PCM_LONG = 0x0C
+} i2s_comm_format_t;
+
+typedef enum {
+    I2S_MCLK_MULTIPLE_DEFAULT = 0,
+    I2S_MCLK_MULTIPLE_128 = 128,
+    I2S_MCLK_MULTIPLE_256 = 256,
+    I2S_MCLK_MULTIPLE_384 = 384
+} i2s_mclk_multiple_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+    i2s_mclk_multiple_t mclk_multiple;
+    i2s_bits_per_chan_t bits_per_chan;
+    uint32_t chan_mask;
+    uint32_t total_chan;
+    bool left_align;
+    bool big_edin;
+    bool bit_order_msb;
+    bool skip_msk;
+} i2s_config_t;
+
+typedef struct {
+    int mck_io_num;
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+typedef enum {
+    I2S_EVENT_DMA_ERROR,
+    I2S_EVENT_TX_DONE,
+    I2S_EVENT_RX_DONE,
+    I2S_EVENT_TX_Q_OVF,
+    I2S_EVENT_RX_Q_OVF,
+    I2S_EVENT_MAX
+} i2s_event_type_t;
+
+typedef struct {
+    i2s_event_type_t type;
+    size_t size;
+} i2s_event_t;
+
+struct HostI2sPort {
+    bool installed = false;
+    i2s_config_t config = {};
+    QueueHandle_t events = nullptr;
+    uint32_t overrunsReported = 0;
+};
+
+inline HostI2sPort& hostI2sPort(i2s_port_t port) {
+    static HostI2sPort ports[I2S_NUM_MAX];
+    return ports[port];
+}
+
+inline esp_err_t i2s_start(i2s_port_t port);
+
+inline esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queueSize, void* queue) {
+    if (port >= I2S_NUM_MAX || config == nullptr) return ESP_ERR_INVALID_ARG;
+    HostI2sPort& state = hostI2sPort(port);
+    if (state.installed) return ESP_ERR_INVALID_STATE;
+    uint32_t channels = config->channel_format == I2S_CHANNEL_FMT_RIGHT_LEFT ? 2 :
+                        config->channel_format == I2S_CHANNEL_FMT_MULTIPLE ? config->total_chan : 1;
+    if (channels == 0) return ESP_ERR_INVALID_ARG;
+    state.config = *config;
+    state.installed = true;
+    if (queue && queueSize > 0) {
+        state.events = xQueueCreate(queueSize, sizeof(i2s_event_t));
+        *(QueueHandle_t*)queue = state.events;
+    }
+    if (config->mode & I2S_MODE_RX) {
+        HostI2s::start(port, config->sample_rate * channels, (size_t)config->dma_buf_count * config->dma_buf_len * channels);
+    }
+    if (config->mode & I2S_MODE_TX) {
+        i2s_start(port);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_driver_uninstall(i2s_port_t port) {
+    if (port >= I2S_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    HostI2sPort& state = hostI2sPort(port);
+    if (state.events) vQueueDelete(state.events);
+    HostI2s::stop(port);
+    HostI2s::stopTx(port);
+    state = HostI2sPort();
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t* pins) {
+    return port < I2S_NUM_MAX && hostI2sPort(port).installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+inline esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytesRead, TickType_t ticks) {
+    if (port >= I2S_NUM_MAX || !hostI2sPort(port).installed) return ESP_ERR_INVALID_STATE;
+    HostI2sPort& state = hostI2sPort(port);
+    if (state.config.bits_per_sample == I2S_BITS_PER_SAMPLE_32BIT) {
+        // A 24-bit mic in 32-bit slots: the 16-bit source sample is the top half
+        int16_t* narrow = (int16_t*)dest;
+        int32_t* wide = (int32_t*)dest;
+        size_t frames = HostI2s::read(port, narrow, size / sizeof(int32_t) * sizeof(int16_t), ticks) / sizeof(int16_t);
+        for (size_t i = frames; i-- > 0;) {
+            wide[i] = (int32_t)narrow[i] * 65536;
+        }
+        *bytesRead = frames * sizeof(int32_t);
+    } else {
+        *bytesRead = HostI2s::read(port, dest, size, ticks);
+    }
+
+    uint32_t overruns = HostI2s::getOverruns(port);
+    for (; state.overrunsReported < overruns; state.overrunsReported++) {
+        i2s_event_t event = { I2S_EVENT_RX_Q_OVF, 0 };
+        if (state.events) xQueueSendFromISR(state.events, &event, nullptr);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_write(i2s_port_t port, const void* src, size_t size, size_t* bytesWritten, TickType_t ticks) {
+    if (port >= I2S_NUM_MAX || !hostI2sPort(port).installed) return ESP_ERR_INVALID_STATE;
+    *bytesWritten = HostI2s::write(port, src, size, ticks * portTICK_PERIOD_MS);
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_set_clk(i2s_port_t port, uint32_t rate, uint32_t bits, i2s_channel_t channels) {
+    if (port >= I2S_NUM_MAX || !hostI2sPort(port).installed) return ESP_ERR_INVALID_STATE;
+    hostI2sPort(port).config.sample_rate = rate;
+    return ESP_OK;
+}
+
+// The DMA starts on the first (zeroed) buffer, so written samples follow one
+// buffer of silence
+inline esp_err_t i2s_start(i2s_port_t port) {
+    if (port >= I2S_NUM_MAX || !hostI2sPort(port).installed) return ESP_ERR_INVALID_STATE;
+    const i2s_config_t& config = hostI2sPort(port).config;
+    if (config.mode & I2S_MODE_TX) {
+        HostI2s::startTx(port, config.sample_rate, (size_t)config.dma_buf_count * config.dma_buf_len, config.dma_buf_len);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_stop(i2s_port_t port) {
+    if (port >= I2S_NUM_MAX || !hostI2sPort(port).installed) return ESP_ERR_INVALID_STATE;
+    HostI2s::stopTx(port);
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_zero_dma_buffer(i2s_port_t port) { return ESP_OK; }
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef HOST_ESP_ADC_CAL_H
+#define HOST_ESP_ADC_CAL_H
+
+#include "driver/adc.h"
+
+typedef enum {
+    ESP_ADC_CAL_VAL_EFUSE_VREF,
+    ESP_ADC_CAL_VAL_EFUSE_TP,
+    ESP_ADC_CAL_VAL_DEFAULT_VREF,
+    ESP_ADC_CAL_VAL_EFUSE_TP_FIT
+} esp_adc_cal_value_t;
+
+typedef struct {
+    adc_unit_t adc_num;
+    adc_atten_t atten;
+    adc_bits_width_t bit_width;
+    uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+// The simulated converter is ideal, so it reports as factory calibrated
+inline esp_err_t esp_adc_cal_check_efuse(esp_adc_cal_value_t source) {
+    return source == ESP_ADC_CAL_VAL_EFUSE_TP_FIT ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+inline esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+                                                    uint32_t defaultVref, esp_adc_cal_characteristics_t* chars) {
+    chars->adc_num = unit;
+    chars->atten = atten;
+    chars->bit_width = width;
+    chars->vref = defaultVref;
+    return ESP_ADC_CAL_VAL_EFUSE_TP_FIT;
+}
+
+// Inverse of analogRead(): 12-bit raw over a 3.1 V span
+inline uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars) {
+    return raw * 3100 / 4095;
+}
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef HOST_ESP_CAMERA_H
+#define HOST_ESP_CAMERA_H
+
+// esp32-camera driver over image files or generated scenes. Frames come in
+// the configured format and size: PGM (P5) and PPM (P6) files are scaled to
+// it nearest-neighbour and converted with the BT.601 matrix, as the sensor's
+// YUV422 output would be. Taking a frame advances HostClock by frameMs, the
+// sensor's frame period; a frame buffer not returned stays out, and with all
+// fb_count out fb_get() fails as it would time out on the device.
+
+#include "esp_err.h"
+#include "host_hal.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef enum {
+    PIXFORMAT_RGB565,
+    PIXFORMAT_YUV422,
+    PIXFORMAT_YUV420,
+    PIXFORMAT_GRAYSCALE,
+    PIXFORMAT_JPEG,
+    PIXFORMAT_RGB888,
+    PIXFORMAT_RAW,
+    PIXFORMAT_RGB444,
+    PIXFORMAT_RGB555
+} pixformat_t;
+
+typedef enum {
+    FRAMESIZE_96X96,
+    FRAMESIZE_QQVGA,
+    FRAMESIZE_QCIF,
+    FRAMESIZE_HQVGA,
+    FRAMESIZE_240X240,
+    FRAMESIZE_QVGA,
+    FRAMESIZE_CIF,
+    FRAMESIZE_HVGA,
+    FRAMESIZE_VGA,
+    FRAMESIZE_SVGA,
+    FRAMESIZE_XGA,
+    FRAMESIZE_HD,
+    FRAMESIZE_SXGA,
+    FRAMESIZE_UXGA,
+    FRAMESIZE_INVALID
+} framesize_t;
+
+typedef enum {
+    CAMERA_GRAB_WHEN_EMPTY,
+    CAMERA_GRAB_LATEST
+} camera_grab_mode_t;
+
+typedef enum {
+    CAMERA_FB_IN_PSRAM,
+    CAMERA_FB_IN_DRAM
+} camera_fb_location_t;
+
+typedef struct {
+    int pin_pwdn;
+    int pin_reset;
+    int pin_xclk;
+    int pin_sccb_sda;
+    int pin_sccb_scl;
+    int pin_d7, pin_d6, pin_d5, pin_d4, pin_d3, pin_d2, pin_d1, pin_d0;
+    int pin_vsync;
+    int pin_href;
+    int pin_pclk;
+    int xclk_freq_hz;
+    int ledc_timer;
+    int ledc_channel;
+    pixformat_t pixel_format;
+    framesize_t frame_size;
+    int jpeg_quality;
+    size_t fb_count;
+    camera_fb_location_t fb_location;
+    camera_grab_mode_t grab_mode;
+    int sccb_i2c_port;
+} camera_config_t;
+
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    pixformat_t format;
+    struct timeval timestamp;
+} camera_fb_t;
+
+class HostCamera {
+public:
+    // Fills a frame of width x height in YUYV; false ends the sequence
+    typedef std::function<bool(uint32_t index, uint16_t width, uint16_t height, uint8_t* yuyv)> Source;
+
+    static inline uint32_t frameMs = 67;            // 15 fps at VGA from a 20 MHz XCLK
+    static inline uint32_t framesTaken = 0;
+
+    static void setSource(Source source) {
+        current = source;
+        files.clear();
+    }
+
+    // Frames from PGM / PPM files, in order, starting over after the last
+    static bool loadImages(const std::vector<std::string>& paths) {
+        files.clear();
+        for (const std::string& path : paths) {
+            Image image;
+            if (!readImage(path, image)) {
+                fprintf(stderr, "camera: cannot read %s (PGM P5 or PPM P6 only)\n", path.c_str());
+                return false;
+            }
+            files.push_back(image);
+        }
+        current = [](uint32_t index, uint16_t width, uint16_t height, uint8_t* yuyv) {
+            if (files.empty()) return false;
+            render(files[index % files.size()], width, height, yuyv);
+            return true;
+        };
+        return true;
+    }
+
+    static bool frameSize(framesize_t size, uint16_t& width, uint16_t& height) {
+        static const uint16_t SIZES[][2] = {
+            { 96, 96 }, { 160, 120 }, { 176, 144 }, { 240, 176 }, { 240, 240 }, { 320, 240 }, { 400, 296 },
+            { 480, 320 }, { 640, 480 }, { 800, 600 }, { 1024, 768 }, { 1280, 720 }, { 1280, 1024 }, { 1600, 1200 }
+        };
+        if (size >= FRAMESIZE_INVALID) return false;
+        width = SIZES[size][0];
+        height = SIZES[size][1];
+        return true;
+    }
+
+    static bool begin(const camera_config_t& newConfig) {
+        uint16_t width, height;
+        if (!frameSize(newConfig.frame_size, width, height) || newConfig.fb_count < 1 ||
+            (newConfig.pixel_format != PIXFORMAT_YUV422 && newConfig.pixel_format != PIXFORMAT_GRAYSCALE)) {
+            return false;
+        }
+        config = newConfig;
+        size_t bytes = (size_t)width * height * (config.pixel_format == PIXFORMAT_YUV422 ? 2 : 1);
+        buffers.assign(config.fb_count, Buffer());
+        for (Buffer& buffer : buffers) {
+            buffer.data.assign(bytes, 0);
+            buffer.frame.buf = buffer.data.data();
+            buffer.frame.len = bytes;
+            buffer.frame.width = width;
+            buffer.frame.height = height;
+            buffer.frame.format = config.pixel_format;
+        }
+        scratch.assign((size_t)width * height * 2, 0);
+        index = 0;
+        running = true;
+        return true;
+    }
+
+    static void end() {
+        running = false;
+        buffers.clear();
+    }
+
+    static camera_fb_t* take() {
+        if (!running || !current) return nullptr;
+        Buffer* free = nullptr;
+        for (Buffer& buffer : buffers) {
+            if (!buffer.out) {
+                free = &buffer;
+                break;
+            }
+        }
+        HostClock::advanceMs(frameMs);
+        if (free == nullptr) return nullptr;
+        camera_fb_t& frame = free->frame;
+        if (!current(index, frame.width, frame.height, scratch.data())) return nullptr;
+        index++;
+        framesTaken++;
+        if (frame.format == PIXFORMAT_YUV422) {
+            memcpy(frame.buf, scratch.data(), frame.len);
+        } else {
+            for (size_t i = 0; i < frame.len; i++) frame.buf[i] = scratch[i * 2];
+        }
+        uint64_t now = HostClock::nowUs();
+        frame.timestamp.tv_sec = now / 1000000;
+        frame.timestamp.tv_usec = now % 1000000;
+        free->out = true;
+        return &frame;
+    }
+
+    static void give(camera_fb_t* frame) {
+        for (Buffer& buffer : buffers) {
+            if (&buffer.frame == frame) buffer.out = false;
+        }
+    }
+
+    static size_t buffersOut() {
+        size_t out = 0;
+        for (const Buffer& buffer : buffers) out += buffer.out;
+        return out;
+    }
+
+    // BT.601 full-range RGB to YUYV, chroma from the pair's left pixel
+    static void toYuyv(const uint8_t* rgb, uint16_t width, uint16_t height, uint8_t* yuyv) {
+        for (size_t i = 0; i < (size_t)width * height; i++) {
+            int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+            yuyv[i * 2] = clamp((77 * r + 150 * g + 29 * b + 128) >> 8);
+            if ((i % width) % 2 == 0) {
+                yuyv[i * 2 + 1] = clamp(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+                yuyv[i * 2 + 3] = clamp(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> data;
+        camera_fb_t frame = {};
+        bool out = false;
+    };
+
+    struct Image {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        std::vector<uint8_t> rgb;
+    };
+
+    static inline camera_config_t config = {};
+    static inline std::vector<Buffer> buffers;
+    static inline std::vector<uint8_t> scratch;
+    static inline std::vector<Image> files;
+    static inline Source current;
+    static inline uint32_t index = 0;
+    static inline bool running = false;
+
+    static uint8_t clamp(int value) {
+        return value < 0 ? 0 : value > 255 ? 255 : value;
+    }
+
+    static bool readImage(const std::string& path, Image& image) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return false;
+        char magic[3] = {};
+        unsigned width = 0, height = 0, maxValue = 0;
+        bool ok = fscanf(file, "%2s %u %u %u", magic, &width, &height, &maxValue) == 4 && maxValue == 255 &&
+                  (strcmp(magic, "P5") == 0 || strcmp(magic, "P6") == 0) && width > 0 && height > 0 &&
+                  width <= 4096 && height <= 4096;
+        if (ok) {
+            fgetc(file);
+            bool colour = magic[1] == '6';
+            std::vector<uint8_t> raw((size_t)width * height * (colour ? 3 : 1));
+            ok = fread(raw.data(), 1, raw.size(), file) == raw.size();
+            image.width = width;
+            image.height = height;
+            image.rgb.resize((size_t)width * height * 3);
+            for (size_t i = 0; ok && i < (size_t)width * height; i++) {
+                for (int c = 0; c < 3; c++) image.rgb[i * 3 + c] = colour ? raw[i * 3 + c] : raw[i];
+            }
+        }
+        fclose(file);
+        return ok;
+    }
+
+    static void render(const Image& image, uint16_t width, uint16_t height, uint8_t* yuyv) {
+        std::vector<uint8_t> rgb((size_t)width * height * 3);
+        for (uint16_t y = 0; y < height; y++) {
+            size_t sy = (size_t)y * image.height / height;
+            for (uint16_t x = 0; x < width; x++) {
+                size_t sx = (size_t)x * image.width / width;
+                memcpy(&rgb[((size_t)y * width + x) * 3], &image.rgb[(sy * image.width + sx) * 3], 3);
+            }
+        }
+        toYuyv(rgb.data(), width, height, yuyv);
+    }
+};
+
+inline esp_err_t esp_camera_init(const camera_config_t* config) {
+    return config != nullptr && HostCamera::begin(*config) ? ESP_OK : ESP_FAIL;
+}
+
+inline esp_err_t esp_camera_deinit() {
+    HostCamera::end();
+    return ESP_OK;
+}
+
+inline camera_fb_t* esp_camera_fb_get() {
+    return HostCamera::take();
+}
+
+inline void esp_camera_fb_return(camera_fb_t* fb) {
+    HostCamera::give(fb);
+}
+
+#endif
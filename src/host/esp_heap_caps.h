@@ -0,0 +1,33 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+// Capability-based allocation; every capability is the host heap. What
+// went to PSRAM is counted, so a harness can report the footprint.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+class HostHeap {
+public:
+    static inline size_t psramBytes = 0;
+};
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    void* memory = malloc(size);
+    if (memory != nullptr && (caps & MALLOC_CAP_SPIRAM)) {
+        HostHeap::psramBytes += size;
+    }
+    return memory;
+}
+
+inline void heap_caps_free(void* memory) {
+    free(memory);
+}
+
+#endif
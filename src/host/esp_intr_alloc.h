@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_INTR_ALLOC_H
+#define HOST_ESP_INTR_ALLOC_H
+
+// Interrupt allocation flags; the host has no interrupt matrix, they are only passed along
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+#endif
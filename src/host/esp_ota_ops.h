@@ -0,0 +1,183 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+// OTA slots and the bootloader's rollback state machine (IDF 4.4 with
+// CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE, as in the arduino-esp32 builds).
+// Writes only clear bits, like NOR flash, so writing into a sector that was
+// not erased corrupts the image. HostOta::reboot() stands in for a reset.
+
+#include "esp_partition.h"
+#include <stdio.h>
+
+typedef uint32_t esp_ota_handle_t;
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe
+
+#define ESP_ERR_OTA_BASE 0x1500
+#define ESP_ERR_OTA_PARTITION_CONFLICT (ESP_ERR_OTA_BASE + 0x01)
+#define ESP_ERR_OTA_VALIDATE_FAILED (ESP_ERR_OTA_BASE + 0x03)
+#define ESP_ERR_OTA_ROLLBACK_FAILED (ESP_ERR_OTA_BASE + 0x05)
+#define ESP_ERR_OTA_ROLLBACK_INVALID_STATE (ESP_ERR_OTA_BASE + 0x06)
+
+typedef enum {
+    ESP_OTA_IMG_NEW = 0x0,
+    ESP_OTA_IMG_PENDING_VERIFY = 0x1,
+    ESP_OTA_IMG_VALID = 0x2,
+    ESP_OTA_IMG_INVALID = 0x3,
+    ESP_OTA_IMG_ABORTED = 0x4,
+    ESP_OTA_IMG_UNDEFINED = 0xFFFFFFFF
+} esp_ota_img_states_t;
+
+class HostOta {
+public:
+    static const uint32_t SECTOR_BYTES = 4096;
+    static const uint8_t IMAGE_MAGIC = 0xE9;        // First byte of every ESP app image
+
+    // Both slots as a USB flash leaves them: the image in slot 0, no otadata
+    static void reset() {
+        running = 0;
+        boot = 0;
+        states[0] = states[1] = ESP_OTA_IMG_UNDEFINED;
+        open = false;
+        restarts = 0;
+    }
+
+    // What the bootloader does after a reset: a new image boots pending
+    // verification; one still pending from the previous boot was never
+    // confirmed, so it is aborted and the other slot boots instead
+    static void reboot() {
+        int slot = boot;
+        if (states[slot] == ESP_OTA_IMG_NEW) {
+            states[slot] = ESP_OTA_IMG_PENDING_VERIFY;
+        } else if (states[slot] == ESP_OTA_IMG_PENDING_VERIFY) {
+            states[slot] = ESP_OTA_IMG_ABORTED;
+            slot = 1 - slot;
+        } else if (!bootable(slot)) {
+            slot = 1 - slot;
+        }
+        running = boot = slot;
+        open = false;
+        restarts++;
+    }
+
+    static bool bootable(int slot) {
+        return states[slot] != ESP_OTA_IMG_INVALID && states[slot] != ESP_OTA_IMG_ABORTED &&
+               HostFlash::data(&HostFlash::slots[slot])[0] == IMAGE_MAGIC;
+    }
+
+    static inline int running = 0;
+    static inline int boot = 0;
+    static inline esp_ota_img_states_t states[2] = { ESP_OTA_IMG_UNDEFINED, ESP_OTA_IMG_UNDEFINED };
+    static inline uint32_t restarts = 0;
+
+    // The one open update
+    static inline bool open = false;
+    static inline int slot = 0;
+    static inline uint32_t offset = 0;
+    static inline uint32_t erasedTo = 0;
+    static inline bool sequential = false;
+
+    static void erase(uint32_t from, uint32_t to) {
+        std::vector<uint8_t>& bytes = HostFlash::data(&HostFlash::slots[slot]);
+        to = (to + SECTOR_BYTES - 1) / SECTOR_BYTES * SECTOR_BYTES;
+        if (to > bytes.size()) to = bytes.size();
+        if (to > from) std::fill(bytes.begin() + from, bytes.begin() + to, 0xFF);
+        if (to > erasedTo) erasedTo = to;
+    }
+};
+
+inline const esp_partition_t* esp_ota_get_running_partition() {
+    return &HostFlash::slots[HostOta::running];
+}
+
+inline const esp_partition_t* esp_ota_get_boot_partition() {
+    return &HostFlash::slots[HostOta::boot];
+}
+
+inline const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    return &HostFlash::slots[1 - HostOta::running];
+}
+
+inline esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    if (partition == nullptr || out_handle == nullptr) return ESP_ERR_INVALID_ARG;
+    if (partition == esp_ota_get_running_partition()) return ESP_ERR_OTA_PARTITION_CONFLICT;
+    if (HostOta::states[HostOta::running] == ESP_OTA_IMG_PENDING_VERIFY) return ESP_ERR_OTA_ROLLBACK_INVALID_STATE;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES && image_size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    HostOta::slot = partition == &HostFlash::slots[1] ? 1 : 0;
+    HostOta::offset = 0;
+    HostOta::erasedTo = 0;
+    HostOta::sequential = image_size == OTA_WITH_SEQUENTIAL_WRITES;
+    if (!HostOta::sequential) {
+        HostOta::erase(0, image_size == OTA_SIZE_UNKNOWN ? partition->size : image_size);
+    }
+    HostOta::states[HostOta::slot] = ESP_OTA_IMG_UNDEFINED;
+    HostOta::open = true;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    if (!HostOta::open || handle != 1) return ESP_ERR_INVALID_ARG;
+    const uint8_t* bytes = (const uint8_t*)data;
+    if (HostOta::offset == 0 && size > 0 && bytes[0] != HostOta::IMAGE_MAGIC) return ESP_ERR_OTA_VALIDATE_FAILED;
+    std::vector<uint8_t>& flash = HostFlash::data(&HostFlash::slots[HostOta::slot]);
+    if (HostOta::offset + size > flash.size()) return ESP_ERR_INVALID_SIZE;
+    if (HostOta::sequential && HostOta::offset + size > HostOta::erasedTo) {
+        HostOta::erase(HostOta::erasedTo, HostOta::offset + size);
+    }
+    for (size_t i = 0; i < size; i++) {
+        flash[HostOta::offset + i] &= bytes[i];
+    }
+    HostOta::offset += size;
+    HostFlash::bytesWritten += size;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    if (!HostOta::open || handle != 1) return ESP_ERR_INVALID_ARG;
+    HostOta::open = false;
+    return HostOta::offset > 0 ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+inline esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    HostOta::open = false;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    int slot = partition == &HostFlash::slots[1] ? 1 : 0;
+    if (HostFlash::data(partition)[0] != HostOta::IMAGE_MAGIC) return ESP_ERR_OTA_VALIDATE_FAILED;
+    HostOta::boot = slot;
+    if (slot != HostOta::running) HostOta::states[slot] = ESP_OTA_IMG_NEW;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+    if (partition == nullptr || state == nullptr) return ESP_ERR_INVALID_ARG;
+    int slot = partition == &HostFlash::slots[1] ? 1 : 0;
+    if (HostOta::states[slot] == ESP_OTA_IMG_UNDEFINED) return ESP_ERR_NOT_FOUND;
+    *state = HostOta::states[slot];
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+    HostOta::states[HostOta::running] = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+inline bool esp_ota_check_rollback_is_possible() {
+    return HostOta::bootable(1 - HostOta::running);
+}
+
+inline esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot() {
+    if (!esp_ota_check_rollback_is_possible()) return ESP_ERR_OTA_ROLLBACK_FAILED;
+    HostOta::states[HostOta::running] = ESP_OTA_IMG_INVALID;
+    HostOta::boot = 1 - HostOta::running;
+    HostOta::reboot();
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+// Flash partitions of partitions_ab.csv, backed by memory. Erased flash
+// reads 0xFF; reads and writes outside a partition fail as on the device.
+// esp_partition_mmap() hands out a pointer into the backing memory, as the
+// flash cache would map it. Writes only clear bits, as on NOR flash; erases
+// take whole 4 KB sectors.
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_APP_FACTORY = 0x00,
+    ESP_PARTITION_SUBTYPE_APP_OTA_0 = 0x10,
+    ESP_PARTITION_SUBTYPE_APP_OTA_1 = 0x11,
+    ESP_PARTITION_SUBTYPE_DATA_OTA = 0x00,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+typedef enum {
+    SPI_FLASH_MMAP_DATA,
+    SPI_FLASH_MMAP_INST
+} spi_flash_mmap_memory_t;
+
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef struct {
+    void* flash_chip;
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+class HostFlash {
+public:
+    static const uint32_t APP_SLOT_BYTES = 0x300000;
+
+    static inline esp_partition_t slots[2] = {
+        { nullptr, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, APP_SLOT_BYTES, "app0", false },
+        { nullptr, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x310000, APP_SLOT_BYTES, "app1", false }
+    };
+
+    // Custom data partition for the asset pack
+    static inline esp_partition_t assets = {
+        nullptr, ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, 0x610000, 0x100000, "assets", false
+    };
+
+    // Raw data partition for the response cache's flash tier
+    static inline esp_partition_t responseCache = {
+        nullptr, ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x41, 0x7F0000, 0x10000, "rcache", false
+    };
+
+    // Contents of a partition; allocated on first use
+    static std::vector<uint8_t>& data(const esp_partition_t* partition) {
+        std::vector<uint8_t>& bytes = contents[partition == &responseCache ? 3 : partition == &assets ? 2 :
+                                               partition == &slots[1] ? 1 : 0];
+        if (bytes.empty()) bytes.assign(partition->size, 0xFF);
+        return bytes;
+    }
+
+    // Writes an image into a slot directly, as a USB flash would
+    static void load(int slot, const std::vector<uint8_t>& image) {
+        load(&slots[slot], image);
+    }
+
+    static void load(const esp_partition_t* partition, const std::vector<uint8_t>& image) {
+        std::vector<uint8_t>& bytes = data(partition);
+        std::fill(bytes.begin(), bytes.end(), 0xFF);
+        std::copy(image.begin(), image.begin() + std::min(image.size(), bytes.size()), bytes.begin());
+    }
+
+    static inline uint64_t bytesRead = 0;
+    static inline uint64_t bytesWritten = 0;
+    static inline uint32_t mappings = 0;        // Currently mapped regions
+    static inline uint32_t sectorErases = 0;
+
+private:
+    static inline std::vector<uint8_t> contents[4];
+};
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                       const char* label) {
+    esp_partition_t* all[] = { &HostFlash::slots[0], &HostFlash::slots[1], &HostFlash::assets, &HostFlash::responseCache };
+    for (esp_partition_t* partition : all) {
+        if (partition->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || partition->subtype == subtype) &&
+            (label == nullptr || strcmp(partition->label, label) == 0)) {
+            return partition;
+        }
+    }
+    return nullptr;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    if (partition == nullptr || offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, HostFlash::data(partition).data() + offset, size);
+    HostFlash::bytesRead += size;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+    if (partition == nullptr || offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    uint8_t* bytes = HostFlash::data(partition).data() + offset;
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] &= ((const uint8_t*)src)[i];
+    }
+    HostFlash::bytesWritten += size;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (partition == nullptr || offset + size > partition->size || offset % 4096 != 0 || size % 4096 != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    std::vector<uint8_t>& bytes = HostFlash::data(partition);
+    std::fill(bytes.begin() + offset, bytes.begin() + offset + size, 0xFF);
+    HostFlash::sectorErases += size / 4096;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                                    spi_flash_mmap_memory_t memory, const void** out_ptr,
+                                    spi_flash_mmap_handle_t* out_handle) {
+    if (partition == nullptr || offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+    *out_ptr = HostFlash::data(partition).data() + offset;
+    *out_handle = ++HostFlash::mappings;
+    return ESP_OK;
+}
+
+inline void spi_flash_munmap(spi_flash_mmap_handle_t handle) {
+    if (HostFlash::mappings > 0) HostFlash::mappings--;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef HOST_ESP_PM_H
+#define HOST_ESP_PM_H
+
+// Power management locks and DFS configuration; the host only records them
+// so simulations can see which clock bounds the firmware asked for.
+
+#include "esp_err.h"
+#include <atomic>
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32s3_t;
+
+typedef esp_pm_config_esp32s3_t esp_pm_config_t;
+
+struct HostPmLock {
+    esp_pm_lock_type_t type;
+    const char* name;
+    std::atomic<int> held{0};
+};
+
+typedef HostPmLock* esp_pm_lock_handle_t;
+
+class HostPm {
+public:
+    static inline esp_pm_config_esp32s3_t config = { 240, 240, false };
+    static inline std::atomic<int> locksHeld{0};
+    static inline std::atomic<int> heldByType[3] = {};
+
+    // Clock DFS settles on for the locks currently held: the maximum under a
+    // CPU lock, 80 MHz (APB at full speed) under an APB lock, else the minimum
+    static int effectiveMhz() {
+        if (heldByType[ESP_PM_CPU_FREQ_MAX] > 0) return config.max_freq_mhz;
+        if (heldByType[ESP_PM_APB_FREQ_MAX] > 0) {
+            int apbMhz = config.max_freq_mhz < 80 ? config.max_freq_mhz : 80;
+            return config.min_freq_mhz > apbMhz ? config.min_freq_mhz : apbMhz;
+        }
+        return config.min_freq_mhz;
+    }
+};
+
+inline esp_err_t esp_pm_configure(const void* config) {
+    HostPm::config = *(const esp_pm_config_esp32s3_t*)config;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_get_configuration(void* config) {
+    *(esp_pm_config_esp32s3_t*)config = HostPm::config;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle) {
+    HostPmLock* lock = new HostPmLock();
+    lock->type = type;
+    lock->name = name;
+    *handle = lock;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle) {
+    delete handle;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    handle->held++;
+    HostPm::locksHeld++;
+    HostPm::heldByType[handle->type]++;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    if (handle->held.load() == 0) return ESP_ERR_INVALID_STATE;
+    handle->held--;
+    HostPm::locksHeld--;
+    HostPm::heldByType[handle->type]--;
+    return ESP_OK;
+}
+
+#endif
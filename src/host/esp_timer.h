@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+#include "host_hal.h"
+
+// Microseconds since boot, from the same clock as micros()
+inline int64_t esp_timer_get_time() {
+    return (int64_t)HostClock::nowUs();
+}
+
+#endif
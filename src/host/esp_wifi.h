@@ -0,0 +1,54 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+// Station configuration and power save over HostWifi; only the fields the
+// firmware sets are kept.
+
+#include <string.h>
+#include "esp_err.h"
+#include "host_net.h"
+
+#define ESP_ERR_WIFI_BASE 0x3000
+#define ESP_ERR_WIFI_STATE (ESP_ERR_WIFI_BASE + 6)
+
+typedef enum {
+    WIFI_IF_STA,
+    WIFI_IF_AP
+} wifi_interface_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint16_t listen_interval;       // Beacons, for WIFI_PS_MAX_MODEM; 0 = 3
+} wifi_sta_config_t;
+
+typedef union {
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+inline esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t* config) {
+    if (interface != WIFI_IF_STA) return ESP_ERR_INVALID_ARG;
+    memset(config, 0, sizeof(*config));
+    config->sta.listen_interval = HostWifi::listenInterval;
+    return ESP_OK;
+}
+
+// Used from the next association on; refused while the station is connecting
+inline esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t* config) {
+    if (interface != WIFI_IF_STA) return ESP_ERR_INVALID_ARG;
+    if (HostWifi::isAssociating()) return ESP_ERR_WIFI_STATE;
+    HostWifi::listenInterval = config->sta.listen_interval;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+    HostWifi::powerSave = type;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_get_ps(wifi_ps_type_t* type) {
+    *type = (wifi_ps_type_t)HostWifi::powerSave.load();
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+#include "../host_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+struct HostQueue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+typedef HostQueue* QueueHandle_t;
+
+// Waits on the queue's condition variable for up to ticks milliseconds.
+// In virtual time there is only one task, so nothing can arrive while waiting:
+// the timeout is charged to the clock and a forever-wait is a deadlock.
+template<typename Predicate>
+inline bool hostQueueWait(HostQueue* queue, std::unique_lock<std::mutex>& guard, TickType_t ticks, Predicate ready) {
+    if (ready()) {
+        return true;
+    }
+    if (ticks == 0) {
+        return false;
+    }
+    if (HostClock::isVirtual()) {
+        if (ticks == portMAX_DELAY) {
+            fprintf(stderr, "[host] queue wait would block forever in virtual time\n");
+            abort();
+        }
+        HostClock::advanceMs(ticks);
+        return false;
+    }
+    if (ticks == portMAX_DELAY) {
+        queue->changed.wait(guard, ready);
+        return true;
+    }
+    return queue->changed.wait_for(guard, std::chrono::milliseconds(ticks), ready);
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue* queue = new HostQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+inline BaseType_t hostQueuePut(QueueHandle_t queue, const void* item, TickType_t ticks, bool front) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!hostQueueWait(queue, guard, ticks, [queue]() { return queue->items.size() < queue->length; })) {
+        return errQUEUE_FULL;
+    }
+    std::vector<uint8_t> copy(queue->itemSize);
+    if (item && queue->itemSize) {
+        memcpy(copy.data(), item, queue->itemSize);
+    }
+    if (front) {
+        queue->items.push_front(std::move(copy));
+    } else {
+        queue->items.push_back(std::move(copy));
+    }
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    return hostQueuePut(queue, item, ticks, false);
+}
+
+inline BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    return hostQueuePut(queue, item, ticks, false);
+}
+
+inline BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    return hostQueuePut(queue, item, ticks, true);
+}
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken) {
+    return hostQueuePut(queue, item, 0, false);
+}
+
+inline BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->items.clear();
+    }
+    return hostQueuePut(queue, item, 0, false);
+}
+
+inline BaseType_t hostQueueTake(QueueHandle_t queue, void* item, TickType_t ticks, bool remove) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!hostQueueWait(queue, guard, ticks, [queue]() { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    if (item && queue->itemSize) {
+        memcpy(item, queue->items.front().data(), queue->itemSize);
+    }
+    if (remove) {
+        queue->items.pop_front();
+        queue->changed.notify_all();
+    }
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    return hostQueueTake(queue, item, ticks, true);
+}
+
+inline BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks) {
+    return hostQueueTake(queue, item, ticks, false);
+}
+
+inline BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void* item, BaseType_t* woken) {
+    return hostQueueTake(queue, item, 0, true);
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->items.size();
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->length - queue->items.size();
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef HOST_FREERTOS_STREAM_BUFFER_H
+#define HOST_FREERTOS_STREAM_BUFFER_H
+
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+
+struct HostStreamBuffer {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<uint8_t> bytes;
+    size_t size;
+    size_t triggerLevel;
+};
+
+typedef HostStreamBuffer* StreamBufferHandle_t;
+
+inline StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t triggerLevel) {
+    HostStreamBuffer* stream = new HostStreamBuffer();
+    stream->size = size;
+    stream->triggerLevel = triggerLevel ? triggerLevel : 1;
+    return stream;
+}
+
+inline void vStreamBufferDelete(StreamBufferHandle_t stream) {
+    delete stream;
+}
+
+// Writes as much as fits, waiting up to ticks for space
+inline size_t xStreamBufferSend(StreamBufferHandle_t stream, const void* data, size_t length, TickType_t ticks) {
+    const uint8_t* in = (const uint8_t*)data;
+    size_t sent = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    std::unique_lock<std::mutex> guard(stream->lock);
+
+    while (true) {
+        while (sent < length && stream->bytes.size() < stream->size) {
+            stream->bytes.push_back(in[sent++]);
+        }
+        stream->changed.notify_all();
+        if (sent == length || ticks == 0) break;
+        auto hasSpace = [stream]() { return stream->bytes.size() < stream->size; };
+        if (ticks == portMAX_DELAY) {
+            stream->changed.wait(guard, hasSpace);
+        } else if (!stream->changed.wait_until(guard, deadline, hasSpace)) {
+            break;
+        }
+    }
+    return sent;
+}
+
+inline size_t xStreamBufferSendFromISR(StreamBufferHandle_t stream, const void* data, size_t length, BaseType_t* woken) {
+    return xStreamBufferSend(stream, data, length, 0);
+}
+
+// Waits up to ticks until the trigger level is reached, then returns what is there
+inline size_t xStreamBufferReceive(StreamBufferHandle_t stream, void* data, size_t length, TickType_t ticks) {
+    uint8_t* out = (uint8_t*)data;
+    std::unique_lock<std::mutex> guard(stream->lock);
+    size_t needed = length < stream->triggerLevel ? length : stream->triggerLevel;
+    auto ready = [stream, needed]() { return stream->bytes.size() >= needed; };
+
+    if (ticks == portMAX_DELAY) {
+        stream->changed.wait(guard, ready);
+    } else {
+        stream->changed.wait_for(guard, std::chrono::milliseconds(ticks), ready);
+    }
+
+    size_t count = 0;
+    while (count < length && !stream->bytes.empty()) {
+        out[count++] = stream->bytes.front();
+        stream->bytes.pop_front();
+    }
+    stream->changed.notify_all();
+    return count;
+}
+
+inline size_t xStreamBufferBytesAvailable(StreamBufferHandle_t stream) {
+    std::lock_guard<std::mutex> guard(stream->lock);
+    return stream->bytes.size();
+}
+
+inline size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t stream) {
+    std::lock_guard<std::mutex> guard(stream->lock);
+    return stream->size - stream->bytes.size();
+}
+
+inline BaseType_t xStreamBufferReset(StreamBufferHandle_t stream) {
+    std::lock_guard<std::mutex> guard(stream->lock);
+    stream->bytes.clear();
+    stream->changed.notify_all();
+    return pdPASS;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+#include "../host_hal.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <string>
+#include <thread>
+
+struct HostTask {
+    std::string name;
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notifyValue = 0;
+};
+
+typedef HostTask* TaskHandle_t;
+
+// Thrown by vTaskDelete(NULL) to unwind the calling task's thread
+struct HostTaskExit {};
+
+inline TaskHandle_t& hostCurrentTask() {
+    // Threads not started through xTaskCreate (main, "loopTask") get a handle on first use
+    thread_local TaskHandle_t current = nullptr;
+    return current;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    TaskHandle_t& current = hostCurrentTask();
+    if (current == nullptr) {
+        current = new HostTask();
+        current->name = "loopTask";
+    }
+    return current;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                          void* parameter, UBaseType_t priority, TaskHandle_t* created,
+                                          BaseType_t coreId) {
+    // Tasks are real threads; in virtual time they would make runs unrepeatable,
+    // so creation fails and the firmware takes its single-task paths
+    if (HostClock::isVirtual()) {
+        return pdFAIL;
+    }
+    TaskHandle_t task = new HostTask();
+    task->name = name ? name : "";
+    if (created) {
+        *created = task;
+    }
+    std::thread([function, parameter, task]() {
+        hostCurrentTask() = task;
+        try {
+            function(parameter);
+        } catch (const HostTaskExit&) {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                              void* parameter, UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, created, -1);
+}
+
+// Only self-deletion is supported: std::thread cannot be stopped from outside
+inline void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == hostCurrentTask()) {
+        throw HostTaskExit();
+    }
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    if (HostClock::isVirtual()) {
+        HostClock::advanceMs(ticks);
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+    }
+}
+
+inline TickType_t xTaskGetTickCount() {
+    return (TickType_t)(HostClock::nowUs() / 1000);
+}
+
+inline const char* pcTaskGetName(TaskHandle_t task) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    return task->name.c_str();
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 4096;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notifyValue++;
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+    xTaskNotifyGive(task);
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> guard(self->lock);
+    auto ready = [self]() { return self->notifyValue > 0; };
+    if (ticks == portMAX_DELAY) {
+        self->notified.wait(guard, ready);
+    } else {
+        self->notified.wait_for(guard, std::chrono::milliseconds(ticks), ready);
+    }
+    uint32_t value = self->notifyValue;
+    if (value > 0) {
+        self->notifyValue = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+#endif
@@ -0,0 +1,254 @@
+// GPIO fast path harness (pio run -e native_gpio).
+// Checks gpio_hal.cpp's register-level paths against the simulated GPIO
+// matrix, the way gpio_toggle_bench does on the chip without the jumper:
+//   - Pin<N>::set()/clear() are one store of the right mask to the right
+//     W1TS/W1TC register, for pins below 32 and from 32 up
+//   - PinGroup::write() maps bit i to the i-th pin across both banks, with
+//     at most one set and one clear store per bank it uses
+//   - GpioIsr dispatches each pin's edges to its own handler and context,
+//     with the pin level and the esp_timer time of the edge
+//   - after detach() the pin's edges reach no handler and are not counted
+//
+// Usage: program
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "../../firmware/hal/gpio_hal.cpp"
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+struct Store {
+    uint32_t address;
+    uint32_t value;
+
+    bool operator==(const Store& other) const {
+        return address == other.address && value == other.value;
+    }
+};
+
+// Register stores made by one call
+template <typename F>
+static std::vector<Store> storesOf(F call) {
+    std::vector<Store> stores;
+    HostGpio::setRegisterTap([&stores](uint32_t address, uint32_t value) {
+        stores.push_back({ address, value });
+    });
+    call();
+    HostGpio::setRegisterTap(nullptr);
+    return stores;
+}
+
+static const char* registerName(uint32_t address) {
+    switch (address) {
+        case GPIO_OUT_W1TS_REG: return "W1TS";
+        case GPIO_OUT_W1TC_REG: return "W1TC";
+        case GPIO_OUT1_W1TS_REG: return "OUT1_W1TS";
+        case GPIO_OUT1_W1TC_REG: return "OUT1_W1TC";
+        default: return "?";
+    }
+}
+
+static std::string describe(const std::vector<Store>& stores) {
+    std::string text;
+    for (const Store& store : stores) {
+        char item[48];
+        snprintf(item, sizeof(item), "%s%s=0x%08x", text.empty() ? "" : ", ", registerName(store.address),
+                 (unsigned)store.value);
+        text += item;
+    }
+    return text.empty() ? "no stores" : text;
+}
+
+template <uint8_t N>
+static void checkPin(Checks& checks, uint32_t setRegister, uint32_t clearRegister) {
+    using P = Pin<N>;
+    P::output();
+    uint32_t mask = 1u << (N % 32);
+
+    std::vector<Store> set = storesOf([] { P::set(); });
+    checks.expect(set == std::vector<Store>{ { setRegister, mask } } && HostGpio::read(N) == 1,
+                  format("Pin<%.0f>::set() is one store to ", N) + registerName(setRegister),
+                  describe(set));
+    std::vector<Store> clear = storesOf([] { P::clear(); });
+    checks.expect(clear == std::vector<Store>{ { clearRegister, mask } } && HostGpio::read(N) == 0,
+                  format("Pin<%.0f>::clear() is one store to ", N) + registerName(clearRegister),
+                  describe(clear));
+
+    P::toggle();
+    bool high = P::read();
+    P::toggle();
+    checks.expect(high && !P::read(), format("Pin<%.0f>::toggle() flips the latch and read() sees it", N));
+}
+
+static void checkPins(Checks& checks) {
+    printf("Pin<N> stores:\n");
+    checkPin<4>(checks, GPIO_OUT_W1TS_REG, GPIO_OUT_W1TC_REG);
+    checkPin<31>(checks, GPIO_OUT_W1TS_REG, GPIO_OUT_W1TC_REG);
+    checkPin<32>(checks, GPIO_OUT1_W1TS_REG, GPIO_OUT1_W1TC_REG);
+    checkPin<47>(checks, GPIO_OUT1_W1TS_REG, GPIO_OUT1_W1TC_REG);
+}
+
+static void checkGroups(Checks& checks) {
+    printf("\nPinGroup stores:\n");
+    static const uint8_t PINS[] = { 4, 38, 21, 45, 33 };
+    using Group = PinGroup<4, 38, 21, 45, 33>;
+    Group::output();
+    char masks[48];
+    snprintf(masks, sizeof(masks), "0x%08x and 0x%08x", (unsigned)Group::LOW_MASK, (unsigned)Group::HIGH_MASK);
+    checks.expect(Group::LOW_MASK == ((1u << 4) | (1u << 21)) && Group::HIGH_MASK == ((1u << 6) | (1u << 13) | (1u << 1)),
+                  "the bank masks hold each pin's bit", masks);
+
+    // Every pattern: levels follow the bits, one set and one clear store per bank
+    int wrongLevels = 0;
+    int wrongStores = 0;
+    for (uint32_t bits = 0; bits < (1u << Group::COUNT); bits++) {
+        uint32_t lowSet = 0;
+        uint32_t highSet = 0;
+        for (size_t i = 0; i < Group::COUNT; i++) {
+            bool on = (bits >> i) & 1;
+            if (on && PINS[i] < 32) lowSet |= 1u << PINS[i];
+            if (on && PINS[i] >= 32) highSet |= 1u << (PINS[i] - 32);
+        }
+        std::vector<Store> stores = storesOf([bits] { Group::write(bits); });
+        std::vector<Store> expected = {
+            { GPIO_OUT_W1TS_REG, lowSet },
+            { GPIO_OUT_W1TC_REG, Group::LOW_MASK & ~lowSet },
+            { GPIO_OUT1_W1TS_REG, highSet },
+            { GPIO_OUT1_W1TC_REG, Group::HIGH_MASK & ~highSet },
+        };
+        if (stores != expected) {
+            if (wrongStores++ == 0) printf("       0x%02x: %s\n", (unsigned)bits, describe(stores).c_str());
+        }
+        for (size_t i = 0; i < Group::COUNT; i++) {
+            if (HostGpio::read(PINS[i]) != (int)((bits >> i) & 1)) wrongLevels++;
+        }
+    }
+    checks.expect(wrongLevels == 0, "write(bits): bit i drives the i-th pin, in both banks",
+                  format("%.0f wrong levels over %.0f patterns", wrongLevels, 1u << Group::COUNT));
+    checks.expect(wrongStores == 0, "write(bits): a set and a clear store per bank, masked to the group",
+                  format("%.0f patterns with other stores", wrongStores));
+
+    std::vector<Store> set = storesOf([] { Group::set(); });
+    std::vector<Store> clear = storesOf([] { Group::clear(); });
+    checks.expect(set == std::vector<Store>{ { GPIO_OUT_W1TS_REG, Group::LOW_MASK }, { GPIO_OUT1_W1TS_REG, Group::HIGH_MASK } } &&
+                  clear == std::vector<Store>{ { GPIO_OUT_W1TC_REG, Group::LOW_MASK }, { GPIO_OUT1_W1TC_REG, Group::HIGH_MASK } },
+                  "set()/clear(): one store per bank", describe(set) + "; " + describe(clear));
+
+    using LowGroup = PinGroup<1, 2, 3>;
+    LowGroup::output();
+    std::vector<Store> low = storesOf([] { LowGroup::write(0b101); });
+    checks.expect(low == std::vector<Store>{ { GPIO_OUT_W1TS_REG, 0b1010u }, { GPIO_OUT_W1TC_REG, 0b0100u } },
+                  "a group in one bank never stores to the other", describe(low));
+}
+
+struct EdgeLog {
+    uint32_t count = 0;
+    uint8_t pin = 0;
+    uint8_t level = 0;
+    int64_t timeUs = 0;
+    void* context = nullptr;
+};
+
+static void onEdge(const GpioEdge& edge, void* context) {
+    EdgeLog* log = static_cast<EdgeLog*>(context);
+    log->count++;
+    log->pin = edge.pin;
+    log->level = edge.level;
+    log->timeUs = edge.timeUs;
+    log->context = context;
+}
+
+static void checkIsr(Checks& checks) {
+    printf("\nGpioIsr dispatch:\n");
+    EdgeLog low;
+    EdgeLog high;
+    bool attached = GpioIsr::attach(11, onEdge, &low, GPIO_INTR_POSEDGE) &&
+                    GpioIsr::attach(40, onEdge, &high, GPIO_INTR_ANYEDGE);
+    checks.expect(attached, "attach() on GPIO11 and GPIO40");
+
+    HostClock::advanceUs(1500);
+    int64_t rise = esp_timer_get_time();
+    HostGpio::inject(11, 1);
+    checks.expect(low.count == 1 && high.count == 0 && low.context == &low && low.pin == 11,
+                  "an edge on GPIO11 reaches its handler with its own context",
+                  format("%.0f and %.0f calls", low.count, high.count));
+    checks.expect(low.level == 1 && low.timeUs == rise && GpioIsr::lastEdgeUs(11) == rise,
+                  "the edge carries the level and the esp_timer time",
+                  format("level %.0f at %.0f us, edge at %.0f us", low.level, low.timeUs, rise));
+    HostGpio::inject(11, 0);
+    checks.expect(low.count == 1 && GpioIsr::edgeCount(11) == 1, "a falling edge does not match POSEDGE");
+
+    HostClock::advanceUs(250);
+    int64_t set = esp_timer_get_time();
+    Pin<40>::output();
+    Pin<40>::set();
+    bool rose = high.count == 1 && high.level == 1 && high.timeUs == set;
+    HostClock::advanceUs(250);
+    int64_t cleared = esp_timer_get_time();
+    Pin<40>::clear();
+    checks.expect(rose && high.count == 2 && high.level == 0 && high.timeUs == cleared && high.context == &high &&
+                  high.pin == 40 && low.count == 1,
+                  "GPIO40 (bank 1) sees both edges of its own pin, levels read from GPIO_IN1",
+                  format("%.0f calls, last level %.0f", high.count, high.level));
+    checks.expect(GpioIsr::edgeCount(40) == 2 && GpioIsr::lastEdgeUs(40) == cleared,
+                  "edgeCount() and lastEdgeUs() follow the slot");
+
+    printf("\nDetach:\n");
+    GpioIsr::detach(11);
+    HostClock::advanceUs(100);
+    HostGpio::inject(11, 1);
+    HostGpio::inject(11, 0);
+    checks.expect(low.count == 1 && GpioIsr::edgeCount(11) == 1 && GpioIsr::lastEdgeUs(11) == rise,
+                  "after detach() GPIO11's edges reach no handler and are not counted",
+                  format("%.0f calls, %.0f edges", low.count, GpioIsr::edgeCount(11)));
+    Pin<40>::set();
+    checks.expect(high.count == 3, "the other pin still dispatches");
+    GpioIsr::detach(40);
+    Pin<40>::clear();
+    checks.expect(high.count == 3, "and stops after its own detach()");
+
+    EdgeLog again;
+    bool reattached = GpioIsr::attach(11, onEdge, &again, GPIO_INTR_NEGEDGE);
+    HostGpio::inject(11, 1);
+    HostGpio::inject(11, 0);
+    checks.expect(reattached && again.count == 1 && again.level == 0 && low.count == 1 && GpioIsr::edgeCount(11) == 1,
+                  "attach() again starts a fresh slot with the new context and type");
+    GpioIsr::detach(11);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 2;
+    }
+
+    HostClock::setVirtual(true);
+    Serial.setHostOutput(nullptr);
+
+    Checks checks;
+    checkPins(checks);
+    checkGroups(checks);
+    checkIsr(checks);
+
+    if (checks.failed) {
+        printf("\n%d check(s) failed\n", checks.failed);
+        return 1;
+    }
+    printf("\nAll checks passed\n");
+    return 0;
+}
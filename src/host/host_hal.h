@@ -0,0 +1,557 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+// Simulated board behind the Arduino / ESP-IDF shim in this directory.
+// The firmware only sees the usual Arduino and driver APIs; benchmarks and
+// simulations drive pins, buses and the microphone through these classes.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+// Monotonic time as seen by millis()/micros(). delay() does not sleep on the
+// host, it skips the clock forward, so timeouts and polling loops cost nothing.
+// In virtual mode real time is left out entirely: the clock only moves when
+// something advances it, which makes single-task runs fully repeatable.
+class HostClock {
+public:
+    // Called after every advance with the interval that was skipped
+    typedef std::function<void(uint64_t fromUs, uint64_t toUs)> AdvanceHook;
+
+    static uint64_t nowUs() {
+        uint64_t skipped = skippedUs.load(std::memory_order_relaxed);
+        return virtualTime ? skipped : realUs() + skipped;
+    }
+
+    static void advanceUs(uint64_t us) {
+        uint64_t from = nowUs();
+        skippedUs.fetch_add(us, std::memory_order_relaxed);
+        if (hook) {
+            hook(from, from + us);
+        }
+    }
+
+    static void advanceMs(uint32_t ms) {
+        advanceUs((uint64_t)ms * 1000);
+    }
+
+    // Switch before the firmware starts; the clock restarts at zero
+    static void setVirtual(bool enabled) {
+        virtualTime = enabled;
+        skippedUs = 0;
+    }
+
+    static bool isVirtual() {
+        return virtualTime;
+    }
+
+    static void setAdvanceHook(AdvanceHook callback) {
+        hook = callback;
+    }
+
+private:
+    static uint64_t realUs() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+
+    static inline const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    static inline std::atomic<uint64_t> skippedUs{0};
+    static inline bool virtualTime = false;
+    static inline AdvanceHook hook;
+};
+
+// Digital levels, touch readings and analog voltages per GPIO
+class HostGpio {
+public:
+    static const uint8_t PIN_COUNT = 49;
+    static const uint16_t TOUCH_IDLE = 100;     // touchRead() with nothing on the pad
+
+    static void setMode(uint8_t pin, uint8_t mode) {
+        if (pin < PIN_COUNT) modes[pin] = mode;
+    }
+
+    static uint8_t getMode(uint8_t pin) {
+        return pin < PIN_COUNT ? modes[pin] : 0;
+    }
+
+    static void write(uint8_t pin, uint8_t level) {
+        drive(pin, level);
+    }
+
+    static int read(uint8_t pin) {
+        return pin < PIN_COUNT ? levels[pin].load() : 0;
+    }
+
+    // Drive an input from outside the firmware
+    static void inject(uint8_t pin, uint8_t level) {
+        drive(pin, level);
+    }
+
+    static void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+        if (pin >= PIN_COUNT) return;
+        handlers[pin] = handler;
+        interruptModes[pin] = mode;
+    }
+
+    static void detachInterrupt(uint8_t pin) {
+        if (pin < PIN_COUNT) handlers[pin] = nullptr;
+    }
+
+    // IDF per-pin ISR service (driver/gpio.h); types use the same numbering
+    static void setIsr(uint8_t pin, void (*handler)(void*), void* arg) {
+        if (pin >= PIN_COUNT) return;
+        isrHandlers[pin] = handler;
+        isrArgs[pin] = arg;
+    }
+
+    static void setIsrType(uint8_t pin, int type) {
+        if (pin < PIN_COUNT) isrTypes[pin] = type;
+    }
+
+    // GPIO matrix registers behind REG_READ / REG_WRITE (offsets from soc/gpio_reg.h).
+    // Output writes drive the pin like write(), so loopback interrupts fire.
+    static const uint32_t REG_BASE = 0x60004000;
+
+    // Sees every register store, in order, before it takes effect
+    typedef std::function<void(uint32_t address, uint32_t value)> RegisterTap;
+
+    static void setRegisterTap(RegisterTap tap) {
+        registerTap = tap;
+    }
+
+    static void writeRegister(uint32_t address, uint32_t value) {
+        registerWrites.fetch_add(1, std::memory_order_relaxed);
+        if (registerTap) registerTap(address, value);
+        switch (address - REG_BASE) {
+            case 0x04: driveBank(0, value, 0xFFFFFFFF); break;          // OUT
+            case 0x08: driveBank(0, 0xFFFFFFFF, value); break;          // OUT_W1TS
+            case 0x0C: driveBank(0, 0, value); break;                   // OUT_W1TC
+            case 0x10: driveBank(32, value, 0xFFFFFFFF); break;         // OUT1
+            case 0x14: driveBank(32, 0xFFFFFFFF, value); break;         // OUT1_W1TS
+            case 0x18: driveBank(32, 0, value); break;                  // OUT1_W1TC
+            case 0x24: enableBank(0, value, true); break;               // ENABLE_W1TS
+            case 0x28: enableBank(0, value, false); break;              // ENABLE_W1TC
+            case 0x30: enableBank(32, value, true); break;              // ENABLE1_W1TS
+            case 0x34: enableBank(32, value, false); break;             // ENABLE1_W1TC
+        }
+    }
+
+    static uint32_t readRegister(uint32_t address) {
+        uint8_t base;
+        switch (address - REG_BASE) {
+            case 0x04: case 0x3C: base = 0; break;                      // OUT, IN
+            case 0x10: case 0x40: base = 32; break;                     // OUT1, IN1
+            default: return 0;
+        }
+        uint32_t bits = 0;
+        for (uint8_t i = 0; i < 32 && base + i < PIN_COUNT; i++) {
+            bits |= (uint32_t)levels[base + i].load() << i;
+        }
+        return bits;
+    }
+
+    // Register stores so far, to check that a fast path is a single write
+    static uint32_t getRegisterWrites() {
+        return registerWrites.load(std::memory_order_relaxed);
+    }
+
+    static void setTouch(uint8_t pin, uint16_t value) {
+        if (pin < PIN_COUNT) touchValues[pin] = value;
+    }
+
+    static uint16_t touch(uint8_t pin) {
+        return pin < PIN_COUNT ? touchValues[pin].load() : 0;
+    }
+
+    static void setMilliVolts(uint8_t pin, uint32_t millivolts) {
+        if (pin < PIN_COUNT) analogMv[pin] = millivolts;
+    }
+
+    static uint32_t milliVolts(uint8_t pin) {
+        return pin < PIN_COUNT ? analogMv[pin].load() : 0;
+    }
+
+    static void reset() {
+        for (uint8_t i = 0; i < PIN_COUNT; i++) {
+            modes[i] = 0;
+            levels[i] = 0;
+            handlers[i] = nullptr;
+            isrHandlers[i] = nullptr;
+            isrTypes[i] = 0;
+            touchValues[i] = TOUCH_IDLE;
+            analogMv[i] = 0;
+        }
+    }
+
+private:
+    static inline uint8_t modes[PIN_COUNT] = {};
+    static inline std::atomic<uint8_t> levels[PIN_COUNT] = {};
+    static inline void (*handlers[PIN_COUNT])() = {};
+    static inline int interruptModes[PIN_COUNT] = {};
+    static inline void (*isrHandlers[PIN_COUNT])(void*) = {};
+    static inline void* isrArgs[PIN_COUNT] = {};
+    static inline int isrTypes[PIN_COUNT] = {};
+    static inline std::atomic<uint32_t> registerWrites{0};
+    static inline RegisterTap registerTap;
+
+    static bool triggers(int type, uint8_t previous, uint8_t level) {
+        switch (type) {
+            case 1: return !previous && level;      // RISING / GPIO_INTR_POSEDGE
+            case 2: return previous && !level;      // FALLING / NEGEDGE
+            case 3: return previous != level;       // CHANGE / ANYEDGE
+            case 4: return !level;                  // ONLOW / LOW_LEVEL
+            case 5: return level;                   // ONHIGH / HIGH_LEVEL
+            default: return false;
+        }
+    }
+
+    // Sets a level and runs whichever handler is attached to the pin, as the
+    // GPIO interrupt would on the chip
+    static void drive(uint8_t pin, uint8_t level) {
+        if (pin >= PIN_COUNT) return;
+        uint8_t previous = levels[pin];
+        levels[pin] = level ? 1 : 0;
+
+        void (*handler)() = handlers[pin];
+        if (handler != nullptr && triggers(interruptModes[pin], previous, levels[pin])) {
+            handler();
+        }
+        void (*isr)(void*) = isrHandlers[pin];
+        if (isr != nullptr && triggers(isrTypes[pin], previous, levels[pin])) {
+            isr(isrArgs[pin]);
+        }
+    }
+
+    // Drives the pins of one register bank selected by mask to the bits in value
+    static void driveBank(uint8_t base, uint32_t value, uint32_t mask) {
+        for (uint8_t i = 0; i < 32 && base + i < PIN_COUNT; i++) {
+            if (mask & (1u << i)) drive(base + i, (value >> i) & 1);
+        }
+    }
+
+    static void enableBank(uint8_t base, uint32_t mask, bool output) {
+        for (uint8_t i = 0; i < 32 && base + i < PIN_COUNT; i++) {
+            if (mask & (1u << i)) modes[base + i] = output ? 0x03 : 0x01;
+        }
+    }
+    static inline std::atomic<uint16_t> touchValues[PIN_COUNT] = {};
+    static inline std::atomic<uint32_t> analogMv[PIN_COUNT] = {};
+
+    // Pads read as untouched until a test says otherwise
+    struct Init {
+        Init() { HostGpio::reset(); }
+    };
+    static inline Init init;
+};
+
+// A device on the simulated I2C bus
+class HostI2cDevice {
+public:
+    virtual ~HostI2cDevice() {}
+    virtual void onWrite(const uint8_t* data, size_t length) {}
+    virtual size_t onRead(uint8_t* out, size_t length) {
+        memset(out, 0xFF, length);
+        return length;
+    }
+    // SCL held low before the device answers, per transfer
+    virtual uint32_t stretchUs() { return 0; }
+};
+
+// I2C bus with attachable devices. Transfers advance HostClock by the time
+// they would take on the wire (9 clocks per byte plus the address byte).
+class HostI2c {
+public:
+    static const uint8_t MAX_ADDRESS = 128;
+
+    static void attach(uint8_t address, HostI2cDevice* device) {
+        if (address < MAX_ADDRESS) devices[address] = device;
+    }
+
+    static void detach(uint8_t address) {
+        if (address < MAX_ADDRESS) devices[address] = nullptr;
+    }
+
+    static void setFrequency(uint32_t hz) {
+        frequency = hz ? hz : 100000;
+    }
+
+    static uint32_t getFrequency() {
+        return frequency;
+    }
+
+    // Wire status codes: 0 success, 2 address not acknowledged
+    static uint8_t write(uint8_t address, const uint8_t* data, size_t length) {
+        HostI2cDevice* device = address < MAX_ADDRESS ? devices[address] : nullptr;
+        if (device == nullptr) {
+            chargeBus(0);
+            return 2;
+        }
+        device->onWrite(data, length);
+        chargeBus(length);
+        bytesWritten += length;
+        return 0;
+    }
+
+    static size_t read(uint8_t address, uint8_t* out, size_t length) {
+        HostI2cDevice* device = address < MAX_ADDRESS ? devices[address] : nullptr;
+        if (device == nullptr) {
+            chargeBus(0);
+            return 0;
+        }
+        size_t count = device->onRead(out, length);
+        chargeBus(count);
+        bytesRead += count;
+        return count;
+    }
+
+    // Clock stretching of the device at address; the driver times out on it
+    static uint32_t stretchUs(uint8_t address) {
+        HostI2cDevice* device = address < MAX_ADDRESS ? devices[address] : nullptr;
+        return device != nullptr ? device->stretchUs() : 0;
+    }
+
+    static uint32_t getTransactions() { return transactions; }
+    static uint64_t getBytesWritten() { return bytesWritten; }
+    static uint64_t getBusyUs() { return busyUs; }
+
+    static void resetStats() {
+        transactions = 0;
+        bytesWritten = 0;
+        bytesRead = 0;
+        busyUs = 0;
+    }
+
+private:
+    static inline HostI2cDevice* devices[MAX_ADDRESS] = {};
+    static inline uint32_t frequency = 100000;
+    static inline std::atomic<uint32_t> transactions{0};
+    static inline std::atomic<uint64_t> bytesWritten{0};
+    static inline std::atomic<uint64_t> bytesRead{0};
+    static inline std::atomic<uint64_t> busyUs{0};
+
+    static void chargeBus(size_t payload) {
+        uint64_t us = (uint64_t)(payload + 1) * 9 * 1000000 / frequency;
+        transactions++;
+        busyUs += us;
+        HostClock::advanceUs(us);
+    }
+};
+
+// Receive DMA state of one I2S port in virtual time
+struct HostI2sClock {
+    bool running = false;
+    uint32_t rate = 16000;
+    size_t ringSamples = 0;
+    uint64_t startUs = 0;
+    uint64_t cursor = 0;      // Index of the next sample to hand out
+    uint32_t overruns = 0;
+};
+
+// Transmit DMA state of one I2S port: samples queued ahead of the DAC
+struct HostI2sTxClock {
+    bool running = false;
+    uint32_t rate = 16000;
+    size_t ringSamples = 0;
+    uint64_t startUs = 0;
+    uint64_t queued = 0;      // Index of the next sample written
+    uint32_t underruns = 0;
+};
+
+// Microphone / speaker side of the I2S peripherals. A source produces 16-bit
+// samples on demand; when it has nothing, reads wait like a starved DMA queue.
+//
+// In virtual time a started port behaves like the DMA engine instead: samples
+// arrive at the configured rate, a read waits (advances the clock) until enough
+// have arrived, and anything older than the DMA ring is dropped as an overrun.
+//
+// A transmitting port plays at its rate from startTx(), in real or virtual
+// time: a write waits for room in the DMA ring, and the sink gets each block
+// with the clock time its first sample reaches the DAC. When writes fall
+// behind, the DMA sends silence and later samples play later (an underrun).
+class HostI2s {
+public:
+    static const uint8_t PORTS = 2;
+
+    // Fills up to count samples, returns how many it produced
+    typedef std::function<size_t(int16_t* out, size_t count)> Source;
+    typedef std::function<void(const int16_t* samples, size_t count, uint64_t playUs)> Sink;
+
+    static void setSource(uint8_t port, Source source) {
+        if (port < PORTS) sources[port] = source;
+    }
+
+    static void setSink(uint8_t port, Sink sink) {
+        if (port < PORTS) sinks[port] = sink;
+    }
+
+    // Called by the driver on install. With several channels, sampleRate counts
+    // every channel's samples and ringSamples is dma_buf_count * dma_buf_len * channels
+    static void start(uint8_t port, uint32_t sampleRate, size_t ringSamples) {
+        if (port >= PORTS) return;
+        clocks[port].running = true;
+        clocks[port].rate = sampleRate ? sampleRate : 16000;
+        clocks[port].ringSamples = ringSamples;
+        clocks[port].startUs = HostClock::nowUs();
+        clocks[port].cursor = 0;
+    }
+
+    static void stop(uint8_t port) {
+        if (port < PORTS) clocks[port].running = false;
+    }
+
+    static bool isRunning(uint8_t port) {
+        return port < PORTS && clocks[port].running;
+    }
+
+    // Clock time at which the first sample of a running port was captured
+    static uint64_t getStartUs(uint8_t port) {
+        return port < PORTS ? clocks[port].startUs : 0;
+    }
+
+    // Returns bytes read; waits up to timeoutMs of real time for the source
+    static size_t read(uint8_t port, void* dest, size_t bytes, uint32_t timeoutMs) {
+        if (port >= PORTS) return 0;
+        if (HostClock::isVirtual() && clocks[port].running) {
+            return readClocked(port, (int16_t*)dest, bytes / sizeof(int16_t)) * sizeof(int16_t);
+        }
+
+        int16_t* out = (int16_t*)dest;
+        size_t wanted = bytes / sizeof(int16_t);
+        size_t got = 0;
+        uint32_t waited = 0;
+
+        while (got < wanted) {
+            size_t n = sources[port] ? sources[port](out + got, wanted - got) : 0;
+            got += n;
+            if (n > 0) continue;
+            if (waited >= timeoutMs) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            waited++;
+        }
+        samplesRead[port] += got;
+        return got * sizeof(int16_t);
+    }
+
+    // Starts the transmit clock; the DMA is already sending the first
+    // leadSamples (a buffer of silence, or data preloaded before the start)
+    static void startTx(uint8_t port, uint32_t sampleRate, size_t ringSamples, size_t leadSamples = 0) {
+        if (port >= PORTS) return;
+        HostI2sTxClock& clock = txClocks[port];
+        clock.running = true;
+        clock.rate = sampleRate ? sampleRate : 16000;
+        clock.ringSamples = ringSamples;
+        clock.startUs = HostClock::nowUs();
+        clock.queued = leadSamples;
+    }
+
+    static void stopTx(uint8_t port) {
+        if (port < PORTS) txClocks[port].running = false;
+    }
+
+    static bool isTransmitting(uint8_t port) {
+        return port < PORTS && txClocks[port].running;
+    }
+
+    // Returns bytes written; waits up to timeoutMs for room in the ring
+    static size_t write(uint8_t port, const void* src, size_t bytes, uint32_t timeoutMs) {
+        if (port >= PORTS || !txClocks[port].running) return 0;
+        HostI2sTxClock& clock = txClocks[port];
+        size_t count = bytes / sizeof(int16_t);
+        uint64_t played = playedBy(clock, HostClock::nowUs());
+        if (clock.queued < played) {
+            clock.queued = played;
+            clock.underruns++;
+        }
+        if (clock.queued + count > played + clock.ringSamples) {
+            uint64_t readyUs = clock.startUs + ((clock.queued + count - clock.ringSamples) * 1000000 + clock.rate - 1) / clock.rate;
+            uint64_t now = HostClock::nowUs();
+            uint64_t waitUs = readyUs > now ? readyUs - now : 0;
+            if (waitUs > (uint64_t)timeoutMs * 1000) waitUs = (uint64_t)timeoutMs * 1000;
+            if (HostClock::isVirtual()) {
+                HostClock::advanceUs(waitUs);
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+            }
+            played = playedBy(clock, HostClock::nowUs());
+        }
+        size_t room = (size_t)(played + clock.ringSamples - clock.queued);
+        if (count > room) count = room;
+        if (sinks[port] && count > 0) {
+            sinks[port]((const int16_t*)src, count, clock.startUs + clock.queued * 1000000 / clock.rate);
+        }
+        clock.queued += count;
+        return count * sizeof(int16_t);
+    }
+
+    static uint32_t getUnderruns(uint8_t port) {
+        return port < PORTS ? txClocks[port].underruns : 0;
+    }
+
+    static uint64_t getSamplesRead(uint8_t port) {
+        return port < PORTS ? samplesRead[port].load() : 0;
+    }
+
+    // Ring overruns since start; the driver turns new ones into RX_Q_OVF events
+    static uint32_t getOverruns(uint8_t port) {
+        return port < PORTS ? clocks[port].overruns : 0;
+    }
+
+private:
+    static inline Source sources[PORTS];
+    static inline Sink sinks[PORTS];
+    static inline std::atomic<uint64_t> samplesRead[PORTS] = {};
+    static inline HostI2sClock clocks[PORTS];
+    static inline HostI2sTxClock txClocks[PORTS];
+
+    static uint64_t playedBy(const HostI2sTxClock& clock, uint64_t us) {
+        return (us - clock.startUs) * clock.rate / 1000000;
+    }
+
+    static uint64_t capturedBy(const HostI2sClock& clock, uint64_t us) {
+        return (us - clock.startUs) * clock.rate / 1000000;
+    }
+
+    static size_t readClocked(uint8_t port, int16_t* out, size_t count) {
+        HostI2sClock& clock = clocks[port];
+
+        // The reader fell behind: the DMA ring kept only the newest samples
+        uint64_t captured = capturedBy(clock, HostClock::nowUs());
+        if (clock.ringSamples && captured - clock.cursor > clock.ringSamples) {
+            pull(port, nullptr, captured - clock.ringSamples - clock.cursor);
+            clock.cursor = captured - clock.ringSamples;
+            clock.overruns++;
+        }
+
+        // Block until the last requested sample has been captured
+        uint64_t needed = clock.cursor + count;
+        if (captured < needed) {
+            uint64_t readyUs = clock.startUs + (needed * 1000000 + clock.rate - 1) / clock.rate;
+            HostClock::advanceUs(readyUs - HostClock::nowUs());
+        }
+
+        pull(port, out, count);
+        clock.cursor += count;
+        samplesRead[port] += count;
+        return count;
+    }
+
+    // Takes count samples from the source, silence where it has none
+    static void pull(uint8_t port, int16_t* out, uint64_t count) {
+        int16_t scratch[256];
+        while (count > 0) {
+            size_t chunk = out ? (size_t)count : (size_t)(count < 256 ? count : 256);
+            int16_t* dest = out ? out : scratch;
+            size_t got = sources[port] ? sources[port](dest, chunk) : 0;
+            memset(dest + got, 0, (chunk - got) * sizeof(int16_t));
+            if (out) out += chunk;
+            count -= chunk;
+        }
+    }
+};
+
+#endif
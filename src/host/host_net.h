@@ -0,0 +1,243 @@
+#ifndef HOST_NET_H
+#define HOST_NET_H
+
+// Simulated access point and server behind the WiFi / HTTPClient shim.
+// Request latency and upload time advance HostClock instead of sleeping.
+
+#include "Arduino.h"
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// As in esp_wifi_types.h
+typedef enum {
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,      // Wakes for every DTIM beacon
+    WIFI_PS_MAX_MODEM       // Wakes every listen interval
+} wifi_ps_type_t;
+
+class HostWifi {
+public:
+    // What the radio is doing, for energy accounting
+    enum Radio {
+        RADIO_OFF,
+        RADIO_IDLE,      // Associated, waiting (modem sleep if enabled)
+        RADIO_SCAN,      // Connecting or searching for a lost access point
+        RADIO_TX,
+        RADIO_RX
+    };
+
+    static inline std::atomic<bool> apAvailable{true};    // Access point in range
+    static inline std::atomic<int> rssi{-55};
+    static inline std::atomic<uint32_t> connectMs{800};   // Association + DHCP time
+    static inline std::atomic<int> powerSave{WIFI_PS_MIN_MODEM};   // Core default
+    static inline std::atomic<uint16_t> listenInterval{0};  // Station config; 0 is the driver's 3
+    static inline std::atomic<uint8_t> dtimPeriod{1};
+    static inline std::atomic<bool> autoReconnect{true};  // Core default: rejoin after a drop
+
+    static const uint32_t BEACON_US = 102400;
+    // After it transmits, a sleeping station stays awake this long (the
+    // driver's minimum active time), so a quick reply is not held for a beacon
+    static const uint32_t MIN_ACTIVE_MS = 50;
+
+    // Drop the link; the firmware sees WL_CONNECTION_LOST until it reconnects
+    static void dropLink() {
+        linkUp = false;
+        lost = true;
+    }
+
+    static void startConnect() {
+        connectStartUs = HostClock::nowUs();
+        connecting = true;
+        lost = false;
+    }
+
+    static void disconnect() {
+        connecting = false;
+        linkUp = false;
+        lost = false;
+    }
+
+    static bool isConnected() {
+        if (lost && autoReconnect && apAvailable && !connecting) {
+            startConnect();
+        }
+        if (!linkUp && connecting && apAvailable &&
+            HostClock::nowUs() - connectStartUs >= (uint64_t)connectMs * 1000) {
+            linkUp = true;
+            connecting = false;
+            associatedUs = connectStartUs + (uint64_t)connectMs * 1000;
+            associatedInterval = listenInterval ? listenInterval.load() : 3;
+        }
+        return linkUp && apAvailable;
+    }
+
+    static bool isAssociating() {
+        return connecting && !linkUp;
+    }
+
+    // Beacons between the wakes of a sleeping station. The listen interval
+    // is the one sent when it associated.
+    static uint32_t wakeBeacons() {
+        return powerSave == WIFI_PS_MAX_MODEM ? associatedInterval.load() : dtimPeriod.load();
+    }
+
+    // Until the next wake, when the AP hands over what it buffered
+    static uint64_t untilWakeUs() {
+        uint64_t period = (uint64_t)wakeBeacons() * BEACON_US;
+        return period - (HostClock::nowUs() - associatedUs) % period;
+    }
+
+    static bool wasLost() {
+        return lost || (linkUp && !apAvailable);
+    }
+
+    static Radio radio() {
+        if (transfer != RADIO_OFF) return (Radio)transfer.load();
+        if (isConnected()) return RADIO_IDLE;
+        return connecting || wasLost() ? RADIO_SCAN : RADIO_OFF;
+    }
+
+    // Set by HostHttp while a request is on the air
+    static void setTransfer(Radio state) {
+        transfer = state;
+    }
+
+private:
+    static inline std::atomic<bool> linkUp{false};
+    static inline std::atomic<bool> connecting{false};
+    static inline std::atomic<bool> lost{false};
+    static inline std::atomic<uint64_t> connectStartUs{0};
+    static inline std::atomic<uint64_t> associatedUs{0};
+    static inline std::atomic<uint16_t> associatedInterval{3};
+    static inline std::atomic<int> transfer{RADIO_OFF};
+};
+
+class WiFiClientSecure;
+
+struct HostHttpRequest {
+    String method;
+    String url;
+    const WiFiClientSecure* secure = nullptr;   // The client an https:// request was begun with
+    std::vector<std::pair<String, String>> headers;
+    std::vector<uint8_t> body;
+    uint32_t timeoutMs = 5000;   // HTTPClient default
+
+    String header(const char* name) const {
+        for (const auto& h : headers) {
+            if (h.first.equalsIgnoreCase(name)) return h.second;
+        }
+        return String();
+    }
+};
+
+struct HostHttpResponse {
+    int code = 200;
+    String body;
+    uint32_t latencyMs = 0;      // Server processing plus network round trip
+    std::vector<std::pair<String, String>> headers;
+};
+
+class HostHttp {
+public:
+    typedef std::function<HostHttpResponse(const HostHttpRequest&)> Handler;
+
+    // Uplink throughput used to charge request bodies to the clock
+    static inline std::atomic<uint32_t> uplinkBitsPerSecond{2000000};
+    // Network round trip added to every request, on top of the handler's latency
+    static inline std::atomic<uint32_t> roundTripMs{0};
+    // Downlink throughput charged as a streamed response body is read
+    static inline std::atomic<uint32_t> downlinkBitsPerSecond{20000000};
+    // Off when the handler is a real transport that already took the time
+    static inline std::atomic<bool> chargeClock{true};
+
+    static void setHandler(Handler handler) {
+        std::lock_guard<std::mutex> guard(lock);
+        current = handler;
+    }
+
+    // Negative codes match HTTPClient errors (-1 connection refused)
+    static HostHttpResponse perform(const HostHttpRequest& request) {
+        Handler handler;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            handler = current;
+        }
+        HostHttpResponse response;
+        if (!handler || !HostWifi::isConnected()) {
+            response.code = -1;
+            return response;
+        }
+        response = handler(request);
+        requests++;
+        if (!chargeClock) {
+            return response;
+        }
+        uint64_t uploadUs = (uint64_t)request.body.size() * 8 * 1000000 / uplinkBitsPerSecond;
+        HostWifi::setTransfer(HostWifi::RADIO_TX);
+        HostClock::advanceUs(uploadUs);
+        uint32_t waitMs = response.latencyMs + roundTripMs;
+        if (HostWifi::powerSave != WIFI_PS_NONE && waitMs > HostWifi::MIN_ACTIVE_MS) {
+            // Asleep while the server works; the AP holds the reply until the next wake
+            HostWifi::setTransfer(HostWifi::RADIO_RX);
+            HostClock::advanceMs(HostWifi::MIN_ACTIVE_MS);
+            HostWifi::setTransfer(HostWifi::RADIO_OFF);
+            HostClock::advanceMs(waitMs - HostWifi::MIN_ACTIVE_MS);
+            HostClock::advanceUs(HostWifi::untilWakeUs());
+        } else {
+            HostWifi::setTransfer(HostWifi::RADIO_RX);
+            HostClock::advanceMs(waitMs);
+        }
+        HostWifi::setTransfer(HostWifi::RADIO_OFF);
+        return response;
+    }
+
+    static uint32_t getRequestCount() { return requests; }
+
+private:
+    static inline std::mutex lock;
+    static inline Handler current;
+    static inline std::atomic<uint32_t> requests{0};
+};
+
+// Byte stream behind WiFiClient::connect(): a simulated server or a real socket
+class HostSocket {
+public:
+    virtual ~HostSocket() {}
+    // Takes what fits in the send buffer now, possibly nothing
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+    virtual size_t read(uint8_t* data, size_t length) = 0;
+    virtual size_t available() = 0;
+    virtual bool connected() = 0;
+    virtual void close() = 0;
+};
+
+class HostSockets {
+public:
+    typedef std::function<std::shared_ptr<HostSocket>(const String& host, uint16_t port)> Connector;
+
+    static void setConnector(Connector connector) {
+        std::lock_guard<std::mutex> guard(lock);
+        current = connector;
+    }
+
+    // nullptr, as for a refused connection, without a connector or a link
+    static std::shared_ptr<HostSocket> connect(const String& host, uint16_t port) {
+        Connector connector;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            connector = current;
+        }
+        if (!connector || !HostWifi::isConnected()) {
+            return nullptr;
+        }
+        return connector(host, port);
+    }
+
+private:
+    static inline std::mutex lock;
+    static inline Connector current;
+};
+
+#endif
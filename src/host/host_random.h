@@ -0,0 +1,45 @@
+#ifndef HOST_RANDOM_H
+#define HOST_RANDOM_H
+
+// Seeded random numbers for host tools. splitmix64 is small and gives the same
+// sequence on every platform, unlike the <random> distributions.
+
+#include <stdint.h>
+#include <math.h>
+
+class HostRandom {
+public:
+    explicit HostRandom(uint64_t seed = 1) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double normal() {
+        double u1 = uniform();
+        double u2 = uniform();
+        return sqrt(-2.0 * log(u1 > 0 ? u1 : 1e-300)) * cos(2.0 * M_PI * u2);
+    }
+
+    double exponential(double mean) {
+        return -mean * log(1.0 - uniform());
+    }
+
+    // Log-normal around a median; sigma is the spread of the underlying normal
+    double logNormal(double median, double sigma) {
+        return median * exp(sigma * normal());
+    }
+
+private:
+    uint64_t state;
+};
+
+#endif
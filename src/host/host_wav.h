@@ -0,0 +1,81 @@
+#ifndef HOST_WAV_H
+#define HOST_WAV_H
+
+// 16-bit mono PCM WAV files for host tools.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+inline bool loadWav(const std::string& path, uint32_t sampleRate, std::vector<int16_t>& samples, std::string& error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + n);
+    }
+    fclose(file);
+
+    auto u16 = [&](size_t at) { return (uint32_t)data[at] | (uint32_t)data[at + 1] << 8; };
+    auto u32 = [&](size_t at) { return u16(at) | u16(at + 2) << 16; };
+    if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) || memcmp(&data[8], "WAVE", 4)) {
+        error = path + " is not a WAV file";
+        return false;
+    }
+
+    bool formatOk = false;
+    for (size_t at = 12; at + 8 <= data.size();) {
+        uint32_t size = u32(at + 4);
+        size_t body = at + 8;
+        if (!memcmp(&data[at], "fmt ", 4) && body + 16 <= data.size()) {
+            formatOk = u16(body) == 1 && u16(body + 2) == 1 && u32(body + 4) == sampleRate && u16(body + 14) == 16;
+        } else if (!memcmp(&data[at], "data", 4)) {
+            if (!formatOk) break;
+            size_t end = std::min(data.size(), body + size);
+            for (size_t i = body; i + 1 < end; i += 2) {
+                samples.push_back((int16_t)u16(i));
+            }
+            return true;
+        }
+        at = body + size + (size & 1);
+    }
+    error = path + ": need " + std::to_string(sampleRate) + " Hz mono 16-bit PCM";
+    return false;
+}
+
+inline bool saveWav(const std::string& path, uint32_t sampleRate, const int16_t* samples, size_t count) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint32_t dataBytes = (uint32_t)(count * sizeof(int16_t));
+    uint8_t header[44];
+    auto put16 = [&](size_t at, uint32_t v) { header[at] = v & 0xFF; header[at + 1] = (v >> 8) & 0xFF; };
+    auto put32 = [&](size_t at, uint32_t v) { put16(at, v & 0xFFFF); put16(at + 2, v >> 16); };
+    memcpy(header, "RIFF", 4);
+    put32(4, 36 + dataBytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(16, 16);
+    put16(20, 1);                   // PCM
+    put16(22, 1);                   // Mono
+    put32(24, sampleRate);
+    put32(28, sampleRate * 2);
+    put16(32, 2);
+    put16(34, 16);
+    memcpy(header + 36, "data", 4);
+    put32(40, dataBytes);
+    // Samples are stored little-endian, as on every host this builds on
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+              fwrite(samples, sizeof(int16_t), count, file) == count;
+    return fclose(file) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,436 @@
+// I2C bus harness (pio run -e native_i2c).
+// Runs I2cBus with its task on a simulated bus and holds the task on a gated
+// device while transactions queue up behind it, so the queue is what the
+// bus task sees on the chip under load. It checks:
+//   - which queued writes go out together: same device, same control prefix,
+//     no reads, prefix 0 never, up to MAX_MERGE and MERGE_BYTES
+//   - that a NACK or a clock-stretch timeout reaches the callers of that
+//     transfer, and only them
+//   - that the bus runs at the slowest registered device's clock, capped by
+//     the board's, from the next transfer
+//   - per-device DeviceStats and the latency histogram's bucket counts
+//
+// Usage: program
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../firmware/hal/i2c_bus.cpp"
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+// Keeps the bus task inside a transfer until opened, so what is submitted
+// meanwhile waits in the queue
+class GateDevice : public HostI2cDevice {
+public:
+    static const uint8_t ADDRESS = 0x20;
+    std::atomic<bool> open{true};
+    std::atomic<bool> entered{false};
+
+    void onWrite(const uint8_t* data, size_t length) override {
+        entered = true;
+        while (!open) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+// SSD1306 stand-in: keeps every transfer it receives
+class PanelDevice : public HostI2cDevice {
+public:
+    static const uint8_t ADDRESS = 0x3C;
+    std::vector<std::vector<uint8_t>> transfers;
+
+    void onWrite(const uint8_t* data, size_t length) override {
+        transfers.emplace_back(data, data + length);
+    }
+};
+
+// Register-mapped sensor: 0x12 0x34 from any register
+class SensorDevice : public HostI2cDevice {
+public:
+    static const uint8_t ADDRESS = 0x48;
+
+    size_t onRead(uint8_t* out, size_t length) override {
+        for (size_t i = 0; i < length; i++) out[i] = i % 2 ? 0x34 : 0x12;
+        return length;
+    }
+};
+
+// Holds SCL low for longer than the bus task's transfer timeout
+class StuckDevice : public HostI2cDevice {
+public:
+    static const uint8_t ADDRESS = 0x29;
+
+    uint32_t stretchUs() override {
+        return (I2cBus::TRANSFER_TIMEOUT_MS + 20) * 1000;
+    }
+};
+
+static const uint8_t ABSENT = 0x50;     // Nothing answers here: a NACK
+
+static GateDevice gate;
+static PanelDevice panel;
+static SensorDevice sensor;
+static StuckDevice stuck;
+
+// What one caller got back
+struct Caller {
+    I2cResult result = {};
+    uint32_t calls = 0;
+};
+
+static void onDone(const I2cResult& result, void* context) {
+    Caller* caller = static_cast<Caller*>(context);
+    caller->result = result;
+    caller->calls++;
+}
+
+static I2cTransaction writeOf(uint8_t address, const uint8_t* tx, size_t length, uint8_t prefix, Caller* caller) {
+    I2cTransaction transaction;
+    transaction.address = address;
+    transaction.tx = tx;
+    transaction.txLength = length;
+    transaction.mergePrefix = prefix;
+    transaction.callback = caller != nullptr ? onDone : nullptr;
+    transaction.context = caller;
+    return transaction;
+}
+
+static I2cTransaction readOf(uint8_t address, const uint8_t* reg, uint8_t* rx, size_t length, Caller* caller) {
+    I2cTransaction transaction = writeOf(address, reg, 1, 0, caller);
+    transaction.rx = rx;
+    transaction.rxLength = length;
+    return transaction;
+}
+
+// Submits the batch while the bus task is held on the gate, so the task
+// finds all of it queued, and waits until the last one completes
+static void runQueued(std::vector<I2cTransaction> batch, uint32_t holdMs = 0) {
+    static const uint8_t knock = 0x00;
+    gate.open = false;
+    gate.entered = false;
+    I2cBus::submit(writeOf(GateDevice::ADDRESS, &knock, 1, 0, nullptr));
+    while (!gate.entered) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    I2cFuture done;
+    batch.back().future = &done;
+    for (const I2cTransaction& transaction : batch) {
+        I2cBus::submit(transaction);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(holdMs));
+    gate.open = true;
+    done.wait();
+}
+
+static std::string bytesOf(const std::vector<uint8_t>& data) {
+    std::string text;
+    for (uint8_t byte : data) {
+        char item[8];
+        snprintf(item, sizeof(item), "%s%02x", text.empty() ? "" : " ", byte);
+        text += item;
+    }
+    return "[" + text + "]";
+}
+
+static std::string transfersOf(size_t from) {
+    std::string text;
+    for (size_t i = from; i < panel.transfers.size(); i++) {
+        text += (text.empty() ? "" : " ") + bytesOf(panel.transfers[i]);
+    }
+    return text;
+}
+
+struct StatsSnapshot {
+    uint32_t transactions = 0;
+    uint32_t transfers = 0;
+    uint32_t errors = 0;
+    uint32_t bytes = 0;
+
+    static StatsSnapshot of(uint8_t address) {
+        StatsSnapshot snapshot;
+        const I2cBus::DeviceStats* stats = I2cBus::getStats(address);
+        if (stats != nullptr) {
+            snapshot.transactions = stats->transactions;
+            snapshot.transfers = stats->transfers;
+            snapshot.errors = stats->errors;
+            snapshot.bytes = stats->bytes;
+        }
+        return snapshot;
+    }
+
+    StatsSnapshot since(const StatsSnapshot& before) const {
+        return { transactions - before.transactions, transfers - before.transfers, errors - before.errors,
+                 bytes - before.bytes };
+    }
+
+    bool operator==(const StatsSnapshot& other) const {
+        return transactions == other.transactions && transfers == other.transfers && errors == other.errors &&
+               bytes == other.bytes;
+    }
+
+    std::string describe() const {
+        char text[96];
+        snprintf(text, sizeof(text), "%u transactions, %u transfers, %u errors, %u bytes", transactions, transfers,
+                 errors, bytes);
+        return text;
+    }
+};
+
+static void checkMerges(Checks& checks) {
+    printf("Merging (bus task held while these queue):\n");
+    static const uint8_t displayOff[] = { 0x00, 0xAE };
+    static const uint8_t displayOn[] = { 0x00, 0xAF };
+    static const uint8_t pixels1[] = { 0x40, 0x01, 0x02, 0x03 };
+    static const uint8_t pixels2[] = { 0x40, 0x04, 0x05 };
+    static const uint8_t contrast[] = { 0x00, 0x81 };
+    static const uint8_t level[] = { 0x00, 0x8F };
+    static const uint8_t resume[] = { 0x00, 0xA4 };
+    static const uint8_t reg = 0x00;
+    uint8_t reading[2] = {};
+    Caller callers[8];
+
+    size_t from = panel.transfers.size();
+    uint32_t mergedBefore = Metrics::get(I2C_MERGED_WRITES);
+    runQueued({
+        writeOf(PanelDevice::ADDRESS, displayOff, sizeof(displayOff), 1, &callers[0]),
+        writeOf(PanelDevice::ADDRESS, displayOn, sizeof(displayOn), 1, &callers[1]),
+        writeOf(PanelDevice::ADDRESS, pixels1, sizeof(pixels1), 1, &callers[2]),     // Another control byte
+        writeOf(PanelDevice::ADDRESS, pixels2, sizeof(pixels2), 1, &callers[3]),
+        readOf(SensorDevice::ADDRESS, &reg, reading, sizeof(reading), &callers[4]),   // Another device, a read
+        writeOf(PanelDevice::ADDRESS, contrast, sizeof(contrast), 0, &callers[5]),   // Prefix 0 never merges
+        writeOf(PanelDevice::ADDRESS, level, sizeof(level), 1, &callers[6]),
+        writeOf(PanelDevice::ADDRESS, resume, sizeof(resume), 1, &callers[7]),
+    });
+
+    std::vector<std::vector<uint8_t>> expected = {
+        { 0x00, 0xAE, 0xAF }, { 0x40, 0x01, 0x02, 0x03, 0x04, 0x05 }, { 0x00, 0x81 }, { 0x00, 0x8F, 0xA4 },
+    };
+    bool sent = std::vector<std::vector<uint8_t>>(panel.transfers.begin() + from, panel.transfers.end()) == expected;
+    checks.expect(sent, "same device and control byte merge, carrying the prefix once", transfersOf(from));
+
+    static const uint8_t mergedWrites[] = { 2, 2, 2, 2, 1, 1, 2, 2 };
+    int wrong = 0;
+    for (int i = 0; i < 8; i++) {
+        if (callers[i].calls != 1 || callers[i].result.status != ESP_OK || callers[i].result.mergedWrites != mergedWrites[i]) {
+            wrong++;
+        }
+    }
+    checks.expect(wrong == 0, "each caller is told how many writes shared its transfer",
+                  format("%.0f of 8 callers wrong", wrong));
+    checks.expect(reading[0] == 0x12 && reading[1] == 0x34 && callers[4].result.address == SensorDevice::ADDRESS,
+                  "a read queued between them goes out on its own");
+    checks.expect(Metrics::get(I2C_MERGED_WRITES) - mergedBefore == 3, "glasses_i2c_merged_writes_total counts 3",
+                  format("%.0f", Metrics::get(I2C_MERGED_WRITES) - mergedBefore));
+
+    // More than MAX_MERGE queued: the task takes MAX_MERGE, then the rest
+    static const uint8_t nop[] = { 0x00, 0xE3 };
+    std::vector<I2cTransaction> many;
+    Caller manyCallers[I2cBus::MAX_MERGE + 2];
+    for (Caller& caller : manyCallers) {
+        many.push_back(writeOf(PanelDevice::ADDRESS, nop, sizeof(nop), 1, &caller));
+    }
+    from = panel.transfers.size();
+    runQueued(many);
+    bool capped = panel.transfers.size() - from == 2 && panel.transfers[from].size() == 1 + I2cBus::MAX_MERGE &&
+                  panel.transfers[from + 1].size() == 3 && manyCallers[0].result.mergedWrites == I2cBus::MAX_MERGE &&
+                  manyCallers[I2cBus::MAX_MERGE].result.mergedWrites == 2;
+    checks.expect(capped, format("%.0f queued commands: %.0f in one transfer, then 2", I2cBus::MAX_MERGE + 2,
+                                 I2cBus::MAX_MERGE));
+
+    // Two writes that together pass MERGE_BYTES
+    static uint8_t frame[1000];
+    static uint8_t tail[100];
+    frame[0] = 0x40;
+    tail[0] = 0x40;
+    Caller frameCaller;
+    Caller tailCaller;
+    from = panel.transfers.size();
+    runQueued({
+        writeOf(PanelDevice::ADDRESS, frame, sizeof(frame), 1, &frameCaller),
+        writeOf(PanelDevice::ADDRESS, tail, sizeof(tail), 1, &tailCaller),
+    });
+    checks.expect(panel.transfers.size() - from == 2 && frameCaller.result.mergedWrites == 1 &&
+                  tailCaller.result.mergedWrites == 1,
+                  format("writes that would pass MERGE_BYTES (%.0f) go separately", I2cBus::MERGE_BYTES));
+}
+
+static void checkErrors(Checks& checks) {
+    printf("\nErrors:\n");
+    static const uint8_t command[] = { 0x00, 0xAF };
+    static const uint8_t reg = 0x00;
+    uint8_t reading[2] = {};
+    Caller callers[7];
+    uint32_t errorsBefore = Metrics::get(I2C_ERRORS);
+    runQueued({
+        writeOf(PanelDevice::ADDRESS, command, sizeof(command), 1, &callers[0]),
+        writeOf(ABSENT, command, sizeof(command), 1, &callers[1]),
+        writeOf(ABSENT, command, sizeof(command), 1, &callers[2]),      // Merged with the one above
+        writeOf(PanelDevice::ADDRESS, command, sizeof(command), 1, &callers[3]),
+        readOf(StuckDevice::ADDRESS, &reg, reading, sizeof(reading), &callers[4]),
+        readOf(SensorDevice::ADDRESS, &reg, reading, sizeof(reading), &callers[5]),
+        writeOf(StuckDevice::ADDRESS, command, sizeof(command), 0, &callers[6]),
+    });
+
+    static const esp_err_t statuses[] = { ESP_OK, ESP_FAIL, ESP_FAIL, ESP_OK, ESP_ERR_TIMEOUT, ESP_OK, ESP_ERR_TIMEOUT };
+    static const uint8_t addresses[] = { PanelDevice::ADDRESS, ABSENT, ABSENT, PanelDevice::ADDRESS,
+                                         StuckDevice::ADDRESS, SensorDevice::ADDRESS, StuckDevice::ADDRESS };
+    std::string got;
+    int wrong = 0;
+    for (int i = 0; i < 7; i++) {
+        got += std::string(got.empty() ? "" : ", ") + esp_err_to_name(callers[i].result.status);
+        if (callers[i].calls != 1 || callers[i].result.status != statuses[i] || callers[i].result.address != addresses[i]) {
+            wrong++;
+        }
+    }
+    checks.expect(wrong == 0, "a NACK and a timeout reach their own callers, and the merged one too", got);
+    checks.expect(callers[1].result.mergedWrites == 2, "the merged writes to a missing device fail together");
+    checks.expect(Metrics::get(I2C_ERRORS) - errorsBefore == 3, "glasses_i2c_errors_total counts failed transfers",
+                  format("%.0f for 3", Metrics::get(I2C_ERRORS) - errorsBefore));
+
+    uint64_t before = HostClock::nowUs();
+    esp_err_t absent = I2cBus::transfer(ABSENT, command, sizeof(command));
+    esp_err_t timedOut = I2cBus::transfer(StuckDevice::ADDRESS, &reg, 1, reading, sizeof(reading));
+    esp_err_t fine = I2cBus::transfer(SensorDevice::ADDRESS, &reg, 1, reading, sizeof(reading));
+    uint64_t tookUs = HostClock::nowUs() - before;
+    checks.expect(absent == ESP_FAIL && timedOut == ESP_ERR_TIMEOUT && fine == ESP_OK,
+                  "transfer() returns the status of its own transfer",
+                  std::string(esp_err_to_name(absent)) + ", " + esp_err_to_name(timedOut) + ", " + esp_err_to_name(fine));
+    checks.expect(tookUs >= I2cBus::TRANSFER_TIMEOUT_MS * 1000, "a stuck device costs the transfer timeout",
+                  format("%.1f ms", tookUs / 1000.0));
+}
+
+static void checkClock(Checks& checks) {
+    printf("\nBus clock:\n");
+    static const uint8_t command[] = { 0x00, 0xAF };
+    uint32_t board = Board::I2c::FREQUENCY;
+
+    I2cBus::transfer(PanelDevice::ADDRESS, command, sizeof(command));
+    checks.expect(I2cBus::getFrequency() == board && HostI2c::getFrequency() == board,
+                  "every device allows more: the board's clock", format("%.0f kHz", HostI2c::getFrequency() / 1000.0));
+
+    I2cBus::addDevice(SensorDevice::ADDRESS, 100000);
+    bool deferred = HostI2c::getFrequency() == board;
+    uint64_t busyBefore = HostI2c::getBusyUs();
+    I2cBus::transfer(PanelDevice::ADDRESS, command, sizeof(command));
+    uint64_t busyUs = HostI2c::getBusyUs() - busyBefore;
+    checks.expect(deferred && I2cBus::getFrequency() == 100000 && HostI2c::getFrequency() == 100000,
+                  "a 100 kHz device slows the bus from the next transfer",
+                  format("%.0f kHz", HostI2c::getFrequency() / 1000.0));
+    checks.expect(busyUs == (sizeof(command) + 1) * 90, "and the panel's write takes 100 kHz wire time",
+                  format("%.0f us", busyUs));
+
+    I2cBus::addDevice(0x30, 1000000);
+    I2cBus::transfer(PanelDevice::ADDRESS, command, sizeof(command));
+    checks.expect(HostI2c::getFrequency() == 100000, "a faster device added later does not speed it up");
+
+    I2cBus::addDevice(SensorDevice::ADDRESS, 1000000);
+    I2cBus::transfer(PanelDevice::ADDRESS, command, sizeof(command));
+    checks.expect(HostI2c::getFrequency() == std::min<uint32_t>(board, 400000),
+                  "the slow device re-registered faster: the next slowest, the panel",
+                  format("%.0f kHz", HostI2c::getFrequency() / 1000.0));
+}
+
+static void checkStats(Checks& checks) {
+    printf("\nPer-device stats:\n");
+    static const uint8_t command[] = { 0x00, 0xAF };
+    static const uint8_t pixels[] = { 0x40, 0x01, 0x02 };
+    static const uint8_t reg = 0x00;
+    uint8_t reading[4] = {};
+    Caller callers[6];
+
+    StatsSnapshot panelBefore = StatsSnapshot::of(PanelDevice::ADDRESS);
+    StatsSnapshot sensorBefore = StatsSnapshot::of(SensorDevice::ADDRESS);
+    StatsSnapshot stuckBefore = StatsSnapshot::of(StuckDevice::ADDRESS);
+    const Histogram& latency = Metrics::histogram(I2C_DISPLAY_US);
+    std::vector<uint32_t> bucketsBefore(Histogram::BUCKETS);
+    for (uint8_t b = 0; b < Histogram::BUCKETS; b++) bucketsBefore[b] = latency.counts[b];
+    uint32_t totalBefore = latency.total;
+
+    // Held 20 ms so the queued latencies land in buckets well above the wire time
+    runQueued({
+        writeOf(PanelDevice::ADDRESS, command, sizeof(command), 1, &callers[0]),
+        writeOf(PanelDevice::ADDRESS, command, sizeof(command), 1, &callers[1]),
+        readOf(SensorDevice::ADDRESS, &reg, reading, sizeof(reading), &callers[2]),
+        writeOf(PanelDevice::ADDRESS, pixels, sizeof(pixels), 1, &callers[3]),
+        writeOf(StuckDevice::ADDRESS, command, sizeof(command), 0, &callers[4]),
+        writeOf(PanelDevice::ADDRESS, command, sizeof(command), 0, &callers[5]),
+    }, 20);
+
+    StatsSnapshot panelStats = StatsSnapshot::of(PanelDevice::ADDRESS).since(panelBefore);
+    StatsSnapshot sensorStats = StatsSnapshot::of(SensorDevice::ADDRESS).since(sensorBefore);
+    StatsSnapshot stuckStats = StatsSnapshot::of(StuckDevice::ADDRESS).since(stuckBefore);
+    checks.expect(panelStats == StatsSnapshot{ 4, 3, 0, 3 + 3 + 2 }, "panel: 4 transactions in 3 transfers",
+                  panelStats.describe());
+    checks.expect(sensorStats == StatsSnapshot{ 1, 1, 0, 1 + 4 }, "sensor: the register write and the bytes read",
+                  sensorStats.describe());
+    checks.expect(stuckStats == StatsSnapshot{ 1, 1, 1, 2 }, "stuck device: its timeout is an error",
+                  stuckStats.describe());
+
+    // The panel's histogram holds exactly its callers' latencies; the others have none
+    std::vector<uint32_t> expected(Histogram::BUCKETS);
+    for (int i : { 0, 1, 3, 5 }) expected[Histogram::bucketFor(callers[i].result.latencyUs)]++;
+    int wrongBuckets = 0;
+    for (uint8_t b = 0; b < Histogram::BUCKETS; b++) {
+        if (latency.counts[b] - bucketsBefore[b] != expected[b]) wrongBuckets++;
+    }
+    checks.expect(latency.total - totalBefore == 4 && wrongBuckets == 0,
+                  "glasses_i2c_latency_us{peripheral=\"display\"} buckets hold the panel's 4 latencies",
+                  format("%.0f observations, %.0f buckets off", latency.total - totalBefore, wrongBuckets));
+    uint32_t least = std::min({ callers[0].result.latencyUs, callers[1].result.latencyUs,
+                                callers[3].result.latencyUs, callers[5].result.latencyUs });
+    checks.expect(least >= 20000, "latency runs from submit(), queueing included",
+                  format("shortest %.1f ms after a 20 ms hold", least / 1000.0));
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 2;
+    }
+
+    Serial.setHostOutput(nullptr);
+    HostI2c::attach(GateDevice::ADDRESS, &gate);
+    HostI2c::attach(PanelDevice::ADDRESS, &panel);
+    HostI2c::attach(SensorDevice::ADDRESS, &sensor);
+    HostI2c::attach(StuckDevice::ADDRESS, &stuck);
+
+    Checks checks;
+    bool started = I2cBus::begin() && I2cBus::addDevice(GateDevice::ADDRESS, 1000000) &&
+                   I2cBus::addDevice(PanelDevice::ADDRESS, 400000, I2C_DISPLAY_US) &&
+                   I2cBus::addDevice(SensorDevice::ADDRESS, 1000000) && I2cBus::addDevice(StuckDevice::ADDRESS, 1000000);
+    checks.expect(started, "bus task started, devices registered");
+    if (started) {
+        checkMerges(checks);
+        checkErrors(checks);
+        checkClock(checks);
+        checkStats(checks);
+    }
+
+    if (checks.failed) {
+        printf("\n%d check(s) failed\n", checks.failed);
+    } else {
+        printf("\nAll checks passed\n");
+    }
+    fflush(stdout);
+    _Exit(checks.failed ? 1 : 0);           // The bus task never returns
+}
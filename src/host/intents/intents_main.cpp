@@ -0,0 +1,701 @@
+// Intent matcher harness (pio run -e native_intents).
+// Runs IntentMatcher over a command set the way the glasses do: each take
+// goes through SpeechEnhancer in 256-sample pieces, as the listener hands it
+// over, then into the matcher. Reports accuracy per command, how often
+// other speech is taken for a command (it should go to the server), the
+// matching cost on this host and how long after the end of speech the
+// decision comes.
+//
+// Usage: program [--pack assets.bin] [--templates list.txt] [--corpus list.txt]
+//                [--takes N] [--seed N] [--write dir] [--verbose]
+//
+// Templates are the pack's command recordings with --pack, the recordings in
+// a --templates list, or else built in (the same two synthetic voices the
+// pack ships; --write saves them as the WAVs in assets/intents/). The built-in
+// command set is formant-synthesized: --takes takes of every command and of
+// phrases outside the vocabulary, each with its own voice (pitch, vocal tract
+// length, tempo, level) in white, pink or fan noise at 10-30 dB SNR. A list
+// file has one recording per line ('#' starts a comment), WAV paths relative
+// to the file, 16 kHz mono 16-bit:
+//   <take.wav> <command|none>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../host_wav.h"
+#include "../../firmware/config/asset_ids.h"
+#include "../../firmware/dsp/speech_enhancer.cpp"
+#include "../../firmware/dsp/intent_matcher.cpp"
+
+typedef std::vector<uint8_t> Bytes;
+
+static const uint32_t SAMPLE_RATE = 16000;
+static const size_t PIECE = 256;                 // Listener frames, as handed to the recorder
+static const double DECISION_BUDGET_MS = 200.0;
+static const uint8_t NONE = IntentMatcher::NO_LABEL;
+
+// ---------------------------------------------------------------- Vocabulary
+
+struct Command {
+    const char* name;
+    const char* phones;
+    AssetId templates[2];           // Pack recordings, one per voice
+};
+
+static const Command COMMANDS[] = {
+    { "mute", "M Y UW T", { COMMAND_MUTE_1, COMMAND_MUTE_2 } },
+    { "unmute", "AH N M Y UW T", { COMMAND_UNMUTE_1, COMMAND_UNMUTE_2 } },
+    { "display off", "D IH S P L EY AO F", { COMMAND_DISPLAY_OFF_1, COMMAND_DISPLAY_OFF_2 } },
+    { "display on", "D IH S P L EY AA N", { COMMAND_DISPLAY_ON_1, COMMAND_DISPLAY_ON_2 } },
+    { "battery level", "B AE D ER IY L EH V AH L", { COMMAND_BATTERY_1, COMMAND_BATTERY_2 } }
+};
+static const uint8_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// Speech the server should get, some of it close to a command
+static const char* const OTHER_SPEECH[] = {
+    "W AH T T AY M IH Z IH T",          // what time is it
+    "K AO L M AA M",                    // call mom
+    "S EH T AH T AY M ER",              // set a timer
+    "T ER N AA N DH AH L AY T",         // turn on the light
+    "P L EY M Y UW Z IH K",             // play music
+    "M UW V",                           // move
+    "N UW Z",                           // news
+    "D IH S P L EY",                    // display
+    "B AE D ER IY",                     // battery
+    "W EH DH ER T AH D EY"              // weather today
+};
+static const uint8_t OTHER_COUNT = sizeof(OTHER_SPEECH) / sizeof(OTHER_SPEECH[0]);
+
+// ---------------------------------------------------------------- Synthesis
+
+// Klatt-style formant synthesis: an impulse train through a glottal lowpass
+// and five cascaded resonators for voicing, band-passed noise for frication
+// and bursts, targets interpolated between phone centres
+struct Phone {
+    const char* name;
+    char kind;                      // v vowel / glide, n nasal, f fricative, z voiced fricative, p stop, b voiced stop
+    double f1, f2, f3;              // Formant targets, or the consonant's locus
+    double ms;
+    double noiseLo, noiseHi;        // Frication / burst band
+};
+
+static const Phone PHONES[] = {
+    { "IY", 'v', 270, 2290, 3010, 120, 0, 0 },
+    { "IH", 'v', 390, 1990, 2550, 90, 0, 0 },
+    { "EH", 'v', 530, 1840, 2480, 100, 0, 0 },
+    { "AE", 'v', 660, 1720, 2410, 130, 0, 0 },
+    { "AH", 'v', 520, 1190, 2390, 80, 0, 0 },
+    { "AA", 'v', 730, 1090, 2440, 140, 0, 0 },
+    { "AO", 'v', 570, 840, 2410, 140, 0, 0 },
+    { "UW", 'v', 300, 870, 2240, 140, 0, 0 },
+    { "ER", 'v', 490, 1350, 1690, 120, 0, 0 },
+    { "EY", 'v', 480, 1900, 2500, 80, 0, 0 },       // Diphthongs glide into IY
+    { "AY", 'v', 730, 1100, 2450, 100, 0, 0 },
+    { "Y", 'v', 280, 2250, 3000, 60, 0, 0 },
+    { "W", 'v', 300, 650, 2200, 60, 0, 0 },
+    { "L", 'v', 360, 1050, 2700, 70, 0, 0 },
+    { "M", 'n', 280, 1000, 2200, 80, 0, 0 },
+    { "N", 'n', 280, 1600, 2600, 70, 0, 0 },
+    { "S", 'f', 350, 1700, 2700, 110, 4000, 7500 },
+    { "F", 'f', 300, 900, 2200, 100, 1200, 7000 },
+    { "Z", 'z', 350, 1700, 2700, 80, 4000, 7500 },
+    { "V", 'z', 300, 900, 2200, 70, 1200, 6000 },
+    { "DH", 'z', 350, 1500, 2600, 50, 1500, 6000 },
+    { "P", 'p', 300, 900, 2200, 55, 600, 2500 },
+    { "T", 'p', 350, 1700, 2700, 55, 3000, 6500 },
+    { "K", 'p', 300, 2000, 2600, 60, 1500, 3500 },
+    { "B", 'b', 300, 900, 2200, 50, 600, 2500 },
+    { "D", 'b', 350, 1700, 2700, 50, 3000, 6000 }
+};
+
+static const Phone* findPhone(const std::string& name) {
+    for (const Phone& p : PHONES) {
+        if (name == p.name) return &p;
+    }
+    return nullptr;
+}
+
+struct Voice {
+    double pitchHz = 120;
+    double tract = 1.0;             // Formant scale: shorter tracts, higher formants
+    double tempo = 1.0;             // Duration scale
+    double jitter = 0.0;            // Per-phone duration spread
+    double peak = 12000;
+};
+
+// One stretch of constant targets
+struct Segment {
+    size_t start, end;
+    double f1, f2, f3;
+    double voicing, noise;
+    double noiseLo, noiseHi;
+};
+
+struct Resonator {
+    double a = 0, b = 0, c = 0, y1 = 0, y2 = 0;
+
+    void set(double hz, double bandwidth) {
+        double r = exp(-M_PI * bandwidth / SAMPLE_RATE);
+        c = -r * r;
+        b = 2 * r * cos(2 * M_PI * hz / SAMPLE_RATE);
+        a = 1 - b - c;
+    }
+
+    double step(double x) {
+        double y = a * x + b * y1 + c * y2;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+// Constant-peak band-pass for the noise source
+struct BandPass {
+    double b0 = 0, a1 = 0, a2 = 0, x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    void set(double lo, double hi) {
+        double centre = sqrt(lo * hi);
+        double w = 2 * M_PI * centre / SAMPLE_RATE;
+        double alpha = sin(w) / (2 * centre / (hi - lo));
+        double a0 = 1 + alpha;
+        b0 = alpha / a0;
+        a1 = -2 * cos(w) / a0;
+        a2 = (1 - alpha) / a0;
+    }
+
+    double step(double x) {
+        double y = b0 * (x - x2) - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+static std::vector<int16_t> synthesize(const std::string& phones, const Voice& voice, HostRandom& rng) {
+    // Phone string to segments; stops are a closure then a burst (aspirated
+    // unless after S), diphthongs glide
+    std::vector<Segment> segments;
+    size_t at = 0;
+    auto add = [&](double ms, const Phone& p, double f1, double f2, double f3, double voicing, double noise) {
+        size_t length = (size_t)(ms * voice.tempo * (1 + voice.jitter * rng.normal()) * SAMPLE_RATE / 1000);
+        length = std::max(length, (size_t)(0.01 * SAMPLE_RATE));
+        segments.push_back({ at, at + length, f1 * voice.tract, f2 * voice.tract, f3 * voice.tract,
+                             voicing, noise, p.noiseLo * voice.tract, p.noiseHi * std::min(voice.tract, 1.05) });
+        at += length;
+    };
+    size_t from = 0;
+    std::string last;
+    while (from < phones.size()) {
+        size_t space = phones.find(' ', from);
+        std::string name = phones.substr(from, space == std::string::npos ? std::string::npos : space - from);
+        from = space == std::string::npos ? phones.size() : space + 1;
+        const Phone* p = findPhone(name);
+        if (p == nullptr) continue;
+        bool afterS = last == "S";
+        last = name;
+        switch (p->kind) {
+            case 'v':
+                if (name == "EY" || name == "AY") {
+                    add(p->ms, *p, p->f1, p->f2, p->f3, 1.0, 0);
+                    add(p->ms * 0.8, *p, 300, 2200, 2900, 0.9, 0);
+                } else {
+                    bool glide = name == "Y" || name == "W" || name == "L";
+                    add(p->ms, *p, p->f1, p->f2, p->f3, glide ? 0.6 : 1.0, 0);
+                }
+                break;
+            case 'n': add(p->ms, *p, p->f1, p->f2, p->f3, 0.5, 0); break;
+            case 'f': add(p->ms, *p, p->f1, p->f2, p->f3, 0, name == "F" ? 0.12 : 0.4); break;
+            case 'z': add(p->ms, *p, p->f1, p->f2, p->f3, 0.3, name == "DH" ? 0.05 : 0.12); break;
+            case 'p':
+                add(p->ms, *p, p->f1, p->f2, p->f3, 0, 0);
+                add(15, *p, p->f1, p->f2, p->f3, 0, 0.2);
+                if (!afterS) add(30, *p, p->f1, p->f2, p->f3, 0, 0.06);
+                break;
+            case 'b':
+                add(p->ms, *p, p->f1, p->f2, p->f3, 0.08, 0);
+                add(10, *p, p->f1, p->f2, p->f3, 0.3, 0.15);
+                break;
+        }
+    }
+
+    std::vector<double> out(at);
+    Resonator formants[5];
+    BandPass band;
+    double glottal1 = 0, glottal2 = 0, phase = 0, previous = 0;
+    double voicing = 0, noise = 0;
+    size_t segment = 0;
+    for (size_t i = 0; i < at; i++) {
+        while (i >= segments[segment].end) {
+            segment++;
+        }
+        const Segment& s = segments[segment];
+        if (i == s.start && s.noiseHi > 0) {
+            // Vowels keep the band of the consonant before them as its noise dies away
+            band.set(s.noiseLo, s.noiseHi);
+        } else if (i == 0) {
+            band.set(1000, 4000);
+        }
+
+        if (i % 8 == 0) {
+            // Targets glide linearly between segment centres
+            size_t centre = (s.start + s.end) / 2;
+            const Segment& other = i < centre ? segments[segment > 0 ? segment - 1 : 0]
+                                              : segments[segment + 1 < segments.size() ? segment + 1 : segment];
+            size_t otherCentre = (other.start + other.end) / 2;
+            double w = otherCentre == centre ? 0 : fabs((double)i - centre) / fabs((double)otherCentre - centre);
+            w = std::min(0.5, w * 0.5);
+            double f[3] = { s.f1 + (other.f1 - s.f1) * w, s.f2 + (other.f2 - s.f2) * w, s.f3 + (other.f3 - s.f3) * w };
+            formants[0].set(f[0], 60);
+            formants[1].set(f[1], 90);
+            formants[2].set(f[2], 150);
+            formants[3].set(3300 * voice.tract, 250);
+            formants[4].set(4200 * voice.tract, 300);
+        }
+
+        // Amplitudes ramp: 8 ms for voicing, 2 ms for noise
+        voicing += (s.voicing - voicing) * (1.0 / (0.008 * SAMPLE_RATE));
+        noise += (s.noise - noise) * (1.0 / (0.002 * SAMPLE_RATE));
+
+        double t = (double)i / SAMPLE_RATE;
+        double total = (double)at / SAMPLE_RATE;
+        double pitch = voice.pitchHz * (1.08 - 0.16 * t / total) * (1 + 0.01 * rng.normal());
+        phase += pitch / SAMPLE_RATE;
+        double pulse = 0;
+        if (phase >= 1) {
+            phase -= 1;
+            pulse = 1;
+        }
+        glottal1 += (pulse - glottal1) * 0.05;
+        glottal2 += (glottal1 - glottal2) * 0.05;
+        double v = glottal2 * voicing * 40;
+        for (Resonator& r : formants) v = r.step(v);
+
+        double n = noise > 1e-4 ? band.step(rng.normal()) * noise * 0.1 : 0;
+        double y = v + n;
+        out[i] = y - previous;      // Lip radiation
+        previous = y;
+    }
+
+    double peak = 1e-9;
+    for (double v : out) peak = std::max(peak, fabs(v));
+    std::vector<int16_t> pcm(at);
+    for (size_t i = 0; i < at; i++) {
+        pcm[i] = (int16_t)lround(out[i] / peak * voice.peak);
+    }
+    return pcm;
+}
+
+static std::vector<double> backgroundNoise(int kind, size_t count, HostRandom& rng) {
+    std::vector<double> out(count);
+    double b0 = 0, b1 = 0, b2 = 0, low = 0;
+    for (size_t i = 0; i < count; i++) {
+        double white = rng.normal();
+        if (kind == 0) {
+            out[i] = white;
+        } else if (kind == 1) {
+            // Paul Kellet's economy pink filter
+            b0 = 0.99765 * b0 + white * 0.0990460;
+            b1 = 0.96300 * b1 + white * 0.2965164;
+            b2 = 0.57000 * b2 + white * 1.0526913;
+            out[i] = (b0 + b1 + b2 + white * 0.1848) * 0.25;
+        } else {
+            // Fan: rumble plus blade tone and harmonics
+            low += (white - low) * 0.02;
+            double t = (double)i / SAMPLE_RATE;
+            out[i] = 4 * low + 0.5 * sin(2 * M_PI * 120 * t) + 0.25 * sin(2 * M_PI * 240 * t) + 0.1 * white;
+        }
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------- Command set
+
+struct Take {
+    std::string name;
+    uint8_t label;                  // Command index or NONE
+    std::vector<int16_t> samples;
+    size_t speechEnd;               // Where the spoken part ends
+};
+
+// The voices behind the shipped templates: a lower and a higher one
+static const Voice TEMPLATE_VOICES[2] = {
+    { 115, 1.0, 1.0, 0.0, 12000 },
+    { 205, 1.12, 0.95, 0.0, 12000 }
+};
+
+static std::vector<int16_t> templateRecording(uint8_t command, uint8_t voice) {
+    HostRandom rng(1000 + command * 2 + voice);
+    std::vector<int16_t> speech = synthesize(COMMANDS[command].phones, TEMPLATE_VOICES[voice], rng);
+    std::vector<int16_t> recording(SAMPLE_RATE / 5, 0);
+    recording.insert(recording.end(), speech.begin(), speech.end());
+    recording.resize(recording.size() + SAMPLE_RATE / 5, 0);
+    return recording;
+}
+
+static Take makeTake(const std::string& name, uint8_t label, const std::string& phones, HostRandom& rng) {
+    Voice voice;
+    bool high = rng.uniform() < 0.5;
+    voice.pitchHz = high ? 170 + 70 * rng.uniform() : 90 + 60 * rng.uniform();
+    voice.tract = (high ? 1.08 : 0.94) + 0.1 * rng.uniform();
+    voice.tempo = 0.8 + 0.45 * rng.uniform();
+    voice.jitter = 0.12;
+    voice.peak = 3000 + 17000 * rng.uniform();
+    std::vector<int16_t> speech = synthesize(phones, voice, rng);
+
+    size_t lead = (size_t)((0.3 + 0.2 * rng.uniform()) * SAMPLE_RATE);
+    size_t total = std::max((size_t)(2 * SAMPLE_RATE), lead + speech.size() + SAMPLE_RATE / 2);
+    double snrDb = 10 + 20 * rng.uniform();
+    double speechPower = 0;
+    for (int16_t s : speech) speechPower += (double)s * s;
+    speechPower /= speech.size();
+    std::vector<double> noise = backgroundNoise((int)(rng.uniform() * 3), total, rng);
+    double noisePower = 0;
+    for (double n : noise) noisePower += n * n;
+    noisePower /= noise.size();
+    double scale = sqrt(speechPower / pow(10, snrDb / 10) / noisePower);
+
+    Take take;
+    char text[128];
+    snprintf(text, sizeof(text), "%s (%.0f Hz, x%.2f, %.0f dB)", name.c_str(), voice.pitchHz, voice.tempo, snrDb);
+    take.name = text;
+    take.label = label;
+    take.samples.resize(total);
+    for (size_t i = 0; i < total; i++) {
+        double s = noise[i] * scale + (i >= lead && i - lead < speech.size() ? speech[i - lead] : 0);
+        take.samples[i] = (int16_t)lround(std::max(-32767.0, std::min(32767.0, s)));
+    }
+    take.speechEnd = lead + speech.size();
+    return take;
+}
+
+static std::vector<Take> builtinSet(int takes, uint64_t seed) {
+    HostRandom rng(seed);
+    std::vector<Take> set;
+    for (uint8_t c = 0; c < COMMAND_COUNT; c++) {
+        for (int i = 0; i < takes; i++) set.push_back(makeTake(COMMANDS[c].name, c, COMMANDS[c].phones, rng));
+    }
+    for (uint8_t o = 0; o < OTHER_COUNT; o++) {
+        for (int i = 0; i < (takes + 1) / 2; i++) set.push_back(makeTake("other", NONE, OTHER_SPEECH[o], rng));
+    }
+    return set;
+}
+
+static uint8_t labelOf(const std::string& name) {
+    for (uint8_t c = 0; c < COMMAND_COUNT; c++) {
+        std::string command = COMMANDS[c].name;
+        std::replace(command.begin(), command.end(), ' ', '_');
+        if (name == command || name == COMMANDS[c].name) return c;
+    }
+    return NONE;
+}
+
+// <take.wav> <command|none> per line; command names use _ for spaces
+static bool loadList(const std::string& path, std::vector<Take>& takes, std::string& error) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string dir = path.find('/') == std::string::npos ? "" : path.substr(0, path.find_last_of('/') + 1);
+    char line[512];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNo++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char wav[300], label[100];
+        int fields = sscanf(line, "%299s %99s", wav, label);
+        if (fields <= 0) continue;
+        uint8_t index = fields == 2 ? labelOf(label) : NONE;
+        if (fields < 2 || (index == NONE && strcmp(label, "none") != 0)) {
+            error = path + ":" + std::to_string(lineNo) + ": expected <take.wav> <command|none>";
+            fclose(file);
+            return false;
+        }
+        Take take;
+        take.name = wav;
+        take.label = index;
+        std::string wavPath = wav[0] == '/' ? wav : dir + wav;
+        if (!loadWav(wavPath, SAMPLE_RATE, take.samples, error)) {
+            fclose(file);
+            return false;
+        }
+        take.speechEnd = 0;         // Unknown: no decision delay for recordings
+        takes.push_back(take);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool readFile(const std::string& path, Bytes& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    uint8_t buffer[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.insert(out.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+// ---------------------------------------------------------------- Evaluation
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)lround(p * (values.size() - 1))];
+}
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+struct Outcome {
+    uint8_t label;                  // NONE when rejected or undecided
+    double decisionMs;              // After the end of speech, -1 if unknown
+    double matchUs;                 // CPU time of the call that decided
+    bool endpointed;                // Decided before the recording ran out
+    uint32_t best, runnerUp;        // DTW distances
+    uint8_t closest;                // Command at the best distance
+    size_t frames;                  // Speech frames matched
+};
+
+static Outcome runTake(IntentMatcher& matcher, SpeechEnhancer& enhancer, const Take& take) {
+    enhancer.reset();
+    matcher.reset();
+    Outcome outcome = { NONE, -1, 0, false };
+    int16_t piece[PIECE];
+    size_t fed = 0;
+    while (fed < take.samples.size()) {
+        size_t n = std::min(PIECE, take.samples.size() - fed);
+        enhancer.process(take.samples.data() + fed, n, piece);
+        fed += n;
+        auto start = std::chrono::steady_clock::now();
+        IntentMatcher::State state = matcher.process(piece, n);
+        double us = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6;
+        if (state == IntentMatcher::MATCHED || state == IntentMatcher::REJECTED) {
+            outcome.matchUs = us;
+            outcome.endpointed = true;
+            break;
+        }
+    }
+    if (!outcome.endpointed) {
+        auto start = std::chrono::steady_clock::now();
+        matcher.finish();
+        outcome.matchUs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6;
+    }
+    outcome.label = matcher.getState() == IntentMatcher::MATCHED ? matcher.getLabel() : NONE;
+    outcome.best = matcher.getBestDistance();
+    outcome.runnerUp = matcher.getRunnerUpDistance();
+    outcome.closest = matcher.getClosestLabel();
+    outcome.frames = matcher.getSpeechFrames();
+    if (take.speechEnd > 0) {
+        outcome.decisionMs = ((double)fed - take.speechEnd) * 1000 / SAMPLE_RATE + outcome.matchUs / 1000;
+    }
+    return outcome;
+}
+
+int main(int argc, char** argv) {
+    std::string packPath, templatesPath, corpusPath, writeDir;
+    int takes = 40;
+    bool verbose = false;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pack" && i + 1 < argc) packPath = argv[++i];
+        else if (arg == "--templates" && i + 1 < argc) templatesPath = argv[++i];
+        else if (arg == "--corpus" && i + 1 < argc) corpusPath = argv[++i];
+        else if (arg == "--takes" && i + 1 < argc) takes = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--write" && i + 1 < argc) writeDir = argv[++i];
+        else if (arg == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--pack assets.bin] [--templates list.txt] [--corpus list.txt] "
+                            "[--takes N] [--seed N] [--write dir] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Templates
+    static IntentMatcher matcher;
+    Bytes pack;
+    AssetPack reader;
+    std::string source;
+    int offered = 0;
+    if (!packPath.empty()) {
+        if (!readFile(packPath, pack)) {
+            fprintf(stderr, "Cannot read %s\n", packPath.c_str());
+            return 2;
+        }
+        AssetPackError error = reader.open(pack.data(), pack.size(), ASSET_SCHEMA);
+        if (error != ASSET_PACK_OK) {
+            fprintf(stderr, "%s: %s\n", packPath.c_str(), assetPackErrorName(error));
+            return 1;
+        }
+        for (uint8_t c = 0; c < COMMAND_COUNT; c++) {
+            for (AssetId id : COMMANDS[c].templates) {
+                offered++;
+                matcher.addTemplate(c, reader.prompt(id));
+            }
+        }
+        source = packPath;
+    } else if (!templatesPath.empty()) {
+        std::vector<Take> recordings;
+        std::string error;
+        if (!loadList(templatesPath, recordings, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        for (const Take& t : recordings) {
+            offered++;
+            if (t.label != NONE) matcher.addTemplate(t.label, t.samples.data(), t.samples.size());
+        }
+        source = templatesPath;
+    } else {
+        for (uint8_t c = 0; c < COMMAND_COUNT; c++) {
+            for (uint8_t v = 0; v < 2; v++) {
+                std::vector<int16_t> recording = templateRecording(c, v);
+                offered++;
+                matcher.addTemplate(c, recording.data(), recording.size());
+                if (!writeDir.empty()) {
+                    std::string name = COMMANDS[c].name;
+                    std::replace(name.begin(), name.end(), ' ', '_');
+                    std::string path = writeDir + "/" + name + "_" + std::to_string(v + 1) + ".wav";
+                    if (!saveWav(path, SAMPLE_RATE, recording.data(), recording.size())) {
+                        fprintf(stderr, "Cannot write %s\n", path.c_str());
+                        return 2;
+                    }
+                }
+            }
+        }
+        source = "built in";
+    }
+    printf("Templates (%s): %u of %d loaded, %zu frames (%zu bytes of %zu)\n", source.c_str(),
+           (unsigned)matcher.getTemplateCount(), offered, matcher.getTemplateFrames(),
+           matcher.getTemplateFrames() * IntentMatcher::COEFFS, IntentMatcher::POOL_FRAMES * IntentMatcher::COEFFS);
+
+    // Command set
+    std::vector<Take> set;
+    if (!corpusPath.empty()) {
+        std::string error;
+        if (!loadList(corpusPath, set, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        printf("Command set: %s, %zu takes\n\n", corpusPath.c_str(), set.size());
+    } else {
+        set = builtinSet(takes, seed);
+        printf("Command set: synthetic, seed %llu, %d takes per command, %d of each other phrase, 10-30 dB SNR\n\n",
+               (unsigned long long)seed, takes, (takes + 1) / 2);
+    }
+
+    SpeechEnhancerConfig enhancing;
+    enhancing.sampleRate = SAMPLE_RATE;
+    SpeechEnhancer enhancer(enhancing);
+    std::vector<int> correct(COMMAND_COUNT + 1), rejected(COMMAND_COUNT + 1), confused(COMMAND_COUNT + 1),
+        total(COMMAND_COUNT + 1);
+    std::vector<double> decisions, matchCosts;
+    int late = 0;
+    for (const Take& take : set) {
+        Outcome outcome = runTake(matcher, enhancer, take);
+        size_t row = take.label == NONE ? COMMAND_COUNT : take.label;
+        total[row]++;
+        if (outcome.label == take.label) correct[row]++;
+        else if (outcome.label == NONE) rejected[row]++;
+        else confused[row]++;
+        if (take.label != NONE && outcome.label == take.label) {
+            if (outcome.decisionMs >= 0) decisions.push_back(outcome.decisionMs);
+            if (!outcome.endpointed) late++;
+        }
+        matchCosts.push_back(outcome.matchUs);
+        if (verbose) {
+            printf("  %-44s -> %-14s %3zu frames, closest %-14s %4d, runner-up %4d, %4.0f ms\n", take.name.c_str(),
+                   outcome.label == NONE ? "-" : COMMANDS[outcome.label].name, outcome.frames,
+                   outcome.closest == NONE ? "-" : COMMANDS[outcome.closest].name,
+                   outcome.best == UINT32_MAX ? -1 : (int)outcome.best,
+                   outcome.runnerUp == UINT32_MAX ? -1 : (int)outcome.runnerUp, outcome.decisionMs);
+        }
+    }
+
+    printf("%-16s %6s %8s %9s %9s\n", "", "takes", "correct", "rejected", "confused");
+    int commandTakes = 0, commandCorrect = 0;
+    for (uint8_t row = 0; row <= COMMAND_COUNT; row++) {
+        if (total[row] == 0) continue;
+        const char* name = row < COMMAND_COUNT ? COMMANDS[row].name : "other speech";
+        if (row < COMMAND_COUNT) {
+            printf("%-16s %6d %8d %9d %9d\n", name, total[row], correct[row], rejected[row], confused[row]);
+            commandTakes += total[row];
+            commandCorrect += correct[row];
+        } else {
+            printf("%-16s %6d %8s %9d %9d  (to the server / taken for a command)\n", name, total[row], "",
+                   correct[row], confused[row]);
+        }
+    }
+    double accuracy = commandTakes ? 100.0 * commandCorrect / commandTakes : 0;
+    double falseAccepts = total[COMMAND_COUNT] ? 100.0 * confused[COMMAND_COUNT] / total[COMMAND_COUNT] : 0;
+    int commandConfused = 0;
+    for (uint8_t row = 0; row < COMMAND_COUNT; row++) commandConfused += confused[row];
+    double wrongAction = commandTakes ? 100.0 * commandConfused / commandTakes : 0;
+    printf("\nCommands recognized %.1f%%, wrong command %.1f%%, other speech taken for a command %.1f%%\n",
+           accuracy, wrongAction, falseAccepts);
+
+    // Cost: the extractor per 10 ms hop, DTW per decision
+    std::vector<int16_t> speech = set.front().samples;
+    MfccExtractor extractor;
+    MfccFrame frames[2];
+    const int REPEATS = 20;
+    size_t produced = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEATS; r++) {
+        for (size_t at = 0; at + PIECE <= speech.size(); at += PIECE) {
+            produced += extractor.process(speech.data() + at, PIECE, frames, 2);
+        }
+    }
+    double perFrame = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / produced;
+    printf("\nCost (this host): MFCC %.1f us per 10 ms frame, deciding %.0f us p50 / %.0f us max "
+           "(endpoint frame and DTW against %u templates)\n",
+           perFrame * 1e6, percentile(matchCosts, 0.5), percentile(matchCosts, 1.0),
+           (unsigned)matcher.getTemplateCount());
+    if (!decisions.empty()) {
+        printf("Decision after the end of speech: p50 %.0f ms, p90 %.0f ms, max %.0f ms "
+               "(enhancer 16 ms + window + %u ms hangover)\n",
+               percentile(decisions, 0.5), percentile(decisions, 0.9), percentile(decisions, 1.0),
+               (unsigned)IntentMatcherConfig().hangoverMs);
+    }
+
+    printf("\nChecks:\n");
+    Checks checks;
+    checks.expect(matcher.getTemplateCount() == offered, "every template has usable speech",
+                  format("%.0f of %.0f", matcher.getTemplateCount(), offered));
+    if (corpusPath.empty()) {
+        // A rejected command still works, through the server; a wrong one does not
+        checks.expect(accuracy >= 85.0, "commands are recognized", format("%.1f%%", accuracy));
+        checks.expect(wrongAction <= 1.0, "a command is rarely taken for another", format("%.1f%%", wrongAction));
+        checks.expect(falseAccepts <= 5.0, "other speech goes to the server", format("%.1f%% taken for a command", falseAccepts));
+        checks.expect(!decisions.empty() && percentile(decisions, 0.9) <= DECISION_BUDGET_MS,
+                      "decided within 200 ms of the end of speech",
+                      format("p90 %.0f ms, %.0f waited for the end of the recording", percentile(decisions, 0.9), late));
+    }
+    printf("\n%s\n", checks.failed ? "Some checks FAILED" : "All checks passed");
+    return checks.failed ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+// Adaptive upload harness (pio run -e native_link).
+// Replays voice commands over shaped stand-in links and compares the time
+// from the end of speech to the transcript for the fixed upload (2 s of
+// 16 kHz PCM in one POST after recording) and the adaptive one (the link
+// plan's format, uploaded chunk by chunk while the user is still talking,
+// as the listener task does on the device).
+//
+// Usage: program [--commands N] [--seed N]
+//
+// Each link has an uplink rate, a round trip with random extra delay and an
+// RSSI. The real NetworkModule sends the requests, so the link estimator
+// learns from the same transfers as on the device; the stand-in server
+// acknowledges chunks at once and transcribes the final one in ASR_MS.
+// Time is virtual, so the run is repeatable and takes milliseconds.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../../firmware/modules/network_module.cpp"
+#include "../../firmware/dsp/audio_codec.cpp"
+
+static const uint32_t SAMPLE_RATE = 16000;
+static const size_t COMMAND_SAMPLES = SAMPLE_RATE * 2;    // What AudioDriver records
+static const uint32_t ASR_MS = 300;                       // Transcription of the final chunk
+
+struct Link {
+    const char* name;
+    uint32_t uplinkBps;
+    uint32_t roundTripMs;
+    int8_t rssi;
+};
+
+static const Link LINKS[] = {
+    { "good",      2000000,  20, -55 },
+    { "fair",       600000,  60, -68 },
+    { "weak",       200000, 150, -76 },
+    { "poor",        64000, 300, -84 },
+    { "congested",  120000, 250, -58 },     // Strong signal, busy channel
+};
+
+struct Result {
+    std::vector<double> fixedMs;
+    std::vector<double> adaptiveMs;
+    size_t fixedBytes = 0;
+    size_t adaptiveBytes = 0;
+    LinkPlan plan;
+};
+
+// Voiced speech stand-in: the timing does not depend on it, the ADPCM step
+// sizes do
+static std::vector<int16_t> syntheticSpeech() {
+    std::vector<int16_t> samples(COMMAND_SAMPLES);
+    for (size_t i = 0; i < samples.size(); i++) {
+        double t = (double)i / SAMPLE_RATE;
+        double envelope = 0.5 + 0.5 * sin(2 * M_PI * 3.0 * t);
+        double v = 0;
+        for (int harmonic = 1; harmonic <= 12; harmonic++) {
+            v += 2500.0 / harmonic * sin(2 * M_PI * 140.0 * harmonic * t + harmonic);
+        }
+        samples[i] = (int16_t)lround(envelope * v);
+    }
+    return samples;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)lround(p * (values.size() - 1));
+    return values[index];
+}
+
+// Old behaviour: the whole recording in one POST once the user stops
+static double fixedUpload(NetworkModule& network, const std::vector<int16_t>& speech, size_t& bytes) {
+    HostClock::advanceMs(COMMAND_SAMPLES * 1000 / SAMPLE_RATE);
+    uint64_t speechEndUs = HostClock::nowUs();
+    bytes = speech.size() * sizeof(int16_t);
+    network.sendAudio((const uint8_t*)speech.data(), bytes);
+    return (HostClock::nowUs() - speechEndUs) / 1000.0;
+}
+
+// Listener path: each chunk goes up as soon as it is recorded
+static double adaptiveUpload(NetworkModule& network, const std::vector<int16_t>& speech, size_t& bytes, LinkPlan& plan) {
+    plan = network.getLinkPlan();
+    AudioEncoder encoder(SAMPLE_RATE, plan.format);
+    size_t chunkSize = std::min(COMMAND_SAMPLES, (size_t)(SAMPLE_RATE * plan.chunkMs / 1000));
+    std::vector<uint8_t> encoded(encoder.maxBytes(chunkSize));
+
+    uint64_t startUs = HostClock::nowUs();
+    uint64_t speechEndUs = startUs + (uint64_t)COMMAND_SAMPLES * 1000000 / SAMPLE_RATE;
+    bytes = 0;
+    uint16_t seq = 0;
+    for (size_t offset = 0; offset < COMMAND_SAMPLES; offset += chunkSize) {
+        size_t count = std::min(chunkSize, COMMAND_SAMPLES - offset);
+        uint64_t readyUs = startUs + (uint64_t)(offset + count) * 1000000 / SAMPLE_RATE;
+        if (HostClock::nowUs() < readyUs) {
+            HostClock::advanceUs(readyUs - HostClock::nowUs());
+        }
+        size_t n = encoder.encode(&speech[offset], count, encoded.data());
+        bytes += n;
+        network.sendAudioChunk(encoded.data(), n, encoder.getFormat(), seq++, offset + count >= COMMAND_SAMPLES);
+    }
+    return (HostClock::nowUs() - speechEndUs) / 1000.0;
+}
+
+int main(int argc, char** argv) {
+    int commands = 20;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--commands" && i + 1 < argc) commands = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "usage: %s [--commands N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    HostClock::setVirtual(true);
+    HostRandom rng(seed);
+    std::vector<int16_t> speech = syntheticSpeech();
+
+    printf("%-10s %9s %6s %7s | %-22s %9s %9s | %9s %9s %7s | %7s %6s\n",
+           "link", "uplink", "rtt", "rssi", "plan", "fixed_p50", "fixed_p90",
+           "adapt_p50", "adapt_p90", "bytes", "goodput", "srtt");
+
+    for (const Link& link : LINKS) {
+        HostHttp::uplinkBitsPerSecond = link.uplinkBps;
+        HostHttp::roundTripMs = link.roundTripMs;
+        HostWifi::rssi = link.rssi;
+        double jitterMs = link.roundTripMs * 0.25;
+        HostHttp::setHandler([&rng, jitterMs](const HostHttpRequest& request) {
+            HostHttpResponse response;
+            response.body = "{\"status\":\"ok\"}";
+            response.latencyMs = (uint32_t)lround(rng.exponential(jitterMs));
+            if (request.header("X-Audio-Final") != "0") {
+                response.latencyMs += ASR_MS;
+            }
+            return response;
+        });
+
+        NetworkModule network;
+        network.connect("stand-in", "");
+        Result result;
+        for (int c = 0; c < commands; c++) {
+            network.maintain();
+            result.fixedMs.push_back(fixedUpload(network, speech, result.fixedBytes));
+            HostClock::advanceMs(1000);
+            result.adaptiveMs.push_back(adaptiveUpload(network, speech, result.adaptiveBytes, result.plan));
+            HostClock::advanceMs(1000);
+        }
+
+        char plan[32];
+        snprintf(plan, sizeof(plan), "%s %ukHz %ums", result.plan.format.codecName(),
+                 (unsigned)(result.plan.format.sampleRate / 1000), (unsigned)result.plan.chunkMs);
+        const LinkEstimator& estimator = network.getLinkEstimator();
+        printf("%-10s %6ukbps %4ums %4ddBm | %-22s %7.0fms %7.0fms | %7.0fms %7.0fms %7zu | %4ukbps %4ums\n",
+               link.name, (unsigned)(link.uplinkBps / 1000), (unsigned)link.roundTripMs, link.rssi, plan,
+               percentile(result.fixedMs, 0.5), percentile(result.fixedMs, 0.9),
+               percentile(result.adaptiveMs, 0.5), percentile(result.adaptiveMs, 0.9), result.adaptiveBytes,
+               (unsigned)(estimator.getGoodputBps() / 1000), (unsigned)estimator.getRttMs());
+    }
+    printf("\nTime to transcript from the end of speech; fixed uploads %zu bytes per command\n",
+           COMMAND_SAMPLES * sizeof(int16_t));
+    return 0;
+}
@@ -0,0 +1,390 @@
+// Listener harness (pio run -e native_listen).
+// Checks the always-listening path from the microphone to the upload:
+//   - detection: how often and how soon WakeDetector fires on a spoken
+//     command in pink noise at 20, 10 and 5 dB SNR
+//   - false triggers: wakes per hour over steady white, pink and fan noise,
+//     and what a sudden 12 dB louder background costs
+//   - handover: AudioDriver's listener task and getVoiceCommand() in real
+//     time against a stand-in server, fast for the first commands and then
+//     slow: a 2 s turn before each reply and, for the last command, a 1 s
+//     wait for one chunk's acknowledgement. Each upload must be, sample for
+//     sample, the enhanced microphone audio from 500 ms of pre-roll before
+//     the wake frame on: nothing lost, repeated or out of order, and the
+//     start of the command inside it.
+//
+// Usage: program [--takes N] [--minutes N] [--speed N] [--seed N]
+//
+// --minutes is the length of each noise for the false trigger rate; the
+// handover plays the microphone --speed times faster than real time.
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../host_random.h"
+#include "../../firmware/drivers/audio_driver.cpp"
+
+static_assert(Board::Mic::CHANNELS == 1 && Board::Mic::DECIMATION == 1,
+              "The handover replay models a single microphone captured at the output rate");
+
+static const uint32_t SAMPLE_RATE = AudioDriver::SAMPLE_RATE;
+static const size_t FRAME = 256;                        // The listener's detector frame
+static const size_t PRE_ROLL = SAMPLE_RATE / 2;         // AudioDriver's pre-roll
+static const size_t RECORDING = SAMPLE_RATE * 2;        // getVoiceCommand()'s 2 s
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+// ---------------------------------------------------------------- Audio
+
+// A spoken command: voiced syllables at a gliding pitch, 1.5 s long
+static std::vector<int16_t> syntheticSpeech(double peak, double pitchHz) {
+    std::vector<int16_t> out((size_t)(1.5 * SAMPLE_RATE));
+    double phase = 0;
+    for (size_t i = 0; i < out.size(); i++) {
+        double t = (double)i / SAMPLE_RATE;
+        double pitch = pitchHz * (1.0 + 0.15 * sin(2 * M_PI * 0.7 * t));
+        phase += 2 * M_PI * pitch / SAMPLE_RATE;
+        // Harmonics shaped by two formant bumps, falling with frequency
+        double voiced = 0;
+        for (int h = 1; h * pitch < 4000; h++) {
+            double f = h * pitch;
+            double formants = exp(-pow((f - 600) / 300, 2)) + 0.6 * exp(-pow((f - 1800) / 400, 2)) + 0.1;
+            voiced += formants / sqrt((double)h) * sin(h * phase);
+        }
+        double syllable = pow(sin(M_PI * fmod(t, 0.25) / 0.25), 2);
+        out[i] = (int16_t)lround(std::max(-32767.0, std::min(32767.0, peak * 0.35 * voiced * syllable)));
+    }
+    return out;
+}
+
+static std::vector<int16_t> syntheticNoise(const std::string& kind, size_t count, double level, HostRandom& rng) {
+    std::vector<int16_t> out(count);
+    double b0 = 0, b1 = 0, b2 = 0, low = 0;
+    for (size_t i = 0; i < count; i++) {
+        double white = rng.normal();
+        double v;
+        if (kind == "white") {
+            v = white;
+        } else if (kind == "pink") {
+            // Paul Kellet's economy pink filter
+            b0 = 0.99765 * b0 + white * 0.0990460;
+            b1 = 0.96300 * b1 + white * 0.2965164;
+            b2 = 0.57000 * b2 + white * 1.0526913;
+            v = (b0 + b1 + b2 + white * 0.1848) * 0.25;
+        } else {
+            // Fan: rumble plus blade tone and harmonics
+            low += (white - low) * 0.02;
+            double t = (double)i / SAMPLE_RATE;
+            v = 4 * low + 0.5 * sin(2 * M_PI * 120 * t) + 0.25 * sin(2 * M_PI * 240 * t) + 0.1 * white;
+        }
+        out[i] = (int16_t)lround(std::max(-32767.0, std::min(32767.0, level * v)));
+    }
+    return out;
+}
+
+static double rms(const int16_t* samples, size_t count) {
+    double power = 0;
+    for (size_t i = 0; i < count; i++) {
+        power += (double)samples[i] * samples[i];
+    }
+    return count ? sqrt(power / count) : 0;
+}
+
+// Adds speech at snrDb over the noise it lands on
+static void mix(std::vector<int16_t>& audio, size_t at, const std::vector<int16_t>& speech, double snrDb) {
+    double gain = rms(audio.data() + at, speech.size()) * pow(10.0, snrDb / 20) / rms(speech.data(), speech.size());
+    for (size_t i = 0; i < speech.size(); i++) {
+        double v = audio[at + i] + gain * speech[i];
+        audio[at + i] = (int16_t)lround(std::max(-32768.0, std::min(32767.0, v)));
+    }
+}
+
+// ---------------------------------------------------------------- Detection
+
+static void detection(Checks& checks, int takes, HostRandom& rng) {
+    printf("Detection (%d commands per SNR in pink noise):\n", takes);
+    for (double snr : { 20.0, 10.0, 5.0 }) {
+        int detected = 0;
+        int early = 0;
+        std::vector<double> delays;
+        for (int take = 0; take < takes; take++) {
+            // 2 s of noise to settle the floor, the command off the frame grid
+            size_t onset = 2 * SAMPLE_RATE + (size_t)(rng.uniform() * FRAME);
+            std::vector<int16_t> audio = syntheticNoise("pink", onset + 3 * SAMPLE_RATE, 3000, rng);
+            mix(audio, onset, syntheticSpeech(8000, 110 + 120 * rng.uniform()), snr);
+
+            WakeDetector detector;
+            for (size_t offset = 0; offset + FRAME <= audio.size(); offset += FRAME) {
+                if (!detector.process(audio.data() + offset, FRAME)) {
+                    continue;
+                }
+                if (offset + FRAME <= onset) {
+                    early++;
+                    continue;
+                }
+                detected++;
+                delays.push_back((offset + FRAME - onset) * 1000.0 / SAMPLE_RATE);
+                break;
+            }
+        }
+        std::sort(delays.begin(), delays.end());
+        double median = delays.empty() ? 0 : delays[delays.size() / 2];
+        double worst = delays.empty() ? 0 : delays.back();
+        char name[64];
+        snprintf(name, sizeof(name), "%.0f dB: commands detected", snr);
+        std::string detail = format("%.0f of %.0f", detected, takes) +
+                             format(", delay median %.0f ms, max %.0f ms", median, worst);
+        if (snr >= 10) {
+            checks.expect(detected == takes && early == 0, name, detail);
+            snprintf(name, sizeof(name), "%.0f dB: every wake within the 500 ms pre-roll", snr);
+            checks.expect(worst < 500, name);
+        } else {
+            printf("  info %s: %s\n", name, detail.c_str());
+        }
+    }
+}
+
+static void falseTriggers(Checks& checks, int minutes, HostRandom& rng) {
+    printf("\nFalse triggers (%d min of each noise):\n", minutes);
+    size_t count = (size_t)minutes * 60 * SAMPLE_RATE;
+    for (const char* kind : { "white", "pink", "fan" }) {
+        std::vector<int16_t> noise = syntheticNoise(kind, count, 3000, rng);
+        WakeDetector detector;
+        int wakes = 0;
+        for (size_t offset = 0; offset + FRAME <= count; offset += FRAME) {
+            wakes += detector.process(noise.data() + offset, FRAME);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "steady %s noise never wakes the device", kind);
+        checks.expect(wakes == 0, name, format("%.1f per hour", wakes * 60.0 / minutes));
+    }
+
+    // The floor rises 1/64 per frame, so a single microphone takes a sudden
+    // louder background for speech until it catches up (a mic array's noise
+    // reference does not wait); reported, not checked
+    const int STEPS = 20;
+    int wakes = 0;
+    double settledMs = 0;
+    for (int step = 0; step < STEPS; step++) {
+        std::vector<int16_t> noise = syntheticNoise("pink", 6 * SAMPLE_RATE, 3000, rng);
+        for (size_t i = 3 * SAMPLE_RATE; i < noise.size(); i++) {
+            noise[i] = (int16_t)std::max(-32768, std::min(32767, noise[i] * 4));
+        }
+        WakeDetector detector;
+        for (size_t offset = 0; offset + FRAME <= noise.size(); offset += FRAME) {
+            if (detector.process(noise.data() + offset, FRAME)) {
+                wakes++;
+                settledMs = std::max(settledMs, ((double)offset + FRAME - 3 * SAMPLE_RATE) * 1000 / SAMPLE_RATE);
+            }
+        }
+    }
+    printf("  info a 12 dB louder background: %.1f wakes per step, the last %.0f ms after it\n",
+           (double)wakes / STEPS, settledMs);
+}
+
+// ---------------------------------------------------------------- Handover
+
+struct Upload {
+    std::vector<int16_t> samples;
+    int chunks = 0;
+    bool inOrder = true;
+    bool final = false;
+    std::string codec;
+};
+
+static void handover(Checks& checks, double speed, HostRandom& rng) {
+    printf("\nHandover (AudioDriver listener, %.0fx real time):\n", speed);
+
+    // Commands 6 s apart, so each pre-roll is a full 500 ms of fresh audio
+    struct Command { size_t onset; double snr; };
+    const Command commands[] = {
+        { 3 * SAMPLE_RATE + 77, 20 }, { 9 * SAMPLE_RATE + 1603, 10 }, { 15 * SAMPLE_RATE + 5920, 15 },
+        { 21 * SAMPLE_RATE + 3311, 15 }, { 27 * SAMPLE_RATE + 402, 10 }
+    };
+    const size_t COMMANDS = sizeof(commands) / sizeof(commands[0]);
+    static std::vector<int16_t> mic;
+    mic = syntheticNoise("pink", 33 * SAMPLE_RATE, 3000, rng);
+    for (const Command& command : commands) {
+        mix(mic, command.onset, syntheticSpeech(8000, 110 + 120 * rng.uniform()), command.snr);
+    }
+
+    // Stand-in server: keeps each session's PCM in arrival order. From the
+    // fourth command on it takes 2 s over each reply, and for the last one
+    // also 1 s to acknowledge the second chunk: more than a chunk lasts, so
+    // the listener keeps capturing into the speech stream meanwhile. The
+    // slow acknowledgement comes last, so no later plan leaves 16 kHz PCM.
+    static const size_t SLOW_FROM = 3;
+    static double stallScale;
+    stallScale = 1 / speed;
+    static std::vector<Upload> uploads;
+    HostHttp::setHandler([](const HostHttpRequest& request) {
+        HostHttpResponse response;
+        response.body = "{\"status\":\"ok\"}";
+        if (!request.url.endsWith("/audio")) {
+            return response;
+        }
+        uint32_t seq = strtoul(request.header("X-Audio-Seq").c_str(), nullptr, 10);
+        if (seq == 0) {
+            uploads.push_back(Upload());
+        }
+        Upload& upload = uploads.back();
+        upload.inOrder = upload.inOrder && seq == (uint32_t)upload.chunks && !upload.final;
+        upload.chunks++;
+        upload.final = request.header("X-Audio-Final") == "1";
+        upload.codec = request.header("X-Audio-Codec").c_str();
+        for (size_t i = 0; i + 1 < request.body.size(); i += 2) {
+            upload.samples.push_back((int16_t)(request.body[i] | request.body[i + 1] << 8));
+        }
+        uint32_t stallMs = 0;
+        if (uploads.size() > SLOW_FROM) {
+            stallMs = upload.final ? 2000 : seq == 1 && uploads.size() == COMMANDS ? 1000 : 0;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds((long)(stallMs * 1000 * stallScale)));
+        return response;
+    });
+    HostWifi::connectMs = 0;
+    static NetworkModule network;
+    network.connect("stand-in", "");
+
+    // The microphone: the clip at speed times its rate, then silence
+    static std::atomic<size_t> served{0};
+    static auto start = std::chrono::steady_clock::now();
+    static double rate;
+    rate = SAMPLE_RATE * speed;
+    HostI2s::setSource(0, [](int16_t* out, size_t count) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t due = (size_t)(elapsed * rate);
+        size_t next = served.load();
+        size_t n = due > next ? std::min(count, due - next) : 0;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = next + i < mic.size() ? mic[next + i] : 0;
+        }
+        served = next + n;
+        return n;
+    });
+
+    static AudioDriver audio;
+    uint32_t overrunsBefore = Metrics::get(AUDIO_OVERRUNS);
+    audio.begin();
+    audio.setNetworkModule(&network);
+    start = std::chrono::steady_clock::now();
+    audio.startLowPowerListening();
+    while (served.load() < mic.size()) {
+        if (audio.voiceDetected()) {
+            audio.getVoiceCommand();
+        }
+    }
+
+    checks.expect(uploads.size() == COMMANDS, "one upload per command, none from the noise",
+                  format("%.0f uploads for %.0f commands", uploads.size(), COMMANDS));
+    checks.expect(Metrics::get(AUDIO_OVERRUNS) == overrunsBefore, "no DMA or speech stream overruns");
+
+    // Replays the front end over the whole clip; the listener's frames are
+    // whole 256-sample frames of it from the first sample on
+    static MicFrontEnd frontEnd;
+    MicFrontEndConfig conditioning;
+    conditioning.gainQ8 = Board::Mic::GAIN_Q8;
+    frontEnd.configure(conditioning);
+    std::vector<int32_t> raw(mic.begin(), mic.end());
+    for (int32_t& sample : raw) {
+        sample *= 65536;
+    }
+    std::vector<int16_t> conditioned(mic.size());
+    frontEnd.process(raw.data(), raw.size(), conditioned.data());
+
+    SpeechEnhancerConfig enhancing;
+    enhancing.sampleRate = SAMPLE_RATE;
+    static SpeechEnhancer enhancer;
+    enhancer.configure(enhancing);
+    static int16_t expected[RECORDING];
+    for (size_t i = 0; i < std::min(uploads.size(), COMMANDS); i++) {
+        const Upload& upload = uploads[i];
+        size_t onset = commands[i].onset;
+        char name[64];
+        snprintf(name, sizeof(name), "command %zu (%s server): ", i + 1, i < SLOW_FROM ? "fast" : "slow");
+        checks.expect(upload.codec == "pcm16" && upload.inOrder && upload.final && upload.samples.size() == RECORDING,
+                      name + std::string("2 s of PCM in chunks numbered in order, the last one final"),
+                      format("%.0f samples in %.0f chunks", upload.samples.size(), upload.chunks) + ", " + upload.codec);
+        if (upload.samples.size() != RECORDING) {
+            continue;
+        }
+
+        // Wake frames ending from the onset up to the pre-roll after it
+        long match = -1;
+        for (size_t end = (onset / FRAME + 1) * FRAME; end < onset + PRE_ROLL && match < 0; end += FRAME) {
+            size_t from = end - PRE_ROLL;
+            if (from + RECORDING > conditioned.size()) {
+                break;
+            }
+            enhancer.reset();
+            enhancer.process(conditioned.data() + from, RECORDING, expected);
+            if (!memcmp(expected, upload.samples.data(), sizeof(expected))) {
+                match = (long)from;
+            }
+        }
+        checks.expect(match >= 0, name + std::string("the upload is the enhanced audio from 500 ms before the wake frame, bit-exact"),
+                      match >= 0 ? format("wake %.0f ms after the onset, the recording starts %.0f ms before it",
+                                          (match + PRE_ROLL - onset) * 1000.0 / SAMPLE_RATE,
+                                          (onset - match) * 1000.0 / SAMPLE_RATE) : "");
+    }
+}
+
+int main(int argc, char** argv) {
+    int takes = 20;
+    int minutes = 10;
+    double speed = 4;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--takes") && i + 1 < argc) {
+            takes = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--minutes") && i + 1 < argc) {
+            minutes = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--takes N] [--minutes N] [--speed N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (takes < 1 || minutes < 1 || speed <= 0) {
+        fprintf(stderr, "--takes, --minutes and --speed must be positive\n");
+        return 2;
+    }
+    Logger::setLogLevel(LOG_NONE);
+
+    Checks checks;
+    HostRandom rng(seed);
+    detection(checks, takes, rng);
+    falseTriggers(checks, minutes, rng);
+    handover(checks, speed, rng);
+
+    if (checks.failed) {
+        printf("\n%d check(s) failed\n", checks.failed);
+    } else {
+        printf("\nAll checks passed\n");
+    }
+    fflush(stdout);
+    _Exit(checks.failed ? 1 : 0);           // The listener task never returns
+}
@@ -0,0 +1,460 @@
+// Fleet load generator (pio run -e native_load).
+// Simulates N pairs of glasses against one server, each driving the
+// firmware's own NetworkModule, and reports latency percentiles, error rates
+// and the throughput at which the server saturates.
+//
+// Usage: program [--server http://host:8000 | --standin] [--devices N | --ramp 25,50,100]
+//                [--duration S] [--warmup S] [--think S] [--ws-fraction F]
+//                [--slo-ms MS] [--seed N] [--workers N] [--command-ms MS] [--audio-ms MS]
+//
+// Every device runs open loop: interactions arrive as a Poisson process with
+// mean gap --think, whether or not the previous one has finished, and latency
+// is measured from the scheduled arrival. A slow server therefore shows up as
+// latency instead of silently lowering the offered load.
+//
+// An interaction is what main.cpp does after the VAD fires: the recording is
+// uploaded (NetworkModule::sendAudio, 1-3 s of 16 kHz audio) and the command
+// is sent (sendCommand). --ws-fraction of the devices chat over the /ws
+// WebSocket instead. Every device also pushes its metrics once a minute.
+//
+// --standin replaces the server with an in-process model: --workers requests
+// are served at a time with log-normal service times, and uploads take the
+// time a 2 Mbit/s Wi-Fi uplink would. scripts/standin_server.py serves the
+// same model over real sockets.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "socket_client.h"
+#include "../host_random.h"
+#include "../../firmware/modules/network_module.cpp"
+#include "../../firmware/utils/logger.cpp"
+
+// ---------------------------------------------------------------- Settings
+
+struct LoadConfig {
+    std::string server = "http://127.0.0.1:8000";
+    bool standIn = false;
+    std::vector<int> steps = { 50 };
+    double durationS = 60.0;
+    double warmupS = 10.0;
+    double thinkS = 30.0;
+    double wsFraction = 0.0;
+    double sloMs = 3000.0;
+    uint64_t seed = 1;
+    int workers = 4;
+    double commandMs = 600.0;
+    double audioMs = 900.0;
+    double sigma = 0.35;
+};
+
+static LoadConfig config;
+
+// ---------------------------------------------------------------- Statistics
+
+enum LoadOp { OP_INTERACTION, OP_AUDIO, OP_COMMAND, OP_CHAT_WS, OP_METRICS, OP_COUNT };
+static const char* const OP_NAMES[OP_COUNT] = { "interaction", "audio", "command", "chat_ws", "metrics" };
+
+class LoadStats {
+public:
+    void record(LoadOp op, double ms, bool ok) {
+        if (!measuring) return;
+        std::lock_guard<std::mutex> guard(lock);
+        Series& s = series[op];
+        if (ok) {
+            s.latencyMs.push_back(ms);
+        } else {
+            s.errors++;
+        }
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        for (Series& s : series) s = Series();
+    }
+
+    struct Summary {
+        size_t ok = 0;
+        uint32_t errors = 0;
+        double p50 = 0, p90 = 0, p99 = 0, max = 0;
+    };
+
+    Summary summarize(LoadOp op) {
+        std::lock_guard<std::mutex> guard(lock);
+        Summary out;
+        std::vector<double>& v = series[op].latencyMs;
+        out.ok = v.size();
+        out.errors = series[op].errors;
+        if (!v.empty()) {
+            std::sort(v.begin(), v.end());
+            auto rank = [&](double q) { return v[(size_t)ceil(q * v.size()) - 1]; };
+            out.p50 = rank(0.50);
+            out.p90 = rank(0.90);
+            out.p99 = rank(0.99);
+            out.max = v.back();
+        }
+        return out;
+    }
+
+    std::atomic<bool> measuring{false};
+
+private:
+    struct Series {
+        std::vector<double> latencyMs;
+        uint32_t errors = 0;
+    };
+
+    std::mutex lock;
+    Series series[OP_COUNT];
+};
+
+static LoadStats stats;
+
+// Set by the transport when any request of the current interaction fails
+thread_local bool requestFailed = false;
+thread_local HostRandom* deviceRandom = nullptr;
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static LoadOp opForUrl(const String& url) {
+    if (url.endsWith("/audio")) return OP_AUDIO;
+    if (url.endsWith("/telemetry/metrics")) return OP_METRICS;
+    return OP_COMMAND;
+}
+
+// ---------------------------------------------------------------- Stand-in server
+
+class StandInServer {
+public:
+    static constexpr uint32_t UPLINK_BPS = 2000000;
+
+    HostHttpResponse handle(const HostHttpRequest& request) {
+        HostHttpResponse response;
+        LoadOp op = opForUrl(request.url);
+        auto start = std::chrono::steady_clock::now();
+
+        // Each device has its own radio link; only the server is shared
+        sleepMs(request.body.size() * 8 * 1000.0 / UPLINK_BPS);
+
+        double median = op == OP_AUDIO ? config.audioMs : op == OP_COMMAND ? config.commandMs : 2.0;
+        if (!serve(median, request.timeoutMs - msSince(start))) {
+            response.code = -11;
+            return response;
+        }
+        if (msSince(start) > request.timeoutMs) {
+            response.code = -11;   // Answered after the client gave up
+            return response;
+        }
+        response.code = 200;
+        response.body = op == OP_COMMAND ? "{\"response\":\"It is 14:05\"}" : "{\"status\":\"ok\"}";
+        return response;
+    }
+
+    // A chat message is one model call on the same workers
+    bool chat(uint32_t timeoutMs) {
+        return serve(config.commandMs, timeoutMs);
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable freed;
+    int busy = 0;
+
+    // Waits for a worker, then holds it for one service time
+    bool serve(double medianMs, double timeoutMs) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto until = std::chrono::steady_clock::now() + std::chrono::microseconds((int64_t)(std::max(timeoutMs, 0.0) * 1000));
+            if (!freed.wait_until(guard, until, [this]() { return busy < config.workers; })) {
+                return false;
+            }
+            busy++;
+        }
+        sleepMs(deviceRandom ? deviceRandom->logNormal(medianMs, config.sigma) : medianMs);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            busy--;
+        }
+        freed.notify_one();
+        return true;
+    }
+
+    static void sleepMs(double ms) {
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(ms * 1000)));
+    }
+};
+
+static StandInServer standIn;
+
+// Every firmware request goes through here, to the stand-in or the socket
+static HostHttpResponse transport(const HostHttpRequest& request) {
+    auto start = std::chrono::steady_clock::now();
+    HostHttpResponse response = config.standIn ? standIn.handle(request) : SocketHttp::perform(request);
+    bool ok = response.code == 200;
+    stats.record(opForUrl(request.url), msSince(start), ok);
+    if (!ok) requestFailed = true;
+    return response;
+}
+
+// ---------------------------------------------------------------- Devices
+
+static const char* const PHRASES[] = {
+    "what time is it",
+    "will it rain today",
+    "when is my next meeting",
+    "read my last message",
+    "navigate to the station"
+};
+
+// Shared recording: 3 s of low-level noise, uploads send a prefix of it
+static std::vector<uint8_t> recording;
+
+class Fleet {
+public:
+    void run(int devices) {
+        stopping = false;
+        stats.reset();
+        stats.measuring = false;
+        start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (int id = 0; id < devices; id++) {
+            threads.emplace_back([this, id]() { device(id); });
+        }
+
+        waitUntil(config.warmupS);
+        stats.measuring = true;
+        waitUntil(config.warmupS + config.durationS);
+        stats.measuring = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : threads) t.join();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::chrono::steady_clock::time_point start;
+
+    // Sleeps to an offset from the start of the step; false once stopping
+    bool waitUntil(double offsetS) {
+        auto until = start + std::chrono::microseconds((int64_t)(offsetS * 1e6));
+        std::unique_lock<std::mutex> guard(lock);
+        wake.wait_until(guard, until, [this]() { return stopping; });
+        return !stopping;
+    }
+
+    void device(int id) {
+        HostRandom rng(config.seed * 1000003ull + id);
+        deviceRandom = &rng;
+        NetworkModule network;
+        network.setServer(config.server.c_str());
+        bool useWebSocket = rng.uniform() < config.wsFraction;
+        WebSocketClient socket;
+
+        // Spread the first arrivals so devices do not start in lockstep
+        double nextInteraction = rng.exponential(config.thinkS);
+        double nextMetrics = rng.uniform() * 60.0;
+
+        while (true) {
+            bool metricsDue = nextMetrics < nextInteraction;
+            double due = metricsDue ? nextMetrics : nextInteraction;
+            if (!waitUntil(due)) break;
+
+            if (metricsDue) {
+                network.postMetrics();
+                nextMetrics += 60.0;
+                continue;
+            }
+
+            // Latency counts from the scheduled arrival, so lateness is included
+            auto scheduled = start + std::chrono::microseconds((int64_t)(due * 1e6));
+            const char* phrase = PHRASES[rng.next() % (sizeof(PHRASES) / sizeof(PHRASES[0]))];
+            requestFailed = false;
+            if (useWebSocket) {
+                chat(socket, phrase, rng);
+            } else {
+                size_t bytes = (size_t)((1.0 + 2.0 * rng.uniform()) * SAMPLE_RATE_BYTES);
+                network.sendAudio(recording.data(), std::min(bytes, recording.size()));
+                network.sendCommand(phrase);
+            }
+            stats.record(OP_INTERACTION, msSince(scheduled), !requestFailed);
+            nextInteraction += rng.exponential(config.thinkS);
+        }
+        socket.close();
+        deviceRandom = nullptr;
+    }
+
+    void chat(WebSocketClient& socket, const char* phrase, HostRandom& rng) {
+        static const uint32_t TIMEOUT_MS = 5000;
+        auto begin = std::chrono::steady_clock::now();
+        bool ok;
+        if (config.standIn) {
+            ok = standIn.chat(TIMEOUT_MS);
+        } else {
+            if (!socket.isOpen()) {
+                std::string url = config.server;
+                url.replace(0, 4, "ws");
+                ok = socket.connect(url + "/ws", TIMEOUT_MS, rng) == 0;
+            } else {
+                ok = true;
+            }
+            std::string reply;
+            ok = ok && socket.sendText(phrase, rng) && socket.receiveText(reply, TIMEOUT_MS);
+            if (!ok) socket.close();   // Reconnect on the next message
+        }
+        stats.record(OP_CHAT_WS, msSince(begin), ok);
+        if (!ok) requestFailed = true;
+    }
+
+    static constexpr size_t SAMPLE_RATE_BYTES = 16000 * sizeof(int16_t);
+};
+
+// ---------------------------------------------------------------- Report
+
+struct StepResult {
+    int devices;
+    double offered;
+    double achieved;
+    LoadStats::Summary interaction;
+    bool withinSlo;
+};
+
+static StepResult report(int devices) {
+    printf("\n%d devices, offered %.2f interactions/s, %.0f s measured after %.0f s warm-up\n",
+           devices, devices / config.thinkS, config.durationS, config.warmupS);
+    printf("  %-12s %7s %7s %7s %8s %8s %8s %8s %8s\n", "op", "ok", "errors", "err%", "per_s",
+           "p50_ms", "p90_ms", "p99_ms", "max_ms");
+
+    StepResult result = { devices, devices / config.thinkS, 0, {}, false };
+    for (int op = 0; op < OP_COUNT; op++) {
+        LoadStats::Summary s = stats.summarize((LoadOp)op);
+        size_t total = s.ok + s.errors;
+        if (total == 0) continue;
+        double rate = s.ok / config.durationS;
+        printf("  %-12s %7zu %7u %7.2f %8.2f %8.0f %8.0f %8.0f %8.0f\n", OP_NAMES[op], s.ok, s.errors,
+               100.0 * s.errors / total, rate, s.p50, s.p90, s.p99, s.max);
+        if (op == OP_INTERACTION) {
+            result.interaction = s;
+            result.achieved = rate;
+        }
+    }
+
+    size_t total = result.interaction.ok + result.interaction.errors;
+    double errorRate = total ? (double)result.interaction.errors / total : 0.0;
+    result.withinSlo = total > 0 && result.interaction.p99 <= config.sloMs && errorRate <= 0.01 &&
+                       result.achieved >= 0.9 * result.offered;
+    return result;
+}
+
+static void summarize(const std::vector<StepResult>& results) {
+    printf("\n%8s %10s %10s %8s %8s %7s  %s\n", "devices", "offered/s", "served/s", "p50_ms", "p99_ms", "err%", "status");
+    const StepResult* lastGood = nullptr;
+    double peak = 0;
+    for (const StepResult& r : results) {
+        size_t total = r.interaction.ok + r.interaction.errors;
+        printf("%8d %10.2f %10.2f %8.0f %8.0f %7.2f  %s\n", r.devices, r.offered, r.achieved, r.interaction.p50,
+               r.interaction.p99, total ? 100.0 * r.interaction.errors / total : 0.0,
+               r.withinSlo ? "ok" : "saturated");
+        if (r.withinSlo) lastGood = &r;
+        peak = std::max(peak, r.achieved);
+    }
+    printf("\nPeak served %.2f interactions/s. ", peak);
+    if (lastGood) {
+        printf("Within SLO (p99 <= %.0f ms, <= 1%% errors) up to %d devices, %.2f interactions/s.\n",
+               config.sloMs, lastGood->devices, lastGood->achieved);
+    } else {
+        printf("No step met the SLO (p99 <= %.0f ms, <= 1%% errors).\n", config.sloMs);
+    }
+}
+
+// ---------------------------------------------------------------- Main
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [--server URL | --standin] [--devices N | --ramp N,N,...] [--duration S] [--warmup S]\n"
+                    "          [--think S] [--ws-fraction F] [--slo-ms MS] [--seed N]\n"
+                    "          [--workers N] [--command-ms MS] [--audio-ms MS] [--sigma S]\n", name);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--standin") { config.standIn = true; continue; }
+        if (value == nullptr) { usage(argv[0]); return 2; }
+        i++;
+        if (arg == "--server") config.server = value;
+        else if (arg == "--devices") config.steps = { atoi(value) };
+        else if (arg == "--ramp") {
+            config.steps.clear();
+            for (const char* p = value; *p; ) {
+                config.steps.push_back(atoi(p));
+                p = strchr(p, ',');
+                if (p == nullptr) break;
+                p++;
+            }
+        }
+        else if (arg == "--duration") config.durationS = atof(value);
+        else if (arg == "--warmup") config.warmupS = atof(value);
+        else if (arg == "--think") config.thinkS = atof(value);
+        else if (arg == "--ws-fraction") config.wsFraction = atof(value);
+        else if (arg == "--slo-ms") config.sloMs = atof(value);
+        else if (arg == "--seed") config.seed = strtoull(value, nullptr, 10);
+        else if (arg == "--workers") config.workers = atoi(value);
+        else if (arg == "--command-ms") config.commandMs = atof(value);
+        else if (arg == "--audio-ms") config.audioMs = atof(value);
+        else if (arg == "--sigma") config.sigma = atof(value);
+        else { usage(argv[0]); return 2; }
+    }
+    if (config.server.compare(0, 7, "http://") != 0) {
+        fprintf(stderr, "Only http:// servers are supported (run uvicorn without TLS for load tests)\n");
+        return 2;
+    }
+    while (!config.server.empty() && config.server.back() == '/') config.server.pop_back();
+
+    Serial.setHostOutput(nullptr);
+    Logger::setLogLevel(LOG_NONE);
+    HostRandom noise(config.seed);
+    for (size_t i = 0; i < 3 * 16000; i++) {
+        int16_t sample = (int16_t)(noise.normal() * 200);
+        recording.push_back(sample & 0xFF);
+        recording.push_back(sample >> 8);
+    }
+
+    // Radio time is real here: the transport or the stand-in takes it
+    HostHttp::chargeClock = false;
+    HostHttp::setHandler(transport);
+    HostWifi::connectMs = 0;
+    WiFi.begin("load", "load");
+
+    printf("Target %s, think %.1f s, %.0f%% WebSocket, seed %llu\n",
+           config.standIn ? "in-process stand-in" : config.server.c_str(), config.thinkS,
+           config.wsFraction * 100, (unsigned long long)config.seed);
+    if (config.standIn) {
+        printf("Stand-in: %d workers, command %.0f ms, audio %.0f ms, sigma %.2f\n",
+               config.workers, config.commandMs, config.audioMs, config.sigma);
+    }
+
+    std::vector<StepResult> results;
+    for (int devices : config.steps) {
+        Fleet fleet;
+        fleet.run(devices);
+        results.push_back(report(devices));
+        fflush(stdout);
+    }
+    if (results.size() > 1) {
+        summarize(results);
+    }
+    return 0;
+}
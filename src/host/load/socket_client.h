@@ -0,0 +1,400 @@
+#ifndef HOST_SOCKET_CLIENT_H
+#define HOST_SOCKET_CLIENT_H
+
+// Real network transport for host tools: plain HTTP/1.1 requests for the
+// HostHttp handler and a minimal WebSocket client. POSIX sockets only, one
+// connection per HTTP request (the firmware does not reuse connections).
+// TLS is not supported; point the tools at an http:// server.
+
+#include <Arduino.h>
+#include "../host_net.h"
+#include "../host_random.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <chrono>
+#include <string>
+
+struct SocketUrl {
+    std::string host;
+    std::string port = "80";
+    std::string path = "/";
+
+    // Accepts http://host[:port][/path] and ws://host[:port][/path]
+    bool parse(const std::string& url) {
+        size_t scheme = url.find("://");
+        if (scheme == std::string::npos) return false;
+        std::string name = url.substr(0, scheme);
+        if (name != "http" && name != "ws") return false;
+        size_t hostStart = scheme + 3;
+        size_t pathStart = url.find('/', hostStart);
+        std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+        path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+        size_t colon = authority.rfind(':');
+        if (colon != std::string::npos) {
+            host = authority.substr(0, colon);
+            port = authority.substr(colon + 1);
+        } else {
+            host = authority;
+        }
+        return !host.empty();
+    }
+};
+
+// One TCP connection with deadline-bounded reads and writes
+class SocketConnection {
+public:
+    ~SocketConnection() {
+        close();
+    }
+
+    // Returns 0, or an HTTPClient error code (-1 refused, -11 timeout)
+    int open(const SocketUrl& url, uint32_t timeoutMs) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &found) != 0) {
+            return -1;
+        }
+
+        int result = -1;
+        for (addrinfo* a = found; a != nullptr && fd < 0; a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd < 0) continue;
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            if (connect(fd, a->ai_addr, a->ai_addrlen) == 0 || errno == EINPROGRESS) {
+                if (!wait(POLLOUT)) {
+                    result = -11;
+                } else {
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                    if (error == 0) {
+                        result = 0;
+                        continue;
+                    }
+                }
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(found);
+        return fd >= 0 ? 0 : result;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    void extendDeadline(uint32_t timeoutMs) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    }
+
+    bool writeAll(const void* data, size_t length) {
+        const uint8_t* p = (const uint8_t*)data;
+        while (length > 0) {
+            ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+            if (n > 0) {
+                p += n;
+                length -= n;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (!wait(POLLOUT)) return false;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Appends whatever arrives next; false on timeout, 0 bytes on orderly close
+    bool readSome(std::string& into, bool& closed) {
+        char chunk[4096];
+        closed = false;
+        while (true) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                into.append(chunk, n);
+                return true;
+            }
+            if (n == 0) {
+                closed = true;
+                return true;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closed = true;
+                return true;
+            }
+            if (!wait(POLLIN)) return false;
+        }
+    }
+
+    // Reads until at least count bytes are buffered
+    bool readAtLeast(std::string& into, size_t count) {
+        bool closed = false;
+        while (into.size() < count) {
+            if (!readSome(into, closed) || closed) return false;
+        }
+        return true;
+    }
+
+private:
+    int fd = -1;
+    std::chrono::steady_clock::time_point deadline;
+
+    bool wait(short events) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+        pollfd p = { fd, events, 0 };
+        return poll(&p, 1, (int)left) > 0;
+    }
+};
+
+class SocketHttp {
+public:
+    // HostHttp handler: performs the request on the wire
+    static HostHttpResponse perform(const HostHttpRequest& request) {
+        HostHttpResponse response;
+        SocketUrl url;
+        if (!url.parse(request.url.c_str())) {
+            response.code = -1;
+            return response;
+        }
+
+        SocketConnection connection;
+        response.code = connection.open(url, request.timeoutMs);
+        if (response.code != 0) {
+            return response;
+        }
+
+        std::string head = std::string(request.method.c_str()) + " " + url.path + " HTTP/1.1\r\n" +
+                           "Host: " + url.host + ":" + url.port + "\r\n" +
+                           "Connection: close\r\n" +
+                           "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+        for (const auto& h : request.headers) {
+            head += std::string(h.first.c_str()) + ": " + h.second.c_str() + "\r\n";
+        }
+        head += "\r\n";
+        if (!connection.writeAll(head.data(), head.size()) ||
+            !connection.writeAll(request.body.data(), request.body.size())) {
+            response.code = -1;
+            return response;
+        }
+
+        // Read to the end of the headers, then the body by length, chunks or close
+        std::string data;
+        size_t headerEnd;
+        bool closed = false;
+        while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+            if (!connection.readSome(data, closed)) {
+                response.code = -11;
+                return response;
+            }
+            if (closed) {
+                response.code = -1;
+                return response;
+            }
+        }
+
+        int code = 0;
+        if (sscanf(data.c_str(), "HTTP/%*s %d", &code) != 1) {
+            response.code = -1;
+            return response;
+        }
+        long contentLength = -1;
+        bool chunked = false;
+        size_t lineStart = data.find("\r\n") + 2;
+        while (lineStart < headerEnd) {
+            size_t lineEnd = data.find("\r\n", lineStart);
+            std::string line = data.substr(lineStart, lineEnd - lineStart);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                std::string name = line.substr(0, colon);
+                std::string value = line.substr(colon + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                response.headers.push_back(std::make_pair(String(name.c_str()), String(value.c_str())));
+                if (strcasecmp(name.c_str(), "Content-Length") == 0) contentLength = atol(value.c_str());
+                if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0 && value.find("chunked") != std::string::npos) chunked = true;
+            }
+            lineStart = lineEnd + 2;
+        }
+
+        std::string body = data.substr(headerEnd + 4);
+        bool complete;
+        if (chunked) {
+            complete = readChunked(connection, body);
+        } else if (contentLength >= 0) {
+            complete = connection.readAtLeast(body, contentLength);
+            body.resize(std::min(body.size(), (size_t)contentLength));
+        } else {
+            complete = true;
+            while (!closed) {
+                if (!connection.readSome(body, closed)) {
+                    complete = false;
+                    break;
+                }
+            }
+        }
+        if (!complete) {
+            response.code = -11;
+            return response;
+        }
+        response.code = code;
+        response.body = String(body.c_str());
+        return response;
+    }
+
+private:
+    static bool readChunked(SocketConnection& connection, std::string& raw) {
+        std::string body;
+        size_t at = 0;
+        while (true) {
+            size_t lineEnd;
+            while ((lineEnd = raw.find("\r\n", at)) == std::string::npos) {
+                if (!connection.readAtLeast(raw, raw.size() + 1)) return false;
+            }
+            size_t size = strtoul(raw.c_str() + at, nullptr, 16);
+            at = lineEnd + 2;
+            if (!connection.readAtLeast(raw, at + size + 2)) return false;
+            if (size == 0) break;
+            body.append(raw, at, size);
+            at += size + 2;
+        }
+        raw = body;
+        return true;
+    }
+};
+
+// Text-message WebSocket client (RFC 6455), enough for the /ws chat endpoint
+class WebSocketClient {
+public:
+    // Returns 0 or an HTTPClient-style error code
+    int connect(const std::string& url, uint32_t timeoutMs, HostRandom& rng) {
+        SocketUrl target;
+        if (!target.parse(url)) return -1;
+        int status = connection.open(target, timeoutMs);
+        if (status != 0) return status;
+
+        uint8_t nonce[16];
+        for (int i = 0; i < 16; i++) nonce[i] = (uint8_t)rng.next();
+        std::string request = "GET " + target.path + " HTTP/1.1\r\n"
+                              "Host: " + target.host + ":" + target.port + "\r\n"
+                              "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Version: 13\r\n"
+                              "Sec-WebSocket-Key: " + base64(nonce, 16) + "\r\n\r\n";
+        if (!connection.writeAll(request.data(), request.size())) return -1;
+
+        bool closed = false;
+        size_t headerEnd;
+        while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos) {
+            if (!connection.readSome(pending, closed)) return -11;
+            if (closed) return -1;
+        }
+        int code = 0;
+        sscanf(pending.c_str(), "HTTP/%*s %d", &code);
+        pending.erase(0, headerEnd + 4);
+        open = code == 101;
+        return open ? 0 : code;
+    }
+
+    bool sendText(const std::string& text, HostRandom& rng) {
+        std::string frame;
+        frame += (char)0x81;   // FIN, text
+        if (text.size() < 126) {
+            frame += (char)(0x80 | text.size());
+        } else if (text.size() < 65536) {
+            frame += (char)(0x80 | 126);
+            frame += (char)(text.size() >> 8);
+            frame += (char)(text.size() & 0xFF);
+        } else {
+            frame += (char)(0x80 | 127);
+            for (int i = 7; i >= 0; i--) frame += (char)((uint64_t)text.size() >> (8 * i));
+        }
+        // Client frames are always masked
+        uint8_t mask[4];
+        for (int i = 0; i < 4; i++) mask[i] = (uint8_t)rng.next();
+        frame.append((const char*)mask, 4);
+        for (size_t i = 0; i < text.size(); i++) frame += (char)(text[i] ^ mask[i & 3]);
+        return connection.writeAll(frame.data(), frame.size());
+    }
+
+    // Next text message; answers pings, false on close or timeout
+    bool receiveText(std::string& text, uint32_t timeoutMs) {
+        connection.extendDeadline(timeoutMs);
+        while (open) {
+            if (!connection.readAtLeast(pending, 2)) return false;
+            uint8_t opcode = pending[0] & 0x0F;
+            uint64_t length = pending[1] & 0x7F;
+            size_t header = 2;
+            if (length == 126) {
+                if (!connection.readAtLeast(pending, 4)) return false;
+                length = ((uint8_t)pending[2] << 8) | (uint8_t)pending[3];
+                header = 4;
+            } else if (length == 127) {
+                if (!connection.readAtLeast(pending, 10)) return false;
+                length = 0;
+                for (int i = 0; i < 8; i++) length = (length << 8) | (uint8_t)pending[2 + i];
+                header = 10;
+            }
+            if (!connection.readAtLeast(pending, header + length)) return false;
+            std::string payload = pending.substr(header, length);
+            pending.erase(0, header + length);
+
+            if (opcode == 0x1) {
+                text = payload;
+                return true;
+            }
+            if (opcode == 0x8) {
+                open = false;
+            } else if (opcode == 0x9) {
+                uint8_t pong[6] = { 0x8A, 0x80, 0, 0, 0, 0 };
+                connection.writeAll(pong, sizeof(pong));
+            }
+        }
+        return false;
+    }
+
+    void close() {
+        if (open) {
+            uint8_t frame[6] = { 0x88, 0x80, 0, 0, 0, 0 };
+            connection.writeAll(frame, sizeof(frame));
+            open = false;
+        }
+        connection.close();
+    }
+
+    bool isOpen() const {
+        return open;
+    }
+
+private:
+    SocketConnection connection;
+    std::string pending;
+    bool open = false;
+
+    static std::string base64(const uint8_t* data, size_t length) {
+        static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        for (size_t i = 0; i < length; i += 3) {
+            uint32_t v = data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+            out += table[v >> 18 & 63];
+            out += table[v >> 12 & 63];
+            out += i + 1 < length ? table[v >> 6 & 63] : '=';
+            out += i + 2 < length ? table[v & 63] : '=';
+        }
+        return out;
+    }
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_MBEDTLS_CTR_DRBG_H
+#define HOST_MBEDTLS_CTR_DRBG_H
+
+// Declared with the rest of the TLS client API
+#include "ssl.h"
+
+#endif
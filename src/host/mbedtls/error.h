@@ -0,0 +1,12 @@
+#ifndef HOST_MBEDTLS_ERROR_H
+#define HOST_MBEDTLS_ERROR_H
+
+#include <stdio.h>
+#include "ssl.h"
+
+// The code only; the device build has the descriptions
+inline void mbedtls_strerror(int errnum, char* buffer, size_t buflen) {
+    snprintf(buffer, buflen, "-0x%04X", errnum < 0 ? -errnum : errnum);
+}
+
+#endif
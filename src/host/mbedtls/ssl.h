@@ -0,0 +1,434 @@
+#ifndef HOST_MBEDTLS_SSL_H
+#define HOST_MBEDTLS_SSL_H
+
+// The TLS client API of mbedtls 2.28 (IDF 4.4) as the firmware uses it, over
+// a pluggable engine. There is no TLS in the shim itself: a harness sets a
+// HostTls factory (an OpenSSL client in src/host/tls), and without one every
+// handshake fails with MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE. The context moves
+// ciphertext between the engine and the bio callbacks as mbedtls would, and
+// steps through the handshake states the firmware can observe: a full
+// handshake passes MBEDTLS_SSL_CLIENT_KEY_EXCHANGE, a resumed one does not.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define MBEDTLS_ERR_NET_SEND_FAILED -0x004E
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
+#define MBEDTLS_ERR_X509_INVALID_FORMAT -0x2180
+#define MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE -0x7080
+#define MBEDTLS_ERR_SSL_BAD_INPUT_DATA -0x7100
+#define MBEDTLS_ERR_SSL_CONN_EOF -0x7280
+#define MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE -0x7780
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY -0x7880
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+#define MBEDTLS_SSL_VERIFY_NONE 0
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+#define MBEDTLS_SSL_SESSION_TICKETS_DISABLED 0
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+
+#define MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 0xC02B
+#define MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 0xC02F
+#define MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256 0xC037
+
+typedef enum {
+    MBEDTLS_SSL_HELLO_REQUEST,
+    MBEDTLS_SSL_CLIENT_HELLO,
+    MBEDTLS_SSL_SERVER_HELLO,
+    MBEDTLS_SSL_SERVER_CERTIFICATE,
+    MBEDTLS_SSL_SERVER_KEY_EXCHANGE,
+    MBEDTLS_SSL_CERTIFICATE_REQUEST,
+    MBEDTLS_SSL_SERVER_HELLO_DONE,
+    MBEDTLS_SSL_CLIENT_CERTIFICATE,
+    MBEDTLS_SSL_CLIENT_KEY_EXCHANGE,
+    MBEDTLS_SSL_CERTIFICATE_VERIFY,
+    MBEDTLS_SSL_CLIENT_CHANGE_CIPHER_SPEC,
+    MBEDTLS_SSL_CLIENT_FINISHED,
+    MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC,
+    MBEDTLS_SSL_SERVER_FINISHED,
+    MBEDTLS_SSL_FLUSH_BUFFERS,
+    MBEDTLS_SSL_HANDSHAKE_WRAPUP,
+    MBEDTLS_SSL_HANDSHAKE_OVER
+} mbedtls_ssl_states;
+
+typedef enum {
+    MBEDTLS_ECP_DP_NONE = 0,
+    MBEDTLS_ECP_DP_SECP256R1 = 3,
+    MBEDTLS_ECP_DP_SECP384R1 = 4
+} mbedtls_ecp_group_id;
+
+typedef int mbedtls_ssl_send_t(void* ctx, const unsigned char* buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void* ctx, unsigned char* buf, size_t len);
+
+// ---------------------------------------------------------------- Engine
+
+// What the client asked for, from the config and the context
+struct HostTlsParams {
+    std::string hostname;
+    bool verify = false;
+    std::string caPem;                      // Trust anchors, when verifying
+    std::string pskIdentity;
+    std::vector<uint8_t> psk;
+    std::vector<int> ciphersuites;          // IANA ids, in order of preference
+    std::vector<int> curves;                // mbedtls_ecp_group_id
+    bool tickets = false;
+    std::shared_ptr<void> session;          // From an earlier handshake, to resume
+};
+
+// One client connection in a real TLS implementation, fed ciphertext
+class HostTlsEngine {
+public:
+    virtual ~HostTlsEngine() {}
+    // Ciphertext from the peer, and to it
+    virtual void receive(const uint8_t* data, size_t length) = 0;
+    virtual std::string takeOutput() = 0;
+    // As far as the bytes so far allow: 1 done, 0 waiting for the peer, -1 failed
+    virtual int handshake() = 0;
+    // Known once the server has answered the hello
+    virtual bool keyExchanged() = 0;
+    // Plaintext: > 0 bytes, 0 nothing yet, -1 closed or failed
+    virtual int read(uint8_t* data, size_t length) = 0;
+    virtual int write(const uint8_t* data, size_t length) = 0;
+    virtual size_t pending() = 0;
+    virtual void closeNotify() = 0;
+    virtual std::shared_ptr<void> session() = 0;
+    virtual const char* ciphersuite() = 0;
+};
+
+class HostTls {
+public:
+    typedef std::function<std::unique_ptr<HostTlsEngine>(const HostTlsParams&)> Factory;
+
+    static void setFactory(Factory factory) {
+        current = factory;
+    }
+
+    static std::unique_ptr<HostTlsEngine> create(const HostTlsParams& params) {
+        return current ? current(params) : nullptr;
+    }
+
+private:
+    static inline Factory current;
+};
+
+// ---------------------------------------------------------------- Randomness
+
+typedef struct mbedtls_entropy_context {
+    std::random_device device;
+} mbedtls_entropy_context;
+
+typedef struct mbedtls_ctr_drbg_context {
+    std::mt19937_64 generator;
+} mbedtls_ctr_drbg_context;
+
+inline void mbedtls_entropy_init(mbedtls_entropy_context*) {}
+inline void mbedtls_entropy_free(mbedtls_entropy_context*) {}
+
+inline int mbedtls_entropy_func(void* data, unsigned char* output, size_t len) {
+    mbedtls_entropy_context* entropy = (mbedtls_entropy_context*)data;
+    for (size_t i = 0; i < len; i++) output[i] = (unsigned char)entropy->device();
+    return 0;
+}
+
+inline void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context*) {}
+inline void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context*) {}
+
+inline int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*f_entropy)(void*, unsigned char*, size_t),
+                                 void* p_entropy, const unsigned char* custom, size_t len) {
+    uint64_t seed = 0;
+    int ret = f_entropy(p_entropy, (unsigned char*)&seed, sizeof(seed));
+    for (size_t i = 0; i < len; i++) seed = seed * 131 + custom[i];
+    ctx->generator.seed(seed);
+    return ret;
+}
+
+inline int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t len) {
+    mbedtls_ctr_drbg_context* ctx = (mbedtls_ctr_drbg_context*)p_rng;
+    for (size_t i = 0; i < len; i++) output[i] = (unsigned char)ctx->generator();
+    return 0;
+}
+
+// ---------------------------------------------------------------- Certificates
+
+typedef struct mbedtls_x509_crt {
+    std::string pem;
+} mbedtls_x509_crt;
+
+inline void mbedtls_x509_crt_init(mbedtls_x509_crt* crt) {
+    crt->pem.clear();
+}
+
+inline void mbedtls_x509_crt_free(mbedtls_x509_crt* crt) {
+    crt->pem.clear();
+}
+
+// PEM only, and as mbedtls wants it: len counts the terminating NUL
+inline int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t buflen) {
+    if (buflen == 0 || buf[buflen - 1] != '\0' || strstr((const char*)buf, "-----BEGIN CERTIFICATE-----") == nullptr) {
+        return MBEDTLS_ERR_X509_INVALID_FORMAT;
+    }
+    chain->pem.append((const char*)buf, buflen - 1);
+    return 0;
+}
+
+// ---------------------------------------------------------------- SSL
+
+typedef struct mbedtls_ssl_session {
+    std::shared_ptr<void> state;
+} mbedtls_ssl_session;
+
+typedef struct mbedtls_ssl_config {
+    int authmode = MBEDTLS_SSL_VERIFY_REQUIRED;
+    const mbedtls_x509_crt* ca = nullptr;
+    std::string pskIdentity;
+    std::vector<uint8_t> psk;
+    std::vector<int> ciphersuites;
+    std::vector<int> curves;
+    bool tickets = true;
+} mbedtls_ssl_config;
+
+typedef struct mbedtls_ssl_context {
+    int state = MBEDTLS_SSL_HELLO_REQUEST;
+    const mbedtls_ssl_config* conf = nullptr;
+    void* p_bio = nullptr;
+    mbedtls_ssl_send_t* f_send = nullptr;
+    mbedtls_ssl_recv_t* f_recv = nullptr;
+    std::string hostname;
+    std::shared_ptr<void> offered;
+    std::unique_ptr<HostTlsEngine> engine;
+    std::string unsent;                     // Ciphertext the bio has not taken yet
+    bool eof = false;
+} mbedtls_ssl_context;
+
+inline void mbedtls_ssl_session_init(mbedtls_ssl_session* session) {
+    session->state.reset();
+}
+
+inline void mbedtls_ssl_session_free(mbedtls_ssl_session* session) {
+    session->state.reset();
+}
+
+inline void mbedtls_ssl_config_init(mbedtls_ssl_config* conf) {
+    *conf = mbedtls_ssl_config();
+}
+
+inline void mbedtls_ssl_config_free(mbedtls_ssl_config* conf) {
+    *conf = mbedtls_ssl_config();
+}
+
+inline int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset) {
+    return endpoint == MBEDTLS_SSL_IS_CLIENT ? 0 : MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+}
+
+inline void mbedtls_ssl_conf_rng(mbedtls_ssl_config*, int (*)(void*, unsigned char*, size_t), void*) {}
+
+inline void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode) {
+    conf->authmode = authmode;
+}
+
+inline void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl) {
+    conf->ca = ca_chain;
+}
+
+inline int mbedtls_ssl_conf_psk(mbedtls_ssl_config* conf, const unsigned char* psk, size_t psk_len,
+                                const unsigned char* psk_identity, size_t psk_identity_len) {
+    if (psk_len == 0 || psk_identity_len == 0) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    conf->psk.assign(psk, psk + psk_len);
+    conf->pskIdentity.assign((const char*)psk_identity, psk_identity_len);
+    return 0;
+}
+
+// Zero-terminated lists, kept by pointer in mbedtls; copied here
+inline void mbedtls_ssl_conf_ciphersuites(mbedtls_ssl_config* conf, const int* ciphersuites) {
+    conf->ciphersuites.clear();
+    for (const int* id = ciphersuites; *id != 0; id++) conf->ciphersuites.push_back(*id);
+}
+
+inline void mbedtls_ssl_conf_curves(mbedtls_ssl_config* conf, const mbedtls_ecp_group_id* curves) {
+    conf->curves.clear();
+    for (const mbedtls_ecp_group_id* id = curves; *id != MBEDTLS_ECP_DP_NONE; id++) conf->curves.push_back(*id);
+}
+
+inline void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config* conf, int use_tickets) {
+    conf->tickets = use_tickets == MBEDTLS_SSL_SESSION_TICKETS_ENABLED;
+}
+
+inline void mbedtls_ssl_init(mbedtls_ssl_context* ssl) {
+    ssl->state = MBEDTLS_SSL_HELLO_REQUEST;
+    ssl->conf = nullptr;
+    ssl->engine.reset();
+}
+
+inline void mbedtls_ssl_free(mbedtls_ssl_context* ssl) {
+    ssl->engine.reset();
+    ssl->offered.reset();
+    ssl->unsent.clear();
+}
+
+inline int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf) {
+    ssl->conf = conf;
+    return 0;
+}
+
+inline int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname) {
+    ssl->hostname = hostname ? hostname : "";
+    return 0;
+}
+
+inline void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t* f_send,
+                                mbedtls_ssl_recv_t* f_recv, void* f_recv_timeout) {
+    ssl->p_bio = p_bio;
+    ssl->f_send = f_send;
+    ssl->f_recv = f_recv;
+}
+
+inline int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session) {
+    if (!session->state) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    ssl->offered = session->state;
+    return 0;
+}
+
+inline int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl) {
+    ssl->state = MBEDTLS_SSL_HELLO_REQUEST;
+    ssl->engine.reset();
+    ssl->offered.reset();
+    ssl->unsent.clear();
+    ssl->eof = false;
+    return 0;
+}
+
+// Whatever the bio will take of the engine's output; 0 when all of it went
+inline int host_ssl_flush(mbedtls_ssl_context* ssl) {
+    ssl->unsent += ssl->engine->takeOutput();
+    while (!ssl->unsent.empty()) {
+        int n = ssl->f_send(ssl->p_bio, (const unsigned char*)ssl->unsent.data(), ssl->unsent.size());
+        if (n < 0) return n;
+        if (n == 0) return MBEDTLS_ERR_SSL_WANT_WRITE;
+        ssl->unsent.erase(0, n);
+    }
+    return 0;
+}
+
+// Everything the bio has for the engine; 0, or an error other than WANT_READ
+inline int host_ssl_fill(mbedtls_ssl_context* ssl) {
+    unsigned char buffer[1460];
+    while (!ssl->eof) {
+        int n = ssl->f_recv(ssl->p_bio, buffer, sizeof(buffer));
+        if (n == MBEDTLS_ERR_SSL_WANT_READ) break;
+        if (n < 0) return n;
+        if (n == 0) {
+            ssl->eof = true;
+            break;
+        }
+        ssl->engine->receive(buffer, n);
+    }
+    return 0;
+}
+
+inline int mbedtls_ssl_handshake_step(mbedtls_ssl_context* ssl) {
+    if (ssl->conf == nullptr || ssl->f_send == nullptr) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    if (ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER) return 0;
+    if (!ssl->engine) {
+        HostTlsParams params;
+        params.hostname = ssl->hostname;
+        params.verify = ssl->conf->authmode == MBEDTLS_SSL_VERIFY_REQUIRED;
+        params.caPem = ssl->conf->ca ? ssl->conf->ca->pem : std::string();
+        params.pskIdentity = ssl->conf->pskIdentity;
+        params.psk = ssl->conf->psk;
+        params.ciphersuites = ssl->conf->ciphersuites;
+        params.curves = ssl->conf->curves;
+        params.tickets = ssl->conf->tickets;
+        params.session = ssl->offered;
+        ssl->engine = HostTls::create(params);
+        if (!ssl->engine) return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+        ssl->state = MBEDTLS_SSL_CLIENT_HELLO;
+    }
+    int ret = host_ssl_fill(ssl);
+    if (ret != 0) return ret;
+    int done = ssl->engine->handshake();
+    ret = host_ssl_flush(ssl);
+    if (done < 0) return MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE;
+    if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_WRITE) return ret;
+    // One state per step, as the firmware might look between them
+    if (ssl->state < MBEDTLS_SSL_CLIENT_KEY_EXCHANGE && ssl->engine->keyExchanged()) {
+        ssl->state = MBEDTLS_SSL_CLIENT_KEY_EXCHANGE;
+        return 0;
+    }
+    if (done == 0) {
+        if (ret != 0) return ret;
+        if (ssl->eof) return MBEDTLS_ERR_SSL_CONN_EOF;
+        if (ssl->state < MBEDTLS_SSL_SERVER_HELLO) ssl->state = MBEDTLS_SSL_SERVER_HELLO;
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    if (ssl->state < MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC) {
+        ssl->state = MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC;
+        return 0;
+    }
+    if (ret != 0) return ret;
+    ssl->state = MBEDTLS_SSL_HANDSHAKE_OVER;
+    return 0;
+}
+
+inline int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl) {
+    int ret = 0;
+    while (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        ret = mbedtls_ssl_handshake_step(ssl);
+        if (ret != 0) break;
+    }
+    return ret;
+}
+
+// A len of 0 only takes in what has arrived (for get_bytes_avail)
+inline int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len) {
+    if (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    int ret = host_ssl_fill(ssl);
+    if (ret != 0) return ret;
+    int n = ssl->engine->read(buf, len);
+    host_ssl_flush(ssl);
+    if (n < 0) return MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+    if (n == 0 && len > 0) return ssl->eof ? MBEDTLS_ERR_SSL_CONN_EOF : MBEDTLS_ERR_SSL_WANT_READ;
+    return n;
+}
+
+// Nothing new is taken while earlier records are still waiting for the bio
+inline int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len) {
+    if (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    int ret = host_ssl_flush(ssl);
+    if (ret != 0) return ret;
+    int n = ssl->engine->write(buf, len);
+    if (n < 0) return MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+    ret = host_ssl_flush(ssl);
+    return ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_WRITE ? ret : n;
+}
+
+inline size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context* ssl) {
+    return ssl->engine && ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER ? ssl->engine->pending() : 0;
+}
+
+inline int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl) {
+    if (!ssl->engine || ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) return 0;
+    ssl->engine->closeNotify();
+    return host_ssl_flush(ssl);
+}
+
+inline int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* dst) {
+    if (!ssl->engine || ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    dst->state = ssl->engine->session();
+    return dst->state ? 0 : MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+}
+
+inline const char* mbedtls_ssl_get_ciphersuite(const mbedtls_ssl_context* ssl) {
+    return ssl->engine ? ssl->engine->ciphersuite() : nullptr;
+}
+
+#endif
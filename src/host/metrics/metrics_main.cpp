@@ -0,0 +1,321 @@
+// Metrics harness (pio run -e native_metrics).
+// Checks the log-linear histogram's bucket boundaries, sum, count and
+// quantiles against the exact values, then hammers counters and histograms
+// from several threads at once and checks nothing was lost. Last, parses
+// the Prometheus export line by line against the text exposition format.
+//
+// Usage: program [--threads N] [--updates N]
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../host_random.h"
+#include "../../firmware/utils/logger.cpp"
+#include "../../firmware/utils/metrics.cpp"
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+static void checkBuckets(Checks& checks) {
+    printf("Buckets:\n");
+
+    bool exact = true;
+    for (uint32_t v = 0; v < Histogram::SUB_BUCKETS; v++) {
+        uint8_t b = Histogram::bucketFor(v);
+        exact = exact && Histogram::bucketLower(b) == v && Histogram::bucketUpper(b) == v;
+    }
+    checks.expect(exact, "values below 8 get a bucket each");
+
+    // Every bucket starts right after the one before and holds its own bounds
+    bool contiguous = Histogram::bucketLower(0) == 0;
+    bool ownBounds = true;
+    uint8_t badBucket = 0;
+    for (uint8_t b = 0; b < Histogram::BUCKETS; b++) {
+        if (b > 0 && Histogram::bucketLower(b) != Histogram::bucketUpper(b - 1) + 1) {
+            contiguous = false;
+            badBucket = b;
+        }
+        if (Histogram::bucketFor(Histogram::bucketLower(b)) != b ||
+            Histogram::bucketFor(Histogram::bucketUpper(b)) != b) {
+            ownBounds = false;
+            badBucket = b;
+        }
+    }
+    checks.expect(contiguous, "buckets cover 0 to UINT32_MAX without gaps or overlaps",
+                  contiguous ? "" : format("bucket %.0f", badBucket));
+    checks.expect(ownBounds, "a bucket's lower and upper bounds fall into it",
+                  ownBounds ? "" : format("bucket %.0f", badBucket));
+
+    double widest = 0;
+    for (uint8_t b = Histogram::SUB_BUCKETS; b < Histogram::BUCKETS - 1; b++) {
+        double lower = Histogram::bucketLower(b);
+        widest = std::max(widest, (Histogram::bucketUpper(b) - lower + 1) / lower);
+    }
+    checks.expect(widest <= 0.125, "no bucket is wider than 12.5% of its lower bound",
+                  format("widest %.1f%%", widest * 100));
+
+    uint32_t last = Histogram::bucketLower(Histogram::BUCKETS - 1);
+    checks.expect(last == 15u << 20 && Histogram::bucketFor(last - 1) == Histogram::BUCKETS - 2 &&
+                  Histogram::bucketFor(1u << Histogram::MAX_EXP) == Histogram::BUCKETS - 1 &&
+                  Histogram::bucketFor(UINT32_MAX) == Histogram::BUCKETS - 1,
+                  "15 * 2^20 and above share the last bucket", format("from %.0f", last));
+    checks.expect(Histogram::bucketUpper(Histogram::BUCKETS - 1) == UINT32_MAX,
+                  "the last bucket is reported as le=\"+Inf\" (upper bound UINT32_MAX)");
+}
+
+static void checkObservations(Checks& checks) {
+    printf("\nObservations:\n");
+
+    // Log-uniform values, the spread of latencies in us and ms
+    HostRandom rng(11);
+    static Histogram h;
+    std::vector<uint32_t> values;
+    uint64_t sum = 0;
+    uint32_t perBucket[Histogram::BUCKETS] = {};
+    for (int i = 0; i < 20000; i++) {
+        uint32_t v = (uint32_t)pow(2.0, 20.0 * rng.uniform());
+        values.push_back(v);
+        sum += v;
+        perBucket[Histogram::bucketFor(v)]++;
+        h.observe(v);
+    }
+    checks.expect(h.total.load() == values.size(), "count is the number of observations",
+                  format("%.0f", h.total.load()));
+    checks.expect(h.sum.load() == (uint32_t)sum, "sum is the exact sum of the values",
+                  format("%.0f", h.sum.load()));
+
+    bool counts = true;
+    for (uint8_t b = 0; b < Histogram::BUCKETS; b++) {
+        counts = counts && h.counts[b].load() == perBucket[b];
+    }
+    checks.expect(counts, "each value is counted in the bucket holding it");
+
+    std::sort(values.begin(), values.end());
+    double worst = 0;
+    const float qs[] = { 0.5f, 0.9f, 0.99f };
+    for (float q : qs) {
+        uint32_t exactValue = values[(size_t)(q * (values.size() - 1))];
+        double error = fabs((double)h.quantile(q) - exactValue) / std::max<uint32_t>(exactValue, 1);
+        worst = std::max(worst, error);
+    }
+    checks.expect(worst <= 0.0625, "p50 / p90 / p99 within half a bucket (6.25%) of the exact quantile",
+                  format("worst %.2f%%", worst * 100));
+
+    static Histogram empty;
+    checks.expect(empty.quantile(0.5f) == 0, "an empty histogram reports 0");
+}
+
+static void checkConcurrency(Checks& checks, int threads, int updates) {
+    printf("\nConcurrent writers (%d threads, %d updates each):\n", threads, updates);
+
+    uint32_t countBefore = Metrics::get(NET_REQUESTS);
+    uint32_t bytesBefore = Metrics::get(NET_BYTES_SENT);
+    const Histogram& h = Metrics::histogram(NET_LATENCY_MS);
+    uint32_t totalBefore = h.total.load();
+    uint32_t sumBefore = h.sum.load();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([t, updates]() {
+            for (int i = 0; i < updates; i++) {
+                Metrics::inc(NET_REQUESTS);
+                Metrics::inc(NET_BYTES_SENT, 3);
+                Metrics::observe(NET_LATENCY_MS, (uint32_t)(t * 37 + i % 500));
+                Metrics::set(NET_RTT_MS, t);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    uint64_t expectedSum = 0;
+    for (int t = 0; t < threads; t++) {
+        for (int i = 0; i < updates; i++) {
+            expectedSum += (uint32_t)(t * 37 + i % 500);
+        }
+    }
+    uint32_t n = (uint32_t)threads * updates;
+    checks.expect(Metrics::get(NET_REQUESTS) - countBefore == n, "no counter increment is lost",
+                  format("%.0f of %.0f", Metrics::get(NET_REQUESTS) - countBefore, n));
+    checks.expect(Metrics::get(NET_BYTES_SENT) - bytesBefore == 3 * n, "increments by more than one add up",
+                  format("%.0f", Metrics::get(NET_BYTES_SENT) - bytesBefore));
+    checks.expect(h.total.load() - totalBefore == n, "no histogram observation is lost",
+                  format("%.0f of %.0f", h.total.load() - totalBefore, n));
+    checks.expect(h.sum.load() - sumBefore == (uint32_t)expectedSum, "the histogram sum matches");
+
+    uint32_t bucketTotal = 0;
+    for (uint8_t b = 0; b < Histogram::BUCKETS; b++) {
+        bucketTotal += h.counts[b].load();
+    }
+    checks.expect(bucketTotal == h.total.load(), "the buckets add up to the count");
+
+    int32_t rtt = Metrics::get(NET_RTT_MS);
+    checks.expect(rtt >= 0 && rtt < threads, "a gauge holds one writer's value, not a mix",
+                  format("%.0f", rtt));
+}
+
+// One sample line: name, labels in order, value
+struct Sample {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> labels;
+    std::string value;
+};
+
+static bool isNameChar(char c, bool first) {
+    return isalpha((unsigned char)c) || c == '_' || c == ':' || (!first && isdigit((unsigned char)c));
+}
+
+// name{label="value",...} value, as the text format allows it
+static bool parseSample(const std::string& line, Sample& sample) {
+    size_t i = 0;
+    while (i < line.size() && isNameChar(line[i], i == 0)) i++;
+    if (i == 0) return false;
+    sample.name = line.substr(0, i);
+    if (i < line.size() && line[i] == '{') {
+        i++;
+        while (i < line.size() && line[i] != '}') {
+            size_t start = i;
+            while (i < line.size() && isNameChar(line[i], i == start)) i++;
+            if (i == start || line.compare(i, 2, "=\"") != 0) return false;
+            std::string label = line.substr(start, i - start);
+            size_t close = line.find('"', i + 2);
+            if (close == std::string::npos) return false;
+            sample.labels.push_back({ label, line.substr(i + 2, close - i - 2) });
+            i = close + 1;
+            if (i < line.size() && line[i] == ',') i++;
+        }
+        if (i >= line.size()) return false;
+        i++;
+    }
+    if (i >= line.size() || line[i] != ' ') return false;
+    sample.value = line.substr(i + 1);
+    char* end = nullptr;
+    strtod(sample.value.c_str(), &end);
+    return !sample.value.empty() && (*end == '\0' || sample.value == "+Inf");
+}
+
+static void checkExposition(Checks& checks) {
+    printf("\nPrometheus export:\n");
+
+    // Labelled and bare histograms with observations in several buckets
+    for (uint32_t v : { 3u, 40u, 900u }) {
+        Metrics::observe(I2C_DISPLAY_US, v);
+        Metrics::observe(TLS_FULL_MS, v);
+        Metrics::observe(DISPLAY_FLUSH_US, v);
+    }
+    String text = Metrics::toPrometheus();
+
+    std::set<std::string> families;
+    std::string family;
+    std::string type;
+    int lines = 0;
+    int bad = 0;
+    std::string firstBad;
+    auto fail = [&](const std::string& line) {
+        if (bad++ == 0) firstBad = line;
+    };
+    std::string all(text.c_str());
+    size_t at = 0;
+    while (at < all.size()) {
+        size_t end = all.find('\n', at);
+        if (end == std::string::npos) end = all.size();
+        std::string line = all.substr(at, end - at);
+        at = end + 1;
+        lines++;
+
+        if (line.compare(0, 7, "# HELP ") == 0) {
+            family = line.substr(7, line.find(' ', 7) - 7);
+            continue;
+        }
+        if (line.compare(0, 7, "# TYPE ") == 0) {
+            // HELP and TYPE once per family, right before its samples
+            size_t space = line.find(' ', 7);
+            if (line.substr(7, space - 7) != family || !families.insert(family).second) fail(line);
+            type = line.substr(space + 1);
+            continue;
+        }
+
+        // Every sample belongs to the family above it; a histogram's carry
+        // its suffix on the bare name and le only on buckets
+        Sample sample;
+        if (!parseSample(line, sample)) {
+            fail(line);
+            continue;
+        }
+        bool hasLe = !sample.labels.empty() && sample.labels.back().first == "le";
+        bool ok;
+        if (type == "histogram") {
+            ok = (sample.name == family + "_bucket" && hasLe) ||
+                 ((sample.name == family + "_sum" || sample.name == family + "_count") && !hasLe);
+        } else {
+            ok = sample.name == family && !hasLe;
+        }
+        // Labels are unique, and device is left for the server's device id
+        for (const auto& label : sample.labels) {
+            ok = ok && label.first != "device" && std::count_if(sample.labels.begin(), sample.labels.end(),
+                                     [&](const std::pair<std::string, std::string>& other) { return other.first == label.first; }) == 1;
+        }
+        if (!ok) fail(line);
+    }
+    checks.expect(bad == 0, "every line is a HELP, TYPE or sample of the family above it",
+                  bad ? format("%.0f bad, first: ", bad) + firstBad : format("%.0f lines", lines));
+    checks.expect(text.indexOf("glasses_i2c_latency_us_bucket{peripheral=\"display\",le=\"3\"} 1\n") >= 0 &&
+                  text.indexOf("glasses_i2c_latency_us_sum{peripheral=\"display\"} 943\n") >= 0 &&
+                  text.indexOf("glasses_i2c_latency_us_count{peripheral=\"display\"} 3\n") >= 0,
+                  "a labelled histogram keeps its labels on _bucket (with le), _sum and _count");
+    checks.expect(text.indexOf("glasses_display_flush_us_bucket{le=\"+Inf\"} 3\n") >= 0 &&
+                  text.indexOf("glasses_display_flush_us_count 3\n") >= 0,
+                  "a histogram without labels has le alone");
+}
+
+int main(int argc, char** argv) {
+    int threads = 8;
+    int updates = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--updates") && i + 1 < argc) {
+            updates = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--threads N] [--updates N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (threads < 1 || updates < 1) {
+        fprintf(stderr, "--threads and --updates must be positive\n");
+        return 2;
+    }
+    Logger::setLogLevel(LOG_NONE);
+
+    Checks checks;
+    checkBuckets(checks);
+    checkObservations(checks);
+    checkConcurrency(checks, threads, updates);
+    checkExposition(checks);
+
+    if (checks.failed) {
+        printf("\n%d check(s) failed\n", checks.failed);
+        return 1;
+    }
+    printf("\nAll checks passed\n");
+    return 0;
+}
@@ -0,0 +1,1204 @@
+// Stream multiplexer harness (pio run -e native_mux).
+// Checks StreamMux framing, flow control, scheduling and resets between
+// two engines, and NetworkModule over MuxClient against an in-process
+// peer, then measures head-of-line blocking: a stretch of the glasses'
+// traffic (camera frames while watching, voice commands in audio chunks,
+// typed commands, the minutely metrics push) sent three ways over one
+// connection:
+// - serial: one request at a time, as the blocking HTTPClient calls go
+// - mux, one class: every request on its own stream, shared fairly
+// - mux: interactive ahead of bulk ahead of background
+// and reports how long commands, uploads and cancels took to get through.
+//
+// Usage: program [--minutes N] [--seed N] [--uplink-kbps N] [--rtt-ms N]
+//                [--server URL [--seconds N]]
+//
+// The peer is a server StreamMux with the stand-in's routes and service
+// times, behind a simulated link: the uplink rate, half the round trip each
+// way, and lwIP's send buffer on the device (TCP_SND_BUF), which no
+// priority can overtake. A request counts as sent when its last byte has
+// left through the uplink. Time is virtual. With --server, the same
+// traffic goes to scripts/standin_server.py's GET /mux for --seconds per
+// mode in real time, the writes paced to --uplink-kbps.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../load/socket_client.h"
+#include "../../firmware/modules/network_module.cpp"
+
+static const size_t SEND_BUFFER = 5744;         // lwIP TCP_SND_BUF on the S3
+static const uint32_t DOWNLINK_BPS = 20000000;
+static const double COMMAND_MS = 600;           // The stand-in's service times
+static const double AUDIO_MS = 900;
+static const double VISION_MS = 700;
+static const double SERVICE_SIGMA = 0.35;
+static const size_t TURN_BYTES = MUX_HEADER_BYTES + 1024 + 64;     // As MuxClient pumps
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(q * (values.size() - 1) + 0.5)];
+}
+
+static std::string rawFrame(uint8_t type, uint8_t flags, uint16_t stream, const std::string& payload) {
+    std::string frame(MUX_HEADER_BYTES, '\0');
+    frame[0] = type;
+    frame[1] = flags;
+    frame[2] = stream >> 8;
+    frame[3] = stream & 0xFF;
+    frame[4] = payload.size() >> 8;
+    frame[5] = payload.size() & 0xFF;
+    return frame + payload;
+}
+
+// Calls fn(type, flags, stream, payload length, end offset) for each whole frame in data
+template <typename Fn>
+static void eachFrame(const uint8_t* data, size_t length, Fn fn) {
+    size_t at = 0;
+    while (at + MUX_HEADER_BYTES <= length) {
+        const uint8_t* frame = data + at;
+        size_t payload = (size_t)frame[4] << 8 | frame[5];
+        at += MUX_HEADER_BYTES + payload;
+        fn(frame[0], frame[1], (uint16_t)(frame[2] << 8 | frame[3]), payload, at);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Two engines back to back
+
+struct Endpoint {
+    StreamMux mux;
+    std::map<uint16_t, std::string> bodies;     // DATA received per stream
+    std::map<uint16_t, std::string> heads;
+    std::map<uint16_t, bool> ended;
+    std::vector<uint16_t> resets;
+    bool answer = false;        // Replies "200" and the body's length when a request ends
+
+    explicit Endpoint(const StreamMuxConfig& config) : mux(config) {
+        mux.setCallback(onEvent, this);
+    }
+
+    static void onEvent(const MuxEvent& event, void* context) {
+        Endpoint* self = (Endpoint*)context;
+        switch (event.type) {
+            case MUX_HEADERS:
+                self->heads[event.stream] = std::string((const char*)event.data, event.length);
+                break;
+            case MUX_DATA:
+                self->bodies[event.stream].append((const char*)event.data, event.length);
+                break;
+            case MUX_RESET:
+                self->resets.push_back(event.stream);
+                return;
+            default:
+                return;
+        }
+        if (!event.end) return;
+        self->ended[event.stream] = true;
+        if (self->answer) {
+            std::string body = std::to_string(self->bodies[event.stream].size());
+            self->mux.respond(event.stream, "200\r\n", 5);
+            self->mux.write(event.stream, (const uint8_t*)body.c_str(), body.size(), true);
+        }
+    }
+};
+
+static StreamMuxConfig serverConfig() {
+    StreamMuxConfig config;
+    config.client = false;
+    return config;
+}
+
+// One poll of up to capacity bytes from one end into the other, in random
+// pieces; false if the receiver found a protocol error
+static bool transfer(Endpoint& from, Endpoint& to, HostRandom& rng, size_t capacity = 2048) {
+    std::vector<uint8_t> out(capacity);
+    size_t n = from.mux.poll(out.data(), capacity);
+    bool ok = true;
+    for (size_t at = 0; at < n;) {
+        size_t piece = 1 + rng.next() % 700;
+        if (piece > n - at) piece = n - at;
+        ok = to.mux.receive(out.data() + at, piece) && ok;
+        at += piece;
+    }
+    return ok;
+}
+
+static std::string pattern(size_t length, uint8_t seed) {
+    std::string data(length, '\0');
+    for (size_t i = 0; i < length; i++) data[i] = (char)(i * 31 + seed);
+    return data;
+}
+
+static void engine(Checks& checks, HostRandom& rng) {
+    {
+        // Three requests at once, sent and answered whole
+        Endpoint client{StreamMuxConfig()}, server{serverConfig()};
+        server.answer = true;
+        const MuxPriority priorities[] = { MUX_INTERACTIVE, MUX_BULK, MUX_BACKGROUND };
+        const size_t sizes[] = { 100, 50000, 5000 };
+        int32_t ids[3];
+        size_t written[3] = {};
+        std::string bodies[3];
+        for (int i = 0; i < 3; i++) {
+            std::string head = "POST /r" + std::to_string(i) + "\r\n";
+            ids[i] = client.mux.open(priorities[i], head.c_str(), head.size());
+            bodies[i] = pattern(sizes[i], i);
+        }
+        bool ok = true;
+        for (int turn = 0; turn < 2000; turn++) {
+            for (int i = 0; i < 3; i++) {
+                size_t n = std::min(client.mux.writable(ids[i]), sizes[i] - written[i]);
+                if (written[i] < sizes[i]) {
+                    written[i] += client.mux.write(ids[i], (const uint8_t*)bodies[i].data() + written[i], n,
+                                                   written[i] + n == sizes[i]);
+                }
+            }
+            ok = transfer(client, server, rng, 64 + rng.next() % 2000) && ok;
+            ok = transfer(server, client, rng) && ok;
+        }
+        bool intact = true, answered = true;
+        for (int i = 0; i < 3; i++) {
+            intact = intact && server.bodies[ids[i]] == bodies[i] && server.ended[ids[i]];
+            answered = answered && client.heads[ids[i]] == "200\r\n" && client.bodies[ids[i]] == std::to_string(sizes[i]);
+        }
+        checks.expect(ok && intact && answered, "three concurrent requests arrive intact and are answered",
+                      format("%.0f, %.0f and %.0f bytes, any split", sizes[0], sizes[1], sizes[2]));
+        checks.expect(client.mux.activeStreams() == 0 && server.mux.activeStreams() == 0,
+                      "every stream slot is free again on both ends");
+    }
+    {
+        // The server stops reading one stream: only that stream waits
+        StreamMuxConfig manual = serverConfig();
+        manual.autoCredit = false;
+        Endpoint client{StreamMuxConfig()}, server{manual};
+        int32_t a = client.mux.open(MUX_BULK, "POST /a\r\n", 9);
+        int32_t b = client.mux.open(MUX_BULK, "POST /b\r\n", 9);
+        std::string bodyA = pattern(40000, 1), bodyB = pattern(4000, 2);
+        size_t sentA = 0, sentB = 0;
+        auto run = [&](int turns) {
+            for (int turn = 0; turn < turns; turn++) {
+                size_t n = std::min(client.mux.writable(a), bodyA.size() - sentA);
+                if (sentA < bodyA.size()) sentA += client.mux.write(a, (const uint8_t*)bodyA.data() + sentA, n, sentA + n == bodyA.size());
+                n = std::min(client.mux.writable(b), bodyB.size() - sentB);
+                if (sentB < bodyB.size()) sentB += client.mux.write(b, (const uint8_t*)bodyB.data() + sentB, n, sentB + n == bodyB.size());
+                transfer(client, server, rng);
+                transfer(server, client, rng);
+            }
+        };
+        run(200);
+        size_t beforeConsume = server.bodies[a].size();
+        checks.expect(beforeConsume == MUX_STREAM_WINDOW && server.ended[b] && server.bodies[b] == bodyB,
+                      "a stream the receiver does not read stops at its window, the other completes",
+                      format("%.0f bytes of the stalled stream", beforeConsume));
+        checks.expect(client.mux.getStats().creditStalls > 0, "the sender counts the credit stalls");
+        for (int turn = 0; turn < 100 && !server.ended[a]; turn++) {
+            server.mux.consume(a, MUX_STREAM_WINDOW);
+            run(5);
+        }
+        checks.expect(server.ended[a] && server.bodies[a] == bodyA, "the stalled stream completes once it is read");
+    }
+    {
+        // An interactive request overtakes queued bulk data
+        Endpoint client{StreamMuxConfig()};
+        int32_t bulk = client.mux.open(MUX_BULK, "POST /audio\r\n", 13);
+        std::string body = pattern(8192, 3);
+        client.mux.write(bulk, (const uint8_t*)body.data(), body.size(), false);
+        uint8_t out[4096];
+        client.mux.poll(out, TURN_BYTES);
+        int32_t command = client.mux.open(MUX_INTERACTIVE, "POST /\r\n", 8);
+        client.mux.write(command, (const uint8_t*)"{\"command\":\"stop\"}", 18, true);
+        size_t n = client.mux.poll(out, 3 * TURN_BYTES);
+        std::vector<uint16_t> order;
+        eachFrame(out, n, [&](uint8_t, uint8_t, uint16_t stream, size_t, size_t) { order.push_back(stream); });
+        bool first = order.size() >= 3 && order[0] == command && order[1] == command && order[2] == bulk;
+        checks.expect(first, "a command's HEADERS and DATA go ahead of the queued audio",
+                      format("%.0f frames in the next poll", order.size()));
+    }
+    {
+        // Two bulk streams share evenly; background waits while they send
+        Endpoint client{StreamMuxConfig()};
+        int32_t one = client.mux.open(MUX_BULK, "POST /audio\r\n", 13);
+        int32_t two = client.mux.open(MUX_BULK, "POST /vision/describe\r\n", 23);
+        int32_t low = client.mux.open(MUX_BACKGROUND, "POST /telemetry/metrics\r\n", 25);
+        std::string body = pattern(8192, 4);
+        client.mux.write(one, (const uint8_t*)body.data(), body.size(), false);
+        client.mux.write(two, (const uint8_t*)body.data(), body.size(), false);
+        client.mux.write(low, (const uint8_t*)body.data(), 2000, true);
+        std::map<uint16_t, size_t> served;
+        uint8_t out[4096];
+        for (int i = 0; i < 12; i++) {
+            size_t n = client.mux.poll(out, MUX_HEADER_BYTES + 1024);
+            eachFrame(out, n, [&](uint8_t type, uint8_t, uint16_t stream, size_t payload, size_t) {
+                if (type == MUX_DATA) served[stream] += payload;
+            });
+        }
+        double gap = fabs((double)served[one] - (double)served[two]);
+        checks.expect(gap <= 1024 && served[low] == 0, "two bulk streams share within a frame, background data waits",
+                      format("%.0f and %.0f bytes, background %.0f", served[one], served[two], served[low]));
+    }
+    {
+        // A background request opened before a command: the server must
+        // see its id first, or it takes the stream for one already closed
+        Endpoint client{StreamMuxConfig()}, server{serverConfig()};
+        int32_t low = client.mux.open(MUX_BACKGROUND, "POST /telemetry/metrics\r\n", 25);
+        int32_t command = client.mux.open(MUX_INTERACTIVE, "POST /\r\n", 8);
+        std::string body = pattern(3000, 6);
+        client.mux.write(low, (const uint8_t*)body.data(), body.size(), true);
+        client.mux.write(command, (const uint8_t*)body.data(), 100, true);
+        for (int turn = 0; turn < 10; turn++) transfer(client, server, rng, TURN_BYTES);
+        checks.expect(server.ended[low] && server.ended[command] && server.bodies[low] == body,
+                      "streams reach the server whatever order their data goes in");
+    }
+    {
+        // A reset overtakes everything, purges the stream's data, and the
+        // peer forgets the stream
+        Endpoint client{StreamMuxConfig()}, server{serverConfig()};
+        int32_t upload = client.mux.open(MUX_BULK, "POST /vision/describe\r\n", 23);
+        int32_t other = client.mux.open(MUX_BULK, "POST /audio\r\n", 13);
+        std::string body = pattern(8192, 5);
+        client.mux.write(upload, (const uint8_t*)body.data(), body.size(), false);
+        client.mux.write(other, (const uint8_t*)body.data(), body.size(), false);
+        transfer(client, server, rng, TURN_BYTES);
+        client.mux.reset(upload);
+        uint8_t out[8192];
+        size_t n = client.mux.poll(out, sizeof(out));
+        bool resetFirst = n > 0 && out[0] == MUX_RESET && ((uint16_t)out[2] << 8 | out[3]) == upload;
+        bool purged = true;
+        eachFrame(out, n, [&](uint8_t type, uint8_t, uint16_t stream, size_t, size_t) {
+            if (type == MUX_DATA && stream == upload) purged = false;
+        });
+        server.mux.receive(out, n);
+        checks.expect(resetFirst && purged, "a reset goes out first and none of the stream's data follows");
+        checks.expect(server.resets.size() == 1 && !server.mux.isOpen(upload) && !client.mux.isOpen(upload),
+                      "both ends drop the reset stream");
+        std::string late = rawFrame(MUX_DATA, MUX_END, upload, "late reply");
+        bool ignored = client.mux.receive((const uint8_t*)late.data(), late.size()) && !client.mux.isFailed();
+        checks.expect(ignored, "a reply that crossed the reset is dropped without an error");
+        uint32_t resetsBefore = client.mux.getStats().resetsSent;
+        int32_t unsent = client.mux.open(MUX_BULK, "POST /audio\r\n", 13);
+        client.mux.reset(unsent);
+        checks.expect(client.mux.poll(out, sizeof(out)) >= 0 && client.mux.getStats().resetsSent == resetsBefore &&
+                      !client.mux.isOpen(unsent), "a stream reset before its head went out costs no frame");
+    }
+    {
+        // Protocol errors end the connection with GOAWAY
+        Endpoint server{serverConfig()};
+        std::string frames = rawFrame(MUX_HEADERS, 0, 1, std::string(1, MUX_BULK) + "POST /audio\r\n");
+        for (int i = 0; i < 5; i++) frames += rawFrame(MUX_DATA, 0, 1, std::string(4000, 'x'));
+        bool refused = !server.mux.receive((const uint8_t*)frames.data(), frames.size());
+        uint8_t out[64];
+        size_t n = server.mux.poll(out, sizeof(out));
+        checks.expect(refused && server.mux.isFailed() && n == MUX_HEADER_BYTES + 1 && out[0] == MUX_GOAWAY &&
+                      out[6] == MUX_PROTOCOL_ERROR, "data beyond the window fails the connection with GOAWAY");
+
+        Endpoint other{serverConfig()};
+        std::string even = rawFrame(MUX_HEADERS, 0, 2, std::string(1, MUX_BULK) + "POST /\r\n");
+        std::string data = rawFrame(MUX_DATA, 0, 2, "x");
+        other.mux.receive((const uint8_t*)even.data(), even.size());
+        bool stray = other.mux.receive((const uint8_t*)data.data(), data.size());
+        checks.expect(stray && other.mux.activeStreams() == 0, "a stream with the server's parity is not opened");
+    }
+    {
+        // More streams than slots: the extra one is refused, not processed
+        Endpoint server{serverConfig()};
+        std::string frames;
+        for (uint16_t id = 1; id <= 2 * StreamMux::MAX_STREAMS + 1; id += 2) {
+            frames += rawFrame(MUX_HEADERS, 0, id, std::string(1, MUX_BULK) + "POST /audio\r\n");
+        }
+        server.mux.receive((const uint8_t*)frames.data(), frames.size());
+        uint8_t out[64];
+        size_t n = server.mux.poll(out, sizeof(out));
+        bool refused = n == MUX_HEADER_BYTES + 1 && out[0] == MUX_RESET && out[3] == 2 * StreamMux::MAX_STREAMS + 1 &&
+                       out[6] == MUX_REFUSED;
+        checks.expect(refused && server.heads.size() == StreamMux::MAX_STREAMS,
+                      "a ninth concurrent stream is refused");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// The peer: the stand-in's routes behind a simulated link
+
+class SimLink : public HostSocket {
+public:
+    SimLink(uint32_t uplinkBps, uint32_t roundTripMs, size_t sendBuffer, uint64_t seed, bool speaksMux = true)
+        : uplinkBps(uplinkBps), oneWayUs((uint64_t)roundTripMs * 500), sendBuffer(sendBuffer),
+          speaksMux(speaksMux), server(serverConfig()), rng(seed) {
+        server.setCallback(onEvent, this);
+        clockUs = micros() / 1000 * 1000;
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        if (!open) return 0;
+        size_t n = std::min(length, sendBuffer - uplink.size());
+        uplink.insert(uplink.end(), data, data + n);
+        return n;
+    }
+
+    size_t read(uint8_t* data, size_t length) override {
+        size_t n = std::min(length, received.size());
+        std::copy(received.begin(), received.begin() + n, data);
+        received.erase(received.begin(), received.begin() + n);
+        return n;
+    }
+
+    size_t available() override {
+        return received.size();
+    }
+
+    bool connected() override {
+        return open || !received.empty();
+    }
+
+    void close() override {
+        open = false;
+    }
+
+    // The server ends the connection
+    void drop() {
+        open = false;
+        received.clear();
+    }
+
+    // Moves the link on to nowUs, a millisecond at a time
+    void advance(uint64_t nowUs) {
+        while (clockUs + 1000 <= nowUs) {
+            clockUs += 1000;
+            step();
+        }
+    }
+
+    // Bytes that have left the device through the uplink
+    uint64_t departed() const {
+        return departedBytes;
+    }
+
+    uint32_t streamsServed = 0;
+    uint32_t resetsSeen = 0;
+    uint32_t protocolErrors = 0;
+
+private:
+    struct Flight {
+        uint64_t arrivalUs;
+        std::string bytes;
+    };
+
+    struct Pending {
+        std::string head;
+        std::string body;
+        uint64_t dueUs = 0;
+        bool ended = false;
+        bool hang = false;
+    };
+
+    uint32_t uplinkBps;
+    uint64_t oneWayUs;
+    size_t sendBuffer;
+    bool speaksMux;
+    bool open = true;
+    bool upgraded = false;
+    std::string handshake;
+    std::deque<uint8_t> uplink;             // The device's send buffer
+    std::deque<Flight> upFlight, downFlight;
+    std::deque<uint8_t> received;
+    double uplinkCredit = 0;
+    uint64_t departedBytes = 0;
+    uint64_t downFreeUs = 0;
+    uint64_t clockUs;
+    StreamMux server;
+    HostRandom rng;
+    std::map<uint16_t, Pending> requests;
+
+    void step() {
+        if (!uplink.empty()) {
+            uplinkCredit += uplinkBps / 8000.0;
+            size_t n = std::min((size_t)uplinkCredit, uplink.size());
+            uplinkCredit -= n;
+            if (n > 0) {
+                upFlight.push_back({ clockUs + oneWayUs, std::string(uplink.begin(), uplink.begin() + n) });
+                uplink.erase(uplink.begin(), uplink.begin() + n);
+                departedBytes += n;
+            }
+            if (uplink.empty()) uplinkCredit = 0;
+        }
+        while (!upFlight.empty() && upFlight.front().arrivalUs <= clockUs) {
+            arrive(upFlight.front().bytes);
+            upFlight.pop_front();
+        }
+        for (auto& entry : requests) {
+            if (entry.second.ended && !entry.second.hang && entry.second.dueUs <= clockUs) {
+                answer(entry.first, entry.second);
+            }
+        }
+        for (auto it = requests.begin(); it != requests.end();) {
+            it = it->second.dueUs == UINT64_MAX ? requests.erase(it) : std::next(it);
+        }
+        if (upgraded) {
+            uint8_t out[16384];
+            size_t n;
+            while ((n = server.poll(out, sizeof(out))) > 0) {
+                sendDown(std::string((const char*)out, n));
+            }
+        }
+        while (!downFlight.empty() && downFlight.front().arrivalUs <= clockUs) {
+            if (open) received.insert(received.end(), downFlight.front().bytes.begin(), downFlight.front().bytes.end());
+            downFlight.pop_front();
+        }
+    }
+
+    void sendDown(const std::string& bytes) {
+        uint64_t start = std::max(clockUs, downFreeUs);
+        downFreeUs = start + (uint64_t)bytes.size() * 8 * 1000000 / DOWNLINK_BPS;
+        downFlight.push_back({ downFreeUs + oneWayUs, bytes });
+    }
+
+    void arrive(const std::string& bytes) {
+        if (upgraded) {
+            if (!server.receive((const uint8_t*)bytes.data(), bytes.size())) protocolErrors++;
+            return;
+        }
+        handshake += bytes;
+        size_t end = handshake.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+        bool asked = handshake.compare(0, 9, "GET /mux ") == 0 && handshake.find("Upgrade: glasses-mux") < end;
+        if (!asked || !speaksMux) {
+            sendDown("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+            return;
+        }
+        sendDown("HTTP/1.1 101 Switching Protocols\r\nUpgrade: glasses-mux/1\r\nConnection: Upgrade\r\n\r\n");
+        upgraded = true;
+        std::string rest = handshake.substr(end + 4);
+        if (!rest.empty()) arrive(rest);
+    }
+
+    static void onEvent(const MuxEvent& event, void* context) {
+        SimLink* self = (SimLink*)context;
+        if (event.type == MUX_RESET) {
+            self->resetsSeen++;
+            self->requests.erase(event.stream);
+            return;
+        }
+        if (event.type != MUX_HEADERS && event.type != MUX_DATA) return;
+        Pending& request = self->requests[event.stream];
+        if (event.type == MUX_HEADERS) {
+            request.head = std::string((const char*)event.data, event.length);
+        } else {
+            request.body.append((const char*)event.data, event.length);
+        }
+        if (event.end) {
+            request.ended = true;
+            self->schedule(request);
+        }
+    }
+
+    void schedule(Pending& request) {
+        double ms = 0;
+        if (request.head.compare(0, 7, "POST /\r") == 0) {
+            ms = rng.logNormal(COMMAND_MS, SERVICE_SIGMA);
+        } else if (request.head.compare(0, 12, "POST /audio\r") == 0) {
+            ms = request.head.find("X-Audio-Final: 0") != std::string::npos ? 0 : rng.logNormal(AUDIO_MS, SERVICE_SIGMA);
+        } else if (request.head.compare(0, 22, "POST /vision/describe\r") == 0) {
+            ms = rng.logNormal(VISION_MS, SERVICE_SIGMA);
+        } else if (request.head.compare(0, 10, "POST /hang") == 0) {
+            request.hang = true;
+        }
+        request.dueUs = clockUs + (uint64_t)(ms * 1000);
+    }
+
+    void answer(uint16_t stream, Pending& request) {
+        std::string head = "200\r\nContent-Type: application/json\r\nDate: Mon, 19 Oct 2026 12:00:00 GMT\r\n";
+        std::string body = "{\"status\":\"ok\"}";
+        if (request.head.compare(0, 7, "POST /\r") == 0) {
+            StaticJsonDocument<256> doc;
+            deserializeJson(doc, request.body);
+            String command = doc["command"] | "";
+            body = std::string("{\"response\":\"Stand-in answer to '") + command.c_str() + "'\"}";
+            head += "Cache-Control: max-age=3600\r\n";
+        } else if (request.head.compare(0, 22, "POST /vision/describe\r") == 0) {
+            size_t start = request.body.find("\xFF\xD8"), end = request.body.rfind("\xFF\xD9");
+            if (start == std::string::npos || end == std::string::npos || end < start) {
+                head.replace(0, 3, "400");
+                body = "{\"detail\":\"image_file must be a JPEG\"}";
+            } else {
+                body = "{\"description\":\"Stand-in description of " + std::to_string(end + 2 - start) +
+                       " bytes of JPEG\"}";
+            }
+        } else if (request.head.compare(0, 12, "POST /audio\r") == 0 &&
+                   request.head.find("X-Audio-Final: 0") == std::string::npos) {
+            body = "{\"status\":\"ok\",\"transcript\":\"what time is it\"}";
+        }
+        server.respond(stream, head.c_str(), head.size());
+        server.write(stream, (const uint8_t*)body.data(), body.size(), true);
+        streamsServed++;
+        request.dueUs = UINT64_MAX;     // Answered; erased after the sweep
+    }
+};
+
+// The real stand-in, paced to the uplink rate
+class SocketLink : public HostSocket {
+public:
+    SocketLink(const std::string& url, uint32_t uplinkBps) : uplinkBps(uplinkBps) {
+        SocketUrl parsed;
+        open = parsed.parse(url) && connection.open(parsed, 3000) == 0;
+        lastUs = micros();
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        if (!open) return 0;
+        uint64_t now = micros();
+        tokens = std::min(tokens + (double)(now - lastUs) * uplinkBps / 8e6, (double)TURN_BYTES);
+        lastUs = now;
+        size_t n = std::min(length, (size_t)tokens);
+        if (n > 0 && !connection.writeAll(data, n)) open = false;
+        tokens -= n;
+        departedBytes += n;
+        return n;
+    }
+
+    size_t read(uint8_t* data, size_t length) override {
+        fill();
+        size_t n = std::min(length, received.size());
+        memcpy(data, received.data(), n);
+        received.erase(0, n);
+        return n;
+    }
+
+    size_t available() override {
+        fill();
+        return received.size();
+    }
+
+    bool connected() override {
+        return open || !received.empty();
+    }
+
+    void close() override {
+        connection.close();
+        open = false;
+    }
+
+    uint64_t departed() const {
+        return departedBytes;
+    }
+
+private:
+    SocketConnection connection;
+    uint32_t uplinkBps;
+    bool open = false;
+    double tokens = 0;
+    uint64_t lastUs = 0;
+    uint64_t departedBytes = 0;
+    std::string received;
+
+    void fill() {
+        if (!open) return;
+        bool closed = false;
+        connection.extendDeadline(0);       // Whatever is there, without waiting
+        if (connection.readSome(received, closed) && closed) open = false;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// NetworkModule over MuxClient
+
+static std::shared_ptr<SimLink> currentLink;
+
+static void connectTo(bool speaksMux, uint32_t uplinkBps, uint32_t roundTripMs, uint64_t seed) {
+    HostSockets::setConnector([=](const String&, uint16_t) {
+        currentLink = std::make_shared<SimLink>(uplinkBps, roundTripMs, SEND_BUFFER, seed, speaksMux);
+        std::weak_ptr<SimLink> link = currentLink;
+        HostClock::setAdvanceHook([link](uint64_t, uint64_t toUs) {
+            if (auto l = link.lock()) l->advance(toUs);
+        });
+        return std::static_pointer_cast<HostSocket>(currentLink);
+    });
+}
+
+static void networkModule(Checks& checks, uint64_t seed) {
+    uint32_t httpRequests = 0;
+    HostHttp::setHandler([&httpRequests](const HostHttpRequest& request) {
+        HostHttpResponse response;
+        response.body = "{\"response\":\"over HTTP\"}";
+        response.latencyMs = 600;
+        httpRequests++;
+        return response;
+    });
+    connectTo(true, 1000000, 40, seed);
+
+    NetworkModule network;
+    network.connect("stand-in", "");
+    network.setServer("http://stand-in:8000");
+    network.maintain();
+    checks.expect(network.isMultiplexed(), "NetworkModule upgrades its connection at the first maintain()");
+
+    String answer = network.sendCommand("what time is it");
+    checks.expect(answer == "Stand-in answer to 'what time is it'" && httpRequests == 0,
+                  "a command goes over the multiplexed connection", answer.c_str());
+    bool pushed = network.postMetrics();
+    static uint8_t jpeg[3000];
+    memset(jpeg, 0x55, sizeof(jpeg));
+    jpeg[0] = 0xFF; jpeg[1] = 0xD8; jpeg[sizeof(jpeg) - 2] = 0xFF; jpeg[sizeof(jpeg) - 1] = 0xD9;
+    String description = network.sendImage("/vision/describe", jpeg, sizeof(jpeg), "");
+    checks.expect(pushed && description.indexOf("3000 bytes") >= 0 && httpRequests == 0 &&
+                  currentLink->streamsServed == 3, "metrics and a camera frame share the same connection",
+                  format("%.0f streams on one connection", currentLink->streamsServed));
+
+    {
+        MuxClient client;
+        client.connect("http://stand-in:8000");
+        MuxReply reply;
+        unsigned long startMs = millis();
+        int code = client.request(MUX_INTERACTIVE, "POST /hang\r\n", (const uint8_t*)"{}", 2, nullptr, reply, 500);
+        unsigned long waitedMs = millis() - startMs;
+        for (int i = 0; i < 100; i++) {
+            client.service();
+            delay(1);
+        }
+        checks.expect(code == HTTPC_ERROR_READ_TIMEOUT && currentLink->resetsSeen == 1 && waitedMs < 700,
+                      "a request without a reply times out and is reset at the server",
+                      format("%.0f ms", waitedMs));
+        client.close();
+    }
+
+    network.setServer("http://stand-in:8000");
+    network.maintain();
+    currentLink->drop();
+    network.maintain();
+    bool dropped = !network.isMultiplexed();
+    answer = network.sendCommand("are you there");
+    bool overHttp = answer == "over HTTP" && httpRequests == 1;
+    for (int i = 0; i < 70 && !network.isMultiplexed(); i++) {
+        delay(100);
+        network.maintain();
+    }
+    checks.expect(dropped && overHttp && network.isMultiplexed(),
+                  "after the server drops the connection, HTTP until it is back a few seconds later");
+
+    connectTo(false, 1000000, 40, seed);
+    NetworkModule older;
+    older.setServer("http://stand-in:8000");
+    older.maintain();
+    answer = older.sendCommand("hello");
+    checks.expect(!older.isMultiplexed() && answer == "over HTTP" && httpRequests == 2,
+                  "a server without /mux is used over HTTP as before");
+
+    HostSockets::setConnector(nullptr);
+    HostClock::setAdvanceHook(nullptr);
+    currentLink = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Head-of-line blocking
+
+enum Kind { KIND_COMMAND, KIND_AUDIO, KIND_VISION, KIND_TELEMETRY, KIND_COUNT };
+static const MuxPriority KIND_PRIORITY[KIND_COUNT] = { MUX_INTERACTIVE, MUX_BULK, MUX_BULK, MUX_BACKGROUND };
+
+enum Policy { POLICY_SERIAL, POLICY_FLAT, POLICY_PRIORITY, POLICY_COUNT };
+static const char* POLICY_NAMES[POLICY_COUNT] = { "serial", "mux, one class", "mux" };
+
+struct Request {
+    Kind kind;
+    std::string head;
+    std::string body;
+    uint64_t submitUs = UINT64_MAX;     // Unset: submitted when another one's reply comes
+    uint64_t cancelUs = 0;              // 0: never cancelled
+    int follow = -1;                    // Submitted when this one's reply comes
+};
+
+// What happened to a request in one run
+struct Outcome {
+    bool waiting = false;
+    bool started = false;
+    bool cancelled = false;
+    bool replied = false;
+    bool headSent = false;
+    bool contended = false;             // Other requests were in progress when it came
+    int32_t stream = -1;
+    size_t written = 0;
+    uint64_t submitUs = UINT64_MAX;
+    uint64_t endOffset = UINT64_MAX;    // Uplink byte offset of its last frame
+    uint64_t resetOffset = UINT64_MAX;
+    uint64_t sentUs = 0;
+    uint64_t cancelDoneUs = 0;
+    uint64_t replyUs = 0;
+    int code = 0;
+};
+
+static std::string jpegUpload(size_t length, HostRandom& rng) {
+    std::string jpeg(length, '\0');
+    for (size_t i = 0; i < length; i++) jpeg[i] = (char)(rng.next() & 0x7F);
+    jpeg[0] = '\xFF'; jpeg[1] = '\xD8'; jpeg[length - 2] = '\xFF'; jpeg[length - 1] = '\xD9';
+    return "--glasses\r\nContent-Disposition: form-data; name=\"image_file\"; filename=\"frame.jpg\"\r\n"
+           "Content-Type: image/jpeg\r\n\r\n" + jpeg + "\r\n--glasses--\r\n";
+}
+
+static std::string commandBody(HostRandom& rng) {
+    size_t length = 60 + rng.next() % 141;
+    std::string text = "{\"command\":\"";
+    while (text.size() + 2 < length) text += (char)('a' + rng.next() % 26);
+    return text + "\"}";
+}
+
+// Seeded, the same for every policy
+static std::vector<Request> makeWorkload(uint64_t durationMs, HostRandom& rng) {
+    std::vector<Request> requests;
+    for (uint64_t t = 2000; t < durationMs; t += 2000) {
+        // Watching: a look every 2 s, a frame sent when the scene changed
+        if (rng.uniform() >= 0.35) continue;
+        Request r;
+        r.kind = KIND_VISION;
+        r.head = "POST /vision/describe\r\nContent-Type: multipart/form-data; boundary=glasses\r\n";
+        size_t length = rng.uniform() < 0.3 ? 60000 + rng.next() % 50000 : 8000 + rng.next() % 22000;
+        r.body = jpegUpload(length, rng);
+        r.submitUs = t * 1000;
+        if (rng.uniform() < 0.15) r.cancelUs = r.submitUs + (uint64_t)(100 + rng.uniform() * 500) * 1000;
+        requests.push_back(r);
+    }
+    uint32_t session = 0;
+    for (double t = rng.exponential(20000); t < durationMs; t += 2000 + rng.exponential(20000)) {
+        // A voice command: 16 KB chunks every 500 ms, then the transcript as a command
+        session++;
+        for (int chunk = 0; chunk < 4; chunk++) {
+            Request r;
+            r.kind = KIND_AUDIO;
+            r.head = "POST /audio\r\nContent-Type: application/octet-stream\r\nX-Audio-Session: " +
+                     std::to_string(session) + "\r\nX-Audio-Seq: " + std::to_string(chunk) +
+                     "\r\nX-Audio-Final: " + (chunk == 3 ? "1" : "0") + "\r\n";
+            r.body = std::string(16000, '\0');
+            for (char& c : r.body) c = (char)rng.next();
+            r.submitUs = (uint64_t)(t + 500 * (chunk + 1)) * 1000;
+            requests.push_back(r);
+        }
+        requests.back().follow = requests.size();
+        Request command;
+        command.kind = KIND_COMMAND;
+        command.head = "POST /\r\nContent-Type: application/json\r\n";
+        command.body = commandBody(rng);
+        requests.push_back(command);
+    }
+    for (double t = rng.exponential(15000); t < durationMs; t += rng.exponential(15000)) {
+        // Typed or cached-transcript commands
+        Request r;
+        r.kind = KIND_COMMAND;
+        r.head = "POST /\r\nContent-Type: application/json\r\n";
+        r.body = commandBody(rng);
+        r.submitUs = (uint64_t)t * 1000;
+        requests.push_back(r);
+    }
+    for (uint64_t t = 60000; t < durationMs; t += 60000) {
+        Request r;
+        r.kind = KIND_TELEMETRY;
+        r.head = "POST /telemetry/metrics\r\nContent-Type: text/plain\r\n";
+        r.body = std::string(3000 + rng.next() % 2000, 'm');
+        r.submitUs = t * 1000;
+        requests.push_back(r);
+    }
+    return requests;
+}
+
+struct Run {
+    const char* name;
+    std::vector<double> sentMs[KIND_COUNT];     // Submitted to last byte out
+    std::vector<double> replyMs[KIND_COUNT];    // Submitted to whole reply
+    std::vector<double> contendedMs;            // Commands that came while others were in progress
+    std::vector<double> cancelMs;               // Cancel to the connection free of the upload
+    size_t answered = 0;
+    size_t expected = 0;
+    size_t errors = 0;
+    bool failed = false;
+    double seconds = 0;
+    double kb = 0;
+};
+
+// Drives one policy: requests go onto streams as they come (one at a time
+// when serial) and the engine is pumped a turn per millisecond, as
+// MuxClient does
+class Driver {
+public:
+    typedef std::function<uint64_t()> Counter;
+
+    Driver(const std::vector<Request>& requests, Policy policy, HostSocket& link, Counter departed,
+           std::function<void()> tick)
+        : requests(requests), outcomes(requests.size()), policy(policy), link(link), departed(departed), tick(tick) {
+        mux.setCallback(onEvent, this);
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (requests[i].submitUs != UINT64_MAX) arrivals.push_back(i);
+        }
+        std::stable_sort(arrivals.begin(), arrivals.end(),
+                         [&](size_t a, size_t b) { return requests[a].submitUs < requests[b].submitUs; });
+    }
+
+    // The client side of the upgrade; false if the server does not speak it
+    bool upgrade(uint32_t timeoutMs) {
+        std::string request = "GET /mux HTTP/1.1\r\nHost: stand-in\r\nConnection: Upgrade\r\n"
+                              "Upgrade: glasses-mux/1\r\n\r\n";
+        size_t written = 0;
+        std::string head;
+        unsigned long startMs = millis();
+        while (millis() - startMs < timeoutMs) {
+            if (written < request.size()) {
+                written += link.write((const uint8_t*)request.data() + written, request.size() - written);
+            }
+            uint8_t c;
+            while (head.find("\r\n\r\n") == std::string::npos && link.read(&c, 1) == 1) head += (char)c;
+            if (head.find("\r\n\r\n") != std::string::npos) return head.compare(0, 12, "HTTP/1.1 101") == 0;
+            tick();
+        }
+        return false;
+    }
+
+    // Submits what is due until endMs, then lets the rest finish, for up
+    // to drainMs more
+    void run(uint32_t endMs, uint32_t drainMs) {
+        baseUs = micros();
+        while (!mux.isFailed() && link.connected()) {
+            uint64_t now = micros() - baseUs;
+            if (now >= (uint64_t)(endMs + drainMs) * 1000 || (now >= (uint64_t)endMs * 1000 && idle())) break;
+            submit(now);
+            cancel(now);
+            start();
+            feed();
+            pump();
+            settle(now);
+            tick();
+        }
+    }
+
+    Run result(const char* name) const {
+        Run run;
+        run.name = name;
+        for (size_t i = 0; i < requests.size(); i++) {
+            const Outcome& o = outcomes[i];
+            if (o.submitUs == UINT64_MAX) continue;
+            if (o.cancelled) {
+                if (o.cancelDoneUs != 0) run.cancelMs.push_back((o.cancelDoneUs - cancelAt(i)) / 1000.0);
+                continue;
+            }
+            run.expected++;
+            if (!o.replied) continue;
+            run.answered++;
+            if (o.code != 200) run.errors++;
+            run.sentMs[requests[i].kind].push_back((o.sentUs - o.submitUs) / 1000.0);
+            if (o.contended && requests[i].kind == KIND_COMMAND) run.contendedMs.push_back((o.sentUs - o.submitUs) / 1000.0);
+            run.replyMs[requests[i].kind].push_back((o.replyUs - o.submitUs) / 1000.0);
+        }
+        run.failed = mux.isFailed();
+        run.seconds = (micros() - baseUs) / 1e6;
+        run.kb = departed() / 1000.0;
+        return run;
+    }
+
+private:
+    StreamMux mux;
+    const std::vector<Request>& requests;
+    std::vector<Outcome> outcomes;
+    Policy policy;
+    HostSocket& link;
+    Counter departed;
+    std::function<void()> tick;
+    std::vector<size_t> arrivals;       // By submit time
+    size_t nextArrival = 0;
+    std::deque<size_t> waiting;         // Submitted, not on a stream yet
+    std::map<uint16_t, size_t> streams; // Stream id to request, for the whole run
+    std::vector<size_t> watched;        // Started, not yet out or not yet cancelled
+    size_t busy = 0;                    // Requests on a stream, waiting for their reply
+    uint64_t baseUs = 0;
+    uint8_t outbox[MUX_HEADER_BYTES + MUX_MAX_PAYLOAD];
+    size_t outboxFill = 0;
+    size_t outboxSent = 0;
+    uint64_t handed = 0;                // Bytes given to the link
+
+    bool idle() const {
+        return nextArrival == arrivals.size() && waiting.empty() && busy == 0;
+    }
+
+    uint64_t cancelAt(size_t i) const {
+        return outcomes[i].submitUs + (requests[i].cancelUs - requests[i].submitUs);
+    }
+
+    void enqueue(size_t i, uint64_t now) {
+        outcomes[i].contended = busy > 0 || !waiting.empty();
+        outcomes[i].waiting = true;
+        outcomes[i].submitUs = now;
+        waiting.push_back(i);
+    }
+
+    void submit(uint64_t now) {
+        while (nextArrival < arrivals.size() && requests[arrivals[nextArrival]].submitUs <= now) {
+            size_t i = arrivals[nextArrival++];
+            enqueue(i, requests[i].submitUs);
+        }
+    }
+
+    void cancel(uint64_t now) {
+        for (size_t n = 0; n < nextArrival; n++) {
+            size_t i = arrivals[n];
+            Outcome& o = outcomes[i];
+            if (requests[i].cancelUs == 0 || cancelAt(i) > now || o.cancelled || o.replied) continue;
+            o.cancelled = true;
+            if (o.waiting) {
+                waiting.erase(std::find(waiting.begin(), waiting.end(), i));
+                o.waiting = false;
+                o.cancelDoneUs = now;
+            } else if (policy == POLICY_SERIAL) {
+                // An HTTP request cannot be taken back: the upload goes on
+                // and the connection is free once its reply is thrown away
+            } else {
+                mux.reset(o.stream);
+                busy--;
+                if (!o.headSent) o.cancelDoneUs = now;     // Never went out: no RESET either
+            }
+        }
+    }
+
+    void start() {
+        size_t limit = policy == POLICY_SERIAL ? 1 : StreamMux::MAX_STREAMS;
+        while (!waiting.empty() && busy < limit) {
+            size_t i = waiting.front();
+            MuxPriority priority = policy == POLICY_PRIORITY ? KIND_PRIORITY[requests[i].kind] : MUX_BULK;
+            int32_t id = mux.open(priority, requests[i].head.c_str(), requests[i].head.size());
+            if (id < 0) break;
+            waiting.pop_front();
+            Outcome& o = outcomes[i];
+            o.waiting = false;
+            o.started = true;
+            o.stream = id;
+            streams[id] = i;
+            watched.push_back(i);
+            busy++;
+        }
+    }
+
+    void feed() {
+        for (size_t i : watched) {
+            const Request& r = requests[i];
+            Outcome& o = outcomes[i];
+            if ((o.cancelled && policy != POLICY_SERIAL) || o.written == r.body.size()) continue;
+            size_t n = std::min(mux.writable(o.stream), r.body.size() - o.written);
+            o.written += mux.write(o.stream, (const uint8_t*)r.body.data() + o.written, n, o.written + n == r.body.size());
+        }
+    }
+
+    void pump() {
+        if (outboxSent == outboxFill) {
+            outboxFill = mux.poll(outbox, TURN_BYTES);
+            outboxSent = 0;
+            eachFrame(outbox, outboxFill, [&](uint8_t type, uint8_t flags, uint16_t stream, size_t, size_t end) {
+                auto found = streams.find(stream);
+                if (found == streams.end()) return;
+                Outcome& o = outcomes[found->second];
+                if (type == MUX_HEADERS) o.headSent = true;
+                if (type == MUX_RESET) o.resetOffset = handed + end;
+                if ((type == MUX_HEADERS || type == MUX_DATA) && (flags & MUX_END)) o.endOffset = handed + end;
+            });
+        }
+        if (outboxSent < outboxFill) {
+            size_t n = link.write(outbox + outboxSent, outboxFill - outboxSent);
+            outboxSent += n;
+            handed += n;
+        }
+        uint8_t inbox[1460];
+        size_t n;
+        while ((n = link.read(inbox, sizeof(inbox))) > 0) {
+            if (!mux.receive(inbox, n)) break;
+        }
+    }
+
+    // Uploads and resets that have left through the uplink
+    void settle(uint64_t now) {
+        uint64_t out = departed();
+        for (size_t k = 0; k < watched.size();) {
+            Outcome& o = outcomes[watched[k]];
+            if (o.sentUs == 0 && out >= o.endOffset) o.sentUs = now;
+            if (o.cancelled && o.cancelDoneUs == 0 && out >= o.resetOffset) o.cancelDoneUs = now;
+            bool finished = o.cancelled ? o.cancelDoneUs != 0 : o.sentUs != 0 && o.replied;
+            if (finished) {
+                watched[k] = watched.back();
+                watched.pop_back();
+            } else {
+                k++;
+            }
+        }
+    }
+
+    static void onEvent(const MuxEvent& event, void* context) {
+        Driver* self = (Driver*)context;
+        auto found = self->streams.find(event.stream);
+        if (found == self->streams.end()) return;
+        size_t i = found->second;
+        Outcome& o = self->outcomes[i];
+        if (o.replyUs != 0 || (o.cancelled && self->policy != POLICY_SERIAL)) return;
+        if (event.type == MUX_HEADERS) {
+            o.code = atoi(std::string((const char*)event.data, event.length).c_str());
+        } else if (event.type == MUX_RESET) {
+            o.code = -1;
+        } else if (event.type != MUX_DATA) {
+            return;
+        }
+        if (!event.end) return;
+        uint64_t now = micros() - self->baseUs;
+        o.replyUs = now;
+        self->busy--;
+        if (o.cancelled) {
+            o.cancelDoneUs = now;       // Serial: the reply to a cancelled upload, thrown away
+            return;
+        }
+        o.replied = true;
+        if (o.sentUs == 0) o.sentUs = now;
+        if (self->requests[i].follow >= 0) self->enqueue(self->requests[i].follow, now);
+    }
+};
+
+static void printRun(const Run& r) {
+    const std::vector<double>& command = r.sentMs[KIND_COMMAND];
+    printf("  %-16s %6.0f %6.0f %6.0f %6.0f | %6.0f %6.0f | %7.0f %8.0f %7.0f | %6.0f %6.0f | %5zu/%-5zu %6.0f\n",
+           r.name, percentile(command, 0.5), percentile(command, 0.9), percentile(r.contendedMs, 0.9),
+           percentile(command, 1.0), percentile(r.replyMs[KIND_COMMAND], 0.5), percentile(r.replyMs[KIND_COMMAND], 0.9),
+           percentile(r.sentMs[KIND_AUDIO], 0.9), percentile(r.sentMs[KIND_VISION], 0.9),
+           percentile(r.sentMs[KIND_TELEMETRY], 0.9), percentile(r.cancelMs, 0.5), percentile(r.cancelMs, 0.9),
+           r.answered, r.expected, r.kb);
+}
+
+static void printHeader() {
+    printf("\n  %-16s %6s %6s %6s %6s | %6s %6s | %7s %8s %7s | %6s %6s | %11s %6s\n", "policy", "cmd50", "cmd90",
+           "busy90", "cmdmax", "ans50", "ans90", "audio90", "vision90", "telem90", "cncl50", "cncl90", "answered",
+           "KB");
+}
+
+static void printLegend() {
+    printf("  cmd: a command submitted to its last byte out of the uplink (ms); busy90: p90 of the commands that\n"
+           "  came while other requests were in progress; ans: to its whole answer; audio/vision/telem90: uploads\n"
+           "  to their last byte out, p90; cncl: a cancel to the connection free of the upload (serial: its reply)\n");
+}
+
+int main(int argc, char** argv) {
+    uint32_t minutes = 15;
+    uint64_t seed = 1;
+    uint32_t uplinkKbps = 1000;
+    uint32_t roundTripMs = 40;
+    std::string server;
+    uint32_t seconds = 60;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--minutes" && i + 1 < argc) minutes = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--uplink-kbps" && i + 1 < argc) uplinkKbps = atoi(argv[++i]);
+        else if (arg == "--rtt-ms" && i + 1 < argc) roundTripMs = atoi(argv[++i]);
+        else if (arg == "--server" && i + 1 < argc) server = argv[++i];
+        else if (arg == "--seconds" && i + 1 < argc) seconds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--minutes N] [--seed N] [--uplink-kbps N] [--rtt-ms N] "
+                    "[--server URL [--seconds N]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (minutes < 1) minutes = 1;
+    if (seconds < 10) seconds = 10;
+    if (uplinkKbps < 64) uplinkKbps = 64;
+    Logger::setLogLevel(LOG_NONE);
+    Checks checks;
+    Run runs[POLICY_COUNT];
+
+    if (server.empty()) {
+        HostClock::setVirtual(true);
+        HostRandom rng(seed);
+        printf("Framing:\n");
+        engine(checks, rng);
+        printf("\nNetworkModule over MuxClient:\n");
+        networkModule(checks, seed);
+
+        uint32_t durationMs = minutes * 60000;
+        std::vector<Request> requests = makeWorkload(durationMs, rng);
+        printf("\nTraffic: %u minutes, %zu requests, uplink %u kbps, round trip %u ms, send buffer %zu bytes\n",
+               minutes, requests.size(), uplinkKbps, roundTripMs, SEND_BUFFER);
+        for (int p = 0; p < POLICY_COUNT; p++) {
+            SimLink link(uplinkKbps * 1000, roundTripMs, SEND_BUFFER, seed + 1);
+            HostClock::setAdvanceHook([&link](uint64_t, uint64_t toUs) { link.advance(toUs); });
+            Driver driver(requests, (Policy)p, link, [&link] { return link.departed(); },
+                          [] { HostClock::advanceMs(1); });
+            bool upgraded = driver.upgrade(3000);
+            driver.run(durationMs, 120000);
+            runs[p] = driver.result(POLICY_NAMES[p]);
+            runs[p].failed = runs[p].failed || !upgraded || link.protocolErrors > 0;
+            HostClock::setAdvanceHook(nullptr);
+        }
+    } else {
+        HostRandom rng(seed);
+        std::vector<Request> requests = makeWorkload(seconds * 1000, rng);
+        printf("Traffic to %s: %u s per policy, %zu requests, writes paced to %u kbps\n", server.c_str(), seconds,
+               requests.size(), uplinkKbps);
+        for (int p = 0; p < POLICY_COUNT; p++) {
+            SocketLink link(server, uplinkKbps * 1000);
+            Driver driver(requests, (Policy)p, link, [&link] { return link.departed(); }, [] { usleep(1000); });
+            if (!driver.upgrade(3000)) {
+                fprintf(stderr, "no /mux at %s\n", server.c_str());
+                return 2;
+            }
+            driver.run(seconds * 1000, 60000);
+            runs[p] = driver.result(POLICY_NAMES[p]);
+        }
+    }
+
+    printHeader();
+    for (const Run& r : runs) printRun(r);
+    printLegend();
+
+    const Run& serial = runs[POLICY_SERIAL];
+    const Run& flat = runs[POLICY_FLAT];
+    const Run& mux = runs[POLICY_PRIORITY];
+    printf("\nHead-of-line blocking:\n");
+    bool complete = true;
+    for (const Run& r : runs) complete = complete && !r.failed && r.answered == r.expected && r.errors == 0;
+    checks.expect(complete, "every request not cancelled is answered with 200 under every policy, no protocol errors");
+    // Commands that came while the connection was in use: the ones that can be blocked
+    double serial90 = percentile(serial.contendedMs, 0.9);
+    double flat90 = percentile(flat.contendedMs, 0.9);
+    double mux90 = percentile(mux.contendedMs, 0.9);
+    checks.expect(mux90 * 4 <= serial90, "a command gets out in under a quarter of the serial time",
+                  format("p90 %.0f ms vs %.0f ms", mux90, serial90));
+    if (server.empty()) {
+        checks.expect(mux90 <= flat90, "priorities get commands out no later than sharing one class",
+                      format("p90 %.0f ms vs %.0f ms", mux90, flat90));
+        // What lwIP holds already, a frame in progress and the command itself
+        double drainMs = (SEND_BUFFER + TURN_BYTES) * 8.0 / uplinkKbps;
+        checks.expect(mux90 <= drainMs + TURN_BYTES * 8.0 / uplinkKbps + 10, "a command waits for the send buffer at most",
+                      format("p90 %.0f ms, the buffer drains in %.0f ms", mux90, drainMs));
+        double cancel90 = percentile(mux.cancelMs, 0.9);
+        checks.expect(cancel90 <= drainMs + 10 && cancel90 * 4 < percentile(serial.cancelMs, 0.9),
+                      "a cancelled upload leaves the connection once the send buffer drains",
+                      format("p90 %.0f ms vs %.0f ms serial", cancel90, percentile(serial.cancelMs, 0.9)));
+        double bulk = percentile(mux.replyMs[KIND_VISION], 0.5);
+        checks.expect(bulk <= percentile(serial.replyMs[KIND_VISION], 0.5),
+                      "camera frames are described no later than when serial",
+                      format("p50 %.0f ms vs %.0f ms", bulk, percentile(serial.replyMs[KIND_VISION], 0.5)));
+    }
+
+    printf("\n%s\n", checks.failed ? "Some checks FAILED" : "All checks passed");
+    return checks.failed ? 1 : 0;
+}
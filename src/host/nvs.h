@@ -0,0 +1,141 @@
+#ifndef HOST_NVS_H
+#define HOST_NVS_H
+
+// NVS key-value storage, backed by memory. Namespaces and keys follow the
+// IDF limits (15 characters); values keep their type, and reading one as
+// another fails as on the device. Nothing needs committing here, but
+// nvs_commit() is accepted.
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_READ_ONLY (ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_INVALID_NAME (ESP_ERR_NVS_BASE + 0x06)
+#define ESP_ERR_NVS_INVALID_HANDLE (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_KEY_TOO_LONG (ESP_ERR_NVS_BASE + 0x09)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+class HostNvs {
+public:
+    static const size_t KEY_NAME_MAX = 15;
+
+    struct Value {
+        bool blob = false;
+        std::vector<uint8_t> bytes;     // Strings keep their terminator
+    };
+
+    struct Handle {
+        std::string space;
+        bool writable = false;
+    };
+
+    static inline std::map<std::string, std::map<std::string, Value>> spaces;
+    static inline std::map<nvs_handle_t, Handle> handles;
+    static inline nvs_handle_t nextHandle = 1;
+
+    // Erases every namespace, as a fresh chip
+    static void clear() {
+        spaces.clear();
+    }
+
+    static Handle* find(nvs_handle_t handle) {
+        auto it = handles.find(handle);
+        return it == handles.end() ? nullptr : &it->second;
+    }
+
+    static esp_err_t get(nvs_handle_t handle, const char* key, bool blob, void* out, size_t* length) {
+        Handle* h = find(handle);
+        if (h == nullptr) return ESP_ERR_NVS_INVALID_HANDLE;
+        auto space = spaces.find(h->space);
+        if (space == spaces.end()) return ESP_ERR_NVS_NOT_FOUND;
+        auto value = space->second.find(key);
+        if (value == space->second.end()) return ESP_ERR_NVS_NOT_FOUND;
+        if (value->second.blob != blob) return ESP_ERR_NVS_TYPE_MISMATCH;
+        size_t size = value->second.bytes.size();
+        if (out == nullptr) {
+            *length = size;
+            return ESP_OK;
+        }
+        if (*length < size) return ESP_ERR_NVS_INVALID_LENGTH;
+        memcpy(out, value->second.bytes.data(), size);
+        *length = size;
+        return ESP_OK;
+    }
+
+    static esp_err_t set(nvs_handle_t handle, const char* key, bool blob, const void* data, size_t length) {
+        Handle* h = find(handle);
+        if (h == nullptr) return ESP_ERR_NVS_INVALID_HANDLE;
+        if (!h->writable) return ESP_ERR_NVS_READ_ONLY;
+        if (strlen(key) > KEY_NAME_MAX) return ESP_ERR_NVS_KEY_TOO_LONG;
+        Value& value = spaces[h->space][key];
+        value.blob = blob;
+        value.bytes.assign((const uint8_t*)data, (const uint8_t*)data + length);
+        return ESP_OK;
+    }
+};
+
+inline esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* out) {
+    if (strlen(name) > HostNvs::KEY_NAME_MAX) return ESP_ERR_NVS_INVALID_NAME;
+    // A read-only open of a namespace that was never written fails
+    if (mode == NVS_READONLY && HostNvs::spaces.find(name) == HostNvs::spaces.end()) return ESP_ERR_NVS_NOT_FOUND;
+    nvs_handle_t handle = HostNvs::nextHandle++;
+    HostNvs::handles[handle] = { name, mode == NVS_READWRITE };
+    *out = handle;
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t handle) {
+    HostNvs::handles.erase(handle);
+}
+
+inline esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out, size_t* length) {
+    return HostNvs::get(handle, key, false, out, length);
+}
+
+inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out, size_t* length) {
+    return HostNvs::get(handle, key, true, out, length);
+}
+
+inline esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return HostNvs::set(handle, key, false, value, strlen(value) + 1);
+}
+
+inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return HostNvs::set(handle, key, true, value, length);
+}
+
+inline esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    HostNvs::Handle* h = HostNvs::find(handle);
+    if (h == nullptr) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->writable) return ESP_ERR_NVS_READ_ONLY;
+    return HostNvs::spaces[h->space].erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+inline esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    HostNvs::Handle* h = HostNvs::find(handle);
+    if (h == nullptr) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->writable) return ESP_ERR_NVS_READ_ONLY;
+    HostNvs::spaces[h->space].clear();
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_commit(nvs_handle_t handle) {
+    return HostNvs::find(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+#endif
@@ -0,0 +1,654 @@
+// OTA update harness (pio run -e native_ota).
+// Checks the update engine end to end and reports package sizes and
+// throughput:
+//   - full and delta packages, compressed or not, rebuilt through
+//     UpdateStream in randomly sized pieces, must hash to the target
+//   - corrupt, truncated and wrong-base payloads must be rejected
+//   - the real OtaUpdater installs from an in-process stand-in update server,
+//     over TLS with the provisioned PSK, into the inactive slot of the
+//     simulated flash, and the bootloader model
+//     keeps a confirmed image, rolls back a failed or unconfirmed boot and
+//     ignores an interrupted download
+//
+// Usage: program [--base old.bin --target new.bin] [--window N --lookahead N] [--seed N]
+//        program pack --target new.bin [--base old.bin] --version v1.2.3 --out update.bin
+//
+// Without images the harness builds synthetic ones: functions with literal
+// pools and PC-relative calls, strings and data tables, and two releases of
+// them (a small fix, and a feature that inserts code and moves everything
+// after it). Throughput is this host's; air time is the package over a link
+// of that rate, without protocol overhead.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "update_packer.h"
+#include "../../firmware/modules/ota_updater.cpp"
+
+typedef std::vector<uint8_t> Bytes;
+
+static bool readFile(const char* path, Bytes& out) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    uint8_t buffer[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.insert(out.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool writeFile(const char* path, const Bytes& data) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+// ---------------------------------------------------------------- Synthetic firmware
+
+// A program that links into an image; releases edit it and link again, so
+// code after an edit moves and every address pointing past it changes.
+// Functions and strings keep their id when others are inserted before them.
+struct Program {
+    struct Call {
+        size_t offset;          // Into the body, 3 bytes
+        int callee;
+    };
+    struct Ref {
+        bool string;
+        int id;
+    };
+    struct Function {
+        int id;
+        Bytes body;
+        std::vector<Call> calls;
+        std::vector<Ref> pool;  // Literal pool: function and string addresses
+    };
+    struct Text {
+        int id;
+        std::string text;
+    };
+    std::vector<Function> functions;
+    std::vector<Text> strings;
+    Bytes data;                 // Calibration and certificate blobs
+    std::string version;
+
+    static const uint32_t IROM = 0x42000000;
+    static const uint32_t DROM = 0x3C000000;
+
+    Bytes link() const {
+        Bytes image(32, 0);
+        image[0] = HostOta::IMAGE_MAGIC;
+        image[1] = 4;
+        memcpy(&image[8], version.data(), std::min<size_t>(version.size(), 16));
+
+        std::map<int, uint32_t> address;
+        size_t offset = image.size();
+        for (const Function& f : functions) {
+            offset += f.pool.size() * 4;
+            address[f.id] = IROM + offset;
+            offset += f.body.size();
+        }
+        std::map<int, uint32_t> stringAddress;
+        size_t rodata = 0;
+        for (const Text& s : strings) {
+            stringAddress[s.id] = DROM + rodata;
+            rodata += (s.text.size() + 4) & ~(size_t)3;
+        }
+
+        for (const Function& f : functions) {
+            for (const Ref& ref : f.pool) {
+                uint32_t value = ref.string ? stringAddress[ref.id] : address[ref.id];
+                for (int b = 0; b < 4; b++) image.push_back((uint8_t)(value >> (8 * b)));
+            }
+            size_t start = image.size();
+            image.insert(image.end(), f.body.begin(), f.body.end());
+            for (const Call& call : f.calls) {
+                int32_t rel = ((int32_t)address[call.callee] - (int32_t)((address[f.id] + call.offset) & ~3u)) >> 2;
+                image[start + call.offset] = (uint8_t)(0x25 | ((rel & 3) << 6));
+                image[start + call.offset + 1] = (uint8_t)(rel >> 2);
+                image[start + call.offset + 2] = (uint8_t)(rel >> 10);
+            }
+        }
+        for (const Text& s : strings) {
+            size_t padded = (s.text.size() + 4) & ~(size_t)3;
+            image.insert(image.end(), s.text.begin(), s.text.end());
+            image.insert(image.end(), padded - s.text.size(), 0);
+        }
+        image.insert(image.end(), data.begin(), data.end());
+        while (image.size() % 16) image.push_back(0);
+        return image;
+    }
+};
+
+class FirmwareModel {
+public:
+    explicit FirmwareModel(uint64_t seed) : rng(seed) {
+        for (int i = 0; i < 400; i++) {
+            uint8_t op = (uint8_t)rng.next();
+            if ((op & 0x0F) == 0x05) op ^= 0x01;      // Keep the CALL opcode for calls
+            vocabulary.push_back({ op, (uint8_t)rng.next(), (uint8_t)rng.next() });
+        }
+        // Compiler idioms: prologues, loop heads, String and Logger calls
+        for (int i = 0; i < 300; i++) {
+            Bytes idiom;
+            size_t length = 3 + pick(10);
+            for (size_t k = 0; k < length; k++) {
+                instruction(idiom);
+            }
+            idioms.push_back(idiom);
+        }
+    }
+
+    Program initial() {
+        Program program;
+        program.version = "v1.0.0";
+        for (int i = 0; i < FUNCTIONS; i++) {
+            program.functions.push_back(function());
+        }
+        for (int i = 0; i < STRINGS; i++) {
+            program.strings.push_back(text());
+        }
+        // Certificates and PHY tables: high entropy
+        for (int i = 0; i < 48 * 1024; i++) {
+            program.data.push_back((uint8_t)rng.next());
+        }
+        return program;
+    }
+
+    // Bug fix: a handful of functions change in place or grow slightly
+    Program fix(Program program) {
+        program.version = "v1.0.1";
+        for (int i = 0; i < 6; i++) {
+            mutate(program.functions[pick(program.functions.size())]);
+        }
+        program.strings[pick(program.strings.size())].text = message();
+        return program;
+    }
+
+    // Feature: a new module in the middle, callers wired to it, new strings
+    Program feature(Program program) {
+        program.version = "v1.1.0";
+        size_t at = program.functions.size() * 2 / 5;
+        std::vector<Program::Function> module;
+        for (int i = 0; i < 40; i++) {
+            module.push_back(function());
+        }
+        program.functions.insert(program.functions.begin() + at, module.begin(), module.end());
+        for (int i = 0; i < 60; i++) {
+            Program::Function& caller = program.functions[pick(program.functions.size())];
+            mutate(caller);
+            caller.pool.push_back({ false, module[pick(module.size())].id });
+        }
+        for (int i = 0; i < 80; i++) {
+            program.strings.insert(program.strings.begin() + pick(program.strings.size()), text());
+        }
+        return program;
+    }
+
+private:
+    static const int FUNCTIONS = 4200;
+    static const int STRINGS = 2400;
+
+    HostRandom rng;
+    std::vector<std::array<uint8_t, 3>> vocabulary;
+    std::vector<Bytes> idioms;
+    int nextFunction = 0;
+    int nextString = 0;
+
+    size_t pick(size_t n) {
+        return (size_t)(rng.uniform() * n);
+    }
+
+    // Skewed like real code: a few instruction forms dominate
+    void instruction(Bytes& body) {
+        const std::array<uint8_t, 3>& form = vocabulary[(size_t)(vocabulary.size() * pow(rng.uniform(), 4))];
+        body.push_back(form[0]);
+        body.push_back(form[1]);
+        if (form[0] & 0x08) {
+            body.push_back(form[2]);                  // Narrow instructions are two bytes
+        } else if (rng.uniform() < 0.15) {
+            body.back() = (uint8_t)rng.next();        // Register / immediate fields vary
+        }
+    }
+
+    // Calls and literals point at functions and strings of the initial release
+    Program::Function function() {
+        Program::Function f;
+        f.id = nextFunction++;
+        size_t instructions = (size_t)std::min(1500.0, rng.logNormal(70, 0.8));
+        for (size_t i = 0; i < instructions; i++) {
+            if (rng.uniform() < 0.08) {
+                f.calls.push_back({ f.body.size(), (int)pick(FUNCTIONS) });
+                f.body.insert(f.body.end(), 3, 0);
+            } else if (rng.uniform() < 0.06) {
+                const Bytes& idiom = idioms[(size_t)(idioms.size() * pow(rng.uniform(), 2))];
+                f.body.insert(f.body.end(), idiom.begin(), idiom.end());
+            } else {
+                instruction(f.body);
+            }
+        }
+        size_t refs = (size_t)(rng.uniform() * 8);
+        for (size_t i = 0; i < refs; i++) {
+            bool string = rng.uniform() < 0.5;
+            f.pool.push_back({ string, (int)pick(string ? STRINGS : FUNCTIONS) });
+        }
+        return f;
+    }
+
+    void mutate(Program::Function& f) {
+        size_t edits = 1 + pick(5);
+        for (size_t e = 0; e < edits && !f.body.empty(); e++) {
+            Bytes extra;
+            instruction(extra);
+            size_t at = pick(f.body.size());
+            bool inCall = false;
+            for (const Program::Call& call : f.calls) {
+                if (at >= call.offset && at < call.offset + 3) inCall = true;
+            }
+            if (inCall) continue;
+            f.body.insert(f.body.begin() + at, extra.begin(), extra.end());
+            for (Program::Call& call : f.calls) {
+                if (call.offset >= at) call.offset += extra.size();
+            }
+        }
+    }
+
+    Program::Text text() {
+        return { nextString++, message() };
+    }
+
+    std::string message() {
+        static const char* const WORDS[] = {
+            "wifi", "audio", "display", "touch", "battery", "failed", "init", "buffer", "timeout",
+            "connect", "server", "stream", "frame", "error", "ready", "update", "level", "mode",
+            "%d", "%s", "%u ms", "0x%08x", "retry", "queue", "sensor", "sample", "clock"
+        };
+        static const char* const TAGS[] = { "[MAIN] ", "[AUDIO] ", "[NET] ", "[OTA] ", "[DISP] ", "E (%u) ", "" };
+        std::string s = TAGS[pick(7)];
+        size_t words = 2 + pick(7);
+        for (size_t i = 0; i < words; i++) {
+            if (i) s += ' ';
+            s += WORDS[pick(sizeof(WORDS) / sizeof(WORDS[0]))];
+        }
+        return s;
+    }
+};
+
+// ---------------------------------------------------------------- Engine checks
+
+struct Rebuilt {
+    Bytes image;
+    UpdateError error;
+};
+
+static bool readBuffer(void* context, uint32_t offset, uint8_t* out, size_t length) {
+    const Bytes* base = ((std::pair<const Bytes*, Bytes*>*)context)->first;
+    if (offset + length > base->size()) return false;
+    memcpy(out, base->data() + offset, length);
+    return true;
+}
+
+static bool writeBuffer(void* context, const uint8_t* data, size_t length) {
+    Bytes* image = ((std::pair<const Bytes*, Bytes*>*)context)->second;
+    image->insert(image->end(), data, data + length);
+    return true;
+}
+
+// Feeds the package's payload in random pieces of 1 to maxPiece bytes
+static Rebuilt rebuild(const Bytes& package, const Bytes* base, HostRandom& rng, size_t maxPiece = 1500,
+                       size_t payloadLimit = SIZE_MAX) {
+    static UpdateStream stream;
+    Rebuilt result;
+    UpdateHeader header;
+    if (package.size() < UpdateHeader::BYTES || !header.parse(package.data())) {
+        result.error = UPDATE_BAD_HEADER;
+        return result;
+    }
+    std::pair<const Bytes*, Bytes*> context(base, &result.image);
+    if (!stream.begin(header, base ? readBuffer : nullptr, writeBuffer, &context)) {
+        result.error = stream.getError();
+        return result;
+    }
+    size_t end = std::min(package.size(), UpdateHeader::BYTES + std::min(payloadLimit, (size_t)header.payloadSize));
+    for (size_t at = UpdateHeader::BYTES; at < end;) {
+        size_t n = std::min(end - at, (size_t)(1 + rng.uniform() * maxPiece));
+        if (!stream.write(&package[at], n)) break;
+        at += n;
+    }
+    stream.finish();
+    result.error = stream.getError();
+    return result;
+}
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best of a few runs, in MB/s of bytes
+static double throughput(size_t bytes, const std::function<void()>& run) {
+    double best = 1e9;
+    for (int i = 0; i < 5; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, secondsSince(start));
+    }
+    return bytes / best / 1e6;
+}
+
+// ---------------------------------------------------------------- Device path
+
+// Stand-in update server: the package for X-Accept-Delta 1 or 0, optionally
+// damaged on the way
+struct UpdateServer {
+    Bytes delta;
+    Bytes full;
+    bool upToDate = false;
+    size_t truncateAt = SIZE_MAX;
+    long flipByte = -1;
+    uint32_t requests = 0;
+    std::string tlsIdentity;        // PSK identity of the last request, empty without TLS
+
+    HostHttpResponse handle(const HostHttpRequest& request) {
+        HostHttpResponse response;
+        requests++;
+        tlsIdentity = request.secure && request.secure->pskIdentity ? request.secure->pskIdentity : "";
+        if (!request.url.endsWith("/ota/update")) {
+            response.code = 404;
+            return response;
+        }
+        if (upToDate) {
+            response.code = 204;
+            return response;
+        }
+        Bytes body = request.header("X-Accept-Delta") == "1" && !delta.empty() ? delta : full;
+        if (flipByte >= 0 && (size_t)flipByte < body.size()) body[flipByte] ^= 0x40;
+        if (body.size() > truncateAt) body.resize(truncateAt);
+        response.body = String(std::string(body.begin(), body.end()));
+        response.latencyMs = 30;
+        return response;
+    }
+};
+
+static bool slotHolds(int slot, const Bytes& image) {
+    const Bytes& flash = HostFlash::data(&HostFlash::slots[slot]);
+    return memcmp(flash.data(), image.data(), image.size()) == 0;
+}
+
+static void devicePath(const Bytes& v1, const Bytes& v2, const Bytes& v3, const PackOptions& options, Checks& checks) {
+    HostClock::setVirtual(true);
+    Serial.setHostOutput(nullptr);
+    WiFi.begin("stand-in", "");
+    HostClock::advanceMs(1000);
+    HostHttp::downlinkBitsPerSecond = 1000000;
+
+    UpdateServer server;
+    HostHttp::setHandler([&server](const HostHttpRequest& request) { return server.handle(request); });
+    static OtaUpdater updater;
+    uint8_t key[16];
+    for (int i = 0; i < 16; i++) key[i] = (uint8_t)(i * 29 + 3);
+    HostNvs::clear();
+    TlsCredentials::provision("glasses-ota", key, sizeof(key));
+
+    HostOta::reset();
+    HostFlash::load(0, v1);
+    PackOptions v2Options = options;
+    v2Options.version = "v1.1.0";
+    server.delta = packUpdate(&v1, v2, v2Options);
+    server.full = packUpdate(nullptr, v2, v2Options);
+
+    // Delta install, first boot, confirmation
+    uint64_t startUs = HostClock::nowUs();
+    OtaUpdater::Result result = updater.checkForUpdate();
+    double installS = (HostClock::nowUs() - startUs) / 1e6;
+    checks.expect(result == OtaUpdater::OTA_INSTALLED && HostOta::boot == 1 && slotHolds(1, v2) && slotHolds(0, v1),
+                  "delta install into the inactive slot",
+                  std::to_string(server.delta.size()) + " bytes, " + std::to_string(installS).substr(0, 4) + " s at 1 Mbps");
+    checks.expect(server.tlsIdentity == "glasses-ota", "the package comes over TLS with the device's PSK",
+                  server.tlsIdentity.empty() ? "no TLS" : server.tlsIdentity);
+    HostOta::reboot();
+    checks.expect(HostOta::running == 1 && HostOta::states[1] == ESP_OTA_IMG_PENDING_VERIFY, "new image boots pending verification");
+    checks.expect(updater.checkForUpdate() == OtaUpdater::OTA_FAILED, "no further update before confirmation");
+    updater.confirmBoot(true);
+    HostOta::reboot();
+    checks.expect(HostOta::running == 1 && HostOta::states[1] == ESP_OTA_IMG_VALID, "confirmed image stays after a reset");
+
+    server.upToDate = true;
+    checks.expect(updater.checkForUpdate() == OtaUpdater::OTA_UP_TO_DATE, "204 from the server is up to date");
+    server.upToDate = false;
+
+    // The next release fails its first boot and is rolled back
+    PackOptions v3Options = options;
+    v3Options.version = "v1.2.0";
+    server.delta = packUpdate(&v2, v3, v3Options);
+    server.full = packUpdate(nullptr, v3, v3Options);
+    result = updater.checkForUpdate();
+    HostOta::reboot();
+    updater.confirmBoot(false);
+    checks.expect(result == OtaUpdater::OTA_INSTALLED && HostOta::running == 1 && HostOta::states[0] == ESP_OTA_IMG_INVALID &&
+                  slotHolds(1, v2), "failed first boot rolls back to the previous slot");
+
+    // A reset before confirmation rolls back as well
+    result = updater.checkForUpdate();
+    HostOta::reboot();
+    bool pending = HostOta::running == 0;
+    HostOta::reboot();
+    checks.expect(result == OtaUpdater::OTA_INSTALLED && pending && HostOta::running == 1 &&
+                  HostOta::states[0] == ESP_OTA_IMG_ABORTED, "reset before confirmation rolls back");
+
+    // Damaged downloads never become the boot slot
+    server.flipByte = UpdateHeader::BYTES + server.delta.size() / 2;
+    result = updater.checkForUpdate();
+    checks.expect(result == OtaUpdater::OTA_FAILED && HostOta::boot == 1, "corrupt download is rejected",
+                  updateErrorName(updater.getLastError()));
+    server.flipByte = -1;
+    server.truncateAt = server.delta.size() * 2 / 3;
+    result = updater.checkForUpdate();
+    checks.expect(result == OtaUpdater::OTA_FAILED && HostOta::boot == 1, "interrupted download is rejected",
+                  updateErrorName(updater.getLastError()));
+    server.truncateAt = SIZE_MAX;
+
+    // A build that is not the delta's base gets the full image
+    Bytes local = v2;
+    local[local.size() / 2] ^= 0xFF;
+    HostFlash::load(1, local);
+    uint32_t before = server.requests;
+    result = updater.checkForUpdate();
+    HostOta::reboot();
+    updater.confirmBoot(true);
+    checks.expect(result == OtaUpdater::OTA_INSTALLED && server.requests - before == 2 && HostOta::running == 0 &&
+                  slotHolds(0, v3), "base mismatch falls back to the full image");
+    HostHttp::setHandler(nullptr);
+}
+
+// ---------------------------------------------------------------- Report
+
+static int pack(int argc, char** argv) {
+    const char* basePath = nullptr;
+    const char* targetPath = nullptr;
+    const char* outPath = nullptr;
+    PackOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--base" && i + 1 < argc) basePath = argv[++i];
+        else if (arg == "--target" && i + 1 < argc) targetPath = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+        else if (arg == "--version" && i + 1 < argc) options.version = argv[++i];
+        else if (arg == "--window" && i + 1 < argc) options.windowBits = atoi(argv[++i]);
+        else if (arg == "--lookahead" && i + 1 < argc) options.lookaheadBits = atoi(argv[++i]);
+        else if (arg == "--raw") options.compress = false;
+        else targetPath = nullptr, i = argc;
+    }
+    Bytes base, target;
+    if (!targetPath || !outPath || options.version.empty() || !readFile(targetPath, target) ||
+        (basePath && !readFile(basePath, base))) {
+        fprintf(stderr, "usage: %s pack --target new.bin [--base old.bin] --version v1.2.3 --out update.bin "
+                        "[--window N] [--lookahead N] [--raw]\n", argv[0]);
+        return 2;
+    }
+    Bytes package = packUpdate(basePath ? &base : nullptr, target, options);
+    if (!writeFile(outPath, package)) {
+        fprintf(stderr, "cannot write %s\n", outPath);
+        return 1;
+    }
+    printf("%s: %s %s, %zu -> %zu bytes\n", outPath, options.version.c_str(), basePath ? "delta" : "full",
+           target.size(), package.size());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "pack") {
+        return pack(argc, argv);
+    }
+    const char* basePath = nullptr;
+    const char* targetPath = nullptr;
+    uint64_t seed = 1;
+    PackOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--base" && i + 1 < argc) basePath = argv[++i];
+        else if (arg == "--target" && i + 1 < argc) targetPath = argv[++i];
+        else if (arg == "--window" && i + 1 < argc) options.windowBits = atoi(argv[++i]);
+        else if (arg == "--lookahead" && i + 1 < argc) options.lookaheadBits = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "usage: %s [--base old.bin --target new.bin] [--window N --lookahead N] [--seed N]\n"
+                            "       %s pack --target new.bin [--base old.bin] --version v1.2.3 --out update.bin\n",
+                    argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    // Releases to update between: base -> each target
+    Bytes base;
+    std::vector<std::pair<std::string, Bytes>> targets;
+    if (basePath || targetPath) {
+        Bytes target;
+        if (!basePath || !targetPath || !readFile(basePath, base) || !readFile(targetPath, target)) {
+            fprintf(stderr, "--base and --target must both name readable images\n");
+            return 2;
+        }
+        targets.push_back({ "target", target });
+    } else {
+        FirmwareModel model(seed);
+        Program v1 = model.initial();
+        base = v1.link();
+        targets.push_back({ "fix", model.fix(v1).link() });
+        targets.push_back({ "feature", model.feature(v1).link() });
+    }
+    printf("Base image %zu bytes; heatshrink window %u bits, lookahead %u bits\n\n",
+           base.size(), options.windowBits, options.lookaheadBits);
+
+    HostRandom rng(seed);
+    Checks checks;
+    printf("%-18s %9s %7s %10s %10s %10s\n", "package", "bytes", "ratio", "air@1Mbps", "air@250k", "pack s");
+    std::vector<std::pair<std::string, Bytes>> packages;
+    for (const auto& target : targets) {
+        PackOptions raw = options;
+        raw.compress = false;
+        const Bytes& image = target.second;
+        struct Variant { std::string name; const Bytes* from; PackOptions options; };
+        std::vector<Variant> variants = {
+            { target.first + " full raw", nullptr, raw },
+            { target.first + " full", nullptr, options },
+            { target.first + " delta raw", &base, raw },
+            { target.first + " delta", &base, options },
+        };
+        for (const Variant& variant : variants) {
+            auto start = std::chrono::steady_clock::now();
+            Bytes package = packUpdate(variant.from, image, variant.options);
+            double packS = secondsSince(start);
+            printf("%-18s %9zu %6.1f%% %9.2fs %9.2fs %10.2f\n", variant.name.c_str(), package.size(),
+                   100.0 * package.size() / image.size(), package.size() * 8 / 1e6, package.size() * 8 / 250e3, packS);
+            Rebuilt rebuilt = rebuild(package, variant.from, rng);
+            if (rebuilt.error != UPDATE_OK || rebuilt.image != image) {
+                checks.expect(false, variant.name + " round trip", updateErrorName(rebuilt.error));
+            }
+            packages.push_back({ variant.name, package });
+        }
+    }
+
+    // Throughput of each stage on this host, in MB/s of image written
+    const Bytes& image = targets.back().second;
+    Bytes deltaRaw = DeltaEncoder::encode(base, image);
+    Bytes compressedImage = heatshrinkEncode(image, options.windowBits, options.lookaheadBits);
+    PackOptions raw = options;
+    raw.compress = false;
+    Bytes fullPackage = packUpdate(nullptr, image, options);
+    Bytes deltaRawPackage = packUpdate(&base, image, raw);
+    Bytes deltaPackage = packUpdate(&base, image, options);
+
+    static HeatshrinkDecoder decoder;
+    static DeltaPatcher patcher;
+    Bytes sink;
+    auto discard = [](void*, const uint8_t*, size_t) { return true; };
+    double decodeMBs = throughput(image.size(), [&] {
+        decoder.configure(options.windowBits, options.lookaheadBits);
+        decoder.decode(compressedImage.data(), compressedImage.size(), discard, nullptr);
+    });
+    std::pair<const Bytes*, Bytes*> context(&base, &sink);
+    double patchMBs = throughput(image.size(), [&] {
+        patcher.begin(readBuffer, discard, &context, base.size());
+        patcher.feed(deltaRaw.data(), deltaRaw.size());
+    });
+    double hashMBs = throughput(image.size(), [&] {
+        Sha256 hash;
+        hash.update(image.data(), image.size());
+        uint8_t digest[Sha256::DIGEST_BYTES];
+        hash.finish(digest);
+    });
+    double fullMBs = throughput(image.size(), [&] { rebuild(fullPackage, nullptr, rng, 1024); });
+    double deltaMBs = throughput(image.size(), [&] { rebuild(deltaPackage, &base, rng, 1024); });
+    printf("\nThroughput on this host (MB/s of image, %s target):\n", targets.back().first.c_str());
+    printf("  heatshrink decode %7.1f   delta apply %7.1f   SHA-256 %7.1f\n", decodeMBs, patchMBs, hashMBs);
+    printf("  full package      %7.1f   delta package %5.1f   (decode + apply + hash, 1 KB reads)\n", fullMBs, deltaMBs);
+    printf("Device RAM: UpdateStream %zu bytes, OtaUpdater %zu bytes\n\n", sizeof(UpdateStream), sizeof(OtaUpdater));
+
+    printf("Checks:\n");
+    for (const auto& package : packages) {
+        const Bytes* from = package.first.find("delta") != std::string::npos ? &base : nullptr;
+        Rebuilt rebuilt = rebuild(package.second, from, rng, 7);
+        checks.expect(rebuilt.error == UPDATE_OK, package.first + " in 1-7 byte pieces");
+    }
+    Bytes corrupt = deltaPackage;
+    corrupt[UpdateHeader::BYTES + (corrupt.size() - UpdateHeader::BYTES) / 3] ^= 0x10;
+    UpdateError error = rebuild(corrupt, &base, rng).error;
+    checks.expect(error == UPDATE_HASH_MISMATCH || error == UPDATE_CORRUPT || error == UPDATE_SIZE_MISMATCH,
+                  "flipped payload bit is rejected", updateErrorName(error));
+    error = rebuild(deltaRawPackage, &base, rng, 1500, (deltaRawPackage.size() - UpdateHeader::BYTES) / 2).error;
+    checks.expect(error == UPDATE_TRUNCATED, "half a payload is rejected", updateErrorName(error));
+    Bytes otherBase = base;
+    otherBase[base.size() / 3] ^= 0x01;
+    error = rebuild(deltaPackage, &otherBase, rng).error;
+    checks.expect(error == UPDATE_HASH_MISMATCH, "delta over a different base is rejected", updateErrorName(error));
+    Bytes longer = deltaRawPackage;
+    longer.push_back(0);
+    error = rebuild(longer, &base, rng).error;
+    checks.expect(error == UPDATE_OK, "bytes after the declared payload are ignored", updateErrorName(error));
+
+    if (targets.size() == 2) {
+        devicePath(base, targets[0].second, targets[1].second, options, checks);
+    }
+    printf("\n%s\n", checks.failed ? "FAILED" : "All checks passed");
+    return checks.failed ? 1 : 0;
+}
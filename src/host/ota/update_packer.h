@@ -0,0 +1,273 @@
+#ifndef HOST_UPDATE_PACKER_H
+#define HOST_UPDATE_PACKER_H
+
+// Server side of the update format in firmware/utils/update_stream.cpp:
+// heatshrink compression, deltas between images and the package around them.
+// Host only; the device carries just the decoders.
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../../firmware/utils/update_stream.cpp"
+
+// ---------------------------------------------------------------- Heatshrink
+
+// Greedy LZSS over hash chains, written as the heatshrink bitstream
+inline std::vector<uint8_t> heatshrinkEncode(const std::vector<uint8_t>& in, uint8_t windowBits, uint8_t lookaheadBits) {
+    const size_t window = (size_t)1 << windowBits;
+    const size_t maxLength = (size_t)1 << lookaheadBits;
+    const size_t refBits = 1 + windowBits + lookaheadBits;
+    const size_t MAX_CHAIN = 256;
+    const size_t HASH_BITS = 16;
+
+    std::vector<uint8_t> out;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    auto put = [&](uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--) {
+            bits = (bits << 1) | ((value >> i) & 1);
+            if (++bitCount == 8) {
+                out.push_back((uint8_t)bits);
+                bits = 0;
+                bitCount = 0;
+            }
+        }
+    };
+
+    std::vector<int32_t> head((size_t)1 << HASH_BITS, -1);
+    std::vector<int32_t> previous(in.size(), -1);
+    auto hashAt = [&](size_t i) {
+        return ((in[i] << 10) ^ (in[i + 1] << 5) ^ in[i + 2]) & (((size_t)1 << HASH_BITS) - 1);
+    };
+    auto insert = [&](size_t i) {
+        if (i + 2 >= in.size()) return;
+        size_t h = hashAt(i);
+        previous[i] = head[h];
+        head[h] = (int32_t)i;
+    };
+
+    for (size_t i = 0; i < in.size();) {
+        size_t bestLength = 0, bestDistance = 0;
+        if (i + 2 < in.size()) {
+            size_t limit = std::min(maxLength, in.size() - i);
+            size_t chain = 0;
+            for (int32_t p = head[hashAt(i)]; p >= 0 && i - p <= window && chain < MAX_CHAIN; p = previous[p], chain++) {
+                size_t length = 0;
+                while (length < limit && in[p + length] == in[i + length]) length++;
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = i - p;
+                    if (length == limit) break;
+                }
+            }
+        }
+        // A back reference only pays when it is shorter than the literals
+        if (bestLength * 9 > refBits) {
+            put(0, 1);
+            put((uint32_t)(bestDistance - 1), windowBits);
+            put((uint32_t)(bestLength - 1), lookaheadBits);
+            for (size_t k = 0; k < bestLength; k++) insert(i + k);
+            i += bestLength;
+        } else {
+            put(1, 1);
+            put(in[i], 8);
+            insert(i);
+            i++;
+        }
+    }
+    if (bitCount > 0) {
+        put(0, 8 - bitCount);
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------- Delta
+
+// bsdiff-style matching without the suffix array: an 8-byte seed index over
+// the base finds where a stretch of the target came from, and the match is
+// then extended while more bytes agree than differ, so code that moved and
+// had its addresses changed stays one match with small ADD differences
+class DeltaEncoder {
+public:
+    static const size_t SEED = 8;
+    static const int MIN_SCORE = 16;            // Net agreeing bytes to take a match
+    static const size_t MIN_COPY = 12;          // Equal run that ends an ADD
+    static const int SLACK = 24;                // Disagreement tolerated before a match ends
+
+    static std::vector<uint8_t> encode(const std::vector<uint8_t>& base, const std::vector<uint8_t>& target) {
+        DeltaEncoder encoder(base, target);
+        encoder.run();
+        return encoder.out;
+    }
+
+private:
+    static const size_t TABLE_BITS = 20;
+
+    const std::vector<uint8_t>& base;
+    const std::vector<uint8_t>& target;
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> literals;
+    std::vector<int32_t> table;
+    uint32_t cursor = 0;
+
+    DeltaEncoder(const std::vector<uint8_t>& base, const std::vector<uint8_t>& target)
+        : base(base), target(target), table((size_t)1 << TABLE_BITS, -1) {
+        for (size_t i = 0; i + SEED <= base.size(); i++) {
+            table[hash(&base[i])] = (int32_t)i;
+        }
+    }
+
+    static size_t hash(const uint8_t* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return (size_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_BITS));
+    }
+
+    // Longest length with the best (agreeing - disagreeing) score from here
+    size_t extend(size_t from, size_t at, int& bestScore) const {
+        int score = 0;
+        bestScore = 0;
+        size_t best = 0;
+        for (size_t k = 0; from + k < base.size() && at + k < target.size(); k++) {
+            score += base[from + k] == target[at + k] ? 1 : -1;
+            if (score > bestScore) {
+                bestScore = score;
+                best = k + 1;
+            } else if (score < bestScore - SLACK) {
+                break;
+            }
+        }
+        return best;
+    }
+
+    void run() {
+        size_t at = 0;
+        while (at < target.size()) {
+            int score = 0, candidateScore;
+            size_t length = 0, from = 0;
+            if (cursor < base.size()) {
+                length = extend(cursor, at, score);
+                from = cursor;
+            }
+            if (at + SEED <= target.size()) {
+                int32_t seed = table[hash(&target[at])];
+                if (seed >= 0 && (uint32_t)seed != cursor && memcmp(&base[seed], &target[at], SEED) == 0) {
+                    size_t candidate = extend(seed, at, candidateScore);
+                    if (candidateScore > score) {
+                        score = candidateScore;
+                        length = candidate;
+                        from = seed;
+                    }
+                }
+            }
+            if (score < MIN_SCORE) {
+                literals.push_back(target[at++]);
+                continue;
+            }
+            flushLiterals();
+            if (from != cursor) {
+                int32_t offset = (int32_t)from - (int32_t)cursor;
+                op(DELTA_SEEK, ((uint32_t)offset << 1) ^ (uint32_t)(offset >> 31));
+                cursor = from;
+            }
+            emitMatch(at, length);
+            at += length;
+        }
+        flushLiterals();
+    }
+
+    // Equal runs become COPY, the rest ADD with byte differences
+    void emitMatch(size_t at, size_t length) {
+        const uint32_t from = cursor;
+        size_t addStart = 0, k = 0;
+        while (k < length) {
+            size_t run = 0;
+            while (k + run < length && base[from + k + run] == target[at + k + run]) run++;
+            if (run >= MIN_COPY || (run > 0 && k + run == length && k == addStart)) {
+                emitAdd(at + addStart, k - addStart);
+                op(DELTA_COPY, run);
+                cursor += run;
+                k += run;
+                addStart = k;
+            } else {
+                k = std::min(length, k + run + 1);
+            }
+        }
+        emitAdd(at + addStart, length - addStart);
+    }
+
+    void emitAdd(size_t at, size_t length) {
+        if (length == 0) return;
+        op(DELTA_ADD, length);
+        for (size_t k = 0; k < length; k++) {
+            out.push_back((uint8_t)(target[at + k] - base[cursor + k]));
+        }
+        cursor += length;
+    }
+
+    void flushLiterals() {
+        if (literals.empty()) return;
+        op(DELTA_INSERT, literals.size());
+        out.insert(out.end(), literals.begin(), literals.end());
+        literals.clear();
+    }
+
+    void op(DeltaOp kind, uint32_t length) {
+        uint32_t value = length << 2 | kind;
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+};
+
+// ---------------------------------------------------------------- Package
+
+struct PackOptions {
+    uint8_t windowBits = 12;
+    uint8_t lookaheadBits = 6;
+    bool compress = true;
+    std::string version;
+};
+
+inline void sha256Of(const std::vector<uint8_t>& data, uint8_t digest[Sha256::DIGEST_BYTES]) {
+    Sha256 hash;
+    hash.update(data.data(), data.size());
+    hash.finish(digest);
+}
+
+// Full image without a base, else a delta against it
+inline std::vector<uint8_t> packUpdate(const std::vector<uint8_t>* base, const std::vector<uint8_t>& target,
+                                       const PackOptions& options) {
+    UpdateHeader header;
+    std::vector<uint8_t> payload = base ? DeltaEncoder::encode(*base, target) : target;
+    std::vector<uint8_t> compressed;
+    if (options.compress) {
+        compressed = heatshrinkEncode(payload, options.windowBits, options.lookaheadBits);
+    }
+    // Stored as is when compression would only add bits
+    if (options.compress && compressed.size() < payload.size()) {
+        payload.swap(compressed);
+        header.flags |= UPDATE_COMPRESSED;
+        header.windowBits = options.windowBits;
+        header.lookaheadBits = options.lookaheadBits;
+    }
+    if (base) {
+        header.flags |= UPDATE_DELTA;
+        header.baseSize = base->size();
+        sha256Of(*base, header.baseSha256);
+    }
+    header.targetSize = target.size();
+    header.payloadSize = payload.size();
+    sha256Of(target, header.targetSha256);
+    strncpy(header.version, options.version.c_str(), UpdateHeader::VERSION_BYTES);
+
+    std::vector<uint8_t> package(UpdateHeader::BYTES);
+    header.serialize(package.data());
+    package.insert(package.end(), payload.begin(), payload.end());
+    return package;
+}
+
+#endif
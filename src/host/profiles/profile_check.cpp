@@ -0,0 +1,94 @@
+// Board profile check (pio run -e native_profiles).
+// Compiling this file is the check: every profile in AllProfiles goes through
+// checkProfile<>()'s static_asserts, and the whole firmware is built against
+// the selected profile (-DBOARD_PROFILE_<NAME>, see the native_profiles_* envs).
+// Running it prints each profile's pin table and flags strapping pins.
+//
+// Usage: program
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <type_traits>
+#include "../../firmware/config/board_profile.h"
+#include "../../firmware/main_dir/main.cpp"
+
+static_assert(checkProfiles(AllProfiles{}), "Board profile check failed");
+
+template <typename P>
+static void printProfile() {
+    printf("%s%s\n", P::NAME, std::is_same<P, Board>::value ? " (firmware built against this profile)" : "");
+
+    struct Row {
+        const char* function;
+        uint8_t pin;
+    };
+    const Row rows[] = {
+        { "i2c_sda", P::I2c::SDA },
+        { "i2c_scl", P::I2c::SCL },
+        { "mic_bclk", P::Mic::BCLK },
+        { "mic_ws", P::Mic::WS },
+        { "mic_din", P::Mic::DIN },
+        { "speaker_bclk", P::Speaker::BCLK },
+        { "speaker_ws", P::Speaker::WS },
+        { "speaker_dout", P::Speaker::DOUT },
+        { "touch", P::Touch::PIN },
+        { "battery1", P::Battery::PIN1 },
+        { "battery2", P::Battery::PIN2 },
+        { "status_led", P::StatusLed::PIN },
+        { "button_power", P::Buttons::POWER },
+        { "button_mode", P::Buttons::MODE },
+        { "camera_xclk", P::Camera::XCLK },
+        { "camera_pclk", P::Camera::PCLK },
+        { "camera_vsync", P::Camera::VSYNC },
+        { "camera_href", P::Camera::HREF },
+        { "camera_d0", P::Camera::D0 },
+        { "camera_d1", P::Camera::D1 },
+        { "camera_d2", P::Camera::D2 },
+        { "camera_d3", P::Camera::D3 },
+        { "camera_d4", P::Camera::D4 },
+        { "camera_d5", P::Camera::D5 },
+        { "camera_d6", P::Camera::D6 },
+        { "camera_d7", P::Camera::D7 }
+    };
+    for (const Row& row : rows) {
+        if (row.pin == NO_PIN) {
+            printf("  %-13s -\n", row.function);
+            continue;
+        }
+        printf("  %-13s GPIO%u%s\n", row.function, row.pin,
+               Esp32S3::isStrappingPin(row.pin) ? "  (strapping pin: keep external pulls off at reset)" : "");
+    }
+
+    printf("  i2c %lu kHz, display %ux%u at 0x%02X\n", (unsigned long)(P::I2c::FREQUENCY / 1000),
+           P::Display::WIDTH, P::Display::HEIGHT, P::Display::ADDRESS);
+    printf("  mic x%u %lu Hz (captured at %lu Hz), %u x %u frame DMA buffers (%.0f ms), gain %.2f\n",
+           P::Mic::CHANNELS, (unsigned long)P::Mic::SAMPLE_RATE,
+           (unsigned long)(P::Mic::SAMPLE_RATE * P::Mic::DECIMATION),
+           P::Mic::DMA_BUF_COUNT, (unsigned)P::Mic::DMA_BUF_LEN,
+           1000.0 * P::Mic::DMA_BUF_COUNT * P::Mic::DMA_BUF_LEN / (P::Mic::SAMPLE_RATE * P::Mic::DECIMATION),
+           P::Mic::GAIN_Q8 / 256.0);
+    printf("  speaker %lu Hz, %u x %u frame DMA buffers (%.0f ms queued at most)\n",
+           (unsigned long)P::Speaker::SAMPLE_RATE, P::Speaker::DMA_BUF_COUNT, (unsigned)P::Speaker::DMA_BUF_LEN,
+           1000.0 * (P::Speaker::DMA_BUF_COUNT + 1) * P::Speaker::DMA_BUF_LEN / P::Speaker::SAMPLE_RATE);
+    printf("  battery divider 1:%.0f, low %.0f%%, critical %.0f%%\n", P::Battery::DIVIDER,
+           P::Battery::LOW_PERCENT, P::Battery::CRITICAL_PERCENT);
+    if (P::Camera::PRESENT) {
+        printf("  camera %ux%u YUV422, %u frame buffers (%.0f KB of PSRAM), XCLK %lu MHz\n\n",
+               P::Camera::WIDTH, P::Camera::HEIGHT, P::Camera::FB_COUNT,
+               P::Camera::FB_COUNT * P::Camera::WIDTH * P::Camera::HEIGHT * 2 / 1024.0,
+               (unsigned long)(P::Camera::XCLK_HZ / 1000000));
+    } else {
+        printf("  no camera\n\n");
+    }
+}
+
+template <typename... Profiles>
+static void printProfiles(ProfileList<Profiles...>) {
+    (printProfile<Profiles>(), ...);
+}
+
+int main() {
+    printProfiles(AllProfiles{});
+    printf("All profiles pass the compile-time checks\n");
+    return 0;
+}
@@ -0,0 +1,373 @@
+// Prompt player harness (pio run -e native_prompts).
+// Checks PromptMixer's rules on synthetic clips, then runs PromptPlayer with
+// its task and the I2S transmit clock in real time against the asset pack
+// and measures, from play() to the prompt's first sample at the amplifier:
+//   - idle: the speaker is off and has to start
+//   - busy: the thinking loop is playing and the ring is full
+// The host shim is the IDF 4.4 legacy driver, which starts on a zeroed DMA
+// buffer; IDF 5 preloads the first samples instead, one buffer sooner.
+//
+// Usage: program [--pack assets.bin] [--trials N]
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../../firmware/drivers/prompt_player.cpp"
+
+typedef std::vector<uint8_t> Bytes;
+
+static const uint32_t RATE = PromptPlayer::SAMPLE_RATE;
+static const double LATENCY_BUDGET_MS = 20.0;
+
+static bool readFile(const std::string& path, Bytes& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    uint8_t buffer[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.insert(out.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)lround(p * (values.size() - 1));
+    return values[index];
+}
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+// ---------------------------------------------------------------- Mixer rules
+
+// PCM prompt built in memory, laid out as in the pack
+struct SyntheticClip {
+    std::vector<uint8_t> bytes;
+
+    SyntheticClip(const std::vector<int16_t>& samples) {
+        AssetPromptHeader header = { (uint16_t)RATE, CODEC_PCM16, 0, (uint32_t)samples.size(), 512, 256 };
+        bytes.resize(sizeof(header) + samples.size() * sizeof(int16_t));
+        memcpy(bytes.data(), &header, sizeof(header));
+        memcpy(bytes.data() + sizeof(header), samples.data(), samples.size() * sizeof(int16_t));
+    }
+
+    AssetPrompt view() const {
+        AssetPrompt prompt;
+        prompt.header = (const AssetPromptHeader*)bytes.data();
+        prompt.data = bytes.data() + sizeof(AssetPromptHeader);
+        prompt.bytes = bytes.size() - sizeof(AssetPromptHeader);
+        return prompt;
+    }
+};
+
+static std::vector<int16_t> render(PromptMixer& mixer, size_t samples) {
+    std::vector<int16_t> out(samples);
+    mixer.mix(out.data(), samples);
+    return out;
+}
+
+static double dbOf(double level, double reference) {
+    return 20 * log10(std::max(level, 1e-9) / reference);
+}
+
+// A steady clip shows the gain the mixer applies: DC 10000 under a silent
+// alert, against the duck, ramp and fade settings
+static void mixerRules(Checks& checks) {
+    const int16_t LEVEL = 10000;
+    SyntheticClip steady(std::vector<int16_t>(RATE / 2, LEVEL));
+    SyntheticClip silentAlert(std::vector<int16_t>(RATE / 4, 0));
+    SyntheticClip feedback(std::vector<int16_t>(RATE / 4, 1000));
+    PromptMixerConfig config;
+    const size_t ms = RATE / 1000;
+    const uint8_t AMBIENT = 0, ALERT = 1, ALERT2 = 2, FEEDBACK = 3;
+
+    PromptMixer mixer(config);
+    mixer.load(AMBIENT, steady.view(), PROMPT_PRIORITY_AMBIENT, true);
+    mixer.load(ALERT, silentAlert.view(), PROMPT_PRIORITY_ALERT);
+    mixer.load(ALERT2, silentAlert.view(), PROMPT_PRIORITY_ALERT);
+    mixer.load(FEEDBACK, feedback.view(), PROMPT_PRIORITY_FEEDBACK);
+
+    // Alone, a clip plays as stored; a loop keeps going past its end
+    mixer.play(AMBIENT);
+    std::vector<int16_t> alone = render(mixer, RATE);
+    bool exact = std::all_of(alone.begin(), alone.end(), [&](int16_t s) { return s == LEVEL; });
+    checks.expect(exact, "a clip alone plays at unity, a looping one past its end", "1 s of a 0.5 s loop");
+
+    // Under an alert: down to the duck gain within the attack, back after it
+    mixer.play(ALERT);
+    std::vector<int16_t> ducked = render(mixer, RATE / 2);
+    double duckDb = dbOf(ducked[50 * ms], LEVEL);
+    size_t settled = std::find(ducked.begin(), ducked.end(), ducked[50 * ms]) - ducked.begin();
+    size_t restored = std::find(ducked.begin() + 250 * ms, ducked.end(), LEVEL) - ducked.begin();
+    checks.expect(fabs(duckDb + 12.0) < 0.2 && settled <= (config.duckAttackMs + 1) * ms,
+                  "an alert ducks the loop", format("%.1f dB after %.1f ms", duckDb, (double)settled / ms));
+    checks.expect(restored - 250 * ms <= (config.duckReleaseMs + 1) * ms, "the loop comes back after the alert",
+                  format("%.0f ms release", (double)(restored - 250 * ms) / ms));
+
+    // Two alerts fill the voices: the loop is replaced, feedback is dropped
+    mixer.play(ALERT);
+    mixer.play(ALERT2);
+    bool dropped = !mixer.play(FEEDBACK);
+    render(mixer, 10 * ms);
+    checks.expect(!mixer.isPlaying(AMBIENT) && dropped, "two alerts displace the loop and refuse feedback");
+    render(mixer, RATE / 4);
+
+    // Stopping fades, with no step larger than the fade ramp
+    mixer.play(AMBIENT);
+    render(mixer, 10 * ms);
+    mixer.stop(AMBIENT);
+    std::vector<int16_t> fade = render(mixer, 10 * ms);
+    size_t silentAt = std::find(fade.begin(), fade.end(), 0) - fade.begin();
+    int largestStep = 0;
+    for (size_t i = 1; i < fade.size(); i++) largestStep = std::max(largestStep, abs(fade[i] - fade[i - 1]));
+    checks.expect(silentAt <= (config.fadeMs + 1) * ms && largestStep < LEVEL / 16 && !mixer.isActive(),
+                  "stop fades out without a click",
+                  format("silent after %.1f ms, largest step %.0f", (double)silentAt / ms, largestStep));
+
+    // A repeated clip fades its first copy while the second starts
+    mixer.play(FEEDBACK);
+    render(mixer, 20 * ms);
+    mixer.play(FEEDBACK);
+    std::vector<int16_t> restart = render(mixer, 20 * ms);
+    int peak = *std::max_element(restart.begin(), restart.end());
+    checks.expect(restart[0] > 1000 && restart[0] < 2000 && restart.back() == 1000 && peak <= 2000,
+                  "a repeated clip restarts, crossfading the old copy", format("peak %.0f", peak));
+}
+
+// Pack prompts through the mixer, against their own decode
+static void packPrompts(Checks& checks, const AssetPack& pack) {
+    PromptMixer mixer;
+    const struct {
+        AssetId id;
+        const char* name;
+    } prompts[] = {
+        { PROMPT_LISTENING, "listening" }, { PROMPT_THINKING, "thinking" }, { PROMPT_DONE, "done" },
+        { PROMPT_ERROR, "error" }, { PROMPT_LOW_BATTERY, "low battery" }
+    };
+    for (const auto& entry : prompts) {
+        AssetPrompt prompt = pack.prompt(entry.id);
+        std::string name = std::string(entry.name) + " prompt";
+        if (!prompt) {
+            checks.expect(false, name + " in the pack");
+            continue;
+        }
+        std::vector<int16_t> expected;
+        int16_t block[PromptMixer::MAX_BLOCK_SAMPLES];
+        for (uint32_t i = 0; i < prompt.blocks(); i++) {
+            size_t length;
+            const uint8_t* data = prompt.block(i, length);
+            if (prompt.header->codec == CODEC_PCM16) {
+                expected.insert(expected.end(), (const int16_t*)data, (const int16_t*)(data + length));
+            } else {
+                size_t n = AudioEncoder::decodeAdpcm(data, length, block);
+                expected.insert(expected.end(), block, block + n);
+            }
+        }
+        mixer.load(0, prompt, PROMPT_PRIORITY_FEEDBACK);
+        mixer.play(0);
+        std::vector<int16_t> out = render(mixer, expected.size() + 64);
+        bool same = std::equal(expected.begin(), expected.end(), out.begin()) &&
+                    std::all_of(out.begin() + expected.size(), out.end(), [](int16_t s) { return s == 0; });
+        checks.expect(same, name + " mixes sample-exact",
+                      format("%.0f ms, ", expected.size() * 1000.0 / RATE) +
+                          (prompt.header->codec == CODEC_PCM16 ? "PCM" : "ADPCM"));
+    }
+}
+
+// ---------------------------------------------------------------- Player latency
+
+// What reached the amplifier, with the time each block started playing
+class Amplifier {
+public:
+    void attach() {
+        HostI2s::setSink(1, [this](const int16_t* samples, size_t count, uint64_t playUs) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < count; i++) {
+                if (samples[i] != 0) {
+                    heard.push_back(playUs + i * 1000000ull / RATE);
+                    break;
+                }
+            }
+        });
+    }
+
+    // First non-silent sample playing at or after us, 0 if none yet
+    uint64_t firstSoundAfter(uint64_t us) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint64_t t : heard) {
+            if (t >= us) return t;
+        }
+        return 0;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<uint64_t> heard;            // First sound in each written block
+};
+
+static void sleepMs(double ms) {
+    std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(ms * 1000)));
+}
+
+static bool waitIdle(double timeoutMs) {
+    for (double waited = 0; waited < timeoutMs; waited += 1) {
+        if (!HostI2s::isTransmitting(1)) return true;
+        sleepMs(1);
+    }
+    return false;
+}
+
+// Samples before a prompt's first non-zero one
+static size_t leadingSilence(const AssetPack& pack, AssetId id) {
+    PromptMixer mixer;
+    mixer.load(0, pack.prompt(id), PROMPT_PRIORITY_FEEDBACK);
+    mixer.play(0);
+    std::vector<int16_t> out = render(mixer, PromptMixer::LEAD_SAMPLES);
+    return std::find_if(out.begin(), out.end(), [](int16_t s) { return s != 0; }) - out.begin();
+}
+
+static void playerLatency(Checks& checks, const AssetPack& pack, int trials) {
+    Amplifier amplifier;
+    amplifier.attach();
+    PromptPlayer player;
+    checks.expect(player.begin(), "player starts with the pack's prompts");
+    HostRandom rng(3);
+    const double sampleMs = 1000.0 / RATE;
+
+    // Idle: the speaker starts for each prompt, then stops again
+    std::vector<double> idle;
+    double doneOffset = leadingSilence(pack, PROMPT_DONE) * sampleMs;
+    for (int i = 0; i < trials; i++) {
+        sleepMs(5 + 20 * rng.uniform());
+        uint64_t trigger = HostClock::nowUs();
+        player.play(PROMPT_DONE);
+        sleepMs(60);
+        uint64_t heard = amplifier.firstSoundAfter(trigger);
+        if (heard) idle.push_back((heard - trigger) / 1000.0 - doneOffset);
+        waitIdle(1000);
+    }
+    bool stopped = !HostI2s::isTransmitting(1);
+
+    // Busy: the thinking loop runs; the error prompt lands in its quiet part
+    std::vector<double> busy;
+    double errorOffset = leadingSilence(pack, PROMPT_ERROR) * sampleMs;
+    uint32_t underrunsBefore = HostI2s::getUnderruns(1);
+    player.play(PROMPT_THINKING);
+    sleepMs(100);
+    for (int i = 0; i < trials; i++) {
+        // The blip is the first 60 ms of each 800 ms period
+        uint64_t loopStart = amplifier.firstSoundAfter(HostClock::nowUs() - 800000);
+        uint64_t quiet = loopStart + 150000 + (uint64_t)(300000 * rng.uniform());
+        while (HostClock::nowUs() < quiet) sleepMs(0.2);
+        uint64_t trigger = HostClock::nowUs();
+        player.play(PROMPT_ERROR);
+        sleepMs(60);
+        uint64_t heard = amplifier.firstSoundAfter(trigger);
+        if (heard) busy.push_back((heard - trigger) / 1000.0 - errorOffset);
+        sleepMs(400);
+    }
+    player.stop(PROMPT_THINKING);
+    uint32_t underruns = HostI2s::getUnderruns(1) - underrunsBefore;
+    bool stoppedAfterLoop = waitIdle(1000);
+
+    printf("\nTrigger to first sample (this host, real time, %d trials each)\n", trials);
+    printf("  %-34s %7s %7s %7s\n", "", "p50 ms", "p99 ms", "max ms");
+    printf("  %-34s %7.2f %7.2f %7.2f\n", "idle: speaker starts", percentile(idle, 0.5), percentile(idle, 0.99),
+           percentile(idle, 1.0));
+    printf("  %-34s %7.2f %7.2f %7.2f\n", "busy: behind the queued ring", percentile(busy, 0.5),
+           percentile(busy, 0.99), percentile(busy, 1.0));
+    printf("  %-34s %7.2f %7s %7.2f\n", "busy, from the DMA ring alone",
+           1000.0 * (Board::Speaker::DMA_BUF_COUNT + 0.5) * PromptPlayer::BUFFER_SAMPLES / RATE, "",
+           1000.0 * (Board::Speaker::DMA_BUF_COUNT + 1) * PromptPlayer::BUFFER_SAMPLES / RATE);
+    printf("  %-34s %7.2f %7.2f\n\n", "player's own estimate (metrics)",
+           Metrics::histogram(PROMPT_LATENCY_US).quantile(0.5) / 1000.0,
+           Metrics::histogram(PROMPT_LATENCY_US).quantile(0.99) / 1000.0);
+
+    checks.expect((int)idle.size() == trials && percentile(idle, 0.99) <= LATENCY_BUDGET_MS,
+                  "idle trigger is heard within 20 ms", format("p99 %.2f ms", percentile(idle, 0.99)));
+    checks.expect((int)busy.size() == trials && percentile(busy, 0.99) <= LATENCY_BUDGET_MS,
+                  "trigger during playback is heard within 20 ms", format("p99 %.2f ms", percentile(busy, 0.99)));
+    checks.expect(underruns == 0, "no underruns while the loop plays", std::to_string(underruns));
+    checks.expect(stopped && stoppedAfterLoop, "the speaker clock stops when nothing plays");
+}
+
+int main(int argc, char** argv) {
+    std::string packPath = ".pio/build/native_prompts/assets.bin";
+    int trials = 20;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pack" && i + 1 < argc) packPath = argv[++i];
+        else if (arg == "--trials" && i + 1 < argc) trials = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--pack assets.bin] [--trials N]\n", argv[0]);
+            return 2;
+        }
+    }
+    Logger::setLogLevel(LOG_NONE);
+
+    Bytes pack;
+    if (!readFile(packPath, pack)) {
+        fprintf(stderr, "Cannot read %s; build it with: python scripts/asset_pack.py assets/assets.txt --out %s\n",
+                packPath.c_str(), packPath.c_str());
+        return 2;
+    }
+    AssetPack reader;
+    AssetPackError error = reader.open(pack.data(), pack.size(), ASSET_SCHEMA);
+    if (error != ASSET_PACK_OK) {
+        fprintf(stderr, "%s: %s\n", packPath.c_str(), assetPackErrorName(error));
+        return 1;
+    }
+
+    Checks checks;
+    printf("Mixer:\n");
+    mixerRules(checks);
+    packPrompts(checks, reader);
+
+    // Mixing cost: two ADPCM voices, one ducked
+    PromptMixer mixer;
+    mixer.load(0, reader.prompt(PROMPT_THINKING), PROMPT_PRIORITY_AMBIENT, true);
+    mixer.load(1, reader.prompt(PROMPT_LOW_BATTERY), PROMPT_PRIORITY_ALERT);
+    mixer.play(0);
+    int16_t buffer[PromptPlayer::BUFFER_SAMPLES];
+    const int BUFFERS = 20000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BUFFERS; i++) {
+        if (i % 100 == 0) mixer.play(1);
+        mixer.mix(buffer, PromptPlayer::BUFFER_SAMPLES);
+    }
+    double perBuffer = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / BUFFERS;
+    printf("  mixing 2 ADPCM voices: %.2f us per %u-sample buffer (this host)\n", perBuffer * 1e6,
+           (unsigned)PromptPlayer::BUFFER_SAMPLES);
+
+    printf("\nPlayer:\n");
+    HostFlash::load(&HostFlash::assets, pack);
+    AssetStore::mount();
+    playerLatency(checks, reader, trials);
+
+    printf("\n%s\n", checks.failed ? "Some checks FAILED" : "All checks passed");
+    fflush(stdout);
+    _Exit(checks.failed ? 1 : 0);           // The player task never returns
+}
@@ -0,0 +1,179 @@
+// Radio scheduler harness (pio run -e native_radio).
+// Drives RadioScheduler in virtual time the way the firmware does, with
+// service() from every loop pass, and checks the Wi-Fi draw it reports to
+// the battery model against the time the modem was actually awake:
+//   - a window with no request is all modem sleep
+//   - a request and its tail that end inside the window count in full
+//   - a request still open when the window closes is split between windows
+//   - an early wake counts for its 3 s, with or without the upload
+// It also checks the power save mode and listen interval the driver is
+// given, and that glasses_wifi_awake_ms_total sees the same awake time.
+//
+// Usage: program [--loop-ms N]
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "../../firmware/modules/radio_scheduler.cpp"
+
+static const uint32_t WINDOW_MS = 10000;
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+// The main loop: service() every pass, loopMs apart; the last pass of a
+// run is cut short so windows stay WINDOW_MS long
+struct Loop {
+    uint32_t loopMs;
+
+    void run(uint32_t ms) {
+        for (uint32_t elapsed = 0; elapsed < ms;) {
+            uint32_t step = std::min(loopMs, ms - elapsed);
+            HostClock::advanceMs(step);
+            RadioScheduler::service();
+            elapsed += step;
+        }
+    }
+};
+
+// The draw RadioScheduler should report for awakeMs of a window
+static float expectedMa(uint32_t awakeMs, uint32_t windowMs, uint8_t interval) {
+    float ratio = (float)awakeMs / windowMs;
+    return ratio * RadioPolicy::idleCurrentMa(true, interval) + (1 - ratio) * RadioPolicy::idleCurrentMa(false, interval);
+}
+
+static void checkDraw(Checks& checks, const char* name, float measured, uint32_t awakeMs, uint32_t loopMs,
+                      uint8_t interval) {
+    float expected = expectedMa(awakeMs, WINDOW_MS, interval);
+    // A tail ends at the first loop pass after it is due
+    float tolerance = expectedMa(loopMs, WINDOW_MS, interval) - RadioPolicy::idleCurrentMa(false, interval) + 0.01f;
+    checks.expect(fabs(measured - expected) <= tolerance, name,
+                  format("%.2f mA, %.2f mA for %.1f s awake", measured, expected, awakeMs / 1000.0));
+}
+
+static void checkWindows(Checks& checks, uint32_t loopMs) {
+    printf("Draw per window (%u ms loop):\n", loopMs);
+    Loop loop = { loopMs };
+    uint8_t interval = RadioPolicy::choose(NORMAL, 100.0f).listenInterval;
+    uint32_t metricBefore = Metrics::get(WIFI_AWAKE_MS);
+    RadioScheduler::takeCurrentMa();
+
+    loop.run(WINDOW_MS);
+    checks.expect(WiFi.getSleep() == WIFI_PS_MAX_MODEM && HostWifi::listenInterval == interval,
+                  "idle, the modem sleeps with the mode's listen interval",
+                  format("listen interval %.0f", HostWifi::listenInterval));
+    checkDraw(checks, "no request: modem sleep throughout", RadioScheduler::takeCurrentMa(), 0, loopMs, interval);
+
+    // A 2 s request and its 500 ms tail, over before the window closes
+    loop.run(1000);
+    RadioScheduler::acquire();
+    bool awake = WiFi.getSleep() == WIFI_PS_NONE;
+    loop.run(2000);
+    RadioScheduler::release();
+    loop.run(7000);
+    checks.expect(awake && WiFi.getSleep() == WIFI_PS_MAX_MODEM, "awake for the request, asleep after its tail");
+    checkDraw(checks, "a request ended in the window counts in full", RadioScheduler::takeCurrentMa(), 2500, loopMs,
+              interval);
+
+    // A request open across the end of the window
+    loop.run(8000);
+    RadioScheduler::acquire();
+    loop.run(2000);
+    checkDraw(checks, "an open request counts up to the window's end", RadioScheduler::takeCurrentMa(), 2000, loopMs,
+              interval);
+    loop.run(1000);
+    RadioScheduler::release();
+    loop.run(9000);
+    checkDraw(checks, "and the rest of it in the next window", RadioScheduler::takeCurrentMa(), 1500, loopMs,
+              interval);
+
+    // Candidate speech with nothing uploaded, then one that leads to an upload
+    RadioScheduler::expect();
+    loop.run(WINDOW_MS);
+    checkDraw(checks, "an unused early wake counts for its 3 s", RadioScheduler::takeCurrentMa(), 3000, loopMs,
+              interval);
+    RadioScheduler::expect();
+    loop.run(1000);
+    RadioScheduler::acquire();
+    loop.run(2000);
+    RadioScheduler::release();
+    loop.run(7000);
+    checkDraw(checks, "an early wake and its upload count once", RadioScheduler::takeCurrentMa(), 3500, loopMs,
+              interval);
+
+    uint32_t metric = Metrics::get(WIFI_AWAKE_MS) - metricBefore;
+    uint32_t awakeMs = 2500 + 2000 + 1500 + 3000 + 3500;
+    checks.expect(metric + 5 * loopMs >= awakeMs && metric <= awakeMs + 5 * loopMs,
+                  "glasses_wifi_awake_ms_total matches the awake time",
+                  format("%.0f ms for %.0f ms", metric, awakeMs));
+}
+
+static void checkModes(Checks& checks, uint32_t loopMs) {
+    printf("\nPower modes:\n");
+    Loop loop = { loopMs };
+    RadioScheduler::update(ECO, 100.0f);
+    RadioScheduler::takeCurrentMa();
+    RadioScheduler::acquire();
+    loop.run(1000);
+    RadioScheduler::release();
+    loop.run(WINDOW_MS - 1000);
+    uint8_t interval = RadioPolicy::choose(ECO, 100.0f).listenInterval;
+    checks.expect(HostWifi::listenInterval == interval, "eco writes its listen interval to the station config",
+                  format("%.0f beacons", HostWifi::listenInterval));
+    checkDraw(checks, "eco: the request and a 200 ms tail", RadioScheduler::takeCurrentMa(), 1200, loopMs, interval);
+
+    RadioScheduler::update(ULTRA_LOW, 100.0f);
+    RadioScheduler::expect();
+    bool ignored = WiFi.getSleep() == WIFI_PS_MAX_MODEM;
+    loop.run(WINDOW_MS);
+    interval = RadioPolicy::choose(ULTRA_LOW, 100.0f).listenInterval;
+    checks.expect(ignored, "ultra low does not wake early");
+    checkDraw(checks, "ultra low: modem sleep throughout", RadioScheduler::takeCurrentMa(), 0, loopMs, interval);
+    RadioScheduler::update(NORMAL, 100.0f);
+}
+
+int main(int argc, char** argv) {
+    uint32_t loopMs = 10;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--loop-ms") && i + 1 < argc) {
+            loopMs = std::max(1, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "Usage: %s [--loop-ms N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    HostClock::setVirtual(true);
+    Serial.setHostOutput(nullptr);
+    WiFi.begin("stand-in", "");
+    HostClock::advanceMs(1000);
+    RadioScheduler::begin();
+
+    Checks checks;
+    checkWindows(checks, loopMs);
+    checkModes(checks, loopMs);
+
+    if (checks.failed) {
+        printf("\n%d check(s) failed\n", checks.failed);
+        return 1;
+    }
+    printf("\nAll checks passed\n");
+    return 0;
+}
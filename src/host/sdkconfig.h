@@ -0,0 +1,13 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+// The options of the Arduino core's prebuilt sdkconfig that the firmware
+// checks for. On the host the TLS backend (mbedtls/ssl.h) stands in for the
+// accelerators.
+#define CONFIG_IDF_TARGET_ESP32S3 1
+#define CONFIG_MBEDTLS_HARDWARE_AES 1
+#define CONFIG_MBEDTLS_HARDWARE_SHA 1
+#define CONFIG_MBEDTLS_HARDWARE_MPI 1
+#define CONFIG_MBEDTLS_CLIENT_SSL_SESSION_TICKETS 1
+
+#endif
@@ -0,0 +1,694 @@
+// Firmware-in-the-loop simulator (pio run -e native_sim).
+// Runs main.cpp's setup()/loop() unchanged in virtual time against scripted
+// speech, touch, battery and Wi-Fi traces and an in-process stand-in server,
+// then prints a per-command latency and energy report.
+//
+// Usage: program <session.txt> [--seed N] [--duration S] [--out report.txt] [--verbose]
+//
+// Nothing depends on the host's speed or scheduling: the clock only moves when
+// the firmware waits (delay, I2S DMA, I2C transfers, HTTP), firmware tasks are
+// refused so everything runs on one thread, and all randomness comes from the
+// session seed. The same session and seed always give the same report.
+// An ESP.restart() from the firmware ends the run and fails the report
+// (exit status 1).
+//
+// Session file, one directive per line ('#' starts a comment):
+//   seed <n>                       random seed (overridden by --seed)
+//   duration <s>                   virtual seconds to run (default 60)
+//   noise <amplitude>              microphone noise floor (default 60)
+//   server <command_ms> <audio_ms> <sigma>
+//                                  median stand-in server latencies and
+//                                  log-normal spread (default 600 900 0.35)
+//   uplink_kbps <kbps>             upload throughput (default 2000)
+//   <t> speech <s> [level]         synthetic voiced speech for s seconds
+//   <t> wav <file> [gain]          16 kHz mono 16-bit WAV, relative to the session
+//   <t> tap | double_tap           touch gestures
+//   <t> long_press [s]             hold the pad (default 1.0 s)
+//   <t> battery <cell_mv>          cell voltage breakpoint, linear in between
+//   <t> wifi_drop <s>              access point gone for s seconds
+//   <t> rssi <dbm>
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../host_wav.h"
+#include "../../firmware/main_dir/main.cpp"
+
+// ---------------------------------------------------------------- Session
+
+struct SpeechSegment {
+    double startS;
+    double endS;
+    float level;                   // Synthetic: peak amplitude, WAV: gain
+    float pitchHz;                 // Synthetic only
+    std::vector<int16_t> samples;  // WAV only
+    bool matched = false;
+};
+
+enum SimAction {
+    ACT_TOUCH,        // value: touch reading
+    ACT_AP,           // value: 1 in range, 0 gone
+    ACT_RSSI,
+    ACT_BATTERY       // value: cell millivolts
+};
+
+struct SimEvent {
+    double timeS;
+    SimAction action;
+    int value;
+};
+
+struct Session {
+    std::string name;
+    uint64_t seed = 1;
+    double durationS = 60.0;
+    float noise = 60.0f;
+    float commandMs = 600.0f;
+    float audioMs = 900.0f;
+    float sigma = 0.35f;
+    uint32_t uplinkKbps = 2000;
+    std::vector<SpeechSegment> speech;
+    std::vector<SimEvent> events;
+};
+
+static bool loadSession(const std::string& path, Session& session, std::string& error) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+    session.name = path.substr(path.find_last_of('/') + 1);
+    std::string dir = path.find('/') == std::string::npos ? "" : path.substr(0, path.find_last_of('/') + 1);
+
+    // Battery breakpoints are expanded once the whole file is read
+    std::vector<std::pair<double, int>> battery;
+    char line[512];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNo++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char word[64] = "";
+        char arg[256] = "";
+        double t = 0, a = 0, b = 0, c = 0;
+
+        if (sscanf(line, " %63s", word) != 1) continue;
+        std::string key = word;
+        bool ok = true;
+        if (key == "seed") {
+            unsigned long long seed;
+            ok = sscanf(line, " %*s %llu", &seed) == 1;
+            session.seed = seed;
+        } else if (key == "duration") {
+            ok = sscanf(line, " %*s %lf", &session.durationS) == 1;
+        } else if (key == "noise") {
+            ok = sscanf(line, " %*s %lf", &a) == 1;
+            session.noise = a;
+        } else if (key == "server") {
+            ok = sscanf(line, " %*s %lf %lf %lf", &a, &b, &c) == 3;
+            session.commandMs = a;
+            session.audioMs = b;
+            session.sigma = c;
+        } else if (key == "uplink_kbps") {
+            ok = sscanf(line, " %*s %lf", &a) == 1 && a > 0;
+            session.uplinkKbps = (uint32_t)a;
+        } else if (sscanf(line, " %lf %63s", &t, word) == 2) {
+            std::string event = word;
+            int count = sscanf(line, " %*f %*s %255s %lf", arg, &b);
+            if (event == "speech" && count >= 1) {
+                SpeechSegment segment;
+                segment.startS = t;
+                segment.endS = t + atof(arg);
+                segment.level = count == 2 ? b : 4000.0f;
+                segment.pitchHz = 0;     // Drawn from the seed when the run starts
+                session.speech.push_back(segment);
+            } else if (event == "wav" && count >= 1) {
+                SpeechSegment segment;
+                std::string wavPath = arg[0] == '/' ? std::string(arg) : dir + arg;
+                if (!loadWav(wavPath, AudioDriver::SAMPLE_RATE, segment.samples, error)) {
+                    fclose(file);
+                    return false;
+                }
+                segment.startS = t;
+                segment.endS = t + (double)segment.samples.size() / AudioDriver::SAMPLE_RATE;
+                segment.level = count == 2 ? b : 1.0f;
+                segment.pitchHz = 0;
+                session.speech.push_back(segment);
+            } else if (event == "tap" || event == "double_tap") {
+                session.events.push_back({ t, ACT_TOUCH, 10 });
+                session.events.push_back({ t + 0.12, ACT_TOUCH, HostGpio::TOUCH_IDLE });
+                if (event == "double_tap") {
+                    session.events.push_back({ t + 0.24, ACT_TOUCH, 10 });
+                    session.events.push_back({ t + 0.36, ACT_TOUCH, HostGpio::TOUCH_IDLE });
+                }
+            } else if (event == "long_press") {
+                double hold = count >= 1 ? atof(arg) : 1.0;
+                session.events.push_back({ t, ACT_TOUCH, 10 });
+                session.events.push_back({ t + hold, ACT_TOUCH, HostGpio::TOUCH_IDLE });
+            } else if (event == "battery" && count >= 1) {
+                battery.push_back({ t, atoi(arg) });
+            } else if (event == "wifi_drop" && count >= 1) {
+                session.events.push_back({ t, ACT_AP, 0 });
+                session.events.push_back({ t + atof(arg), ACT_AP, 1 });
+            } else if (event == "rssi" && count >= 1) {
+                session.events.push_back({ t, ACT_RSSI, atoi(arg) });
+            } else {
+                ok = false;
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            error = path + ":" + std::to_string(lineNo) + ": cannot parse '" + key + "'";
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+
+    // Battery: one breakpoint every 100 ms of virtual time between the given points
+    std::sort(battery.begin(), battery.end());
+    if (battery.empty()) battery.push_back({ 0.0, 4000 });
+    session.events.push_back({ 0.0, ACT_BATTERY, battery[0].second });
+    for (size_t i = 1; i < battery.size(); i++) {
+        double t0 = battery[i - 1].first, t1 = battery[i].first;
+        int v0 = battery[i - 1].second, v1 = battery[i].second;
+        for (double t = t0 + 0.1; t < t1; t += 0.1) {
+            session.events.push_back({ t, ACT_BATTERY, (int)lround(v0 + (v1 - v0) * (t - t0) / (t1 - t0)) });
+        }
+        session.events.push_back({ t1, ACT_BATTERY, v1 });
+    }
+
+    std::stable_sort(session.events.begin(), session.events.end(),
+                     [](const SimEvent& a, const SimEvent& b) { return a.timeS < b.timeS; });
+    std::sort(session.speech.begin(), session.speech.end(),
+              [](const SpeechSegment& a, const SpeechSegment& b) { return a.startS < b.startS; });
+    return true;
+}
+
+// ---------------------------------------------------------------- Board models
+
+// Microphone scene: noise plus every speech segment active at each sample
+class MicScene {
+public:
+    MicScene(Session& session, HostRandom& rng) : session(session), rng(rng) {}
+
+    size_t fill(int16_t* out, size_t count) {
+        double startS = HostI2s::getStartUs(I2S_NUM_0) / 1e6;
+        for (size_t i = 0; i < count; i++, index++) {
+            double t = startS + (double)index / AudioDriver::SAMPLE_RATE;
+            float value = session.noise * (2.0f * (float)rng.uniform() - 1.0f);
+            for (const SpeechSegment& segment : session.speech) {
+                if (t < segment.startS) break;
+                if (t >= segment.endS) continue;
+                value += speechSample(segment, t - segment.startS);
+            }
+            out[i] = (int16_t)std::max(-32768.0f, std::min(32767.0f, value));
+        }
+        return count;
+    }
+
+private:
+    Session& session;
+    HostRandom& rng;
+    uint64_t index = 0;
+
+    static float speechSample(const SpeechSegment& segment, double t) {
+        if (!segment.samples.empty()) {
+            size_t i = (size_t)(t * AudioDriver::SAMPLE_RATE);
+            return i < segment.samples.size() ? segment.samples[i] * segment.level : 0.0f;
+        }
+        // Voiced tone with two harmonics, amplitude-modulated at a syllable rate
+        double phase = 2.0 * M_PI * segment.pitchHz * t;
+        double voiced = 0.7 * sin(phase) + 0.2 * sin(2 * phase) + 0.1 * sin(3 * phase);
+        double syllables = 0.6 + 0.4 * sin(2.0 * M_PI * 4.0 * t);
+        return (float)(segment.level * voiced * syllables);
+    }
+};
+
+// SSD1306 at the profile's address: follows the panel on/off and contrast commands
+class OledModel : public HostI2cDevice {
+public:
+    bool panelOn = false;
+    uint8_t contrast = 0x7F;
+
+    void onWrite(const uint8_t* data, size_t length) override {
+        if (length == 0 || data[0] != 0x00) return;   // 0x40 = framebuffer data
+        // Argument bytes of the other commands the driver sends never equal these
+        for (size_t i = 1; i < length; i++) {
+            if (data[i] == 0xAE) panelOn = false;
+            else if (data[i] == 0xAF) panelOn = true;
+            else if (data[i] == 0x81 && i + 1 < length) contrast = data[++i];
+        }
+    }
+};
+
+// Same component figures as scripts/energy_model.py, in mA
+struct SimCurrents {
+    static float cpuIdle(int mhz) { return interpolate(mhz, IDLE_MA); }
+
+    // Associated and idle: awake, or asleep and waking every few beacons
+    static float wifiIdle(bool powerSave, uint32_t wakeBeacons) {
+        if (!powerSave) return WIFI_CONNECTED_IDLE;
+        return WIFI_PS_FLOOR + WIFI_CONNECTED_IDLE * WIFI_BEACON_AWAKE_MS / (wakeBeacons * 102.4f);
+    }
+
+    static constexpr float LIGHT_SLEEP = 0.24f;
+    static constexpr float WIFI_TX = 190.0f;
+    static constexpr float WIFI_RX = 85.0f;
+    static constexpr float WIFI_CONNECTED_IDLE = 80.0f;
+    static constexpr float WIFI_PS_FLOOR = 3.0f;        // Modem asleep
+    static constexpr float WIFI_BEACON_AWAKE_MS = 21.8f; // Per wake: beacon and broadcast wait; DTIM1 averages 20 mA
+    static constexpr float DISPLAY_ON = 12.0f;          // At the driver's 0x8F contrast
+    static constexpr float DISPLAY_LOGIC = 0.4f;
+    static constexpr float DISPLAY_OFF = 0.02f;
+    static constexpr float MIC = 1.4f;
+    static constexpr float BASE = 1.5f;
+
+private:
+    // 40, 80, 160, 240 MHz
+    static constexpr float IDLE_MA[4] = { 10.0f, 15.0f, 22.0f, 27.0f };
+
+    static float interpolate(int mhz, const float* table) {
+        static const int clocks[4] = { 40, 80, 160, 240 };
+        if (mhz <= clocks[0]) return table[0];
+        for (int i = 1; i < 4; i++) {
+            if (mhz <= clocks[i]) {
+                float frac = (float)(mhz - clocks[i - 1]) / (clocks[i] - clocks[i - 1]);
+                return table[i - 1] + frac * (table[i] - table[i - 1]);
+            }
+        }
+        return table[3];
+    }
+};
+
+enum EnergyPart { PART_CPU, PART_WIFI, PART_DISPLAY, PART_MIC, PART_BASE, PART_COUNT };
+static const char* const PART_NAMES[PART_COUNT] = { "cpu", "wifi", "display", "mic", "base" };
+
+// Integrates the current of each part over every clock advance. Firmware code
+// itself takes no virtual time, so the CPU is charged at its idle current for
+// the clock DFS would be running while the firmware waits.
+class EnergyMeter {
+public:
+    explicit EnergyMeter(const OledModel& oled) : oled(oled) {}
+
+    void integrate(uint64_t fromUs, uint64_t toUs) {
+        double seconds = (toUs - fromUs) / 1e6;
+        float parts[PART_COUNT];
+        currents(parts);
+        for (int i = 0; i < PART_COUNT; i++) {
+            mAs[i] += parts[i] * seconds;
+            totalMAs += parts[i] * seconds;
+        }
+        timeline.push_back({ toUs, totalMAs });
+    }
+
+    // Charge drawn up to a point inside the kept timeline, mA·s
+    double chargeAt(uint64_t us) const {
+        if (timeline.empty() || us <= timeline.front().us) return timeline.empty() ? totalMAs : timeline.front().mAs;
+        for (size_t i = 1; i < timeline.size(); i++) {
+            const Point& a = timeline[i - 1];
+            const Point& b = timeline[i];
+            if (us <= b.us) {
+                return b.us == a.us ? b.mAs : a.mAs + (b.mAs - a.mAs) * (double)(us - a.us) / (b.us - a.us);
+            }
+        }
+        return totalMAs;
+    }
+
+    // Forget history before the last point once it has been looked up
+    void trim() {
+        if (timeline.size() > 1) timeline.erase(timeline.begin(), timeline.end() - 1);
+    }
+
+    double partMAs(int part) const { return mAs[part]; }
+    double total() const { return totalMAs; }
+
+private:
+    struct Point {
+        uint64_t us;
+        double mAs;
+    };
+
+    const OledModel& oled;
+    double mAs[PART_COUNT] = {};
+    double totalMAs = 0;
+    std::vector<Point> timeline;
+
+    void currents(float* parts) const {
+        // The I2S driver holds an APB lock while streaming, which rules out light sleep
+        bool sleeps = HostPm::config.light_sleep_enable && HostPm::locksHeld == 0 && !HostI2s::isRunning(I2S_NUM_0);
+        parts[PART_CPU] = sleeps ? SimCurrents::LIGHT_SLEEP : SimCurrents::cpuIdle(HostPm::effectiveMhz());
+
+        switch (HostWifi::radio()) {
+            case HostWifi::RADIO_TX:   parts[PART_WIFI] = SimCurrents::WIFI_TX; break;
+            case HostWifi::RADIO_RX:
+            case HostWifi::RADIO_SCAN: parts[PART_WIFI] = SimCurrents::WIFI_RX; break;
+            case HostWifi::RADIO_IDLE:
+                parts[PART_WIFI] = SimCurrents::wifiIdle(HostWifi::powerSave != WIFI_PS_NONE, HostWifi::wakeBeacons());
+                break;
+            default:                   parts[PART_WIFI] = 0.0f; break;
+        }
+
+        parts[PART_DISPLAY] = oled.panelOn
+            ? SimCurrents::DISPLAY_LOGIC + (SimCurrents::DISPLAY_ON - SimCurrents::DISPLAY_LOGIC) * oled.contrast / 0x8F
+            : SimCurrents::DISPLAY_OFF;
+        parts[PART_MIC] = HostI2s::isRunning(I2S_NUM_0) ? SimCurrents::MIC : 0.0f;
+        parts[PART_BASE] = SimCurrents::BASE;
+    }
+};
+
+// Stand-in for the AI server: answers the firmware's routes with seeded,
+// log-normally distributed processing times
+class StandInServer {
+public:
+    uint32_t commands = 0;
+    uint32_t audioUploads = 0;
+    uint32_t metricsPushes = 0;
+
+    StandInServer(const Session& session, HostRandom& rng) : session(session), rng(rng) {}
+
+    HostHttpResponse handle(const HostHttpRequest& request) {
+        HostHttpResponse response;
+        if (request.url.endsWith("/audio")) {
+            response.body = "{\"status\":\"ok\"}";
+            // Chunks before the final one are only acknowledged
+            if (request.header("X-Audio-Final") == "0") {
+                return response;
+            }
+            audioUploads++;
+            response.latencyMs = latency(session.audioMs);
+        } else if (request.url.endsWith("/telemetry/metrics")) {
+            metricsPushes++;
+            response.latencyMs = latency(40.0f);
+        } else if (request.url.endsWith("/ota/update")) {
+            // Already on the latest firmware; fixed latency keeps the seeded
+            // draws of the other routes where they were
+            response.code = 204;
+            response.latencyMs = 40;
+        } else {
+            commands++;
+            response.body = "{\"response\":\"" + String(ANSWERS[commands % 4]) + "\"}";
+            response.latencyMs = latency(session.commandMs);
+        }
+        return response;
+    }
+
+private:
+    static constexpr const char* ANSWERS[4] = {
+        "It is 14:05",
+        "Light rain expected after six, take an umbrella",
+        "Your next meeting is in 25 minutes in room 3B",
+        "Turning left in 200 meters onto Market Street"
+    };
+
+    const Session& session;
+    HostRandom& rng;
+
+    uint32_t latency(float medianMs) {
+        return (uint32_t)lround(rng.logNormal(medianMs, session.sigma));
+    }
+};
+
+// ---------------------------------------------------------------- Simulation
+
+struct CommandRecord {
+    int speech = -1;               // Index into Session::speech, -1 for a false trigger
+    bool retrigger = false;        // Second capture of an already answered segment
+    uint64_t captureStartUs = 0;
+    double captureMs = 0, uploadMs = 0, serverMs = 0, renderMs = 0;
+    uint64_t renderEndUs = 0;
+    bool rendered = false;
+    double chargeUAh = 0;
+};
+
+class Simulator {
+public:
+    Simulator(Session& session, uint64_t seed)
+        : session(session), rng(seed), mic(session, rng), meter(oled), server(session, rng) {
+        for (SpeechSegment& segment : session.speech) {
+            if (segment.samples.empty()) segment.pitchHz = 100.0f + 120.0f * (float)rng.uniform();
+        }
+    }
+
+    void run() {
+        HostClock::setVirtual(true);
+        HostClock::setAdvanceHook([this](uint64_t fromUs, uint64_t toUs) {
+            meter.integrate(fromUs, toUs);
+            applyEvents(toUs);
+        });
+        HostI2c::attach(Board::Display::ADDRESS, &oled);
+        HostI2s::setSource(I2S_NUM_0, [this](int16_t* out, size_t count) { return mic.fill(out, count); });
+        HostHttp::setHandler([this](const HostHttpRequest& request) { return server.handle(request); });
+        HostHttp::uplinkBitsPerSecond = session.uplinkKbps * 1000;
+        applyEvents(0);
+
+        setup();
+        if (!verbose) {
+            // setup() turns debug logging on; nobody reads it here
+            Logger::setLogLevel(LOG_NONE);
+        }
+
+        // A restart would bring the device up from scratch, which main.cpp's
+        // globals and loop() statics cannot do in-process; the run ends there
+        uint64_t endUs = (uint64_t)(session.durationS * 1e6);
+        while (HostClock::nowUs() < endUs && ESP.getRestartCount() == 0) {
+            loop();
+            collectSpans();
+        }
+        if (ESP.getRestartCount() > 0) {
+            restartUs = HostClock::nowUs();
+        }
+        if (pending.captureStartUs) finish(pending);
+        HostClock::setAdvanceHook(nullptr);
+    }
+
+    void report(FILE* out, uint64_t seed) {
+        fprintf(out, "Session %s, seed %llu, %.1f s virtual\n\n", session.name.c_str(),
+                (unsigned long long)seed, HostClock::nowUs() / 1e6);
+
+        fprintf(out, "%3s %9s %9s %9s %9s %9s %9s %10s %9s\n", "#", "spoken_s", "detect_ms", "capture_ms",
+                "upload_ms", "server_ms", "render_ms", "answer_ms", "uAh");
+        std::vector<double> detect, answer, charge;
+        int falseTriggers = 0;
+        for (size_t i = 0; i < commands.size(); i++) {
+            const CommandRecord& c = commands[i];
+            char spoken[16] = "-";
+            char detectMs[16] = "-";
+            char answerMs[16] = "-";
+            if (c.speech >= 0 && !c.retrigger) {
+                const SpeechSegment& s = session.speech[c.speech];
+                double d = c.captureStartUs / 1e3 - s.startS * 1e3;
+                snprintf(spoken, sizeof(spoken), "%.3f", s.startS);
+                snprintf(detectMs, sizeof(detectMs), "%.0f", d);
+                detect.push_back(d);
+                if (c.rendered) {
+                    double a = c.renderEndUs / 1e3 - s.endS * 1e3;
+                    snprintf(answerMs, sizeof(answerMs), "%.0f", a);
+                    answer.push_back(a);
+                }
+            } else {
+                falseTriggers++;
+                snprintf(spoken, sizeof(spoken), c.retrigger ? "again" : "false");
+            }
+            charge.push_back(c.chargeUAh);
+            fprintf(out, "%3zu %9s %9s %10.0f %9.0f %9.0f %9.1f %10s %9.1f\n", i + 1, spoken, detectMs,
+                    c.captureMs, c.uploadMs, c.serverMs, c.renderMs, answerMs, c.chargeUAh);
+        }
+
+        int spoken = 0;
+        int missed = 0;
+        for (const SpeechSegment& s : session.speech) {
+            if (s.startS >= session.durationS) continue;
+            spoken++;
+            if (!s.matched) missed++;
+        }
+        fprintf(out, "\nSpeech segments %d, answered %zu, missed %d, false or repeated triggers %d\n",
+                spoken, answer.size(), missed, falseTriggers);
+        printSpread(out, "detect_ms", detect);
+        printSpread(out, "answer_ms", answer);
+        printSpread(out, "uAh/command", charge);
+
+        double hours = HostClock::nowUs() / 3.6e9;
+        fprintf(out, "\nEnergy %.3f mAh, average %.2f mA\n", meter.total() / 3600.0, meter.total() / 3600.0 / hours);
+        for (int i = 0; i < PART_COUNT; i++) {
+            fprintf(out, "  %-8s %8.3f mAh %7.2f mA\n", PART_NAMES[i], meter.partMAs(i) / 3600.0,
+                    meter.partMAs(i) / 3600.0 / hours);
+        }
+
+        fprintf(out, "\nBoot ready %u ms, complete %u ms\n", boot.getReadyMs(), boot.getCompleteMs());
+        for (uint8_t i = 0; i < boot.getStepCount(); i++) {
+            const BootOrchestrator::Step& step = boot.getStep(i);
+            fprintf(out, "  %-10s %6u ms +%6u ms %s\n", step.name, step.startMs, step.endMs - step.startMs,
+                    step.status == BOOT_DONE ? "ok" : step.status == BOOT_FAILED ? "failed" : "running");
+        }
+
+        fprintf(out, "\nBattery %.0f%% at end\n", powerModule.getBatteryLevel());
+        fprintf(out, "Network %u requests (%u command, %u audio, %u metrics), %u errors, %u reconnects\n",
+                HostHttp::getRequestCount(), server.commands, server.audioUploads, server.metricsPushes,
+                Metrics::get(NET_ERRORS), Metrics::get(NET_RECONNECTS));
+        fprintf(out, "Audio %u VAD triggers, %u overruns\n", Metrics::get(AUDIO_VAD_TRIGGERS), Metrics::get(AUDIO_OVERRUNS));
+        if (restarted()) {
+            fprintf(out, "\nFAILED: the firmware restarted the device at %.1f s of %.1f s; the run stops there\n",
+                    restartUs / 1e6, session.durationS);
+        }
+    }
+
+    bool restarted() const {
+        return restartUs > 0;
+    }
+
+    void setVerbose(bool enabled) {
+        verbose = enabled;
+    }
+
+private:
+    Session& session;
+    HostRandom rng;
+    MicScene mic;
+    OledModel oled;
+    EnergyMeter meter;
+    StandInServer server;
+    size_t nextEvent = 0;
+    bool verbose = false;
+    uint64_t restartUs = 0;                 // When the firmware called ESP.restart()
+    std::vector<CommandRecord> commands;
+    CommandRecord pending;
+
+    void applyEvents(uint64_t nowUs) {
+        while (nextEvent < session.events.size() && session.events[nextEvent].timeS * 1e6 <= nowUs) {
+            const SimEvent& event = session.events[nextEvent++];
+            switch (event.action) {
+                case ACT_TOUCH:
+                    HostGpio::setTouch(Board::Touch::PIN, event.value);
+                    break;
+                case ACT_AP:
+                    HostWifi::apAvailable = event.value != 0;
+                    if (!event.value) HostWifi::dropLink();
+                    break;
+                case ACT_RSSI:
+                    HostWifi::rssi = event.value;
+                    break;
+                case ACT_BATTERY:
+                    // Both cells through the board's dividers
+                    HostGpio::setMilliVolts(Board::Battery::PIN1, (uint32_t)(event.value / Board::Battery::DIVIDER));
+                    HostGpio::setMilliVolts(Board::Battery::PIN2, (uint32_t)(event.value / Board::Battery::DIVIDER));
+                    break;
+            }
+        }
+    }
+
+    // Turn the spans recorded during the last loop() into command records
+    void collectSpans() {
+        static TraceEvent spans[TRACE_RING_SIZE * TRACE_MAX_TASKS];
+        size_t count = Tracer::readEvents(spans, TRACE_RING_SIZE * TRACE_MAX_TASKS);
+        Tracer::clear();
+
+        uint64_t now = HostClock::nowUs();
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent& span = spans[i];
+            // micros() is 32-bit; recover the full start time from the current one
+            uint64_t startUs = now - (uint32_t)((uint32_t)now - span.startUs);
+            double ms = span.durationUs / 1e3;
+
+            switch (span.stage) {
+                case TRACE_CAPTURE:
+                    if (pending.captureStartUs) finish(pending);
+                    pending = CommandRecord();
+                    pending.captureStartUs = startUs;
+                    pending.captureMs = ms;
+                    break;
+                case TRACE_UPLOAD:      pending.uploadMs += ms; break;
+                case TRACE_SERVER_WAIT: pending.serverMs += ms; break;
+                case TRACE_RENDER:
+                    pending.renderMs += ms;
+                    pending.renderEndUs = startUs + (uint64_t)(ms * 1e3);
+                    pending.rendered = true;
+                    if (pending.captureStartUs) finish(pending);
+                    break;
+            }
+        }
+        if (!pending.captureStartUs) meter.trim();
+    }
+
+    void finish(CommandRecord& command) {
+        uint64_t endUs = command.rendered ? command.renderEndUs : HostClock::nowUs();
+        command.chargeUAh = (meter.chargeAt(endUs) - meter.chargeAt(command.captureStartUs)) / 3.6;
+
+        // Attribute to the latest segment that started before the capture, if it
+        // was still going or ended within the last second
+        double captureS = command.captureStartUs / 1e6;
+        for (int i = (int)session.speech.size() - 1; i >= 0; i--) {
+            SpeechSegment& segment = session.speech[i];
+            if (segment.startS > captureS) continue;
+            if (captureS <= segment.endS + 1.0) {
+                command.speech = i;
+                command.retrigger = segment.matched;
+                segment.matched = true;
+            }
+            break;
+        }
+        commands.push_back(command);
+        pending = CommandRecord();
+    }
+
+    static void printSpread(FILE* out, const char* name, std::vector<double> values) {
+        if (values.empty()) return;
+        std::sort(values.begin(), values.end());
+        auto rank = [&](double q) { return values[(size_t)ceil(q * values.size()) - 1]; };
+        fprintf(out, "  %-12s p50 %8.1f  p90 %8.1f  max %8.1f\n", name, rank(0.5), rank(0.9), values.back());
+    }
+};
+
+int main(int argc, char** argv) {
+    const char* sessionPath = nullptr;
+    const char* outPath = nullptr;
+    long long seedOverride = -1;
+    double durationOverride = 0;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seedOverride = atoll(argv[++i]);
+        else if (arg == "--duration" && i + 1 < argc) durationOverride = atof(argv[++i]);
+        else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+        else if (arg == "--verbose") verbose = true;
+        else if (sessionPath == nullptr && arg[0] != '-') sessionPath = argv[i];
+        else {
+            fprintf(stderr, "Usage: %s <session.txt> [--seed N] [--duration S] [--out FILE] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (sessionPath == nullptr) {
+        fprintf(stderr, "Usage: %s <session.txt> [--seed N] [--duration S] [--out FILE] [--verbose]\n", argv[0]);
+        return 2;
+    }
+
+    Session session;
+    std::string error;
+    if (!loadSession(sessionPath, session, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    uint64_t seed = seedOverride >= 0 ? (uint64_t)seedOverride : session.seed;
+    if (durationOverride > 0) session.durationS = durationOverride;
+
+    // Firmware logs would interleave with the report
+    Serial.setHostOutput(verbose ? stderr : nullptr);
+    Simulator simulator(session, seed);
+    simulator.setVerbose(verbose);
+    simulator.run();
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if (out == nullptr) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 1;
+    }
+    simulator.report(out, seed);
+    if (outPath) fclose(out);
+    return simulator.restarted() ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#ifndef HOST_SOC_GPIO_REG_H
+#define HOST_SOC_GPIO_REG_H
+
+// ESP32-S3 GPIO matrix register addresses (subset of soc/gpio_reg.h)
+
+#define DR_REG_GPIO_BASE 0x60004000
+
+#define GPIO_OUT_REG (DR_REG_GPIO_BASE + 0x0004)
+#define GPIO_OUT_W1TS_REG (DR_REG_GPIO_BASE + 0x0008)
+#define GPIO_OUT_W1TC_REG (DR_REG_GPIO_BASE + 0x000C)
+#define GPIO_OUT1_REG (DR_REG_GPIO_BASE + 0x0010)
+#define GPIO_OUT1_W1TS_REG (DR_REG_GPIO_BASE + 0x0014)
+#define GPIO_OUT1_W1TC_REG (DR_REG_GPIO_BASE + 0x0018)
+#define GPIO_ENABLE_W1TS_REG (DR_REG_GPIO_BASE + 0x0024)
+#define GPIO_ENABLE_W1TC_REG (DR_REG_GPIO_BASE + 0x0028)
+#define GPIO_ENABLE1_W1TS_REG (DR_REG_GPIO_BASE + 0x0030)
+#define GPIO_ENABLE1_W1TC_REG (DR_REG_GPIO_BASE + 0x0034)
+#define GPIO_IN_REG (DR_REG_GPIO_BASE + 0x003C)
+#define GPIO_IN1_REG (DR_REG_GPIO_BASE + 0x0040)
+
+#endif
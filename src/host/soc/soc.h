@@ -0,0 +1,13 @@
+#ifndef HOST_SOC_SOC_H
+#define HOST_SOC_SOC_H
+
+#include <stdint.h>
+#include "../host_hal.h"
+
+// Register access goes to the simulated GPIO matrix in HostGpio; it is the
+// only peripheral the firmware touches through raw registers
+
+#define REG_WRITE(reg, value) HostGpio::writeRegister((uint32_t)(reg), (uint32_t)(value))
+#define REG_READ(reg) HostGpio::readRegister((uint32_t)(reg))
+
+#endif
@@ -0,0 +1,855 @@
+// TLS transport harness (pio run -e native_tls).
+// Checks the TLS credentials in NVS, then connects TlsTransport to a local
+// TLS stand-in again and again, four ways:
+// - certificate, full: a new transport for every connection, as HTTPClient
+//   makes one for every request
+// - certificate, resumed: one transport, which offers its session ticket
+// - PSK, full / PSK, resumed: the same with ECDHE-PSK
+// and reports handshake time, round trips, bytes and host CPU time. Last,
+// NetworkModule over https://: the multiplexed connection, the HTTP fallback
+// while it is down, and the resumed reconnect.
+//
+// Usage: program [--connections N] [--rtt-ms N] [--uplink-kbps N]
+//                [--ecdhe-ms N] [--certificate-ms N]
+//
+// The stand-in is OpenSSL in this process, limited to TLS 1.2 as mbedtls
+// 2.28 speaks it, with an RSA-2048 certificate as the server's cert.pem, a
+// PSK table and session tickets; after the handshake it speaks GET /mux and
+// answers every stream at once. The device side is TlsTransport over the
+// mbedtls shim with an OpenSSL engine (HostTls). Time is virtual: the link
+// adds the round trip and the uplink rate, and the engine charges the S3's
+// share of the handshake (ECDHE_MS and the rest below), since this host does
+// it in microseconds.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include "../../firmware/modules/network_module.cpp"
+
+static const size_t SEND_BUFFER = 5744;         // lwIP TCP_SND_BUF on the S3
+static const uint32_t DOWNLINK_BPS = 20000000;
+static const char* HOST = "stand-in";
+static const uint16_t PORT = 8443;
+static const char* IDENTITY = "glasses-240ac4000001";
+
+// Estimates for mbedtls on the S3 at 240 MHz, charged to the clock by the
+// engine; the device's own figures are in the glasses_tls_handshake_ms
+// histograms. --ecdhe-ms and --certificate-ms replace the first two.
+static uint32_t ecdheMs = 90;           // P-256 key pair and shared secret, in software
+static uint32_t certificateMs = 15;     // Parse the certificate, two RSA-2048 verifies on the MPI unit
+static const uint32_t SYMMETRIC_MS = 2; // PRF, Finished and records on the SHA and AES units
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(q * (values.size() - 1) + 0.5)];
+}
+
+// ---------------------------------------------------------------------------
+// The device's side: OpenSSL behind the mbedtls shim
+
+// What the last client connection did
+struct EngineReport {
+    bool keyExchange = false;
+    bool certificate = false;
+    bool resumed = false;
+    uint64_t cpuUs = 0;
+};
+
+static EngineReport lastEngine;
+
+static const char* cipherName(int id) {
+    switch (id) {
+        case MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256: return "ECDHE-PSK-AES128-CBC-SHA256";
+        case MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256: return "ECDHE-RSA-AES128-GCM-SHA256";
+        case MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256: return "ECDHE-ECDSA-AES128-GCM-SHA256";
+        default: return nullptr;
+    }
+}
+
+class OpenSslEngine : public HostTlsEngine {
+public:
+    explicit OpenSslEngine(const HostTlsParams& params) : params(params) {
+        lastEngine = EngineReport();
+        ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+        std::string ciphers;
+        for (int id : params.ciphersuites) {
+            if (cipherName(id) == nullptr) continue;
+            ciphers += (ciphers.empty() ? "" : ":") + std::string(cipherName(id));
+        }
+        SSL_CTX_set_cipher_list(ctx, ciphers.c_str());
+        SSL_CTX_set1_groups_list(ctx, "P-256");
+        if (!params.tickets) SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        if (params.verify) {
+            BIO* bio = BIO_new_mem_buf(params.caPem.data(), params.caPem.size());
+            X509* cert;
+            while ((cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr)) != nullptr) {
+                X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx), cert);
+                X509_free(cert);
+            }
+            BIO_free(bio);
+            ERR_clear_error();
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+        }
+        ssl = SSL_new(ctx);
+        SSL_set_app_data(ssl, this);
+        if (!params.psk.empty()) SSL_set_psk_client_callback(ssl, onPsk);
+        if (params.verify) SSL_set1_host(ssl, params.hostname.c_str());
+        SSL_set_tlsext_host_name(ssl, params.hostname.c_str());
+        if (params.session) SSL_set_session(ssl, (SSL_SESSION*)params.session.get());
+        SSL_set_msg_callback(ssl, onMessage);
+        SSL_set_msg_callback_arg(ssl, this);
+        in = BIO_new(BIO_s_mem());
+        out = BIO_new(BIO_s_mem());
+        SSL_set_bio(ssl, in, out);
+        SSL_set_connect_state(ssl);
+    }
+
+    ~OpenSslEngine() override {
+        SSL_free(ssl);
+        SSL_CTX_free(ctx);
+    }
+
+    void receive(const uint8_t* data, size_t length) override {
+        BIO_write(in, data, length);
+    }
+
+    std::string takeOutput() override {
+        std::string bytes(BIO_pending(out), '\0');
+        if (!bytes.empty()) BIO_read(out, &bytes[0], bytes.size());
+        return bytes;
+    }
+
+    int handshake() override {
+        if (done) return 1;
+        auto start = std::chrono::steady_clock::now();
+        int ret = SSL_do_handshake(ssl);
+        lastEngine.cpuUs += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        // The S3 works before it sends the flight
+        if (lastEngine.keyExchange && !charged) {
+            charged = true;
+            HostClock::advanceMs(ecdheMs + (lastEngine.certificate ? certificateMs : 0));
+        }
+        if (ret == 1) {
+            done = true;
+            lastEngine.resumed = SSL_session_reused(ssl);
+            HostClock::advanceMs(SYMMETRIC_MS);
+            return 1;
+        }
+        int error = SSL_get_error(ssl, ret);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) return 0;
+        ERR_clear_error();
+        return -1;
+    }
+
+    bool keyExchanged() override {
+        return lastEngine.keyExchange;
+    }
+
+    int read(uint8_t* data, size_t length) override {
+        char probe;
+        int ret = length == 0 ? SSL_peek(ssl, &probe, 1) : SSL_read(ssl, data, length);
+        if (ret > 0) return length == 0 ? 0 : ret;
+        int error = SSL_get_error(ssl, ret);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) return 0;
+        ERR_clear_error();
+        return -1;
+    }
+
+    int write(const uint8_t* data, size_t length) override {
+        int ret = SSL_write(ssl, data, length);
+        return ret > 0 ? ret : -1;
+    }
+
+    size_t pending() override {
+        return SSL_pending(ssl);
+    }
+
+    void closeNotify() override {
+        SSL_shutdown(ssl);
+    }
+
+    std::shared_ptr<void> session() override {
+        SSL_SESSION* session = SSL_get1_session(ssl);
+        if (session == nullptr) return nullptr;
+        return std::shared_ptr<void>(session, [](void* s) { SSL_SESSION_free((SSL_SESSION*)s); });
+    }
+
+    const char* ciphersuite() override {
+        return SSL_get_cipher_name(ssl);
+    }
+
+private:
+    HostTlsParams params;
+    SSL_CTX* ctx;
+    SSL* ssl;
+    BIO* in;
+    BIO* out;
+    bool charged = false;
+    bool done = false;
+
+    static unsigned int onPsk(SSL* ssl, const char* hint, char* identity, unsigned int maxIdentity,
+                              unsigned char* psk, unsigned int maxPsk) {
+        OpenSslEngine* self = (OpenSslEngine*)SSL_get_app_data(ssl);
+        const HostTlsParams& p = self->params;
+        if (p.pskIdentity.size() + 1 > maxIdentity || p.psk.size() > maxPsk) return 0;
+        memcpy(identity, p.pskIdentity.c_str(), p.pskIdentity.size() + 1);
+        memcpy(psk, p.psk.data(), p.psk.size());
+        return p.psk.size();
+    }
+
+    static void onMessage(int write, int version, int type, const void* data, size_t length, SSL* ssl, void* arg) {
+        if (type != SSL3_RT_HANDSHAKE || length == 0) return;
+        uint8_t message = *(const uint8_t*)data;
+        if (write && message == SSL3_MT_CLIENT_KEY_EXCHANGE) lastEngine.keyExchange = true;
+        if (!write && message == SSL3_MT_CERTIFICATE) lastEngine.certificate = true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// The stand-in: certificate, PSK table and ticket keys, shared by connections
+
+class TlsStandIn {
+public:
+    TlsStandIn() {
+        key = EVP_RSA_gen(2048);
+        X509* cert = X509_new();
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)HOST, -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509V3_CTX v3;
+        X509V3_set_ctx_nodb(&v3);
+        X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+        std::string san = std::string("DNS:") + HOST;
+        X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, san.c_str());
+        X509_add_ext(cert, extension, -1);
+        X509_EXTENSION_free(extension);
+        X509_sign(cert, key, EVP_sha256());
+        certificate = cert;
+        BIO* bio = BIO_new(BIO_s_mem());
+        PEM_write_bio_X509(bio, cert);
+        char* pem;
+        long length = BIO_get_mem_data(bio, &pem);
+        certificatePem.assign(pem, length);
+        BIO_free(bio);
+        restart();
+    }
+
+    ~TlsStandIn() {
+        SSL_CTX_free(ctx);
+        X509_free(certificate);
+        EVP_PKEY_free(key);
+    }
+
+    // A new context: the tickets it issued before are no longer accepted
+    void restart() {
+        if (ctx != nullptr) SSL_CTX_free(ctx);
+        ctx = SSL_CTX_new(TLS_server_method());
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_use_certificate(ctx, certificate);
+        SSL_CTX_use_PrivateKey(ctx, key);
+        SSL_CTX_set_cipher_list(ctx, "ECDHE-PSK-AES128-CBC-SHA256:ECDHE-ECDSA-AES128-GCM-SHA256:"
+                                     "ECDHE-RSA-AES128-GCM-SHA256");
+        SSL_CTX_set1_groups_list(ctx, "P-256");
+        SSL_CTX_set_app_data(ctx, this);
+        SSL_CTX_set_psk_server_callback(ctx, onPsk);
+        SSL_CTX_set_session_id_context(ctx, (const unsigned char*)"glasses", 7);
+    }
+
+    SSL_CTX* context() {
+        return ctx;
+    }
+
+    std::string certificatePem;
+    std::map<std::string, std::vector<uint8_t>> psks;
+
+private:
+    EVP_PKEY* key = nullptr;
+    X509* certificate = nullptr;
+    SSL_CTX* ctx = nullptr;
+
+    static unsigned int onPsk(SSL* ssl, const char* identity, unsigned char* psk, unsigned int maxPsk) {
+        TlsStandIn* self = (TlsStandIn*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+        auto it = self->psks.find(identity ? identity : "");
+        if (it == self->psks.end() || it->second.size() > maxPsk) return 0;
+        memcpy(psk, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+};
+
+// One connection to the stand-in behind a simulated link: the uplink rate,
+// half the round trip each way, and the device's send buffer
+class TlsLink : public HostSocket {
+public:
+    TlsLink(TlsStandIn& standIn, uint32_t uplinkBps, uint32_t roundTripMs)
+        : uplinkBps(uplinkBps), oneWayUs((uint64_t)roundTripMs * 500), server(serverConfig()) {
+        ssl = SSL_new(standIn.context());
+        in = BIO_new(BIO_s_mem());
+        out = BIO_new(BIO_s_mem());
+        SSL_set_bio(ssl, in, out);
+        SSL_set_accept_state(ssl);
+        server.setCallback(onEvent, this);
+        clockUs = micros() / 1000 * 1000;
+    }
+
+    ~TlsLink() override {
+        SSL_free(ssl);
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        if (!open) return 0;
+        size_t n = std::min(length, SEND_BUFFER - uplink.size());
+        uplink.insert(uplink.end(), data, data + n);
+        return n;
+    }
+
+    size_t read(uint8_t* data, size_t length) override {
+        size_t n = std::min(length, received.size());
+        std::copy(received.begin(), received.begin() + n, data);
+        received.erase(received.begin(), received.begin() + n);
+        return n;
+    }
+
+    size_t available() override {
+        return received.size();
+    }
+
+    bool connected() override {
+        return open || !received.empty();
+    }
+
+    void close() override {
+        open = false;
+    }
+
+    // The server ends the connection
+    void drop() {
+        open = false;
+        received.clear();
+    }
+
+    // Moves the link on to nowUs, a millisecond at a time
+    void advance(uint64_t nowUs) {
+        while (clockUs + 1000 <= nowUs) {
+            clockUs += 1000;
+            step();
+        }
+    }
+
+    bool established = false;
+    bool failed = false;
+    uint32_t flights = 0;               // Server flights before its handshake was done
+    uint64_t handshakeDown = 0;
+    uint64_t handshakeUp = 0;
+    uint32_t streamsServed = 0;
+
+private:
+    struct Flight {
+        uint64_t arrivalUs;
+        std::string bytes;
+    };
+
+    uint32_t uplinkBps;
+    uint64_t oneWayUs;
+    bool open = true;
+    SSL* ssl;
+    BIO* in;
+    BIO* out;
+    std::deque<uint8_t> uplink;
+    std::deque<Flight> upFlight, downFlight;
+    std::deque<uint8_t> received;
+    double uplinkCredit = 0;
+    uint64_t downFreeUs = 0;
+    uint64_t clockUs;
+    bool upgraded = false;
+    std::string request;
+    StreamMux server;
+    std::map<uint16_t, std::string> bodies;
+
+    static StreamMuxConfig serverConfig() {
+        StreamMuxConfig config;
+        config.client = false;
+        return config;
+    }
+
+    void step() {
+        if (!uplink.empty()) {
+            uplinkCredit += uplinkBps / 8000.0;
+            size_t n = std::min((size_t)uplinkCredit, uplink.size());
+            uplinkCredit -= n;
+            if (n > 0) {
+                upFlight.push_back({ clockUs + oneWayUs, std::string(uplink.begin(), uplink.begin() + n) });
+                uplink.erase(uplink.begin(), uplink.begin() + n);
+            }
+            if (uplink.empty()) uplinkCredit = 0;
+        }
+        bool arrived = false;
+        while (!upFlight.empty() && upFlight.front().arrivalUs <= clockUs) {
+            if (!established) handshakeUp += upFlight.front().bytes.size();
+            BIO_write(in, upFlight.front().bytes.data(), upFlight.front().bytes.size());
+            upFlight.pop_front();
+            arrived = true;
+        }
+        if (arrived && !failed) serve();
+        while (!downFlight.empty() && downFlight.front().arrivalUs <= clockUs) {
+            if (open) received.insert(received.end(), downFlight.front().bytes.begin(), downFlight.front().bytes.end());
+            downFlight.pop_front();
+        }
+    }
+
+    void serve() {
+        bool handshaking = !established;
+        if (handshaking) {
+            int ret = SSL_do_handshake(ssl);
+            if (ret == 1) {
+                established = true;
+            } else if (SSL_get_error(ssl, ret) != SSL_ERROR_WANT_READ) {
+                failed = true;      // The alert goes out below
+                ERR_clear_error();
+            }
+        }
+        if (established) {
+            uint8_t plain[4096];
+            int n;
+            while ((n = SSL_read(ssl, plain, sizeof(plain))) > 0) {
+                application(std::string((const char*)plain, n));
+            }
+            ERR_clear_error();
+            uint8_t frames[16384];
+            size_t length;
+            while (upgraded && (length = server.poll(frames, sizeof(frames))) > 0) {
+                SSL_write(ssl, frames, length);
+            }
+        }
+        size_t pending = BIO_pending(out);
+        if (pending > 0) {
+            std::string bytes(pending, '\0');
+            BIO_read(out, &bytes[0], pending);
+            if (handshaking) {
+                flights++;
+                handshakeDown += pending;
+            }
+            sendDown(bytes);
+        }
+        if (failed) open = false;
+    }
+
+    void sendDown(const std::string& bytes) {
+        uint64_t start = std::max(clockUs, downFreeUs);
+        downFreeUs = start + (uint64_t)bytes.size() * 8 * 1000000 / DOWNLINK_BPS;
+        downFlight.push_back({ downFreeUs + oneWayUs, bytes });
+    }
+
+    void reply(const std::string& text) {
+        SSL_write(ssl, text.data(), text.size());
+    }
+
+    // Plaintext from the device: the upgrade, then frames
+    void application(const std::string& bytes) {
+        if (upgraded) {
+            server.receive((const uint8_t*)bytes.data(), bytes.size());
+            return;
+        }
+        request += bytes;
+        size_t end = request.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+        if (request.compare(0, 9, "GET /mux ") != 0) {
+            reply("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+            return;
+        }
+        reply("HTTP/1.1 101 Switching Protocols\r\nUpgrade: glasses-mux/1\r\nConnection: Upgrade\r\n\r\n");
+        upgraded = true;
+        std::string rest = request.substr(end + 4);
+        if (!rest.empty()) application(rest);
+    }
+
+    static void onEvent(const MuxEvent& event, void* context) {
+        TlsLink* self = (TlsLink*)context;
+        if (event.type == MUX_DATA) {
+            self->bodies[event.stream].append((const char*)event.data, event.length);
+        }
+        if ((event.type != MUX_HEADERS && event.type != MUX_DATA) || !event.end) return;
+        StaticJsonDocument<256> doc;
+        deserializeJson(doc, self->bodies[event.stream]);
+        String command = doc["command"] | "";
+        std::string head = "200\r\nContent-Type: application/json\r\n";
+        std::string body = std::string("{\"response\":\"Stand-in answer to '") + command.c_str() + "'\"}";
+        self->server.respond(event.stream, head.c_str(), head.size());
+        self->server.write(event.stream, (const uint8_t*)body.data(), body.size(), true);
+        self->bodies.erase(event.stream);
+        self->streamsServed++;
+    }
+};
+
+static std::shared_ptr<TlsLink> currentLink;
+
+static void connectTo(TlsStandIn& standIn, uint32_t uplinkBps, uint32_t roundTripMs) {
+    HostSockets::setConnector([&standIn, uplinkBps, roundTripMs](const String&, uint16_t) {
+        currentLink = std::make_shared<TlsLink>(standIn, uplinkBps, roundTripMs);
+        std::weak_ptr<TlsLink> link = currentLink;
+        HostClock::setAdvanceHook([link](uint64_t, uint64_t toUs) {
+            if (auto l = link.lock()) l->advance(toUs);
+        });
+        return std::static_pointer_cast<HostSocket>(currentLink);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Credentials
+
+static void credentials(Checks& checks, const TlsStandIn& standIn) {
+    HostNvs::clear();
+    TlsCredentials loaded;
+    checks.expect(!TlsCredentials::load(loaded) && !TlsCredentials::get().hasPsk() && !TlsCredentials::get().hasCa(),
+                  "a device without credentials has neither a PSK nor a CA");
+
+    uint8_t key[32];
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(i * 37 + 11);
+    bool provisioned = TlsCredentials::provision(IDENTITY, key, sizeof(key));
+    const TlsCredentials& current = TlsCredentials::get();
+    checks.expect(provisioned && current.hasPsk() && strcmp(current.identity, IDENTITY) == 0 &&
+                  current.keyLength == 32 && memcmp(current.key, key, 32) == 0 && strlen(current.keyHex) == 64 &&
+                  strncmp(current.keyHex, "0b30", 4) == 0,
+                  "a provisioned PSK reads back from NVS", current.identity);
+
+    bool shortKey = TlsCredentials::provision(IDENTITY, key, 15);
+    bool longIdentity = TlsCredentials::provision("glasses-0123456789abcdef0123456789", key, 32);
+    bool notPem = TlsCredentials::provisionCa("not a certificate");
+    checks.expect(!shortKey && !longIdentity && !notPem && memcmp(TlsCredentials::get().key, key, 32) == 0,
+                  "a short key, a long identity or a CA that is not PEM is refused, the PSK kept");
+
+    bool ca = TlsCredentials::provisionCa(standIn.certificatePem.c_str());
+    checks.expect(ca && TlsCredentials::get().hasCa() && TlsCredentials::get().caPem == standIn.certificatePem.c_str(),
+                  "the server's CA certificate is kept next to the PSK",
+                  format("%.0f bytes of PEM", standIn.certificatePem.size()));
+
+    nvs_handle_t handle;
+    nvs_open("tls", NVS_READWRITE, &handle);
+    nvs_set_blob(handle, "psk", key, 8);
+    nvs_close(handle);
+    TlsCredentials::load(loaded);
+    checks.expect(!loaded.hasPsk() && loaded.hasCa(), "a PSK under 16 bytes in NVS is not used");
+
+    checks.expect(TlsCredentials::erase() && !TlsCredentials::get().hasPsk() && !TlsCredentials::get().hasCa(),
+                  "erase() leaves nothing");
+}
+
+// ---------------------------------------------------------------------------
+// Handshakes
+
+struct Mode {
+    const char* name;
+    bool psk;
+    bool resume;
+};
+
+struct ModeResult {
+    std::string name;
+    uint32_t connections = 0;
+    uint32_t failures = 0;
+    uint32_t full = 0;
+    uint32_t resumed = 0;
+    double firstMs = 0;
+    // The handshakes after the first
+    std::vector<double> laterMs, laterFlights, laterDown, laterUp, laterCpuUs;
+};
+
+static void provisionFor(const TlsStandIn& standIn, bool psk, const uint8_t* key, size_t length) {
+    HostNvs::clear();
+    if (psk) {
+        TlsCredentials::provision(IDENTITY, key, length);
+    } else {
+        TlsCredentials::provisionCa(standIn.certificatePem.c_str());
+    }
+}
+
+static ModeResult runMode(const Mode& mode, uint32_t connections, uint32_t roundTripMs) {
+    ModeResult result;
+    result.name = mode.name;
+    uint32_t fullBefore = Metrics::get(TLS_FULL);
+    uint32_t resumedBefore = Metrics::get(TLS_RESUMED);
+    std::unique_ptr<TlsTransport> shared(new TlsTransport());
+    for (uint32_t i = 0; i < connections; i++) {
+        std::unique_ptr<TlsTransport> fresh;
+        TlsTransport* transport = shared.get();
+        if (!mode.resume) {
+            fresh.reset(new TlsTransport());
+            transport = fresh.get();
+        }
+        transport->setSecure(true);
+        unsigned long startUs = micros();
+        bool ok = transport->connect(HOST, PORT, 5000) == 1;
+        double ms = (micros() - startUs) / 1000.0;
+        result.connections++;
+        // The server is done when the client's last flight arrives
+        for (uint32_t t = 0; ok && t < 2 * roundTripMs && !currentLink->established; t++) delay(1);
+        if (!ok || !currentLink->established) {
+            result.failures++;
+            continue;
+        }
+        transport->stop();
+        if (i == 0) {
+            result.firstMs = ms;
+        } else {
+            result.laterMs.push_back(ms);
+            result.laterFlights.push_back(currentLink->flights);
+            result.laterDown.push_back(currentLink->handshakeDown);
+            result.laterUp.push_back(currentLink->handshakeUp);
+            result.laterCpuUs.push_back(lastEngine.cpuUs);
+        }
+        if (transport->wasResumed() != lastEngine.resumed) result.failures++;     // The transport got it wrong
+        delay(100);
+    }
+    result.full = Metrics::get(TLS_FULL) - fullBefore;
+    result.resumed = Metrics::get(TLS_RESUMED) - resumedBefore;
+    return result;
+}
+
+static void printResult(const ModeResult& r) {
+    printf("  %-22s %5u/%-4u | %6.0f | %6.0f %6.0f | %5.0f %7.0f %7.0f | %7.0f\n", r.name.c_str(), r.full,
+           r.resumed, r.firstMs, percentile(r.laterMs, 0.5), percentile(r.laterMs, 0.9),
+           percentile(r.laterFlights, 0.5), percentile(r.laterDown, 0.5), percentile(r.laterUp, 0.5),
+           percentile(r.laterCpuUs, 0.5));
+}
+
+static void handshakes(Checks& checks, TlsStandIn& standIn, uint32_t connections, uint32_t uplinkBps,
+                       uint32_t roundTripMs) {
+    uint8_t key[32];
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(i * 37 + 11);
+    standIn.psks[IDENTITY] = std::vector<uint8_t>(key, key + sizeof(key));
+    connectTo(standIn, uplinkBps, roundTripMs);
+
+    const Mode modes[] = {
+        { "certificate, full", false, false },
+        { "certificate, resumed", false, true },
+        { "PSK, full", true, false },
+        { "PSK, resumed", true, true },
+    };
+    ModeResult results[4];
+    uint32_t fullSamples = Metrics::histogram(TLS_FULL_MS).total;
+    uint32_t resumedSamples = Metrics::histogram(TLS_RESUMED_MS).total;
+    for (int m = 0; m < 4; m++) {
+        provisionFor(standIn, modes[m].psk, key, sizeof(key));
+        results[m] = runMode(modes[m], connections, roundTripMs);
+    }
+
+    printf("  %-22s %10s | %6s | %13s | %21s | %7s\n", "", "", "first", "after first", "after first, p50",
+           "host CPU");
+    printf("  %-22s %10s | %6s | %6s %6s | %5s %7s %7s | %7s\n", "mode", "full/res", "ms", "p50", "p90", "RTTs",
+           "down", "up", "us p50");
+    for (const ModeResult& r : results) printResult(r);
+    printf("  ms: handshake after the TCP connect, with the S3's estimated %u ms ECDHE, %u ms certificate and\n"
+           "  %u ms symmetric work; RTTs: server flights; down/up: handshake bytes; host CPU: OpenSSL here\n\n",
+           ecdheMs, certificateMs, SYMMETRIC_MS);
+
+    uint32_t failures = 0, total = 0;
+    for (const ModeResult& r : results) {
+        failures += r.failures;
+        total += r.connections;
+    }
+    checks.expect(failures == 0, "every handshake succeeds and is told full or resumed correctly",
+                  format("%.0f of %.0f", total - failures, total));
+    const ModeResult& certFull = results[0];
+    const ModeResult& certResumed = results[1];
+    const ModeResult& pskFull = results[2];
+    const ModeResult& pskResumed = results[3];
+    checks.expect(certFull.resumed == 0 && pskFull.resumed == 0 && certResumed.full == 1 && pskResumed.full == 1 &&
+                  certResumed.resumed == connections - 1 && pskResumed.resumed == connections - 1,
+                  "a transport resumes every connection after its first; a new one cannot");
+    checks.expect(percentile(certFull.laterFlights, 0.5) == 2 && percentile(certResumed.laterFlights, 0.5) == 1 &&
+                  percentile(pskFull.laterFlights, 0.5) == 2 && percentile(pskResumed.laterFlights, 0.5) == 1,
+                  "a full handshake takes two round trips, a resumed one one");
+    double full50 = percentile(certFull.laterMs, 0.5), resumed50 = percentile(certResumed.laterMs, 0.5);
+    checks.expect(resumed50 * 2 <= full50, "resuming takes half the time of a full handshake or less",
+                  format("%.0f ms vs %.0f ms", resumed50, full50));
+    checks.expect(percentile(pskFull.laterMs, 0.5) < full50 &&
+                  percentile(pskFull.laterDown, 0.5) * 2 < percentile(certFull.laterDown, 0.5),
+                  "ECDHE-PSK skips the certificate: less time, under half the bytes",
+                  format("%.0f vs %.0f bytes down", percentile(pskFull.laterDown, 0.5),
+                         percentile(certFull.laterDown, 0.5)));
+    checks.expect(percentile(certResumed.laterCpuUs, 0.5) * 2 < percentile(certFull.laterCpuUs, 0.5),
+                  "a resumed handshake costs this host's CPU under half of a full one",
+                  format("%.0f us vs %.0f us", percentile(certResumed.laterCpuUs, 0.5),
+                         percentile(certFull.laterCpuUs, 0.5)));
+    uint32_t fullCount = 0, resumedCount = 0;
+    for (const ModeResult& r : results) {
+        fullCount += r.full;
+        resumedCount += r.resumed;
+    }
+    checks.expect(Metrics::histogram(TLS_FULL_MS).total - fullSamples == fullCount &&
+                  Metrics::histogram(TLS_RESUMED_MS).total - resumedSamples == resumedCount &&
+                  Metrics::histogram(TLS_RESUMED_MS).quantile(0.5) < Metrics::histogram(TLS_FULL_MS).quantile(0.5),
+                  "each handshake is timed in the histogram of its kind",
+                  format("p50 %.0f ms resumed, %.0f ms full", Metrics::histogram(TLS_RESUMED_MS).quantile(0.5),
+                         Metrics::histogram(TLS_FULL_MS).quantile(0.5)));
+
+    // A transport that has a ticket, then a server that forgot its keys
+    provisionFor(standIn, true, key, sizeof(key));
+    {
+        TlsTransport transport;
+        transport.setSecure(true);
+        transport.connect(HOST, PORT, 5000);
+        transport.stop();
+        standIn.restart();
+        bool ok = transport.connect(HOST, PORT, 5000) == 1;
+        checks.expect(ok && !transport.wasResumed() && currentLink->flights == 2,
+                      "a ticket the server no longer knows falls back to a full handshake");
+        transport.stop();
+    }
+
+    uint32_t failuresBefore = Metrics::get(TLS_FAILURES);
+    {
+        uint8_t wrong[32];
+        memcpy(wrong, key, sizeof(wrong));
+        wrong[0] ^= 1;
+        provisionFor(standIn, true, wrong, sizeof(wrong));
+        TlsTransport transport;
+        transport.setSecure(true);
+        unsigned long startMs = millis();
+        bool ok = transport.connect(HOST, PORT, 5000) == 1;
+        unsigned long waitedMs = millis() - startMs;
+        checks.expect(!ok && waitedMs < 1000 && Metrics::get(TLS_FAILURES) == failuresBefore + 1,
+                      "a wrong PSK fails the handshake at once and is counted", format("%.0f ms", waitedMs));
+    }
+    {
+        TlsStandIn other;
+        HostNvs::clear();
+        TlsCredentials::provisionCa(other.certificatePem.c_str());
+        TlsTransport transport;
+        transport.setSecure(true);
+        bool ok = transport.connect(HOST, PORT, 5000) == 1;
+        checks.expect(!ok && Metrics::get(TLS_FAILURES) == failuresBefore + 2,
+                      "a server certificate from another CA is refused");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// NetworkModule over https://
+
+static void networkModule(Checks& checks, TlsStandIn& standIn, uint32_t uplinkBps, uint32_t roundTripMs) {
+    uint8_t key[32];
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(i * 37 + 11);
+    provisionFor(standIn, true, key, sizeof(key));
+    String lastUrl;
+    uint32_t httpRequests = 0;
+    HostHttp::setHandler([&](const HostHttpRequest& request) {
+        HostHttpResponse response;
+        response.body = "{\"response\":\"over HTTP\"}";
+        response.latencyMs = 600;
+        lastUrl = request.url;
+        httpRequests++;
+        return response;
+    });
+    connectTo(standIn, uplinkBps, roundTripMs);
+
+    uint32_t fullBefore = Metrics::get(TLS_FULL);
+    uint32_t resumedBefore = Metrics::get(TLS_RESUMED);
+    NetworkModule network;
+    network.connect("stand-in", "");
+    network.setServer(String("https://") + HOST + ":" + String(PORT));
+    network.maintain();
+    checks.expect(network.isMultiplexed() && currentLink->established && Metrics::get(TLS_FULL) == fullBefore + 1,
+                  "NetworkModule opens its connection over TLS at the first maintain()");
+
+    String answer = network.sendCommand("what time is it");
+    checks.expect(answer == "Stand-in answer to 'what time is it'" && httpRequests == 0 &&
+                  currentLink->streamsServed == 1, "a command goes over the TLS connection", answer.c_str());
+
+    currentLink->drop();
+    network.maintain();
+    bool dropped = !network.isMultiplexed();
+    answer = network.sendCommand("are you there");
+    checks.expect(dropped && answer == "over HTTP" && lastUrl.startsWith("https://"),
+                  "while it is down, requests go through HTTPClient to the https:// URL");
+
+    for (int i = 0; i < 70 && !network.isMultiplexed(); i++) {
+        delay(100);
+        network.maintain();
+    }
+    answer = network.sendCommand("still there");
+    checks.expect(network.isMultiplexed() && Metrics::get(TLS_RESUMED) == resumedBefore + 1 &&
+                  Metrics::get(TLS_FULL) == fullBefore + 1 && answer == "Stand-in answer to 'still there'",
+                  "the reconnect resumes the session", format("%.0f server flights", currentLink->flights));
+
+    HostSockets::setConnector(nullptr);
+    HostClock::setAdvanceHook(nullptr);
+    HostHttp::setHandler(nullptr);
+    currentLink = nullptr;
+}
+
+int main(int argc, char** argv) {
+    uint32_t connections = 20;
+    uint32_t roundTripMs = 40;
+    uint32_t uplinkKbps = 1000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--connections" && i + 1 < argc) connections = atoi(argv[++i]);
+        else if (arg == "--rtt-ms" && i + 1 < argc) roundTripMs = atoi(argv[++i]);
+        else if (arg == "--uplink-kbps" && i + 1 < argc) uplinkKbps = atoi(argv[++i]);
+        else if (arg == "--ecdhe-ms" && i + 1 < argc) ecdheMs = atoi(argv[++i]);
+        else if (arg == "--certificate-ms" && i + 1 < argc) certificateMs = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--connections N] [--rtt-ms N] [--uplink-kbps N] [--ecdhe-ms N] "
+                    "[--certificate-ms N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (connections < 2) connections = 2;
+    if (uplinkKbps < 64) uplinkKbps = 64;
+    Logger::setLogLevel(LOG_NONE);
+    HostClock::setVirtual(true);
+    HostTls::setFactory([](const HostTlsParams& params) {
+        return std::unique_ptr<HostTlsEngine>(new OpenSslEngine(params));
+    });
+    Checks checks;
+    TlsStandIn standIn;
+    WiFi.begin("stand-in", "");
+    while (WiFi.status() != WL_CONNECTED) delay(10);
+
+    printf("Credentials in NVS:\n");
+    credentials(checks, standIn);
+    printf("\nHandshakes: %u connections per mode, uplink %u kbps, round trip %u ms, TLS 1.2, P-256, RSA-2048\n\n",
+           connections, uplinkKbps, roundTripMs);
+    handshakes(checks, standIn, connections, uplinkKbps * 1000, roundTripMs);
+    printf("\nNetworkModule over https://:\n");
+    networkModule(checks, standIn, uplinkKbps * 1000, roundTripMs);
+
+    printf("\n%s\n", checks.failed == 0 ? "All checks passed" : "Some checks FAILED");
+    return checks.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,635 @@
+// Vision pipeline harness (pio run -e native_vision).
+// Checks the JPEG encoder, the frame differ and the multipart body, then
+// walks the glasses through a scripted stretch of rooms while watching
+// (a look every 2 s) and replays it three ways through the real
+// VisionModule, CameraHal and NetworkModule, against a stand-in
+// /vision/describe that parses the multipart body and the JPEG:
+// - every look, whole frame, quality 80
+// - frame-difference skip, whole frame, quality 80
+// - skip, region-of-interest crops, quality adapted to the link
+// and reports JPEG bytes per described scene, how long a new scene waited
+// for its description, and what was missed or stale.
+//
+// Usage: program [--minutes N] [--seed N] [--uplink-kbps N]
+//                [--images list.txt [--hold LOOKS]]
+//
+// The rooms: a wall and a floor with texture and furniture, a new room
+// every 45 s on average; inside one, every 12 s an object is put down,
+// taken away or moved. The wearer's head jitters by a pixel or two, the
+// exposure drifts and the sensor adds noise. With --images, each image of
+// the list (PGM or PPM, one path per line) is the scene for --hold looks.
+//
+// Time is virtual. Encoding is charged at S3_ENCODE_NS_PER_PIXEL, an
+// estimate for this encoder on the S3 at 240 MHz with the frame in PSRAM;
+// the host's own encode time is printed for comparison.
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <esp_heap_caps.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../host_random.h"
+#include "../../firmware/modules/vision_module.cpp"
+
+static const uint32_t LOOK_MS = 2000;
+static const uint32_t S3_ENCODE_NS_PER_PIXEL = 280;
+static const uint32_t SERVER_MS = 450;          // Describing a frame, plus 1 ms per 2 KB decoded
+
+struct Checks {
+    int failed = 0;
+
+    void expect(bool ok, const std::string& name, const std::string& detail = "") {
+        printf("  %-4s %s%s%s\n", ok ? "ok" : "FAIL", name.c_str(), detail.empty() ? "" : ": ", detail.c_str());
+        if (!ok) failed++;
+    }
+};
+
+static std::string format(const char* pattern, double a, double b = 0, double c = 0) {
+    char text[128];
+    snprintf(text, sizeof(text), pattern, a, b, c);
+    return text;
+}
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(q * (values.size() - 1) + 0.5)];
+}
+
+// ---------------------------------------------------------------- The world
+
+struct Shape {
+    int16_t x, y, w, h;
+    uint8_t rgb[3];
+    uint8_t kind;                   // 0 box, 1 round, 2 striped
+};
+
+struct Scene {
+    uint8_t wall[3], floor[3];
+    int16_t horizon;
+    uint32_t texture;
+    std::vector<Shape> shapes;      // Furniture first, then objects
+    size_t furniture = 0;
+};
+
+struct World {
+    std::vector<Scene> states;      // Every state the wearer sees, in order
+    std::vector<uint32_t> startMs;  // When each begins
+    uint32_t endMs = 0;
+
+    size_t stateAt(uint32_t ms) const {
+        return std::upper_bound(startMs.begin(), startMs.end(), ms) - startMs.begin() - 1;
+    }
+};
+
+static Shape randomShape(HostRandom& rng, int minSide, int maxSide) {
+    Shape s;
+    s.w = minSide + rng.next() % (maxSide - minSide + 1);
+    s.h = minSide + rng.next() % (maxSide - minSide + 1);
+    s.x = rng.next() % (640 - s.w);
+    s.y = rng.next() % (480 - s.h);
+    for (int c = 0; c < 3; c++) s.rgb[c] = 20 + rng.next() % 216;
+    s.kind = rng.next() % 3;
+    return s;
+}
+
+static Scene randomRoom(HostRandom& rng) {
+    Scene scene;
+    for (int c = 0; c < 3; c++) {
+        scene.wall[c] = 90 + rng.next() % 140;
+        scene.floor[c] = 30 + rng.next() % 120;
+    }
+    scene.horizon = 200 + rng.next() % 160;
+    scene.texture = (uint32_t)rng.next();
+    scene.furniture = 2 + rng.next() % 4;
+    for (size_t i = 0; i < scene.furniture; i++) scene.shapes.push_back(randomShape(rng, 80, 260));
+    size_t objects = 1 + rng.next() % 3;
+    for (size_t i = 0; i < objects; i++) scene.shapes.push_back(randomShape(rng, 48, 120));
+    return scene;
+}
+
+static void render(const Scene& scene, int dx, int dy, double gain, HostRandom& noise,
+                   uint16_t width, uint16_t height, uint8_t* yuyv);
+
+// Pixels of a 160x120 view that differ in luma or colour: a change hidden
+// behind furniture is no change
+static double visibleChange(const Scene& a, const Scene& b) {
+    static uint8_t before[160 * 120 * 2], after[160 * 120 * 2];
+    HostRandom noise(1);
+    render(a, 0, 0, 1.0, noise, 160, 120, before);
+    render(b, 0, 0, 1.0, noise, 160, 120, after);
+    size_t changed = 0;
+    for (size_t i = 0; i < sizeof(before); i += 2) {
+        changed += abs(before[i] - after[i]) > 24 || abs(before[i + 1] - after[i + 1]) > 16;
+    }
+    return (double)changed / (160 * 120);
+}
+
+static World makeWorld(uint32_t minutes, HostRandom& rng) {
+    World world;
+    world.endMs = minutes * 60000;
+    double t = 0;
+    double nextRoom = 0;
+    while (t < world.endMs) {
+        Scene scene;
+        if (t >= nextRoom || world.states.empty()) {
+            scene = randomRoom(rng);
+            nextRoom = t + rng.exponential(45000);
+        } else {
+            scene = world.states.back();
+            size_t objects = scene.shapes.size() - scene.furniture;
+            double r = rng.uniform();
+            if (r < 0.4 || objects == 0) {
+                scene.shapes.push_back(randomShape(rng, 48, 120));
+            } else if (r < 0.7 && objects > 1) {
+                scene.shapes.erase(scene.shapes.begin() + scene.furniture + rng.next() % objects);
+            } else {
+                Shape& s = scene.shapes[scene.furniture + rng.next() % objects];
+                s.x = rng.next() % (640 - s.w);
+                s.y = rng.next() % (480 - s.h);
+            }
+            if (visibleChange(world.states.back(), scene) < 0.01) {
+                continue;
+            }
+        }
+        world.states.push_back(scene);
+        world.startMs.push_back((uint32_t)t);
+        t += std::min(rng.exponential(12000), std::max(nextRoom - t, 1000.0));
+        t = std::max(t, world.startMs.back() + 1000.0);
+    }
+    return world;
+}
+
+static uint8_t textureAt(uint32_t seed, int x, int y) {
+    uint32_t h = seed ^ ((uint32_t)(x >> 3) * 0x9E3779B1u) ^ ((uint32_t)(y >> 3) * 0x85EBCA77u);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h & 15;
+}
+
+static bool inside(const Shape& s, int x, int y) {
+    if (x < s.x || y < s.y || x >= s.x + s.w || y >= s.y + s.h) return false;
+    if (s.kind != 1) return true;
+    double dx = (x - s.x - s.w / 2.0) / (s.w / 2.0), dy = (y - s.y - s.h / 2.0) / (s.h / 2.0);
+    return dx * dx + dy * dy <= 1.0;
+}
+
+// The scene through the camera: offset by the head's jitter, exposure gain, noise
+static void render(const Scene& scene, int dx, int dy, double gain, HostRandom& noise,
+                   uint16_t width, uint16_t height, uint8_t* yuyv) {
+    static std::vector<uint8_t> rgb;
+    rgb.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; y++) {
+        int wy = y * 480 / height + dy;
+        for (int x = 0; x < width; x++) {
+            int wx = x * 640 / width + dx;
+            const uint8_t* colour = wy < scene.horizon ? scene.wall : scene.floor;
+            int shade = textureAt(scene.texture, wx, wy) - 8;
+            for (const Shape& s : scene.shapes) {
+                if (inside(s, wx, wy)) {
+                    colour = s.rgb;
+                    shade = s.kind == 2 && ((wx - s.x) / 6) % 2 ? -30 : 0;
+                }
+            }
+            uint8_t* out = &rgb[((size_t)y * width + x) * 3];
+            for (int c = 0; c < 3; c++) {
+                int v = (int)((colour[c] + shade) * gain) + (int)(noise.next() % 7) - 3;
+                out[c] = v < 0 ? 0 : v > 255 ? 255 : v;
+            }
+        }
+    }
+    HostCamera::toYuyv(rgb.data(), width, height, yuyv);
+}
+
+// ---------------------------------------------------------------- Stand-in server
+
+static size_t renderedState = 0;        // State in the frame the camera last took
+static uint32_t framesAtStart = 0;
+static uint32_t holdLooks = 5;
+static bool fromImages = false;
+
+static size_t currentState() {
+    return fromImages ? (HostCamera::framesTaken - framesAtStart - 1) / holdLooks : renderedState;
+}
+static size_t malformed = 0;
+
+static uint16_t be16(const uint8_t* p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+// The JPEG in a multipart body with field image_file, or false
+static bool parseUpload(const HostHttpRequest& request, std::vector<uint8_t>& jpeg) {
+    String type = request.header("Content-Type");
+    int at = type.indexOf("boundary=");
+    if (!type.startsWith("multipart/form-data") || at < 0) return false;
+    std::string boundary = std::string("--") + type.substring(at + 9).c_str();
+    std::string body(request.body.begin(), request.body.end());
+    std::string tail = "\r\n" + boundary + "--\r\n";
+    size_t head = body.find("\r\n\r\n");
+    if (body.compare(0, boundary.size(), boundary) != 0 || head == std::string::npos ||
+        body.find("name=\"image_file\"") > head || body.size() < head + 4 + tail.size() ||
+        body.compare(body.size() - tail.size(), tail.size(), tail) != 0) {
+        return false;
+    }
+    jpeg.assign(request.body.begin() + head + 4, request.body.end() - tail.size());
+    return true;
+}
+
+// Frame size from the JPEG's SOF0, SOI to EOI
+static bool jpegSize(const std::vector<uint8_t>& jpeg, uint16_t& width, uint16_t& height) {
+    if (jpeg.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8 || jpeg[jpeg.size() - 2] != 0xFF ||
+        jpeg[jpeg.size() - 1] != 0xD9) {
+        return false;
+    }
+    size_t i = 2;
+    while (i + 9 < jpeg.size() && jpeg[i] == 0xFF) {
+        if (jpeg[i + 1] == 0xC0) {
+            height = be16(&jpeg[i + 5]);
+            width = be16(&jpeg[i + 7]);
+            return true;
+        }
+        i += 2 + be16(&jpeg[i + 2]);
+    }
+    return false;
+}
+
+static void standIn() {
+    HostHttp::setHandler([](const HostHttpRequest& request) {
+        HostHttpResponse response;
+        response.latencyMs = 20;
+        if (!request.url.endsWith("/vision/describe")) {
+            response.body = "{\"status\":\"ok\"}";
+            return response;
+        }
+        std::vector<uint8_t> jpeg;
+        uint16_t width = 0, height = 0;
+        String region = request.header("X-Vision-Region");
+        unsigned x, y, w, h, fw, fh;
+        bool regionOk = region.length() == 0 ||
+                        (sscanf(region.c_str(), "%u,%u,%u,%u/%ux%u", &x, &y, &w, &h, &fw, &fh) == 6 &&
+                         x + w <= fw && y + h <= fh);
+        if (!parseUpload(request, jpeg) || !jpegSize(jpeg, width, height) || !regionOk ||
+            (region.length() > 0 && (w != width || h != height))) {
+            malformed++;
+            response.code = 400;
+            return response;
+        }
+        response.latencyMs = SERVER_MS + jpeg.size() / 2048;
+        response.body = String("{\"description\":\"Scene ") + String((unsigned)currentState()) + "\"}";
+        return response;
+    });
+}
+
+// ---------------------------------------------------------------- Replay
+
+struct Run {
+    const char* name;
+    size_t looks = 0;
+    size_t skipped = 0;
+    size_t cropped = 0;
+    size_t encodes = 0;
+    double kb = 0;
+    size_t seen = 0;                // States that were there at a look
+    size_t described = 0;
+    size_t staleLooks = 0;          // Looks after which the held description was of another state
+    size_t redundant = 0;           // Uploads of a state already described
+    std::vector<double> sceneMs;    // State start to its description
+    std::vector<double> lookMs;     // Upload looks: capture to description, encode included
+    std::vector<double> quality;
+    size_t buffersLeftOut = 0;
+};
+
+static const World* world = nullptr;
+static uint64_t worldStartMs = 0;
+static std::vector<std::string> imagePaths;
+
+static void setSource(uint64_t seed) {
+    static HostRandom noise(1);
+    noise = HostRandom(seed * 31 + 7);
+    if (fromImages) {
+        std::vector<std::string> frames;
+        for (const std::string& path : imagePaths) {
+            for (uint32_t i = 0; i < holdLooks; i++) frames.push_back(path);
+        }
+        HostCamera::loadImages(frames);
+        return;
+    }
+    HostCamera::setSource([](uint32_t index, uint16_t width, uint16_t height, uint8_t* yuyv) {
+        uint32_t now = HostClock::nowUs() / 1000 - worldStartMs;
+        if (now >= world->endMs) return false;
+        renderedState = world->stateAt(now);
+        int dx = (int)lround(0.8 * noise.normal()), dy = (int)lround(0.8 * noise.normal());
+        double gain = 1.0 + 0.05 * sin(now / 20000.0) + 0.004 * noise.normal();
+        render(world->states[renderedState], dx, dy, gain, noise, width, height, yuyv);
+        return true;
+    });
+}
+
+static Run replay(const char* name, const VisionConfig& config, uint64_t seed, uint32_t endMs) {
+    Run run;
+    run.name = name;
+    HostClock::setVirtual(true);
+    CameraHal::end();
+    setSource(seed);
+    static NetworkModule network;
+    network.connect("stand-in", "");
+    // A few chunks of audio first, so the link estimate is measured
+    static uint8_t audio[16000] = {};
+    for (uint16_t i = 0; i < 4; i++) network.sendAudioChunk(audio, sizeof(audio), AudioFormat(), i, false);
+
+    VisionModule* vision = new VisionModule(config);
+    vision->setNetworkModule(&network);
+    if (!vision->begin()) {
+        printf("  %s: camera did not start\n", name);
+        delete vision;
+        return run;
+    }
+    size_t states = fromImages ? imagePaths.size() : world->states.size();
+    std::vector<bool> seen(states, false), described(states, false);
+    std::string held;
+    vision->setWatching(true);
+    framesAtStart = HostCamera::framesTaken;
+    worldStartMs = HostClock::nowUs() / 1000;
+    while (HostClock::nowUs() / 1000 - worldStartMs < endMs) {
+        String description;
+        uint32_t frames = HostCamera::framesTaken;
+        uint64_t lookStart = HostClock::nowUs() / 1000;
+        bool fresh = vision->service(description);
+        if (HostCamera::framesTaken == frames) {
+            HostClock::advanceMs(50);
+            continue;
+        }
+        const VisionReport& report = vision->getLastReport();
+        size_t state = currentState();
+        if (!report.captured || state >= states) break;
+        run.looks++;
+        seen[state] = true;
+        if (report.uploaded) {
+            // The encoder's time on the S3, which the host clock did not see
+            uint32_t pixels = report.region.area() ? report.region.area() : Board::Camera::WIDTH * Board::Camera::HEIGHT;
+            HostClock::advanceUs((uint64_t)pixels * report.encodes * S3_ENCODE_NS_PER_PIXEL / 1000);
+            run.cropped += report.cropped;
+            run.encodes += report.encodes;
+            run.kb += report.bytes / 1024.0;
+            run.quality.push_back(report.quality);
+            run.lookMs.push_back(HostClock::nowUs() / 1000 - lookStart);
+            run.redundant += described[state];
+        } else {
+            run.skipped++;
+        }
+        if (fresh) {
+            held = description.c_str();
+            if (!described[state]) {
+                described[state] = true;
+                if (!fromImages) {
+                    run.sceneMs.push_back(HostClock::nowUs() / 1000 - worldStartMs - world->startMs[state]);
+                }
+            }
+        }
+        run.staleLooks += held != "Scene " + std::to_string(state);
+        run.buffersLeftOut += HostCamera::buffersOut();
+    }
+    for (size_t i = 0; i < states; i++) {
+        run.seen += seen[i];
+        run.described += described[i] && seen[i];
+    }
+    vision->setWatching(false);
+    delete vision;
+    return run;
+}
+
+static void printRun(const Run& r) {
+    double perScene = r.described ? r.kb / r.described : 0;
+    printf("  %-26s %6zu %6zu %6zu %8.0f %8.1f %7zu/%-4zu %6zu %6zu %7.0f %7.0f %7.0f\n", r.name, r.looks,
+           r.looks - r.skipped, r.cropped, r.kb, perScene, r.described, r.seen, r.staleLooks, r.redundant,
+           percentile(r.lookMs, 0.5), percentile(r.sceneMs, 0.5), percentile(r.sceneMs, 0.9));
+}
+
+// ---------------------------------------------------------------- Parts
+
+static void parts(Checks& checks) {
+    static uint8_t yuyv[640 * 480 * 2];
+    static uint8_t other[640 * 480 * 2];
+    HostRandom rng(3);
+    HostRandom noise(4);
+    Scene room = randomRoom(rng);
+    render(room, 0, 0, 1.0, noise, 640, 480, yuyv);
+    JpegImage image = { yuyv, 640, 480, 640 * 2, JPEG_INPUT_YUYV };
+    std::vector<uint8_t> out(640 * 480);
+    JpegEncoder encoder;
+
+    uint16_t w = 0, h = 0;
+    encoder.setQuality(80);
+    size_t q80 = encoder.encode(image, JpegRect(), out.data(), out.size());
+    std::vector<uint8_t> jpeg(out.begin(), out.begin() + q80);
+    checks.expect(q80 > 0 && jpegSize(jpeg, w, h) && w == 640 && h == 480, "whole frame: SOI, SOF0 640x480, EOI",
+                  format("%.1f KB at quality 80", q80 / 1024.0));
+    encoder.setQuality(30);
+    size_t q30 = encoder.encode(image, JpegRect(), out.data(), out.size());
+    checks.expect(q30 > 0 && q30 < q80 * 0.6, "quality 30 is under 60% of quality 80", format("%.1f KB", q30 / 1024.0));
+    JpegRect crop;
+    crop.x = 161;
+    crop.y = 96;
+    crop.width = 160;
+    crop.height = 128;
+    size_t cropped = encoder.encode(image, crop, out.data(), out.size());
+    jpeg.assign(out.begin(), out.begin() + cropped);
+    checks.expect(cropped > 0 && jpegSize(jpeg, w, h) && w == 161 && h == 128,
+                  "crop is encoded at its own size, an odd x widened to its chroma pair");
+    checks.expect(encoder.encode(image, JpegRect(), out.data(), 4000) == 0, "a buffer too small gives 0, not a torn JPEG");
+
+    // Host encode time, and the differ's
+    const int ROUNDS = 20;
+    encoder.setQuality(70);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) encoder.encode(image, JpegRect(), out.data(), out.size());
+    double fullMs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / ROUNDS * 1e3;
+    JpegRect roi;
+    roi.x = 240;
+    roi.y = 160;
+    roi.width = 160;
+    roi.height = 160;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS * 10; i++) encoder.encode(image, roi, out.data(), out.size());
+    double roiMs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / (ROUNDS * 10) * 1e3;
+    uint8_t thumb[FrameDiffer::THUMB_BYTES];
+    FrameDiffer differ;
+    differ.setReference(thumb);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS * 100; i++) {
+        FrameDiffer::thumbnail(image, thumb);
+        differ.compare(thumb, 640, 480);
+    }
+    double diffUs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / (ROUNDS * 100) * 1e6;
+    printf("  encode 640x480 q70     %7.2f ms on this host, %5.0f ms charged as the S3's\n", fullMs,
+           640.0 * 480 * S3_ENCODE_NS_PER_PIXEL / 1e6);
+    printf("  encode 160x160 q70     %7.2f ms on this host, %5.0f ms charged as the S3's\n", roiMs,
+           160.0 * 160 * S3_ENCODE_NS_PER_PIXEL / 1e6);
+    printf("  thumbnail and compare  %7.1f us on this host (%u PSRAM reads)\n", diffUs,
+           (unsigned)(FrameDiffer::CELLS * FrameDiffer::SAMPLES * FrameDiffer::SAMPLES));
+
+    // The differ: noise, head jitter and exposure against real changes
+    FrameDiffer::thumbnail(image, thumb);
+    differ.setReference(thumb);
+    auto changeTo = [&](const Scene& scene, int dx, int dy, double gain) {
+        render(scene, dx, dy, gain, noise, 640, 480, other);
+        JpegImage next = { other, 640, 480, 640 * 2, JPEG_INPUT_YUYV };
+        uint8_t t[FrameDiffer::THUMB_BYTES];
+        FrameDiffer::thumbnail(next, t);
+        return differ.compare(t, 640, 480);
+    };
+    VisionConfig defaults;
+    SceneChange same = changeTo(room, 0, 0, 1.0);
+    SceneChange jitter = changeTo(room, 1, -1, 1.0);
+    SceneChange exposure = changeTo(room, 0, 0, 1.08);
+    checks.expect(same.changedCells < defaults.sceneChangeCells &&
+                  jitter.changedCells < defaults.sceneChangeCells &&
+                  exposure.changedCells < defaults.sceneChangeCells,
+                  "noise, 1 px of jitter and +8% exposure are not a new scene",
+                  format("%.0f, %.0f, %.0f cells", same.changedCells, jitter.changedCells, exposure.changedCells));
+    Scene added = room;
+    Shape cup = { 400, 300, 64, 80, { 230, 40, 40 }, 0 };
+    added.shapes.push_back(cup);
+    SceneChange local = changeTo(added, 0, 0, 1.0);
+    bool covers = local.region.x <= cup.x && local.region.y <= cup.y &&
+                  local.region.x + local.region.width >= cup.x + cup.w &&
+                  local.region.y + local.region.height >= cup.y + cup.h;
+    checks.expect(local.changedCells >= defaults.sceneChangeCells && covers &&
+                  local.region.area() * 100 <= 640u * 480 * defaults.cropMaxPercent &&
+                  local.region.x % FrameDiffer::ALIGN == 0 && local.region.width % FrameDiffer::ALIGN == 0,
+                  "a 64x80 object put down: a change, the region covers it, MCU-aligned",
+                  format("%.0f cells, region %.0f x %.0f", local.changedCells, local.region.width,
+                         local.region.height));
+    SceneChange cut = changeTo(randomRoom(rng), 0, 0, 1.0);
+    checks.expect(cut.changedPercent > defaults.cropMaxPercent, "another room changes most of the frame",
+                  format("%.0f%% of cells", cut.changedPercent));
+
+    // The multipart body reads the JPEG where it lies
+    MultipartStream body("image_file", "frame.jpg", "image/jpeg", out.data(), 50000);
+    std::vector<uint8_t> read(body.size());
+    size_t got = 0;
+    char piece[1460];
+    while (body.available() > 0) {
+        size_t n = body.readBytes(piece, sizeof(piece));
+        memcpy(read.data() + got, piece, n);
+        got += n;
+    }
+    HostHttpRequest request;
+    request.headers.push_back({ "Content-Type", body.contentType() });
+    request.body = read;
+    std::vector<uint8_t> part;
+    checks.expect(got == body.size() && parseUpload(request, part) && part.size() == 50000 &&
+                  memcmp(part.data(), out.data(), 50000) == 0 && sizeof(MultipartStream) < 512,
+                  "multipart body: head, the buffer in place, tail",
+                  format("%.0f bytes of framing, %.0f bytes of state", body.size() - 50000.0, sizeof(MultipartStream)));
+}
+
+int main(int argc, char** argv) {
+    uint32_t minutes = 15;
+    uint64_t seed = 1;
+    uint32_t uplinkKbps = 1000;
+    std::string list;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--minutes" && i + 1 < argc) minutes = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--uplink-kbps" && i + 1 < argc) uplinkKbps = atoi(argv[++i]);
+        else if (arg == "--images" && i + 1 < argc) list = argv[++i];
+        else if (arg == "--hold" && i + 1 < argc) holdLooks = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--minutes N] [--seed N] [--uplink-kbps N] [--images list.txt [--hold LOOKS]]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (minutes < 1) minutes = 1;
+    if (holdLooks < 1) holdLooks = 1;
+    if (uplinkKbps < 64) uplinkKbps = 64;
+    if (!list.empty()) {
+        std::ifstream file(list);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line[0] != '#') imagePaths.push_back(line);
+        }
+        if (imagePaths.empty()) {
+            fprintf(stderr, "no images in %s\n", list.c_str());
+            return 2;
+        }
+        fromImages = true;
+    }
+    Logger::setLogLevel(LOG_NONE);
+    HostHttp::uplinkBitsPerSecond = uplinkKbps * 1000;
+
+    Checks checks;
+    printf("Parts:\n");
+    parts(checks);
+
+    HostRandom rng(seed);
+    World w = makeWorld(minutes, rng);
+    world = &w;
+    uint32_t endMs = fromImages ? imagePaths.size() * holdLooks * LOOK_MS : w.endMs;
+    standIn();
+
+    VisionConfig every;
+    every.sceneChangeCells = 0;
+    every.cropMaxPercent = 0;
+    every.minQuality = every.maxQuality = every.startQuality = 80;
+    every.watchIntervalMs = LOOK_MS;
+    VisionConfig skip = every;
+    skip.sceneChangeCells = VisionConfig().sceneChangeCells;
+    VisionConfig adaptive;
+    adaptive.watchIntervalMs = LOOK_MS;
+
+    if (!fromImages) {
+        printf("\nWorld: %u minutes, %zu scenes, a look every %.0f s, uplink %u kbps\n", minutes, w.states.size(),
+               LOOK_MS / 1000.0, uplinkKbps);
+    } else {
+        printf("\nImages: %zu, each held for %u looks, a look every %.0f s, uplink %u kbps\n", imagePaths.size(),
+               holdLooks, LOOK_MS / 1000.0, uplinkKbps);
+    }
+    Run runs[] = {
+        replay("every look, whole, q80", every, seed, endMs),
+        replay("skip, whole, q80", skip, seed, endMs),
+        replay("skip, crops, adaptive q", adaptive, seed, endMs),
+    };
+    printf("\n  %-26s %6s %6s %6s %8s %8s %12s %6s %6s %7s %7s %7s\n", "strategy", "looks", "sent", "crops", "KB",
+           "KB/scene", "described", "stale", "redund", "look50", "scene50", "scene90");
+    for (const Run& r : runs) printRun(r);
+    const Run& a = runs[0];
+    const Run& b = runs[1];
+    const Run& c = runs[2];
+    printf("  adaptive quality: p10 %.0f, p50 %.0f, p90 %.0f; %.2f encodes per upload\n",
+           percentile(c.quality, 0.1), percentile(c.quality, 0.5), percentile(c.quality, 0.9),
+           c.looks - c.skipped ? (double)c.encodes / (c.looks - c.skipped) : 0.0);
+    printf("  look50: capture to description of an upload look (ms); scene50/90: a new scene to its description (ms)\n");
+    printf("  JPEG buffer in PSRAM: %zu bytes\n", HostHeap::psramBytes);
+
+    printf("\nChecks:\n");
+    checks.expect(malformed == 0 && a.buffersLeftOut + b.buffersLeftOut + c.buffersLeftOut == 0,
+                  "every upload parsed at the stand-in, every frame buffer given back");
+    checks.expect(HostHeap::psramBytes >= (size_t)Board::Camera::WIDTH * Board::Camera::HEIGHT / 2,
+                  "the JPEG buffer is in PSRAM");
+    if (!fromImages) {
+        checks.expect(c.kb <= 0.4 * a.kb, "skip, crops and adaptive quality send under 40% of every look's bytes",
+                      format("%.0f KB vs %.0f KB", c.kb, a.kb));
+        checks.expect(c.kb < b.kb, "crops and adaptive quality send less than skipping alone",
+                      format("%.0f KB vs %.0f KB", c.kb, b.kb));
+        checks.expect(c.described >= 0.95 * c.seen, "95% of the scenes looked at are described",
+                      format("%.0f of %.0f", c.described, c.seen));
+        checks.expect(c.staleLooks <= 0.05 * c.looks, "at most 5% of looks leave a stale description",
+                      format("%.0f of %.0f", c.staleLooks, c.looks));
+        checks.expect(percentile(c.sceneMs, 0.9) <= percentile(a.sceneMs, 0.9) + 250,
+                      "a new scene is described no later than when sending every look",
+                      format("p90 %.0f ms vs %.0f ms", percentile(c.sceneMs, 0.9), percentile(a.sceneMs, 0.9)));
+    }
+
+    printf("\n%s\n", checks.failed ? "Some checks FAILED" : "All checks passed");
+    return checks.failed ? 1 : 0;
+}
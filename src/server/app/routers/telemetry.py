@@ -0,0 +1,79 @@
+from fastapi import APIRouter, Request, Header
+from fastapi.responses import PlainTextResponse
+from typing import Dict
+import logging
+
+logger = logging.getLogger(__name__)
+router = APIRouter()
+
+# Latest Prometheus text pushed by each device
+device_metrics: Dict[str, str] = {}
+
+# Sample names a histogram family's samples are written under
+HISTOGRAM_SUFFIXES = ("_bucket", "_sum", "_count")
+
+def add_device_label(line: str, device_id: str) -> str:
+    """Insert a device label into a Prometheus sample line."""
+    name, _, value = line.rpartition(" ")
+    if "{" in name:
+        name = name.replace("{", f'{{device="{device_id}",', 1)
+    else:
+        name = f'{name}{{device="{device_id}"}}'
+    return f"{name} {value}"
+
+@router.post("/metrics")
+async def push_metrics(
+    request: Request,
+    x_device_id: str = Header(default="unknown")
+) -> Dict[str, str]:
+    """
+    Store the metrics snapshot pushed by a device.
+    """
+    body = await request.body()
+    device_metrics[x_device_id] = body.decode("utf-8", errors="replace")
+    return {"status": "ok"}
+
+@router.get("/metrics", response_class=PlainTextResponse)
+async def scrape_metrics() -> str:
+    """
+    Fleet-wide metrics in Prometheus text format, one device label per unit.
+    Each family is written once, HELP and TYPE first, with every device's
+    samples of it together, as the exposition format requires.
+    """
+    families: Dict[str, Dict] = {}
+
+    def family_of(sample_name: str) -> str:
+        if sample_name in families:
+            return sample_name
+        for suffix in HISTOGRAM_SUFFIXES:
+            base = sample_name[:-len(suffix)]
+            if sample_name.endswith(suffix) and base in families:
+                return base
+        return sample_name
+
+    for device_id, text in device_metrics.items():
+        for line in text.splitlines():
+            if not line:
+                continue
+            if line.startswith("# HELP ") or line.startswith("# TYPE "):
+                parts = line.split(" ", 3)
+                if len(parts) < 3:
+                    continue
+                family = families.setdefault(parts[2], {"help": None, "type": None, "samples": []})
+                key = "help" if parts[1] == "HELP" else "type"
+                if family[key] is None:
+                    family[key] = line
+            elif line.startswith("#"):
+                continue
+            else:
+                sample_name = line.split("{", 1)[0].split(" ", 1)[0]
+                family = families.setdefault(family_of(sample_name), {"help": None, "type": None, "samples": []})
+                family["samples"].append(add_device_label(line, device_id))
+
+    lines = []
+    for family in families.values():
+        if not family["samples"]:
+            continue
+        lines.extend(header for header in (family["help"], family["type"]) if header)
+        lines.extend(family["samples"])
+    return "\n".join(lines) + "\n"
@@ -1,6 +1,6 @@
 from fastapi import FastAPI, WebSocket, HTTPException
 from fastapi.middleware.cors import CORSMiddleware
-from app.routers import audio, vision, chat
+from app.routers import audio, vision, chat, telemetry
 from app.models.ai_manager import AIManager
 from app.security import SecurityManager
 import uvicorn
@@ -37,6 +37,7 @@ ai_manager = AIManager()
 app.include_router(audio.router, prefix="/audio", tags=["audio"])
 app.include_router(vision.router, prefix="/vision", tags=["vision"])
 app.include_router(chat.router, prefix="/chat", tags=["chat"])
+app.include_router(telemetry.router, prefix="/telemetry", tags=["telemetry"])
 
 @app.on_event("startup")
 async def startup_event():